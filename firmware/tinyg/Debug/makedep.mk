@@ -2,6 +2,8 @@
 # Automatically-generated file. Do not edit or delete the file
 ################################################################################
 
+analog.c
+
 canonical_machine.c
 
 config.c
@@ -34,6 +36,8 @@ main.c
 
 network.c
 
+perf.c
+
 persistence.c
 
 planner.c
@@ -44,6 +48,10 @@ plan_exec.c
 
 plan_line.c
 
+plan_shaper.c
+
+plan_spline.c
+
 plan_zoid.c
 
 pwm.c
@@ -66,6 +74,8 @@ xio.c
 
 xio\xio_file.c
 
+xio\xio_flash.c
+
 xio\xio_pgm.c
 
 xio\xio_rs485.c
@@ -0,0 +1,236 @@
+/*
+ * analog.c - analog inputs sampled by the ADC
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tinyg.h"		// #1
+#include "config.h"		// #2
+#include "hardware.h"
+#include "text_parser.h"
+#include "util.h"
+#include "analog.h"
+
+#ifdef __AVR
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#endif
+
+#if defined(__ANALOG) && defined(__XIO_SPI_SLAVE)
+#error __ANALOG and __XIO_SPI_SLAVE use the same DMA channel (see analog.h)
+#endif
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**** Allocate Structures ****/
+
+anAnalog_t an;
+
+static void _adc_init(void);
+static void _set_mux(uint8_t channel);
+
+/************************************************************************************
+ **** CODE **************************************************************************
+ ************************************************************************************/
+
+/*
+ * analog_init() - initialize the analog inputs and start sampling
+ *
+ *	The channel pins are set up again as the config loads (see an_set_pin())
+ */
+
+void analog_init()
+{
+	memset(&an, 0, sizeof(an));
+	_adc_init();
+}
+
+#ifdef __ANALOG
+/*
+ * _read_calibration_byte() - read a byte of the production signature row
+ */
+
+static uint8_t _read_calibration_byte(uint8_t index)
+{
+	NVM.CMD = NVM_CMD_READ_CALIB_ROW_gc;
+	uint8_t result = pgm_read_byte(index);
+	NVM.CMD = NVM_CMD_NO_OPERATION_gc;
+	return (result);
+}
+
+static void _set_dma_address(volatile uint8_t *reg, const volatile void *addr)
+{
+	reg[0] = (uint8_t)((uint16_t)addr);				// ADDR0, ADDR1 and ADDR2 are consecutive
+	reg[1] = (uint8_t)((uint16_t)addr >> 8);
+	reg[2] = 0;
+}
+#endif // __ANALOG
+
+/*
+ * _adc_init() - set up the ADC sweep and the DMA ring it is copied into
+ *
+ *	Each sweep ends with a combined DMA request for the four channels. The DMA moves the
+ *	8 result bytes in one burst, reloading the source after every burst and the
+ *	destination at the end of the ring, and repeats without end.
+ */
+
+static void _adc_init()
+{
+#ifdef __ANALOG
+	ANALOG_ADC.CTRLA = 0;
+	ANALOG_ADC.CALL = _read_calibration_byte(offsetof(NVM_PROD_SIGNATURES_t, ADCBCAL0));
+	ANALOG_ADC.CALH = _read_calibration_byte(offsetof(NVM_PROD_SIGNATURES_t, ADCBCAL1));
+	ANALOG_ADC.CTRLB = ADC_CONMODE_bm | ADC_FREERUN_bm | ADC_RESOLUTION_12BIT_gc;
+	ANALOG_ADC.REFCTRL = ADC_REFSEL_VCC_gc;
+	ANALOG_ADC.PRESCALER = ANALOG_ADC_PRESCALER;
+	ANALOG_ADC.EVCTRL = ADC_SWEEP_0123_gc;
+	for (uint8_t channel = 0; channel < ANALOG_CHANNELS; channel++) {
+		(&ANALOG_ADC.CH0)[channel].CTRL = ADC_CH_INPUTMODE_SINGLEENDED_gc;
+		_set_mux(channel);
+	}
+
+	DMA.CTRL |= DMA_ENABLE_bm;
+	DMA.ANALOG_DMA_CH.CTRLA = 0;
+	DMA.ANALOG_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_BURST_gc | DMA_CH_SRCDIR_INC_gc |
+								 DMA_CH_DESTRELOAD_BLOCK_gc | DMA_CH_DESTDIR_INC_gc;
+	DMA.ANALOG_DMA_CH.TRIGSRC = ANALOG_DMA_TRIGSRC;
+	DMA.ANALOG_DMA_CH.TRFCNT = sizeof(an.ring);
+	DMA.ANALOG_DMA_CH.REPCNT = 0;					// repeat forever
+	_set_dma_address(&DMA.ANALOG_DMA_CH.SRCADDR0, &ANALOG_ADC.CH0RES);
+	_set_dma_address(&DMA.ANALOG_DMA_CH.DESTADDR0, an.ring);
+	DMA.ANALOG_DMA_CH.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_REPEAT_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_8BYTE_gc;
+
+	ANALOG_ADC.CTRLA = ADC_DMASEL_CH0123_gc | ADC_ENABLE_bm;	// free running from here on
+#endif
+}
+
+/*
+ * _set_mux() - connect an ADC channel to its pin
+ */
+
+static void _set_mux(uint8_t channel)
+{
+#ifdef __ANALOG
+	uint8_t pin_bm = 1 << an.c[channel].pin;
+	ANALOG_PORT.DIRCLR = pin_bm;
+	(&ANALOG_PORT.PIN0CTRL)[an.c[channel].pin] = PORT_ISC_INPUT_DISABLE_gc;	// no digital input buffer
+	(&ANALOG_ADC.CH0)[channel].MUXCTRL = an.c[channel].pin << ADC_CH_MUXPOS_gp;
+#endif
+}
+
+/*
+ * analog_callback() - refresh the filtered values from the DMA ring
+ *
+ *	A box filter over the ring. A result is read until two reads agree in case the
+ *	DMA writes it between its two bytes.
+ */
+
+stat_t analog_callback()
+{
+#ifndef __ANALOG
+	return (STAT_NOOP);
+#else
+	if ((SysTickTimer_getValue() - an.update_tick) < ANALOG_UPDATE_MS) {
+		return (STAT_NOOP);
+	}
+	an.update_tick = SysTickTimer_getValue();
+
+	for (uint8_t channel = 0; channel < ANALOG_CHANNELS; channel++) {
+		int32_t sum = 0;
+		for (uint8_t i = 0; i < ANALOG_SAMPLES; i++) {
+			int16_t result;
+			do {
+				result = an.ring[i][channel];
+			} while (result != an.ring[i][channel]);
+			sum += max(result, 0);					// noise at 0 volts can read just below
+		}
+		an.value[channel] = sum * an.c[channel].scale / (ANALOG_SAMPLES * ANALOG_FULL_SCALE);
+	}
+	return (STAT_OK);
+#endif
+}
+
+/*
+ * analog_get_value() - return the filtered value of a channel in its units
+ */
+
+float analog_get_value(uint8_t channel)
+{
+	return (an.value[channel]);
+}
+
+/***********************************************************************************
+ * CONFIGURATION AND INTERFACE FUNCTIONS
+ * Functions to get and set variables from the cfgArray table
+ ***********************************************************************************/
+
+static uint8_t _get_channel(nvObj_t *nv)
+{
+	return ((nv->group[0] ? nv->token[0] : nv->token[2]) - 0x31);
+}
+
+/*
+ * an_set_pin() - set the PORTB pin read by a channel
+ */
+
+stat_t an_set_pin(nvObj_t *nv)
+{
+	if (nv->value < 0) {
+		return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	}
+	if (nv->value > 7) {
+		return (STAT_INPUT_EXCEEDS_MAX_VALUE);
+	}
+	set_ui8(nv);
+	_set_mux(_get_channel(nv));
+	return (STAT_OK);
+}
+
+/***********************************************************************************
+ * TEXT MODE SUPPORT
+ * Functions to print variables from the cfgArray table
+ ***********************************************************************************/
+
+#ifdef __TEXT_MODE
+
+static const char fmt_an[] PROGMEM =  "[%s%s] analog input %c%20.3f\n";
+static const char fmt_anp[] PROGMEM = "[%s%s] analog input %c pin%15.0f [PB0-PB7]\n";
+static const char fmt_ank[] PROGMEM = "[%s%s] analog input %c scale%13.3f at full scale\n";
+
+static void _print_analog_flt(nvObj_t *nv, const char *format)
+{
+	text_printf_P(format, nv->group, nv->token, _get_channel(nv) + 0x31, nv->value);
+}
+
+void an_print_an(nvObj_t *nv) { _print_analog_flt(nv, fmt_an);}
+void an_print_anp(nvObj_t *nv) { _print_analog_flt(nv, fmt_anp);}
+void an_print_ank(nvObj_t *nv) { _print_analog_flt(nv, fmt_ank);}
+
+#endif // __TEXT_MODE
+
+#ifdef __cplusplus
+}
+#endif
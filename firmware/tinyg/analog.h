@@ -0,0 +1,101 @@
+/*
+ * analog.h - analog inputs sampled by the ADC
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * ANALOG INPUTS
+ *
+ *	With __ANALOG enabled ADCB sweeps its four channels in free running mode and a DMA
+ *	channel copies the four results of each sweep into a ring of ANALOG_SAMPLES sweeps.
+ *	The DMA repeats forever, so sampling costs no CPU time and no interrupts - the DDA
+ *	never sees it. analog_callback() averages the ring every ANALOG_UPDATE_MS into the
+ *	filtered values, and analog_get_value() just returns one of them, so it is constant
+ *	time and can be called from the exec or the loader as well as the controller.
+ *
+ *	Each channel reads a PORTB pin ($an1p = 0-7) and is scaled so the ADC reference
+ *	(VCC/1.6, about 2 volts) reads $an1k units. The channels convert in signed mode so
+ *	0 volts reads 0 without an offset, at 11 bits of resolution. Keep the pins clear of
+ *	the quadrature encoder (PB0 and PB1 with __ENCODER_QDEC) and SPI SS2 (PB3).
+ *
+ *	The DMA channel is the SPI slave's TX channel, so __ANALOG and __XIO_SPI_SLAVE
+ *	can't both be enabled. Without __ANALOG the values read 0.
+ */
+#ifndef ANALOG_H_ONCE
+#define ANALOG_H_ONCE
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**** Configs and Constants ****/
+
+#define ANALOG_CHANNELS		4			// ADC channels swept (must match the ADC sweep setting)
+#define ANALOG_SAMPLES		16			// sweeps in the DMA ring - the filter length
+#define ANALOG_UPDATE_MS	5			// filtered values are refreshed this often
+#define ANALOG_FULL_SCALE	2047		// signed mode result at the reference voltage
+
+/**** Structures ****/
+
+typedef struct anChannel {				// one per ADC channel
+	uint8_t pin;						// PORTB pin read by the channel (0-7)
+	float scale;						// units at full scale
+} anChannel_t;
+
+typedef struct anAnalog {
+	anChannel_t c[ANALOG_CHANNELS];		// channel configs
+	float value[ANALOG_CHANNELS];		// filtered values in channel units
+	uint32_t update_tick;				// systick of the last filter pass
+	volatile int16_t ring[ANALOG_SAMPLES][ANALOG_CHANNELS];	// ADC results written by the DMA
+} anAnalog_t;
+
+extern anAnalog_t an;
+
+/**** Function Prototypes ****/
+
+void analog_init(void);
+stat_t analog_callback(void);
+float analog_get_value(uint8_t channel);
+
+stat_t an_set_pin(nvObj_t *nv);
+
+#ifdef __TEXT_MODE
+
+	void an_print_an(nvObj_t *nv);
+	void an_print_anp(nvObj_t *nv);
+	void an_print_ank(nvObj_t *nv);
+
+#else
+
+	#define an_print_an tx_print_stub
+	#define an_print_anp tx_print_stub
+	#define an_print_ank tx_print_stub
+
+#endif // __TEXT_MODE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// End of include guard: ANALOG_H_ONCE
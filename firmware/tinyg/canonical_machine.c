@@ -39,14 +39,15 @@
  *
  *	There are 3 temporal contexts for system state:
  *	  - The gcode model in the canonical machine (the MODEL context, held in gm)
- *	  - The gcode model used by the planner (PLANNER context, held in bf's and mm)
+ *	  - The gcode model used by the planner (PLANNER context, held in bf's, mb.modal and mm)
  *	  - The gcode model used during motion for reporting (RUNTIME context, held in mr)
  *
  *	It's a bit more complicated than this. The 'gm' struct contains the core Gcode model
- *	context. This originates in the canonical machine and is copied to each planner buffer
- *	(bf buffer) during motion planning. Finally, the gm context is passed to the runtime
- *	(mr) for the RUNTIME context. So at last count the Gcode model exists in as many as
- *	30 copies in the system. (1+28+1)
+ *	context. This originates in the canonical machine and is split up during motion planning:
+ *	the per-move values (line number, target, move time...) are copied to each planner buffer
+ *	(bf buffer), and the modal values (offsets, spindle, tool, coolant...) are kept once in a
+ *	small deduplicated table that consecutive buffers share (mb.modal). Finally, the gm context
+ *	is reassembled in the runtime (mr) for the RUNTIME context.
  *
  *	Depending on the need, any one of these contexts may be called for reporting or by
  *	a function. Most typically, all new commends from the gcode parser work form the MODEL
@@ -91,17 +92,23 @@
 #include "text_parser.h"
 #include "canonical_machine.h"
 #include "controller.h"
+#include "gcode_parser.h"
 #include "plan_arc.h"
 #include "planner.h"
+#include "plan_spline.h"
 #include "stepper.h"
+#include "kinematics.h"
 #include "encoder.h"
 #include "spindle.h"
 #include "report.h"
 #include "gpio.h"
 #include "switch.h"
 #include "hardware.h"
+#include "analog.h"
+#include "test.h"
 #include "util.h"
 #include "xio.h"			// for serial queue flush
+#include "persistence.h"
 /*
 #ifdef __cplusplus
 extern "C"{
@@ -120,6 +127,7 @@ cmSingleton_t cm;		// canonical machine controller singleton
 // command execution callbacks from planner queue
 static void _exec_offset(float *value, float *flag);
 static void _exec_change_tool(float *value, float *flag);
+static void _apply_tool_length(uint8_t tool);
 static void _exec_select_tool(float *value, float *flag);
 static void _exec_mist_coolant_control(float *value, float *flag);
 static void _exec_flood_coolant_control(float *value, float *flag);
@@ -172,6 +180,7 @@ uint8_t cm_get_buffer_drain_state() { return cm.buffer_drain_state;}
 void cm_set_motion_state(uint8_t motion_state)
 {
 	cm.motion_state = motion_state;
+	controller_publish(TOPIC_STATE);
 
 	switch (motion_state) {
 		case (MOTION_STOP): { ACTIVE_MODEL = MODEL; break; }
@@ -191,7 +200,6 @@ void cm_set_buffer_drain_state(uint8_t buffer_drain_state)
 
 /*	These getters and setters will work on any gm model with inputs:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
@@ -255,20 +263,52 @@ void cm_set_model_linenum(uint32_t linenum)
 
 /*
  * cm_get_active_coord_offset() - return the currently active coordinate offset for an axis
+ * cm_invalidate_coord_offsets() - drop the cached offsets after an offset value has changed
  *
  *	Takes G5x, G92 and absolute override into account to return the active offset for this move
  *
  *	This function is typically used to evaluate and set offsets, as opposed to cm_get_work_offset()
  *	which merely returns what's in the work_offset[] array.
+ *
+ *	The combined offsets are called for on every move and every model position report, but only
+ *	change with G10, G5x, G53 and the G92 family. They are kept in cm.active_offset[] for the
+ *	coord system and absolute override they were made for, and remade when either changes or
+ *	when an offset value is changed (G10, G92, $g54x...), which must call
+ *	cm_invalidate_coord_offsets().
  */
 
+static void _update_active_offsets()
+{
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		if (cm.gm.absolute_override == true) {				// no offset if in absolute override mode
+			cm.active_offset[axis] = 0;
+			continue;
+		}
+		cm.active_offset[axis] = cm.offset[cm.gm.coord_system][axis];
+		if (cm.gmx.origin_offset_enable == true)
+			cm.active_offset[axis] += cm.gmx.origin_offset[axis];	// includes G5x and G92 components
+	}
+	if (cm.gm.absolute_override != true) {
+		cm.active_offset[AXIS_Z] += cm.gmx.tool_length_offset;		// and the G43 tool length
+	}
+	cm.active_offset_system = cm.gm.coord_system;
+	cm.active_offset_override = cm.gm.absolute_override;
+	cm.active_offset_valid = true;
+}
+
 float cm_get_active_coord_offset(uint8_t axis)
 {
-	if (cm.gm.absolute_override == true) return (0);		// no offset if in absolute override mode
-	float offset = cm.offset[cm.gm.coord_system][axis];
-	if (cm.gmx.origin_offset_enable == true)
-		offset += cm.gmx.origin_offset[axis];				// includes G5x and G92 components
-	return (offset);
+	if ((cm.active_offset_valid != true) ||
+		(cm.active_offset_system != cm.gm.coord_system) ||
+		(cm.active_offset_override != cm.gm.absolute_override)) {
+		_update_active_offsets();
+	}
+	return (cm.active_offset[axis]);
+}
+
+void cm_invalidate_coord_offsets()
+{
+	cm.active_offset_valid = false;
 }
 
 /*
@@ -276,7 +316,6 @@ float cm_get_active_coord_offset(uint8_t axis)
  *
  *	This function accepts as input:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
@@ -291,16 +330,14 @@ float cm_get_work_offset(GCodeState_t *gcode_state, uint8_t axis)
  *
  *	This function accepts as input:
  *		MODEL 		(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
- *		PLANNER		(GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
  *		RUNTIME		(GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
  *		ACTIVE_MODEL cm.am						// active model pointer is maintained by state management
  */
 
 void cm_set_work_offsets(GCodeState_t *gcode_state)
 {
-	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
-		gcode_state->work_offset[axis] = cm_get_active_coord_offset(axis);
-	}
+	cm_get_active_coord_offset(AXIS_X);						// bring the cached offsets up to date
+	copy_vector(gcode_state->work_offset, cm.active_offset);
 }
 
 /*
@@ -377,29 +414,93 @@ void cm_finalize_move() {
 void cm_update_model_position_from_runtime() { copy_vector(cm.gmx.position, mr.gm.target); }
 
 /*
- * cm_deferred_write_callback() - write any changed G10 values back to persistence
+ * cm_deferred_write_callback() - stage changed G10 values for persistence
  *
- *	Only runs if there is G10 data to write, there is no movement, and the serial queues are quiescent
- *	This could be made tighter by issuing an XOFF or ~CTS beforehand and releasing it afterwards.
+ *	G10 offsets and tool table entries take effect in RAM when they are set. Each one also
+ *	marks its own bit in cm.offset_dirty[] or cm.tool_dirty, and this callback hands only
+ *	the marked values to the persistence stage (see write_persistent_value()). Staging is
+ *	RAM only, so it is done straight away, even while the machine is moving, and the stage
+ *	is committed to the journal in one batch once the machine is idle.
+ *
+ *	Only as many values are staged as the stage has room for, so staging never forces a
+ *	commit. Anything left over stays marked and is staged once the commit has freed the
+ *	stage - a preamble that sets all of G54-G59 costs one or two background commits.
  */
 
 stat_t cm_deferred_write_callback()
 {
-	if ((cm.cycle_state == CYCLE_OFF) && (cm.deferred_write_flag == true)) {
-#ifdef __AVR
-		if (xio_isbusy()) return (STAT_OK);		// don't write back if serial RX is not empty
-#endif
-		cm.deferred_write_flag = false;
-		nvObj_t nv;
-		for (uint8_t i=1; i<=COORDS; i++) {
-			for (uint8_t j=0; j<AXES; j++) {
-				sprintf((char *)nv.token, "g%2d%c", 53+i, ("xyzabc")[j]);
-				nv.index = nv_get_index((const char_t *)"", nv.token);
-				nv.value = cm.offset[i][j];
-				nv_persist(&nv);				// Note: only writes values that have changed
-			}
+	if (cm.deferred_write_flag == false) return (STAT_OK);
+
+	uint8_t room = persistence_stage_room();
+	nvObj_t nv;
+	for (uint8_t i=1; i<=COORDS; i++) {
+		for (uint8_t j=0; j<AXES; j++) {
+			if ((cm.offset_dirty[i] & (1<<j)) == 0) continue;
+			if (room == 0) return (STAT_OK);	// the rest wait for the next commit
+			sprintf((char *)nv.token, "g%2d%c", 53+i, ("xyzabc")[j]);
+			nv.index = nv_get_index((const char_t *)"", nv.token);
+			nv.value = cm.offset[i][j];
+			nv_persist(&nv);
+			cm.offset_dirty[i] &= ~(1<<j);
+			room--;
+		}
+	}
+	for (uint8_t i=1; i<=TOOLS; i++) {
+		if ((cm.tool_dirty & (1<<i)) == 0) continue;
+		if (room < 2) return (STAT_OK);
+		for (uint8_t j=0; j<2; j++) {
+			sprintf((char *)nv.token, "tt%d%c", i, ("ld")[j]);
+			nv.index = nv_get_index((const char_t *)"", nv.token);
+			nv.value = (j == 0) ? cm.tool_length[i] : cm.tool_diameter[i];
+			nv_persist(&nv);
 		}
+		cm.tool_dirty &= ~(1<<i);
+		room -= 2;
 	}
+	cm.deferred_write_flag = false;
+	return (STAT_OK);
+}
+
+/*
+ * cm_checkpoint_callback() - record a power loss checkpoint every $cpi ms while running
+ *
+ *	The checkpoint is the runtime line number and machine position, and the coordinate
+ *	system, tool, units, distance mode, plane, spindle and coolant in effect. One more is
+ *	taken when the cycle ends, so the last one is never left mid-job. Nothing is written
+ *	if nothing has changed (e.g. in a feedhold). Each is a single NVM page write to a ring
+ *	that spreads the wear (see persistence_write_checkpoint()), so motion is not held up.
+ *	With a 5 s interval the ring lasts about 1000 hours of running.
+ *
+ *	After a power loss {"ckp":n} reports it, and the job can be restarted with $ff set to
+ *	the line (see cm_fast_forward_resume()) once the machine has been homed.
+ */
+stat_t cm_checkpoint_callback()
+{
+	if (cm.checkpoint_interval == 0) return (STAT_NOOP);
+	if (cm.cycle_state == CYCLE_OFF) {
+		if (cm.checkpoint_running == false) return (STAT_NOOP);
+		cm.checkpoint_running = false;					// the cycle has ended - take the last one
+	} else {
+		if ((SysTickTimer_getValue() - cm.checkpoint_tick) < cm.checkpoint_interval) return (STAT_NOOP);
+		cm.checkpoint_running = true;
+	}
+	cm.checkpoint_tick = SysTickTimer_getValue();
+
+	cmCheckpoint_t ckp;
+	memset(&ckp, 0, sizeof(ckp));
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		ckp.position[axis] = mp_get_runtime_absolute_position(axis);
+	}
+	ckp.linenum = mr.gm.linenum;
+	ckp.coord_tool = mr.gm.coord_system | (cm.gm.tool << 4);
+	ckp.modes = ((mr.gm.units_mode == MILLIMETERS) ? CHECKPOINT_MILLIMETERS : 0) |
+				((mr.gm.distance_mode == INCREMENTAL_MODE) ? CHECKPOINT_INCREMENTAL : 0) |
+				(mr.gm.select_plane << 2) | (cm.gm.spindle_mode << 4) |
+				((cm.gm.mist_coolant == true) ? CHECKPOINT_MIST : 0) |
+				((cm.gm.flood_coolant == true) ? CHECKPOINT_FLOOD : 0);
+	if (memcmp(&ckp, &cm.checkpoint, NVM_CHECKPOINT_LEN) == 0) return (STAT_NOOP);
+	cm.checkpoint = ckp;
+	persistence_write_checkpoint((const int8_t *)&ckp);
 	return (STAT_OK);
 }
 
@@ -418,6 +519,10 @@ stat_t cm_deferred_write_callback()
  * 	RADIUS	  - ABC axis value is provided in Gcode block in linear units
  *			  - Target is set to degrees based on axis' Radius value
  *			  - Radius mode is only processed for ABC axes. Application to XYZ is ignored.
+ *	WRAPPED	  - ABC axis value is provided in degrees, as for ENABLED
+ *			  - In absolute mode the target is taken modulo 360 degrees and reached the
+ *				shortest way around (at most 180 degrees) from the current position. The
+ *				position keeps counting past 360, so relative moves and G92 work as usual.
  *
  *	Target coordinates are provided in target[]
  *	Axes that need processing are signaled in flag[]
@@ -429,10 +534,10 @@ stat_t cm_deferred_write_callback()
 
 static float _calc_ABC(uint8_t axis, float target[], float flag[])
 {
-	if ((cm.a[axis].axis_mode == AXIS_STANDARD) || (cm.a[axis].axis_mode == AXIS_INHIBITED)) {
-		return(target[axis]);	// no mm conversion - it's in degrees
+	if (cm.a[axis].axis_mode == AXIS_RADIUS) {
+		return(_to_millimeters(target[axis]) * cm.a[axis].radius_scale);
 	}
-	return(_to_millimeters(target[axis]) * 360 / (2 * M_PI * cm.a[axis].radius));
+	return(target[axis]);	// no mm conversion - it's in degrees
 }
 
 void cm_set_model_target(float target[], float flag[])
@@ -440,6 +545,20 @@ void cm_set_model_target(float target[], float flag[])
 	uint8_t axis;
 	float tmp = 0;
 
+	// G68/G51 - recover the untransformed XY program position before the XYZ loop moves it
+	float program[2];
+	bool transform = ((cm.gmx.transform_enable) && (!cm.gm.absolute_override) &&
+					  ((fp_TRUE(flag[AXIS_X])) || (fp_TRUE(flag[AXIS_Y]))));
+	if (transform) {
+		float work[2];
+		for (axis=AXIS_X; axis<=AXIS_Y; axis++) {
+			work[axis] = cm.gm.target[axis] - cm_get_active_coord_offset(axis) - cm.gmx.transform_offset[axis];
+		}
+		for (axis=AXIS_X; axis<=AXIS_Y; axis++) {
+			program[axis] = cm.gmx.transform_inverse[axis][0] * work[0] + cm.gmx.transform_inverse[axis][1] * work[1];
+		}
+	}
+
 	// process XYZABC for lower modes
 	for (axis=AXIS_X; axis<=AXIS_Z; axis++) {
 		if ((fp_FALSE(flag[axis])) || (cm.a[axis].axis_mode == AXIS_DISABLED)) {
@@ -452,6 +571,22 @@ void cm_set_model_target(float target[], float flag[])
 			}
 		}
 	}
+	if (transform) {
+		for (axis=AXIS_X; axis<=AXIS_Y; axis++) {
+			if ((fp_FALSE(flag[axis])) || (cm.a[axis].axis_mode == AXIS_DISABLED)) {
+				continue;
+			}
+			if (cm.gm.distance_mode == ABSOLUTE_MODE) {
+				program[axis] = _to_millimeters(target[axis]);
+			} else {
+				program[axis] += _to_millimeters(target[axis]);
+			}
+		}
+		for (axis=AXIS_X; axis<=AXIS_Y; axis++) {
+			cm.gm.target[axis] = cm_get_active_coord_offset(axis) + cm.gmx.transform_offset[axis] +
+								 cm.gmx.transform[axis][0] * program[0] + cm.gmx.transform[axis][1] * program[1];
+		}
+	}
 	// FYI: The ABC loop below relies on the XYZ loop having been run first
 	for (axis=AXIS_A; axis<=AXIS_C; axis++) {
 		if ((fp_FALSE(flag[axis])) || (cm.a[axis].axis_mode == AXIS_DISABLED)) {
@@ -461,6 +596,15 @@ void cm_set_model_target(float target[], float flag[])
 		}
 		if (cm.gm.distance_mode == ABSOLUTE_MODE) {
 			cm.gm.target[axis] = tmp + cm_get_active_coord_offset(axis); // sacidu93's fix to Issue #22
+			if (cm.a[axis].axis_mode == AXIS_WRAPPED) {
+				float travel = fmod(cm.gm.target[axis] - cm.gmx.position[axis], 360);
+				if (travel > 180) {
+					travel -= 360;
+				} else if (travel < -180) {
+					travel += 360;
+				}
+				cm.gm.target[axis] = cm.gmx.position[axis] + travel;
+			}
 		} else {
 			cm.gm.target[axis] += tmp;
 		}
@@ -469,6 +613,7 @@ void cm_set_model_target(float target[], float flag[])
 
 /*
  * cm_test_soft_limits() - return error code if soft limit is exceeded
+ * cm_update_soft_limits() - recompute the soft limit box
  *
  *	Must be called with target properly set in GM struct. Best done after cm_set_model_target().
  *
@@ -476,25 +621,38 @@ void cm_set_model_target(float target[], float flag[])
  *	and max to 0,0 to disable soft limits for an axis. Also will not test a min or a max if the
  *	value is < -1000000 (negative one million). This allows a single end to be tested w/the other
  *	disabled, should that requirement ever arise.
+ *
+ *	These rules are folded into a box in machine coordinates by cm_update_soft_limits(), so the
+ *	test for a move is only a pair of compares per axis. An end that is not tested is opened up
+ *	to SOFT_LIMIT_OPEN. Targets are in machine coordinates, so offset changes leave the box as it
+ *	is. It must be updated whenever the soft limit enable, a travel limit or a homed flag changes.
  */
 stat_t cm_test_soft_limits(float target[])
 {
-	if (cm.soft_limit_enable == true) {
-		for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
-			if (cm.homed[axis] != true) continue;		// don't test axes that are not homed
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		if ((target[axis] < cm.soft_limit_min[axis]) || (target[axis] > cm.soft_limit_max[axis])) {
+			return (STAT_SOFT_LIMIT_EXCEEDED);
+		}
+	}
+	return (STAT_OK);
+}
 
-			if (fp_EQ(cm.a[axis].travel_min, cm.a[axis].travel_max)) continue;
+void cm_update_soft_limits()
+{
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		cm.soft_limit_min[axis] = -SOFT_LIMIT_OPEN;
+		cm.soft_limit_max[axis] = SOFT_LIMIT_OPEN;
 
-			if ((cm.a[axis].travel_min > DISABLE_SOFT_LIMIT) && (target[axis] < cm.a[axis].travel_min)) {
-				return (STAT_SOFT_LIMIT_EXCEEDED);
-			}
+		if ((cm.soft_limit_enable != true) || (cm.homed[axis] != true)) continue;
+		if (fp_EQ(cm.a[axis].travel_min, cm.a[axis].travel_max)) continue;
 
-			if ((cm.a[axis].travel_max > DISABLE_SOFT_LIMIT) && (target[axis] > cm.a[axis].travel_max)) {
-				return (STAT_SOFT_LIMIT_EXCEEDED);
-			}
+		if (cm.a[axis].travel_min > DISABLE_SOFT_LIMIT) {
+			cm.soft_limit_min[axis] = cm.a[axis].travel_min;
+		}
+		if (cm.a[axis].travel_max > DISABLE_SOFT_LIMIT) {
+			cm.soft_limit_max[axis] = cm.a[axis].travel_max;
 		}
 	}
-	return (STAT_OK);
 }
 
 /*************************************************************************
@@ -531,8 +689,21 @@ void canonical_machine_init()
 	cm_set_path_control(cm.path_control);
 	cm_set_distance_mode(cm.distance_mode);
 	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);// always the default
+	cm_update_soft_limits();
+	cm_cancel_rotation();
+	cm_cancel_scaling();
+	cm.gmx.tool_select = 0;
+	cm.gmx.tool = 0;
+	cm.gmx.tool_length_enable = false;
+	cm.gmx.tool_length_follow = false;
+	cm.gmx.tool_length_tool = 0;
+	cm.gmx.tool_length_offset = 0;
 
 	cm.gmx.block_delete_switch = true;
+	cm.gmx.retract_mode = RETRACT_TO_INITIAL_LEVEL;
+	cm.gmx.feed_rate_override_factor = 1.0;
+	cm.gmx.traverse_override_factor = 1.0;
+	cm.gmx.spindle_override_factor = 1.0;
 
 	// never start a machine in a motion mode
 	cm.gm.motion_mode = MOTION_MODE_CANCEL_MOTION_MODE;
@@ -549,6 +720,7 @@ void canonical_machine_init()
 	// sub-system inits
 	cm_spindle_init();
 	cm_arc_init();
+	cm_spline_init();
 }
 
 /*
@@ -564,6 +736,8 @@ void canonical_machine_init_assertions(void)
 	cm.gmx.magic_end = MAGICNUM;
 	arc.magic_start = MAGICNUM;
 	arc.magic_end = MAGICNUM;
+	spline.magic_start = MAGICNUM;
+	spline.magic_end = MAGICNUM;
 }
 
 stat_t canonical_machine_test_assertions(void)
@@ -571,6 +745,7 @@ stat_t canonical_machine_test_assertions(void)
 	if ((cm.magic_start 	!= MAGICNUM) || (cm.magic_end 	  != MAGICNUM)) return (STAT_CANONICAL_MACHINE_ASSERTION_FAILURE);
 	if ((cm.gmx.magic_start != MAGICNUM) || (cm.gmx.magic_end != MAGICNUM)) return (STAT_CANONICAL_MACHINE_ASSERTION_FAILURE);
 	if ((arc.magic_start 	!= MAGICNUM) || (arc.magic_end    != MAGICNUM)) return (STAT_CANONICAL_MACHINE_ASSERTION_FAILURE);
+	if ((spline.magic_start != MAGICNUM) || (spline.magic_end != MAGICNUM)) return (STAT_CANONICAL_MACHINE_ASSERTION_FAILURE);
 	return (STAT_OK);
 }
 
@@ -601,7 +776,7 @@ stat_t cm_hard_alarm(stat_t status)
 {
 	// stop the motors and the spindle
 	stepper_init();							// hard stop
-	cm_spindle_control(SPINDLE_OFF);
+	cm_spindle_stop();
 
 	// disable all MCode functions
 //	gpio_set_bit_off(SPINDLE_BIT);			//++++ this current stuff is temporary
@@ -611,6 +786,7 @@ stat_t cm_hard_alarm(stat_t status)
 //	gpio_set_bit_off(FLOOD_COOLANT_BIT);	//++++ replace with exec function
 
 	rpt_exception(status);					// send shutdown message
+	rpt_save_exceptions();					// keep what led up to it past the reset
 	cm.machine_state = MACHINE_SHUTDOWN;
 	return (status);
 }
@@ -667,9 +843,11 @@ stat_t cm_set_coord_offsets(uint8_t coord_system, float offset[], float flag[])
 	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
 		if (fp_TRUE(flag[axis])) {
 			cm.offset[coord_system][axis] = _to_millimeters(offset[axis]);
-			cm.deferred_write_flag = true;								// persist offsets once machining cycle is over
+			cm.offset_dirty[coord_system] |= (1<<axis);
+			cm.deferred_write_flag = true;								// stage the offset for persistence
 		}
 	}
+	cm_invalidate_coord_offsets();
 	return (STAT_OK);
 }
 
@@ -683,8 +861,9 @@ stat_t cm_set_coord_offsets(uint8_t coord_system, float offset[], float flag[])
 stat_t cm_set_coord_system(uint8_t coord_system)
 {
 	cm.gm.coord_system = coord_system;
+	cm_invalidate_coord_offsets();							// also re-applies the G92 enable
 
-	float value[AXES] = { (float)coord_system,0,0,0,0,0 };	// pass coordinate system in value[0] element
+	float value[AXES] = { (float)coord_system,cm.gmx.tool_length_offset,0,0,0,0 };	// coordinate system in value[0], tool length in value[1]
 	mp_queue_command(_exec_offset, value, value);			// second vector (flags) is not used, so fake it
 	return (STAT_OK);
 }
@@ -696,6 +875,7 @@ static void _exec_offset(float *value, float *flag)
 	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
 		offsets[axis] = cm.offset[coord_system][axis] + (cm.gmx.origin_offset[axis] * cm.gmx.origin_offset_enable);
 	}
+	offsets[AXIS_Z] += value[1];							// G43 tool length as it was when queued
 	mp_set_runtime_work_offset(offsets);
 	cm_set_work_offsets(MODEL);								// set work offsets in the Gcode model
 }
@@ -729,6 +909,28 @@ void cm_set_position(uint8_t axis, float position)
 	mp_set_steps_to_runtime_position();
 }
 
+/*
+ * cm_set_position_to_runtime() - set the model and planner to where the runtime is, all axes
+ *
+ *	Same as cm_set_position() on every axis with the runtime position, but the runtime
+ *	snapshot is read, published and converted to steps once rather than once per axis.
+ *	The same DO NOT CALL warning applies.
+ */
+
+void cm_set_position_to_runtime()
+{
+	float position[AXES];
+
+	mp_get_runtime_absolute_vector(position);
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		cm.gmx.position[axis] = position[axis];
+		cm.gm.target[axis] = position[axis];
+		mp_set_planner_position(axis, position[axis]);
+	}
+	mp_set_runtime_position_vector(position);
+	mp_set_steps_to_runtime_position();
+}
+
 /*** G28.3 functions and support ***
  *
  * cm_set_absolute_origin() - G28.3 - model, planner and queue to runtime
@@ -765,8 +967,10 @@ static void _exec_absolute_origin(float *value, float *flag)
 		if (fp_TRUE(flag[axis])) {
 			mp_set_runtime_position(axis, value[axis]);
 			cm.homed[axis] = true;	// G28.3 is not considered homed until you get here
+			if (axis < HOMING_AXES) cm.home_switch_known &= ~(1 << axis);	// the switch moved with the origin
 		}
 	}
+	cm_update_soft_limits();
 	mp_set_steps_to_runtime_position();
 }
 
@@ -789,8 +993,12 @@ stat_t cm_set_origin_offsets(float offset[], float flag[])
 									  cm.offset[cm.gm.coord_system][axis] - _to_millimeters(offset[axis]);
 		}
 	}
+	if (fp_TRUE(flag[AXIS_Z])) {
+		cm.gmx.origin_offset[AXIS_Z] -= cm.gmx.tool_length_offset;	// G92 is set at the tool tip
+	}
+	cm_invalidate_coord_offsets();
 	// now pass the offset to the callback - setting the coordinate system also applies the offsets
-	float value[AXES] = { (float)cm.gm.coord_system,0,0,0,0,0 }; // pass coordinate system in value[0] element
+	float value[AXES] = { (float)cm.gm.coord_system,cm.gmx.tool_length_offset,0,0,0,0 }; // coord system in value[0], tool length in value[1]
 	mp_queue_command(_exec_offset, value, value);				  // second vector is not used
 	return (STAT_OK);
 }
@@ -801,7 +1009,8 @@ stat_t cm_reset_origin_offsets()
 	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
 		cm.gmx.origin_offset[axis] = 0;
 	}
-	float value[AXES] = { (float)cm.gm.coord_system,0,0,0,0,0 };
+	cm_invalidate_coord_offsets();
+	float value[AXES] = { (float)cm.gm.coord_system,cm.gmx.tool_length_offset,0,0,0,0 };
 	mp_queue_command(_exec_offset, value, value);
 	return (STAT_OK);
 }
@@ -809,7 +1018,8 @@ stat_t cm_reset_origin_offsets()
 stat_t cm_suspend_origin_offsets()
 {
 	cm.gmx.origin_offset_enable = 0;
-	float value[AXES] = { (float)cm.gm.coord_system,0,0,0,0,0 };
+	cm_invalidate_coord_offsets();
+	float value[AXES] = { (float)cm.gm.coord_system,cm.gmx.tool_length_offset,0,0,0,0 };
 	mp_queue_command(_exec_offset, value, value);
 	return (STAT_OK);
 }
@@ -817,11 +1027,153 @@ stat_t cm_suspend_origin_offsets()
 stat_t cm_resume_origin_offsets()
 {
 	cm.gmx.origin_offset_enable = 1;
-	float value[AXES] = { (float)cm.gm.coord_system,0,0,0,0,0 };
+	cm_invalidate_coord_offsets();
+	float value[AXES] = { (float)cm.gm.coord_system,cm.gmx.tool_length_offset,0,0,0,0 };
 	mp_queue_command(_exec_offset, value, value);
 	return (STAT_OK);
 }
 
+/*
+ * cm_set_rotation()	- G68
+ * cm_cancel_rotation() - G69
+ * cm_set_scaling()		- G51
+ * cm_cancel_scaling()	- G50
+ * cm_transform_vector() - apply the linear part of the transform to an XY offset
+ *
+ *	G68 X Y R rotates the XY program coordinates R degrees counterclockwise about X Y.
+ *	G51 X Y P scales them by P about X Y; I and J give separate X and Y factors instead,
+ *	and a negative factor mirrors that axis. Omitted center words default to the current
+ *	position. Both are XY only, and G51 in the Z axis (K) is not supported.
+ *
+ *	Points are scaled first, then rotated. The two are folded into a single matrix and
+ *	offset in gmx by _update_transform(), so cm_set_model_target() applies both with one
+ *	multiply. The transform works in the G54-G59 + G92 work frame; G53 is not transformed.
+ *	Positions are reported in the work frame, after the transform.
+ */
+static void _update_transform()
+{
+	float sx = 1, sy = 1, c = 1, s = 0;
+	float scs[2] = {0,0};							// S*Cs - Cs, the scaling about its center
+	float cr[2] = {0,0};
+
+	if (cm.gmx.scaling_enable) {
+		sx = cm.gmx.scaling_factor[0];
+		sy = cm.gmx.scaling_factor[1];
+		scs[0] = cm.gmx.scaling_center[0] * (1 - sx);
+		scs[1] = cm.gmx.scaling_center[1] * (1 - sy);
+	}
+	if (cm.gmx.rotation_enable) {
+		c = cos(cm.gmx.rotation_angle);
+		s = sin(cm.gmx.rotation_angle);
+		cr[0] = cm.gmx.rotation_center[0];
+		cr[1] = cm.gmx.rotation_center[1];
+	}
+	cm.gmx.transform_enable = (cm.gmx.scaling_enable || cm.gmx.rotation_enable);
+
+	// work = R*(S*p + scs - cr) + cr = M*p + t
+	cm.gmx.transform[0][0] = c * sx;
+	cm.gmx.transform[0][1] = -s * sy;
+	cm.gmx.transform[1][0] = s * sx;
+	cm.gmx.transform[1][1] = c * sy;
+	float u[2] = { scs[0] - cr[0], scs[1] - cr[1] };
+	cm.gmx.transform_offset[0] = cr[0] + c * u[0] - s * u[1];
+	cm.gmx.transform_offset[1] = cr[1] + s * u[0] + c * u[1];
+
+	float det = sx * sy;							// rotation has a determinant of 1
+	cm.gmx.transform_inverse[0][0] =  cm.gmx.transform[1][1] / det;
+	cm.gmx.transform_inverse[0][1] = -cm.gmx.transform[0][1] / det;
+	cm.gmx.transform_inverse[1][0] = -cm.gmx.transform[1][0] / det;
+	cm.gmx.transform_inverse[1][1] =  cm.gmx.transform[0][0] / det;
+}
+
+static void _get_transform_center(float center[], float origin[], float flag[])
+{
+	for (uint8_t axis = AXIS_X; axis <= AXIS_Y; axis++) {
+		if (fp_TRUE(flag[axis])) {
+			center[axis] = _to_millimeters(origin[axis]);
+		} else {
+			center[axis] = cm.gmx.position[axis] - cm_get_active_coord_offset(axis);
+		}
+	}
+}
+
+static stat_t _check_transform_words(float flag[])
+{
+	for (uint8_t axis = AXIS_Z; axis < AXES; axis++) {
+		if (fp_TRUE(flag[axis])) {
+			return (STAT_TRANSFORM_SPECIFICATION_ERROR);
+		}
+	}
+	return (STAT_OK);
+}
+
+stat_t cm_set_rotation(float center[], float flag[], float angle, float angle_flag)
+{
+	if (fp_FALSE(angle_flag)) {
+		return (STAT_TRANSFORM_SPECIFICATION_ERROR);	// R is required
+	}
+	ritorno(_check_transform_words(flag));
+	_get_transform_center(cm.gmx.rotation_center, center, flag);
+	cm.gmx.rotation_angle = angle * (M_PI / 180);
+	cm.gmx.rotation_enable = true;
+	_update_transform();
+	return (STAT_OK);
+}
+
+stat_t cm_cancel_rotation()
+{
+	cm.gmx.rotation_enable = false;
+	cm.gmx.rotation_angle = 0;
+	_update_transform();
+	return (STAT_OK);
+}
+
+stat_t cm_set_scaling(float center[], float flag[], float factor[], float factor_flag[],
+					  float uniform, float uniform_flag)
+{
+	float sx = uniform, sy = uniform;
+
+	ritorno(_check_transform_words(flag));
+	if (fp_TRUE(factor_flag[2])) {
+		return (STAT_TRANSFORM_SPECIFICATION_ERROR);	// K - Z scaling is not supported
+	}
+	if ((fp_TRUE(factor_flag[0])) || (fp_TRUE(factor_flag[1]))) {
+		if (fp_TRUE(uniform_flag)) {
+			return (STAT_TRANSFORM_SPECIFICATION_ERROR);// either P or I J, not both
+		}
+		sx = (fp_TRUE(factor_flag[0])) ? factor[0] : 1;
+		sy = (fp_TRUE(factor_flag[1])) ? factor[1] : 1;
+	} else if (fp_FALSE(uniform_flag)) {
+		return (STAT_TRANSFORM_SPECIFICATION_ERROR);	// no factor given
+	}
+	if ((fp_ZERO(sx)) || (fp_ZERO(sy))) {
+		return (STAT_TRANSFORM_SPECIFICATION_ERROR);
+	}
+	_get_transform_center(cm.gmx.scaling_center, center, flag);
+	cm.gmx.scaling_factor[0] = sx;
+	cm.gmx.scaling_factor[1] = sy;
+	cm.gmx.scaling_enable = true;
+	_update_transform();
+	return (STAT_OK);
+}
+
+stat_t cm_cancel_scaling()
+{
+	cm.gmx.scaling_enable = false;
+	cm.gmx.scaling_factor[0] = 1;
+	cm.gmx.scaling_factor[1] = 1;
+	_update_transform();
+	return (STAT_OK);
+}
+
+void cm_transform_vector(float vector[])
+{
+	if (!cm.gmx.transform_enable) return;
+	float v0 = vector[0];
+	vector[0] = cm.gmx.transform[0][0] * v0 + cm.gmx.transform[0][1] * vector[1];
+	vector[1] = cm.gmx.transform[1][0] * v0 + cm.gmx.transform[1][1] * vector[1];
+}
+
 stat_t cm_get_position() 
 {
 	// M114: Get current position, see https://www.reprap.org/wiki/G-code#M114:_Get_Current_Position
@@ -971,6 +1323,111 @@ stat_t cm_set_path_control(uint8_t mode)
 	return (STAT_OK);
 }
 
+/*
+ * cm_set_path_tolerance() - G64 P (affects MODEL only)
+ *
+ *	Sets how far the tool may leave the programmed corner in continuous mode. G64 without P
+ *	sets it to zero, which blends nothing and leaves cornering to junction deviation.
+ */
+
+stat_t cm_set_path_tolerance(float tolerance)
+{
+	cm.gm.path_tolerance = _to_millimeters(tolerance);
+	return (STAT_OK);
+}
+
+/*
+ * cm_set_preset() - G187 [Pn] (affects MODEL only)
+ * cm_get_jerk_scale()			 - jerk_max multiplier of the model's preset (planner)
+ * cm_get_junction_acceleration() - junction acceleration of the model's preset (planner)
+ * cm_get_chordal_tolerance()	 - chordal tolerance of the model's preset (arcs and splines)
+ * cm_get_segment_usec()		 - nominal segment time of a move's preset (runtime)
+ *
+ *	A preset retunes the planner for roughing or finishing passes: P1 rough, P2 medium
+ *	and P3 finish by default, and G187 without P goes back to the base settings. Each
+ *	preset scales the axis jerk and sets its own junction acceleration, segment time and
+ *	chordal tolerance, with 0 keeping the base setting ($pr1jk... see config_app.c).
+ *
+ *	The preset is a modal Gcode value, so G187 queues nothing and drains nothing. The
+ *	planner reads it from the model as it plans each move, and the runtime reads the
+ *	segment time from the move's own copy, so moves already queued keep the preset they
+ *	were planned with. Program end goes back to the base settings.
+ */
+
+stat_t cm_set_preset(float preset)
+{
+	if ((preset < 0) || (preset > PRESETS)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	if (fp_NE(preset, (uint8_t)preset)) {
+		return (STAT_P_WORD_IS_NOT_AN_INTEGER);
+	}
+	cm.gm.preset = (uint8_t)preset;
+	return (STAT_OK);
+}
+
+float cm_get_jerk_scale()
+{
+	if ((cm.gm.preset == 0) || (fp_ZERO(cm.preset[cm.gm.preset-1].jerk_scale))) return (1);
+	return (cm.preset[cm.gm.preset-1].jerk_scale);
+}
+
+float cm_get_junction_acceleration()
+{
+	if ((cm.gm.preset == 0) || (fp_ZERO(cm.preset[cm.gm.preset-1].junction_acceleration))) {
+		return (cm.junction_acceleration);
+	}
+	return (cm.preset[cm.gm.preset-1].junction_acceleration);
+}
+
+float cm_get_chordal_tolerance()
+{
+	if ((cm.gm.preset == 0) || (fp_ZERO(cm.preset[cm.gm.preset-1].chordal_tolerance))) {
+		return (cm.chordal_tolerance);
+	}
+	return (cm.preset[cm.gm.preset-1].chordal_tolerance);
+}
+
+float cm_get_segment_usec(uint8_t preset)
+{
+	if ((preset == 0) || (fp_ZERO(cm.preset[preset-1].segment_usec))) return (NOM_SEGMENT_USEC);
+	return (min(max(cm.preset[preset-1].segment_usec, MIN_SEGMENT_USEC), BODY_SEGMENT_USEC));
+}
+
+/*
+ * cm_set_cutter_comp() - G40, G41 [Dn], G42 [Dn] (affects MODEL only)
+ *
+ *	Keeps the tool to the left (G41) or right (G42) of the programmed path by the radius of
+ *	tool table entry n, or of the tool loaded by M6 if D is left out. Only lines in the XY
+ *	plane (G17) are offset - the planner does it in mp_aline(). The radius is taken when
+ *	compensation is turned on, so a tool change or G10 L1 needs a new G41 or G42. Work
+ *	coordinates mirrored by G51 turn the path around, so the side is swapped with it.
+ */
+
+stat_t cm_set_cutter_comp(uint8_t mode, uint8_t tool, uint8_t tool_flag)
+{
+	if (mode == CUTTER_COMP_OFF) {						// G40
+		cm.gm.cutter_comp = CUTTER_COMP_OFF;
+		cm.gm.cutter_radius = 0;
+		return (STAT_OK);
+	}
+	if (cm.gm.select_plane != CANON_PLANE_XY) {
+		return (STAT_CUTTER_COMPENSATION_CANNOT_BE_ENABLED);
+	}
+	if (tool_flag == false) {
+		tool = cm.gmx.tool;
+	} else if (tool > TOOLS) {
+		return (STAT_D_WORD_IS_INVALID);
+	}
+	if ((cm.gmx.transform_enable == true) &&
+		((cm.gmx.transform[0][0] * cm.gmx.transform[1][1] - cm.gmx.transform[0][1] * cm.gmx.transform[1][0]) < 0)) {
+		mode = (mode == CUTTER_COMP_LEFT) ? CUTTER_COMP_RIGHT : CUTTER_COMP_LEFT;
+	}
+	cm.gm.cutter_comp = mode;
+	cm.gm.cutter_radius = cm.tool_diameter[tool] / 2;	// tool 0 (no tool) has no diameter
+	return (STAT_OK);
+}
+
 /*******************************
  * Machining Functions (4.3.6) *
  *******************************/
@@ -988,6 +1445,33 @@ stat_t cm_dwell(float seconds)
 	return (STAT_OK);
 }
 
+/*
+ * cm_retract() - G10 (no L, P or axis words) retract, G11 unretract
+ *
+ *	Retracts the extruder axis ($pax) by $rtl at $rtv, or takes the retraction back off.
+ *	Both are in the units of the axis words, so a radius mode axis is scaled.
+ *	The retraction is a runtime offset on the extruder (see mp_set_retract()), so it needs
+ *	no planner buffer and runs on top of the travel that follows it. Repeated G10s or G11s
+ *	do nothing more.
+ */
+static void _exec_retract(float *value, float *flag)
+{
+	mp_set_retract(value[0], value[1]);
+}
+
+stat_t cm_retract(uint8_t retract)
+{
+	if (cm.pa_axis == 0) return (STAT_COMMAND_NOT_ACCEPTED);	// no extruder axis
+
+	uint8_t axis = cm.pa_axis - 1;
+	float scale = (cm.a[axis].axis_mode == AXIS_RADIUS) ? cm.a[axis].radius_scale : 1;	// as the axis words are
+	float value[AXES] = { 0,0,0,0,0,0 };
+	value[0] = (retract == true) ? -cm.retract_length * scale : 0;
+	value[1] = cm.retract_velocity * scale;
+	mp_queue_segment_command(_exec_retract, value, value);
+	return (STAT_OK);
+}
+
 /*
  * cm_straight_feed() - G1
  */
@@ -1007,11 +1491,292 @@ stat_t cm_straight_feed(float target[], float flags[])
 	// prep and plan the move
 	cm_set_work_offsets(&cm.gm);				// capture the fully resolved offsets to the state
 	cm_cycle_start();							// required for homing & other cycles
+	cm.gm.raster_pixels = mp_get_raster_row();	// pixels sent with $rst ride on this line
 	status = mp_aline(&cm.gm);					// send the move to the planner
+	cm.gm.raster_pixels = 0;
+	mp_discard_raster_row();					// a line too short to plan drops its row
+	cm_finalize_move();
+	return (status);
+}
+
+/*
+ * cm_spindle_sync_feed() - G33, G33.1
+ *
+ *	Moves K (the pitch, in units per revolution) along the line for each turn of the
+ *	spindle - see mp_exec_sync(). K is required on every block. A rigid tap (G33.1)
+ *	comes back out to where it started, so the model position doesn't move. Each axis
+ *	must be able to keep up with the spindle at the programmed S.
+ */
+stat_t cm_spindle_sync_feed(float target[], float flags[], float pitch, float pitch_flag, uint8_t motion_mode)
+{
+	uint8_t axis;
+
+	for (axis = AXIS_X; (axis < AXES) && (fp_ZERO(flags[axis])); axis++);
+	if (axis == AXES) return (STAT_OK);			// a block with no axis words (e.g. an M code) does not move
+
+	if (cm.gm.spindle_mode == SPINDLE_OFF) {
+		return (STAT_SPINDLE_MUST_BE_TURNING);
+	}
+	if ((fp_ZERO(pitch_flag)) || (pitch <= 0)) {
+		return (STAT_SPINDLE_SYNC_SPECIFICATION_ERROR);
+	}
+	cm.gm.motion_mode = motion_mode;
+	cm_set_model_target(target, flags);
+
+	// test soft limits
+	stat_t status = cm_test_soft_limits(cm.gm.target);
+	if (status != STAT_OK) return (cm_soft_alarm(status));
+
+	// the axes must keep up with the spindle
+	pitch = _to_millimeters(pitch);
+	float length = get_axis_vector_length(cm.gm.target, cm.gmx.position);
+	if (fp_NOT_ZERO(length)) {
+		for (axis = AXIS_X; axis < AXES; axis++) {
+			float velocity = pitch * cm.gm.spindle_speed * fabs(cm.gm.target[axis] - cm.gmx.position[axis]) / length;
+			if (velocity > cm.a[axis].feedrate_max) {
+				return (STAT_SPINDLE_SYNC_SPECIFICATION_ERROR);
+			}
+		}
+	}
+
+	// prep and plan the move
+	cm_set_work_offsets(&cm.gm);				// capture the fully resolved offsets to the state
+	cm_cycle_start();
+	status = mp_spindle_sync(&cm.gm, pitch, (motion_mode == MOTION_MODE_RIGID_TAP));
+	if (motion_mode == MOTION_MODE_RIGID_TAP) {
+		copy_vector(cm.gm.target, cm.gmx.position);
+	}
 	cm_finalize_move();
 	return (status);
 }
 
+/*
+ * cm_set_retract_mode() - G98, G99 (affects MODEL only)
+ */
+stat_t cm_set_retract_mode(uint8_t mode)
+{
+	cm.gmx.retract_mode = mode;
+	return (STAT_OK);
+}
+
+/*
+ * cm_canned_cycle()		  - G73, G81, G82, G83 drilling cycles
+ * cm_canned_cycle_callback() - queue the moves of a drilling cycle
+ * cm_abort_canned_cycle()	  - stop a drilling cycle without maintaining position
+ *
+ *	A drilling block is expanded here instead of by the host. cm_canned_cycle() works out
+ *	the heights for the hole, sets the model position to the end of the cycle and leaves
+ *	cm_canned_cycle_callback() to queue the moves as planner buffers free up - the same
+ *	way arcs are run. The callback blocks new input until the hole is finished.
+ *	The sequence follows RS274NGC:
+ *
+ *	  - if Z starts below the R plane it is first raised to R
+ *	  - rapid to the XY location, then down to the R plane
+ *	  - G81 feeds to the Z depth, G82 also dwells for P seconds at the bottom
+ *	  - G83 feeds down Q at a time, rapids out to R after each peck and rapids back
+ *		in to just above the last depth (CANNED_PECK_CLEARANCE)
+ *	  - G73 feeds down Q at a time, backing off CANNED_PECK_CLEARANCE to break the chip
+ *	  - rapid out to the starting Z (G98) or to the R plane (G99)
+ *
+ *	R, Z, Q and P are sticky while a cycle is active, so a hole pattern can follow as
+ *	X/Y blocks only. In incremental mode (G91) R is relative to the starting Z and Z is
+ *	relative to R. Only the XY plane is supported and the L repeat count is ignored.
+ */
+
+enum cmCannedStep {					// steps of the drilling sequence
+	CANNED_STEP_RAISE = 0,			// raise Z to the R plane if it starts below it
+	CANNED_STEP_XY,					// rapid to the hole
+	CANNED_STEP_TO_R_PLANE,			// rapid down to the R plane
+	CANNED_STEP_FEED,				// feed to the next peck depth or to the bottom
+	CANNED_STEP_PECK_RETRACT,		// G83 rapid out to R, G73 back off to break the chip
+	CANNED_STEP_PECK_RETURN,		// G83 rapid back in to just above the last depth
+	CANNED_STEP_DWELL,				// G82 dwell at the bottom
+	CANNED_STEP_RETRACT				// rapid out to the retract height
+};
+
+typedef struct cmCannedCycle {		// drilling cycle state
+	uint8_t run_state;				// MOVE_OFF or MOVE_RUN
+	uint8_t step;					// next step in the sequence (cmCannedStep)
+	uint8_t motion_mode;			// cycle being run
+
+	uint8_t r_set;					// sticky words have been given since the cycle became active
+	uint8_t z_set;
+	uint8_t q_set;
+	float r_word;					// sticky words in program units
+	float z_word;
+	float q_word;
+	float p_word;
+
+	float hole[2];					// XY of the hole (machine coordinates)
+	float clear_z;					// Z to retract to when the hole is done
+	float r_z;						// R plane
+	float bottom_z;					// bottom of the hole
+	float depth;					// deepest Z reached so far
+	float peck;						// peck increment in mm (0 to drill in one pass)
+	GCodeState_t gm;				// gcode state for the moves - target is the last move queued
+} cmCannedCycle_t;
+
+static cmCannedCycle_t canned;
+
+static void _canned_move(uint8_t motion_mode, float z)
+{
+	canned.gm.motion_mode = motion_mode;
+	canned.gm.target[AXIS_Z] = z;
+	mp_aline(&canned.gm);
+}
+
+stat_t cm_canned_cycle(float target[], float flags[], uint8_t motion_mode)
+{
+	if (cm.gm.motion_mode < MOTION_MODE_CANNED_CYCLE_81) {	// starting a new cycle - drop old sticky words
+		canned.r_set = false;
+		canned.z_set = false;
+		canned.q_set = false;
+		canned.p_word = 0;
+	}
+	cm.gm.motion_mode = motion_mode;
+
+	if (fp_TRUE(cm.gf.arc_radius)) { canned.r_word = cm.gn.arc_radius; canned.r_set = true; }
+	if (fp_TRUE(flags[AXIS_Z]))    { canned.z_word = target[AXIS_Z]; canned.z_set = true; }
+	if (fp_TRUE(cm.gf.peck_depth)) { canned.q_word = cm.gn.peck_depth; canned.q_set = true; }
+	if (fp_TRUE(cm.gf.parameter))  { canned.p_word = cm.gn.parameter; }
+
+	if (fp_FALSE(flags[AXIS_X]) && fp_FALSE(flags[AXIS_Y]) && fp_FALSE(flags[AXIS_Z])) {
+		return (STAT_OK);									// no axis words - no hole
+	}
+	if (fp_TRUE(flags[AXIS_A]) || fp_TRUE(flags[AXIS_B]) || fp_TRUE(flags[AXIS_C])) {
+		return (STAT_GCODE_ROTARY_AXIS_CANNOT_BE_USED);
+	}
+	if (cm.gm.select_plane != CANON_PLANE_XY) return (STAT_GCODE_ACTIVE_PLANE_IS_INVALID);
+	if (cm.gm.feed_rate_mode == INVERSE_TIME_MODE) return (STAT_GCODE_INVERSE_TIME_MODE_CANNOT_BE_USED);
+	if (fp_ZERO(cm.gm.feed_rate)) return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	if (canned.r_set == false) return (STAT_R_WORD_IS_MISSING);
+	if (canned.z_set == false) return (STAT_GCODE_AXIS_IS_MISSING);
+	canned.peck = 0;
+	if ((motion_mode == MOTION_MODE_CANNED_CYCLE_83) || (motion_mode == MOTION_MODE_CANNED_CYCLE_73)) {
+		if (canned.q_set == false) return (STAT_Q_WORD_IS_MISSING);
+		if (canned.q_word <= 0) return (STAT_Q_WORD_IS_INVALID);
+		canned.peck = _to_millimeters(canned.q_word);
+	}
+	if ((motion_mode == MOTION_MODE_CANNED_CYCLE_82) && (canned.p_word < 0)) return (STAT_P_WORD_IS_NEGATIVE);
+
+	// work out the heights for this hole (machine coordinates)
+	float start_z = cm.gmx.position[AXIS_Z];
+	if (cm.gm.distance_mode == ABSOLUTE_MODE) {
+		float offset = cm_get_active_coord_offset(AXIS_Z);
+		canned.r_z = offset + _to_millimeters(canned.r_word);
+		canned.bottom_z = offset + _to_millimeters(canned.z_word);
+	} else {
+		canned.r_z = start_z + _to_millimeters(canned.r_word);
+		canned.bottom_z = canned.r_z + _to_millimeters(canned.z_word);
+	}
+	if (canned.bottom_z > canned.r_z) return (STAT_R_WORD_IS_INVALID);	// R must not be below the hole
+	canned.clear_z = canned.r_z;
+	if ((cm.gmx.retract_mode == RETRACT_TO_INITIAL_LEVEL) && (start_z > canned.r_z)) {
+		canned.clear_z = start_z;
+	}
+
+	// the model moves to the hole at the retract height; test the hole bottom as well
+	float xy_flags[] = { flags[AXIS_X], flags[AXIS_Y], 0,0,0,0 };
+	cm_set_model_target(target, xy_flags);
+	cm.gm.target[AXIS_Z] = canned.bottom_z;
+	stat_t status = cm_test_soft_limits(cm.gm.target);
+	cm.gm.target[AXIS_Z] = canned.clear_z;
+	if (status == STAT_OK) status = cm_test_soft_limits(cm.gm.target);
+	if (status != STAT_OK) return (cm_soft_alarm(status));
+
+	// hand the moves to the callback
+	cm_set_work_offsets(&cm.gm);
+	memcpy(&canned.gm, &cm.gm, sizeof(GCodeState_t));
+	copy_vector(canned.gm.target, cm.gmx.position);			// moves start where the model is now
+	canned.hole[0] = cm.gm.target[AXIS_X];
+	canned.hole[1] = cm.gm.target[AXIS_Y];
+	canned.depth = canned.r_z;
+	canned.motion_mode = motion_mode;
+	canned.step = CANNED_STEP_RAISE;
+	canned.run_state = MOVE_RUN;
+
+	cm_cycle_start();
+	cm_finalize_move();
+	return (STAT_OK);
+}
+
+stat_t cm_canned_cycle_callback()
+{
+	if (canned.run_state == MOVE_OFF)
+		return (STAT_NOOP);
+
+	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM)
+		return (STAT_EAGAIN);
+
+	switch (canned.step) {
+		case CANNED_STEP_RAISE: {
+			if (canned.gm.target[AXIS_Z] < canned.r_z) {
+				_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, canned.r_z);
+			}
+			canned.step = CANNED_STEP_XY;
+			break;
+		}
+		case CANNED_STEP_XY: {
+			canned.gm.target[AXIS_X] = canned.hole[0];
+			canned.gm.target[AXIS_Y] = canned.hole[1];
+			_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, canned.gm.target[AXIS_Z]);
+			canned.step = CANNED_STEP_TO_R_PLANE;
+			break;
+		}
+		case CANNED_STEP_TO_R_PLANE: {
+			_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, canned.r_z);
+			canned.step = CANNED_STEP_FEED;
+			break;
+		}
+		case CANNED_STEP_FEED: {
+			canned.depth -= canned.peck;
+			if ((fp_ZERO(canned.peck)) || (canned.depth < canned.bottom_z)) {
+				canned.depth = canned.bottom_z;
+			}
+			_canned_move(MOTION_MODE_STRAIGHT_FEED, canned.depth);
+			if (canned.depth > canned.bottom_z) {
+				canned.step = CANNED_STEP_PECK_RETRACT;
+			} else if (canned.motion_mode == MOTION_MODE_CANNED_CYCLE_82) {
+				canned.step = CANNED_STEP_DWELL;
+			} else {
+				canned.step = CANNED_STEP_RETRACT;
+			}
+			break;
+		}
+		case CANNED_STEP_PECK_RETRACT: {
+			if (canned.motion_mode == MOTION_MODE_CANNED_CYCLE_83) {
+				_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, canned.r_z);
+				canned.step = CANNED_STEP_PECK_RETURN;
+			} else {
+				_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, min(canned.depth + CANNED_PECK_CLEARANCE, canned.r_z));
+				canned.step = CANNED_STEP_FEED;
+			}
+			break;
+		}
+		case CANNED_STEP_PECK_RETURN: {
+			_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, min(canned.depth + CANNED_PECK_CLEARANCE, canned.r_z));
+			canned.step = CANNED_STEP_FEED;
+			break;
+		}
+		case CANNED_STEP_DWELL: {
+			mp_dwell(canned.p_word);
+			canned.step = CANNED_STEP_RETRACT;
+			break;
+		}
+		case CANNED_STEP_RETRACT: {
+			_canned_move(MOTION_MODE_STRAIGHT_TRAVERSE, canned.clear_z);
+			canned.run_state = MOVE_OFF;
+			return (STAT_OK);
+		}
+	}
+	return (STAT_EAGAIN);
+}
+
+void cm_abort_canned_cycle()
+{
+	canned.run_state = MOVE_OFF;
+}
+
 /*****************************
  * Spindle Functions (4.3.7) *
  *****************************/
@@ -1027,11 +1792,13 @@ stat_t cm_straight_feed(float target[], float flags[])
  * cm_change_tool()		- M6 (This might become a complete tool change cycle)
  * _exec_change_tool()	- execution callback
  *
- * Note: These functions don't actually do anything for now, and there's a bug
- *		 where T and M in different blocks don;t work correctly
+ * Note: These functions don't move anything. The model keeps its own copy of the
+ *		 T word and the loaded tool in gmx so M6 picks up a T from an earlier block
+ *		 (or the same one) before the runtime has seen it, and so G43 can follow M6.
  */
 stat_t cm_select_tool(uint8_t tool_select)
 {
+	cm.gmx.tool_select = tool_select;
 	float value[AXES] = { (float)tool_select,0,0,0,0,0 };
 	mp_queue_command(_exec_select_tool, value, value);
 	return (STAT_OK);
@@ -1044,8 +1811,12 @@ static void _exec_select_tool(float *value, float *flag)
 
 stat_t cm_change_tool(uint8_t tool_change)
 {
-	float value[AXES] = { (float)cm.gm.tool_select,0,0,0,0,0 };
+	cm.gmx.tool = cm.gmx.tool_select;
+	float value[AXES] = { (float)cm.gmx.tool,0,0,0,0,0 };
 	mp_queue_command(_exec_change_tool, value, value);
+	if ((cm.gmx.tool_length_enable == true) && (cm.gmx.tool_length_follow == true)) {
+		_apply_tool_length(cm.gmx.tool);				// G43 is in effect - take the new tool's length
+	}
 	return (STAT_OK);
 }
 
@@ -1054,6 +1825,68 @@ static void _exec_change_tool(float *value, float *flag)
 	cm.gm.tool = (uint8_t)value[0];
 }
 
+/*
+ * cm_set_tool_length_offset() - G43 [Hn], G49
+ * cm_set_tool_table()		   - G10 L1 Pn [Z] [R]
+ * _apply_tool_length()		   - take the length offset from a tool table entry
+ *
+ *	The tool table holds a length and a diameter for tools 1 to TOOLS. It is persisted
+ *	like the coordinate offsets ($tt1l, $tt1d...) and written back after a G10 L1 once
+ *	the machining cycle is over (see cm_deferred_write_callback()).
+ *
+ *	G43 Hn applies the length of table entry n to the Z axis. G43 without H uses the
+ *	tool loaded by M6, and keeps following it through later tool changes. G49 cancels.
+ *	The length is folded into the cached work offsets (cm_get_active_coord_offset()) and
+ *	passed to the runtime by _exec_offset(), the same way as G92, so a tool change is a
+ *	table lookup and an offset update. Tools outside the table have no length offset.
+ */
+static void _apply_tool_length(uint8_t tool)
+{
+	cm.gmx.tool_length_tool = tool;
+	cm.gmx.tool_length_offset = (tool <= TOOLS) ? cm.tool_length[tool] : 0;
+	cm_invalidate_coord_offsets();
+	float value[AXES] = { (float)cm.gm.coord_system,cm.gmx.tool_length_offset,0,0,0,0 };
+	mp_queue_command(_exec_offset, value, value);
+}
+
+stat_t cm_set_tool_length_offset(uint8_t enable, uint8_t tool, uint8_t tool_flag)
+{
+	if (enable == false) {								// G49
+		cm.gmx.tool_length_enable = false;
+		cm.gmx.tool_length_follow = false;
+		_apply_tool_length(0);
+		return (STAT_OK);
+	}
+	if (tool_flag == false) {							// G43 - use the loaded tool
+		tool = cm.gmx.tool;
+	} else if (tool > TOOLS) {							// G43 Hn
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	cm.gmx.tool_length_enable = true;
+	cm.gmx.tool_length_follow = !tool_flag;
+	_apply_tool_length(tool);
+	return (STAT_OK);
+}
+
+stat_t cm_set_tool_table(uint8_t tool, float offset[], float flag[], float radius, float radius_flag)
+{
+	if ((tool < 1) || (tool > TOOLS)) {
+		return (STAT_P_WORD_IS_NOT_VALID_TOOL_NUMBER);
+	}
+	if (fp_TRUE(flag[AXIS_Z])) {
+		cm.tool_length[tool] = _to_millimeters(offset[AXIS_Z]);
+	}
+	if (fp_TRUE(radius_flag)) {
+		cm.tool_diameter[tool] = _to_millimeters(radius) * 2;
+	}
+	cm.tool_dirty |= (1<<tool);
+	cm.deferred_write_flag = true;						// stage the entry for persistence
+	if ((cm.gmx.tool_length_enable == true) && (cm.gmx.tool_length_tool == tool)) {
+		_apply_tool_length(tool);						// the entry in effect was changed
+	}
+	return (STAT_OK);
+}
+
 /***********************************
  * Miscellaneous Functions (4.3.9) *
  ***********************************/
@@ -1065,7 +1898,7 @@ static void _exec_change_tool(float *value, float *flag)
 stat_t cm_mist_coolant_control(uint8_t mist_coolant)
 {
 	float value[AXES] = { (float)mist_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_mist_coolant_control, value, value);
+	mp_queue_segment_command(_exec_mist_coolant_control, value, value);
 	return (STAT_OK);
 }
 static void _exec_mist_coolant_control(float *value, float *flag)
@@ -1088,7 +1921,7 @@ static void _exec_mist_coolant_control(float *value, float *flag)
 stat_t cm_flood_coolant_control(uint8_t flood_coolant)
 {
 	float value[AXES] = { (float)flood_coolant,0,0,0,0,0 };
-	mp_queue_command(_exec_flood_coolant_control, value, value);
+	mp_queue_segment_command(_exec_flood_coolant_control, value, value);
 	return (STAT_OK);
 }
 static void _exec_flood_coolant_control(float *value, float *flag)
@@ -1116,6 +1949,37 @@ static void _exec_flood_coolant_control(float *value, float *flag)
 #endif // __ARM
 }
 
+/*
+ * cm_sync_output() - M62, M63 - switch an output as the next move starts
+ *
+ *	The output is not queued as a command, so motion does not stop for it. It waits here
+ *	until the next line or arc is queued, rides in that move's planner buffer and is
+ *	switched by the loader as the first segment of the move starts (see _load_move()).
+ *	The timing is good to a segment time, with no deceleration - e.g. dispensers and
+ *	vacuum valves along a path. Outputs 0 - 3 (P) are the gpio1 bits, which are also the
+ *	spindle and coolant outputs on stock boards. Outputs set by several M62s and M63s
+ *	before a move are switched together; the last one for an output wins.
+ *
+ *	Outputs are dropped while a job resume is fast forwarding, as commands are.
+ */
+
+stat_t cm_sync_output(uint8_t state, float output)
+{
+	if ((output < 0) || (output >= SYNC_OUTPUTS)) return (STAT_INPUT_VALUE_RANGE_ERROR);
+	if (fp_NE(output, trunc(output))) return (STAT_P_WORD_IS_NOT_AN_INTEGER);
+	if (cm.ff_line != 0) return (STAT_OK);
+
+	uint8_t bit = 0x08 >> (uint8_t)output;		// same bit order as gpio_led_on()
+	if (state == true) {
+		cm.outputs_on |= bit;
+		cm.outputs_off &= ~bit;
+	} else {
+		cm.outputs_off |= bit;
+		cm.outputs_on &= ~bit;
+	}
+	return (STAT_OK);
+}
+
 /*
  * cm_override_enables() - M48, M49
  * cm_feed_rate_override_enable() - M50
@@ -1127,6 +1991,10 @@ static void _exec_flood_coolant_control(float *value, float *flag)
  *
  *	Override enables are kind of a mess in Gcode. This is an attempt to sort them out.
  *	See http://www.linuxcnc.org/docs/2.4/html/gcode_main.html#sec:M50:-Feed-Override
+ *
+ *	Feed and traverse overrides are passed to the runtime, which applies them to the move that
+ *	is running (see mp_feed_rate_override()). They take effect as soon as the block is parsed.
+ *	The spindle override is applied to the running spindle's PWM (cm_update_spindle_override()).
  */
 
 stat_t cm_override_enables(uint8_t flag)			// M48, M49
@@ -1134,6 +2002,9 @@ stat_t cm_override_enables(uint8_t flag)			// M48, M49
 	cm.gmx.feed_rate_override_enable = flag;
 	cm.gmx.traverse_override_enable = flag;
 	cm.gmx.spindle_override_enable = flag;
+	mp_feed_rate_override(flag, cm.gmx.feed_rate_override_factor);
+	mp_traverse_override(flag, cm.gmx.traverse_override_factor);
+	cm_update_spindle_override();
 	return (STAT_OK);
 }
 
@@ -1144,14 +2015,14 @@ stat_t cm_feed_rate_override_enable(uint8_t flag)	// M50
 	} else {
 		cm.gmx.feed_rate_override_enable = true;
 	}
-	return (STAT_OK);
+	return (mp_feed_rate_override(cm.gmx.feed_rate_override_enable, cm.gmx.feed_rate_override_factor));
 }
 
 stat_t cm_feed_rate_override_factor(uint8_t flag)	// M50.1
 {
+	ritorno(mp_feed_rate_override(flag, cm.gn.parameter));	// validates the factor
 	cm.gmx.feed_rate_override_enable = flag;
 	cm.gmx.feed_rate_override_factor = cm.gn.parameter;
-//	mp_feed_rate_override(flag, cm.gn.parameter);	// replan the queue for new feed rate
 	return (STAT_OK);
 }
 
@@ -1162,14 +2033,14 @@ stat_t cm_traverse_override_enable(uint8_t flag)	// M50.2
 	} else {
 		cm.gmx.traverse_override_enable = true;
 	}
-	return (STAT_OK);
+	return (mp_traverse_override(cm.gmx.traverse_override_enable, cm.gmx.traverse_override_factor));
 }
 
 stat_t cm_traverse_override_factor(uint8_t flag)	// M51
 {
+	ritorno(mp_traverse_override(flag, cm.gn.parameter));	// validates the factor
 	cm.gmx.traverse_override_enable = flag;
 	cm.gmx.traverse_override_factor = cm.gn.parameter;
-//	mp_feed_rate_override(flag, cm.gn.parameter);	// replan the queue for new feed rate
 	return (STAT_OK);
 }
 
@@ -1180,6 +2051,7 @@ stat_t cm_spindle_override_enable(uint8_t flag)		// M51.1
 	} else {
 		cm.gmx.spindle_override_enable = true;
 	}
+	cm_update_spindle_override();
 	return (STAT_OK);
 }
 
@@ -1187,7 +2059,7 @@ stat_t cm_spindle_override_factor(uint8_t flag)		// M50.1
 {
 	cm.gmx.spindle_override_enable = flag;
 	cm.gmx.spindle_override_factor = cm.gn.parameter;
-//	change spindle speed
+	cm_update_spindle_override();
 	return (STAT_OK);
 }
 
@@ -1256,12 +2128,15 @@ void cm_message(char_t *message)
  *		should start to run anything in the planner queue
  */
 
-void cm_request_feedhold(void) { cm.feedhold_requested = true; }
-void cm_request_queue_flush(void) { cm.queue_flush_requested = true; }
-void cm_request_cycle_start(void) { cm.cycle_start_requested = true; }
+void cm_request_feedhold(void) { cm.feedhold_requested = true; controller_publish(TOPIC_STATE); }
+void cm_request_queue_flush(void) { cm.queue_flush_requested = true; controller_publish(TOPIC_STATE); }
+void cm_request_cycle_start(void) { cm.cycle_start_requested = true; controller_publish(TOPIC_STATE); }
 
 stat_t cm_feedhold_sequencing_callback()
 {
+	if (controller_take_events(SUB_FEEDHOLD) == 0) {
+		return (STAT_OK);					// no request and no state change since the last look
+	}
 	if (cm.feedhold_requested == true) {
 		if ((cm.motion_state == MOTION_RUN) && (cm.hold_state == FEEDHOLD_OFF)) {
 			cm_set_motion_state(MOTION_HOLD);
@@ -1290,6 +2165,91 @@ stat_t cm_feedhold_sequencing_callback()
 	return (STAT_OK);
 }
 
+/*
+ * cm_request_override() - queue a realtime override char (called from the RX interrupts)
+ * cm_override_callback() - apply the queued override chars to the runtime
+ * _step_override() - add a step to an override factor and clamp it to the limits
+ *
+ *	The override chars only change the factors; the runtime ramps the feed and traverse
+ *	factors in over the next segments (see mp_feed_rate_override()), and the spindle PWM
+ *	is updated at once. A char sets its override enable, so it also works after an M49.
+ *	Each char is a single step, so the chars are queued rather than flagged - a host that
+ *	sends +10% five times in a row gets +50%. Chars that arrive with the queue full are
+ *	dropped.
+ */
+
+void cm_request_override(char_t c)
+{
+	uint8_t next = (cm.override_head + 1) & (OVERRIDE_QUEUE_SIZE-1);
+	if (next == cm.override_tail) return;
+	cm.override_queue[cm.override_head] = (uint8_t)c;
+	cm.override_head = next;
+}
+
+static float _step_override(uint8_t enable, float factor, float step, float min, float max)
+{
+	if (enable == false) factor = 1.0;		// a disabled override is running at 100%
+	factor += step;
+	if (factor < min) return (min);
+	if (factor > max) return (max);
+	return (factor);
+}
+
+stat_t cm_override_callback()
+{
+	if (cm.override_tail == cm.override_head) return (STAT_NOOP);
+
+	while (cm.override_tail != cm.override_head) {
+		char_t c = (char_t)cm.override_queue[cm.override_tail];
+		cm.override_tail = (cm.override_tail + 1) & (OVERRIDE_QUEUE_SIZE-1);
+
+		float factor;
+		switch (c) {
+			case CHAR_FEED_OVERRIDE_RESET:
+			case CHAR_FEED_OVERRIDE_PLUS:
+			case CHAR_FEED_OVERRIDE_MINUS: {
+				if (c == CHAR_FEED_OVERRIDE_RESET) {
+					factor = 1.0;
+				} else {
+					factor = _step_override(cm.gmx.feed_rate_override_enable, cm.gmx.feed_rate_override_factor,
+						(c == CHAR_FEED_OVERRIDE_PLUS) ? OVERRIDE_STEP : -OVERRIDE_STEP,
+						FEED_OVERRIDE_MIN, FEED_OVERRIDE_MAX);
+				}
+				cm.gmx.feed_rate_override_enable = true;
+				cm.gmx.feed_rate_override_factor = factor;
+				mp_feed_rate_override(true, factor);
+				break;
+			}
+			case CHAR_RAPID_OVERRIDE_RESET:
+			case CHAR_RAPID_OVERRIDE_MEDIUM:
+			case CHAR_RAPID_OVERRIDE_LOW: {
+				if (c == CHAR_RAPID_OVERRIDE_RESET) { factor = 1.0; } else
+				if (c == CHAR_RAPID_OVERRIDE_MEDIUM) { factor = 0.50; } else { factor = 0.25; }
+				cm.gmx.traverse_override_enable = true;
+				cm.gmx.traverse_override_factor = factor;
+				mp_traverse_override(true, factor);
+				break;
+			}
+			case CHAR_SPINDLE_OVERRIDE_RESET:
+			case CHAR_SPINDLE_OVERRIDE_PLUS:
+			case CHAR_SPINDLE_OVERRIDE_MINUS: {
+				if (c == CHAR_SPINDLE_OVERRIDE_RESET) {
+					factor = 1.0;
+				} else {
+					factor = _step_override(cm.gmx.spindle_override_enable, cm.gmx.spindle_override_factor,
+						(c == CHAR_SPINDLE_OVERRIDE_PLUS) ? OVERRIDE_STEP : -OVERRIDE_STEP,
+						SPINDLE_OVERRIDE_MIN, SPINDLE_OVERRIDE_MAX);
+				}
+				cm.gmx.spindle_override_enable = true;
+				cm.gmx.spindle_override_factor = factor;
+				cm_update_spindle_override();
+				break;
+			}
+		}
+	}
+	return (STAT_OK);
+}
+
 stat_t cm_queue_flush()
 {
 	if (cm_get_runtime_busy() == true)
@@ -1299,14 +2259,14 @@ stat_t cm_queue_flush()
 	xio_reset_usb_rx_buffers();				// flush serial queues
 #endif
 	mp_flush_planner();						// flush planner queue
+	cm.outputs_on = cm.outputs_off = 0;		// ...and the outputs waiting for a move
+	gc_abort_replay();						// stop any subroutine or loop being run
+	gc_flush_read_ahead();					// ...drop the blocks read ahead of the planner
+	cm_abort_probe_grid();					// ...and any G29 grid
 	qr_request_queue_report(0);				// request a queue report, since we've changed the number of buffers available
 	rx_request_rx_report();
 
-	// Note: The following uses low-level mp calls for absolute position.
-	//		 It could also use cm_get_absolute_position(RUNTIME, axis);
-	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
-		cm_set_position(axis, mp_get_runtime_absolute_position(axis)); // set mm from mr
-	}
+	cm_set_position_to_runtime();			// set mm from mr
 	float value[AXES] = { (float)MACHINE_PROGRAM_STOP, 0,0,0,0,0 };
 	_exec_program_finalize(value, value);	// finalize now, not later
 	return (STAT_OK);
@@ -1364,14 +2324,20 @@ static void _exec_program_finalize(float *value, float *flag)
 		cm_reset_origin_offsets();						// G92.1 - we do G91.1 instead of G92.2
 	//	cm_suspend_origin_offsets();					// G92.2 - as per Kramer
 		cm_set_coord_system(cm.coord_system);			// reset to default coordinate system
+		cm_cancel_rotation();							// G69
+		cm_cancel_scaling();							// G50
 		cm_select_plane(cm.select_plane);				// reset to default arc plane
+		cm_set_cutter_comp(CUTTER_COMP_OFF, 0, false);	// G40
 		cm_set_distance_mode(cm.distance_mode);
 //++++	cm_set_units_mode(cm.units_mode);				// reset to default units mode +++ REMOVED +++
-		cm_spindle_control(SPINDLE_OFF);				// M5
+		cm_set_preset(0);								// G187
+		cm_spindle_stop();								// M5, on PWM_2 as well
 		cm_flood_coolant_control(false);				// M9
 		cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);	// G94
 	//	cm_set_motion_mode(MOTION_MODE_STRAIGHT_FEED);	// NIST specifies G1, but we cancel motion mode. Safer.
 		cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
+		jp_request_job_profile();						// report the job profile (if enabled)
+		bm_request_report();							// report the cycle time benchmark (if armed)
 	}
 	sr_request_status_report(SR_IMMEDIATE_REQUEST);		// request a final status report (not unfiltered)
 }
@@ -1407,10 +2373,75 @@ void cm_optional_program_stop()
 
 void cm_program_end()
 {
+	mp_end_dry_run();										// $dry - the job is all planned
 	float value[AXES] = { (float)MACHINE_PROGRAM_END, 0,0,0,0,0 };
 	mp_queue_command(_exec_program_finalize, value, value);
 }
 
+/*
+ * cm_fast_forward_resume() - end a fast forward ($ff) and move to where the job resumes
+ *
+ *	Called by the Gcode parser on reaching the $ff line. The skipped blocks have left the
+ *	model at the resume point with its offsets, tool, spindle and coolant, but none of it
+ *	got to the runtime. Queue the offsets and tool, lift Z to the higher of where it is and
+ *	the resume height, traverse to the resume point, start the spindle and coolant, then
+ *	feed Z down. The moves are in machine coordinates so no offset or G68/G51 applies twice.
+ */
+stat_t cm_fast_forward_resume()
+{
+	float resume[AXES], target[AXES], flags[AXES];
+	uint8_t units_mode = cm.gm.units_mode;
+	uint8_t distance_mode = cm.gm.distance_mode;
+	uint8_t motion_mode = cm.gm.motion_mode;
+	stat_t status;
+
+	cm.ff_line = 0;											// commands queue again from here
+	copy_vector(resume, cm.gmx.position);
+	cm_set_coord_system(cm.gm.coord_system);				// queues the offsets and tool length
+	float value[AXES] = { (float)cm.gmx.tool_select,0,0,0,0,0 };
+	mp_queue_command(_exec_select_tool, value, value);
+	value[0] = (float)cm.gmx.tool;
+	mp_queue_command(_exec_change_tool, value, value);
+
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {		// the model starts where the machine is
+		cm.gmx.position[axis] = mp_get_runtime_absolute_position(axis);
+		cm.gm.target[axis] = cm.gmx.position[axis];
+		target[axis] = resume[axis];
+		flags[axis] = (cm.a[axis].axis_mode == AXIS_DISABLED) ? 0 : 1;
+		if (cm.a[axis].axis_mode == AXIS_RADIUS) {
+			target[axis] /= cm.a[axis].radius_scale;		// _calc_ABC() takes radius axes in mm
+		}
+	}
+	cm.gm.units_mode = MILLIMETERS;
+	cm.gm.distance_mode = ABSOLUTE_MODE;
+	cm_set_absolute_override(MODEL, true);
+
+	float z_flags[AXES] = { 0,0,1,0,0,0 };
+	float z_target[AXES] = { 0,0, max(cm.gmx.position[AXIS_Z], resume[AXIS_Z]), 0,0,0 };
+	status = cm_straight_traverse(z_target, z_flags);		// up to a safe height
+	flags[AXIS_Z] = 0;
+	if (status == STAT_OK) {
+		status = cm_straight_traverse(target, flags);		// over the resume point
+	}
+	if (status == STAT_OK) {
+		cm_set_spindle_speed(cm.ff_spindle_speed);
+		cm_spindle_control(cm.ff_spindle_mode);
+		cm_mist_coolant_control(cm.ff_mist_coolant);
+		cm_flood_coolant_control(cm.ff_flood_coolant);
+		z_target[AXIS_Z] = resume[AXIS_Z];
+		if ((cm.gm.feed_rate_mode == INVERSE_TIME_MODE) || (fp_ZERO(cm.gm.feed_rate))) {
+			status = cm_straight_traverse(z_target, z_flags);
+		} else {
+			status = cm_straight_feed(z_target, z_flags);	// down to the resume height at F
+		}
+	}
+	cm_set_absolute_override(MODEL, false);
+	cm.gm.units_mode = units_mode;
+	cm.gm.distance_mode = distance_mode;
+	cm.gm.motion_mode = motion_mode;
+	return (status);
+}
+
 /**************************************
  * END OF CANONICAL MACHINE FUNCTIONS *
  **************************************/
@@ -1436,7 +2467,8 @@ static const char msg_am00[] PROGMEM = "[disabled]";
 static const char msg_am01[] PROGMEM = "[standard]";
 static const char msg_am02[] PROGMEM = "[inhibited]";
 static const char msg_am03[] PROGMEM = "[radius]";
-static const char *const msg_am[] PROGMEM = { msg_am00, msg_am01, msg_am02, msg_am03};
+static const char msg_am04[] PROGMEM = "[wrapped]";
+static const char *const msg_am[] PROGMEM = { msg_am00, msg_am01, msg_am02, msg_am03, msg_am04};
 
 static const char msg_g20[] PROGMEM = "G20 - inches mode";
 static const char msg_g21[] PROGMEM = "G21 - millimeter mode";
@@ -1473,7 +2505,8 @@ static const char msg_cycs1[] PROGMEM = "Machining";
 static const char msg_cycs2[] PROGMEM = "Probe";
 static const char msg_cycs3[] PROGMEM = "Homing";
 static const char msg_cycs4[] PROGMEM = "Jog";
-static const char *const msg_cycs[] PROGMEM = { msg_cycs0, msg_cycs1, msg_cycs2, msg_cycs3,  msg_cycs4 };
+static const char msg_cycs5[] PROGMEM = "Tune";
+static const char *const msg_cycs[] PROGMEM = { msg_cycs0, msg_cycs1, msg_cycs2, msg_cycs3,  msg_cycs4, msg_cycs5 };
 
 static const char msg_mots0[] PROGMEM = "Stop";
 static const char msg_mots1[] PROGMEM = "Run";
@@ -1508,7 +2541,25 @@ static const char msg_g01[] PROGMEM = "G1  - linear feed";
 static const char msg_g02[] PROGMEM = "G2  - clockwise arc feed";
 static const char msg_g03[] PROGMEM = "G3  - counter clockwise arc feed";
 static const char msg_g80[] PROGMEM = "G80 - cancel motion mode (none active)";
-static const char *const msg_momo[] PROGMEM = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80 };
+static const char msg_g38[] PROGMEM = "G38.2 - straight probe";
+static const char msg_g81[] PROGMEM = "G81 - drilling cycle";
+static const char msg_g82[] PROGMEM = "G82 - drilling cycle with dwell";
+static const char msg_g83[] PROGMEM = "G83 - peck drilling cycle";
+static const char msg_g84[] PROGMEM = "G84 - right hand tapping cycle";
+static const char msg_g85[] PROGMEM = "G85 - boring cycle, feed out";
+static const char msg_g86[] PROGMEM = "G86 - boring cycle, spindle stop, rapid out";
+static const char msg_g87[] PROGMEM = "G87 - back boring cycle";
+static const char msg_g88[] PROGMEM = "G88 - boring cycle, spindle stop, manual out";
+static const char msg_g89[] PROGMEM = "G89 - boring cycle, dwell, feed out";
+static const char msg_g73[] PROGMEM = "G73 - chip break drilling cycle";
+static const char msg_g05[] PROGMEM = "G5 - cubic spline feed";
+static const char msg_g5a[] PROGMEM = "G5.1 - quadratic spline feed";
+static const char msg_g33[] PROGMEM = "G33 - spindle synchronized motion";
+static const char msg_g33a[] PROGMEM = "G33.1 - rigid tapping";
+static const char *const msg_momo[] PROGMEM = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80, msg_g38,
+												msg_g81, msg_g82, msg_g83, msg_g84, msg_g85, msg_g86,
+												msg_g87, msg_g88, msg_g89, msg_g73, msg_g05, msg_g5a,
+												msg_g33, msg_g33a };
 
 static const char msg_g17[] PROGMEM = "G17 - XY plane";
 static const char msg_g18[] PROGMEM = "G18 - XZ plane";
@@ -1711,6 +2762,11 @@ stat_t cm_get_ofs(nvObj_t *nv)
  *
  * cm_get_am()	- get axis mode w/enumeration string
  * cm_set_am()	- set axis mode w/exception handling for axis type
+ * cm_set_ra()	- set rotary axis radius and cache the degrees per mm it gives
+ * cm_set_tl()	- set travel min or max and update the soft limit box
+ * cm_set_cofs()	- set a coordinate system offset ($g54x...) and drop the cached offsets
+ * cm_set_tt()		- set a tool table entry ($tt1l...) and update the tool length in effect
+ * cm_set_sl()	- set soft limit enable and update the soft limit box
  * cm_set_sw()	- run this any time you change a switch setting
  */
 
@@ -1728,15 +2784,98 @@ stat_t cm_set_am(nvObj_t *nv)		// axis mode
 		if (nv->value > AXIS_MODE_MAX_ROTARY) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
 	}
 	set_ui8(nv);
+	config_mark_derived(DERIVED_MOTOR_MAP);	// inhibited axes are resolved in the kinematics table
+	return(STAT_OK);
+}
+
+stat_t cm_set_ra(nvObj_t *nv)		// rotary axis radius
+{
+	if (nv->value < EPSILON) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	set_flt(nv);
+	uint8_t axis = _get_axis(nv->index);
+	cm.a[axis].radius_scale = 360 / (2 * M_PI * cm.a[axis].radius);
+	return(STAT_OK);
+}
+
+stat_t cm_set_tl(nvObj_t *nv)		// travel min or max - rotary axes are in degrees
+{
+	if (_get_axis_type(nv->index) == 0) {
+		set_flu(nv);
+	} else {
+		set_flt(nv);
+	}
+	cm_update_soft_limits();
+	return(STAT_OK);
+}
+
+stat_t cm_set_cofs(nvObj_t *nv)		// coordinate system offset
+{
+	set_flu(nv);
+	cm_invalidate_coord_offsets();
+	return(STAT_OK);
+}
+
+stat_t cm_set_tt(nvObj_t *nv)		// tool table length or diameter
+{
+	set_flu(nv);
+	if (cm.gmx.tool_length_enable == true) {
+		_apply_tool_length(cm.gmx.tool_length_tool);	// in case it was the entry in effect
+	}
+	return(STAT_OK);
+}
+
+stat_t cm_set_ff(nvObj_t *nv)		// job resume line
+{
+	if (cm.machine_state == MACHINE_CYCLE) {
+		return (STAT_COMMAND_NOT_ACCEPTED);		// the model has to be where the machine is
+	}
+	set_int(nv);
+	cm.ff_linenum = 0;
+	cm.ff_spindle_mode = cm.gm.spindle_mode;
+	cm.ff_spindle_speed = cm.gm.spindle_speed;
+	cm.ff_mist_coolant = cm.gm.mist_coolant;
+	cm.ff_flood_coolant = cm.gm.flood_coolant;
+	return(STAT_OK);
+}
+
+stat_t cm_get_ckp(nvObj_t *nv)		// power loss checkpoint - sends it as a line of JSON
+{
+	cmCheckpoint_t ckp;
+	nv->value = 0;
+	nv->valuetype = TYPE_INTEGER;
+	if (persistence_read_checkpoint((int8_t *)&ckp) == false) {
+		printf_P(PSTR("{\"ckp\":{}}\n"));
+		return (STAT_OK);
+	}
+	printf_P(PSTR("{\"ckp\":{\"n\":%lu"), ckp.linenum);
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		printf_P(PSTR(",\"mpo%c\":%0.3f"), ("xyzabc")[axis], (double)ckp.position[axis]);
+	}
+	printf_P(PSTR(",\"coor\":%d,\"tool\":%d,\"unit\":%d,\"dist\":%d,\"plan\":%d,\"spm\":%d,\"mist\":%d,\"flood\":%d}}\n"),
+		ckp.coord_tool & 0x0F, ckp.coord_tool >> 4,
+		(ckp.modes & CHECKPOINT_MILLIMETERS) ? MILLIMETERS : INCHES,
+		(ckp.modes & CHECKPOINT_INCREMENTAL) ? INCREMENTAL_MODE : ABSOLUTE_MODE,
+		(ckp.modes & CHECKPOINT_PLANE) >> 2, (ckp.modes & CHECKPOINT_SPINDLE) >> 4,
+		(ckp.modes & CHECKPOINT_MIST) ? 1 : 0, (ckp.modes & CHECKPOINT_FLOOD) ? 1 : 0);
+	nv->value = (float)ckp.linenum;
+	return (STAT_OK);
+}
+
+stat_t cm_set_sl(nvObj_t *nv)		// soft limit enable
+{
+	set_ui8(nv);
+	cm_update_soft_limits();
 	return(STAT_OK);
 }
 
 /**** Jerk functions
  * cm_get_axis_jerk() - returns jerk for an axis
  * cm_set_axis_jerk() - sets the jerk for an axis, including recirpcal and cached values
+ * cm_update_axis_jerk() - recompute the cached reciprocals of all axes (config_update_derived())
  *
- * cm_set_xjm()		  - set jerk max value
+ * cm_set_xjm()		  - set jerk max value. The reciprocal is updated before the next move
  * cm_set_xjh()		  - set jerk halt value (used by homing and other stops)
+ * cm_set_xvm()		  - set velocity max value
  *
  *	Jerk values can be rather large, often in the billions. This makes for some pretty big
  *	numbers for people to deal with. Jerk values are stored in the system in truncated format;
@@ -1757,13 +2896,33 @@ void cm_set_axis_jerk(uint8_t axis, float jerk)
 {
 	cm.a[axis].jerk_max = jerk;
 	cm.a[axis].recip_jerk = 1/(jerk * JERK_MULTIPLIER);
+	mp_stage_live_config();
+}
+
+void cm_update_axis_jerk()
+{
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cm.a[axis].recip_jerk = 1/(cm.a[axis].jerk_max * JERK_MULTIPLIER);
+	}
 }
 
 stat_t cm_set_xjm(nvObj_t *nv)
 {
 	if (nv->value > JERK_MULTIPLIER) nv->value /= JERK_MULTIPLIER;
 	set_flu(nv);
-	cm_set_axis_jerk(_get_axis(nv->index), nv->value);
+	config_mark_derived(DERIVED_JERK);
+	mp_stage_live_config();				// jogs in progress take the new jerk on their next segment
+	return(STAT_OK);
+}
+
+stat_t cm_set_xvm(nvObj_t *nv)
+{
+	if (_get_axis_type(nv->index) == 0) {	// linear
+		set_flu(nv);
+	} else {
+		set_flt(nv);
+	}
+	mp_stage_live_config();
 	return(STAT_OK);
 }
 
@@ -1774,6 +2933,151 @@ stat_t cm_set_xjh(nvObj_t *nv)
 	return(STAT_OK);
 }
 
+/**** Junction functions
+ * cm_set_ja()		  - set junction acceleration
+ * cm_set_jd()		  - set axis junction deviation. Linear axes take G20/G21 units
+ * cm_update_junction_limits() - recompute the per-axis junction limits (config_update_derived())
+ *
+ *	The junction limit is the deviation times the junction acceleration, so the planner's
+ *	corner velocity takes one multiply less per junction (see _get_junction_vmax()).
+ */
+stat_t cm_set_ja(nvObj_t *nv)
+{
+	set_flu(nv);
+	config_mark_derived(DERIVED_JUNCTION);
+	return(STAT_OK);
+}
+
+stat_t cm_set_jd(nvObj_t *nv)
+{
+	if (_get_axis_type(nv->index) == 0) {	// linear
+		set_flu(nv);
+	} else {
+		set_flt(nv);
+	}
+	config_mark_derived(DERIVED_JUNCTION);
+	return(STAT_OK);
+}
+
+void cm_update_junction_limits()
+{
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cm.a[axis].junction_limit = cm.a[axis].junction_dev * cm.junction_acceleration;
+	}
+}
+
+/**** Step rate functions
+ * cm_update_step_velocity() - recompute the axis step rate velocity limits (config_update_derived())
+ * cm_get_vs()		  - get an axis step rate velocity limit, bringing it up to date first
+ *
+ *	An axis can't be moved faster than its slowest motor can be stepped (see st_get_step_rate_max()),
+ *	whatever its vm or fr says. The planner clamps each move's cruise velocity to these limits.
+ *	Axes with no motor are unlimited (0), as are all axes with non-Cartesian kinematics, where
+ *	joint and axis velocities have no fixed ratio. Uses the kinematics table, so it must run
+ *	after ik_map_motors().
+ */
+void cm_update_step_velocity()
+{
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cm.a[axis].step_velocity_max = 0;
+	}
+	if (ik.kinematics != KINEMATICS_CARTESIAN) {
+		return;
+	}
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if (ik.steps_per_unit[motor] > 0) {							// mapped to an active axis
+			uint8_t axis = ik.axis[motor];
+			float velocity = st_get_step_rate_max(motor) * 60 / ik.steps_per_unit[motor];
+			if ((cm.a[axis].step_velocity_max == 0) || (velocity < cm.a[axis].step_velocity_max)) {
+				cm.a[axis].step_velocity_max = velocity;
+			}
+		}
+	}
+}
+
+stat_t cm_get_vs(nvObj_t *nv)
+{
+	if (cfg.derived_dirty != 0) {
+		config_update_derived();
+	}
+	return (get_flt(nv));
+}
+
+/**** Input shaper functions (see plan_shaper.c)
+ * cm_set_xif()		  - set shaper frequency. 0 turns the shaper off
+ * cm_set_xiz()		  - set shaper damping ratio
+ *
+ *	The shaper lags by up to one damped period, so frequencies below SHAPER_MIN_FREQUENCY
+ *	are refused. New values take effect once the axes come to rest.
+ */
+stat_t cm_set_xif(nvObj_t *nv)
+{
+	if ((nv->value < SHAPER_MIN_FREQUENCY) && (fp_NOT_ZERO(nv->value))) {
+		return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
+stat_t cm_set_xiz(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > SHAPER_MAX_DAMPING) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
+/**** Adaptive feed functions (see _get_adaptive_feed() in plan_exec.c)
+ * cm_set_lfi() - set the analog input read as spindle load, 0 = off
+ * cm_set_lfn() - set an adaptive feed factor limit (min and max)
+ */
+stat_t cm_set_lfi(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > ANALOG_CHANNELS) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_ui8(nv);
+	return(STAT_OK);
+}
+
+stat_t cm_set_lfn(nvObj_t *nv)
+{
+	if (nv->value < FEED_OVERRIDE_MIN) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > FEED_OVERRIDE_MAX) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
+/**** Torch height control functions (see _update_thc() in plan_exec.c)
+ * cm_set_thi() - set the analog input read as arc voltage, 0 = off
+ * cm_set_thd() - set the fraction of the cruise velocity below which corrections hold
+ */
+stat_t cm_set_thi(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > ANALOG_CHANNELS) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_ui8(nv);
+	return(STAT_OK);
+}
+
+stat_t cm_set_thd(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > 1) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
+/*
+ * cm_set_pax() - set the axis run as the extruder by the pressure advance, 0 = off
+ */
+stat_t cm_set_pax(nvObj_t *nv)
+{
+	if (nv->value < 0) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
+	if (nv->value > AXES) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
+	set_ui8(nv);
+	return(STAT_OK);
+}
+
 /*
  * Commands
  *
@@ -1860,6 +3164,47 @@ stat_t cm_run_joga(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+stat_t cm_run_jogv(nvObj_t *nv)
+{
+	set_flu(nv);
+	return (cm_jogging_velocity());
+}
+
+/***********************************************************************************
+ * AXIS TUNING
+ ***********************************************************************************/
+
+stat_t cm_run_tunx(nvObj_t *nv)
+{
+	set_flt(nv);
+	return (cm_tuning_cycle_start(AXIS_X));
+}
+
+stat_t cm_run_tuny(nvObj_t *nv)
+{
+	set_flt(nv);
+	return (cm_tuning_cycle_start(AXIS_Y));
+}
+
+stat_t cm_run_tunz(nvObj_t *nv)
+{
+	set_flt(nv);
+	return (cm_tuning_cycle_start(AXIS_Z));
+}
+
+stat_t cm_run_tuna(nvObj_t *nv)
+{
+	set_flt(nv);
+	return (cm_tuning_cycle_start(AXIS_A));
+}
+
+stat_t cm_set_tum(nvObj_t *nv)
+{
+	if ((nv->value <= 0) || (nv->value > 1)) { return (STAT_INPUT_VALUE_RANGE_ERROR);}
+	set_flt(nv);
+	return(STAT_OK);
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -1886,6 +3231,7 @@ const char fmt_path[] PROGMEM = "Path Mode:           %s\n";
 const char fmt_dist[] PROGMEM = "Distance mode:       %s\n";
 const char fmt_frmo[] PROGMEM = "Feed rate mode:      %s\n";
 const char fmt_tool[] PROGMEM = "Tool number          %d\n";
+const char fmt_ff[] PROGMEM = "Resume at line:%10lu\n";
 
 const char fmt_pos[] PROGMEM = "%c position:%15.3f%s\n";
 const char fmt_mpo[] PROGMEM = "%c machine posn:%11.3f%s\n";
@@ -1915,6 +3261,7 @@ void cm_print_path(nvObj_t *nv) { text_print_str(nv, fmt_path);}
 void cm_print_dist(nvObj_t *nv) { text_print_str(nv, fmt_dist);}
 void cm_print_frmo(nvObj_t *nv) { text_print_str(nv, fmt_frmo);}
 void cm_print_tool(nvObj_t *nv) { text_print_int(nv, fmt_tool);}
+void cm_print_ff(nvObj_t *nv) { text_print_int(nv, fmt_ff);}
 
 void cm_print_gpl(nvObj_t *nv) { text_print_int(nv, fmt_gpl);}
 void cm_print_gun(nvObj_t *nv) { text_print_int(nv, fmt_gun);}
@@ -1926,14 +3273,102 @@ void cm_print_gdi(nvObj_t *nv) { text_print_int(nv, fmt_gdi);}
 
 const char fmt_ja[] PROGMEM = "[ja]  junction acceleration%8.0f%s\n";
 const char fmt_ct[] PROGMEM = "[ct]  chordal tolerance%17.4f%s\n";
+const char fmt_lt[] PROGMEM = "[lt]  line merge tolerance%14.4f%s\n";
+const char fmt_qg[] PROGMEM = "[qg]  queue governor time%15lu ms\n";
+const char fmt_pb[] PROGMEM = "[pb]  planner prime buffers%13lu\n";
+const char fmt_pt[] PROGMEM = "[pt]  planner prime time%16lu ms\n";
+const char fmt_px[] PROGMEM = "[px]  planner prime timeout%13lu ms\n";
 const char fmt_sl[] PROGMEM = "[sl]  soft limit enable%12d\n";
+const char fmt_sc[] PROGMEM = "[sc]  segment commands%13d\n";
+const char fmt_tum[] PROGMEM = "[tum] tuning margin%21.2f\n";
+const char fmt_tuw[] PROGMEM = "[tuw] tuning write results%9d [0=report only,1=write jm and vm]\n";
+const char fmt_plv[] PROGMEM = "[plv] probe latch velocity%14.0f%s/min\n";
+const char fmt_plb[] PROGMEM = "[plb] probe latch backoff%15.3f%s\n";
+const char fmt_cpi[] PROGMEM = "[cpi] checkpoint interval%15lu ms\n";
+const char fmt_lfi[] PROGMEM = "[lfi] adaptive feed input%15d [0=off,1-4=analog input]\n";
+const char fmt_lfl[] PROGMEM = "[lfl] adaptive feed load lo%13.3f\n";
+const char fmt_lfh[] PROGMEM = "[lfh] adaptive feed load hi%13.3f\n";
+const char fmt_lfn[] PROGMEM = "[lfn] adaptive feed min%17.3f\n";
+const char fmt_lfx[] PROGMEM = "[lfx] adaptive feed max%17.3f\n";
+const char fmt_lff[] PROGMEM = "[lff] adaptive feed factor%14.3f\n";
+const char fmt_thi[] PROGMEM = "[thi] torch height input%16d [0=off,1-4=analog input]\n";
+const char fmt_thv[] PROGMEM = "[thv] torch height voltage%14.3f\n";
+const char fmt_thg[] PROGMEM = "[thg] torch height gain%17.3f%s/min per volt\n";
+const char fmt_thr[] PROGMEM = "[thr] torch height rate%17.3f%s/min\n";
+const char fmt_thl[] PROGMEM = "[thl] torch height limit%16.3f%s\n";
+const char fmt_thd[] PROGMEM = "[thd] torch height anti-dive%12.3f of cruise velocity\n";
+const char fmt_tho[] PROGMEM = "[tho] torch height offset%15.3f mm\n";
+const char fmt_pax[] PROGMEM = "[pax] pressure advance axis%13d [0=off,1-6=X-C]\n";
+const char fmt_pak[] PROGMEM = "[pak] pressure advance%18.3f sec\n";
+const char fmt_pao[] PROGMEM = "[pao] pressure advance offset%11.3f\n";
+const char fmt_rtl[] PROGMEM = "[rtl] retract length%20.3f\n";
+const char fmt_rtv[] PROGMEM = "[rtv] retract velocity%18.0f per min\n";
+const char fmt_rto[] PROGMEM = "[rto] retract offset%20.3f\n";
+const char fmt_kin[] PROGMEM = "[kin] kinematics%19d [0=cartesian,1=corexy,2=hbot,3=delta,4=rtcp]\n";
+const char fmt_kdr[] PROGMEM = "[kdr] delta radius%22.3f%s\n";
+const char fmt_kdl[] PROGMEM = "[kdl] delta rod length%18.3f%s\n";
+const char fmt_kpx[] PROGMEM = "[kpx] rtcp pivot x%22.3f%s\n";
+const char fmt_kpy[] PROGMEM = "[kpy] rtcp pivot y%22.3f%s\n";
+const char fmt_kpz[] PROGMEM = "[kpz] rtcp pivot z%22.3f%s\n";
+const char fmt_pcs[] PROGMEM = "[%s%s] pitch map start%16.3f%s\n";
+const char fmt_pcd[] PROGMEM = "[%s%s] pitch map spacing%14.3f%s\n";
+const char fmt_pcn[] PROGMEM = "[%s%s] pitch correction%15.4f%s\n";
+const char fmt_sk[] PROGMEM = "[%s%s] skew correction%16.5f\n";
+const char fmt_prjk[] PROGMEM = "[%s%s] preset jerk scale%15.3f [0=base]\n";
+const char fmt_prja[] PROGMEM = "[%s%s] preset junction accel%11.0f%s [0=base]\n";
+const char fmt_prst[] PROGMEM = "[%s%s] preset segment time%13.0f uSec [0=base]\n";
+const char fmt_prct[] PROGMEM = "[%s%s] preset chordal tolerance%9.4f%s [0=base]\n";
 const char fmt_ml[] PROGMEM = "[ml]  min line segment%17.3f%s\n";
 const char fmt_ma[] PROGMEM = "[ma]  min arc segment%18.3f%s\n";
 const char fmt_ms[] PROGMEM = "[ms]  min segment time%13.0f uSec\n";
 
 void cm_print_ja(nvObj_t *nv) { text_print_flt_units(nv, fmt_ja, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ct(nvObj_t *nv) { text_print_flt_units(nv, fmt_ct, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_lt(nvObj_t *nv) { text_print_flt_units(nv, fmt_lt, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_qg(nvObj_t *nv) { text_print_int(nv, fmt_qg);}
+void cm_print_pb(nvObj_t *nv) { text_print_int(nv, fmt_pb);}
+void cm_print_pt(nvObj_t *nv) { text_print_int(nv, fmt_pt);}
+void cm_print_px(nvObj_t *nv) { text_print_int(nv, fmt_px);}
 void cm_print_sl(nvObj_t *nv) { text_print_ui8(nv, fmt_sl);}
+void cm_print_sc(nvObj_t *nv) { text_print_ui8(nv, fmt_sc);}
+void cm_print_tum(nvObj_t *nv) { text_print_flt(nv, fmt_tum);}
+void cm_print_tuw(nvObj_t *nv) { text_print_ui8(nv, fmt_tuw);}
+void cm_print_plv(nvObj_t *nv) { text_print_flt_units(nv, fmt_plv, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_plb(nvObj_t *nv) { text_print_flt_units(nv, fmt_plb, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_cpi(nvObj_t *nv) { text_print_int(nv, fmt_cpi);}
+void cm_print_lfi(nvObj_t *nv) { text_print_ui8(nv, fmt_lfi);}
+void cm_print_lfl(nvObj_t *nv) { text_print_flt(nv, fmt_lfl);}
+void cm_print_lfh(nvObj_t *nv) { text_print_flt(nv, fmt_lfh);}
+void cm_print_lfn(nvObj_t *nv) { text_print_flt(nv, fmt_lfn);}
+void cm_print_lfx(nvObj_t *nv) { text_print_flt(nv, fmt_lfx);}
+void cm_print_lff(nvObj_t *nv) { text_print_flt(nv, fmt_lff);}
+void cm_print_thi(nvObj_t *nv) { text_print_ui8(nv, fmt_thi);}
+void cm_print_thv(nvObj_t *nv) { text_print_flt(nv, fmt_thv);}
+void cm_print_thg(nvObj_t *nv) { text_print_flt_units(nv, fmt_thg, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_thr(nvObj_t *nv) { text_print_flt_units(nv, fmt_thr, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_thl(nvObj_t *nv) { text_print_flt_units(nv, fmt_thl, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_thd(nvObj_t *nv) { text_print_flt(nv, fmt_thd);}
+void cm_print_tho(nvObj_t *nv) { text_print_flt(nv, fmt_tho);}
+void cm_print_pax(nvObj_t *nv) { text_print_ui8(nv, fmt_pax);}
+void cm_print_pak(nvObj_t *nv) { text_print_flt(nv, fmt_pak);}
+void cm_print_pao(nvObj_t *nv) { text_print_flt(nv, fmt_pao);}
+void cm_print_rtl(nvObj_t *nv) { text_print_flt(nv, fmt_rtl);}
+void cm_print_rtv(nvObj_t *nv) { text_print_flt(nv, fmt_rtv);}
+void cm_print_rto(nvObj_t *nv) { text_print_flt(nv, fmt_rto);}
+void cm_print_kin(nvObj_t *nv) { text_print_ui8(nv, fmt_kin);}
+void cm_print_kdr(nvObj_t *nv) { text_print_flt_units(nv, fmt_kdr, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_kdl(nvObj_t *nv) { text_print_flt_units(nv, fmt_kdl, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_kpx(nvObj_t *nv) { text_print_flt_units(nv, fmt_kpx, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_kpy(nvObj_t *nv) { text_print_flt_units(nv, fmt_kpy, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_kpz(nvObj_t *nv) { text_print_flt_units(nv, fmt_kpz, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_pcs(nvObj_t *nv) { text_printf_P(fmt_pcs, nv->group, nv->token, nv->value, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_pcd(nvObj_t *nv) { text_printf_P(fmt_pcd, nv->group, nv->token, nv->value, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_pcn(nvObj_t *nv) { text_printf_P(fmt_pcn, nv->group, nv->token, nv->value, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_sk(nvObj_t *nv) { text_printf_P(fmt_sk, nv->group, nv->token, nv->value);}
+void cm_print_prjk(nvObj_t *nv) { text_printf_P(fmt_prjk, nv->group, nv->token, nv->value);}
+void cm_print_prja(nvObj_t *nv) { text_printf_P(fmt_prja, nv->group, nv->token, nv->value, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_prst(nvObj_t *nv) { text_printf_P(fmt_prst, nv->group, nv->token, nv->value);}
+void cm_print_prct(nvObj_t *nv) { text_printf_P(fmt_prct, nv->group, nv->token, nv->value, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ml(nvObj_t *nv) { text_print_flt_units(nv, fmt_ml, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ma(nvObj_t *nv) { text_print_flt_units(nv, fmt_ma, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_ms(nvObj_t *nv) { text_print_flt_units(nv, fmt_ms, GET_UNITS(ACTIVE_MODEL));}
@@ -1953,12 +3388,18 @@ void cm_print_ms(nvObj_t *nv) { text_print_flt_units(nv, fmt_ms, GET_UNITS(ACTIV
  *	cm_print_jm()
  *	cm_print_jh()
  *	cm_print_jd()
+ *	cm_print_vs()
  *	cm_print_ra()
  *	cm_print_sn()
  *	cm_print_sx()
  *	cm_print_lv()
  *	cm_print_lb()
  *	cm_print_zb()
+ *	cm_print_hg()
+ *	cm_print_hw()
+ *	cm_print_it()
+ *	cm_print_if()
+ *	cm_print_iz()
  *
  *	cm_print_pos() - print position with unit displays for MM or Inches
  * 	cm_print_mpo() - print position with fixed unit display - always in Degrees or MM
@@ -1972,6 +3413,7 @@ static const char fmt_Xtn[] PROGMEM = "[%s%s] %s travel minimum%17.3f%s\n";
 static const char fmt_Xjm[] PROGMEM = "[%s%s] %s jerk maximum%15.0f%s/min^3 * 1 million\n";
 static const char fmt_Xjh[] PROGMEM = "[%s%s] %s jerk homing%16.0f%s/min^3 * 1 million\n";
 static const char fmt_Xjd[] PROGMEM = "[%s%s] %s junction deviation%14.4f%s (larger is faster)\n";
+static const char fmt_Xvs[] PROGMEM = "[%s%s] %s step rate velocity%10.0f%s/min [0=unlimited]\n";
 static const char fmt_Xra[] PROGMEM = "[%s%s] %s radius value%20.4f%s\n";
 static const char fmt_Xsn[] PROGMEM = "[%s%s] %s switch min%17d [0=off,1=homing,2=limit,3=limit+homing]\n";
 static const char fmt_Xsx[] PROGMEM = "[%s%s] %s switch max%17d [0=off,1=homing,2=limit,3=limit+homing]\n";
@@ -1979,12 +3421,19 @@ static const char fmt_Xsv[] PROGMEM = "[%s%s] %s search velocity%12.0f%s/min\n";
 static const char fmt_Xlv[] PROGMEM = "[%s%s] %s latch velocity%13.0f%s/min\n";
 static const char fmt_Xlb[] PROGMEM = "[%s%s] %s latch backoff%18.3f%s\n";
 static const char fmt_Xzb[] PROGMEM = "[%s%s] %s zero backoff%19.3f%s\n";
+static const char fmt_Xhg[] PROGMEM = "[%s%s] %s homing group%15d [0=alone,1-3=home together]\n";
+static const char fmt_Xhw[] PROGMEM = "[%s%s] %s homing window%18.3f%s [0=full search]\n";
+static const char fmt_Xit[] PROGMEM = "[%s%s] %s input shaper%15d [0=off,1=ZV,2=ZVD,3=EI]\n";
+static const char fmt_Xif[] PROGMEM = "[%s%s] %s shaper frequency%15.1f Hz\n";
+static const char fmt_Xiz[] PROGMEM = "[%s%s] %s shaper damping%18.3f\n";
 static const char fmt_cofs[] PROGMEM = "[%s%s] %s %s offset%20.3f%s\n";
 static const char fmt_cpos[] PROGMEM = "[%s%s] %s %s position%18.3f%s\n";
+static const char fmt_ttl[] PROGMEM = "[%s%s] %s tool length%20.3f%s\n";
+static const char fmt_ttd[] PROGMEM = "[%s%s] %s tool diameter%18.3f%s\n";
 
 static void _print_axis_ui8(nvObj_t *nv, const char *format)
 {
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, (uint8_t)nv->value);
+	text_printf_P(format, nv->group, nv->token, nv->group, (uint8_t)nv->value);
 }
 
 static void _print_axis_flt(nvObj_t *nv, const char *format)
@@ -1995,7 +3444,7 @@ static void _print_axis_flt(nvObj_t *nv, const char *format)
 	} else {
 		units = (char *)GET_TEXT_ITEM(msg_units, DEGREE_INDEX);
 	}
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->value, units);
+	text_printf_P(format, nv->group, nv->token, nv->group, nv->value, units);
 }
 
 static void _print_axis_coord_flt(nvObj_t *nv, const char *format)
@@ -2006,7 +3455,7 @@ static void _print_axis_coord_flt(nvObj_t *nv, const char *format)
 	} else {
 		units = (char *)GET_TEXT_ITEM(msg_units, DEGREE_INDEX);
 	}
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->token, nv->value, units);
+	text_printf_P(format, nv->group, nv->token, nv->group, nv->token, nv->value, units);
 }
 
 static void _print_pos(nvObj_t *nv, const char *format, uint8_t units)
@@ -2014,12 +3463,12 @@ static void _print_pos(nvObj_t *nv, const char *format, uint8_t units)
 	char axes[] = {"XYZABC"};
 	uint8_t axis = _get_axis(nv->index);
 	if (axis >= AXIS_A) { units = DEGREES;}
-	fprintf_P(stderr, format, axes[axis], nv->value, GET_TEXT_ITEM(msg_units, units));
+	text_printf_P(format, axes[axis], nv->value, GET_TEXT_ITEM(msg_units, units));
 }
 
 void cm_print_am(nvObj_t *nv)	// print axis mode with enumeration string
 {
-	fprintf_P(stderr, fmt_Xam, nv->group, nv->token, nv->group, (uint8_t)nv->value,
+	text_printf_P(fmt_Xam, nv->group, nv->token, nv->group, (uint8_t)nv->value,
 	GET_TEXT_ITEM(msg_am, (uint8_t)nv->value));
 }
 
@@ -2030,6 +3479,7 @@ void cm_print_tn(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xtn);}
 void cm_print_jm(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjm);}
 void cm_print_jh(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjh);}
 void cm_print_jd(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xjd);}
+void cm_print_vs(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xvs);}
 void cm_print_ra(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xra);}
 void cm_print_sn(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xsn);}
 void cm_print_sx(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xsx);}
@@ -2037,9 +3487,16 @@ void cm_print_sv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xsv);}
 void cm_print_lv(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlv);}
 void cm_print_lb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xlb);}
 void cm_print_zb(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xzb);}
+void cm_print_hg(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xhg);}
+void cm_print_hw(nvObj_t *nv) { _print_axis_flt(nv, fmt_Xhw);}
+void cm_print_it(nvObj_t *nv) { _print_axis_ui8(nv, fmt_Xit);}
+void cm_print_if(nvObj_t *nv) { text_printf_P(fmt_Xif, nv->group, nv->token, nv->group, nv->value);}
+void cm_print_iz(nvObj_t *nv) { text_printf_P(fmt_Xiz, nv->group, nv->token, nv->group, nv->value);}
 
 void cm_print_cofs(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cofs);}
 void cm_print_cpos(nvObj_t *nv) { _print_axis_coord_flt(nv, fmt_cpos);}
+void cm_print_ttl(nvObj_t *nv) { text_printf_P(fmt_ttl, nv->group, nv->token, nv->group, nv->value, GET_UNITS(MODEL));}
+void cm_print_ttd(nvObj_t *nv) { text_printf_P(fmt_ttd, nv->group, nv->token, nv->group, nv->value, GET_UNITS(MODEL));}
 
 void cm_print_pos(nvObj_t *nv) { _print_pos(nv, fmt_pos, cm_get_units_mode(MODEL));}
 void cm_print_mpo(nvObj_t *nv) { _print_pos(nv, fmt_mpo, MILLIMETERS);}
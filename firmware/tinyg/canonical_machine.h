@@ -40,14 +40,28 @@ extern "C"{
 /* Defines, Macros, and  Assorted Parameters */
 
 #define MODEL 	(GCodeState_t *)&cm.gm		// absolute pointer from canonical machine gm model
-#define PLANNER (GCodeState_t *)&bf->gm		// relative to buffer *bf is currently pointing to
 #define RUNTIME (GCodeState_t *)&mr.gm		// absolute pointer from runtime mm struct
 #define ACTIVE_MODEL cm.am					// active model pointer is maintained by state management
 
 #define _to_millimeters(a) ((cm.gm.units_mode == INCHES) ? (a * MM_PER_INCH) : a)
 
 #define JOGGING_START_VELOCITY ((float)10.0)
+#define JOGGING_VELOCITY_TIMEOUT 500		// ms - a velocity jog stops if the host sends nothing for this long
+
+#define TUNING_STEPS 8						// passes run by the tuning cycle (see cycle_tuning.c)
+#define TUNING_START_FACTOR ((float)0.5)	// first pass runs at this fraction of the axis jm and vm
+#define TUNING_STEP_FACTOR ((float)1.25)	// each pass after runs this much faster and harder
+#define TUNING_ERROR_FRACTION ((float)0.5)	// a pass fails at this fraction of the following error limit
+#define TUNING_FOLLOWING_ERROR ((float)16.0)// ...or at this many steps if the motor has no limit (a stall)
+#define CANNED_PECK_CLEARANCE ((float)0.25)	// mm - G83 re-entry height and G73 chip break retract
 #define DISABLE_SOFT_LIMIT (-1000000)
+#define SOFT_LIMIT_OPEN 100000000			// soft limit box edge of an axis that is not tested
+#define OVERRIDE_QUEUE_SIZE 16			// realtime override chars waiting for the main loop (power of 2)
+#define OVERRIDE_STEP ((float)0.10)			// feed and spindle override change per realtime char
+#define SPINDLE_OVERRIDE_MIN ((float)0.10)	// realtime spindle override limits
+#define SPINDLE_OVERRIDE_MAX ((float)2.00)
+#define SYNC_OUTPUTS 4						// M62, M63 P0 - P3 are the gpio1 output bits
+#define PRESETS 3							// G187 P1 - P3 machining presets (see cm_set_preset())
 
 /*****************************************************************************
  * GCODE MODEL - The following GCodeModel/GCodeInput structs are used:
@@ -57,8 +71,9 @@ extern "C"{
  *	 machine coordinate system (absolute coordinate system). Gm is owned by the
  *	 canonical machine layer and should be accessed only through cm_ routines.
  *
- *	 The gm core struct is copied and passed as context to the runtime where it is
- *	 used for planning, replanning, and reporting.
+ *	 The gm core struct is passed to the planner, which keeps the per-move values in
+ *	 each planner buffer and the modal values in a shared, deduplicated table. It is
+ *	 reassembled in the runtime (mr.gm) where it is used for reporting.
  *
  * - gmx is the extended gcode model variables that are only used by the canonical
  *	 machine and do not need to be passed further down.
@@ -80,19 +95,30 @@ extern "C"{
  *	 the operating state for the values (which may have changed).
  */
 typedef struct GCodeState {				// Gcode model state - used by model, planning and runtime
+										// per-move values - carried in each planner buffer (see mpBuf_t)
 	uint32_t linenum;					// Gcode block line number
 	uint8_t motion_mode;				// Group1: G0, G1, G2, G3, G38.2, G80, G81,
 										// G82, G83 G84, G85, G86, G87, G88, G89
 	float target[AXES]; 				// XYZABC where the move should go
-	float work_offset[AXES];			// offset from the work coordinate system (for reporting only)
-
 	float move_time;					// optimal time for move given axis constraints
 	float minimum_time;					// minimum time possible for move given axis constraints
 	float feed_rate; 					// F - normalized to millimeters/minute or in inverse time mode
+	uint8_t raster_pixels;				// pixels of a raster line (see mp_set_rst()); 0 for other moves
+	uint8_t outputs_on;					// M62 outputs switched on as the move starts (see cm_sync_output())
+	uint8_t outputs_off;				// M63 outputs switched off as the move starts
 
+										// per-line values - not carried by the planner (S and P
+										// are queued as commands and dwells), so they stay out of
+										// the modal comparison and don't use up mb.modal[] entries
 	float spindle_speed;				// in RPM
 	float parameter;					// P - parameter used for dwell time in seconds, G10 coord select...
 
+										// modal values - shared by planner buffers via mb.modal[]
+										// work_offset must remain the first modal value (see planner.c)
+	float work_offset[AXES];			// offset from the work coordinate system (for reporting only)
+	float path_tolerance;				// G64 P - corner blending tolerance in mm (0 = no blending)
+	float cutter_radius;				// G41, G42 - cutter radius in mm (see mp_aline())
+
 	uint8_t feed_rate_mode;				// See cmFeedRateMode for settings
 	uint8_t select_plane;				// G17,G18,G19 - values to set plane to
 	uint8_t units_mode;					// G20,G21 - 0=inches (G20), 1 = mm (G21)
@@ -106,6 +132,8 @@ typedef struct GCodeState {				// Gcode model state - used by model, planning an
 	uint8_t mist_coolant;				// TRUE = mist on (M7), FALSE = off (M9)
 	uint8_t flood_coolant;				// TRUE = flood on (M8), FALSE = off (M9)
 	uint8_t spindle_mode;				// 0=OFF (M5), 1=CW (M3), 2=CCW (M4)
+	uint8_t cutter_comp;				// G40, G41, G42 - side of the path the tool is kept on
+	uint8_t preset;						// G187 P - machining preset, 0 = none (see cm_set_preset())
 
 } GCodeState_t;
 
@@ -126,14 +154,32 @@ typedef struct GCodeStateExtended {		// Gcode dynamic state extensions - used by
 	uint8_t l_word;						// L word - used by G10s
 
 	uint8_t origin_offset_enable;		// G92 offsets enabled/disabled.  0=disabled, 1=enabled
+
+	uint8_t tool_select;				// T value as seen by the model (gm.tool_select is set at runtime)
+	uint8_t tool;						// tool loaded by the last M6, as seen by the model
+	uint8_t tool_length_enable;			// G43 tool length offset is active (G49 cancels)
+	uint8_t tool_length_follow;			// G43 without H - the offset follows the tool loaded by M6
+	uint8_t tool_length_tool;			// tool table entry the offset was taken from
+	float tool_length_offset;			// Z tool length offset in effect (mm), 0 if G49
+
+	uint8_t rotation_enable;			// G68 coordinate rotation is active (G69 cancels)
+	float rotation_angle;				// G68 rotation in radians, counterclockwise
+	float rotation_center[2];			// G68 center of rotation in XY work coordinates (mm)
+	uint8_t scaling_enable;				// G51 scaling is active (G50 cancels)
+	float scaling_factor[2];			// G51 X and Y scale factors - a negative factor mirrors the axis
+	float scaling_center[2];			// G51 center of scaling in XY work coordinates (mm)
+	uint8_t transform_enable;			// TRUE if G68 or G51 is active and transform[] applies
+	float transform[2][2];				// XY work position = transform * program position + transform_offset
+	float transform_offset[2];
+	float transform_inverse[2][2];		// inverse of transform[] (program position from work position)
 	uint8_t block_delete_switch;		// set true to enable block deletes (true is default)
+	uint8_t retract_mode;				// G98, G99 - canned cycles retract to initial Z or to R plane
 
 	float spindle_override_factor;		// 1.0000 x S spindle speed. Go up or down from there
 	uint8_t	spindle_override_enable;	// TRUE = override enabled
-
-// unimplemented gcode parameters
-//	float cutter_radius;				// D - cutter radius compensation (0 is off)
-//	float cutter_length;				// H - cutter length compensation (0 is off)
+	uint8_t spindle_css_mode;			// G96, G97 - TRUE = S is a constant surface speed (G96)
+	float spindle_css_speed;			// G96 surface speed in mm/min
+	float spindle_css_max;				// G96 D - max spindle speed in RPM (0 = none)
 
 	uint16_t magic_end;
 
@@ -156,6 +202,8 @@ typedef struct GCodeInput {				// Gcode model inputs - meaning depends on contex
 	uint8_t	traverse_override_enable;	// TRUE = traverse override enabled
 	uint8_t override_enables;			// enables for feed and spoindle (GN/GF only)
 	uint8_t l_word;						// L word - used by G10s
+	uint8_t h_word;						// H word - tool table entry for G43
+	uint8_t tool_length_mode;			// G43, G49 - TRUE = tool length offset on (G43)
 
 	uint8_t select_plane;				// G17,G18,G19 - values to set plane to
 	uint8_t units_mode;					// G20,G21 - 0=inches (G20), 1 = mm (G21)
@@ -165,25 +213,28 @@ typedef struct GCodeInput {				// Gcode model inputs - meaning depends on contex
 	uint8_t path_control;				// G61... EXACT_PATH, EXACT_STOP, CONTINUOUS
 	uint8_t distance_mode;				// G91   0=use absolute coords(G90), 1=incremental movement
 	uint8_t arc_distance_mode;			// G91.1   0=use absolute coords(G90), 1=incremental movement
+	uint8_t retract_mode;				// G98, G99 - canned cycle retract mode
+	uint8_t preset_select;				// G187 - select the machining preset in P
 
 	uint8_t tool;						// Tool after T and M6 (tool_select and tool_change)
 	uint8_t tool_select;				// T value - T sets this value
 	uint8_t tool_change;				// M6 tool change flag - moves "tool_select" to "tool"
 	uint8_t mist_coolant;				// TRUE = mist on (M7), FALSE = off (M9)
 	uint8_t flood_coolant;				// TRUE = flood on (M8), FALSE = off (M9)
+	uint8_t sync_output;				// TRUE = on (M62), FALSE = off (M63) - output number in P
 
 	uint8_t spindle_mode;				// 0=OFF (M5), 1=CW (M3), 2=CCW (M4)
 	float spindle_speed;				// in RPM
 	float spindle_override_factor;		// 1.0000 x S spindle speed. Go up or down from there
 	uint8_t	spindle_override_enable;	// TRUE = override enabled
+	uint8_t spindle_css_mode;			// G96, G97 - TRUE = constant surface speed (G96)
+	uint8_t cutter_comp;				// G40, G41, G42 - cutter radius compensation
+	float d_word;						// D - max spindle speed in G96, tool table entry for G41, G42
 
 	float parameter;					// P - parameter used for dwell time in seconds, G10 coord select...
 	float arc_radius;					// R - radius value in arc radius mode
 	float arc_offset[3];  				// IJK - used by arc commands
-
-// unimplemented gcode parameters
-//	float cutter_radius;				// D - cutter radius compensation (0 is off)
-//	float cutter_length;				// H - cutter length compensation (0 is off)
+	float peck_depth;					// Q - peck increment in G73 and G83 drilling cycles
 
 } GCodeInput_t;
 
@@ -201,13 +252,42 @@ typedef struct cmAxis {
 	float jerk_homing;					// homing jerk (Jh) in mm/min^3 divided by 1 million
 	float recip_jerk;					// stored reciprocal of current jerk value - has the million in it
 	float junction_dev;					// aka cornering delta
+	float junction_limit;				// junction_dev * junction acceleration (derived)
+	float step_velocity_max;			// fastest the axis motors can be stepped in mm/min or deg/min - 0 if unlimited (derived)
 	float radius;						// radius in mm for rotary axis modes
+	float radius_scale;					// degrees per mm of travel at the radius (cached by cm_set_ra())
 	float search_velocity;				// homing search velocity
 	float latch_velocity;				// homing latch velocity
 	float latch_backoff;				// backoff from switches prior to homing latch movement
 	float zero_backoff;					// backoff from switches for machine zero
+	uint8_t homing_group;				// axes with the same non-zero group are homed together
+	float homing_window;				// quick re-homing searches this far either side of the known switch, 0 = off
+	uint8_t shaper_type;				// input shaper (see enum mpShaperType), X, Y and Z only
+	float shaper_frequency;				// input shaper frequency in Hz, 0 = off
+	float shaper_damping;				// input shaper damping ratio
 } cfgAxis_t;
 
+typedef struct cmPreset {				// machining preset - 0 keeps the base setting
+	float jerk_scale;					// multiplies every axis jerk_max
+	float junction_acceleration;		// replaces $ja
+	float segment_usec;					// replaces NOM_SEGMENT_USEC for ramps and arcs
+	float chordal_tolerance;			// replaces $ct
+} cmPreset_t;
+
+typedef struct cmCheckpoint {			// power loss checkpoint, one NVM page (see cm_checkpoint_callback())
+	float position[AXES];				// machine position of the runtime (mm or degrees)
+	uint32_t linenum;					// runtime line number
+	uint8_t coord_tool;					// coordinate system (low nibble) and tool (high nibble)
+	uint8_t modes;						// CHECKPOINT_ bits below
+} cmCheckpoint_t;
+
+#define CHECKPOINT_MILLIMETERS	0x01	// G21 (else G20)
+#define CHECKPOINT_INCREMENTAL	0x02	// G91 (else G90)
+#define CHECKPOINT_PLANE		0x0C	// select_plane << 2
+#define CHECKPOINT_SPINDLE		0x30	// spindle_mode << 4
+#define CHECKPOINT_MIST			0x40	// M7
+#define CHECKPOINT_FLOOD		0x80	// M8
+
 typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	magic_t magic_start;				// magic number to test memory integrity
 
@@ -216,7 +296,32 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	// system group settings
 	float junction_acceleration;		// centripetal acceleration max for cornering
 	float chordal_tolerance;			// arc chordal accuracy setting in mm
+	cmPreset_t preset[PRESETS];			// G187 machining presets
+	float line_merge_tolerance;			// max deviation for merging collinear lines in mm (0 = off)
+	uint32_t queue_governor_time;		// queued ms below which feeds are slowed down (0 = off)
+	uint32_t prime_buffers;				// queued buffers needed to start a cycle (0 = off)
+	uint32_t prime_time;				// queued ms needed to start a cycle (0 = off)
+	uint32_t prime_timeout;				// max ms the first move of a cycle waits for priming
 	uint8_t soft_limit_enable;
+	uint8_t segment_commands;			// TRUE to run spindle and coolant commands at segment boundaries without stopping
+	float probe_latch_velocity;			// mm/min of the slow probing pass (0 = single pass at F)
+	float probe_latch_backoff;			// max travel of the slow probing pass off the contact
+	uint32_t checkpoint_interval;		// ms between power loss checkpoints while running (0 = off)
+	uint8_t adaptive_feed_input;		// analog input read as spindle load by the adaptive feed (0 = off)
+	float adaptive_load_lo;				// load band the adaptive feed keeps the load in
+	float adaptive_load_hi;
+	float adaptive_feed_min;			// adaptive feed factor limits
+	float adaptive_feed_max;
+	uint8_t thc_input;					// analog input read as arc voltage by the torch height control (0 = off)
+	float thc_voltage;					// arc voltage the torch height control holds
+	float thc_gain;						// Z correction velocity per unit of voltage error
+	float thc_rate;						// max Z correction velocity
+	float thc_limit;					// max Z offset either way
+	float thc_antidive;					// corrections hold below this fraction of the cruise velocity
+	uint8_t pa_axis;					// axis run as the extruder by the pressure advance (0 = off, 1-6 = X-C)
+	float pa_advance;					// pressure advance in seconds of extruder velocity
+	float retract_length;				// firmware retraction (G10) of the extruder in its axis units
+	float retract_velocity;				// firmware retraction velocity in extruder units per minute
 
 	// hidden system settings
 	float min_segment_len;				// line drawing resolution in mm
@@ -232,6 +337,12 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 
 	// coordinate systems and offsets
 	float offset[COORDS+1][AXES];		// persistent coordinate offsets: absolute (G53) + G54,G55,G56,G57,G58,G59
+	float active_offset[AXES];			// combined G5x + G92 offsets cached by cm_get_active_coord_offset()
+	uint8_t active_offset_system;		// coord system and absolute override the cache was made for
+	uint8_t active_offset_override;
+	uint8_t active_offset_valid;		// FALSE once an offset changes (see cm_invalidate_coord_offsets())
+	float tool_length[TOOLS+1];			// persistent tool table: Z length offsets, entry 0 is no tool
+	float tool_diameter[TOOLS+1];		// persistent tool table: cutter diameters
 
 	// settings for axes X,Y,Z,A B,C
 	cfgAxis_t a[AXES];
@@ -246,17 +357,44 @@ typedef struct cmSingleton {			// struct to manage cm globals and cycles
 	uint8_t homing_state;				// home: homing cycle sub-state machine
 	uint8_t buffer_drain_state;			// M400: buffer drain state	
 	uint8_t homed[AXES];				// individual axis homing flags
+	uint8_t home_switch_known;			// bitmap of axes whose homing switch position is known (see cycle_homing.c)
+	float home_switch[HOMING_AXES];		// machine position of the homing switch found by the last homing cycle
+	float soft_limit_min[AXES];			// soft limit box in machine coordinates (see cm_update_soft_limits())
+	float soft_limit_max[AXES];
 
 	uint8_t probe_state;				// 1==success, 0==failed
 	float probe_results[AXES];			// probing results
+	uint8_t grid_compensation;			// true = the G29 height map is applied to Z in the runtime
 
 	uint8_t	g28_flag;					// true = complete a G28 move
 	uint8_t	g30_flag;					// true = complete a G30 move
 	uint8_t deferred_write_flag;		// G10 data has changed (e.g. offsets) - flag to persist them
+	uint8_t offset_dirty[COORDS+1];		// bitmap of axes of each coordinate system to persist
+	uint8_t tool_dirty;					// bitmap of tool table entries to persist (bit = tool number)
 	uint8_t feedhold_requested;			// feedhold character has been received
 	uint8_t queue_flush_requested;		// queue flush character has been received
 	uint8_t cycle_start_requested;		// cycle start character has been received (flag to end feedhold)
+	uint8_t override_queue[OVERRIDE_QUEUE_SIZE];// realtime override chars trapped by the RX interrupts
+	volatile uint8_t override_head;		// written by cm_request_override() from the RX interrupts
+	uint8_t override_tail;				// read by cm_override_callback()
 	float jogging_dest;					// jogging direction as a relative move from current position
+	float jog_velocity[AXES];			// velocity jog targets as sent by the host (mm/min, signed)
+	float tuning_travel;				// tuning pass length as a relative move from current position
+	float tuning_margin;				// fraction of the tuning results written to the axis ($tum)
+	uint8_t tuning_write;				// true = write the tuning results to the axis jm and vm ($tuw)
+	float tuning_jerk;					// highest jerk passed by the last tuning cycle
+	float tuning_velocity;				// highest velocity passed by the last tuning cycle
+	uint32_t checkpoint_tick;			// SysTick of the last checkpoint
+	uint8_t checkpoint_running;			// TRUE if a checkpoint was taken in the cycle that is running
+	cmCheckpoint_t checkpoint;			// the last checkpoint written
+	uint8_t outputs_on;					// M62, M63 outputs waiting for the next move (see cm_sync_output())
+	uint8_t outputs_off;
+	uint32_t ff_line;					// ff: resume the job at this line (0 = not fast forwarding)
+	uint32_t ff_linenum;				// line number of the last fast forwarded block
+	uint8_t ff_spindle_mode;			// spindle and coolant as left by the fast forwarded blocks
+	uint8_t ff_mist_coolant;
+	uint8_t ff_flood_coolant;
+	float ff_spindle_speed;
 	struct GCodeState *am;				// active Gcode model is maintained by state management
 
 	/**** Model states ****/
@@ -334,7 +472,8 @@ enum cmCycleState {
 	CYCLE_MACHINING,				// in normal machining cycle
 	CYCLE_PROBE,					// in probe cycle
 	CYCLE_HOMING,					// homing is treated as a specialized cycle
-	CYCLE_JOG						// jogging is treated as a specialized cycle
+	CYCLE_JOG,						// jogging is treated as a specialized cycle
+	CYCLE_TUNE						// jerk and velocity tuning cycle
 };
 
 enum cmMotionState {
@@ -389,11 +528,21 @@ enum cmNextAction {						// these are in order to optimized CASE statement
 	NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS,	// G92.2
 	NEXT_ACTION_RESUME_ORIGIN_OFFSETS,	// G92.3
 	NEXT_ACTION_DWELL,					// G4
-	NEXT_ACTION_STRAIGHT_PROBE,			// G38.2
+	NEXT_ACTION_STRAIGHT_PROBE,			// G38.2 probe toward the work, error if no contact
+	NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR,// G38.3 probe toward the work
+	NEXT_ACTION_STRAIGHT_PROBE_AWAY,	// G38.4 probe away from the work, error if contact is not lost
+	NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR,// G38.5 probe away from the work
+	NEXT_ACTION_PROBE_GRID,				// G29 probe a height map
+	NEXT_ACTION_CLEAR_PROBE_GRID,		// G29.1 stop applying the height map
 	NEXT_ACTION_GET_POSITION,			// M114
 	NEXT_ACTION_GET_FIRMWARE,			// M115
 	NEXT_ACTION_SET_JERK,				// M201.3
-	NEXT_ACTION_WAIT_FOR_COMPLETION		// M400
+	NEXT_ACTION_WAIT_FOR_COMPLETION,	// M400
+	NEXT_ACTION_SET_ROTATION,			// G68 coordinate rotation
+	NEXT_ACTION_CANCEL_ROTATION,		// G69
+	NEXT_ACTION_SET_SCALING,			// G51 scaling and mirroring
+	NEXT_ACTION_CANCEL_SCALING,			// G50
+	NEXT_ACTION_UNRETRACT				// G11 firmware unretract (G10 alone retracts)
 
 };
 
@@ -412,7 +561,12 @@ enum cmMotionMode {						// G Modal Group 1
 	MOTION_MODE_CANNED_CYCLE_86,		// G86 - boring, spindle stop, rapid out
 	MOTION_MODE_CANNED_CYCLE_87,		// G87 - back boring
 	MOTION_MODE_CANNED_CYCLE_88,		// G88 - boring, spindle stop, manual out
-	MOTION_MODE_CANNED_CYCLE_89			// G89 - boring, dwell, feed out
+	MOTION_MODE_CANNED_CYCLE_89,		// G89 - boring, dwell, feed out
+	MOTION_MODE_CANNED_CYCLE_73,		// G73 - peck drilling with chip breaking
+	MOTION_MODE_CUBIC_SPLINE,			// G5 - cubic spline feed
+	MOTION_MODE_QUADRATIC_SPLINE,		// G5.1 - quadratic spline feed
+	MOTION_MODE_SPINDLE_SYNC,			// G33 - spindle synchronized motion
+	MOTION_MODE_RIGID_TAP				// G33.1 - rigid tapping
 };
 
 enum cmModalGroup {						// Used for detecting gcode errors. See NIST section 3.4
@@ -427,6 +581,7 @@ enum cmModalGroup {						// Used for detecting gcode errors. See NIST section 3.
 	MODAL_GROUP_G9,						// {G98,G99}			return mode in canned cycles
 	MODAL_GROUP_G12,					// {G54,G55,G56,G57,G58,G59} coordinate system selection
 	MODAL_GROUP_G13,					// {G61,G61.1,G64}		path control mode
+	MODAL_GROUP_G14,					// {G96,G97}			spindle speed mode
 	MODAL_GROUP_M4,						// {M0,M1,M2,M30,M60}	stopping
 	MODAL_GROUP_M6,						// {M6}					tool change
 	MODAL_GROUP_M7,						// {M3,M4,M5}			spindle turning
@@ -466,11 +621,22 @@ enum cmPathControlMode {			// G Modal Group 13
 	PATH_CONTINUOUS					// G64 and typically the default mode
 };
 
+enum cmCutterComp {					// G Modal Group 7
+	CUTTER_COMP_OFF = 0,			// G40
+	CUTTER_COMP_LEFT,				// G41 - tool to the left of the path
+	CUTTER_COMP_RIGHT				// G42 - tool to the right of the path
+};
+
 enum cmDistanceMode {
 	ABSOLUTE_MODE = 0,				// G90
 	INCREMENTAL_MODE				// G91
 };
 
+enum cmRetractMode {				// G Modal Group 10
+	RETRACT_TO_INITIAL_LEVEL = 0,	// G98 - retract to the Z the cycle started from
+	RETRACT_TO_R_PLANE				// G99 - retract to the R plane
+};
+
 enum cmFeedRateMode {
 	INVERSE_TIME_MODE = 0,			// G93
 	UNITS_PER_MINUTE_MODE,			// G94
@@ -511,10 +677,11 @@ enum cmAxisMode {					// axis modes (ordered: see _cm_get_feed_time())
 	AXIS_DISABLED = 0,				// kill axis
 	AXIS_STANDARD,					// axis in coordinated motion w/standard behaviors
 	AXIS_INHIBITED,					// axis is computed but not activated
-	AXIS_RADIUS						// rotary axis calibrated to circumference
+	AXIS_RADIUS,					// rotary axis calibrated to circumference
+	AXIS_WRAPPED					// rotary axis in degrees, absolute moves take the shortest way around
 };	// ordering must be preserved. See cm_set_move_times()
 #define AXIS_MODE_MAX_LINEAR AXIS_INHIBITED
-#define AXIS_MODE_MAX_ROTARY AXIS_RADIUS
+#define AXIS_MODE_MAX_ROTARY AXIS_WRAPPED
 
 /*****************************************************************************
  * FUNCTION PROTOTYPES
@@ -560,6 +727,7 @@ void cm_set_model_linenum(uint32_t linenum);
 
 // Coordinate systems and offsets
 float cm_get_active_coord_offset(uint8_t axis);
+void cm_invalidate_coord_offsets(void);
 float cm_get_work_offset(GCodeState_t *gcode_state, uint8_t axis);
 void cm_set_work_offsets(GCodeState_t *gcode_state);
 float cm_get_absolute_position(GCodeState_t *gcode_state, uint8_t axis);
@@ -569,8 +737,10 @@ float cm_get_work_position(GCodeState_t *gcode_state, uint8_t axis);
 void cm_update_model_position_from_runtime(void);
 void cm_finalize_move(void);
 stat_t cm_deferred_write_callback(void);
+stat_t cm_checkpoint_callback(void);
 void cm_set_model_target(float target[], float flag[]);
 stat_t cm_test_soft_limits(float target[]);
+void cm_update_soft_limits(void);
 
 /*--- Canonical machining functions (loosely) defined by NIST [organized by NIST Gcode doc] ---*/
 
@@ -588,8 +758,11 @@ stat_t cm_select_plane(uint8_t plane);							// G17, G18, G19
 stat_t cm_set_units_mode(uint8_t mode);							// G20, G21
 stat_t cm_set_distance_mode(uint8_t mode);						// G90, G91
 stat_t cm_set_coord_offsets(uint8_t coord_system, float offset[], float flag[]); // G10 L2
+stat_t cm_set_tool_table(uint8_t tool, float offset[], float flag[], float radius, float radius_flag); // G10 L1
+stat_t cm_set_tool_length_offset(uint8_t enable, uint8_t tool, uint8_t tool_flag);	// G43, G49
 
 void cm_set_position(uint8_t axis, float position);				// set absolute position - single axis
+void cm_set_position_to_runtime(void);							// set model and planner to the runtime - all axes
 stat_t cm_set_absolute_origin(float origin[], float flag[]);	// G28.3
 void cm_set_axis_origin(uint8_t axis, const float position);	// G28.3 planner callback
 
@@ -598,6 +771,12 @@ stat_t cm_set_origin_offsets(float offset[], float flag[]);		// G92
 stat_t cm_reset_origin_offsets(void); 							// G92.1
 stat_t cm_suspend_origin_offsets(void); 						// G92.2
 stat_t cm_resume_origin_offsets(void);				 			// G92.3
+stat_t cm_set_rotation(float center[], float flag[], float angle, float angle_flag);	// G68
+stat_t cm_cancel_rotation(void);								// G69
+stat_t cm_set_scaling(float center[], float flag[], float factor[], float factor_flag[],
+					  float uniform, float uniform_flag);		// G51
+stat_t cm_cancel_scaling(void);									// G50
+void cm_transform_vector(float vector[]);						// apply G68/G51 to an XY offset
 
 stat_t cm_get_position(void);									// M114
 stat_t cm_get_firmware(void);									// M115
@@ -615,13 +794,25 @@ stat_t cm_goto_g30_position(float target[], float flags[]);		// G30
 stat_t cm_set_feed_rate(float feed_rate);						// F parameter
 stat_t cm_set_feed_rate_mode(uint8_t mode);						// G93, G94, (G95 unimplemented)
 stat_t cm_set_path_control(uint8_t mode);						// G61, G61.1, G64
+stat_t cm_set_path_tolerance(float tolerance);					// G64 P
+stat_t cm_set_preset(float preset);								// G187 P
+float cm_get_jerk_scale(void);
+float cm_get_junction_acceleration(void);
+float cm_get_chordal_tolerance(void);
+float cm_get_segment_usec(uint8_t preset);
+stat_t cm_set_cutter_comp(uint8_t mode, uint8_t tool, uint8_t tool_flag);	// G40, G41, G42
 
 // Machining Functions (4.3.6)
 stat_t cm_straight_feed(float target[], float flags[]);		    // G1
 stat_t cm_arc_feed(	float target[], float flags[],              // G2, G3
 					float i, float j, float k,
 					float radius, uint8_t motion_mode);
+stat_t cm_spline_feed(float target[], float flags[],			// G5, G5.1
+					  float i, float j, float p, float q, uint8_t motion_mode);
+stat_t cm_spindle_sync_feed(float target[], float flags[],		// G33, G33.1
+							float pitch, float pitch_flag, uint8_t motion_mode);
 stat_t cm_dwell(float seconds);									// G4, P parameter
+stat_t cm_retract(uint8_t retract);								// G10, G11 firmware retraction
 
 // Spindle Functions (4.3.7)
 // see spindle.h for spindle definitions - which would go right here
@@ -633,6 +824,7 @@ stat_t cm_change_tool(uint8_t tool);							// M6
 // Miscellaneous Functions (4.3.9)
 stat_t cm_mist_coolant_control(uint8_t mist_coolant); 			// M7
 stat_t cm_flood_coolant_control(uint8_t flood_coolant);			// M8, M9
+stat_t cm_sync_output(uint8_t state, float output);				// M62, M63
 
 stat_t cm_override_enables(uint8_t flag); 						// M48, M49
 stat_t cm_feed_rate_override_enable(uint8_t flag); 				// M50
@@ -648,6 +840,9 @@ void cm_message(char_t *message);								// msg to console (e.g. Gcode comments)
 void cm_request_feedhold(void);
 void cm_request_queue_flush(void);
 void cm_request_cycle_start(void);
+void cm_request_override(char_t c);
+
+stat_t cm_override_callback(void);							// apply realtime feed, traverse and spindle overrides
 
 stat_t cm_feedhold_sequencing_callback(void);					// process feedhold, cycle start and queue flush requests
 stat_t cm_queue_flush(void);									// flush serial and planner queues with coordinate resets
@@ -667,13 +862,32 @@ stat_t cm_homing_cycle_start_no_set(void);						// G28.4
 stat_t cm_homing_callback(void);								// G28.2/.4 main loop callback
 
 // Probe cycles
-stat_t cm_straight_probe(float target[], float flags[]);		// G38.2
+stat_t cm_straight_probe(float target[], float flags[], bool probe_away, bool alarm_on_miss); // G38.2 - G38.5
 stat_t cm_probe_callback(void);									// G38.2 main loop callback
+stat_t cm_probe_grid(float target[], float flags[], float points[], float points_flags[]); // G29
+stat_t cm_clear_probe_grid(void);								// G29.1
+stat_t cm_probe_grid_callback(void);							// G29 main loop callback
+
+// Job resume
+stat_t cm_fast_forward_resume(void);							// $ff - move to the resume line and run it
+void cm_abort_probe_grid(void);
+const float *cm_grid_compensate(const float target[], float compensated[]);
+
+// Canned cycles
+stat_t cm_set_retract_mode(uint8_t mode);						// G98, G99
+stat_t cm_canned_cycle(float target[], float flags[], uint8_t motion_mode); // G73, G81, G82, G83
+stat_t cm_canned_cycle_callback(void);							// drilling cycle main loop callback
+void cm_abort_canned_cycle(void);
 
 // Jogging cycle
 stat_t cm_jogging_callback(void);								// jogging cycle main loop
 stat_t cm_jogging_cycle_start(uint8_t axis);					// {"jogx":-100.3}
 float cm_get_jogging_dest(void);
+stat_t cm_jogging_velocity(void);								// {"jgv":{"x":1200,"y":0}}
+
+// Tuning cycle
+stat_t cm_tuning_callback(void);								// tuning cycle main loop
+stat_t cm_tuning_cycle_start(uint8_t axis);						// {"tunx":20}
 
 /*--- cfgArray interface functions ---*/
 
@@ -712,11 +926,38 @@ stat_t cm_run_jogx(nvObj_t *nv);		// start jogging cycle for x
 stat_t cm_run_jogy(nvObj_t *nv);		// start jogging cycle for y
 stat_t cm_run_jogz(nvObj_t *nv);		// start jogging cycle for z
 stat_t cm_run_joga(nvObj_t *nv);		// start jogging cycle for a
+stat_t cm_run_jogv(nvObj_t *nv);		// set a velocity jog target and start or update the jog
+stat_t cm_run_tunx(nvObj_t *nv);		// start tuning cycle for x
+stat_t cm_run_tuny(nvObj_t *nv);		// start tuning cycle for y
+stat_t cm_run_tunz(nvObj_t *nv);		// start tuning cycle for z
+stat_t cm_run_tuna(nvObj_t *nv);		// start tuning cycle for a
+stat_t cm_set_tum(nvObj_t *nv);			// set tuning margin
 
 stat_t cm_get_am(nvObj_t *nv);			// get axis mode
 stat_t cm_set_am(nvObj_t *nv);			// set axis mode
+stat_t cm_set_ra(nvObj_t *nv);			// set rotary axis radius and its cached scale
+stat_t cm_set_tl(nvObj_t *nv);			// set travel min or max (soft limits)
+stat_t cm_set_cofs(nvObj_t *nv);		// set a coordinate system offset
+stat_t cm_set_tt(nvObj_t *nv);			// set a tool table length or diameter
+stat_t cm_set_ff(nvObj_t *nv);			// set the job resume line (fast forward)
+stat_t cm_get_ckp(nvObj_t *nv);			// report the power loss checkpoint
+stat_t cm_set_sl(nvObj_t *nv);			// set soft limit enable
 stat_t cm_set_xjm(nvObj_t *nv);			// set jerk max with 1,000,000 correction
 stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
+stat_t cm_set_xvm(nvObj_t *nv);			// set velocity max (staged for the runtime)
+void cm_update_axis_jerk(void);			// recompute the axis jerk reciprocals
+stat_t cm_set_ja(nvObj_t *nv);			// set junction acceleration
+stat_t cm_set_jd(nvObj_t *nv);			// set axis junction deviation
+void cm_update_junction_limits(void);	// recompute the axis junction limits
+void cm_update_step_velocity(void);		// recompute the axis step rate velocity limits
+stat_t cm_get_vs(nvObj_t *nv);			// get an axis step rate velocity limit
+stat_t cm_set_xif(nvObj_t *nv);			// set input shaper frequency
+stat_t cm_set_xiz(nvObj_t *nv);			// set input shaper damping ratio
+stat_t cm_set_lfi(nvObj_t *nv);			// set adaptive feed load input
+stat_t cm_set_lfn(nvObj_t *nv);			// set an adaptive feed factor limit
+stat_t cm_set_thi(nvObj_t *nv);			// set torch height control voltage input
+stat_t cm_set_thd(nvObj_t *nv);			// set torch height control anti-dive velocity fraction
+stat_t cm_set_pax(nvObj_t *nv);			// set pressure advance extruder axis
 
 /*--- text_mode support functions ---*/
 
@@ -739,6 +980,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_dist(nvObj_t *nv);
 	void cm_print_frmo(nvObj_t *nv);
 	void cm_print_tool(nvObj_t *nv);
+	void cm_print_ff(nvObj_t *nv);
 
 	void cm_print_gpl(nvObj_t *nv);		// Gcode defaults
 	void cm_print_gun(nvObj_t *nv);
@@ -753,7 +995,51 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	void cm_print_ja(nvObj_t *nv);		// global CM settings
 	void cm_print_ct(nvObj_t *nv);
+	void cm_print_lt(nvObj_t *nv);
+	void cm_print_qg(nvObj_t *nv);
+	void cm_print_pb(nvObj_t *nv);
+	void cm_print_pt(nvObj_t *nv);
+	void cm_print_px(nvObj_t *nv);
 	void cm_print_sl(nvObj_t *nv);
+	void cm_print_sc(nvObj_t *nv);
+	void cm_print_tum(nvObj_t *nv);
+	void cm_print_tuw(nvObj_t *nv);
+	void cm_print_plv(nvObj_t *nv);
+	void cm_print_plb(nvObj_t *nv);
+	void cm_print_cpi(nvObj_t *nv);
+	void cm_print_lfi(nvObj_t *nv);
+	void cm_print_lfl(nvObj_t *nv);
+	void cm_print_lfh(nvObj_t *nv);
+	void cm_print_lfn(nvObj_t *nv);
+	void cm_print_lfx(nvObj_t *nv);
+	void cm_print_lff(nvObj_t *nv);
+	void cm_print_thi(nvObj_t *nv);
+	void cm_print_thv(nvObj_t *nv);
+	void cm_print_thg(nvObj_t *nv);
+	void cm_print_thr(nvObj_t *nv);
+	void cm_print_thl(nvObj_t *nv);
+	void cm_print_thd(nvObj_t *nv);
+	void cm_print_tho(nvObj_t *nv);
+	void cm_print_pax(nvObj_t *nv);
+	void cm_print_pak(nvObj_t *nv);
+	void cm_print_pao(nvObj_t *nv);
+	void cm_print_rtl(nvObj_t *nv);
+	void cm_print_rtv(nvObj_t *nv);
+	void cm_print_rto(nvObj_t *nv);
+	void cm_print_kin(nvObj_t *nv);
+	void cm_print_kdr(nvObj_t *nv);
+	void cm_print_kdl(nvObj_t *nv);
+	void cm_print_kpx(nvObj_t *nv);
+	void cm_print_kpy(nvObj_t *nv);
+	void cm_print_kpz(nvObj_t *nv);
+	void cm_print_pcs(nvObj_t *nv);
+	void cm_print_pcd(nvObj_t *nv);
+	void cm_print_pcn(nvObj_t *nv);
+	void cm_print_sk(nvObj_t *nv);
+	void cm_print_prjk(nvObj_t *nv);
+	void cm_print_prja(nvObj_t *nv);
+	void cm_print_prst(nvObj_t *nv);
+	void cm_print_prct(nvObj_t *nv);
 	void cm_print_ml(nvObj_t *nv);
 	void cm_print_ma(nvObj_t *nv);
 	void cm_print_ms(nvObj_t *nv);
@@ -767,6 +1053,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_jm(nvObj_t *nv);
 	void cm_print_jh(nvObj_t *nv);
 	void cm_print_jd(nvObj_t *nv);
+	void cm_print_vs(nvObj_t *nv);
 	void cm_print_ra(nvObj_t *nv);
 	void cm_print_sn(nvObj_t *nv);
 	void cm_print_sx(nvObj_t *nv);
@@ -774,8 +1061,15 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	void cm_print_lv(nvObj_t *nv);
 	void cm_print_lb(nvObj_t *nv);
 	void cm_print_zb(nvObj_t *nv);
+	void cm_print_hg(nvObj_t *nv);
+	void cm_print_hw(nvObj_t *nv);
+	void cm_print_it(nvObj_t *nv);
+	void cm_print_if(nvObj_t *nv);
+	void cm_print_iz(nvObj_t *nv);
 	void cm_print_cofs(nvObj_t *nv);
 	void cm_print_cpos(nvObj_t *nv);
+	void cm_print_ttl(nvObj_t *nv);
+	void cm_print_ttd(nvObj_t *nv);
 
 #else // __TEXT_MODE
 
@@ -796,6 +1090,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_dist tx_print_stub
 	#define cm_print_frmo tx_print_stub
 	#define cm_print_tool tx_print_stub
+	#define cm_print_ff tx_print_stub
 
 	#define cm_print_gpl tx_print_stub		// Gcode defaults
 	#define cm_print_gun tx_print_stub
@@ -810,7 +1105,51 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 
 	#define cm_print_ja tx_print_stub		// global CM settings
 	#define cm_print_ct tx_print_stub
+	#define cm_print_lt tx_print_stub
+	#define cm_print_qg tx_print_stub
+	#define cm_print_pb tx_print_stub
+	#define cm_print_pt tx_print_stub
+	#define cm_print_px tx_print_stub
 	#define cm_print_sl tx_print_stub
+	#define cm_print_sc tx_print_stub
+	#define cm_print_tum tx_print_stub
+	#define cm_print_tuw tx_print_stub
+	#define cm_print_plv tx_print_stub
+	#define cm_print_plb tx_print_stub
+	#define cm_print_cpi tx_print_stub
+	#define cm_print_lfi tx_print_stub
+	#define cm_print_lfl tx_print_stub
+	#define cm_print_lfh tx_print_stub
+	#define cm_print_lfn tx_print_stub
+	#define cm_print_lfx tx_print_stub
+	#define cm_print_lff tx_print_stub
+	#define cm_print_thi tx_print_stub
+	#define cm_print_thv tx_print_stub
+	#define cm_print_thg tx_print_stub
+	#define cm_print_thr tx_print_stub
+	#define cm_print_thl tx_print_stub
+	#define cm_print_thd tx_print_stub
+	#define cm_print_tho tx_print_stub
+	#define cm_print_pax tx_print_stub
+	#define cm_print_pak tx_print_stub
+	#define cm_print_pao tx_print_stub
+	#define cm_print_rtl tx_print_stub
+	#define cm_print_rtv tx_print_stub
+	#define cm_print_rto tx_print_stub
+	#define cm_print_kin tx_print_stub
+	#define cm_print_kdr tx_print_stub
+	#define cm_print_kdl tx_print_stub
+	#define cm_print_kpx tx_print_stub
+	#define cm_print_kpy tx_print_stub
+	#define cm_print_kpz tx_print_stub
+	#define cm_print_pcs tx_print_stub
+	#define cm_print_pcd tx_print_stub
+	#define cm_print_pcn tx_print_stub
+	#define cm_print_sk tx_print_stub
+	#define cm_print_prjk tx_print_stub
+	#define cm_print_prja tx_print_stub
+	#define cm_print_prst tx_print_stub
+	#define cm_print_prct tx_print_stub
 	#define cm_print_ml tx_print_stub
 	#define cm_print_ma tx_print_stub
 	#define cm_print_ms tx_print_stub
@@ -824,6 +1163,7 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_jm tx_print_stub
 	#define cm_print_jh tx_print_stub
 	#define cm_print_jd tx_print_stub
+	#define cm_print_vs tx_print_stub
 	#define cm_print_ra tx_print_stub
 	#define cm_print_sn tx_print_stub
 	#define cm_print_sx tx_print_stub
@@ -831,8 +1171,15 @@ stat_t cm_set_xjh(nvObj_t *nv);			// set jerk homing with 1,000,000 correction
 	#define cm_print_lv tx_print_stub
 	#define cm_print_lb tx_print_stub
 	#define cm_print_zb tx_print_stub
+	#define cm_print_hg tx_print_stub
+	#define cm_print_hw tx_print_stub
+	#define cm_print_it tx_print_stub
+	#define cm_print_if tx_print_stub
+	#define cm_print_iz tx_print_stub
 	#define cm_print_cofs tx_print_stub
 	#define cm_print_cpos tx_print_stub
+	#define cm_print_ttl tx_print_stub
+	#define cm_print_ttd tx_print_stub
 
 #endif // __TEXT_MODE
 /*
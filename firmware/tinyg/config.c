@@ -46,6 +46,7 @@ extern "C"{
 #endif
 
 static void _set_defa(nvObj_t *nv);
+static void _load_profile(nvObj_t *nv);
 
 /***********************************************************************************
  **** STRUCTURE ALLOCATIONS ********************************************************
@@ -132,16 +133,63 @@ void config_init()
 		_set_defa(nv);
 	} else {									// case (2) NVM is setup and in revision
 		rpt_print_loading_configs_message();
-		for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
-			if (GET_TABLE_BYTE(flags) & F_INITIALIZE) {
-				strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN);	// read the token from the array
-				read_persistent_value(nv);
-				nv_set(nv);
-			}
+		_load_profile(nv);						// status reports are set up after ready (see _deferred_init())
+	}
+#endif
+}
+
+/*
+ * _load_profile() - set every initialized value from the active NVM profile
+ * config_reload_profile() - load the active profile again, keeping the host's comm mode and units
+ * set_pro() 	   - switch to another stored machine profile and load it
+ *
+ *	Switching is refused while the machine is moving or a config transaction is open
+ *	(see persistence_select_profile()). After the load the Gcode defaults are re-applied
+ *	as at program end, as the new profile may carry different ones.
+ */
+
+static void _load_profile(nvObj_t *nv)
+{
+	cfgItem_t item;
+	cm_set_units_mode(MILLIMETERS);				// NVM values are in canonical units
+	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
+		GET_TABLE_ITEM(nv->index, &item);
+		if (item.flags & F_INITIALIZE) {
+			strncpy(nv->token, item.token, TOKEN_LEN);	// the token from the array
+			read_persistent_value(nv);
+			nv_set(nv);
 		}
-		sr_init_status_report();
 	}
+	config_update_derived();					// once for the whole profile
+}
+
+void config_reload_profile()
+{
+	nvObj_t load;								// the caller's nv is still needed for the response
+	uint8_t units = cm_get_units_mode(MODEL);
+	uint8_t comm_mode = cfg.comm_mode;			// keep talking the way the host is talking
+
+	memset(&load, 0, sizeof(nvObj_t));
+	_load_profile(&load);
+
+	cfg.comm_mode = comm_mode;
+	cm_set_units_mode(units);
+	cm_set_coord_system(cm.coord_system);		// Gcode defaults from the profile
+	cm_select_plane(cm.select_plane);
+	cm_set_path_control(cm.path_control);
+	cm_set_distance_mode(cm.distance_mode);
+}
+
+stat_t set_pro(nvObj_t *nv)
+{
+#ifdef __AVR
+	if ((nv->value < 0) || (nv->value >= NVM_PROFILES)) return (STAT_INPUT_VALUE_RANGE_ERROR);
+	ritorno(persistence_select_profile((uint8_t)nv->value));
+	config_reload_profile();
 #endif
+	nv->value = nvm.profile;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
 }
 
 /*
@@ -151,15 +199,18 @@ void config_init()
 
 static void _set_defa(nvObj_t *nv)
 {
+	cfgItem_t item;
 	cm_set_units_mode(MILLIMETERS);				// must do inits in MM mode
 	for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
-		if (GET_TABLE_BYTE(flags) & F_INITIALIZE) {
-			nv->value = GET_TABLE_FLOAT(def_value);
-			strncpy_P(nv->token, cfgArray[nv->index].token, TOKEN_LEN);
+		GET_TABLE_ITEM(nv->index, &item);
+		if (item.flags & F_INITIALIZE) {
+			nv->value = item.def_value;
+			strncpy(nv->token, item.token, TOKEN_LEN);
 			nv_set(nv);
 			nv_persist(nv);
 		}
 	}
+	config_update_derived();					// once for the whole set of defaults
 	sr_init_status_report();					// reset status reports
 	rpt_print_initializing_message();			// don't start TX until all the NVM persistence is done
 }
@@ -244,7 +295,7 @@ stat_t get_data(nvObj_t *nv)
 stat_t get_flt(nvObj_t *nv)
 {
 	nv->value = *((float *)GET_TABLE_WORD(target));
-	nv->precision = (int8_t)GET_TABLE_WORD(precision);
+	nv->precision = (int8_t)GET_TABLE_BYTE(precision);
 	nv->valuetype = TYPE_FLOAT;
 	return (STAT_OK);
 }
@@ -307,7 +358,7 @@ stat_t set_data(nvObj_t *nv)
 stat_t set_flt(nvObj_t *nv)
 {
 	*((float *)GET_TABLE_WORD(target)) = nv->value;
-	nv->precision = GET_TABLE_WORD(precision);
+	nv->precision = (int8_t)GET_TABLE_BYTE(precision);
 	nv->valuetype = TYPE_FLOAT;
 	return(STAT_OK);
 }
@@ -350,16 +401,31 @@ stat_t set_flt(nvObj_t *nv)
  *
  *	The sys group is an exception where the children carry a blank group field, even though
  *	the sys parent is labeled as a TYPE_PARENT.
+ *
+ *	A group can have more children than the body holds (the sys group does). In text mode
+ *	a full body is printed and the list restarted so the listing continues; in JSON mode
+ *	the response is cut off at the body limit and STAT_JSON_TOO_MANY_PAIRS is returned.
  */
 
 stat_t get_grp(nvObj_t *nv)
 {
-	char_t *parent_group = nv->token;				// token in the parent nv object is the group
+	char_t parent_group[TOKEN_LEN+1];				// token in the parent nv object is the group
 	char_t group[GROUP_LEN+1];						// group string retrieved from cfgArray child
+	uint8_t children = 0;
+
+	strncpy(parent_group, nv->token, TOKEN_LEN+1);	// the token is lost if the list is restarted
 	nv->valuetype = TYPE_PARENT;					// make first object the parent
 	for (index_t i=0; nv_index_is_single(i); i++) {
 		strcpy_P(group, cfgArray[i].group);			// don't need strncpy as it's always terminated
 		if (strcmp(parent_group, group) != 0) continue;
+		if (++children >= NV_MAX_OBJECTS) {			// body is full
+			if (cfg.comm_mode != TEXT_MODE) { return (STAT_JSON_TOO_MANY_PAIRS);}
+			nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+			nv = nv_reset_nv_list();
+			strcpy(nv->token, parent_group);
+			nv->valuetype = TYPE_PARENT;
+			children = 1;
+		}
 		(++nv)->index = i;
 		nv_get_nvObj(nv);
 	}
@@ -394,6 +460,122 @@ stat_t set_grp(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+/*
+ * nv_stream_start()	- begin a new list of groups to dump
+ * nv_stream_add()		- add a group to the list by its token
+ * nv_stream_run()		- start the dump in text mode, or print it all in JSON mode
+ * nv_stream_callback()	- print the next values of a running dump as TX room allows
+ * nv_stream_drain()	- print the rest of a dump now (for output that can't wait)
+ * nv_stream_active()	- true while a dump is running
+ *
+ *	A text mode group display ($x, $sys) or uber-group ($$, $m, $q, $o) prints a line
+ *	per value. $$ is several hundred lines, many times what the TX buffer holds, and
+ *	printing it in one go waited on the transmitter for seconds with the controller
+ *	stopped. Now the command only lists the groups and returns, and nv_stream_callback()
+ *	prints up to NV_STREAM_LINES values per controller pass while NV_STREAM_TX_FREE chars
+ *	are free. The planner, feedhold and the other tasks ahead of it in the dispatch list
+ *	keep running. No command is read until the dump ends, so no response lands in the
+ *	middle of it, and the prompt of the dump command is held back until its last line
+ *	(see text_response()).
+ *
+ *	JSON mode has no uber-groups and a group is a one line response, so a dump started in
+ *	JSON mode is printed at once, a group per response, as before. The command's own
+ *	response follows, holding just its token - it used to be built on the list the last
+ *	group left behind, which that group's footer had cut short.
+ */
+typedef struct nvStream {
+	index_t group[NV_STREAM_GROUPS];		// groups to dump, in order
+	uint8_t count;							// groups in the list
+	uint8_t next;							// list position of the group being printed
+	index_t child;							// next cfgArray index to test for a child of that group
+	uint8_t active;
+} nvStream_t;
+static nvStream_t nvs;
+
+void nv_stream_start()
+{
+	nvs.count = 0;
+	nvs.next = 0;
+	nvs.child = 0;
+	nvs.active = false;
+}
+
+void nv_stream_add(const char_t *token)
+{
+	index_t index = nv_get_index((const char_t *)"", token);
+	if ((index == NO_MATCH) || (nvs.count >= NV_STREAM_GROUPS)) return;
+	nvs.group[nvs.count++] = index;
+}
+
+uint8_t nv_stream_active() { return (nvs.active);}
+
+static uint8_t _stream_step()		// print the next value (text) or group (JSON) - false when done
+{
+	char_t parent[TOKEN_LEN+1];
+	char_t group[GROUP_LEN+1];
+	nvObj_t *nv;
+
+	while (nvs.next < nvs.count) {
+		if (cfg.comm_mode == JSON_MODE) {
+			nv = nv_reset_nv_list();
+			nv->index = nvs.group[nvs.next++];
+			nv_get_nvObj(nv);						// get_grp() populates the body
+			nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+			return (true);
+		}
+		strcpy_P(parent, cfgArray[nvs.group[nvs.next]].token);
+		while (nv_index_is_single(nvs.child)) {		// same children as get_grp() finds
+			index_t i = nvs.child++;
+			strcpy_P(group, cfgArray[i].group);
+			if (strcmp(parent, group) != 0) continue;
+			nv = nv_reset_nv_list();
+			nv->index = i;
+			nv_get_nvObj(nv);
+			nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+			return (true);
+		}
+		nvs.next++;
+		nvs.child = 0;
+	}
+	return (false);
+}
+
+stat_t nv_stream_run(nvObj_t *nv)
+{
+	if (cfg.comm_mode == JSON_MODE) {
+		char_t token[TOKEN_LEN+1];
+		strcpy(token, nv->token);
+		while (_stream_step() == true);
+		nv = nv_reset_nv_list();					// the command answers with its own token
+		strcpy(nv->token, token);
+		nv->valuetype = TYPE_NULL;
+		return (STAT_OK);
+	}
+	nvs.active = true;
+	return (STAT_COMPLETE);
+}
+
+void nv_stream_drain()
+{
+	while (_stream_step() == true);
+	nvs.active = false;
+}
+
+stat_t nv_stream_callback()
+{
+	if (nvs.active == false) return (STAT_NOOP);
+	for (uint8_t i=0; i<NV_STREAM_LINES; i++) {
+		if (xio_get_usb_tx_free() < NV_STREAM_TX_FREE) return (STAT_EAGAIN);
+		if (_stream_step() == false) {
+			nvs.active = false;
+			text_response(STAT_OK, (char_t *)"");	// the prompt text_response() held back
+			return (STAT_OK);
+		}
+	}
+	controller_post_event(EVENT_PASS);
+	return (STAT_EAGAIN);
+}
+
 /*
  * nv_group_is_prefixed() - hack
  *
@@ -418,30 +600,52 @@ uint8_t nv_group_is_prefixed(char_t *group)
 /* nv_get_index() - get index from mnenonic token + group
  *
  * nv_get_index() is the most expensive routine in the whole config. It does a
- * linear table scan of the PROGMEM strings, which of course could be further
- * optimized with indexes or hashing.
+ * linear table scan of the PROGMEM strings. To keep that off the common path
+ * each index found is kept in a small hash cache (NV_INDEX_CACHE_SIZE entries).
+ * A cached index is checked against its PROGMEM token, so a collision or a
+ * stale entry just falls through to the scan. Repeated tokens - gc, n, sr and
+ * whatever the host keeps asking for - then cost one compare, however big the
+ * table gets.
  */
-index_t nv_get_index(const char_t *group, const char_t *token)
+static index_t nv_index_cache[NV_INDEX_CACHE_SIZE];	// zeroed at reset - index 0 is checked like any other
+
+static uint8_t _token_matches(const index_t i, const char_t *str)
 {
 	char_t c;
+	if ((c = GET_TOKEN_BYTE(token[0])) != str[0]) {	return (false); }			// 1st character mismatch
+	if ((c = GET_TOKEN_BYTE(token[1])) == NUL) { return (str[1] == NUL);}		// one character match
+	if (c != str[1]) return (false);											// 2nd character mismatch
+	if ((c = GET_TOKEN_BYTE(token[2])) == NUL) { return (str[2] == NUL);}		// two character match
+	if (c != str[2]) return (false);											// 3rd character mismatch
+	if ((c = GET_TOKEN_BYTE(token[3])) == NUL) { return (str[3] == NUL);}		// three character match
+	if (c != str[3]) return (false);											// 4th character mismatch
+	if ((c = GET_TOKEN_BYTE(token[4])) == NUL) { return (str[4] == NUL);}		// four character match
+	if (c != str[4]) return (false);											// 5th character mismatch
+	return (true);																// five character match
+}
+
+index_t nv_get_index(const char_t *group, const char_t *token)
+{
 	char_t str[TOKEN_LEN + GROUP_LEN+1];	// should actually never be more than TOKEN_LEN+1
 	strncpy(str, group, GROUP_LEN+1);
 	strncat(str, token, TOKEN_LEN+1);
 
-	index_t i;
-	index_t index_max = nv_index_max();
+	uint8_t hash = 0;
+	for (uint8_t j=0; (j < TOKEN_LEN) && (str[j] != NUL); j++) {
+		hash = (hash << 1) + hash + str[j];		// hash * 3 + c
+	}
+	hash &= (NV_INDEX_CACHE_SIZE-1);
 
+	index_t i = nv_index_cache[hash];
+	index_t index_max = nv_index_max();
+	if ((i < index_max) && (_token_matches(i, str) == true)) {
+		return (i);
+	}
 	for (i=0; i < index_max; i++) {
-		if ((c = GET_TOKEN_BYTE(token[0])) != str[0]) {	continue; }					// 1st character mismatch
-		if ((c = GET_TOKEN_BYTE(token[1])) == NUL) { if (str[1] == NUL) return(i);}	// one character match
-		if (c != str[1]) continue;													// 2nd character mismatch
-		if ((c = GET_TOKEN_BYTE(token[2])) == NUL) { if (str[2] == NUL) return(i);}	// two character match
-		if (c != str[2]) continue;													// 3rd character mismatch
-		if ((c = GET_TOKEN_BYTE(token[3])) == NUL) { if (str[3] == NUL) return(i);}	// three character match
-		if (c != str[3]) continue;													// 4th character mismatch
-		if ((c = GET_TOKEN_BYTE(token[4])) == NUL) { if (str[4] == NUL) return(i);}	// four character match
-		if (c != str[4]) continue;													// 5th character mismatch
-		return (i);																	// five character match
+		if (_token_matches(i, str) == true) {
+			nv_index_cache[hash] = i;
+			return (i);
+		}
 	}
 	return (NO_MATCH);
 }
@@ -499,18 +703,16 @@ void nv_get_nvObj(nvObj_t *nv)
 	nv_reset_nv(nv);
 	nv->index = tmp;
 
-	strcpy_P(nv->token, cfgArray[nv->index].token); // token field is always terminated
-	strcpy_P(nv->group, cfgArray[nv->index].group); // group field is always terminated
+	cfgItem_t item;
+	GET_TABLE_ITEM(nv->index, &item);		// one block read instead of a read per field
+	strcpy(nv->token, item.token);			// token field is always terminated
 
 	// special processing for system groups and stripping tokens for groups
-	if (nv->group[0] != NUL) {
-		if (GET_TABLE_BYTE(flags) & F_NOSTRIP) {
-			nv->group[0] = NUL;
-		} else {
-			strcpy(nv->token, &nv->token[strlen(nv->group)]); // strip group from the token
-		}
+	if ((item.group[0] != NUL) && ((item.flags & F_NOSTRIP) == 0)) {
+		strcpy(nv->group, item.group);		// group field is always terminated
+		strcpy(nv->token, &nv->token[strlen(nv->group)]); // strip group from the token
 	}
-	((fptrCmd)GET_TABLE_WORD(get))(nv);		// populate the value
+	item.get(nv);							// populate the value
 }
 
 nvObj_t *nv_reset_nv(nvObj_t *nv)			// clear a single nvObj structure
@@ -535,11 +737,21 @@ nvObj_t *nv_reset_nv(nvObj_t *nv)			// clear a single nvObj structure
 	return (nv);							// return pointer to nv as a convenience to callers
 }
 
+/*
+ *	nv_reset_nv_list() only clears the elements the last use dirtied. Lists are filled in
+ *	order from the start of the body, so the clear stops at the first element that is still
+ *	clean (empty with no token or index). A used element is relinked as it is cleared, which
+ *	undoes a list terminated early (e.g. the footer). The list starts out zeroed, which is
+ *	not clean (TYPE_NULL), so the first reset links and clears it all.
+ */
 nvObj_t *nv_reset_nv_list()					// clear the header and response body
 {
 	nvStr.wp = 0;							// reset the shared string
 	nvObj_t *nv = nvl.list;					// set up linked list and initialize elements
 	for (uint8_t i=0; i<NV_LIST_LEN; i++, nv++) {
+		if ((i > 1) && (nv->valuetype == TYPE_EMPTY) && (nv->token[0] == NUL) && (nv->index == 0)) {
+			break;							// nothing from here on was used
+		}
 		nv->pv = (nv-1);					// the ends are bogus & corrected later
 		nv->nx = (nv+1);
 		nv->index = 0;
@@ -547,8 +759,8 @@ nvObj_t *nv_reset_nv_list()					// clear the header and response body
 		nv->precision = 0;
 		nv->valuetype = TYPE_EMPTY;
 		nv->token[0] = NUL;
+		if (i == NV_LIST_LEN-1) { nv->nx = NULL;}	// terminate the list
 	}
-	(--nv)->nx = NULL;
 	nv = nvl.list;							// setup response header element ('r')
 	nv->pv = NULL;
 	nv->depth = 0;
@@ -121,7 +121,8 @@ extern "C"{
  *	pointer to NULL. The terminating element may carry data, and will be processed.
  *
  *	When you use the list you can terminate your own last element, or just leave the EMPTY elements
- *	to be skipped over during output serialization.
+ *	to be skipped over during output serialization. Use the elements in order from the start of
+ *	the body - the reset only clears up to the first element that was left clean.
  *
  * 	We don't use recursion so parent/child nesting relationships are captured in a 'depth' variable,
  *	This must remain consistent if the curlies are to work out. You should not have to track depth
@@ -193,6 +194,10 @@ typedef uint16_t index_t;				// use this if there are > 255 indexed objects
 #define NV_LIST_LEN (NV_BODY_LEN+2)		// +2 allows for a header and a footer
 #define NV_MAX_OBJECTS (NV_BODY_LEN-1)	// maximum number of objects in a body string
 #define NO_MATCH (index_t)0xFFFF
+#define NV_INDEX_CACHE_SIZE 32			// token lookup cache entries - must be a power of 2
+#define NV_STREAM_GROUPS 32				// most groups one dump can list ($$ lists 28)
+#define NV_STREAM_LINES 4				// most values a dump prints per controller pass
+#define NV_STREAM_TX_FREE 80			// TX chars that must be free to print the next value
 #define NV_STATUS_REPORT_LEN NV_MAX_OBJECTS // max number of status report elements - see cfgArray
 											// **** must also line up in cfgArray, se00 - seXX ****
 
@@ -205,7 +210,8 @@ enum tgCommunicationsMode {
 enum flowControl {
 	FLOW_CONTROL_OFF = 0,				// flow control disabled
 	FLOW_CONTROL_XON,					// flow control uses XON/XOFF
-	FLOW_CONTROL_RTS					// flow control uses RTS/CTS
+	FLOW_CONTROL_RTS,					// flow control uses RTS/CTS
+	FLOW_CONTROL_COUNT					// host counts chars; responses carry the free RX bytes
 };
 
 /*
@@ -240,12 +246,14 @@ enum valueType {						// value typing for config and JSON
 #define F_PERSIST 		0x02			// persist this item when set is run
 #define F_NOSTRIP		0x04			// do not strip the group prefix from the token
 #define F_CONVERT		0x08			// set if unit conversion is required
+#define F_APPEND		0x10			// a string value too long for a line may be set in pieces (see json_parse_chunk())
 
 #define _f0				0x00
 #define _fi				(F_INITIALIZE)
 #define _fp				(F_PERSIST)
 #define _fn				(F_NOSTRIP)
 #define _fc				(F_CONVERT)
+#define _fa				(F_APPEND)
 #define _fip			(F_INITIALIZE | F_PERSIST)
 #define _fipc			(F_INITIALIZE | F_PERSIST | F_CONVERT)
 #define _fipn			(F_INITIALIZE | F_PERSIST | F_NOSTRIP)
@@ -312,6 +320,8 @@ extern const cfgItem_t cfgArray[];
 
 void config_init(void);
 stat_t set_defaults(nvObj_t *nv);			// reset config to default values
+void config_reload_profile(void);			// load RAM from the active profile again
+stat_t set_pro(nvObj_t *nv);				// switch to another stored machine profile
 void config_init_assertions(void);
 stat_t config_test_assertions(void);
 
@@ -349,6 +359,14 @@ stat_t get_flt(nvObj_t *nv);				// get floating point value
 stat_t set_grp(nvObj_t *nv);				// set data for a group
 stat_t get_grp(nvObj_t *nv);				// get data for a group
 
+// incremental group and config dumps
+void nv_stream_start(void);					// begin a new list of groups to dump
+void nv_stream_add(const char_t *token);	// add a group to the list
+stat_t nv_stream_run(nvObj_t *nv);			// start the dump for the command in nv
+stat_t nv_stream_callback(void);			// print the next values of a running dump
+void nv_stream_drain(void);					// print the rest of a dump now
+uint8_t nv_stream_active(void);
+
 // nvObj and list functions
 void nv_get_nvObj(nvObj_t *nv);
 nvObj_t *nv_reset_nv(nvObj_t *nv);
@@ -33,10 +33,15 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "settings.h"
+#include "persistence.h"
 #include "planner.h"
 #include "stepper.h"
+#include "encoder.h"
+#include "kinematics.h"
 #include "switch.h"
 #include "pwm.h"
+#include "analog.h"
+#include "perf.h"
 #include "report.h"
 #include "hardware.h"
 #include "test.h"
@@ -72,7 +77,13 @@ static stat_t set_ec(nvObj_t *nv);			// expand CRLF on TX output
 static stat_t set_ee(nvObj_t *nv);			// enable character echo
 static stat_t set_ex(nvObj_t *nv);			// enable XON/XOFF and RTS/CTS flow control
 static stat_t set_baud(nvObj_t *nv);		// set USB baud rate
+static stat_t set_pnm(nvObj_t *nv);			// set the output mirrored to the RS485 pendant
 static stat_t get_rx(nvObj_t *nv);			// get bytes in RX buffer
+static stat_t get_job(nvObj_t *nv);			// get length of the job stored in SPI flash
+static stat_t set_job(nvObj_t *nv);			// upload or run the job stored in SPI flash
+static stat_t get_jcrc(nvObj_t *nv);			// get the CRC-16 of the stored job (or the upload so far)
+static stat_t get_jrc(nvObj_t *nv);				// get the runs of the stored job left
+static stat_t set_jrc(nvObj_t *nv);				// set how many times the stored job runs
 //static stat_t run_sx(nvObj_t *nv);		// send XOFF, XON
 
 /***********************************************************************************
@@ -126,6 +137,10 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "",   "dist",_f0, 0, cm_print_dist, cm_get_dist, set_nul,(float *)&cs.null, 0 },			// distance mode
 	{ "",   "frmo",_f0, 0, cm_print_frmo, cm_get_frmo, set_nul,(float *)&cs.null, 0 },			// feed rate mode
 	{ "",   "tool",_f0, 0, cm_print_tool, cm_get_toolv,set_nul,(float *)&cs.null, 0 },			// active tool
+	{ "",   "ff",  _f0, 0, cm_print_ff,   get_int,     cm_set_ff,(float *)&cm.ff_line, 0 },		// job resume - fast forward to this line
+	{ "",   "dry", _f0, 0, tx_print_int,  get_ui8,     mp_set_dry,(float *)&mb.dry_run, 0 },	// dry run - plan only and report the job time
+	{ "",   "pvw", _f0, 0, tx_print_int,  mp_get_pvw,  set_nul,   (float *)&cs.null, 0 },		// send the planner queue preview; returns moves queued
+	{ "",   "ckp", _f0, 0, tx_print_int,  cm_get_ckp,  set_nul,(float *)&cs.null, 0 },			// power loss checkpoint - send it
 //	{ "",   "tick",_f0, 0, tx_print_int,  get_int,     set_int,(float *)&rtc.sys_ticks, 0 },	// tick count
 
 	{ "mpo","mpox",_f0, 3, cm_print_mpo, cm_get_mpo, set_nul,(float *)&cs.null, 0 },			// X machine position
@@ -164,6 +179,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "prb","prba",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_A], 0 },
 	{ "prb","prbb",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_B], 0 },
 	{ "prb","prbc",_f0, 3, tx_print_nul, get_flt, set_nul,(float *)&cm.probe_results[AXIS_C], 0 },
+	{ "prb","prbg",_f0, 0, tx_print_nul, get_ui8, set_nul,(float *)&cm.grid_compensation, 0 },	// G29 height map applied
 
 	{ "jog","jogx",_f0, 0, tx_print_nul, get_nul, cm_run_jogx, (float *)&cm.jogging_dest, 0},
 	{ "jog","jogy",_f0, 0, tx_print_nul, get_nul, cm_run_jogy, (float *)&cm.jogging_dest, 0},
@@ -171,6 +187,17 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "jog","joga",_f0, 0, tx_print_nul, get_nul, cm_run_joga, (float *)&cm.jogging_dest, 0},
 //	{ "jog","jogb",_f0, 0, tx_print_nul, get_nul, cm_run_jogb, (float *)&cm.jogging_dest, 0},
 //	{ "jog","jogc",_f0, 0, tx_print_nul, get_nul, cm_run_jogc, (float *)&cm.jogging_dest, 0},
+	{ "jgv","jgvx",_f0, 0, tx_print_nul, get_flt, cm_run_jogv, (float *)&cm.jog_velocity[AXIS_X], 0},	// velocity jog
+	{ "jgv","jgvy",_f0, 0, tx_print_nul, get_flt, cm_run_jogv, (float *)&cm.jog_velocity[AXIS_Y], 0},
+	{ "jgv","jgvz",_f0, 0, tx_print_nul, get_flt, cm_run_jogv, (float *)&cm.jog_velocity[AXIS_Z], 0},
+	{ "jgv","jgva",_f0, 0, tx_print_nul, get_flt, cm_run_jogv, (float *)&cm.jog_velocity[AXIS_A], 0},
+
+	{ "tun","tunx",_f0, 0, tx_print_nul, get_nul, cm_run_tunx, (float *)&cm.tuning_travel, 0},	// tuning cycle
+	{ "tun","tuny",_f0, 0, tx_print_nul, get_nul, cm_run_tuny, (float *)&cm.tuning_travel, 0},
+	{ "tun","tunz",_f0, 0, tx_print_nul, get_nul, cm_run_tunz, (float *)&cm.tuning_travel, 0},
+	{ "tun","tuna",_f0, 0, tx_print_nul, get_nul, cm_run_tuna, (float *)&cm.tuning_travel, 0},
+	{ "tun","tunj",_f0, 0, tx_print_nul, get_flt, set_nul, (float *)&cm.tuning_jerk, 0},		// tuning results
+	{ "tun","tunv",_f0, 0, tx_print_nul, get_flt, set_nul, (float *)&cm.tuning_velocity, 0},
 
 	{ "pwr","pwr1",_f0, 0, st_print_pwr, st_get_pwr, set_nul, (float *)&cs.null, 0},	// motor power enable readouts
 	{ "pwr","pwr2",_f0, 0, st_print_pwr, st_get_pwr, set_nul, (float *)&cs.null, 0},
@@ -183,20 +210,45 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "pwr","pwr6",_f0, 0, st_print_pwr, st_get_pwr, set_nul, (float *)&cs.null, 0},
 #endif
 
+	{ "mem","memf",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// free RAM now (bytes)
+	{ "mem","meml",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// least free RAM since reset - the stack high water mark
+	{ "mem","memd",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// all static data (.data and .bss)
+	{ "mem","memp",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// planner static allocation
+	{ "mem","memv",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// config nvList static allocation
+	{ "mem","memx",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// xio static allocation
+	{ "mem","memc",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// controller static allocation
+	{ "mem","memm",_f0, 0, tx_print_int, hw_get_mem, set_nul, (float *)&cs.null, 0},	// canonical machine static allocation
+
 	// Reports, tests, help, and messages
 	{ "", "sr",  _f0, 0, sr_print_sr,  sr_get,  sr_set,   (float *)&cs.null, 0 },	// status report object
 	{ "", "qr",  _f0, 0, qr_print_qr,  qr_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - planner buffers available
 	{ "", "qi",  _f0, 0, qr_print_qi,  qi_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - buffers added to queue
 	{ "", "qo",  _f0, 0, qr_print_qo,  qo_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - buffers removed from queue
+	{ "", "qt",  _f0, 0, qr_print_qt,  qt_get,  set_nul,  (float *)&cs.null, 0 },	// queue report - time queued in the planner (ms)
 	{ "", "er",  _f0, 0, tx_print_nul, rpt_er,  set_nul,  (float *)&cs.null, 0 },	// invoke bogus exception report for testing
+	{ "", "exl", _f0, 0, tx_print_int, rpt_get_exl, rpt_set_exl,(float *)&cs.null, 0 },	// exception log - set to clear
+	{ "", "exs", _f0, 0, tx_print_int, rpt_get_exs, rpt_set_exs,(float *)&cs.null, 0 },	// exceptions saved at the last hard alarm - set to erase
+	{ "", "tra", _f0, 0, tx_print_ui8, get_ui8, mp_set_tra,(float *)&mp_trace.divider, 0 },	// motion trace - record every Nth segment, 0=off
+	{ "", "jpr", _f0, 0, tx_print_int, jp_get_jpr,set_nul,(float *)&cs.null, 0 },	// job profile - send report now
+	{ "", "trd", _f0, 0, tx_print_int, mp_get_trd,set_nul,(float *)&cs.null, 0 },	// motion trace - dump records
+	{ "", "rst", _fa, 0, tx_print_int, mp_get_rst,mp_set_rst,(float *)&cs.null, 0 },	// raster pixels for the next G1 (hex); returns pixels free
 	{ "", "qf",  _f0, 0, tx_print_nul, get_nul, cm_run_qf,(float *)&cs.null, 0 },	// queue flush
+	{ "", "txn", _f0, 0, tx_print_ui8, get_ui8, persistence_set_txn,(float *)&nvm.txn_open, 0 },	// config transaction: 1=begin, 2=commit, 0=abort
+	{ "", "pro", _f0, 0, tx_print_ui8, get_ui8, set_pro,  (float *)&nvm.profile, 0 },	// active machine profile - set to switch
+	{ "", "snap",_f0, 0, tx_print_int, persistence_get_snapshot, persistence_set_snapshot,(float *)&cs.null, 0 },	// config snapshot: GET exports, 1 begins an import, 0 abandons it
 	{ "", "rx",  _f0, 0, tx_print_int, get_rx,  set_nul,  (float *)&cs.null, 0 },	// space in RX buffer
+	{ "", "job", _f0, 0, tx_print_int, get_job, set_job,  (float *)&cs.null, 0 },	// stored job: 1=upload, 0=end upload, 2=run; returns its length
+	{ "", "jcrc",_f0, 0, tx_print_int, get_jcrc,set_nul,  (float *)&cs.null, 0 },	// CRC-16 of the stored job, or of the upload so far
+	{ "", "jrc", _f0, 0, tx_print_int, get_jrc, set_jrc,  (float *)&cs.null, 0 },	// stored job run count; returns the runs left
 	{ "", "msg", _f0, 0, tx_print_str, get_nul, set_nul,  (float *)&cs.null, 0 },	// string for generic messages
 //	{ "", "clc", _f0, 0, tx_print_nul, st_clc,  st_clc,   (float *)&cs.null, 0 },	// clear diagnostic step counters
 	{ "", "clear",_f0,0, tx_print_nul, cm_clear,cm_clear, (float *)&cs.null, 0 },	// GET a clear to clear soft alarm
 //	{ "", "sx",  _f0, 0, tx_print_nul, run_sx,  run_sx ,  (float *)&cs.null, 0 },	// send XOFF, XON test
 
 	{ "", "test",_f0, 0, tx_print_nul, help_test, run_test, (float *)&cs.null,0 },	// run tests, print test help screen
+#ifdef __BENCHMARKS
+	{ "", "bench",_f0,0, tx_print_int, run_bench, set_nul,(float *)&cs.null,0 },	// GET runs the micro-benchmarks (see test.c)
+#endif
 	{ "", "defa",_f0, 0, tx_print_nul, help_defa, set_defaults,(float *)&cs.null,0 },	// set/print defaults / help screen
 	{ "", "boot",_f0, 0, tx_print_nul, help_boot_loader,hw_run_boot, (float *)&cs.null,0 },
 
@@ -206,79 +258,134 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 	// Motor parameters
-	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
+	{ "1","1ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_1].motor_map,	M1_MOTOR_MAP },
 	{ "1","1sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_1].step_angle,	M1_STEP_ANGLE },
 	{ "1","1tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_1].travel_rev,	M1_TRAVEL_PER_REV },
 	{ "1","1mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_1].microsteps,	M1_MICROSTEPS },
 	{ "1","1po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_1].polarity,	M1_POLARITY },
 	{ "1","1pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_1].power_mode,	M1_POWER_MODE },
+	{ "1","1bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_1].backlash,	M1_BACKLASH },
+	{ "1","1sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_1].square_switches,	M1_SQUARE_SWITCHES },
+	{ "1","1ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_1].counts_per_rev,	M1_ENCODER_COUNTS },
+	{ "1","1fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_1].following_error_limit,	M1_FOLLOWING_ERROR_LIMIT },
+	{ "1","1ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_1].correction_threshold,	M1_CORRECTION_THRESHOLD },
+	{ "1","1cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_1].correction_factor,	M1_CORRECTION_FACTOR },
+	{ "1","1cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_1].correction_max,	M1_CORRECTION_MAX },
 #ifdef __ARM
 	{ "1","1pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_1].power_level,M1_POWER_LEVEL },
+	{ "1","1pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_1].power_boost,M1_POWER_BOOST },
+	{ "1","1pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_1].power_idle,M1_POWER_IDLE },
 #endif
 #if (MOTORS >= 2)
-	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
+	{ "2","2ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_2].motor_map,	M2_MOTOR_MAP },
 	{ "2","2sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_2].step_angle,	M2_STEP_ANGLE },
 	{ "2","2tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_2].travel_rev,	M2_TRAVEL_PER_REV },
 	{ "2","2mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_2].microsteps,	M2_MICROSTEPS },
 	{ "2","2po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_2].polarity,	M2_POLARITY },
 	{ "2","2pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_2].power_mode,	M2_POWER_MODE },
+	{ "2","2bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_2].backlash,	M2_BACKLASH },
+	{ "2","2sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_2].square_switches,	M2_SQUARE_SWITCHES },
+	{ "2","2ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_2].counts_per_rev,	M2_ENCODER_COUNTS },
+	{ "2","2fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_2].following_error_limit,	M2_FOLLOWING_ERROR_LIMIT },
+	{ "2","2ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_2].correction_threshold,	M2_CORRECTION_THRESHOLD },
+	{ "2","2cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_2].correction_factor,	M2_CORRECTION_FACTOR },
+	{ "2","2cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_2].correction_max,	M2_CORRECTION_MAX },
 #ifdef __ARM
 	{ "2","2pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_2].power_level,M2_POWER_LEVEL},
+	{ "2","2pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_2].power_boost,M2_POWER_BOOST },
+	{ "2","2pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_2].power_idle,M2_POWER_IDLE },
 #endif
 #endif
 #if (MOTORS >= 3)
-	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
+	{ "3","3ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_3].motor_map,	M3_MOTOR_MAP },
 	{ "3","3sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_3].step_angle,	M3_STEP_ANGLE },
 	{ "3","3tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_3].travel_rev,	M3_TRAVEL_PER_REV },
 	{ "3","3mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_3].microsteps,	M3_MICROSTEPS },
 	{ "3","3po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_3].polarity,	M3_POLARITY },
 	{ "3","3pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_3].power_mode,	M3_POWER_MODE },
+	{ "3","3bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_3].backlash,	M3_BACKLASH },
+	{ "3","3sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_3].square_switches,	M3_SQUARE_SWITCHES },
+	{ "3","3ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_3].counts_per_rev,	M3_ENCODER_COUNTS },
+	{ "3","3fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_3].following_error_limit,	M3_FOLLOWING_ERROR_LIMIT },
+	{ "3","3ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_3].correction_threshold,	M3_CORRECTION_THRESHOLD },
+	{ "3","3cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_3].correction_factor,	M3_CORRECTION_FACTOR },
+	{ "3","3cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_3].correction_max,	M3_CORRECTION_MAX },
 #ifdef __ARM
 	{ "3","3pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_3].power_level,M3_POWER_LEVEL },
+	{ "3","3pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_3].power_boost,M3_POWER_BOOST },
+	{ "3","3pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_3].power_idle,M3_POWER_IDLE },
 #endif
 #endif
 #if (MOTORS >= 4)
-	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
+	{ "4","4ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_4].motor_map,	M4_MOTOR_MAP },
 	{ "4","4sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_4].step_angle,	M4_STEP_ANGLE },
 	{ "4","4tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_4].travel_rev,	M4_TRAVEL_PER_REV },
 	{ "4","4mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_4].microsteps,	M4_MICROSTEPS },
 	{ "4","4po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_4].polarity,	M4_POLARITY },
 	{ "4","4pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_4].power_mode,	M4_POWER_MODE },
+	{ "4","4bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_4].backlash,	M4_BACKLASH },
+	{ "4","4sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_4].square_switches,	M4_SQUARE_SWITCHES },
+	{ "4","4ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_4].counts_per_rev,	M4_ENCODER_COUNTS },
+	{ "4","4fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_4].following_error_limit,	M4_FOLLOWING_ERROR_LIMIT },
+	{ "4","4ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_4].correction_threshold,	M4_CORRECTION_THRESHOLD },
+	{ "4","4cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_4].correction_factor,	M4_CORRECTION_FACTOR },
+	{ "4","4cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_4].correction_max,	M4_CORRECTION_MAX },
 #ifdef __ARM
 	{ "4","4pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_4].power_level,M4_POWER_LEVEL },
+	{ "4","4pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_4].power_boost,M4_POWER_BOOST },
+	{ "4","4pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_4].power_idle,M4_POWER_IDLE },
 #endif
 #endif
 #if (MOTORS >= 5)
-	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
+	{ "5","5ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_5].motor_map,	M5_MOTOR_MAP },
 	{ "5","5sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_5].step_angle,	M5_STEP_ANGLE },
 	{ "5","5tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_5].travel_rev,	M5_TRAVEL_PER_REV },
 	{ "5","5mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_5].microsteps,	M5_MICROSTEPS },
 	{ "5","5po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_5].polarity,	M5_POLARITY },
 	{ "5","5pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_5].power_mode,	M5_POWER_MODE },
+	{ "5","5bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_5].backlash,	M5_BACKLASH },
+	{ "5","5sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_5].square_switches,	M5_SQUARE_SWITCHES },
+	{ "5","5ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_5].counts_per_rev,	M5_ENCODER_COUNTS },
+	{ "5","5fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_5].following_error_limit,	M5_FOLLOWING_ERROR_LIMIT },
+	{ "5","5ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_5].correction_threshold,	M5_CORRECTION_THRESHOLD },
+	{ "5","5cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_5].correction_factor,	M5_CORRECTION_FACTOR },
+	{ "5","5cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_5].correction_max,	M5_CORRECTION_MAX },
 #ifdef __ARM
 	{ "5","5pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_5].power_level,M5_POWER_LEVEL },
+	{ "5","5pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_5].power_boost,M5_POWER_BOOST },
+	{ "5","5pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_5].power_idle,M5_POWER_IDLE },
 #endif
 #endif
 #if (MOTORS >= 6)
-	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, set_ui8,   (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
+	{ "6","6ma",_fip, 0, st_print_ma, get_ui8, st_set_ma, (float *)&st_cfg.mot[MOTOR_6].motor_map,	M6_MOTOR_MAP },
 	{ "6","6sa",_fip, 3, st_print_sa, get_flt, st_set_sa, (float *)&st_cfg.mot[MOTOR_6].step_angle,	M6_STEP_ANGLE },
 	{ "6","6tr",_fipc,4, st_print_tr, get_flt, st_set_tr, (float *)&st_cfg.mot[MOTOR_6].travel_rev,	M6_TRAVEL_PER_REV },
 	{ "6","6mi",_fip, 0, st_print_mi, get_ui8, st_set_mi, (float *)&st_cfg.mot[MOTOR_6].microsteps,	M6_MICROSTEPS },
 	{ "6","6po",_fip, 0, st_print_po, get_ui8, set_01,    (float *)&st_cfg.mot[MOTOR_6].polarity,	M6_POLARITY },
 	{ "6","6pm",_fip, 0, st_print_pm, get_ui8, st_set_pm, (float *)&st_cfg.mot[MOTOR_6].power_mode,	M6_POWER_MODE },
+	{ "6","6bl",_fipc,4, st_print_bl, get_flt, set_flu,   (float *)&st_cfg.mot[MOTOR_6].backlash,	M6_BACKLASH },
+	{ "6","6sq",_fip, 0, st_print_sq, get_ui8, st_set_sq, (float *)&st_cfg.mot[MOTOR_6].square_switches,	M6_SQUARE_SWITCHES },
+	{ "6","6ec",_fip, 0, en_print_ec, get_flt, en_set_ec, (float *)&en.en[MOTOR_6].counts_per_rev,	M6_ENCODER_COUNTS },
+	{ "6","6fl",_fip, 0, en_print_fl, get_flt, set_flt,   (float *)&en.en[MOTOR_6].following_error_limit,	M6_FOLLOWING_ERROR_LIMIT },
+	{ "6","6ct",_fip, 2, en_print_ct, get_flt, set_flt,   (float *)&en.en[MOTOR_6].correction_threshold,	M6_CORRECTION_THRESHOLD },
+	{ "6","6cf",_fip, 3, en_print_cf, get_flt, set_flt,   (float *)&en.en[MOTOR_6].correction_factor,	M6_CORRECTION_FACTOR },
+	{ "6","6cm",_fip, 2, en_print_cm, get_flt, set_flt,   (float *)&en.en[MOTOR_6].correction_max,	M6_CORRECTION_MAX },
 #ifdef __ARM
 	{ "6","6pl",_fip, 3, st_print_pl, get_flt, st_set_pl, (float *)&st_cfg.mot[MOTOR_6].power_level,M6_POWER_LEVEL },
+	{ "6","6pb",_fip, 3, st_print_pb, get_flt, st_set_pb, (float *)&st_cfg.mot[MOTOR_6].power_boost,M6_POWER_BOOST },
+	{ "6","6pi",_fip, 3, st_print_pi, get_flt, st_set_pi, (float *)&st_cfg.mot[MOTOR_6].power_idle,M6_POWER_IDLE },
 #endif
 #endif
 	// Axis parameters
 	{ "x","xam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_X].axis_mode,		X_AXIS_MODE },
-	{ "x","xvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].velocity_max,	X_VELOCITY_MAX },
+	{ "x","xvm",_fipc, 0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_X].velocity_max,	X_VELOCITY_MAX },
+	{ "x","xvs",_fc,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_X].step_velocity_max, 0 },
 	{ "x","xfr",_fipc, 0, cm_print_fr, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].feedrate_max,	X_FEEDRATE_MAX },
-	{ "x","xtn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].travel_min,		X_TRAVEL_MIN },
-	{ "x","xtm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].travel_max,		X_TRAVEL_MAX },
+	{ "x","xtn",_fipc, 3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_X].travel_min,		X_TRAVEL_MIN },
+	{ "x","xtm",_fipc, 3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_X].travel_max,		X_TRAVEL_MAX },
 	{ "x","xjm",_fipc, 0, cm_print_jm, get_flt,   cm_set_xjm,(float *)&cm.a[AXIS_X].jerk_max,		X_JERK_MAX },
 	{ "x","xjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_X].jerk_homing,	X_JERK_HOMING },
-	{ "x","xjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].junction_dev,	X_JUNCTION_DEVIATION },
+	{ "x","xjd",_fipc, 4, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_X].junction_dev,	X_JUNCTION_DEVIATION },
 	{ "x","xsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[0],					X_SWITCH_MODE_MIN },
 	{ "x","xsx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.mode[1],					X_SWITCH_MODE_MAX },
 //	{ "x","xsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_X][SW_MIN].mode,	X_SWITCH_MODE_MIN },	// new style
@@ -287,15 +394,21 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "x","xlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_velocity,	X_LATCH_VELOCITY },
 	{ "x","xlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].latch_backoff,	X_LATCH_BACKOFF },
 	{ "x","xzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].zero_backoff,	X_ZERO_BACKOFF },
+	{ "x","xhg",_fip,  0, cm_print_hg, get_ui8,   set_0123,  (float *)&cm.a[AXIS_X].homing_group,	X_HOMING_GROUP },
+	{ "x","xhw",_fipc, 3, cm_print_hw, get_flt,   set_flu,   (float *)&cm.a[AXIS_X].homing_window,	X_HOMING_WINDOW },
+	{ "x","xit",_fip,  0, cm_print_it, get_ui8,   set_0123,  (float *)&cm.a[AXIS_X].shaper_type,	X_SHAPER_TYPE },
+	{ "x","xif",_fip,  1, cm_print_if, get_flt,   cm_set_xif,(float *)&cm.a[AXIS_X].shaper_frequency,X_SHAPER_FREQUENCY },
+	{ "x","xiz",_fip,  3, cm_print_iz, get_flt,   cm_set_xiz,(float *)&cm.a[AXIS_X].shaper_damping,	X_SHAPER_DAMPING },
 
 	{ "y","yam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Y].axis_mode,		Y_AXIS_MODE },
-	{ "y","yvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].velocity_max,	Y_VELOCITY_MAX },
+	{ "y","yvm",_fipc, 0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_Y].velocity_max,	Y_VELOCITY_MAX },
+	{ "y","yvs",_fc,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_Y].step_velocity_max, 0 },
 	{ "y","yfr",_fipc, 0, cm_print_fr, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].feedrate_max,	Y_FEEDRATE_MAX },
-	{ "y","ytn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].travel_min,		Y_TRAVEL_MIN },
-	{ "y","ytm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].travel_max,		Y_TRAVEL_MAX },
+	{ "y","ytn",_fipc, 3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_Y].travel_min,		Y_TRAVEL_MIN },
+	{ "y","ytm",_fipc, 3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_Y].travel_max,		Y_TRAVEL_MAX },
 	{ "y","yjm",_fipc, 0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_Y].jerk_max,		Y_JERK_MAX },
 	{ "y","yjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_Y].jerk_homing,	Y_JERK_HOMING },
-	{ "y","yjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].junction_dev,	Y_JUNCTION_DEVIATION },
+	{ "y","yjd",_fipc, 4, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_Y].junction_dev,	Y_JUNCTION_DEVIATION },
 	{ "y","ysn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[2],					Y_SWITCH_MODE_MIN },
 	{ "y","ysx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.mode[3],					Y_SWITCH_MODE_MAX },
 //	{ "y","ysn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_Y][SW_MIN].mode,	Y_SWITCH_MODE_MIN },	// new style
@@ -304,15 +417,21 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "y","ylv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_velocity,	Y_LATCH_VELOCITY },
 	{ "y","ylb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].latch_backoff,	Y_LATCH_BACKOFF },
 	{ "y","yzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].zero_backoff,	Y_ZERO_BACKOFF },
+	{ "y","yhg",_fip,  0, cm_print_hg, get_ui8,   set_0123,  (float *)&cm.a[AXIS_Y].homing_group,	Y_HOMING_GROUP },
+	{ "y","yhw",_fipc, 3, cm_print_hw, get_flt,   set_flu,   (float *)&cm.a[AXIS_Y].homing_window,	Y_HOMING_WINDOW },
+	{ "y","yit",_fip,  0, cm_print_it, get_ui8,   set_0123,  (float *)&cm.a[AXIS_Y].shaper_type,	Y_SHAPER_TYPE },
+	{ "y","yif",_fip,  1, cm_print_if, get_flt,   cm_set_xif,(float *)&cm.a[AXIS_Y].shaper_frequency,Y_SHAPER_FREQUENCY },
+	{ "y","yiz",_fip,  3, cm_print_iz, get_flt,   cm_set_xiz,(float *)&cm.a[AXIS_Y].shaper_damping,	Y_SHAPER_DAMPING },
 
 	{ "z","zam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_Z].axis_mode,		Z_AXIS_MODE },
-	{ "z","zvm",_fipc, 0, cm_print_vm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].velocity_max,	Z_VELOCITY_MAX },
+	{ "z","zvm",_fipc, 0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_Z].velocity_max,	Z_VELOCITY_MAX },
+	{ "z","zvs",_fc,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_Z].step_velocity_max, 0 },
 	{ "z","zfr",_fipc, 0, cm_print_fr, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].feedrate_max,	Z_FEEDRATE_MAX },
-	{ "z","ztn",_fipc, 3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].travel_min,		Z_TRAVEL_MIN },
-	{ "z","ztm",_fipc, 3, cm_print_tm, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].travel_max,		Z_TRAVEL_MAX },
+	{ "z","ztn",_fipc, 3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_Z].travel_min,		Z_TRAVEL_MIN },
+	{ "z","ztm",_fipc, 3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_Z].travel_max,		Z_TRAVEL_MAX },
 	{ "z","zjm",_fipc, 0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_Z].jerk_max,		Z_JERK_MAX },
 	{ "z","zjh",_fipc, 0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_Z].jerk_homing, 	Z_JERK_HOMING },
-	{ "z","zjd",_fipc, 4, cm_print_jd, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].junction_dev,	Z_JUNCTION_DEVIATION },
+	{ "z","zjd",_fipc, 4, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_Z].junction_dev,	Z_JUNCTION_DEVIATION },
 	{ "z","zsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[4],					Z_SWITCH_MODE_MIN },
 	{ "z","zsx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.mode[5],					Z_SWITCH_MODE_MAX },
 //	{ "z","zsn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_Z][SW_MIN].mode,	Z_SWITCH_MODE_MIN },	// new style
@@ -321,16 +440,22 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "z","zlv",_fipc, 0, cm_print_lv, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_velocity,	Z_LATCH_VELOCITY },
 	{ "z","zlb",_fipc, 3, cm_print_lb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].latch_backoff,	Z_LATCH_BACKOFF },
 	{ "z","zzb",_fipc, 3, cm_print_zb, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].zero_backoff,	Z_ZERO_BACKOFF },
+	{ "z","zhg",_fip,  0, cm_print_hg, get_ui8,   set_0123,  (float *)&cm.a[AXIS_Z].homing_group,	Z_HOMING_GROUP },
+	{ "z","zhw",_fipc, 3, cm_print_hw, get_flt,   set_flu,   (float *)&cm.a[AXIS_Z].homing_window,	Z_HOMING_WINDOW },
+	{ "z","zit",_fip,  0, cm_print_it, get_ui8,   set_0123,  (float *)&cm.a[AXIS_Z].shaper_type,	Z_SHAPER_TYPE },
+	{ "z","zif",_fip,  1, cm_print_if, get_flt,   cm_set_xif,(float *)&cm.a[AXIS_Z].shaper_frequency,Z_SHAPER_FREQUENCY },
+	{ "z","ziz",_fip,  3, cm_print_iz, get_flt,   cm_set_xiz,(float *)&cm.a[AXIS_Z].shaper_damping,	Z_SHAPER_DAMPING },
 
 	{ "a","aam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_A].axis_mode,		A_AXIS_MODE },
-	{ "a","avm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].velocity_max,	A_VELOCITY_MAX },
+	{ "a","avm",_fip,  0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_A].velocity_max,	A_VELOCITY_MAX },
+	{ "a","avs",_f0,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_A].step_velocity_max, 0 },
 	{ "a","afr",_fip,  0, cm_print_fr, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].feedrate_max,	A_FEEDRATE_MAX },
-	{ "a","atn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_A].travel_min,		A_TRAVEL_MIN },
-	{ "a","atm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].travel_max,		A_TRAVEL_MAX },
+	{ "a","atn",_fip,  3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_A].travel_min,		A_TRAVEL_MIN },
+	{ "a","atm",_fip,  3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_A].travel_max,		A_TRAVEL_MAX },
 	{ "a","ajm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_A].jerk_max,		A_JERK_MAX },
 	{ "a","ajh",_fip,  0, cm_print_jh, get_flt,	  cm_set_xjh,(float *)&cm.a[AXIS_A].jerk_homing, 	A_JERK_HOMING },
-	{ "a","ajd",_fip,  4, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].junction_dev,	A_JUNCTION_DEVIATION },
-	{ "a","ara",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].radius,			A_RADIUS},
+	{ "a","ajd",_fip,  4, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_A].junction_dev,	A_JUNCTION_DEVIATION },
+	{ "a","ara",_fipc, 3, cm_print_ra, get_flt,   cm_set_ra, (float *)&cm.a[AXIS_A].radius,			A_RADIUS},
 	{ "a","asn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.mode[6],					A_SWITCH_MODE_MIN },
 	{ "a","asx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.mode[7],					A_SWITCH_MODE_MAX },
 //	{ "a","asn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_A][SW_MIN].mode,	A_SWITCH_MODE_MIN },	// new style
@@ -339,15 +464,18 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "a","alv",_fip,  0, cm_print_lv, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_velocity,	A_LATCH_VELOCITY },
 	{ "a","alb",_fip,  3, cm_print_lb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].latch_backoff,	A_LATCH_BACKOFF },
 	{ "a","azb",_fip,  3, cm_print_zb, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].zero_backoff,	A_ZERO_BACKOFF },
+	{ "a","ahg",_fip,  0, cm_print_hg, get_ui8,   set_0123,  (float *)&cm.a[AXIS_A].homing_group,	A_HOMING_GROUP },
+	{ "a","ahw",_fip,  3, cm_print_hw, get_flt,   set_flt,   (float *)&cm.a[AXIS_A].homing_window,	A_HOMING_WINDOW },
 
 	{ "b","bam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_B].axis_mode,		B_AXIS_MODE },
-	{ "b","bvm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].velocity_max,	B_VELOCITY_MAX },
+	{ "b","bvm",_fip,  0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_B].velocity_max,	B_VELOCITY_MAX },
+	{ "b","bvs",_f0,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_B].step_velocity_max, 0 },
 	{ "b","bfr",_fip,  0, cm_print_fr, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].feedrate_max,	B_FEEDRATE_MAX },
-	{ "b","btn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_B].travel_min,		B_TRAVEL_MIN },
-	{ "b","btm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].travel_max,		B_TRAVEL_MAX },
+	{ "b","btn",_fip,  3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_B].travel_min,		B_TRAVEL_MIN },
+	{ "b","btm",_fip,  3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_B].travel_max,		B_TRAVEL_MAX },
 	{ "b","bjm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_B].jerk_max,		B_JERK_MAX },
-	{ "b","bjd",_fip,  0, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].junction_dev,	B_JUNCTION_DEVIATION },
-	{ "b","bra",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_B].radius,			B_RADIUS },
+	{ "b","bjd",_fip,  0, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_B].junction_dev,	B_JUNCTION_DEVIATION },
+	{ "b","bra",_fipc, 3, cm_print_ra, get_flt,   cm_set_ra, (float *)&cm.a[AXIS_B].radius,			B_RADIUS },
 #ifdef __ARM	// B axis extended parameters
 	{ "b","asn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_B][SW_MIN].mode,	B_SWITCH_MODE_MIN },
 	{ "b","asx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_B][SW_MAX].mode,	B_SWITCH_MODE_MAX },
@@ -359,13 +487,14 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 	{ "c","cam",_fip,  0, cm_print_am, cm_get_am, cm_set_am, (float *)&cm.a[AXIS_C].axis_mode,		C_AXIS_MODE },
-	{ "c","cvm",_fip,  0, cm_print_vm, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].velocity_max,	C_VELOCITY_MAX },
+	{ "c","cvm",_fip,  0, cm_print_vm, get_flt,   cm_set_xvm,(float *)&cm.a[AXIS_C].velocity_max,	C_VELOCITY_MAX },
+	{ "c","cvs",_f0,   0, cm_print_vs, cm_get_vs, set_nul,   (float *)&cm.a[AXIS_C].step_velocity_max, 0 },
 	{ "c","cfr",_fip,  0, cm_print_fr, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].feedrate_max,	C_FEEDRATE_MAX },
-	{ "c","ctn",_fip,  3, cm_print_tn, get_flt,   set_flu,   (float *)&cm.a[AXIS_C].travel_min,		C_TRAVEL_MIN },
-	{ "c","ctm",_fip,  3, cm_print_tm, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].travel_max,		C_TRAVEL_MAX },
+	{ "c","ctn",_fip,  3, cm_print_tn, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_C].travel_min,		C_TRAVEL_MIN },
+	{ "c","ctm",_fip,  3, cm_print_tm, get_flt,   cm_set_tl, (float *)&cm.a[AXIS_C].travel_max,		C_TRAVEL_MAX },
 	{ "c","cjm",_fip,  0, cm_print_jm, get_flt,	  cm_set_xjm,(float *)&cm.a[AXIS_C].jerk_max,		C_JERK_MAX },
-	{ "c","cjd",_fip,  0, cm_print_jd, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].junction_dev,	C_JUNCTION_DEVIATION },
-	{ "c","cra",_fipc, 3, cm_print_ra, get_flt,   set_flt,   (float *)&cm.a[AXIS_C].radius,			C_RADIUS },
+	{ "c","cjd",_fip,  0, cm_print_jd, get_flt,   cm_set_jd,  (float *)&cm.a[AXIS_C].junction_dev,	C_JUNCTION_DEVIATION },
+	{ "c","cra",_fipc, 3, cm_print_ra, get_flt,   cm_set_ra, (float *)&cm.a[AXIS_C].radius,			C_RADIUS },
 #ifdef __ARM	// C axis extended parameters
 	{ "c","csn",_fip,  0, cm_print_sn, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_C][SW_MIN].mode,	C_SWITCH_MODE_MIN },
 	{ "c","csx",_fip,  0, cm_print_sx, get_ui8,   sw_set_sw, (float *)&sw.s[AXIS_C][SW_MAX].mode,	C_SWITCH_MODE_MAX },
@@ -387,49 +516,66 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "p1","p1wpl",_fip, 3, pwm_print_p1wpl, get_flt, set_flt,(float *)&pwm.c[PWM_1].ccw_phase_lo,	P1_CCW_PHASE_LO },
 	{ "p1","p1wph",_fip, 3, pwm_print_p1wph, get_flt, set_flt,(float *)&pwm.c[PWM_1].ccw_phase_hi,	P1_CCW_PHASE_HI },
 	{ "p1","p1pof",_fip, 3, pwm_print_p1pof, get_flt, set_flt,(float *)&pwm.c[PWM_1].phase_off,		P1_PWM_PHASE_OFF },
+	{ "p1","p1lsr",_fip, 0, pwm_print_p1lsr, get_ui8, set_01, (float *)&pwm.c[PWM_1].laser_mode,		P1_LASER_MODE },
+	{ "p1","p1dth",_fip, 0, pwm_print_p1dth, get_ui8, set_01, (float *)&pwm.c[PWM_1].dither,			P1_DITHER },
+	{ "p1","p1acc",_fip, 0, pwm_print_p1acc, get_flt, set_flt,(float *)&pwm.c[PWM_1].spindle_accel,	P1_SPINDLE_ACCEL },
+	{ "p1","p1enc",_fip, 0, en_print_p1enc, get_flt, en_set_spindle_ec,(float *)&en.spindle_counts_per_rev,	P1_ENCODER_COUNTS },
+
+	{ "p2","p2frq",_fip, 0, pwm_print_p2frq, get_flt, set_flt,(float *)&pwm.c[PWM_2].frequency,		P2_PWM_FREQUENCY },
+	{ "p2","p2csl",_fip, 0, pwm_print_p2csl, get_flt, set_flt,(float *)&pwm.c[PWM_2].cw_speed_lo,	P2_CW_SPEED_LO },
+	{ "p2","p2csh",_fip, 0, pwm_print_p2csh, get_flt, set_flt,(float *)&pwm.c[PWM_2].cw_speed_hi,	P2_CW_SPEED_HI },
+	{ "p2","p2cpl",_fip, 3, pwm_print_p2cpl, get_flt, set_flt,(float *)&pwm.c[PWM_2].cw_phase_lo,	P2_CW_PHASE_LO },
+	{ "p2","p2cph",_fip, 3, pwm_print_p2cph, get_flt, set_flt,(float *)&pwm.c[PWM_2].cw_phase_hi,	P2_CW_PHASE_HI },
+	{ "p2","p2wsl",_fip, 0, pwm_print_p2wsl, get_flt, set_flt,(float *)&pwm.c[PWM_2].ccw_speed_lo,	P2_CCW_SPEED_LO },
+	{ "p2","p2wsh",_fip, 0, pwm_print_p2wsh, get_flt, set_flt,(float *)&pwm.c[PWM_2].ccw_speed_hi,	P2_CCW_SPEED_HI },
+	{ "p2","p2wpl",_fip, 3, pwm_print_p2wpl, get_flt, set_flt,(float *)&pwm.c[PWM_2].ccw_phase_lo,	P2_CCW_PHASE_LO },
+	{ "p2","p2wph",_fip, 3, pwm_print_p2wph, get_flt, set_flt,(float *)&pwm.c[PWM_2].ccw_phase_hi,	P2_CCW_PHASE_HI },
+	{ "p2","p2pof",_fip, 3, pwm_print_p2pof, get_flt, set_flt,(float *)&pwm.c[PWM_2].phase_off,		P2_PWM_PHASE_OFF },
+	{ "p2","p2lsr",_fip, 0, pwm_print_p2lsr, get_ui8, set_01, (float *)&pwm.c[PWM_2].laser_mode,		P2_LASER_MODE },
+	{ "p2","p2tn", _fip, 0, pwm_print_p2tn,  get_ui8, set_ui8,(float *)&pwm.c[PWM_2].tool,			P2_TOOL },
 
 	// Coordinate system offsets (G54-G59 and G92)
-	{ "g54","g54x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_X], G54_X_OFFSET },
-	{ "g54","g54y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Y], G54_Y_OFFSET },
-	{ "g54","g54z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_Z], G54_Z_OFFSET },
-	{ "g54","g54a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_A], G54_A_OFFSET },
-	{ "g54","g54b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_B], G54_B_OFFSET },
-	{ "g54","g54c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G54][AXIS_C], G54_C_OFFSET },
-
-	{ "g55","g55x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_X], G55_X_OFFSET },
-	{ "g55","g55y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Y], G55_Y_OFFSET },
-	{ "g55","g55z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_Z], G55_Z_OFFSET },
-	{ "g55","g55a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_A], G55_A_OFFSET },
-	{ "g55","g55b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_B], G55_B_OFFSET },
-	{ "g55","g55c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G55][AXIS_C], G55_C_OFFSET },
-
-	{ "g56","g56x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_X], G56_X_OFFSET },
-	{ "g56","g56y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Y], G56_Y_OFFSET },
-	{ "g56","g56z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_Z], G56_Z_OFFSET },
-	{ "g56","g56a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_A], G56_A_OFFSET },
-	{ "g56","g56b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_B], G56_B_OFFSET },
-	{ "g56","g56c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G56][AXIS_C], G56_C_OFFSET },
-
-	{ "g57","g57x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_X], G57_X_OFFSET },
-	{ "g57","g57y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Y], G57_Y_OFFSET },
-	{ "g57","g57z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_Z], G57_Z_OFFSET },
-	{ "g57","g57a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_A], G57_A_OFFSET },
-	{ "g57","g57b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_B], G57_B_OFFSET },
-	{ "g57","g57c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G57][AXIS_C], G57_C_OFFSET },
-
-	{ "g58","g58x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_X], G58_X_OFFSET },
-	{ "g58","g58y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Y], G58_Y_OFFSET },
-	{ "g58","g58z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_Z], G58_Z_OFFSET },
-	{ "g58","g58a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_A], G58_A_OFFSET },
-	{ "g58","g58b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_B], G58_B_OFFSET },
-	{ "g58","g58c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G58][AXIS_C], G58_C_OFFSET },
-
-	{ "g59","g59x",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_X], G59_X_OFFSET },
-	{ "g59","g59y",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Y], G59_Y_OFFSET },
-	{ "g59","g59z",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_Z], G59_Z_OFFSET },
-	{ "g59","g59a",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_A], G59_A_OFFSET },
-	{ "g59","g59b",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_B], G59_B_OFFSET },
-	{ "g59","g59c",_fipc, 3, cm_print_cofs, get_flt, set_flu,(float *)&cm.offset[G59][AXIS_C], G59_C_OFFSET },
+	{ "g54","g54x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_X], G54_X_OFFSET },
+	{ "g54","g54y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_Y], G54_Y_OFFSET },
+	{ "g54","g54z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_Z], G54_Z_OFFSET },
+	{ "g54","g54a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_A], G54_A_OFFSET },
+	{ "g54","g54b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_B], G54_B_OFFSET },
+	{ "g54","g54c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G54][AXIS_C], G54_C_OFFSET },
+
+	{ "g55","g55x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_X], G55_X_OFFSET },
+	{ "g55","g55y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_Y], G55_Y_OFFSET },
+	{ "g55","g55z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_Z], G55_Z_OFFSET },
+	{ "g55","g55a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_A], G55_A_OFFSET },
+	{ "g55","g55b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_B], G55_B_OFFSET },
+	{ "g55","g55c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G55][AXIS_C], G55_C_OFFSET },
+
+	{ "g56","g56x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_X], G56_X_OFFSET },
+	{ "g56","g56y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_Y], G56_Y_OFFSET },
+	{ "g56","g56z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_Z], G56_Z_OFFSET },
+	{ "g56","g56a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_A], G56_A_OFFSET },
+	{ "g56","g56b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_B], G56_B_OFFSET },
+	{ "g56","g56c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G56][AXIS_C], G56_C_OFFSET },
+
+	{ "g57","g57x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_X], G57_X_OFFSET },
+	{ "g57","g57y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_Y], G57_Y_OFFSET },
+	{ "g57","g57z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_Z], G57_Z_OFFSET },
+	{ "g57","g57a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_A], G57_A_OFFSET },
+	{ "g57","g57b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_B], G57_B_OFFSET },
+	{ "g57","g57c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G57][AXIS_C], G57_C_OFFSET },
+
+	{ "g58","g58x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_X], G58_X_OFFSET },
+	{ "g58","g58y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_Y], G58_Y_OFFSET },
+	{ "g58","g58z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_Z], G58_Z_OFFSET },
+	{ "g58","g58a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_A], G58_A_OFFSET },
+	{ "g58","g58b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_B], G58_B_OFFSET },
+	{ "g58","g58c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G58][AXIS_C], G58_C_OFFSET },
+
+	{ "g59","g59x",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_X], G59_X_OFFSET },
+	{ "g59","g59y",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_Y], G59_Y_OFFSET },
+	{ "g59","g59z",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_Z], G59_Z_OFFSET },
+	{ "g59","g59a",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_A], G59_A_OFFSET },
+	{ "g59","g59b",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_B], G59_B_OFFSET },
+	{ "g59","g59c",_fipc, 3, cm_print_cofs, get_flt, cm_set_cofs,(float *)&cm.offset[G59][AXIS_C], G59_C_OFFSET },
 
 	{ "g92","g92x",_fi, 3, cm_print_cofs, get_flt, set_nul,(float *)&cm.gmx.origin_offset[AXIS_X], 0 },// G92 handled differently
 	{ "g92","g92y",_fi, 3, cm_print_cofs, get_flt, set_nul,(float *)&cm.gmx.origin_offset[AXIS_Y], 0 },
@@ -453,6 +599,16 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "g30","g30b",_fi, 3, cm_print_cpos, get_flt, set_nul,(float *)&cm.gmx.g30_position[AXIS_B], 0 },
 	{ "g30","g30c",_fi, 3, cm_print_cpos, get_flt, set_nul,(float *)&cm.gmx.g30_position[AXIS_C], 0 },
 
+	// Tool table (G10 L1, G43)
+	{ "tt1","tt1l",_fipc, 3, cm_print_ttl, get_flt, cm_set_tt,(float *)&cm.tool_length[1], T1_LENGTH },
+	{ "tt1","tt1d",_fipc, 3, cm_print_ttd, get_flt, cm_set_tt,(float *)&cm.tool_diameter[1], T1_DIAMETER },
+	{ "tt2","tt2l",_fipc, 3, cm_print_ttl, get_flt, cm_set_tt,(float *)&cm.tool_length[2], T2_LENGTH },
+	{ "tt2","tt2d",_fipc, 3, cm_print_ttd, get_flt, cm_set_tt,(float *)&cm.tool_diameter[2], T2_DIAMETER },
+	{ "tt3","tt3l",_fipc, 3, cm_print_ttl, get_flt, cm_set_tt,(float *)&cm.tool_length[3], T3_LENGTH },
+	{ "tt3","tt3d",_fipc, 3, cm_print_ttd, get_flt, cm_set_tt,(float *)&cm.tool_diameter[3], T3_DIAMETER },
+	{ "tt4","tt4l",_fipc, 3, cm_print_ttl, get_flt, cm_set_tt,(float *)&cm.tool_length[4], T4_LENGTH },
+	{ "tt4","tt4d",_fipc, 3, cm_print_ttd, get_flt, cm_set_tt,(float *)&cm.tool_diameter[4], T4_DIAMETER },
+
 	// this is a 128bit UUID for identifying a previously committed job state
 	{ "jid","jida",_f0, 0, tx_print_nul, get_data, set_data, (float *)&cs.job_id[0], 0},
 	{ "jid","jidb",_f0, 0, tx_print_nul, get_data, set_data, (float *)&cs.job_id[1], 0},
@@ -460,28 +616,59 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "jid","jidd",_f0, 0, tx_print_nul, get_data, set_data, (float *)&cs.job_id[3], 0},
 
 	// System parameters
-	{ "sys","ja",  _fipnc,0, cm_print_ja,  get_flt,   set_flu,    (float *)&cm.junction_acceleration,JUNCTION_ACCELERATION },
+	{ "sys","ja",  _fipnc,0, cm_print_ja,  get_flt,   cm_set_ja,  (float *)&cm.junction_acceleration,JUNCTION_ACCELERATION },
 	{ "sys","ct",  _fipnc,4, cm_print_ct,  get_flt,   set_flu,    (float *)&cm.chordal_tolerance,	CHORDAL_TOLERANCE },
-	{ "sys","sl",  _fipn, 0, cm_print_sl,  get_ui8,   set_ui8,    (float *)&cm.soft_limit_enable,	SOFT_LIMIT_ENABLE },
+	{ "sys","lt",  _fipnc,4, cm_print_lt,  get_flt,   set_flu,    (float *)&cm.line_merge_tolerance,LINE_MERGE_TOLERANCE },
+	{ "sys","qg",  _fipn, 0, cm_print_qg,  get_int,   set_int,    (float *)&cm.queue_governor_time,	QUEUE_GOVERNOR_TIME_MS },
+	{ "sys","pb",  _fipn, 0, cm_print_pb,  get_int,   set_int,    (float *)&cm.prime_buffers,		PLANNER_PRIME_BUFFERS },
+	{ "sys","pt",  _fipn, 0, cm_print_pt,  get_int,   set_int,    (float *)&cm.prime_time,		PLANNER_PRIME_TIME_MS },
+	{ "sys","px",  _fipn, 0, cm_print_px,  get_int,   set_int,    (float *)&cm.prime_timeout,		PLANNER_PRIME_TIMEOUT_MS },
+	{ "sys","kin", _fipn, 0, cm_print_kin, get_ui8,   ik_set_kin, (float *)&ik.kinematics,			KINEMATICS },
+	{ "sys","kdr", _fipnc,3, cm_print_kdr, get_flt,   ik_set_delta,(float *)&ik.delta_radius,		DELTA_RADIUS },
+	{ "sys","kdl", _fipnc,3, cm_print_kdl, get_flt,   ik_set_delta,(float *)&ik.delta_rod_length,	DELTA_ROD_LENGTH },
+	{ "sys","kpx", _fipnc,3, cm_print_kpx, get_flt,   ik_set_pivot,(float *)&ik.pivot[AXIS_X],		RTCP_PIVOT_X },
+	{ "sys","kpy", _fipnc,3, cm_print_kpy, get_flt,   ik_set_pivot,(float *)&ik.pivot[AXIS_Y],		RTCP_PIVOT_Y },
+	{ "sys","kpz", _fipnc,3, cm_print_kpz, get_flt,   ik_set_pivot,(float *)&ik.pivot[AXIS_Z],		RTCP_PIVOT_Z },
+	{ "sys","sl",  _fipn, 0, cm_print_sl,  get_ui8,   cm_set_sl,   (float *)&cm.soft_limit_enable,	SOFT_LIMIT_ENABLE },
+	{ "sys","sc",  _fipn, 0, cm_print_sc,  get_ui8,   set_01,     (float *)&cm.segment_commands,	SEGMENT_COMMANDS },
+	{ "sys","tum", _fipn, 2, cm_print_tum, get_flt,   cm_set_tum,  (float *)&cm.tuning_margin,		TUNING_MARGIN },
+	{ "sys","tuw", _fipn, 0, cm_print_tuw, get_ui8,   set_01,     (float *)&cm.tuning_write,		TUNING_WRITE },
+	{ "sys","plv", _fipnc,0, cm_print_plv, get_flt,   set_flu,    (float *)&cm.probe_latch_velocity,PROBE_LATCH_VELOCITY },
+	{ "sys","plb", _fipnc,3, cm_print_plb, get_flt,   set_flu,    (float *)&cm.probe_latch_backoff,	PROBE_LATCH_BACKOFF },
+	{ "sys","cpi", _fipn, 0, cm_print_cpi, get_int,   set_int,    (float *)&cm.checkpoint_interval,	CHECKPOINT_INTERVAL_MS },
 	{ "sys","st",  _fipn, 0, sw_print_st,  get_ui8,   sw_set_st,  (float *)&sw.switch_type,			SWITCH_TYPE },
+	{ "sys","sf",  _fipn, 0, sw_print_sf,  get_ui8,   sw_set_sf,  (float *)&sw.filter,				SWITCH_FILTER },
 	{ "sys","mt",  _fipn, 2, st_print_mt,  get_flt,   st_set_mt,  (float *)&st_cfg.motor_power_timeout,MOTOR_IDLE_TIMEOUT},
+	{ "sys","dda", _fipn, 0, st_print_dda, get_ui8,   st_set_dda, (float *)&st_cfg.dda_mode,			DDA_MODE },
+	{ "sys","msr", _fipn, 0, st_print_msr, get_int,   st_set_msr, (float *)&st_cfg.morph_rate,			MICROSTEP_MORPH_RATE },
 	{ "",   "me",  _f0,   0, tx_print_str, st_set_me, st_set_me,  (float *)&cs.null, 0 },
 	{ "",   "md",  _f0,   0, tx_print_str, st_set_md, st_set_md,  (float *)&cs.null, 0 },
 
 	{ "sys","ej",  _fipn, 0, js_print_ej,  get_ui8,   set_01,     (float *)&cfg.comm_mode,			COMM_MODE },
 	{ "sys","jv",  _fipn, 0, js_print_jv,  get_ui8,   json_set_jv,(float *)&js.json_verbosity,		JSON_VERBOSITY },
 	{ "sys","js",  _fipn, 0, js_print_js,  get_ui8,   set_01,     (float *)&js.json_syntax, 		JSON_SYNTAX_MODE },
+	{ "sys","jc",  _fipn, 0, js_print_jc,  get_ui8,   set_01,     (float *)&js.json_checksum, 		JSON_FOOTER_CHECKSUM },
 	{ "sys","tv",  _fipn, 0, tx_print_tv,  get_ui8,   set_01,     (float *)&txt.text_verbosity,		TEXT_VERBOSITY },
 	{ "sys","qv",  _fipn, 0, qr_print_qv,  get_ui8,   set_0123,   (float *)&qr.queue_report_verbosity,QUEUE_REPORT_VERBOSITY },
+	{ "sys","qd",  _fipn, 0, qr_print_qd,  get_ui8,   set_ui8,    (float *)&qr.queue_report_delta,	QUEUE_REPORT_BUFFER_DELTA },
+	{ "sys","qm",  _fipn, 0, qr_print_qm,  get_int,   set_int,    (float *)&qr.queue_report_interval,QUEUE_REPORT_INTERVAL_MS },
 	{ "sys","sv",  _fipn, 0, sr_print_sv,  get_ui8,   set_012,    (float *)&sr.status_report_verbosity,STATUS_REPORT_VERBOSITY },
 	{ "sys","si",  _fipn, 0, sr_print_si,  get_int,   sr_set_si,  (float *)&sr.status_report_interval,STATUS_REPORT_INTERVAL_MS },
+	{ "sys","jp",  _fipn, 0, jp_print_jp,  get_ui8,   jp_set_jp,  (float *)&jp.profile_enable,		JOB_PROFILE_ENABLE },
+	{ "sys","sa",  _fipn, 0, sr_print_sa,  get_ui8,   set_01,     (float *)&sr.status_report_adaptive,STATUS_REPORT_ADAPTIVE },
+	{ "sys","sb",  _fipn, 0, sr_print_sb,  get_int,   sr_set_sb,  (float *)&sr.status_report_binary,STATUS_REPORT_BINARY },
 //	{ "sys","spi", _fipn, 0, xio_print_spi,get_ui8,   xio_set_spi,(float *)&xio.spi_state,			0 },
 
 	{ "sys","ec",  _fipn, 0, cfg_print_ec,  get_ui8,   set_ec,     (float *)&cfg.enable_cr,			COM_EXPAND_CR },
 	{ "sys","ee",  _fipn, 0, cfg_print_ee,  get_ui8,   set_ee,     (float *)&cfg.enable_echo,		COM_ENABLE_ECHO },
 	{ "sys","ex",  _fipn, 0, cfg_print_ex,  get_ui8,   set_ex,     (float *)&cfg.enable_flow_control,COM_ENABLE_FLOW_CONTROL },
+	{ "sys","lc",  _fipn, 0, cfg_print_lc,  get_ui8,   set_01,     (float *)&cfg.line_check,		COM_LINE_CHECK },
 	{ "sys","baud",_fn,   0, cfg_print_baud,get_ui8,   set_baud,   (float *)&cfg.usb_baud_rate,		XIO_BAUD_115200 },
 	{ "sys","net", _fipn, 0, cfg_print_net, get_ui8,   set_ui8,    (float *)&cs.network_mode,		NETWORK_MODE },
+	{ "sys","pnd", _fipn, 0, cfg_print_pnd, get_ui8,   set_01,     (float *)&cs.pendant_enable,		PENDANT_ENABLE },
+	{ "sys","pnm", _fipn, 0, cfg_print_pnm, get_ui8,   set_pnm,    (float *)&cs.pendant_mirror,		PENDANT_MIRROR },
+	{ "sys","ast", _fipn, 0, cfg_print_ast, get_ui8,   set_012,    (float *)&cs.assertion_level,	ASSERTION_LEVEL },
+	{ "sys","slp", _fipn, 0, cfg_print_slp, get_ui8,   set_01,     (float *)&cs.idle_sleep,			IDLE_SLEEP },
 
 	// switch state readouts
 /*
@@ -529,6 +716,120 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "udd","udd2", _fip, 0, tx_print_int, get_data, set_data,(float *)&cfg.user_data_d[2], USER_DATA_D2 },
 	{ "udd","udd3", _fip, 0, tx_print_int, get_data, set_data,(float *)&cfg.user_data_d[3], USER_DATA_D3 },
 
+	// Underruns and late loads (see stepper.h)
+	{ "ur","urn",  _f0, 0, st_print_urn, get_int, st_set_urn,(float *)&st_pre.underrun_count, 0 },
+	{ "ur","urlc", _f0, 0, st_print_urlc,get_int, set_nul,   (float *)&st_pre.late_load_count, 0 },
+	{ "ur","urll", _f0, 0, st_print_urll,get_int, set_nul,   (float *)&st_pre.late_load_line, 0 },
+	{ "ur","url",  _f0, 0, st_print_url, get_int, set_nul,   (float *)&st_pre.underrun_line, 0 },
+	{ "ur","urb",  _fip,3, st_print_urb, get_flt, st_set_urb,(float *)&st_cfg.underrun_backoff, UNDERRUN_BACKOFF },
+	{ "ur","urf",  _f0, 3, st_print_urf, get_flt, set_nul,   (float *)&st_pre.backoff_factor, 0 },
+
+#ifdef __PERF_COUNTERS
+	// Performance counters (see perf.h)
+	{ "pf","pfrp", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_REPLAN], 0 },		// block list replans
+	{ "pf","pfzt", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_TRAPEZOID], 0 },	// trapezoids computed
+	{ "pf","pfzr", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_TRAPEZOID_REUSED], 0 },// trapezoids reused
+	{ "pf","pfpe", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_PARSE_ERROR], 0 },	// Gcode parse errors
+	{ "pf","pfio", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_ISR_OVERRUN], 0 },	// DDA ISR overruns
+	{ "pf","pfts", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_TX_STALL], 0 },	// TX buffer stalls
+	{ "pf","pfxo", _f0, 0, tx_print_int, get_int, set_int,(float *)&perf[PERF_XOFF], 0 },		// RX high water (XOFF) events
+	{ "",  "pfc",  _f0, 0, tx_print_nul, perf_clear, perf_clear,(float *)&cs.null, 0 },		// clear the performance counters
+#endif
+
+	// Analog inputs (see analog.h)
+	{ "an","an1p", _fip, 0, an_print_anp, get_ui8, an_set_pin,(float *)&an.c[0].pin, AN1_PIN },
+	{ "an","an1k", _fip, 3, an_print_ank, get_flt, set_flt,   (float *)&an.c[0].scale, AN1_SCALE },
+	{ "an","an1",  _f0,  3, an_print_an,  get_flt, set_nul,   (float *)&an.value[0], 0 },
+	{ "an","an2p", _fip, 0, an_print_anp, get_ui8, an_set_pin,(float *)&an.c[1].pin, AN2_PIN },
+	{ "an","an2k", _fip, 3, an_print_ank, get_flt, set_flt,   (float *)&an.c[1].scale, AN2_SCALE },
+	{ "an","an2",  _f0,  3, an_print_an,  get_flt, set_nul,   (float *)&an.value[1], 0 },
+	{ "an","an3p", _fip, 0, an_print_anp, get_ui8, an_set_pin,(float *)&an.c[2].pin, AN3_PIN },
+	{ "an","an3k", _fip, 3, an_print_ank, get_flt, set_flt,   (float *)&an.c[2].scale, AN3_SCALE },
+	{ "an","an3",  _f0,  3, an_print_an,  get_flt, set_nul,   (float *)&an.value[2], 0 },
+	{ "an","an4p", _fip, 0, an_print_anp, get_ui8, an_set_pin,(float *)&an.c[3].pin, AN4_PIN },
+	{ "an","an4k", _fip, 3, an_print_ank, get_flt, set_flt,   (float *)&an.c[3].scale, AN4_SCALE },
+	{ "an","an4",  _f0,  3, an_print_an,  get_flt, set_nul,   (float *)&an.value[3], 0 },
+
+	// Adaptive feed
+	{ "lf","lfi", _fip, 0, cm_print_lfi, get_ui8, cm_set_lfi,(float *)&cm.adaptive_feed_input, ADAPTIVE_FEED_INPUT },
+	{ "lf","lfl", _fip, 3, cm_print_lfl, get_flt, set_flt,   (float *)&cm.adaptive_load_lo, ADAPTIVE_LOAD_LO },
+	{ "lf","lfh", _fip, 3, cm_print_lfh, get_flt, set_flt,   (float *)&cm.adaptive_load_hi, ADAPTIVE_LOAD_HI },
+	{ "lf","lfn", _fip, 3, cm_print_lfn, get_flt, cm_set_lfn,(float *)&cm.adaptive_feed_min, ADAPTIVE_FEED_MIN },
+	{ "lf","lfx", _fip, 3, cm_print_lfx, get_flt, cm_set_lfn,(float *)&cm.adaptive_feed_max, ADAPTIVE_FEED_MAX },
+	{ "lf","lff", _f0,  3, cm_print_lff, get_flt, set_nul,   (float *)&mr.adaptive_factor, 0 },
+
+	// Torch height control
+	{ "th","thi", _fip, 0, cm_print_thi, get_ui8, cm_set_thi,(float *)&cm.thc_input, THC_INPUT },
+	{ "th","thv", _fip, 3, cm_print_thv, get_flt, set_flt,   (float *)&cm.thc_voltage, THC_VOLTAGE },
+	{ "th","thg", _fipc,3, cm_print_thg, get_flt, set_flu,   (float *)&cm.thc_gain, THC_GAIN },
+	{ "th","thr", _fipc,3, cm_print_thr, get_flt, set_flu,   (float *)&cm.thc_rate, THC_RATE },
+	{ "th","thl", _fipc,3, cm_print_thl, get_flt, set_flu,   (float *)&cm.thc_limit, THC_LIMIT },
+	{ "th","thd", _fip, 3, cm_print_thd, get_flt, cm_set_thd,(float *)&cm.thc_antidive, THC_ANTIDIVE },
+	{ "th","tho", _f0,  3, cm_print_tho, get_flt, set_nul,   (float *)&mr.thc_offset, 0 },
+
+	{ "pa","pax", _fip, 0, cm_print_pax, get_ui8, cm_set_pax,(float *)&cm.pa_axis, PA_AXIS },
+	{ "pa","pak", _fip, 3, cm_print_pak, get_flt, set_flt,   (float *)&cm.pa_advance, PA_ADVANCE },
+	{ "pa","pao", _f0,  3, cm_print_pao, get_flt, set_nul,   (float *)&mr.pa_offset, 0 },
+
+	{ "rt","rtl", _fip, 3, cm_print_rtl, get_flt, set_flt,   (float *)&cm.retract_length, RETRACT_LENGTH },
+	{ "rt","rtv", _fip, 0, cm_print_rtv, get_flt, set_flt,   (float *)&cm.retract_velocity, RETRACT_VELOCITY },
+	{ "rt","rto", _f0,  3, cm_print_rto, get_flt, set_nul,   (float *)&mr.retract_offset, 0 },
+
+	// Machine error corrections (see _compensate() in kinematics.c)
+	{ "pcx","pcxs",_fipc,3, cm_print_pcs, get_flt, ik_set_pc, (float *)&ik.pitch_start[AXIS_X], PITCH_X_START },
+	{ "pcx","pcxd",_fipc,3, cm_print_pcd, get_flt, ik_set_pcd,(float *)&ik.pitch_spacing[AXIS_X], PITCH_X_SPACING },
+	{ "pcx","pcx0",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][0], 0 },
+	{ "pcx","pcx1",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][1], 0 },
+	{ "pcx","pcx2",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][2], 0 },
+	{ "pcx","pcx3",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][3], 0 },
+	{ "pcx","pcx4",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][4], 0 },
+	{ "pcx","pcx5",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][5], 0 },
+	{ "pcx","pcx6",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][6], 0 },
+	{ "pcx","pcx7",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][7], 0 },
+	{ "pcx","pcx8",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_X][8], 0 },
+
+	{ "pcy","pcys",_fipc,3, cm_print_pcs, get_flt, ik_set_pc, (float *)&ik.pitch_start[AXIS_Y], PITCH_Y_START },
+	{ "pcy","pcyd",_fipc,3, cm_print_pcd, get_flt, ik_set_pcd,(float *)&ik.pitch_spacing[AXIS_Y], PITCH_Y_SPACING },
+	{ "pcy","pcy0",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][0], 0 },
+	{ "pcy","pcy1",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][1], 0 },
+	{ "pcy","pcy2",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][2], 0 },
+	{ "pcy","pcy3",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][3], 0 },
+	{ "pcy","pcy4",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][4], 0 },
+	{ "pcy","pcy5",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][5], 0 },
+	{ "pcy","pcy6",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][6], 0 },
+	{ "pcy","pcy7",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][7], 0 },
+	{ "pcy","pcy8",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Y][8], 0 },
+
+	{ "pcz","pczs",_fipc,3, cm_print_pcs, get_flt, ik_set_pc, (float *)&ik.pitch_start[AXIS_Z], PITCH_Z_START },
+	{ "pcz","pczd",_fipc,3, cm_print_pcd, get_flt, ik_set_pcd,(float *)&ik.pitch_spacing[AXIS_Z], PITCH_Z_SPACING },
+	{ "pcz","pcz0",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][0], 0 },
+	{ "pcz","pcz1",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][1], 0 },
+	{ "pcz","pcz2",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][2], 0 },
+	{ "pcz","pcz3",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][3], 0 },
+	{ "pcz","pcz4",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][4], 0 },
+	{ "pcz","pcz5",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][5], 0 },
+	{ "pcz","pcz6",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][6], 0 },
+	{ "pcz","pcz7",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][7], 0 },
+	{ "pcz","pcz8",_fipc,4, cm_print_pcn, get_flt, ik_set_pc, (float *)&ik.pitch[AXIS_Z][8], 0 },
+
+	{ "sk","skxy", _fip, 5, cm_print_sk,  get_flt, ik_set_sk, (float *)&ik.skew[IK_SKEW_XY], SKEW_XY },
+	{ "sk","skxz", _fip, 5, cm_print_sk,  get_flt, ik_set_sk, (float *)&ik.skew[IK_SKEW_XZ], SKEW_XZ },
+	{ "sk","skyz", _fip, 5, cm_print_sk,  get_flt, ik_set_sk, (float *)&ik.skew[IK_SKEW_YZ], SKEW_YZ },
+
+	// Machining presets (see cm_set_preset())
+	{ "pr1","pr1jk",_fip, 3, cm_print_prjk, get_flt, set_flt, (float *)&cm.preset[0].jerk_scale, PRESET_1_JERK_SCALE },
+	{ "pr1","pr1ja",_fipc,0, cm_print_prja, get_flt, set_flu, (float *)&cm.preset[0].junction_acceleration, PRESET_1_JUNCTION_ACCEL },
+	{ "pr1","pr1st",_fip, 0, cm_print_prst, get_flt, set_flt, (float *)&cm.preset[0].segment_usec, PRESET_1_SEGMENT_USEC },
+	{ "pr1","pr1ct",_fipc,4, cm_print_prct, get_flt, set_flu, (float *)&cm.preset[0].chordal_tolerance, PRESET_1_CHORDAL_TOLERANCE },
+	{ "pr2","pr2jk",_fip, 3, cm_print_prjk, get_flt, set_flt, (float *)&cm.preset[1].jerk_scale, PRESET_2_JERK_SCALE },
+	{ "pr2","pr2ja",_fipc,0, cm_print_prja, get_flt, set_flu, (float *)&cm.preset[1].junction_acceleration, PRESET_2_JUNCTION_ACCEL },
+	{ "pr2","pr2st",_fip, 0, cm_print_prst, get_flt, set_flt, (float *)&cm.preset[1].segment_usec, PRESET_2_SEGMENT_USEC },
+	{ "pr2","pr2ct",_fipc,4, cm_print_prct, get_flt, set_flu, (float *)&cm.preset[1].chordal_tolerance, PRESET_2_CHORDAL_TOLERANCE },
+	{ "pr3","pr3jk",_fip, 3, cm_print_prjk, get_flt, set_flt, (float *)&cm.preset[2].jerk_scale, PRESET_3_JERK_SCALE },
+	{ "pr3","pr3ja",_fipc,0, cm_print_prja, get_flt, set_flu, (float *)&cm.preset[2].junction_acceleration, PRESET_3_JUNCTION_ACCEL },
+	{ "pr3","pr3st",_fip, 0, cm_print_prst, get_flt, set_flt, (float *)&cm.preset[2].segment_usec, PRESET_3_SEGMENT_USEC },
+	{ "pr3","pr3ct",_fipc,4, cm_print_prct, get_flt, set_flu, (float *)&cm.preset[2].chordal_tolerance, PRESET_3_CHORDAL_TOLERANCE },
+
 	// Diagnostic parameters
 #ifdef __DIAGNOSTIC_PARAMETERS
 	{ "_te","_tex",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target[AXIS_X], 0 },			// X target endpoint
@@ -546,56 +847,148 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "_tr","_trc",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.gm.target[AXIS_C], 0 },
 
 #if (MOTORS >= 1)
-	{ "_ts","_ts1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_1], 0 },		// Motor 1 target steps
-	{ "_ps","_ps1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_1], 0 },	// Motor 1 position steps
-	{ "_cs","_cs1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_1], 0 },	// Motor 1 commanded steps (delayed steps)
+	{ "_ts","_ts1",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_1], 0 },		// Motor 1 target steps
+	{ "_ps","_ps1",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_1], 0 },	// Motor 1 position steps
+	{ "_cs","_cs1",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_1], 0 },	// Motor 1 commanded steps (delayed steps)
 	{ "_es","_es1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_1], 0 },	// Motor 1 encoder steps
 	{ "_xs","_xs1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_1].corrected_steps, 0 }, // Motor 1 correction steps applied
+	{ "_xn","_xn1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_1].corrections, 0 }, // Motor 1 corrections applied
 	{ "_fe","_fe1",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_1], 0 },	// Motor 1 following error in steps
 #endif
 #if (MOTORS >= 2)
-	{ "_ts","_ts2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_2], 0 },
-	{ "_ps","_ps2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_2], 0 },
-	{ "_cs","_cs2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_2], 0 },
+	{ "_ts","_ts2",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_2], 0 },
+	{ "_ps","_ps2",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_2], 0 },
+	{ "_cs","_cs2",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_2], 0 },
 	{ "_es","_es2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_2], 0 },
 	{ "_xs","_xs2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_2].corrected_steps, 0 },
+	{ "_xn","_xn2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_2].corrections, 0 },
 	{ "_fe","_fe2",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_2], 0 },
 #endif
 #if (MOTORS >= 3)
-	{ "_ts","_ts3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_3], 0 },
-	{ "_ps","_ps3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_3], 0 },
-	{ "_cs","_cs3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_3], 0 },
+	{ "_ts","_ts3",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_3], 0 },
+	{ "_ps","_ps3",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_3], 0 },
+	{ "_cs","_cs3",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_3], 0 },
 	{ "_es","_es3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_3], 0 },
 	{ "_xs","_xs3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_3].corrected_steps, 0 },
+	{ "_xn","_xn3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_3].corrections, 0 },
 	{ "_fe","_fe3",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_3], 0 },
 #endif
 #if (MOTORS >= 4)
-	{ "_ts","_ts4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_4], 0 },
-	{ "_ps","_ps4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_4], 0 },
-	{ "_cs","_cs4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_4], 0 },
+	{ "_ts","_ts4",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_4], 0 },
+	{ "_ps","_ps4",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_4], 0 },
+	{ "_cs","_cs4",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_4], 0 },
 	{ "_es","_es4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_4], 0 },
 	{ "_xs","_xs4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_4].corrected_steps, 0 },
+	{ "_xn","_xn4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_4].corrections, 0 },
 	{ "_fe","_fe4",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_4], 0 },
 #endif
 #if (MOTORS >= 5)
-	{ "_ts","_ts5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_5], 0 },
-	{ "_ps","_ps5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_5], 0 },
-	{ "_cs","_cs5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_5], 0 },
+	{ "_ts","_ts5",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_5], 0 },
+	{ "_ps","_ps5",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_5], 0 },
+	{ "_cs","_cs5",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_5], 0 },
 	{ "_es","_es5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_5], 0 },
 	{ "_xs","_xs6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_6].corrected_steps, 0 },
+	{ "_xn","_xn6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_6].corrections, 0 },
 	{ "_fe","_fe5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_5], 0 },
 #endif
 #if (MOTORS >= 6)
-	{ "_ts","_ts6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.target_steps[MOTOR_6], 0 },
-	{ "_ps","_ps6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.position_steps[MOTOR_6], 0 },
-	{ "_cs","_cs6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.commanded_steps[MOTOR_6], 0 },
+	{ "_ts","_ts6",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.target_steps[MOTOR_6], 0 },
+	{ "_ps","_ps6",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.position_steps[MOTOR_6], 0 },
+	{ "_cs","_cs6",_f0, 2, tx_print_flt, mp_get_steps, set_nul,(float *)&mr.commanded_steps[MOTOR_6], 0 },
 	{ "_es","_es6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.encoder_steps[MOTOR_6], 0 },
 	{ "_xs","_xs5",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&st_pre.mot[MOTOR_5].corrected_steps, 0 },
+	{ "_xn","_xn5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_pre.mot[MOTOR_5].corrections, 0 },
 	{ "_fe","_fe6",_f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.following_error[MOTOR_6], 0 },
 #endif
 	{ "",   "_dam",_f0, 0, tx_print_nul, cm_dam,  cm_dam, (float *)&cs.null, 0 },	// dump active model
+	{ "",   "_hl", _f0, 2, tx_print_flt, get_flt, set_nul,(float *)&mr.hold_latency, 0 },		// last feedhold latency (ms)
+	{ "",   "_hls",_f0, 0, tx_print_int, get_int, set_nul,(float *)&mr.hold_latency_segments, 0 },	// last feedhold latency (segments)
 #endif	//  __DIAGNOSTIC_PARAMETERS
 
+#ifdef __ISR_TIMING
+	{ "_td","_tdl",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.min, 0 },			// DDA ISR minimum cycles
+	{ "_td","_tdh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.max, 0 },			// DDA ISR maximum cycles
+	{ "_td","_tdm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.dda, 0 },	// DDA ISR mean cycles
+	{ "_td","_tdc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.count, 0 },		// DDA ISR passes
+	{ "_td","_td0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[0], 0 },		// DDA ISR histogram
+	{ "_td","_td1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[1], 0 },
+	{ "_td","_td2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[2], 0 },
+	{ "_td","_td3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[3], 0 },
+	{ "_td","_td4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[4], 0 },
+	{ "_td","_td5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[5], 0 },
+	{ "_td","_td6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[6], 0 },
+	{ "_td","_td7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dda.hist[7], 0 },
+	{ "_tw","_twl",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.min, 0 },			// dwell ISR minimum cycles
+	{ "_tw","_twh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.max, 0 },			// dwell ISR maximum cycles
+	{ "_tw","_twm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.dwell, 0 },	// dwell ISR mean cycles
+	{ "_tw","_twc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.count, 0 },		// dwell ISR passes
+	{ "_tw","_tw0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[0], 0 },		// dwell ISR histogram
+	{ "_tw","_tw1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[1], 0 },
+	{ "_tw","_tw2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[2], 0 },
+	{ "_tw","_tw3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[3], 0 },
+	{ "_tw","_tw4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[4], 0 },
+	{ "_tw","_tw5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[5], 0 },
+	{ "_tw","_tw6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[6], 0 },
+	{ "_tw","_tw7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.dwell.hist[7], 0 },
+	{ "_tl","_tll",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.min, 0 },			// load minimum cycles
+	{ "_tl","_tlh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.max, 0 },			// load maximum cycles
+	{ "_tl","_tlm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.load, 0 },	// load mean cycles
+	{ "_tl","_tlc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.count, 0 },		// load passes
+	{ "_tl","_tl0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[0], 0 },		// load histogram
+	{ "_tl","_tl1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[1], 0 },
+	{ "_tl","_tl2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[2], 0 },
+	{ "_tl","_tl3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[3], 0 },
+	{ "_tl","_tl4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[4], 0 },
+	{ "_tl","_tl5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[5], 0 },
+	{ "_tl","_tl6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[6], 0 },
+	{ "_tl","_tl7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.load.hist[7], 0 },
+	{ "_tx","_txl",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.min, 0 },			// exec minimum cycles
+	{ "_tx","_txh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.max, 0 },			// exec maximum cycles
+	{ "_tx","_txm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.exec, 0 },	// exec mean cycles
+	{ "_tx","_txc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.count, 0 },		// exec passes
+	{ "_tx","_tx0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[0], 0 },		// exec histogram
+	{ "_tx","_tx1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[1], 0 },
+	{ "_tx","_tx2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[2], 0 },
+	{ "_tx","_tx3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[3], 0 },
+	{ "_tx","_tx4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[4], 0 },
+	{ "_tx","_tx5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[5], 0 },
+	{ "_tx","_tx6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[6], 0 },
+	{ "_tx","_tx7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.exec.hist[7], 0 },
+	{ "_tx","_txb",_f0, 1, tx_print_flt, st_get_timing_budget, set_nul,(float *)&st_tim.exec, 0 },	// slowest exec pass in percent of a segment
+	{ "_tk","_tkl",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.min, 0 },			// kinematics minimum cycles
+	{ "_tk","_tkh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.max, 0 },			// kinematics maximum cycles
+	{ "_tk","_tkm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.kin, 0 },	// kinematics mean cycles
+	{ "_tk","_tkc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.count, 0 },		// kinematics passes
+	{ "_tk","_tk0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[0], 0 },		// kinematics histogram
+	{ "_tk","_tk1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[1], 0 },
+	{ "_tk","_tk2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[2], 0 },
+	{ "_tk","_tk3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[3], 0 },
+	{ "_tk","_tk4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[4], 0 },
+	{ "_tk","_tk5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[5], 0 },
+	{ "_tk","_tk6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[6], 0 },
+	{ "_tk","_tk7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.kin.hist[7], 0 },
+	{ "_tk","_tkb",_f0, 1, tx_print_flt, st_get_timing_budget, set_nul,(float *)&st_tim.kin, 0 },	// slowest kinematics pass in percent of a segment
+	{ "_tg","_tgl",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.min, 0 },			// load latency minimum cycles
+	{ "_tg","_tgh",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.max, 0 },			// load latency maximum cycles
+	{ "_tg","_tgm",_f0, 1, tx_print_flt, st_get_timing_mean, set_nul,(float *)&st_tim.gap, 0 },	// load latency mean cycles
+	{ "_tg","_tgc",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.count, 0 },		// load latency passes
+	{ "_tg","_tg0",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[0], 0 },		// load latency histogram
+	{ "_tg","_tg1",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[1], 0 },
+	{ "_tg","_tg2",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[2], 0 },
+	{ "_tg","_tg3",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[3], 0 },
+	{ "_tg","_tg4",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[4], 0 },
+	{ "_tg","_tg5",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[5], 0 },
+	{ "_tg","_tg6",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[6], 0 },
+	{ "_tg","_tg7",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.gap.hist[7], 0 },
+	{ "_tg","_tgs",_f0, 0, tx_print_int, get_int, set_nul,(float *)&st_tim.starved, 0 },			// segment ends with nothing to load
+	{ "",   "_tcl",_f0, 0, tx_print_nul, st_clear_timing, st_clear_timing,(float *)&cs.null, 0 },	// clear ISR timing counters
+#endif	//  __ISR_TIMING
+
+#ifdef __TASK_TIMING
+	{ "",   "_tsk",_f0, 0, tx_print_int, controller_get_tsk, controller_clear_tsk,(float *)&cs.null, 0 },	// dump controller task timing; set to clear
+	{ "",   "_tsp",_f0, 0, tx_print_int, controller_get_tsp, controller_set_tsp,(float *)&cs.null, 0 },	// dump slow pass traces; set the pass budget (ms, 0 = default) and clear
+#endif	//  __TASK_TIMING
+
 	// Persistence for status report - must be in sequence
 	// *** Count must agree with NV_STATUS_REPORT_LEN in config.h ***
 	{ "","se00",_fp, 0, tx_print_nul, get_int, set_int,(float *)&sr.status_report_list[0],0 },
@@ -635,6 +1028,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	// *** START COUNTING FROM HERE ***
 	{ "","sys",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// system group
 	{ "","p1", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// PWM 1 group
+	{ "","p2", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// PWM 2 group
 
 	{ "","1",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// motor groups
 	{ "","2",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
@@ -664,6 +1058,10 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","g92",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// origin offsets
 	{ "","g28",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// g28 home position
 	{ "","g30",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// g30 home position
+	{ "","tt1",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// tool table entries
+	{ "","tt2",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+	{ "","tt3",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+	{ "","tt4",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
 
 	{ "","mpo",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// machine position group
 	{ "","pos",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// work position group
@@ -672,12 +1070,31 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","prb",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// probing state group
 	{ "","pwr",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// motor power enagled group
 	{ "","jog",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// axis jogging state group
+	{ "","jgv",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// velocity jog group
+	{ "","tun",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// tuning cycle group
 	{ "","jid",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// job ID group
+	{ "","mem",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// memory usage group
 
 	{ "","uda", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
 	{ "","udb", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
 	{ "","udc", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
 	{ "","udd", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// user data group
+	{ "","ur",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// underrun group
+	{ "","an",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// analog input group
+	{ "","lf",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// adaptive feed group
+	{ "","th",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// torch height control group
+	{ "","pa",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// pressure advance group
+	{ "","rt",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// firmware retraction group
+	{ "","pcx", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// lead-screw pitch map groups
+	{ "","pcy", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+	{ "","pcz", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+	{ "","sk",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// skew correction group
+	{ "","pr1", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// machining preset groups
+	{ "","pr2", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+	{ "","pr3", _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },
+#ifdef __PERF_COUNTERS
+	{ "","pf",  _f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// performance counter group
+#endif
 
 #ifdef __DIAGNOSTIC_PARAMETERS
 	{ "","_te",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// target axis endpoint group
@@ -687,8 +1104,17 @@ const cfgItem_t cfgArray[] PROGMEM = {
 	{ "","_cs",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// commanded motor steps group
 	{ "","_es",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// encoder steps group
 	{ "","_xs",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// correction steps group
+	{ "","_xn",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// corrections applied group
 	{ "","_fe",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// following error group
 #endif
+#ifdef __ISR_TIMING
+	{ "","_td",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// DDA ISR timing group
+	{ "","_tw",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// dwell ISR timing group
+	{ "","_tl",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// load timing group
+	{ "","_tx",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// exec timing group
+	{ "","_tk",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// kinematics timing group
+	{ "","_tg",_f0, 0, tx_print_nul, get_grp, set_grp,(float *)&cs.null,0 },	// load latency timing group
+#endif
 
 	// Uber-group (groups of groups, for text-mode displays only)
 	// *** Must agree with NV_COUNT_UBER_GROUPS below ****
@@ -701,7 +1127,7 @@ const cfgItem_t cfgArray[] PROGMEM = {
 /***** Make sure these defines line up with any changes in the above table *****/
 
 #define NV_COUNT_UBER_GROUPS 	4 		// count of uber-groups, above
-#define STANDARD_GROUPS 		33		// count of standard groups, excluding diagnostic parameter groups
+#define STANDARD_GROUPS 		53		// count of standard groups, excluding diagnostic parameter groups
 
 #if (MOTORS >= 5)
 #define MOTOR_GROUP_5			1
@@ -716,11 +1142,23 @@ const cfgItem_t cfgArray[] PROGMEM = {
 #endif
 
 #ifdef __DIAGNOSTIC_PARAMETERS
-#define DIAGNOSTIC_GROUPS 		8		// count of diagnostic groups only
+#define DIAGNOSTIC_GROUPS 		9		// count of diagnostic groups only
 #else
 #define DIAGNOSTIC_GROUPS 		0
 #endif
-#define NV_COUNT_GROUPS 		(STANDARD_GROUPS + MOTOR_GROUP_5 + MOTOR_GROUP_6 + DIAGNOSTIC_GROUPS)
+
+#ifdef __ISR_TIMING
+#define TIMING_GROUPS 			6		// count of ISR timing groups only
+#else
+#define TIMING_GROUPS 			0
+#endif
+
+#ifdef __PERF_COUNTERS
+#define PERF_GROUPS 			1		// performance counter group
+#else
+#define PERF_GROUPS 			0
+#endif
+#define NV_COUNT_GROUPS 		(STANDARD_GROUPS + MOTOR_GROUP_5 + MOTOR_GROUP_6 + DIAGNOSTIC_GROUPS + TIMING_GROUPS + PERF_GROUPS)
 
 /* <DO NOT MESS WITH THESE DEFINES> */
 #define NV_INDEX_MAX (sizeof cfgArray / sizeof(cfgItem_t))
@@ -763,6 +1201,7 @@ stat_t set_flu(nvObj_t *nv)
 void preprocess_float(nvObj_t *nv)
 {
 	if (isnan((double)nv->value) || isinf((double)nv->value)) return; // illegal float values
+	if (nv->index >= NV_INDEX_MAX) return;			// echo of an unrecognized name
 	if (GET_TABLE_BYTE(flags) & F_CONVERT) {		// unit conversion required?
 		if (cm_get_units_mode(MODEL) == INCHES) {
 			nv->value *= INCHES_PER_MM;
@@ -777,31 +1216,27 @@ void preprocess_float(nvObj_t *nv)
  *	- offsets		- group of all offsets and stored positions
  *	- all			- group of all groups
  *
- * _do_group_list()	- get and print all groups in the list (iteration)
- * _do_motors()		- get and print motor uber group 1-N
- * _do_axes()		- get and print axis uber group XYZABC
- * _do_offsets()	- get and print offset uber group G54-G59, G28, G30, G92
- * _do_all()		- get and print all groups uber group
+ * _do_group_list()	- add all groups in the list to the dump (iteration)
+ * _list_motors()	- add motor groups 1-N to the dump
+ * _list_axes()		- add axis groups XYZABC to the dump
+ * _list_offsets()	- add the offset groups G54-G59, G28, G30, G92 and the tool table to the dump
+ * _do_motors()		- print motor uber group 1-N
+ * _do_axes()		- print axis uber group XYZABC
+ * _do_offsets()	- print offset uber group G54-G59, G28, G30, G92
+ * _do_all()		- print all groups uber group
+ *
+ * The groups are printed by the incremental dump (see nv_stream_run() in config.c).
  */
 
-static stat_t _do_group_list(nvObj_t *nv, char list[][TOKEN_LEN+1]) // helper to print multiple groups in a list
+static void _do_group_list(char list[][TOKEN_LEN+1]) // helper to list multiple groups for the dump
 {
 	for (uint8_t i=0; i < NV_MAX_OBJECTS; i++) {
-		if (list[i][0] == NUL)
-            return (STAT_COMPLETE);
-
-		nv_reset_nv_list();
-		nv = nv_body;
-		strncpy(nv->token, list[i], TOKEN_LEN);
-		nv->index = nv_get_index((const char_t *)"", nv->token);
-//		nv->valuetype = TYPE_PARENT;
-		nv_get_nvObj(nv);
-		nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+		if (list[i][0] == NUL) return;
+		nv_stream_add(list[i]);
 	}
-	return (STAT_COMPLETE);
 }
 
-static stat_t _do_motors(nvObj_t *nv)	// print parameters for all motor groups
+static void _list_motors(void)
 {
 #if MOTORS == 2
 	char list[][TOKEN_LEN+1] = {"1","2",""}; // must have a terminating element
@@ -818,35 +1253,52 @@ static stat_t _do_motors(nvObj_t *nv)	// print parameters for all motor groups
 #if MOTORS == 6
 	char list[][TOKEN_LEN+1] = {"1","2","3","4","5","6",""}; // must have a terminating element
 #endif
-	return (_do_group_list(nv, list));
+	_do_group_list(list);
+}
+
+static void _list_axes(void)
+{
+	char list[][TOKEN_LEN+1] = {"x","y","z","a","b","c",""}; // must have a terminating element
+	_do_group_list(list);
+}
+
+static void _list_offsets(void)
+{
+	char list[][TOKEN_LEN+1] = {"g54","g55","g56","g57","g58","g59","g92","g28","g30","tt1","tt2","tt3","tt4",""}; // must have a terminating element
+	_do_group_list(list);
+}
+
+static stat_t _do_motors(nvObj_t *nv)	// print parameters for all motor groups
+{
+	nv_stream_start();
+	_list_motors();
+	return (nv_stream_run(nv));
 }
 
 static stat_t _do_axes(nvObj_t *nv)	// print parameters for all axis groups
 {
-	char list[][TOKEN_LEN+1] = {"x","y","z","a","b","c",""}; // must have a terminating element
-	return (_do_group_list(nv, list));
+	nv_stream_start();
+	_list_axes();
+	return (nv_stream_run(nv));
 }
 
-static stat_t _do_offsets(nvObj_t *nv)	// print offset parameters for G54-G59,G92, G28, G30
+static stat_t _do_offsets(nvObj_t *nv)	// print offset parameters for G54-G59,G92, G28, G30 and the tool table
 {
-	char list[][TOKEN_LEN+1] = {"g54","g55","g56","g57","g58","g59","g92","g28","g30",""}; // must have a terminating element
-	return (_do_group_list(nv, list));
+	nv_stream_start();
+	_list_offsets();
+	return (nv_stream_run(nv));
 }
 
 static stat_t _do_all(nvObj_t *nv)	// print all parameters
 {
-	strcpy(nv->token,"sys");			// print system group
-	get_grp(nv);
-	nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
-
-	_do_motors(nv);					// print all motor groups
-	_do_axes(nv);						// print all axis groups
-
-	strcpy(nv->token,"p1");			// print PWM group
-	get_grp(nv);
-	nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
-
-	return (_do_offsets(nv));			// print all offsets
+	nv_stream_start();
+	nv_stream_add((const char_t *)"sys");	// system group
+	_list_motors();						// all motor groups
+	_list_axes();						// all axis groups
+	nv_stream_add((const char_t *)"p1");	// PWM groups
+	nv_stream_add((const char_t *)"p2");
+	_list_offsets();					// all offsets
+	return (nv_stream_run(nv));
 }
 
 /***********************************************************************************
@@ -861,6 +1313,11 @@ static stat_t _do_all(nvObj_t *nv)	// print all parameters
  * set_ex() - enable XON/XOFF or RTS/CTS flow control
  * set_baud() - set USB baud rate
  * get_rx()	- get bytes available in RX buffer
+ * get_job() - get length of the job stored in SPI flash (see xio_file.h)
+ * set_job() - 1 = start an upload, 0 = end the upload, 2 = run the stored job
+ * get_jcrc() - get the CRC-16 of the stored job, or of the lines uploaded so far
+ * get_jrc() - get the runs of the stored job left, including the one in progress
+ * set_jrc() - set how many times $job=2 runs the stored job
  *
  *	The above assume USB is the std device
  */
@@ -891,14 +1348,39 @@ static stat_t set_ee(nvObj_t *nv) 				// enable character echo
 	return(_set_comm_helper(nv, XIO_ECHO, XIO_NOECHO));
 }
 
-static stat_t set_ex(nvObj_t *nv)				// enable XON/XOFF or RTS/CTS flow control
+static stat_t set_ex(nvObj_t *nv)				// enable XON/XOFF, RTS/CTS or char counting flow control
 {
-	if (nv->value > FLOW_CONTROL_RTS)
+	if (nv->value > FLOW_CONTROL_COUNT)
         return (STAT_INPUT_VALUE_RANGE_ERROR);
 	cfg.enable_flow_control = (uint8_t)nv->value;
+	if (cfg.enable_flow_control == FLOW_CONTROL_COUNT) {
+		(void)xio_ctrl(XIO_DEV_USB, XIO_NOXOFF);	// the host never sends more than the window
+		return (STAT_OK);
+	}
+	if (cfg.enable_flow_control == FLOW_CONTROL_RTS) {
+		(void)xio_ctrl(XIO_DEV_USB, XIO_NOXOFF);	// the RTS line is driven from the RX buffer, no XON/XOFF
+		return (STAT_OK);
+	}
 	return(_set_comm_helper(nv, XIO_XOFF, XIO_NOXOFF));
 }
 
+/*
+ * set_pnm() - mirror classes of output lines to the RS485 pendant
+ *
+ *	The value is a mask of XIO_OUT_ line classes, e.g. 2 sends only status reports to a
+ *	pendant display. Lines are formatted once and fanned out (see xio_set_output()). The
+ *	mirror is only turned on in standalone mode as the network uses the same port - set
+ *	$pnm again after changing $net.
+ */
+static stat_t set_pnm(nvObj_t *nv)
+{
+	if (nv->value > XIO_OUT_ALL)
+        return (STAT_INPUT_VALUE_RANGE_ERROR);
+	cs.pendant_mirror = (uint8_t)nv->value;
+	xio_set_output(XIO_DEV_RS485, (cs.network_mode == NETWORK_STANDALONE) ? cs.pendant_mirror : 0);
+	return (STAT_OK);
+}
+
 static stat_t get_rx(nvObj_t *nv)
 {
 #ifdef __AVR
@@ -913,6 +1395,59 @@ static stat_t get_rx(nvObj_t *nv)
 #endif
 }
 
+static stat_t get_job(nvObj_t *nv)
+{
+	nv->value = (float)xio_get_flash_job_length();
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+static stat_t set_job(nvObj_t *nv)
+{
+	switch ((uint8_t)nv->value) {
+		case 0: { return (xio_close_flash_upload());}
+		case 1: {
+			if ((cs.primary_src == XIO_DEV_FLASH) || (xio_flash_is_storing() == true)) {
+				return (STAT_COMMAND_NOT_ACCEPTED);
+			}
+			return (xio_open_flash_upload());
+		}
+		case 2: {
+			if ((cs.primary_src == XIO_DEV_FLASH) || (xio_flash_is_storing() == true)) {
+				return (STAT_COMMAND_NOT_ACCEPTED);
+			}
+			if (xio_open(XIO_DEV_FLASH, 0, FLASH_FLAGS) == NULL) {
+				return (STAT_FILE_NOT_OPEN);			// no flash or no job stored
+			}
+			tg_set_primary_source(XIO_DEV_FLASH);
+			return (STAT_OK);
+		}
+		default: return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+}
+
+static stat_t get_jcrc(nvObj_t *nv)
+{
+	nv->value = (float)xio_get_flash_job_crc();
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+static stat_t get_jrc(nvObj_t *nv)
+{
+	nv->value = (float)xio_get_flash_runs_left();
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+static stat_t set_jrc(nvObj_t *nv)
+{
+	if ((nv->value < 0) || (nv->value > 65535)) return (STAT_INPUT_VALUE_RANGE_ERROR);
+	if (cs.primary_src == XIO_DEV_FLASH) return (STAT_COMMAND_NOT_ACCEPTED);
+	xio_set_flash_runs((uint16_t)nv->value);
+	return (STAT_OK);
+}
+
 /* run_sx()	- send XOFF, XON --- test only
 static stat_t run_sx(nvObj_t *nv)
 {
@@ -965,6 +1500,43 @@ stat_t set_baud_callback(void)
 	return (STAT_OK);
 }
 
+/*
+ * config_update_derived() - rebuild the derived values config changes have made stale
+ *
+ *	Setters only mark what they invalidate (config_mark_derived()). The values are rebuilt
+ *	here once before the next move is planned (see mp_aline()), at the end of a defaults
+ *	or profile load and at a transaction commit or abort, so a full settings push computes
+ *	each of them once rather than once per setting. Steps per unit feed the motor map,
+ *	which must be current before the steppers are reset onto the runtime position, and
+ *	both feed the axis step rate velocity limits.
+ */
+
+void config_update_derived()
+{
+	uint8_t dirty = cfg.derived_dirty;
+	if (dirty == 0) return;
+	cfg.derived_dirty = 0;
+
+	if (dirty & DERIVED_STEPS_PER_UNIT) {
+		st_update_steps_per_unit();
+	}
+	if (dirty & (DERIVED_STEPS_PER_UNIT | DERIVED_MOTOR_MAP)) {
+		ik_map_motors();
+	}
+	if (dirty & (DERIVED_STEPS_PER_UNIT | DERIVED_MOTOR_MAP | DERIVED_STEP_VELOCITY)) {
+		cm_update_step_velocity();
+	}
+	if (dirty & DERIVED_STEPS_PER_UNIT) {
+		st_reset();
+	}
+	if (dirty & DERIVED_JERK) {
+		cm_update_axis_jerk();
+	}
+	if (dirty & DERIVED_JUNCTION) {
+		cm_update_junction_limits();
+	}
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -975,16 +1547,26 @@ stat_t set_baud_callback(void)
 //static const char fmt_ic[] PROGMEM = "[ic]  ignore CR or LF on RX%8d [0=off,1=CR,2=LF]\n";
 static const char fmt_ec[] PROGMEM = "[ec]  expand LF to CRLF on TX%6d [0=off,1=on]\n";
 static const char fmt_ee[] PROGMEM = "[ee]  enable echo%18d [0=off,1=on]\n";
-static const char fmt_ex[] PROGMEM = "[ex]  enable flow control%10d [0=off,1=XON/XOFF, 2=RTS/CTS]\n";
+static const char fmt_ex[] PROGMEM = "[ex]  enable flow control%10d [0=off,1=XON/XOFF, 2=RTS/CTS, 3=count]\n";
+static const char fmt_lc[] PROGMEM = "[lc]  line number checking%9d [0=off,1=N and *checksum with resend]\n";
 static const char fmt_baud[] PROGMEM = "[baud] USB baud rate%15d [1=9600,2=19200,3=38400,4=57600,5=115200,6=230400]\n";
-static const char fmt_net[] PROGMEM = "[net] network mode%17d [0=master]\n";
+static const char fmt_net[] PROGMEM = "[net] network mode%17d [0=standalone,1=master,2=slave]\n";
+static const char fmt_pnd[] PROGMEM = "[pnd] RS485 pendant channel%8d [0=off,1=on]\n";
+static const char fmt_pnm[] PROGMEM = "[pnm] RS485 pendant mirror%9d [0=off,1=responses,2=SR,4=QR,8=ER,16=other]\n";
+static const char fmt_ast[] PROGMEM = "[ast] assertion level%14d [0=cheap,1=full checks on a time slice,2=full checks always]\n";
+static const char fmt_slp[] PROGMEM = "[slp] idle sleep%19d [0=off,1=sleep between passes when idle]\n";
 static const char fmt_rx[] PROGMEM = "rx:%d\n";
 
 void cfg_print_ec(nvObj_t *nv) { text_print_ui8(nv, fmt_ec);}
 void cfg_print_ee(nvObj_t *nv) { text_print_ui8(nv, fmt_ee);}
 void cfg_print_ex(nvObj_t *nv) { text_print_ui8(nv, fmt_ex);}
+void cfg_print_lc(nvObj_t *nv) { text_print_ui8(nv, fmt_lc);}
 void cfg_print_baud(nvObj_t *nv) { text_print_ui8(nv, fmt_baud);}
 void cfg_print_net(nvObj_t *nv) { text_print_ui8(nv, fmt_net);}
+void cfg_print_pnd(nvObj_t *nv) { text_print_ui8(nv, fmt_pnd);}
+void cfg_print_pnm(nvObj_t *nv) { text_print_ui8(nv, fmt_pnm);}
+void cfg_print_ast(nvObj_t *nv) { text_print_ui8(nv, fmt_ast);}
+void cfg_print_slp(nvObj_t *nv) { text_print_ui8(nv, fmt_slp);}
 void cfg_print_rx(nvObj_t *nv) { text_print_ui8(nv, fmt_rx);}
 
 #endif // __TEXT_MODE
@@ -50,10 +50,12 @@ typedef struct cfgParameters {		// mostly communications variables at this point
 	uint8_t enable_cr;				// enable CR in CRFL expansion on TX
 	uint8_t enable_echo;			// enable text-mode echo
 	uint8_t enable_flow_control;	// enable XON/XOFF or RTS/CTS flow control
+	uint8_t line_check;				// check N line numbers and *checksums, request resends (see _check_line())
 //	uint8_t ignore_crlf;			// ignore CR or LF on RX --- these 4 are shadow settings for XIO cntrl bits
 
 	uint8_t usb_baud_rate;			// see xio_usart.h for XIO_BAUD values
 	uint8_t usb_baud_flag;			// technically this belongs in the controller singleton
+	uint8_t derived_dirty;			// derived values that are out of date (see cfgDerived)
 
 	// user-defined data groups
 	uint32_t user_data_a[4];
@@ -65,12 +67,22 @@ typedef struct cfgParameters {		// mostly communications variables at this point
 } cfgParameters_t;
 extern cfgParameters_t cfg;
 
+enum cfgDerived {					// derived values rebuilt by config_update_derived()
+	DERIVED_STEPS_PER_UNIT = 0x01,	// motor steps per unit from sa, tr and mi
+	DERIVED_MOTOR_MAP = 0x02,		// kinematics motor map from ma and am
+	DERIVED_JERK = 0x04,			// axis jerk reciprocals from jm
+	DERIVED_JUNCTION = 0x08,		// axis junction limits from jd and ja
+	DERIVED_STEP_VELOCITY = 0x10	// axis step rate velocity limits from the motor map, mi, msr and dda
+};
+#define config_mark_derived(d) (cfg.derived_dirty |= (d))
+
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
  * Functions to get and set variables from the cfgArray table
  ***********************************************************************************/
 
 stat_t set_baud_callback(void);
+void config_update_derived(void);
 
 // job config
 void job_print_job(nvObj_t *nv);
@@ -88,8 +100,13 @@ uint8_t job_report_callback();
 	void cfg_print_ec(nvObj_t *nv);
 	void cfg_print_ee(nvObj_t *nv);
 	void cfg_print_ex(nvObj_t *nv);
+	void cfg_print_lc(nvObj_t *nv);
 	void cfg_print_baud(nvObj_t *nv);
 	void cfg_print_net(nvObj_t *nv);
+	void cfg_print_pnd(nvObj_t *nv);
+	void cfg_print_pnm(nvObj_t *nv);
+	void cfg_print_ast(nvObj_t *nv);
+	void cfg_print_slp(nvObj_t *nv);
 	void cfg_print_rx(nvObj_t *nv);
 
 #else
@@ -97,8 +114,13 @@ uint8_t job_report_callback();
 	#define cfg_print_ec tx_print_stub
 	#define cfg_print_ee tx_print_stub
 	#define cfg_print_ex tx_print_stub
+	#define cfg_print_lc tx_print_stub
 	#define cfg_print_baud tx_print_stub
 	#define cfg_print_net tx_print_stub
+	#define cfg_print_pnd tx_print_stub
+	#define cfg_print_pnm tx_print_stub
+	#define cfg_print_ast tx_print_stub
+	#define cfg_print_slp tx_print_stub
 	#define cfg_print_rx tx_print_stub
 
 #endif // __TEXT_MODE
@@ -34,16 +34,22 @@
 #include "gcode_parser.h"
 #include "canonical_machine.h"
 #include "plan_arc.h"
+#include "persistence.h"
 #include "planner.h"
+#include "plan_spline.h"
 #include "stepper.h"
 
 #include "encoder.h"
+#include "network.h"
 #include "hardware.h"
 #include "switch.h"
 #include "gpio.h"
+#include "analog.h"
 #include "report.h"
 #include "help.h"
+#include "test.h"
 #include "util.h"
+#include "perf.h"
 #include "xio.h"
 
 #ifdef __ARM
@@ -61,13 +67,33 @@ controller_t cs;		// controller state structure
  ***********************************************************************************/
 
 static void _controller_HSM(void);
+static stat_t _controller_critical(void);
+static void _controller_sleep(void);
+static stat_t _deferred_init(void);
 static stat_t _shutdown_idler(void);
 static stat_t _normal_idler(void);
 static stat_t _limit_switch_handler(void);
 static stat_t _system_assertions(void);
 static stat_t _sync_to_planner(void);
+static stat_t _planner_has_room(void);
 static stat_t _sync_to_tx_buffer(void);
 static stat_t _command_dispatch(void);
+static stat_t _pendant_dispatch(void);
+static stat_t _dispatch_chunk(char_t *buf, uint8_t more);
+static void _keep_line(uint8_t keep);
+static void _save_line(const char_t *str);
+static uint8_t _hold_line(const char_t *str);
+static uint8_t _check_line(char_t *str);
+#ifdef __ARM
+static stat_t _read_usb_line(xioLine_t *line);
+#endif
+#ifdef __TASK_TIMING
+static void _task_timing(uint8_t task, const char *name, uint32_t start, stat_t status, uint8_t leaf);
+static void _critical_timing(void);
+static void _pass_start(void);
+static void _pass_timing(void);
+static void _sleep_timing(uint32_t start);
+#endif
 
 // prep for export to other modules:
 stat_t hardware_hard_reset_handler(void);
@@ -80,6 +106,12 @@ stat_t hardware_bootloader_handler(void);
  * controller_init() - controller init
  */
 
+static const uint8_t subscriptions[SUB_COUNT] = {	// topics each subscriber runs on (see cmSubscriber)
+	TOPIC_MOVE_START | TOPIC_MOVE_END | TOPIC_STATE | TOPIC_TICK,	// SR - a timed report only falls due on a tick
+	TOPIC_MOVE_END | TOPIC_STATE | TOPIC_TICK,		// feedhold sequencing
+	TOPIC_BUFFER_FREE | TOPIC_TICK					// planner sync
+};
+
 void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err)
 {
 	memset(&cs, 0, sizeof(controller_t));			// clear all values, job_id's, pointers and status
@@ -88,6 +120,10 @@ void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err)
 	cs.fw_build = TINYG_FIRMWARE_BUILD;
 	cs.fw_version = TINYG_FIRMWARE_VERSION;
 	cs.hw_platform = TINYG_HARDWARE_PLATFORM;		// NB: HW version is set from EEPROM
+	cs.init_deferred = true;						// finish the boot from the first controller pass
+	for (uint8_t i=0; i < SUB_COUNT; i++) {
+		cs.pending[i] = subscriptions[i];			// every subscriber runs once to start
+	}
 
 #ifdef __AVR
 	cs.state = CONTROLLER_STARTUP;					// ready to run startup lines
@@ -96,6 +132,7 @@ void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err)
 	xio_set_stderr(std_err);
 	cs.default_src = std_in;
 	tg_set_primary_source(cs.default_src);
+	tg_set_secondary_source(XIO_DEV_RS485);		// read only with $pnd=1 (see _pendant_dispatch())
 #endif
 
 #ifdef __ARM
@@ -138,62 +175,231 @@ stat_t controller_test_assertions()
  * and runs the next routine in the list.
  *
  * A routine that had no action (i.e. is OFF or idle) should return STAT_NOOP
+ *
+ * The critical tasks (resets, shutdown, limit switches, feedhold sequencing and
+ * hold planning, assertions) are grouped in _controller_critical(). The group runs
+ * first in every pass and is run again after any report or continuation task that
+ * did work (returned other than STAT_NOOP). The loop is cooperative - a task cannot
+ * be preempted - so the re-runs bound the latency of a feedhold to the longest single
+ * task rather than to a whole pass through the list.
+ *
+ * With __TASK_TIMING enabled every dispatch site also records its run count, total
+ * and maximum run time (ms) and the number of runs over CONTROLLER_TASK_BUDGET_MS,
+ * and the critical group records its longest interval between runs. See $_tsk
+ * Passes longer than $_tsp ms are traced with the task that took the time. See $_tsp
+ * Time spent asleep is not part of any pass, so the times are busy time only.
+ *
+ * Between passes the CPU sleeps if nothing is pending (see _controller_sleep()).
  */
 
 void controller_run()
 {
 	while (true) {
+		cs.events = 0;							// a single byte write is atomic
+#ifdef __ARM
+		if (SysTickTimer.getValue() != cs.tick) {	// there is no RTC ISR to publish the tick
+			cs.tick = SysTickTimer.getValue();
+			controller_publish(TOPIC_TICK);
+		}
+#endif
+#ifdef __TASK_TIMING
+		_pass_start();
+		_controller_HSM();
+		_pass_timing();
+#else
 		_controller_HSM();
+#endif
+		_controller_sleep();
 	}
 }
-
-#define	DISPATCH(func) if (func == STAT_EAGAIN) return;
-static void _controller_HSM()
+
+/*
+ * controller_publish() - post typed events to the tasks that subscribe to them
+ * controller_take_events() - return and clear the topics published to a subscriber
+ *
+ *	Tasks that only have work after something changes subscribe to topics (see the
+ *	subscriptions table) instead of polling state every pass. The planner, runtime and
+ *	canonical machine publish the changes. A subscriber takes its events at the top of
+ *	its task and returns at once if there are none. Taking clears the topics before the
+ *	task looks at any state, so a topic published while it runs is kept for the next
+ *	pass rather than lost. Every waiting subscriber also takes TOPIC_TICK so a change no
+ *	topic covers (e.g. TX buffer space) is seen within an RTC tick.
+ *
+ *	controller_publish() is safe from any interrupt level, and wakes the controller.
+ */
+
+void controller_publish(const uint8_t topics)
+{
+#ifdef __AVR
+	uint8_t sreg = SREG;
+	cli();
+#endif
+	for (uint8_t i=0; i < SUB_COUNT; i++) {
+		if (subscriptions[i] & topics) cs.pending[i] |= topics;
+	}
+	controller_post_event(EVENT_PASS);
+#ifdef __AVR
+	SREG = sreg;
+#endif
+}
+
+uint8_t controller_take_events(const uint8_t subscriber)
+{
+	uint8_t topics = cs.pending[subscriber];
+	if (topics != 0) {
+		cs.pending[subscriber] = 0;					// a single byte write is atomic
+	}
+	return (topics);
+}
+
+/*
+ * _controller_sleep() - sleep until the next interrupt if there is nothing to do
+ *
+ *	Without this the controller spins through every task in the list even when the
+ *	machine is idle. Anything that can give it work either comes from an interrupt -
+ *	RX chars, the RTC tick that runs the timers and timed reports, switch edges and
+ *	the steppers - or from a task that did work in the pass and posts EVENT_PASS. The
+ *	ISRs post an event too, so work that arrived during the pass is never slept on.
+ *	Any interrupt ends the sleep, so a wait that is only polled (a TX drain, an EEPROM
+ *	write) runs again within one RTC tick.
+ *
+ *	The controller only sleeps when the machine is stopped and no line is held or
+ *	partly read, as the planner and the segment exec need every pass while it moves.
+ *	Sleep is IDLE mode, which leaves the clocks and peripherals running. $slp=0 turns
+ *	it off, e.g. for an on-chip debugger that can't follow a sleeping core.
+ */
+
+static void _controller_sleep()
+{
+	if (cs.idle_sleep == false) return;
+	if ((cs.events != 0) || (cs.init_deferred == true)) return;
+	if ((cs.line_held == true) || (cs.line_chunked != LINE_CHUNK_OFF) || (cs.pendant_held == true)) return;
+	if ((cs.tx_stalled == true) || (cm.cycle_state != CYCLE_OFF) || (cm_get_runtime_busy() == true)) return;
+	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_POOL_SIZE) return;
+#ifdef __TASK_TIMING
+	uint32_t start = SysTickTimer_getValue();
+	hw_sleep(&cs.events);
+	_sleep_timing(start);
+#else
+	hw_sleep(&cs.events);
+#endif
+}
+
+#ifdef __TASK_TIMING
+enum { CONTROLLER_TASK_BASE = __COUNTER__ };	// dispatch sites are numbered from here
+#define	RUN_TASK(func, s, leaf) uint32_t _t = SysTickTimer_getValue(); stat_t s = func; \
+						  _task_timing(__COUNTER__ - CONTROLLER_TASK_BASE - 1, PSTR(#func), _t, s, leaf)
+#else
+#define	RUN_TASK(func, s, leaf) stat_t s = func
+#endif
+
+#define	DISPATCH(func) { RUN_TASK(func, _s, true); if (_s == STAT_EAGAIN) return; }
+#define	DISPATCH_GROUP(func) { RUN_TASK(func, _s, false); if (_s == STAT_EAGAIN) return; }	// a group of dispatches
+#define	DISPATCH_CRITICAL(func) { RUN_TASK(func, _s, true); if (_s == STAT_EAGAIN) return (STAT_EAGAIN); }
+#define	DISPATCH_YIELD(func) { RUN_TASK(func, _s, true); if (_s == STAT_EAGAIN) return; if (_s != STAT_NOOP) { \
+						  controller_post_event(EVENT_PASS); if (_controller_critical() == STAT_EAGAIN) return; }}
+
+static stat_t _controller_critical()
 {
 //----- Interrupt Service Routines are the highest priority controller functions ----//
 //      See hardware.h for a list of ISRs and their priorities.
 //
 //----- kernel level ISR handlers ----(flags are set in ISRs)------------------------//
 												// Order is important:
-	DISPATCH(hw_hard_reset_handler());			// 1. handle hard reset requests
-	DISPATCH(hw_bootloader_handler());			// 2. handle requests to enter bootloader
-	DISPATCH(_shutdown_idler());				// 3. idle in shutdown state
-//	DISPATCH( poll_switches());					// 4. run a switch polling cycle
-	DISPATCH(_limit_switch_handler());			// 5. limit switch has been thrown
+	DISPATCH_CRITICAL(hw_hard_reset_handler());	// 1. handle hard reset requests
+	DISPATCH_CRITICAL(hw_bootloader_handler());	// 2. handle requests to enter bootloader
+	DISPATCH_CRITICAL(_shutdown_idler());		// 3. idle in shutdown state
+//	DISPATCH_CRITICAL( poll_switches());		// 4. run a switch polling cycle
+	DISPATCH_CRITICAL(_limit_switch_handler());	// 5. limit switch has been thrown
+	DISPATCH_CRITICAL(en_following_error_callback());// 5a. a motor stalled or lost steps
+	DISPATCH_CRITICAL(net_callback());			// 5b. network frame lost, or a slave's exec to restart
 
-	DISPATCH(cm_feedhold_sequencing_callback());// 6a. feedhold state machine runner
-	DISPATCH(mp_plan_hold_callback());			// 6b. plan a feedhold from line runtime
-	DISPATCH(_system_assertions());				// 7. system integrity assertions
+	DISPATCH_CRITICAL(cm_feedhold_sequencing_callback());	// 6a. feedhold state machine runner
+#ifndef __PLAN_ISR								// run from the PendSV interrupt (see stepper.c)
+	DISPATCH_CRITICAL(mp_plan_hold_callback());	// 6b. plan a feedhold from line runtime
+#endif
+	DISPATCH_CRITICAL(cm_override_callback());	// 6c. realtime feed, traverse and spindle overrides
+	DISPATCH_CRITICAL(_system_assertions());	// 7. system integrity assertions
+#ifdef __TASK_TIMING
+	_critical_timing();
+#endif
+	return (STAT_OK);
+}
+
+static void _controller_HSM()
+{
+	DISPATCH_GROUP(_controller_critical());		// safety, hold and integrity tasks
+	DISPATCH(_deferred_init());					// finish the boot once the system is ready
 
 //----- planner hierarchy for gcode and cycles ---------------------------------------//
 
 	DISPATCH(st_motor_power_callback());		// stepper motor power sequencing
+	DISPATCH(analog_callback());				// filter the analog inputs
 //	DISPATCH(switch_debounce_callback());		// debounce switches
-	DISPATCH(sr_status_report_callback());		// conditionally send status report
-	DISPATCH(qr_queue_report_callback());		// conditionally send queue report
-	DISPATCH(rx_report_callback());             // conditionally send rx report
-	DISPATCH(cm_arc_callback());				// arc generation runs behind lines
+	DISPATCH_YIELD(sr_status_report_callback());// conditionally send status report
+	DISPATCH_YIELD(qr_queue_report_callback());	// conditionally send queue report
+	DISPATCH_YIELD(rx_report_callback());		// conditionally send rx report
+	DISPATCH_YIELD(ak_report_callback());		// acknowledge accepted lines in streaming mode
+	DISPATCH_YIELD(jp_job_profile_callback());	// send the job profile at program end
+	DISPATCH_YIELD(bm_report_callback());		// send the cycle time benchmark at program end
+	DISPATCH(mp_merge_callback());				// release lines held for merging or cutter compensation as the queue runs low
+	DISPATCH(mp_prime_callback());				// start the first move of a cycle once the queue is primed
+	DISPATCH(mp_dry_run_callback());			// retire planned moves and report the estimate in a dry run
+	DISPATCH_YIELD(mp_preview_callback());		// send the planner queue preview a move at a time
+	DISPATCH_YIELD(cm_arc_callback());			// arc generation runs behind lines
+	DISPATCH_YIELD(cm_spline_callback());		// spline segments run behind their block when the table is full
+	DISPATCH_YIELD(cm_canned_cycle_callback());	// drilling cycle moves run behind their block
 	DISPATCH(cm_homing_callback());				// G28.2 continuation
 	DISPATCH(cm_jogging_callback());			// jog function
+	DISPATCH(cm_tuning_callback());				// jerk and velocity tuning cycle
 	DISPATCH(cm_probe_callback());				// G38.2 continuation
-	DISPATCH(cm_deferred_write_callback());		// persist G10 changes when not in machining cycle
+	DISPATCH(cm_probe_grid_callback());			// G29 continuation
+	DISPATCH(cm_deferred_write_callback());		// stage G10 changes for persistence
+	DISPATCH(cm_checkpoint_callback());			// record a power loss checkpoint while running
+	DISPATCH(persistence_callback());			// commit staged NVM writes when idle
 
 //----- command readers and parsers --------------------------------------------------//
 
+	DISPATCH(_pendant_dispatch());				// pendant lines run ahead of the primary source
+	DISPATCH(nv_stream_callback());				// print the next lines of a $$ or group dump
 	DISPATCH(_sync_to_planner());				// ensure there is at least one free buffer in planning queue
 	DISPATCH(_sync_to_tx_buffer());				// sync with TX buffer (pseudo-blocking)
 #ifdef __AVR
 	DISPATCH(set_baud_callback());				// perform baud rate update (must be after TX sync)
 #endif
+	DISPATCH_YIELD(gc_replay_callback());		// run stored subroutine and loop blocks
+	DISPATCH_YIELD(gc_read_ahead_callback());	// run a block read ahead while the planner was full
 	DISPATCH(_command_dispatch());				// read and execute next command
 	DISPATCH(_normal_idler());					// blink LEDs slowly to show everything is OK
 }
 
+/*
+ * _deferred_init() - run the boot stage that was left until after system ready
+ *
+ *	_application_init() only brings up what motion safety, the serial IO and the config
+ *	shadow need, then announces the system is ready. The rest runs once from here,
+ *	ahead of the reports and the command dispatcher, so the host can connect sooner
+ *	after a reset and nothing it sends is read before this stage is done.
+ */
+
+static stat_t _deferred_init()
+{
+	if (cs.init_deferred == false) return (STAT_NOOP);
+	cs.init_deferred = false;
+
+	sr_init_status_report();					// status report setup persists every entry
+	if (nvm.layout_error) {
+		rpt_exception(STAT_PERSISTENCE_ERROR);	// the profiles don't fit in NVM - nothing is saved
+	}
+	return (STAT_OK);
+}
+
 /*****************************************************************************
  * _command_dispatch() - dispatch line received from active input device
  *
  *	Reads next command line and dispatches to relevant parser or action
  *	Accepts commands if the move queue has room - EAGAINS if it doesn't
+ *	Gcode is read ahead while the queue is full - other lines are held (see _hold_line())
  *	Manages cutback to serial input from file devices (EOF)
  *	Also responsible for prompts and for flow control
  */
@@ -202,12 +408,18 @@ static stat_t _command_dispatch()
 {
 #ifdef __AVR
 	stat_t status;
+	xioLine_t line;
 
 	// read input line or return if not a completed line
-	// xio_gets() is a non-blocking workalike of fgets()
-	while (true) {
-		if ((status = xio_gets(cs.primary_src, cs.in_buf, sizeof(cs.in_buf))) == STAT_OK) {
-			cs.bufp = cs.in_buf;
+	// xio_get_line() is a non-blocking workalike of fgets() that also returns the line length
+	// A held line stays in the input buffer until the blocks read ahead of it have run
+	while (cs.line_held == false) {
+		if ((status = xio_get_line(cs.primary_src, cs.in_buf, sizeof(cs.in_buf), &line)) == STAT_OK) {
+			if ((line.more == true) || (cs.line_chunked != LINE_CHUNK_OFF)) {
+				return (_dispatch_chunk(line.buf, line.more));	// a line too long for the buffer
+			}
+			cs.bufp = line.buf;							// the parsers work on the line in place
+			cs.linelen = line.len;						// linelen only tracks primary input
 			break;
 		}
 		// handle end-of-file from file devices
@@ -227,16 +439,27 @@ static stat_t _command_dispatch()
 	if (SerialUSB.isConnected() == false) cs.state = CONTROLLER_NOT_CONNECTED;
 
 	// read input line and return if not a completed line
-	if (cs.state == CONTROLLER_READY) {
-		if (read_line(cs.in_buf, &cs.read_index, sizeof(cs.in_buf)) != STAT_OK) {
-			cs.bufp = cs.in_buf;
+	if (cs.line_held == true) {
+		// the held line is still in the input buffer
+	} else if (cs.state == CONTROLLER_READY) {
+		xioLine_t line;
+		if (_read_usb_line(&line) != STAT_OK) {
 			return (STAT_OK);	// This is an exception: returns OK for anything NOT OK, so the idler always runs
 		}
+		if ((line.more == true) || (cs.line_chunked != LINE_CHUNK_OFF)) {
+			return (_dispatch_chunk(line.buf, line.more));
+		}
+		cs.bufp = line.buf;								// the parsers work on the line in place
+		cs.linelen = line.len;							// linelen only tracks primary input
 	} else if (cs.state == CONTROLLER_NOT_CONNECTED) {
 		if (SerialUSB.isConnected() == false) return (STAT_OK);
 		cm_request_queue_flush();
 		rpt_print_system_ready_message();
 		cs.state = CONTROLLER_STARTUP;
+		cs.usb_tail = cs.usb_head = cs.usb_scan = 0;	// nothing left from the last connection is run
+		cs.in_buf[0] = NUL;
+		cs.bufp = cs.in_buf;							// the startup passes run an empty line
+		cs.linelen = 1;
 
 	} else if (cs.state == CONTROLLER_STARTUP) {		// run startup code
 		cs.state = CONTROLLER_READY;
@@ -244,12 +467,17 @@ static stat_t _command_dispatch()
 	} else {
 		return (STAT_OK);
 	}
-	cs.read_index = 0;
-#endif // __ARM
-
-	// set up the buffers
-	cs.linelen = strlen(cs.in_buf)+1;					// linelen only tracks primary input
-	strncpy(cs.saved_buf, cs.bufp, SAVED_BUFFER_LEN-1);	// save input buffer for reporting
+#endif // __ARM
+	if (cs.line_chunked != LINE_CHUNK_OFF) {
+		return (_dispatch_chunk(cs.bufp, false));		// the held end of a long line
+	}
+	if ((cs.line_held = _hold_line(cs.bufp)) == true) {
+		return (STAT_EAGAIN);							// wait for the blocks read ahead of it
+	}
+	if ((cfg.line_check == true) && (_check_line(cs.bufp) == false)) {
+		return (STAT_OK);								// already answered
+	}
+	uint32_t block_start = hw_get_usec();				// cycle time benchmark (see test.c)
 
 	// dispatch the new text line
 	switch (toupper(*cs.bufp)) {						// first char
@@ -260,35 +488,370 @@ static stat_t _command_dispatch()
 
 		case NUL: { 									// blank line (just a CR)
 			if (cfg.comm_mode != JSON_MODE) {
-				text_response(STAT_OK, cs.saved_buf);
+				text_response(STAT_OK, cs.bufp);
 			}
 			break;
 		}
 		case '$': case '?': case 'H': { 				// text mode input
 			cfg.comm_mode = TEXT_MODE;
+			_save_line(cs.bufp);						// the text parser rewrites the line
 			text_response(text_parser(cs.bufp), cs.saved_buf);
 			break;
 		}
-		case '{': { 									// JSON input
+		case STX: {										// pre-tokenized Gcode frame
+			stat_t frame_status = gc_gcode_frame_parser(cs.bufp+1);
+			if (cfg.comm_mode == JSON_MODE) {
+				nv_reset_nv_list();
+				nv_add_string((const char_t *)"gc", (const char_t *)"");	// respond as for a gc line
+				json_print_response(frame_status);
+			} else {
+				text_response(frame_status, (char_t *)"");	// a frame has nothing to echo
+			}
+			break;
+		}
+		case '{': case '[': { 							// JSON input (an array is several commands)
 			cfg.comm_mode = JSON_MODE;
+			_save_line(cs.bufp);						// reported on JSON syntax errors
 			json_parser(cs.bufp);
 			break;
 		}
 		default: {										// anything else must be Gcode
+			if (xio_flash_is_storing() == true) {		// stored while a job is uploaded...
+				stat_t store_status = xio_store_flash_line(cs.bufp, cs.linelen);
+				if (cfg.comm_mode == JSON_MODE) {
+					nv_reset_nv_list();
+					nv_add_string((const char_t *)"gc", (const char_t *)"");
+					json_print_response(store_status);
+				} else {
+					text_response(store_status, cs.bufp);
+				}
+				break;
+			}
 			if (cfg.comm_mode == JSON_MODE) {			// run it as JSON...
+				_save_line(cs.bufp);
 				strncpy(cs.out_buf, cs.bufp, INPUT_BUFFER_LEN -8);					// use out_buf as temp
-				sprintf((char *)cs.bufp,"{\"gc\":\"%s\"}\n", (char *)cs.out_buf);	// '-8' is used for JSON chars
-				json_parser(cs.bufp);
+				sprintf((char *)cs.in_buf,"{\"gc\":\"%s\"}\n", (char *)cs.out_buf);	// '-8' is used for JSON chars
+				json_parser(cs.in_buf);							// the line may not be in in_buf (ARM)
 			} else {									//...or run it as text
-				text_response(gc_gcode_parser(cs.bufp), cs.saved_buf);
+				text_response(gc_gcode_parser(cs.bufp), cs.bufp); // the Gcode parser leaves the line alone
 			}
 		}
 	}
+	bm_record_block(block_start);
+	controller_post_event(EVENT_PASS);					// there may be another line behind it
+	return (STAT_OK);
+}
+
+/*
+ * _dispatch_chunk() - run a chunk of a line too long for the input buffer
+ * _keep_line()		 - keep the unused end of a chunk to be read again with what follows
+ *
+ *	A line that fills the input buffer is read in chunks (see xio_get_line()). A JSON
+ *	line is run as it arrives by json_parse_chunk(), which answers it once, at its end.
+ *	The end of an element it can't run yet is kept at the front of the buffer and read
+ *	again with the chars that follow, so a long config push or raster row needs no more
+ *	RAM than a short line. Each chunk waits for the planner room any JSON line does.
+ *	The last chunk can't be read again, so if it has to wait it is held in the buffer
+ *	like a line (see _hold_line()).
+ *
+ *	Any other line that long can't be parsed. It is dropped as it arrives and answered
+ *	with STAT_INPUT_EXCEEDS_MAX_LENGTH at its end. Long lines are not line checked ($lc),
+ *	and linelen counts the whole line for the footer.
+ */
+static stat_t _dispatch_chunk(char_t *buf, uint8_t more)
+{
+	uint8_t chars = strlen(buf);
+	uint8_t used = chars;
+	stat_t status = STAT_OK;
+
+	if (cs.line_chunked == LINE_CHUNK_OFF) {			// first chunk
+		const char_t *rd = buf;
+		while (isspace((char)*rd)) { rd++; }
+		cs.line_chunked = ((*rd == '{') || (*rd == '[')) ? LINE_CHUNK_JSON : LINE_CHUNK_DROP;
+		cs.linelen = 0;
+		_save_line(buf);
+	}
+	if ((more == false) && (cs.line_held == false)) {
+		cs.linelen += chars + 1;						// the rest of the line and its terminator
+	}
+	if (cs.line_chunked == LINE_CHUNK_JSON) {
+		if ((gc_reading_ahead() == true) || (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false)) {
+			status = STAT_EAGAIN;
+			used = 0;
+		} else {
+			cfg.comm_mode = JSON_MODE;
+			status = json_parse_chunk(buf, more, &used);
+		}
+	}
+	if (more == true) {
+		cs.linelen += used;
+		_keep_line(chars - used);
+		return ((status == STAT_EAGAIN) ? STAT_EAGAIN : STAT_OK);
+	}
+	if (status == STAT_EAGAIN) {
+		cs.bufp = buf + used;							// hold the rest of the last chunk
+		cs.line_held = true;
+		return (STAT_EAGAIN);
+	}
+	if (cs.line_chunked == LINE_CHUNK_DROP) {
+		if (cfg.comm_mode == JSON_MODE) {
+			nv_reset_nv_list();
+			nv_add_string((const char_t *)"gc", (const char_t *)"");
+			json_print_response(STAT_INPUT_EXCEEDS_MAX_LENGTH);
+		} else {
+			text_response(STAT_INPUT_EXCEEDS_MAX_LENGTH, cs.saved_buf);
+		}
+	}
+	cs.line_chunked = LINE_CHUNK_OFF;
+	cs.line_held = false;
+	controller_post_event(EVENT_PASS);
 	return (STAT_OK);
 }
 
+static void _keep_line(uint8_t keep)
+{
+#ifdef __AVR
+	xio_keep_line(cs.primary_src, keep);
+#endif
+#ifdef __ARM
+	cs.usb_buf[cs.usb_chunk_end] = cs.usb_chunk_char;
+	cs.usb_tail = cs.usb_chunk_end - keep;
+#endif
+}
+
+
+/*****************************************************************************
+ * _pendant_dispatch() - dispatch a line received from the secondary source
+ *
+ *	With $pnd=1 the secondary source (RS485) is a pendant channel read ahead of the
+ *	primary one, so a pendant can send commands while the primary streams a job. Its
+ *	realtime characters are trapped in the RX ISR like those from USB. Its lines run
+ *	between primary lines: a line that has been read holds up the primary reader
+ *	until the planner has PLANNER_BUFFER_HEADROOM, which is a few buffers of queue
+ *	depth at most, rather than waiting for the primary RX buffer to drain. The
+ *	responses go back to the pendant and the comm mode of the primary is left alone.
+ *	Gcode is not taken from the pendant while a cycle runs, as it would land in the
+ *	middle of the primary's moves - neither as a text line nor as a JSON gc command
+ *	(see gc_run_gc()), which fail with STAT_COMMAND_NOT_ACCEPTED. The channel is not read in network mode, as the
+ *	network uses the same port.
+ */
+
+static stat_t _pendant_dispatch()
+{
+	if ((cs.pendant_enable == false) || (cs.network_mode != NETWORK_STANDALONE)) return (STAT_NOOP);
+#ifdef __AVR
+	if (cs.pendant_held == false) {
+		xioLine_t line;
+		if (xio_get_line(cs.secondary_src, cs.pendant_buf, sizeof(cs.pendant_buf), &line) != STAT_OK) {
+			return (STAT_NOOP);
+		}
+		controller_post_event(EVENT_PASS);				// there may be another line behind it
+		if ((line.more == true) || (cs.pendant_dropping == true)) {
+			xio_keep_line(cs.secondary_src, 0);			// too long for the pendant buffer - dropped
+			cs.pendant_dropping = line.more;
+			return (STAT_NOOP);
+		}
+		cs.pendant_held = true;
+	}
+	char_t *buf = cs.pendant_buf;
+	switch (*buf) {
+		case '!': { cm_request_feedhold(); cs.pendant_held = false; return (STAT_OK);}
+		case '%': { cm_request_queue_flush(); cs.pendant_held = false; return (STAT_OK);}
+		case '~': { cm_request_cycle_start(); cs.pendant_held = false; return (STAT_OK);}
+		case NUL: { cs.pendant_held = false; return (STAT_OK);}
+	}
+	if (nv_stream_active() == true) {
+		return (STAT_NOOP);								// hold the line until a dump to the primary ends
+	}
+	if (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false) {
+		return (STAT_EAGAIN);							// hold the primary until the line fits
+	}
+	cs.pendant_held = false;
+
+	xio_set_stdout(cs.secondary_src);					// answer the pendant
+	xio_set_stderr(cs.secondary_src);
+	switch (toupper(*buf)) {
+		case '$': case '?': case 'H': {
+			_save_line(buf);
+			stat_t status = text_parser(buf);
+			nv_stream_drain();							// a dump goes out now, before the output is switched back
+			text_response(status, cs.saved_buf);
+			break;
+		}
+		case '{': case '[': {
+			_save_line(buf);
+			cs.pendant_json = true;						// its gc elements are refused in a cycle too
+			json_parser(buf);
+			cs.pendant_json = false;
+			break;
+		}
+		default: {
+			stat_t status = STAT_COMMAND_NOT_ACCEPTED;
+			if (cm_get_machine_state() != MACHINE_CYCLE) {
+				status = gc_gcode_parser(buf);
+			}
+			text_response(status, buf);
+		}
+	}
+	xio_set_stdout(STD_OUT);
+	xio_set_stderr(STD_ERR);
+#endif // __AVR
+	return (STAT_OK);
+}
 
 /**** Local Utilities ********************************************************/
+/*
+ * _save_line() - keep a copy of a line for reporting after its parser has rewritten it
+ *
+ *	Only the modes that rewrite the line make the copy. The Gcode parser only reads
+ *	the block, so streamed Gcode is not copied.
+ */
+static void _save_line(const char_t *str)
+{
+	strncpy(cs.saved_buf, str, SAVED_BUFFER_LEN-1);
+	cs.saved_buf[SAVED_BUFFER_LEN-1] = NUL;
+}
+
+/*
+ * _hold_line() - return true if a line must wait for the blocks read ahead of it
+ *
+ *	While Gcode is being read ahead (see gc_read_ahead_callback()) only the blocks the
+ *	parser can store run through. Anything else waits in the input buffer until the
+ *	FIFO is empty and the planner has room, so commands keep the order they were sent.
+ *	Feedhold, queue flush and cycle start are never held.
+ *
+ *	Lines are read once the planner has room for a line move. Gcode that needs more (see
+ *	gc_block_headroom()) is read ahead, or held if it can't be. Other lines may queue
+ *	anything, so they are held until the planner has the full PLANNER_BUFFER_HEADROOM.
+ */
+static uint8_t _hold_line(const char_t *str)
+{
+	uint8_t reading_ahead = gc_reading_ahead();
+	if ((reading_ahead == false) && (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == true)) return (false);
+
+	switch (toupper(*str)) {
+		case '!': case '%': case '~': case NUL: return (false);
+		case '$': case '?': case 'H': case STX: case '{': case '[': return (true);
+	}
+	if (xio_flash_is_storing() == true) return (false);	// stored, not run
+	if ((reading_ahead == false) && (mp_planner_has_headroom(gc_block_headroom(str)) == true)) return (false);
+	return (gc_read_ahead_accepts(str) == false);
+}
+
+/*
+ * _check_line() - check the line number and checksum of a numbered line ($lc=1)
+ * _request_resend() - ask the host for the line expected next
+ *
+ *	A line that starts with N must end with *<checksum>, the XOR of every character
+ *	before the '*', which is taken in the same pass that finds it. The line numbers must
+ *	follow on from each other - M110 sets the next one (N<n> M110 expects n+1 next). A
+ *	corrupted line or one that follows a missed line is not run, and the only response
+ *	is a resend request for the line expected next: "rs:<n>" in text mode or {"rs":<n>}
+ *	with status 186 in JSON mode. The host then sends again from that line, and a line
+ *	that was already run is answered OK but not run again. Lines without an N are not
+ *	checked, so commands can still be typed. The checksum is cut off the line so the
+ *	parsers never see it.
+ *
+ *	Returns true if the line is to be run.
+ */
+static uint8_t _request_resend()
+{
+	if (cfg.comm_mode == JSON_MODE) {
+		nv_reset_nv_list();
+		nv_add_integer((const char_t *)"rs", cs.line_next);
+		json_print_response(STAT_LINE_RESEND);
+	} else {
+		fprintf_P(stderr, PSTR("rs:%lu\n"), (unsigned long)cs.line_next);
+	}
+	return (false);
+}
+
+static uint8_t _check_line(char_t *str)
+{
+	if (toupper(*str) != 'N') return (true);			// only numbered lines are checked
+
+	char_t *p = str;
+	uint8_t checksum = 0;
+	while ((*p != NUL) && (*p != '*')) {
+		checksum ^= (uint8_t)*p++;
+	}
+	if (*p != '*') return (_request_resend());			// numbered lines must carry a checksum
+	char *end;
+	if ((strtoul(p+1, &end, 10) != checksum) || (end == p+1)) return (_request_resend());
+	uint32_t linenum = strtoul(str+1, &end, 10);
+	if (end == str+1) return (_request_resend());
+	*p = NUL;											// the parsers don't see the checksum
+	cs.linelen = p - str + 1;
+
+	while (*end == ' ') end++;
+	if ((toupper(*end) == 'M') && (strtoul(end+1, NULL, 10) == 110)) {
+		cs.line_next = linenum + 1;						// M110 - set the line number
+		return (true);
+	}
+	if (linenum > cs.line_next) return (_request_resend());	// a line was missed
+	if (linenum < cs.line_next) {						// already run - the host resent it
+		if (cfg.comm_mode == JSON_MODE) {
+			nv_reset_nv_list();
+			nv_add_string((const char_t *)"gc", (const char_t *)"");
+			json_print_response(STAT_OK);
+		} else {
+			text_response(STAT_OK, str);
+		}
+		return (false);
+	}
+	cs.line_next++;
+	return (true);
+}
+
+/*
+ * _read_usb_line() - return the next line read from USB (ARM)
+ *
+ *	Reading one character per read() call spends most of the time in the USB driver, so
+ *	each call takes everything the bulk endpoint has in one transfer into usb_buf, and
+ *	the lines are scanned where they landed. The descriptor points into usb_buf like
+ *	xio_get_line() does on the xmega, so the line is not copied. It is valid until the
+ *	next call, which is not made while the line is held (see _hold_line()). The end of
+ *	a partial line is kept for the next transfer. A line longer than the input buffer
+ *	is passed on in chunks of INPUT_BUFFER_LEN-1 chars (see _dispatch_chunk()).
+ */
+#ifdef __ARM
+static stat_t _read_usb_line(xioLine_t *line)
+{
+	if (cs.usb_tail == cs.usb_head) {					// all lines used - start again at the front
+		cs.usb_tail = cs.usb_head = cs.usb_scan = 0;
+	} else if ((cs.usb_head == USB_READ_BUFFER_LEN) && (cs.usb_tail != 0)) {
+		memmove(cs.usb_buf, cs.usb_buf + cs.usb_tail, cs.usb_head - cs.usb_tail);	// make room
+		cs.usb_head -= cs.usb_tail;
+		cs.usb_scan -= cs.usb_tail;
+		cs.usb_tail = 0;
+	}
+	int16_t count = SerialUSB.read((uint8_t *)cs.usb_buf + cs.usb_head, USB_READ_BUFFER_LEN - cs.usb_head);
+	if (count > 0) cs.usb_head += count;
+
+	uint16_t scan_end = min(cs.usb_head, cs.usb_tail + INPUT_BUFFER_LEN);
+	for (; cs.usb_scan < scan_end; cs.usb_scan++) {
+		if ((cs.usb_buf[cs.usb_scan] == LF) || (cs.usb_buf[cs.usb_scan] == CR)) {
+			cs.usb_buf[cs.usb_scan] = NUL;
+			line->buf = cs.usb_buf + cs.usb_tail;
+			line->len = cs.usb_scan - cs.usb_tail + 1;
+			line->more = false;
+			cs.usb_tail = ++cs.usb_scan;
+			return (STAT_OK);
+		}
+	}
+	if ((cs.usb_scan - cs.usb_tail) >= INPUT_BUFFER_LEN) {	// too long for the parsers - pass on a chunk
+		cs.usb_chunk_end = cs.usb_tail + INPUT_BUFFER_LEN-1;
+		cs.usb_chunk_char = cs.usb_buf[cs.usb_chunk_end];
+		cs.usb_buf[cs.usb_chunk_end] = NUL;
+		line->buf = cs.usb_buf + cs.usb_tail;
+		line->len = INPUT_BUFFER_LEN;
+		line->more = true;
+		return (STAT_OK);
+	}
+	return (STAT_EAGAIN);
+}
+#endif // __ARM
+
 /*
  * _shutdown_idler() - blink rapidly and prevent further activity from occurring
  * _normal_idler() - blink Indicator LED slowly to show everything is OK
@@ -362,7 +925,7 @@ static stat_t _normal_idler()
 /*
  * tg_reset_source() 		 - reset source to default input device (see note)
  * tg_set_primary_source() 	 - set current primary input source
- * tg_set_secondary_source() - set current primary input source
+ * tg_set_secondary_source() - set current secondary (pendant) input source
  *
  * Note: Once multiple serial devices are supported reset_source() should
  * be expanded to also set the stdout/stderr console device so the prompt
@@ -377,16 +940,34 @@ void tg_set_secondary_source(uint8_t dev) { cs.secondary_src = dev;}
  * _sync_to_tx_buffer() - return eagain if TX queue is backed up
  * _sync_to_planner() - return eagain if planner is not ready for a new command
  * _sync_to_time() - return eagain if planner is not ready for a new command
+ *
+ *	Once the planner is full _sync_to_planner() waits for TOPIC_BUFFER_FREE instead of
+ *	testing the headroom and the read ahead FIFO on every pass.
  */
 static stat_t _sync_to_tx_buffer()
 {
 	if ((xio_get_tx_bufcount_usart(ds[XIO_DEV_USB].x) >= XOFF_TX_LO_WATER_MARK)) {
+		if (cs.tx_stalled == false) {
+			cs.tx_stalled = true;
+			PERF_COUNT(PERF_TX_STALL);
+		}
 		return (STAT_EAGAIN);
 	}
+	cs.tx_stalled = false;
 	return (STAT_OK);
 }
 
 static stat_t _sync_to_planner()
+{
+	if ((cs.planner_blocked == true) && (controller_take_events(SUB_SYNC_PLANNER) == 0)) {
+		return (STAT_EAGAIN);						// no buffer has freed since the last look
+	}
+	stat_t status = _planner_has_room();
+	cs.planner_blocked = (status == STAT_EAGAIN);
+	return (status);
+}
+
+static stat_t _planner_has_room()
 {
 	if (cm_get_buffer_drain_state() == DRAIN_REQUESTED) {
 		if (mp_get_planner_buffers_available() < PLANNER_BUFFER_POOL_SIZE) { // need to drain it first
@@ -400,8 +981,10 @@ static stat_t _sync_to_planner()
 		}
 	}
 	else {
-		if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM) { // allow up to N planner buffers for this line
-			return (STAT_EAGAIN);
+		if (mp_planner_has_headroom(mp_get_line_headroom()) == false) {	// room for a line move and modal changes...
+			if (gc_read_ahead_has_room() == false) { // ...or read the Gcode ahead until the planner has room
+				return (STAT_EAGAIN);
+			}
 		}
 	}
 	return (STAT_OK);
@@ -434,6 +1017,13 @@ static stat_t _limit_switch_handler(void)
 
 /*
  * _system_assertions() - check memory integrity and other assertions
+ *
+ *	The cheap checks run every pass. They guard the singletons next to the hand-sized
+ *	buffers - cs.in_buf and saved_buf, the nvList and string pool, the planner and the
+ *	stepper - which is where an overrun usually lands. The full checks add the rest
+ *	of the magic numbers and the planner queue walk. $ast sets how often they run
+ *	(see cmAssertionLevel); the sliced default finds corruption within a fraction
+ *	of a second without paying for the walk on every pass.
  */
 #define emergency___everybody_to_get_from_street(a) if((status_code=a) != STAT_OK) return (cm_hard_alarm(status_code));
 
@@ -441,10 +1031,194 @@ stat_t _system_assertions()
 {
 	emergency___everybody_to_get_from_street(config_test_assertions());
 	emergency___everybody_to_get_from_street(controller_test_assertions());
-	emergency___everybody_to_get_from_street(canonical_machine_test_assertions());
 	emergency___everybody_to_get_from_street(planner_test_assertions());
 	emergency___everybody_to_get_from_street(stepper_test_assertions());
+
+	if (cs.assertion_level == ASSERT_CHEAP) { return (STAT_OK);}
+	if (cs.assertion_level == ASSERT_SLICED) {
+		if (SysTickTimer_getValue() < cs.assertion_timer) { return (STAT_OK);}
+		cs.assertion_timer = SysTickTimer_getValue() + ASSERTION_INTERVAL_MS;
+	}
+	emergency___everybody_to_get_from_street(canonical_machine_test_assertions());
+	emergency___everybody_to_get_from_street(planner_test_queue_assertions());
 	emergency___everybody_to_get_from_street(encoder_test_assertions());
 	emergency___everybody_to_get_from_street(xio_test_assertions());
 	return (STAT_OK);
 }
+
+/***********************************************************************************
+ * TASK TIMING - dispatch accounting. Enable with __TASK_TIMING in tinyg.h
+ *
+ * _task_timing()	- record one run of a dispatch site. Idle runs (STAT_NOOP) are not counted
+ * _critical_timing() - record the interval since the critical group last completed
+ * _pass_start()	- start timing a pass through _controller_HSM()
+ * _pass_timing()	- end the pass, and trace it if it took longer than the pass budget
+ * _sleep_timing()	- count a sleep between passes and the time spent in it
+ * controller_get_tsk() - print one line per dispatch site, the critical latency, then the sleeps
+ * controller_clear_tsk() - clear all task timing counters and pass traces
+ * controller_get_tsp() - print the pass traces, oldest first, and return how many there are
+ * controller_set_tsp() - set the pass budget (ms) and clear the pass traces
+ *
+ *	Times are SysTick ms, so a task shorter than a tick will generally record 0.
+ *	The totals and overrun counts are what find the tasks that hold up a pass.
+ *
+ *	A pass that runs over the budget is kept in a ring of the last CONTROLLER_PASS_TRACES
+ *	slow passes with the slowest dispatch in it, the model line number and the start of
+ *	the input line at the end of the pass (the parsers work on the line in place, so it
+ *	may already be partly rewritten). Groups run with DISPATCH_GROUP() are not taken as
+ *	the slowest dispatch - the dispatches inside them are. Each trace prints as
+ *	{"tsp":[systick, pass ms, task ms, "task", linenum, "line"]}
+ */
+#ifdef __TASK_TIMING
+
+#define CONTROLLER_TASK_SLOTS 32			// must be at least the number of dispatch sites
+#define CONTROLLER_TASK_BUDGET_MS 2			// a run longer than this counts as an overrun
+#define CONTROLLER_PASS_BUDGET_MS 10		// default $_tsp - a pass longer than this is traced
+#define CONTROLLER_PASS_TRACES 4			// slow passes kept
+#define CONTROLLER_TRACE_LINE_LEN 24		// chars of the input line kept with a trace
+
+typedef struct ctlTaskTiming {
+	const char *name;						// dispatch expression, in program memory
+	uint32_t runs;							// runs that did work (returned other than STAT_NOOP)
+	uint32_t total_ms;						// total time in those runs
+	uint16_t max_ms;						// longest run
+	uint16_t overruns;						// runs longer than CONTROLLER_TASK_BUDGET_MS
+} ctlTaskTiming_t;
+
+typedef struct ctlPassTrace {
+	uint32_t tick;							// SysTick at the end of the pass
+	uint16_t pass_ms;						// length of the pass
+	uint16_t task_ms;						// ...and of its slowest dispatch
+	const char *task;						// dispatch expression, in program memory
+	uint32_t linenum;						// model line number
+	char_t line[CONTROLLER_TRACE_LINE_LEN+1];// start of the input line
+} ctlPassTrace_t;
+
+static struct ctlTimingSingleton {
+	ctlTaskTiming_t task[CONTROLLER_TASK_SLOTS];
+	uint32_t critical_tick;					// SysTick when the critical group last completed
+	uint16_t critical_max_ms;				// longest interval between critical group runs
+
+	uint32_t pass_tick;						// SysTick when the pass started
+	const char *pass_task;					// slowest dispatch in the pass so far
+	uint16_t pass_task_ms;					// ...and its run time
+	uint16_t pass_budget_ms;				// a pass longer than this is traced ($_tsp, 0 = default)
+	uint8_t trace_next;						// ring slot for the next trace
+	uint8_t trace_count;					// traces in the ring
+	ctlPassTrace_t trace[CONTROLLER_PASS_TRACES];
+	uint32_t sleeps;						// times the controller slept between passes
+	uint32_t sleep_ms;						// ...and the time it spent asleep
+} ct;
+
+static void _task_timing(uint8_t task, const char *name, uint32_t start, stat_t status, uint8_t leaf)
+{
+	uint16_t elapsed = (uint16_t)(SysTickTimer_getValue() - start);
+	if ((leaf == true) && ((ct.pass_task == NULL) || (elapsed > ct.pass_task_ms))) {
+		ct.pass_task = name;				// idle runs count here - the trace wants the time
+		ct.pass_task_ms = elapsed;
+	}
+	if ((status == STAT_NOOP) || (task >= CONTROLLER_TASK_SLOTS)) return;
+	ctlTaskTiming_t *t = &ct.task[task];
+	t->name = name;
+	t->runs++;
+	t->total_ms += elapsed;
+	if (elapsed > t->max_ms) t->max_ms = elapsed;
+	if (elapsed > CONTROLLER_TASK_BUDGET_MS) t->overruns++;
+}
+
+static void _critical_timing()
+{
+	uint32_t now = SysTickTimer_getValue();
+	if (ct.critical_tick != 0) {
+		uint16_t interval = (uint16_t)(now - ct.critical_tick);
+		if (interval > ct.critical_max_ms) ct.critical_max_ms = interval;
+	}
+	ct.critical_tick = now;
+}
+
+static void _pass_start()
+{
+	ct.pass_tick = SysTickTimer_getValue();
+	ct.pass_task = NULL;
+	ct.pass_task_ms = 0;
+}
+
+static void _sleep_timing(uint32_t start)
+{
+	ct.sleeps++;
+	ct.sleep_ms += SysTickTimer_getValue() - start;
+}
+
+static void _pass_timing()
+{
+	uint32_t now = SysTickTimer_getValue();
+	uint16_t elapsed = (uint16_t)(now - ct.pass_tick);
+	uint16_t budget = (ct.pass_budget_ms == 0) ? CONTROLLER_PASS_BUDGET_MS : ct.pass_budget_ms;
+	if (elapsed <= budget) return;
+
+	ctlPassTrace_t *p = &ct.trace[ct.trace_next];
+	p->tick = now;
+	p->pass_ms = elapsed;
+	p->task_ms = ct.pass_task_ms;
+	p->task = ct.pass_task;
+	p->linenum = cm_get_linenum(MODEL);
+	uint8_t i = 0;
+	for (const char_t *c = cs.bufp; (c != NULL) && (i < CONTROLLER_TRACE_LINE_LEN); c++) {
+		if ((*c == NUL) || (*c == CR) || (*c == LF)) break;
+		p->line[i++] = ((*c == '"') || (*c == '\\') || (*c < ' ')) ? '\'' : *c;	// keep the JSON printable
+	}
+	p->line[i] = NUL;
+	if (++ct.trace_next >= CONTROLLER_PASS_TRACES) ct.trace_next = 0;
+	if (ct.trace_count < CONTROLLER_PASS_TRACES) ct.trace_count++;
+}
+
+stat_t controller_get_tsk(nvObj_t *nv)
+{
+	for (uint8_t i=0; i<CONTROLLER_TASK_SLOTS; i++) {
+		ctlTaskTiming_t *t = &ct.task[i];
+		if (t->name == NULL) continue;
+		printf_P(PSTR("{\"tsk\":[%d,%lu,%lu,%u,%u,\""), i, (unsigned long)t->runs, (unsigned long)t->total_ms, t->max_ms, t->overruns);
+		printf_P(t->name);
+		printf_P(PSTR("\"]}\n"));
+	}
+	printf_P(PSTR("{\"tsc\":%u}\n"), ct.critical_max_ms);
+	printf_P(PSTR("{\"tss\":[%lu,%lu]}\n"), (unsigned long)ct.sleeps, (unsigned long)ct.sleep_ms);
+	nv->value = ct.critical_max_ms;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t controller_clear_tsk(nvObj_t *nv)
+{
+	uint16_t budget = ct.pass_budget_ms;
+	memset(&ct, 0, sizeof(ct));
+	ct.pass_budget_ms = budget;
+	nv->valuetype = TYPE_NULL;
+	return (STAT_OK);
+}
+
+stat_t controller_get_tsp(nvObj_t *nv)
+{
+	uint8_t slot = (ct.trace_next + CONTROLLER_PASS_TRACES - ct.trace_count) % CONTROLLER_PASS_TRACES;
+	for (uint8_t i=0; i<ct.trace_count; i++) {
+		ctlPassTrace_t *p = &ct.trace[slot];
+		printf_P(PSTR("{\"tsp\":[%lu,%u,%u,\""), (unsigned long)p->tick, p->pass_ms, p->task_ms);
+		if (p->task != NULL) printf_P(p->task);
+		printf_P(PSTR("\",%lu,\"%s\"]}\n"), (unsigned long)p->linenum, (char *)p->line);
+		if (++slot >= CONTROLLER_PASS_TRACES) slot = 0;
+	}
+	nv->value = ct.trace_count;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t controller_set_tsp(nvObj_t *nv)
+{
+	if ((nv->value < 0) || (nv->value > 60000)) return (STAT_INPUT_VALUE_RANGE_ERROR);
+	ct.pass_budget_ms = (uint16_t)nv->value;
+	ct.trace_next = 0;
+	ct.trace_count = 0;
+	return (STAT_OK);
+}
+
+#endif // __TASK_TIMING
@@ -35,10 +35,28 @@ extern "C"{
 #define INPUT_BUFFER_LEN 255			// text buffer size (255 max)
 #define SAVED_BUFFER_LEN 100			// saved buffer size (for reporting only)
 #define OUTPUT_BUFFER_LEN 512			// text buffer size
+#define USB_READ_BUFFER_LEN 2048		// ARM USB bulk reads land here (see _read_usb_line())
+#define PENDANT_BUFFER_LEN 80			// secondary (pendant) channel line buffer size
 // see also: tinyg.h MESSAGE_LEN and config.h NV_ lengths
 
 #define LED_NORMAL_TIMER 1000			// blink rate for normal operation (in ms)
 #define LED_ALARM_TIMER 100				// blink rate for alarm state (in ms)
+#define ASSERTION_INTERVAL_MS 250		// time between full assertion checks for ASSERT_SLICED (in ms)
+
+enum cmTopic {							// controller_publish() topics
+	TOPIC_MOVE_START = 0x01,			// the runtime started a planner buffer
+	TOPIC_MOVE_END = 0x02,				// the runtime finished a planner buffer
+	TOPIC_STATE = 0x04,					// the motion state changed, or a feedhold, flush or cycle start was requested
+	TOPIC_BUFFER_FREE = 0x08,			// planner buffers went back to the pool
+	TOPIC_TICK = 0x10					// the RTC ticked - the backstop for waits no other topic covers
+};
+
+enum cmSubscriber {						// cs.pending[] index - see controller_take_events()
+	SUB_STATUS_REPORT = 0,				// sr_status_report_callback()
+	SUB_FEEDHOLD,						// cm_feedhold_sequencing_callback()
+	SUB_SYNC_PLANNER,					// _sync_to_planner()
+	SUB_COUNT
+};
 
 typedef struct controllerSingleton {	// main TG controller struct
 	magic_t magic_start;				// magic number to test memory integrity
@@ -53,10 +71,35 @@ typedef struct controllerSingleton {	// main TG controller struct
 	uint8_t primary_src;				// primary input source device
 	uint8_t secondary_src;				// secondary input source device
 	uint8_t default_src;				// default source device
-	uint8_t network_mode;				// 0=master, 1=repeater, 2=slave
+	uint8_t network_mode;				// 0=standalone, 1=master, 2=slave (see network.h)
+	uint8_t pendant_enable;				// read the secondary source as a pendant channel ($pnd)
+	uint8_t pendant_mirror;				// XIO_OUT_ line classes mirrored to the pendant ($pnm)
+	uint8_t assertion_level;			// how often the full assertions run (see cmAssertionLevel)
+	uint8_t idle_sleep;					// sleep the CPU between passes when there is nothing to do ($slp)
+	volatile uint8_t events;			// events posted since the start of the pass (see cmControllerEvent)
+	volatile uint8_t pending[SUB_COUNT];// topics published since each subscriber last looked (see cmSubscriber)
+	uint8_t planner_blocked;			// TRUE while _sync_to_planner() waits for a buffer to free
+#ifdef __ARM
+	uint32_t tick;						// SysTick when TOPIC_TICK was last published
+#endif
+	uint32_t assertion_timer;			// time of the next sliced full check
 
 	uint16_t linelen;					// length of currently processing line
-	uint16_t read_index;				// length of line being read
+#ifdef __ARM
+	uint16_t usb_head;					// end of the data read into usb_buf
+	uint16_t usb_tail;					// start of the next line in usb_buf
+	uint16_t usb_scan;					// where the search for the line end resumes
+	uint16_t usb_chunk_end;				// end of the chunk of a long line passed on
+	char_t usb_chunk_char;				// char the chunk's NUL was written over
+	char_t usb_buf[USB_READ_BUFFER_LEN];// USB bulk read buffer - lines are parsed where they land
+#endif
+	uint8_t line_held;					// TRUE if the line in the input buffer waits for Gcode read ahead
+	uint8_t line_chunked;				// a line too long for the input buffer is being run (see cmLineChunk)
+	uint8_t pendant_held;				// TRUE if the line in the pendant buffer waits for planner headroom
+	uint8_t pendant_dropping;			// TRUE while a pendant line too long for its buffer is dropped
+	uint8_t pendant_json;				// TRUE while a pendant JSON line runs (see gc_run_gc())
+	uint32_t line_next;					// N line number expected next with line checking ($lc)
+	uint8_t tx_stalled;					// TRUE while the TX buffer holds up the controller (see _sync_to_tx_buffer())
 
 	// system state variables
 	uint8_t led_state;		// LEGACY	// 0=off, 1=on
@@ -65,6 +108,7 @@ typedef struct controllerSingleton {	// main TG controller struct
 	uint8_t hard_reset_requested;		// flag to perform a hard reset
 	uint8_t bootloader_requested;		// flag to enter the bootloader
 	uint8_t shared_buf_overrun;			// flag for shared string buffer overrun condition
+	uint8_t init_deferred;				// TRUE until the deferred boot stage has run (see _deferred_init())
 
 //	uint8_t sync_to_time_state;
 //	uint32_t sync_to_time_time;
@@ -76,6 +120,7 @@ typedef struct controllerSingleton {	// main TG controller struct
 	char_t in_buf[INPUT_BUFFER_LEN];	// primary input buffer
 	char_t out_buf[OUTPUT_BUFFER_LEN];	// output buffer
 	char_t saved_buf[SAVED_BUFFER_LEN];	// save the input buffer
+	char_t pendant_buf[PENDANT_BUFFER_LEN];// secondary input buffer
 	magic_t magic_end;
 } controller_t;
 
@@ -89,18 +134,55 @@ enum cmControllerState {				// manages startup lines
 	CONTROLLER_READY					// controller is active and ready for use
 };
 
+enum cmLineChunk {						// cs.line_chunked values - see _dispatch_chunk()
+	LINE_CHUNK_OFF = 0,					// lines fit the input buffer
+	LINE_CHUNK_JSON,					// a long JSON line is passed to json_parse_chunk() as it arrives
+	LINE_CHUNK_DROP						// a long line of any other kind is dropped
+};
+
+enum cmControllerEvent {				// cs.events bits - see controller_post_event()
+	EVENT_RX = 0x01,					// a char was received
+	EVENT_TICK = 0x02,					// the RTC ticked (timers, debounce and timed reports)
+	EVENT_SWITCH = 0x04,				// a switch input changed
+	EVENT_MOTION = 0x08,				// a segment ended or the runtime went idle
+	EVENT_PASS = 0x10					// a task did work and wants another pass
+};
+
+/*
+ * controller_post_event() - tell the controller there is something to do
+ *
+ *	Safe from any interrupt level. Bits may be lost if a higher level ISR posts in the
+ *	middle of the OR, but the controller only tests for none, so nothing is missed.
+ */
+#define controller_post_event(e) (cs.events |= (e))
+
+enum cmAssertionLevel {				// cs.assertion_level values
+	ASSERT_CHEAP = 0,					// only the cheap checks, every pass
+	ASSERT_SLICED,						// full checks every ASSERTION_INTERVAL_MS as well
+	ASSERT_FULL							// full checks every pass (for debugging)
+};
+
 /**** function prototypes ****/
 
 void controller_init(uint8_t std_in, uint8_t std_out, uint8_t std_err);
 void controller_init_assertions(void);
 stat_t controller_test_assertions(void);
 void controller_run(void);
+void controller_publish(const uint8_t topics);
+uint8_t controller_take_events(const uint8_t subscriber);
 //void controller_reset(void);
 
 void tg_reset_source(void);
 void tg_set_primary_source(uint8_t dev);
 void tg_set_secondary_source(uint8_t dev);
 
+#ifdef __TASK_TIMING
+stat_t controller_get_tsk(nvObj_t *nv);
+stat_t controller_clear_tsk(nvObj_t *nv);
+stat_t controller_get_tsp(nvObj_t *nv);
+stat_t controller_set_tsp(nvObj_t *nv);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,7 +32,9 @@
 #include "text_parser.h"
 #include "canonical_machine.h"
 #include "planner.h"
+#include "stepper.h"
 #include "switch.h"
+#include "encoder.h"
 #include "report.h"
 
 #ifdef __cplusplus
@@ -43,34 +45,38 @@ extern "C"{
 
 struct hmHomingSingleton {			// persistent homing runtime variables
 	// controls for homing cycle
-	int8_t axis;					// axis currently being homed
-	uint8_t min_mode;				// mode for min switch for this axis
-	uint8_t max_mode;				// mode for max switch for this axis
+	int8_t axis;					// lead axis of the group being homed (first in homing order)
+	uint8_t axes;					// bitmap of axes being homed together
+	uint8_t pending;				// bitmap of axes still moving in a search or latch
+	uint8_t done;					// bitmap of axes taken up by the cycle so far
+	uint8_t held;					// bitmap of motors held still while squaring a gantry
+	uint8_t quick;					// bitmap of axes searching only the window around their known switch
 
 #ifndef __NEW_SWITCHES
-	int8_t homing_switch;			// homing switch for current axis (index into switch flag table)
-	int8_t limit_switch;			// limit switch for current axis, or -1 if none
+	int8_t homing_switch[HOMING_AXES];	// homing switch per axis (index into switch flag table)
+	int8_t limit_switch[HOMING_AXES];	// limit switch per axis, or -1 if none
 #else
-	int8_t homing_switch_axis;		// axis of current homing switch, or -1 if none
-	uint8_t homing_switch_position;	// min/max position of current homing switch
-	int8_t limit_switch_axis;		// axis of current limit switch, or -1 if none
-	uint8_t limit_switch_position;	// min/max position of current limit switch
+	uint8_t homing_switch[HOMING_AXES];	// min/max position of homing switch per axis
+	int8_t limit_switch[HOMING_AXES];	// min/max position of limit switch per axis, or -1 if none
+	void (*switch_saved_on_trailing[HOMING_AXES])(struct swSwitch *s);
 #endif
-	void (*switch_saved_on_trailing)(struct swSwitch *s);
+	int8_t square_switch[HOMING_AXES];	// switch the squaring motors of the axis home on, or -1 if none
+									// (__NEW_SWITCHES: the axis of the switch, on the homing switch side)
+	uint8_t master_motors[HOMING_AXES];	// bitmap of motors of the axis homed on the homing switch
+	uint8_t square_motors[HOMING_AXES];	// bitmap of motors of the axis homed on the square switch
 
-	uint8_t homing_closed;			// 0=open, 1=closed
-	uint8_t limit_closed;			// 0=open, 1=closed
 	uint8_t set_coordinates;		// G28.4 flag. true = set coords to zero at the end of homing cycle
 	stat_t (*func)(int8_t axis);	// binding for callback function state machine
 
 	// per-axis parameters
-	float direction;				// set to 1 for positive (max), -1 for negative (to min);
-	float search_travel;			// signed distance to travel in search
-	float search_velocity;			// search speed as positive number
-	float latch_velocity;			// latch speed as positive number
-	float latch_backoff;			// max distance to back off switch during latch phase
-	float zero_backoff;				// distance to back off switch before setting zero
-	float max_clear_backoff;		// maximum distance of switch clearing backoffs before erring out
+	float search_travel[HOMING_AXES];	// signed distance to travel in search
+	float search_velocity[HOMING_AXES];	// search speed as positive number
+	float latch_velocity[HOMING_AXES];	// latch speed as positive number
+	float latch_backoff[HOMING_AXES];	// signed distance to back off switch during latch phase
+	float zero_backoff[HOMING_AXES];	// signed distance to back off switch before setting zero
+	float latch_overrun[HOMING_AXES];	// signed distance travelled past the latch point
+	float quick_travel[HOMING_AXES];	// signed distance to travel in a quick search (across the window)
+	float saved_jerk[HOMING_AXES];		// saved and restored for each axis homed
 
 	// state saved from gcode model
 	uint8_t saved_units_mode;		// G20,G21 global setting
@@ -78,20 +84,33 @@ struct hmHomingSingleton {			// persistent homing runtime variables
 	uint8_t saved_distance_mode;	// G90,G91 global setting
 	uint8_t saved_feed_rate_mode;   // G93,G94 global setting
 	float saved_feed_rate;			// F setting
-	float saved_jerk;				// saved and restored for each axis homed
 };
 static struct hmHomingSingleton hm;
 
+#define HOMING_AXIS_BIT(axis) (1 << (axis))
+
 /**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
 
 static stat_t _set_homing_func(stat_t (*func)(int8_t axis));
 static stat_t _homing_axis_start(int8_t axis);
+static stat_t _homing_axis_setup(int8_t axis);
+static stat_t _homing_square_setup(int8_t axis);
 static stat_t _homing_axis_clear(int8_t axis);
+static stat_t _homing_axis_approach(int8_t axis);
+static stat_t _homing_axis_approach_stop(int8_t axis);
 static stat_t _homing_axis_search(int8_t axis);
+static stat_t _homing_axis_search_stop(int8_t axis);
 static stat_t _homing_axis_latch(int8_t axis);
+static stat_t _homing_axis_latch_stop(int8_t axis);
 static stat_t _homing_axis_zero_backoff(int8_t axis);
 static stat_t _homing_axis_set_zero(int8_t axis);
-static stat_t _homing_axis_move(int8_t axis, float target, float velocity);
+static stat_t _homing_axis_move(uint8_t axes, const float target[], const float velocity[]);
+static uint8_t _homing_switch_closed(int8_t axis);
+static uint8_t _limit_switch_closed(int8_t axis);
+static uint8_t _square_switch_closed(int8_t axis);
+static uint8_t _any_switch_closed(uint8_t axes);
+static uint8_t _homing_sides_done(int8_t axis, uint8_t master_done, uint8_t square_done);
+static void _homing_restore_axes(void);
 static stat_t _homing_abort(int8_t axis);
 static stat_t _homing_error_exit(int8_t axis, stat_t status);
 static stat_t _homing_finalize_exit(int8_t axis);
@@ -115,10 +134,21 @@ static int8_t _get_next_axis(int8_t axis);
  *	Homing is always run in the following order - for each enabled axis:
  *	  Z,X,Y,A			Note: B and C cannot be homed
  *
+ *	Axes that share a non-zero homing group ($xhg, $yhg...) are homed together,
+ *	in the place of the first of them in the order above. Each axis of a group
+ *	stops on its own switch while the others carry on. Putting both sides of a
+ *	gantry driven as separate axes in one group squares the gantry on its switches.
+ *
+ *	A gantry can also be driven by two motors mapped to the same axis. Giving one of
+ *	them the switches of another axis ($4sq) squares it on those: the search and latch
+ *	hold each side of the axis still as its own switch is reached and run the axis on
+ *	with the other side (see _homing_sides_done()). The latch overrun is measured on the
+ *	lowest numbered motor of the axis, so that should be one homed on the axis switch.
+ *
  *	At the start of a homing cycle those switches configured for homing
  *	(or for homing and limits) are treated as homing switches (they are modal).
  *
- *	After initialization the following sequence is run for each axis to be homed:
+ *	After initialization the following sequence is run for each axis (or group) to be homed:
  *
  *	  0. If a homing or limit switch is closed on invocation, clear off the switch
  *	  1. Drive towards the homing switch at search velocity until switch is hit
@@ -134,8 +164,27 @@ static int8_t _get_next_axis(int8_t axis);
  *	thing that can happen is the move will run to its full length if no switch
  *	change is detected (hit or open),
  *
+ *	A switch change stops every axis in the move, so the search and latch of a
+ *	group are run as a series of moves. After each stop the axes whose switch
+ *	has changed drop out and the move is restarted for the rest.
+ *
  *	Once all moves for an axis are complete the next axis in the sequence is homed
  *
+ *	--- Quick re-homing ---
+ *
+ *	Each G28.2 records where it found the homing switch in machine coordinates. If an
+ *	axis is still homed (e.g. after a soft alarm or a G28.2 of another axis) and has a
+ *	homing window ($xhw), steps 0 and 1 are replaced by a rapid move to the window's
+ *	distance short of the known switch and a search that runs twice the window past
+ *	that point. The latch and zero backoff run as in a full homing, so both arrive at
+ *	the same zero. Should the rapid move close a switch, or the search not find it in
+ *	the window, the axis falls back to the full sequence from where it stopped. A group
+ *	takes the quick search only if all its axes can. Power up, a G28.3 or a G28.4 of the
+ *	axis forgets its switch position.
+ *
+ *	The window should cover the worst position error the machine can come out of an
+ *	alarm with - a few mm is typical for steppers that were not de-energized.
+ *
  *	When a homing cycle is initiated the homing state is set to HOMING_NOT_HOMED
  *	When homing completes successfully this is set to HOMING_HOMED, otherwise it
  *	remains HOMING_NOT_HOMED.
@@ -170,6 +219,8 @@ stat_t cm_homing_cycle_start(void)
 	hm.set_coordinates = true;
 
 	hm.axis = -1;							// set to retrieve initial axis
+	hm.axes = 0;
+	hm.done = 0;
 	hm.func = _homing_axis_start; 			// bind initial processing function
 	cm.cycle_state = CYCLE_HOMING;
 	cm.homing_state = HOMING_NOT_HOMED;
@@ -184,17 +235,23 @@ stat_t cm_homing_cycle_start_no_set(void)
 	return (STAT_OK);
 }
 
-/* Homing axis moves - these execute in sequence for each axis
+/* Homing axis moves - these execute in sequence for each axis or group of axes
  * cm_homing_callback() 		- main loop callback for running the homing cycle
  *	_set_homing_func()			- a convenience for setting the next dispatch vector and exiting
  *	_trigger_feedhold()			- callback from switch closure to trigger a feedhold (convenience for casting)
  *  _bind_switch_settings()		- setup switch for homing operation
  *	_restore_switch_settings()	- return switch to normal operation
- *	_homing_axis_start()		- get next axis, initialize variables, call the clear
+ *	_homing_axis_start()		- get next axis and its group, initialize variables, call the clear
+ *	_homing_axis_setup()		- initialize variables for one axis and add it to the group
  *	_homing_axis_clear()		- initiate a clear to move off a switch that is thrown at the start
+ *	_homing_axis_approach()		- quick re-homing: rapid to the window short of the known switch
+ *	_homing_axis_approach_stop()- fall back to the clear if a switch closed on the way
  *	_homing_axis_search()		- fast search for switch, closes switch
+ *	_homing_axis_search_stop()	- drop out the axes that found their switch, search on with the rest
  *	_homing_axis_latch()		- slow reverse until switch opens again
- *	_homing_axis_final()		- backoff from latch location to zero position
+ *	_homing_axis_latch_stop()	- drop out the axes whose switch opened, latch on with the rest
+ *	_homing_axis_zero_backoff()	- backoff from latch location to zero position
+ *	_homing_axis_set_zero()		- set zero and go to the next axis
  *	_homing_axis_move()			- helper that actually executes the above moves
  */
 
@@ -202,6 +259,9 @@ stat_t cm_homing_callback(void)
 {
 	if (cm.cycle_state != CYCLE_HOMING) { return (STAT_NOOP);} 	// exit if not in a homing cycle
 	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN);}	// sync to planner move ends
+	if ((cm.cycle_start_requested == true) || (cm.motion_state == MOTION_RUN)) {
+		return (STAT_EAGAIN);										// ...and to a move not yet picked up by the runtime
+	}
 	return (hm.func(hm.axis));									// execute the current homing move
 }
 
@@ -218,21 +278,25 @@ static void _trigger_feedhold(switch_t *s)
 	cm_request_feedhold();
 }
 
-static void _bind_switch_settings(switch_t *s)
+static void _bind_switch_settings(int8_t axis, switch_t *s)
 {
-	hm.switch_saved_on_trailing = s->on_trailing;
+	hm.switch_saved_on_trailing[axis] = s->on_trailing;
 	s->on_trailing = _trigger_feedhold;							// bind feedhold to trailing edge
 }
 
-static void _restore_switch_settings(switch_t *s)
+static void _restore_switch_settings(int8_t axis, switch_t *s)
 {
-	s->on_trailing = hm.switch_saved_on_trailing;
+	s->on_trailing = hm.switch_saved_on_trailing[axis];
 }
 */
 static stat_t _homing_axis_start(int8_t axis)
 {
-	// get the first or next axis
-	if ((axis = _get_next_axis(axis)) < 0) { 				// axes are done or error
+	// get the first or next axis that was not homed with an earlier group
+	do {
+		axis = _get_next_axis(axis);
+	} while ((axis >= 0) && ((hm.done & HOMING_AXIS_BIT(axis)) != 0));
+
+	if (axis < 0) { 										// axes are done or error
 		if (axis == -1) {									// -1 is done
 			cm.homing_state = HOMING_HOMED;
 			return (_set_homing_func(_homing_finalize_exit));
@@ -240,8 +304,39 @@ static stat_t _homing_axis_start(int8_t axis)
 			return (_homing_error_exit(-2, STAT_HOMING_ERROR_BAD_OR_NO_AXIS));
 		}
 	}
+	hm.axis = axis;											// persist the lead axis
+	hm.axes = 0;
+	hm.quick = 0;
+
+	// take up the axis and the other requested axes of its homing group
+	uint8_t group = cm.a[axis].homing_group;
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if (i != axis) {
+			if ((group == 0) || (cm.a[i].homing_group != group)) continue;
+			if (!fp_TRUE(cm.gf.target[i]) || ((hm.done & HOMING_AXIS_BIT(i)) != 0)) continue;
+		}
+		hm.done |= HOMING_AXIS_BIT(i);
+		ritorno(_homing_axis_setup(i));
+	}
+	// if homing is disabled for every axis of the group then skip to the next axis
+	if (hm.axes == 0) {
+		return (_set_homing_func(_homing_axis_start));
+	}
+	if (hm.quick == hm.axes) {
+		return (_set_homing_func(_homing_axis_approach));	// start the quick re-homing
+	}
+	hm.quick = 0;
+	return (_set_homing_func(_homing_axis_clear));			// start the clear
+}
+
+static stat_t _homing_axis_setup(int8_t axis)
+{
+	// the switch position is only trusted while the axis is still homed
+	uint8_t known = (cm.homed[axis] != false) && ((cm.home_switch_known & HOMING_AXIS_BIT(axis)) != 0);
+
 	// clear the homed flag for axis so we'll be able to move w/o triggering soft limits
 	cm.homed[axis] = false;
+	cm_update_soft_limits();
 
 	// trap axis mis-configurations
 	if (fp_ZERO(cm.a[axis].search_velocity)) return (_homing_error_exit(axis, STAT_HOMING_ERROR_ZERO_SEARCH_VELOCITY));
@@ -254,172 +349,403 @@ static stat_t _homing_axis_start(int8_t axis)
 
 	// determine the switch setup and that config is OK
 #ifndef __NEW_SWITCHES
-	hm.min_mode = get_switch_mode(MIN_SWITCH(axis));
-	hm.max_mode = get_switch_mode(MAX_SWITCH(axis));
+	uint8_t min_mode = get_switch_mode(MIN_SWITCH(axis));
+	uint8_t max_mode = get_switch_mode(MAX_SWITCH(axis));
 #else
-	hm.min_mode = get_switch_mode(axis, SW_MIN);
-	hm.max_mode = get_switch_mode(axis, SW_MAX);
+	uint8_t min_mode = get_switch_mode(axis, SW_MIN);
+	uint8_t max_mode = get_switch_mode(axis, SW_MAX);
 #endif
 
-	if ( ((hm.min_mode & SW_HOMING_BIT) ^ (hm.max_mode & SW_HOMING_BIT)) == 0) {	  // one or the other must be homing
+	if ( ((min_mode & SW_HOMING_BIT) ^ (max_mode & SW_HOMING_BIT)) == 0) {	  // one or the other must be homing
 		return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION)); // axis cannot be homed
 	}
-	hm.axis = axis;											// persist the axis
-	hm.search_velocity = fabs(cm.a[axis].search_velocity);	// search velocity is always positive
-	hm.latch_velocity = fabs(cm.a[axis].latch_velocity);	// latch velocity is always positive
+	hm.search_velocity[axis] = fabs(cm.a[axis].search_velocity);	// search velocity is always positive
+	hm.latch_velocity[axis] = fabs(cm.a[axis].latch_velocity);	// latch velocity is always positive
 
 	// setup parameters homing to the minimum switch
-	if (hm.min_mode & SW_HOMING_BIT) {
+	if (min_mode & SW_HOMING_BIT) {
 #ifndef __NEW_SWITCHES
-		hm.homing_switch = MIN_SWITCH(axis);				// the min is the homing switch
-		hm.limit_switch = MAX_SWITCH(axis);					// the max would be the limit switch
+		hm.homing_switch[axis] = MIN_SWITCH(axis);			// the min is the homing switch
+		hm.limit_switch[axis] = MAX_SWITCH(axis);			// the max would be the limit switch
 #else
-		hm.homing_switch_axis = axis;
-		hm.homing_switch_position = SW_MIN;					// the min is the homing switch
-		hm.limit_switch_axis = axis;
-		hm.limit_switch_position = SW_MAX;					// the max would be the limit switch
+		hm.homing_switch[axis] = SW_MIN;					// the min is the homing switch
+		hm.limit_switch[axis] = SW_MAX;						// the max would be the limit switch
 #endif
-		hm.search_travel = -travel_distance;				// search travels in negative direction
-		hm.latch_backoff = cm.a[axis].latch_backoff;		// latch travels in positive direction
-		hm.zero_backoff = cm.a[axis].zero_backoff;
+		hm.search_travel[axis] = -travel_distance;			// search travels in negative direction
+		hm.latch_backoff[axis] = cm.a[axis].latch_backoff;	// latch travels in positive direction
+		hm.zero_backoff[axis] = cm.a[axis].zero_backoff;
 
 	// setup parameters for positive travel (homing to the maximum switch)
 	} else {
 #ifndef __NEW_SWITCHES
-		hm.homing_switch = MAX_SWITCH(axis);				// the max is the homing switch
-		hm.limit_switch = MIN_SWITCH(axis);					// the min would be the limit switch
+		hm.homing_switch[axis] = MAX_SWITCH(axis);			// the max is the homing switch
+		hm.limit_switch[axis] = MIN_SWITCH(axis);			// the min would be the limit switch
 #else
-		hm.homing_switch_axis = axis;
-		hm.homing_switch_position = SW_MAX;					// the max is the homing switch
-		hm.limit_switch_axis = axis;
-		hm.limit_switch_position = SW_MIN;					// the min would be the limit switch
+		hm.homing_switch[axis] = SW_MAX;					// the max is the homing switch
+		hm.limit_switch[axis] = SW_MIN;						// the min would be the limit switch
 #endif
-		hm.search_travel = travel_distance;					// search travels in positive direction
-		hm.latch_backoff = -cm.a[axis].latch_backoff;		// latch travels in negative direction
-		hm.zero_backoff = -cm.a[axis].zero_backoff;
+		hm.search_travel[axis] = travel_distance;			// search travels in positive direction
+		hm.latch_backoff[axis] = -cm.a[axis].latch_backoff;	// latch travels in negative direction
+		hm.zero_backoff[axis] = -cm.a[axis].zero_backoff;
 	}
 
-	// if homing is disabled for the axis then skip to the next axis
+	// if homing is disabled for the axis then leave it out of the group
 #ifndef __NEW_SWITCHES
-	uint8_t sw_mode = get_switch_mode(hm.homing_switch);
+	uint8_t sw_mode = get_switch_mode(hm.homing_switch[axis]);
 	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		return (STAT_OK);
 	}
 	// disable the limit switch parameter if there is no limit switch
-	if (get_switch_mode(hm.limit_switch) == SW_MODE_DISABLED) hm.limit_switch = -1;
+	if (get_switch_mode(hm.limit_switch[axis]) == SW_MODE_DISABLED) hm.limit_switch[axis] = -1;
 #else
-//	switch_t *s = &sw.s[hm.homing_switch_axis][hm.homing_switch_position];
-//	_bind_switch_settings(s);
-	_bind_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
-
-	uint8_t sw_mode = get_switch_mode(hm.homing_switch_axis, hm.homing_switch_position);
+	uint8_t sw_mode = get_switch_mode(axis, hm.homing_switch[axis]);
 	if ((sw_mode != SW_MODE_HOMING) && (sw_mode != SW_MODE_HOMING_LIMIT)) {
-		return (_set_homing_func(_homing_axis_start));
+		return (STAT_OK);
 	}
+	_bind_switch_settings(axis, &sw.s[axis][hm.homing_switch[axis]]);
+
 	// disable the limit switch parameter if there is no limit switch
-	if (get_switch_mode(hm.limit_switch_axis, hm.limit_switch_position) == SW_MODE_DISABLED) {
-		hm.limit_switch_axis = -1;
+	if (get_switch_mode(axis, hm.limit_switch[axis]) == SW_MODE_DISABLED) {
+		hm.limit_switch[axis] = -1;
 	}
 #endif
 
-//	hm.saved_jerk = cm.a[axis].jerk_max;					// save the max jerk value
-	hm.saved_jerk = cm_get_axis_jerk(axis);					// save the max jerk value
-	return (_set_homing_func(_homing_axis_clear));			// start the clear
+	ritorno(_homing_square_setup(axis));
+	hm.saved_jerk[axis] = cm_get_axis_jerk(axis);			// save the max jerk value
+	hm.axes |= HOMING_AXIS_BIT(axis);
+
+	// a quick search crosses the window around the known switch in the search direction
+	if (known && (cm.a[axis].homing_window > 0)) {
+		hm.quick_travel[axis] = copysign(2 * cm.a[axis].homing_window, hm.search_travel[axis]);
+		hm.quick |= HOMING_AXIS_BIT(axis);
+	}
+	return (STAT_OK);
+}
+
+// Sort the motors of the axis into those homed on its switch and those squared on another
+static stat_t _homing_square_setup(int8_t axis)
+{
+	hm.square_switch[axis] = -1;
+	hm.master_motors[axis] = 0;
+	hm.square_motors[axis] = 0;
+
+	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
+		if (st_cfg.mot[motor].motor_map != axis) continue;
+		int8_t pair = (int8_t)st_cfg.mot[motor].square_switches - 1;
+		if ((pair < 0) || (pair == axis)) {
+			hm.master_motors[axis] |= (1 << motor);
+			continue;
+		}
+#ifndef __NEW_SWITCHES
+		int8_t sw_num = (hm.homing_switch[axis] == MIN_SWITCH(axis)) ? MIN_SWITCH(pair) : MAX_SWITCH(pair);
+		uint8_t sw_mode = get_switch_mode(sw_num);
+#else
+		int8_t sw_num = pair;
+		uint8_t sw_mode = get_switch_mode(pair, hm.homing_switch[axis]);
+#endif
+		if (((sw_mode & SW_HOMING_BIT) == 0) ||
+			((hm.square_switch[axis] >= 0) && (hm.square_switch[axis] != sw_num))) {
+			return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION));
+		}
+		hm.square_switch[axis] = sw_num;
+		hm.square_motors[axis] |= (1 << motor);
+	}
+	if ((hm.square_switch[axis] >= 0) && (hm.master_motors[axis] == 0)) {
+		return (_homing_error_exit(axis, STAT_HOMING_ERROR_SWITCH_MISCONFIGURATION));
+	}
+	return (STAT_OK);
 }
 
 // Handle an initial switch closure by backing off the closed switch
 // NOTE: Relies on independent switches per axis (not shared)
 static stat_t _homing_axis_clear(int8_t axis)				// first clear move
 {
-#ifndef __NEW_SWITCHES
-	if (sw.state[hm.homing_switch] == SW_CLOSED) {
-		_homing_axis_move(axis, hm.latch_backoff, hm.search_velocity);
-	} else if (sw.state[hm.limit_switch] == SW_CLOSED) {
-		_homing_axis_move(axis, -hm.latch_backoff, hm.search_velocity);
+	float target[HOMING_AXES];
+	uint8_t axes = 0;
+
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((hm.axes & HOMING_AXIS_BIT(i)) == 0) continue;
+		if (_homing_switch_closed(i) || _square_switch_closed(i)) {
+			target[i] = hm.latch_backoff[i];
+		} else if (_limit_switch_closed(i)) {
+			target[i] = -hm.latch_backoff[i];
+		} else {
+			continue;
+		}
+		axes |= HOMING_AXIS_BIT(i);
 	}
-#else
-	if (read_switch(hm.homing_switch_axis, hm.homing_switch_position) == SW_CLOSED) {
-		_homing_axis_move(axis, hm.latch_backoff, hm.search_velocity);
-	} else if (read_switch(hm.limit_switch_axis, hm.limit_switch_position) == SW_CLOSED) {
-		_homing_axis_move(axis, -hm.latch_backoff, hm.search_velocity);
-	} else { // no move needed, so target position is same as current position
-		hm.target_position = cm_get_absolute_position(MODEL, axis);
+	if (axes != 0) {
+		_homing_axis_move(axes, target, hm.search_velocity);
+	}
+	return (_set_homing_func(_homing_axis_search));
+}
+
+static stat_t _homing_axis_approach(int8_t axis)			// rapid to the start of the window
+{
+	float target[HOMING_AXES];
+
+	if (_any_switch_closed(hm.axes)) {						// needs a clear - take the full sequence
+		hm.quick = 0;
+		return (_set_homing_func(_homing_axis_clear));
+	}
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		target[i] = cm.home_switch[i] - hm.quick_travel[i] / 2 - cm_get_absolute_position(RUNTIME, i);
+	}
+	_homing_axis_move(hm.axes, target, NULL);
+	return (_set_homing_func(_homing_axis_approach_stop));
+}
+
+static stat_t _homing_axis_approach_stop(int8_t axis)		// switches closed early fall back to the full sequence
+{
+	if (_any_switch_closed(hm.axes)) {
+		hm.quick = 0;
+		return (_set_homing_func(_homing_axis_clear));
 	}
-#endif
 	return (_set_homing_func(_homing_axis_search));
 }
 
 static stat_t _homing_axis_search(int8_t axis)				// start the search
 {
-	cm_set_axis_jerk(axis, cm.a[axis].jerk_homing);			// use the homing jerk for search onward
-	_homing_axis_move(axis, hm.search_travel, hm.search_velocity);
-    return (_set_homing_func(_homing_axis_latch));
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((hm.axes & HOMING_AXIS_BIT(i)) != 0) {
+			cm_set_axis_jerk(i, cm.a[i].jerk_homing);		// use the homing jerk for search onward
+		}
+	}
+	hm.pending = hm.axes;
+	hm.held = 0;
+	_homing_axis_move(hm.pending, (hm.quick != 0) ? hm.quick_travel : hm.search_travel, hm.search_velocity);
+	return (_set_homing_func(_homing_axis_search_stop));
 }
 
-static stat_t _homing_axis_latch(int8_t axis)				// latch to switch open
+static stat_t _homing_axis_search_stop(int8_t axis)			// axes that hit their switch stay put
 {
+	uint8_t found = 0;
+	uint8_t held = hm.held;
+
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if (((hm.pending & HOMING_AXIS_BIT(i)) != 0) &&
+			_homing_sides_done(i, _homing_switch_closed(i), _square_switch_closed(i))) {
+			found |= HOMING_AXIS_BIT(i);
+		}
+	}
 	// verify assumption that we arrived here because of homing switch closure
 	// rather than user-initiated feedhold or other disruption
-#ifndef __NEW_SWITCHES
-	if (sw.state[hm.homing_switch] != SW_CLOSED)
-		return (_set_homing_func(_homing_abort));
-#else
-	if (read_switch(hm.homing_switch_axis, hm.homing_switch_position) != SW_CLOSED)
+	if ((found == 0) && (hm.held == held)) {
+		if (hm.quick != 0) {								// not in the window - take the full sequence
+			hm.quick = 0;
+			return (_set_homing_func(_homing_axis_clear));
+		}
 		return (_set_homing_func(_homing_abort));
-#endif
-	_homing_axis_move(axis, hm.latch_backoff, hm.latch_velocity);
+	}
+	hm.pending &= ~found;
+	if (hm.pending != 0) {
+		_homing_axis_move(hm.pending, (hm.quick != 0) ? hm.quick_travel : hm.search_travel, hm.search_velocity);
+		return (_set_homing_func(_homing_axis_search_stop));
+	}
+	return (_set_homing_func(_homing_axis_latch));
+}
+
+static stat_t _homing_axis_latch(int8_t axis)				// latch to switch open
+{
+	hm.pending = hm.axes;
+	hm.held = 0;
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		hm.latch_overrun[i] = 0;							// stays zero if no switch edge is latched
+	}
+	en_clear_latch(hm.pending);								// the switch edge latches the step position
+	_homing_axis_move(hm.pending, hm.latch_backoff, hm.latch_velocity);
+	return (_set_homing_func(_homing_axis_latch_stop));
+}
+
+static stat_t _homing_axis_latch_stop(int8_t axis)			// axes that opened their switch stay put
+{
+	uint8_t latched = 0;
+	uint8_t opened = 0;										// axes whose own homing switch opened on this stop
+	uint8_t held = hm.held;
+
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((hm.pending & HOMING_AXIS_BIT(i)) == 0) continue;
+		if (_homing_sides_done(i, !_homing_switch_closed(i), !_square_switch_closed(i))) {
+			latched |= HOMING_AXIS_BIT(i);
+		}
+		if ((hm.square_switch[i] < 0) ? ((latched & HOMING_AXIS_BIT(i)) != 0) :
+										((hm.held & ~held & hm.master_motors[i]) != 0)) {
+			opened |= HOMING_AXIS_BIT(i);
+		}
+	}
+	// a latch that ran its full length without opening a switch ends the latch
+	hm.pending &= ~latched;
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		float latched_position;
+		if (((opened & HOMING_AXIS_BIT(i)) != 0) && (en_get_latched_position(i, &latched_position) == true)) {
+			hm.latch_overrun[i] = cm_get_absolute_position(RUNTIME, i) - latched_position;
+		}
+	}
+	if (((latched != 0) || (hm.held != held)) && (hm.pending != 0)) {
+		en_clear_latch(hm.pending);
+		_homing_axis_move(hm.pending, hm.latch_backoff, hm.latch_velocity);
+		return (_set_homing_func(_homing_axis_latch_stop));
+	}
 	return (_set_homing_func(_homing_axis_zero_backoff));
 }
 
 static stat_t _homing_axis_zero_backoff(int8_t axis)		// backoff to zero position
 {
-	_homing_axis_move(axis, hm.zero_backoff, hm.search_velocity);
+	float target[HOMING_AXES];
+
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		target[i] = hm.zero_backoff[i] - hm.latch_overrun[i];	// measured from the switch, not the stop
+	}
+	hm.held = 0;											// both sides of a squared axis back off
+	_homing_axis_move(hm.axes, target, hm.search_velocity);
 	return (_set_homing_func(_homing_axis_set_zero));
 }
 
 static stat_t _homing_axis_set_zero(int8_t axis)			// set zero and finish up
 {
-	if (hm.set_coordinates != false) {
-		cm_set_position(axis, 0);
-		cm.homed[axis] = true;
-	} else {
-        // do not set axis if in G28.4 cycle
-		cm_set_position(axis, cm_get_work_position(RUNTIME, axis));
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((hm.axes & HOMING_AXIS_BIT(i)) == 0) continue;
+		if (hm.set_coordinates != false) {
+			cm_set_position(i, 0);
+			cm.homed[i] = true;
+			cm.home_switch[i] = -hm.zero_backoff[i];		// zero is the zero backoff from the switch
+			cm.home_switch_known |= HOMING_AXIS_BIT(i);
+		} else {
+			// do not set axis if in G28.4 cycle
+			cm_set_position(i, cm_get_work_position(RUNTIME, i));
+			cm.home_switch_known &= ~HOMING_AXIS_BIT(i);
+		}
 	}
-	cm_set_axis_jerk(axis, hm.saved_jerk);					// restore the max jerk value
-
-#ifdef __NEW_SWITCHES
-	switch_t *s = &sw.s[hm.homing_switch_axis][hm.homing_switch_position];
-	s->on_trailing = hm.switch_saved_on_trailing;
-	_restore_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
-#endif
+	cm_update_soft_limits();
+	_homing_restore_axes();
 	return (_set_homing_func(_homing_axis_start));
 }
 
-static stat_t _homing_axis_move(int8_t axis, float target, float velocity)
+/*
+ * _homing_axis_move() - move the axes in the bitmap, each by its target distance
+ *
+ *	Runs in inverse time so every axis arrives together and none goes faster
+ *	than its own velocity. The slowest axis sets the time of the move. A NULL
+ *	velocity makes it a traverse at the axes' maximum velocities instead.
+ */
+
+static stat_t _homing_axis_move(uint8_t axes, const float target[], const float velocity[])
 {
 	float vect[] = {0,0,0,0,0,0};
 	float flags[] = {false, false, false, false, false, false};
+	float move_time = 0;
 
-	vect[axis] = target;
-	flags[axis] = true;
-	cm.gm.feed_rate = velocity;
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((axes & HOMING_AXIS_BIT(i)) == 0) continue;
+		vect[i] = target[i];
+		flags[i] = true;
+		move_time = max(move_time, fabs(target[i]) / ((velocity == NULL) ? cm.a[i].velocity_max : velocity[i]));
+	}
 	mp_flush_planner();										// don't use cm_request_queue_flush() here
+	if (fp_ZERO(move_time)) return (STAT_OK);				// nothing to move (e.g. zero backoff)
+
+	st_hold_motors(hm.held);								// the steppers are stopped between moves
+
 	cm_request_cycle_start();
+	if (velocity == NULL) {
+		ritorno(cm_straight_traverse(vect, flags));
+		return (STAT_EAGAIN);
+	}
+	cm_set_feed_rate_mode(INVERSE_TIME_MODE);				// the planner drops G93 after each move
+	cm.gm.feed_rate = move_time;							// minutes, as cm_set_feed_rate() leaves it in G93
 	ritorno(cm_straight_feed(vect, flags));
 	return (STAT_EAGAIN);
 }
 
 /*
- * _homing_abort() - end homing cycle in progress
+ * _homing_switch_closed() - return true if the homing switch of the axis is closed
+ * _limit_switch_closed() 	- return true if the limit switch of the axis is closed
  */
 
-static stat_t _homing_abort(int8_t axis)
+static uint8_t _homing_switch_closed(int8_t axis)
+{
+#ifndef __NEW_SWITCHES
+	return (sw.state[hm.homing_switch[axis]] == SW_CLOSED);
+#else
+	return (read_switch(axis, hm.homing_switch[axis]) == SW_CLOSED);
+#endif
+}
+
+static uint8_t _limit_switch_closed(int8_t axis)
+{
+	if (hm.limit_switch[axis] < 0) return (false);
+#ifndef __NEW_SWITCHES
+	return (sw.state[hm.limit_switch[axis]] == SW_CLOSED);
+#else
+	return (read_switch(axis, hm.limit_switch[axis]) == SW_CLOSED);
+#endif
+}
+
+static uint8_t _square_switch_closed(int8_t axis)
+{
+	if (hm.square_switch[axis] < 0) return (false);
+#ifndef __NEW_SWITCHES
+	return (sw.state[hm.square_switch[axis]] == SW_CLOSED);
+#else
+	return (read_switch(hm.square_switch[axis], hm.homing_switch[axis]) == SW_CLOSED);
+#endif
+}
+
+/*
+ * _any_switch_closed() - return true if a homing, limit or square switch of the axes is closed
+ */
+
+static uint8_t _any_switch_closed(uint8_t axes)
+{
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((axes & HOMING_AXIS_BIT(i)) == 0) continue;
+		if (_homing_switch_closed(i) || _limit_switch_closed(i) || _square_switch_closed(i)) return (true);
+	}
+	return (false);
+}
+
+/*
+ * _homing_sides_done() - hold the sides of a squared axis that are done; true once all are
+ *
+ *	An axis that isn't squared has one side, which is done when its homing switch is.
+ *	The held motors stay put on the next move while the rest of the axis runs on.
+ */
+
+static uint8_t _homing_sides_done(int8_t axis, uint8_t master_done, uint8_t square_done)
 {
-	cm_set_axis_jerk(axis, hm.saved_jerk);					// restore the max jerk value
+	if (hm.square_switch[axis] < 0) return (master_done);
+
+	uint8_t motors = hm.master_motors[axis] | hm.square_motors[axis];
+	if (master_done) hm.held |= hm.master_motors[axis];
+	if (square_done) hm.held |= hm.square_motors[axis];
+	return ((hm.held & motors) == motors);
+}
+
+/*
+ * _homing_restore_axes() - restore jerk (and switch bindings) of the axes being homed
+ */
+
+static void _homing_restore_axes(void)
+{
+	for (uint8_t i = 0; i < HOMING_AXES; i++) {
+		if ((hm.axes & HOMING_AXIS_BIT(i)) == 0) continue;
+		cm_set_axis_jerk(i, hm.saved_jerk[i]);				// restore the max jerk value
 #ifdef __NEW_SWITCHES
-	_restore_switch_settings(&sw.s[hm.homing_switch_axis][hm.homing_switch_position]);
+		_restore_switch_settings(i, &sw.s[i][hm.homing_switch[i]]);
 #endif
+	}
+	hm.axes = 0;
+	hm.held = 0;
+	st_hold_motors(0);
+}
+
+/*
+ * _homing_abort() - end homing cycle in progress
+ */
+
+static stat_t _homing_abort(int8_t axis)
+{
+	_homing_restore_axes();
 	_homing_finalize_exit(axis);
 	sr_request_status_report(SR_TIMED_REQUEST);
 	return (STAT_HOMING_CYCLE_FAILED);						// homing state remains HOMING_NOT_HOMED
@@ -444,6 +770,7 @@ static stat_t _homing_error_exit(int8_t axis, stat_t status)
 	}
 	nv_print_list(STAT_HOMING_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
 
+	_homing_restore_axes();
 	_homing_finalize_exit(axis);
 	return (STAT_HOMING_CYCLE_FAILED);						// homing state remains HOMING_NOT_HOMED
 }
@@ -478,7 +805,8 @@ static stat_t _homing_finalize_exit(int8_t axis)			// third part of return to ho
  *	Homes Z first, then the rest in sequence
  *
  *	Isolating this function facilitates implementing more complex and
- *	user-specified axis homing orders
+ *	user-specified axis homing orders. Homing groups are gathered from the
+ *	axis it returns by _homing_axis_start(), which skips axes already homed.
  */
 
 static int8_t _get_next_axis(int8_t axis)
@@ -553,64 +881,6 @@ static int8_t _get_next_axis(int8_t axis)
 #endif
 }
 
-/*
- * _get_next_axes() - return next axis in sequence based on axis in arg
- *
- *	Accepts "axis" arg as the current axis; or -1 to retrieve the first axis
- *	Returns next axis based on "axis" argument
- *	Returns -1 when all axes have been processed
- *	Returns -2 if no axes are specified (Gcode calling error)
- *
- *	hm.axis2 is set to the secondary axis if axis is a dual axis
- *	hm.axis2 is set to -1 otherwise
- *
- *	Isolating this function facilitates implementing more complex and
- *	user-specified axis homing orders
- *
- *	Note: the logic to test for disabled or inhibited axes will allow the
- *	following condition to occur: A single axis is specified but it is
- *	disabled or inhibited - homing will say that it was successfully homed.
- */
-
-// _run_homing_dual_axis() - kernal routine for running homing on a dual axis
-//static stat_t _run_homing_dual_axis(int8_t axis) { return (STAT_OK);}
-
-/*
-int8_t _get_next_axes(int8_t axis)
-{
-	int8_t next_axis;
-	hm.axis2 = -1;
-
-	// Scan target vector for case where no valid axes are specified
-	for (next_axis = 0; next_axis < AXES; next_axis++) {
-		if ((fp_TRUE(cm.gf.target[next_axis])) &&
-			(cm.a[next_axis].axis_mode != AXIS_INHIBITED) &&
-			(cm.a[next_axis].axis_mode != AXIS_DISABLED)) {
-			break;
-		}
-	}
-	if (next_axis == AXES) {
-//		fprintf_P(stderr, PSTR("***** Homing failed: none or disabled/inhibited axes specified\n"));
-		return (-2);	// didn't find any axes to process
-	}
-
-	// Scan target vector from the current axis to find next axis or the end
-	for (next_axis = ++axis; next_axis < AXES; next_axis++) {
-		if (fp_TRUE(cm.gf.target[next_axis])) {
-			if ((cm.a[next_axis].axis_mode == AXIS_INHIBITED) ||
-				(cm.a[next_axis].axis_mode == AXIS_DISABLED)) {	// Skip if axis disabled or inhibited
-				continue;
-			}
-			break;		// got a good one
-		}
-		return (-1);	// you are done
-	}
-
-	// Got a valid axis. Find out if it's a dual
-	return (STAT_OK);
-}
-*/
-
 #ifdef __cplusplus
 }
 #endif
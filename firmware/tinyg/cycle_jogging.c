@@ -30,6 +30,7 @@
 #include "text_parser.h"
 #include "canonical_machine.h"
 #include "planner.h"
+#include "report.h"
 #include "util.h"
 
 #ifdef __cplusplus
@@ -55,6 +56,10 @@ struct jmJoggingSingleton {			// persistent jogging runtime variables
 	uint8_t saved_distance_mode;	// G90,G91 global setting
 	uint8_t saved_feed_rate_mode;   // G93,G94 global setting
 	float saved_jerk;				// saved and restored for each axis homed
+
+	// velocity jog (see cm_jogging_velocity())
+	uint8_t velocity_mode;			// true while a velocity jog is running
+	uint32_t last_command;			// SysTick of the last velocity update (for the timeout)
 };
 static struct jmJoggingSingleton jog;
 
@@ -65,6 +70,7 @@ static stat_t _set_jogging_func(uint8_t (*func)(int8_t axis));
 static stat_t _jogging_axis_start(int8_t axis);
 static stat_t _jogging_axis_jog(int8_t axis);
 static stat_t _jogging_finalize_exit(int8_t axis);
+static stat_t _jogging_velocity_callback(void);
 
 /*****************************************************************************
  * cm_jogging_cycle_start()	- jogging cycle using soft limits
@@ -130,6 +136,7 @@ stat_t cm_jogging_cycle_start(uint8_t axis)
 stat_t cm_jogging_callback(void)
 {
 	if (cm.cycle_state != CYCLE_JOG) { return (STAT_NOOP); } 		// exit if not in a jogging cycle
+	if (jog.velocity_mode == true) { return (_jogging_velocity_callback()); }
 	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN); }	// sync to planner move ends
 	return (jog.func(jog.axis));									// execute the current homing move
 }
@@ -209,6 +216,73 @@ static stat_t _jogging_finalize_exit(int8_t axis)	// finish a jog
 	return (STAT_OK);
 }
 
+/*****************************************************************************
+ * cm_jogging_velocity() - start or update a velocity jog from cm.jog_velocity[]
+ *
+ *	The host streams axis velocities ({"jgv":{"x":1200}}, mm/min, signed) and the
+ *	runtime ramps to them with each axis' jerk (see mp_exec_jog()). Nothing is queued
+ *	per update, so a zero velocity starts the decel on the next segment. The jog ends
+ *	once all axes have stopped, either because the host sent zeros, sent a feedhold,
+ *	or sent nothing for JOGGING_VELOCITY_TIMEOUT.
+ *
+ *	A jog only starts from an idle machine, and Gcode is refused while it runs
+ *	(the Gcode model does not know the position until the jog has ended).
+ */
+
+stat_t cm_jogging_velocity(void)
+{
+	float velocity[AXES];
+	uint8_t moving = false;
+
+	if (jog.velocity_mode == false) {
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			if (fp_NOT_ZERO(cm.jog_velocity[axis])) moving = true;
+		}
+		if (moving == false) return (STAT_OK);		// nothing to start
+		if ((cm.cycle_state != CYCLE_OFF) || (cm_get_runtime_busy() == true) ||
+			(mp_get_planner_buffers_available() < PLANNER_BUFFER_POOL_SIZE)) {
+			for (uint8_t axis=0; axis<AXES; axis++) { cm.jog_velocity[axis] = 0; }
+			return (STAT_COMMAND_NOT_ACCEPTED);
+		}
+		jog.velocity_mode = true;
+		cm.cycle_state = CYCLE_JOG;
+		cm_cycle_start();
+	} else if (cm.hold_state != FEEDHOLD_OFF) {
+		return (STAT_COMMAND_NOT_ACCEPTED);			// a feedhold has stopped this jog
+	}
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		velocity[axis] = min(max(cm.jog_velocity[axis], -cm.a[axis].velocity_max), cm.a[axis].velocity_max);
+	}
+	jog.last_command = SysTickTimer_getValue();
+	return (mp_jog(velocity));
+}
+
+static stat_t _jogging_velocity_callback(void)
+{
+	if (mj.run == true) {							// stop the jog if the host has gone quiet
+		if ((SysTickTimer_getValue() - jog.last_command) > JOGGING_VELOCITY_TIMEOUT) {
+			for (uint8_t axis=0; axis<AXES; axis++) { cm.jog_velocity[axis] = 0; }
+			jog.last_command = SysTickTimer_getValue();
+			mp_jog(cm.jog_velocity);
+		}
+		return (STAT_NOOP);							// keep reading commands while jogging
+	}
+	if ((cm_get_runtime_busy() == true) ||
+		(mp_get_planner_buffers_available() < PLANNER_BUFFER_POOL_SIZE)) {
+		return (STAT_NOOP);							// wait for the last segment to clear
+	}
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		cm.jog_velocity[axis] = 0;
+	}
+	cm_set_position_to_runtime();					// the Gcode model picks up the jog end position
+	jog.velocity_mode = false;
+	cm.cycle_state = CYCLE_OFF;
+	sr_request_status_report(SR_IMMEDIATE_REQUEST);
+
+	printf("{\"jog\":0}\n");
+	return (STAT_OK);
+}
+
 /*
 static stat_t _jogging_error_exit(int8_t axis)
 {
@@ -34,6 +34,7 @@
 #include "switch.h"
 #include "util.h"
 #include "planner.h"
+#include "encoder.h"
 
 /**** Probe singleton structure ****/
 
@@ -57,19 +58,67 @@ struct pbProbingSingleton {						// persistent probing runtime variables
 	// state saved from gcode model
 	uint8_t saved_distance_mode;				// G90,G91 global setting
 	uint8_t saved_coord_system;					// G54 - G59 setting
+	uint8_t saved_feed_rate_mode;				// G93,G94 - the slow pass runs in G94
+	float saved_feed_rate;						// F setting
 	float saved_jerk[AXES];						// saved and restored for each axis
 
+	// probe mode
+	uint8_t probe_away;							// G38.4, G38.5 - stop when the contact opens
+	uint8_t alarm_on_miss;						// G38.2, G38.4 - alarm if the switch does not change
+	uint8_t latch_pass;							// TRUE once the slow pass has been queued
+
 	// probe destination
 	float start_position[AXES];
 	float target[AXES];
 	float flags[AXES];
+	float contact[AXES];						// contact found by the fast pass
 };
 static struct pbProbingSingleton pb;
 
+/**** Probe grid singleton structure ****/
+
+#define PROBE_GRID_MAX_POINTS 8					// per side. The map takes PROBE_GRID_MAX_POINTS^2 floats
+#define PROBE_GRID_DEFAULT_POINTS 3
+
+enum pgGridStep {								// G29 sequence
+	GRID_OFF = 0,
+	GRID_START,									// save the Gcode model settings when motion stops
+	GRID_MOVE,									// travel to the next point at the start height
+	GRID_PROBE,									// probe the point
+	GRID_RECORD,								// store the contact height and retract
+	GRID_RETURN,								// travel back to the start corner
+	GRID_FINISH,								// restore the settings and apply the map
+	GRID_CLEAR									// G29.1 - stop applying the map when motion stops
+};
+
+struct pgProbeGridSingleton {					// height map and G29 runtime variables
+	uint8_t step;								// see pgGridStep
+	uint8_t point;								// point being probed, in probing order
+	uint8_t points[2];							// points along X and Y
+	uint8_t requested_points[2];				// points of a G29 waiting to start
+
+	// state saved from gcode model
+	uint8_t saved_units_mode;
+	uint8_t saved_coord_system;
+	uint8_t saved_distance_mode;
+	uint8_t saved_origin_offset_enable;
+
+	// grid geometry in machine coordinates
+	float corner[3];							// XY of the far corner, Z of the probe bottom
+	float origin[2];							// start corner
+	float spacing[2];							// distance between points (may be negative)
+	float inverse_spacing[2];
+	float clearance_z;							// travel height between points
+
+	float z[PROBE_GRID_MAX_POINTS * PROBE_GRID_MAX_POINTS];	// height map, row by row from the start corner
+};
+static struct pgProbeGridSingleton pg;
+
 /**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
 
 static stat_t _probing_init();
 static stat_t _probing_start();
+static stat_t _probing_latch();
 static stat_t _probing_finish();
 static stat_t _probing_finalize_exit();
 static stat_t _probing_error_exit(int8_t axis);
@@ -86,9 +135,22 @@ uint8_t _set_pb_func(uint8_t (*func)())
 }
 
 /****************************************************************************************
- * cm_probing_cycle_start()	- G38.2 homing cycle using limit switches
+ * cm_probing_cycle_start()	- G38.2 - G38.5 probing cycle using the Z min switch
  * cm_probing_callback() 	- main loop callback for running the homing cycle
  *
+ *	G38.2 and G38.3 probe toward the work and stop when the contact closes. G38.4 and
+ *	G38.5 probe away from it and stop when the contact opens. G38.2 and G38.4 alarm if
+ *	the switch does not change before the target is reached; G38.3 and G38.5 only
+ *	report the failed probe (prbe 0), as G29 does for its points.
+ *
+ *	Probing is done in two passes, the same way homing finds its switches. The fast pass
+ *	runs at F until the switch changes. The slow pass then backs off along the probe
+ *	line at the probe latch velocity ($plv) until the switch changes back, for at most
+ *	the probe latch backoff ($plb). The edge of the slow pass is latched by the switch
+ *	ISR and is the probe result, so F sets only the approach time and $plv the accuracy.
+ *	The tool is left just off the contact. If the slow pass sees no edge the fast pass
+ *	contact is used. $plv 0 probes once at F and leaves the tool where it stopped.
+ *
  *	--- Some further details ---
  *
  *	All cm_probe_cycle_start does is prevent any new commands from queueing to the
@@ -106,7 +168,7 @@ uint8_t _set_pb_func(uint8_t (*func)())
  *	to cm_get_runtime_busy() is about.
  */
 
-uint8_t cm_straight_probe(float target[], float flags[])
+uint8_t cm_straight_probe(float target[], float flags[], bool probe_away, bool alarm_on_miss)
 {
 	// trap zero feed rate condition
 	if ((cm.gm.feed_rate_mode != INVERSE_TIME_MODE) && (fp_ZERO(cm.gm.feed_rate))) {
@@ -122,6 +184,9 @@ uint8_t cm_straight_probe(float target[], float flags[])
 	copy_vector(pb.flags, flags);		// set axes involved on the move
 	clear_vector(cm.probe_results);		// clear the old probe position.
 										// NOTE: relying on probe_result will not detect a probe to 0,0,0.
+	pb.probe_away = probe_away;
+	pb.alarm_on_miss = alarm_on_miss;
+	pb.latch_pass = false;
 
 	cm.probe_state = PROBE_WAITING;		// wait until planner queue empties before completing initialization
 	pb.func = _probing_init; 			// bind probing initialization function
@@ -200,51 +265,101 @@ static uint8_t _probing_init()
 	// probe in absolute machine coords
 	pb.saved_coord_system = cm_get_coord_system(ACTIVE_MODEL);     //cm.gm.coord_system;
 	pb.saved_distance_mode = cm_get_distance_mode(ACTIVE_MODEL);   //cm.gm.distance_mode;
+	pb.saved_feed_rate_mode = cm_get_feed_rate_mode(ACTIVE_MODEL);
+	pb.saved_feed_rate = cm_get_feed_rate(ACTIVE_MODEL);
 	cm_set_distance_mode(ABSOLUTE_MODE);
 	cm_set_coord_system(ABSOLUTE_COORDS);
 
-	cm_spindle_control(SPINDLE_OFF);
+	cm_spindle_stop();
 	return (_set_pb_func(_probing_start));							// start the move
 }
 
 /*
- * _probing_start()
+ * _probing_start()	 - fast pass at F
+ * _probing_latch()	 - slow pass back off the contact at the probe latch velocity
+ * _probing_finish() - record the result
+ * _probe_contact()	 - TRUE if the switch is in the state the probe stops on
+ * _probe_position() - get the stopped position, moved back to the switch edge if one was latched
  */
 
-static stat_t _probing_start()
+static uint8_t _probe_contact()
 {
-	// initial probe state, don't probe if we're already contacted!
 #ifndef __NEW_SWITCHES
 	int8_t probe = sw.state[pb.probe_switch];
 #else
 	int8_t probe = read_switch(pb.probe_switch_axis, pb.probe_switch_position);
 #endif
+	return (probe == ((pb.probe_away == true) ? SW_OPEN : SW_CLOSED));
+}
 
-    if( probe==SW_OPEN ) {
-        ritorno(cm_straight_feed(pb.target, pb.flags));
-    }
-	return (_set_pb_func(_probing_finish));
+static void _probe_position(float position[], uint8_t latched)
+{
+	// get the overrun past the edge for axes that latched their steps - before
+	// cm_set_position() below rewrites the step counts the latch is measured against
+	float overrun[AXES];
+	for( uint8_t axis=0; axis<AXES; axis++ ) {
+		float latched_position;
+		overrun[axis] = 0;
+		if ((latched == true) && (en_get_latched_position(axis, &latched_position) == true)) {
+			overrun[axis] = mp_get_runtime_absolute_position(axis) - latched_position;
+		}
+	}
+	for( uint8_t axis=0; axis<AXES; axis++ ) {
+		// if we got here because of a feed hold we need to keep the model position correct
+		cm_set_position(axis, mp_get_runtime_work_position(axis));
+		position[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis) - overrun[axis];
+	}
 }
 
-/*
- * _probing_finish()
- */
+static stat_t _probing_start()
+{
+	// initial probe state, don't probe if we're already contacted!
+	if (_probe_contact() == false) {
+		en_clear_latch(0xFF);										// a probe contact latches all axes
+		ritorno(cm_straight_feed(pb.target, pb.flags));
+	}
+	return (_set_pb_func(_probing_latch));
+}
 
-static stat_t _probing_finish()
+static stat_t _probing_latch()
 {
-#ifndef __NEW_SWITCHES
-	int8_t probe = sw.state[pb.probe_switch];
-#else
-	int8_t probe = read_switch(pb.probe_switch_axis, pb.probe_switch_position);
-#endif
-	cm.probe_state = (probe==SW_CLOSED) ? PROBE_SUCCEEDED : PROBE_FAILED;
+	uint8_t contact = _probe_contact();
+	_probe_position(pb.contact, contact);
+	if ((contact == false) || (fp_ZERO(cm.probe_latch_velocity)) || (fp_ZERO(cm.probe_latch_backoff))) {
+		return (_probing_finish());
+	}
 
+	// back off toward the start, along the probe line
+	float length = get_axis_vector_length(pb.start_position, pb.target);
+	float backoff[AXES];
 	for( uint8_t axis=0; axis<AXES; axis++ ) {
-		// if we got here because of a feed hold we need to keep the model position correct
-		cm_set_position(axis, mp_get_runtime_work_position(axis));
+		backoff[axis] = pb.contact[axis];
+		if (fp_TRUE(pb.flags[axis])) {
+			backoff[axis] += (pb.start_position[axis] - pb.target[axis]) * cm.probe_latch_backoff / length;
+		}
+	}
+	mp_flush_planner();												// drop the rest of the fast pass
+	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
+	cm.gm.feed_rate = cm.probe_latch_velocity;
+	pb.latch_pass = true;
+	en_clear_latch(0xFF);											// the slow edge latches all axes
+	cm_request_cycle_start();
+	ritorno(cm_straight_feed(backoff, pb.flags));
+	return (_set_pb_func(_probing_finish));
+}
 
-		// store the probe results
-		cm.probe_results[axis] = cm_get_absolute_position(ACTIVE_MODEL, axis);
+static stat_t _probing_finish()
+{
+	if (pb.latch_pass == true) {
+		uint8_t released = !_probe_contact();						// the slow pass went back across the edge
+		_probe_position(cm.probe_results, released);
+		if (released == false) {
+			copy_vector(cm.probe_results, pb.contact);				// no edge - keep the fast contact
+		}
+		cm.probe_state = PROBE_SUCCEEDED;
+	} else {
+		cm.probe_state = (_probe_contact() == true) ? PROBE_SUCCEEDED : PROBE_FAILED;
+		copy_vector(cm.probe_results, pb.contact);
 	}
 
 	json_parser("{\"prb\":null}"); // TODO: verify that this is OK to do...
@@ -284,9 +399,11 @@ static void _probe_restore_settings()
 	for( uint8_t axis=0; axis<AXES; axis++ )
 		cm_set_axis_jerk(axis, pb.saved_jerk[axis]);
 
-	// restore coordinate system and distance mode
+	// restore coordinate system, distance mode and feed rate
 	cm_set_coord_system(pb.saved_coord_system);
 	cm_set_distance_mode(pb.saved_distance_mode);
+	cm_set_feed_rate_mode(pb.saved_feed_rate_mode);
+	cm.gm.feed_rate = pb.saved_feed_rate;
 
 	// update the model with actual position
 	cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
@@ -297,6 +414,9 @@ static void _probe_restore_settings()
 static stat_t _probing_finalize_exit()
 {
 	_probe_restore_settings();
+	if ((cm.probe_state != PROBE_SUCCEEDED) && (pb.alarm_on_miss == true)) {
+		return (cm_soft_alarm(STAT_PROBE_CYCLE_FAILED));		// G38.2, G38.4 - the probe did not trip
+	}
 	return (STAT_OK);
 }
 
@@ -318,3 +438,242 @@ static stat_t _probing_error_exit(int8_t axis)
 	_probe_restore_settings();
 	return (STAT_PROBE_CYCLE_FAILED);
 }
+
+/****************************************************************************************
+ * cm_probe_grid()			- G29 probe a grid of points into a height map
+ * cm_clear_probe_grid()	- G29.1 stop applying the height map
+ * cm_probe_grid_callback()	- main loop callback for running the grid
+ * cm_abort_probe_grid()	- drop a grid that is flushed from the queue
+ * cm_grid_compensate()		- apply the height map to a runtime segment target
+ *
+ *	G29 X_ Y_ Z_ I_ J_ F_ probes I x J points (3 x 3 if omitted) evenly spread over the
+ *	rectangle between the current position and the X and Y of the block. Each point is a
+ *	G38.3 probe down to Z at feed rate F run by cm_straight_probe(). The tool travels
+ *	between points at the Z it started from, row by row in a serpentine, and returns to
+ *	the start corner at the end. A point that does not make contact aborts the grid.
+ *	X, Y and Z are in the current units, distance mode and coordinate system.
+ *
+ *	The height map is kept in RAM in machine coordinates, relative to the start corner -
+ *	so set Z zero on the work at that corner. Once the grid completes, the runtime adds the
+ *	bilinear interpolation of the map to the Z of each segment before the segment goes to
+ *	ik_kinematics() (points outside the grid take the nearest edge value). While the map is
+ *	applied body segments are NOM_SEGMENT_USEC like head and tail segments, so long moves
+ *	are subdivided every few tenths of a mm at usual feeds and follow the surface. The
+ *	planner does not see the Z motion the map adds, which is fine for the slopes of a
+ *	warped board or fixture plate.
+ *
+ *	The map is turned on and off with the machine stopped, and the Z model position is
+ *	moved by the local map offset rather than the tool. G29.1 stops applying it, as does
+ *	a new G29 until it has completed.
+ */
+
+static void _grid_set_compensation(uint8_t enable);
+static stat_t _grid_exit(stat_t status);
+
+stat_t cm_probe_grid(float target[], float flags[], float points[], float points_flags[])
+{
+	if ((cm.gm.feed_rate_mode != INVERSE_TIME_MODE) && (fp_ZERO(cm.gm.feed_rate))) {
+		return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	}
+	if (fp_ZERO(flags[AXIS_X]) || fp_ZERO(flags[AXIS_Y]) || fp_ZERO(flags[AXIS_Z]))
+		return (STAT_GCODE_AXIS_IS_MISSING);
+
+	// the grid is run in machine coordinates and mm
+	for (uint8_t axis=AXIS_X; axis<=AXIS_Z; axis++) {
+		pg.corner[axis] = _to_millimeters(target[axis]);
+		pg.corner[axis] += (cm.gm.distance_mode == ABSOLUTE_MODE) ?
+			cm_get_active_coord_offset(axis) : cm_get_absolute_position(MODEL, axis);
+	}
+	if (pg.corner[AXIS_Z] > cm_get_absolute_position(MODEL, AXIS_Z) - MINIMUM_PROBE_TRAVEL)
+		return (STAT_INPUT_VALUE_RANGE_ERROR);		// probe bottom must be below the start
+
+	for (uint8_t i=0; i<2; i++) {
+		float count = (fp_TRUE(points_flags[i])) ? points[i] : PROBE_GRID_DEFAULT_POINTS;
+		if ((count < 2) || (count > PROBE_GRID_MAX_POINTS))
+			return (STAT_INPUT_VALUE_RANGE_ERROR);
+		if (fabs(pg.corner[i] - cm_get_absolute_position(MODEL, i)) < MINIMUM_PROBE_TRAVEL)
+			return (STAT_INPUT_VALUE_RANGE_ERROR);
+		pg.requested_points[i] = (uint8_t)count;	// the running map still uses pg.points
+	}
+	pg.step = GRID_START;							// wait until motion stops before starting
+	return (STAT_OK);
+}
+
+stat_t cm_clear_probe_grid()
+{
+	pg.step = GRID_CLEAR;							// turn it off once motion stops
+	return (STAT_OK);
+}
+
+void cm_abort_probe_grid()
+{
+	if ((pg.step != GRID_OFF) && (pg.step != GRID_START) && (pg.step != GRID_CLEAR)) {
+		_grid_exit(STAT_OK);					// restore the Gcode model settings
+	}
+	pg.step = GRID_OFF;
+}
+
+static uint8_t _grid_point(uint8_t point, float target[])
+{
+	uint8_t row = point / pg.points[0];
+	uint8_t column = point % pg.points[0];
+	if ((row & 1) != 0) column = pg.points[0] - 1 - column;	// odd rows run backwards
+
+	target[AXIS_X] = pg.origin[0] + column * pg.spacing[0];
+	target[AXIS_Y] = pg.origin[1] + row * pg.spacing[1];
+	return (row * pg.points[0] + column);			// index into the map
+}
+
+stat_t cm_probe_grid_callback(void)
+{
+	if (pg.step == GRID_OFF) return (STAT_NOOP);
+	if (cm_get_runtime_busy() == true) return (STAT_EAGAIN);	// sync to planner move ends
+	if ((cm.cycle_start_requested == true) || (cm.motion_state == MOTION_RUN)) {
+		return (STAT_EAGAIN);						// ...and to a move not yet picked up by the runtime
+	}
+
+	float target[AXES], flags[AXES];
+	clear_vector(target);
+	clear_vector(flags);
+	stat_t status = STAT_OK;
+
+	switch (pg.step) {
+		case GRID_START: {
+			_grid_set_compensation(false);
+			pg.saved_units_mode = cm_get_units_mode(MODEL);
+			pg.saved_coord_system = cm_get_coord_system(MODEL);
+			pg.saved_distance_mode = cm_get_distance_mode(MODEL);
+			pg.saved_origin_offset_enable = cm.gmx.origin_offset_enable;
+			cm.gmx.origin_offset_enable = false;
+			cm_set_units_mode(MILLIMETERS);
+			cm_set_coord_system(ABSOLUTE_COORDS);
+			cm_set_distance_mode(ABSOLUTE_MODE);
+
+			for (uint8_t i=0; i<2; i++) {
+				pg.points[i] = pg.requested_points[i];
+				pg.origin[i] = cm_get_absolute_position(MODEL, i);
+				pg.spacing[i] = (pg.corner[i] - pg.origin[i]) / (pg.points[i] - 1);
+				pg.inverse_spacing[i] = 1 / pg.spacing[i];
+			}
+			pg.clearance_z = cm_get_absolute_position(MODEL, AXIS_Z);
+			pg.point = 0;
+			pg.step = GRID_MOVE;
+			break;
+		}
+		case GRID_MOVE: {							// travel to the point at the start height
+			_grid_point(pg.point, target);
+			target[AXIS_Z] = pg.clearance_z;
+			flags[AXIS_X] = 1;
+			flags[AXIS_Y] = 1;
+			flags[AXIS_Z] = 1;
+			status = cm_straight_traverse(target, flags);
+			pg.step = GRID_PROBE;
+			break;
+		}
+		case GRID_PROBE: {
+			_grid_point(pg.point, target);
+			target[AXIS_Z] = pg.corner[AXIS_Z];
+			flags[AXIS_Z] = 1;
+			status = cm_straight_probe(target, flags, false, false);	// G38.3 - a miss aborts the grid
+			pg.step = GRID_RECORD;
+			break;
+		}
+		case GRID_RECORD: {							// store the contact height and retract
+			if (cm.probe_state != PROBE_SUCCEEDED) {
+				return (_grid_exit(STAT_PROBE_CYCLE_FAILED));
+			}
+			pg.z[_grid_point(pg.point, target)] = cm.probe_results[AXIS_Z];
+			target[AXIS_Z] = pg.clearance_z;
+			flags[AXIS_Z] = 1;
+			status = cm_straight_traverse(target, flags);
+			pg.step = (++pg.point < pg.points[0] * pg.points[1]) ? GRID_MOVE : GRID_RETURN;
+			break;
+		}
+		case GRID_RETURN: {
+			target[AXIS_X] = pg.origin[0];
+			target[AXIS_Y] = pg.origin[1];
+			flags[AXIS_X] = 1;
+			flags[AXIS_Y] = 1;
+			status = cm_straight_traverse(target, flags);
+			pg.step = GRID_FINISH;
+			break;
+		}
+		case GRID_FINISH: {
+			float reference = pg.z[0];				// heights relative to the start corner
+			for (uint8_t i=0; i < pg.points[0] * pg.points[1]; i++) {
+				pg.z[i] -= reference;
+			}
+			_grid_exit(STAT_OK);
+			_grid_set_compensation(true);
+			cm_cycle_end();
+			return (STAT_OK);
+		}
+		case GRID_CLEAR: {
+			_grid_set_compensation(false);
+			pg.step = GRID_OFF;
+			return (STAT_OK);
+		}
+	}
+	if (status != STAT_OK) return (_grid_exit(status));
+	return (STAT_EAGAIN);
+}
+
+/*
+ * _grid_exit() - restore the Gcode model settings and end the grid
+ */
+
+static stat_t _grid_exit(stat_t status)
+{
+	cm.gmx.origin_offset_enable = pg.saved_origin_offset_enable;
+	cm_set_units_mode(pg.saved_units_mode);
+	cm_set_coord_system(pg.saved_coord_system);
+	cm_set_distance_mode(pg.saved_distance_mode);
+	pg.step = GRID_OFF;
+
+	if (status == STAT_PROBE_CYCLE_FAILED) {
+		nv_reset_nv_list();
+		nv_add_conditional_message((const char_t *)"Probing error - no contact at grid point");
+		nv_print_list(STAT_PROBE_CYCLE_FAILED, TEXT_INLINE_VALUES, JSON_RESPONSE_FORMAT);
+	}
+	return (status);
+}
+
+/*
+ * _grid_offset() - bilinear interpolation of the height map at X,Y
+ * _grid_set_compensation() - turn the height map on or off with the machine stopped
+ */
+
+static float _grid_offset(float x, float y)
+{
+	float u = (x - pg.origin[0]) * pg.inverse_spacing[0];	// position in grid cells
+	float v = (y - pg.origin[1]) * pg.inverse_spacing[1];
+	u = min(max(u, 0), pg.points[0] - 1);
+	v = min(max(v, 0), pg.points[1] - 1);
+	uint8_t column = min((uint8_t)u, pg.points[0] - 2);
+	uint8_t row = min((uint8_t)v, pg.points[1] - 2);
+	u -= column;
+	v -= row;
+
+	const float *z = &pg.z[row * pg.points[0] + column];
+	float z_low = z[0] + (z[1] - z[0]) * u;
+	float z_high = z[pg.points[0]] + (z[pg.points[0] + 1] - z[pg.points[0]]) * u;
+	return (z_low + (z_high - z_low) * v);
+}
+
+static void _grid_set_compensation(uint8_t enable)
+{
+	if (cm.grid_compensation == enable) return;
+	float z = mp_get_runtime_absolute_position(AXIS_Z);
+	float offset = _grid_offset(mp_get_runtime_absolute_position(AXIS_X), mp_get_runtime_absolute_position(AXIS_Y));
+
+	cm.grid_compensation = enable;					// the tool stays where it is...
+	cm_set_position(AXIS_Z, (enable == true) ? (z - offset) : (z + offset));	// ...the model moves
+}
+
+const float *cm_grid_compensate(const float target[], float compensated[])
+{
+	if (cm.grid_compensation == false) return (target);
+	memcpy(compensated, target, sizeof(float)*AXES);	// not copy_vector() - target is a pointer here
+	compensated[AXIS_Z] += _grid_offset(target[AXIS_X], target[AXIS_Y]);
+	return (compensated);
+}
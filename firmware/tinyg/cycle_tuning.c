@@ -0,0 +1,256 @@
+/*
+ * cycle_tuning.c - jerk and velocity tuning cycle extension to canonical_machine.c
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tinyg.h"
+#include "config.h"
+#include "json_parser.h"
+#include "text_parser.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "kinematics.h"
+#include "encoder.h"
+#include "report.h"
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**** Tuning singleton structure ****/
+
+struct tnTuningSingleton {			// persistent tuning runtime variables
+	int8_t axis;					// axis being tuned
+	uint8_t step;					// tuning step being run
+	uint8_t watched;				// true if a motor of the axis has an encoder
+	float start_pos;				// machine position the passes start and end at
+	float jerk;						// jerk of the step being run (divided by JERK_MULTIPLIER)
+	float velocity;					// velocity of the step being run
+	float error;					// largest following error of the step, in steps
+
+	stat_t (*func)(int8_t axis);	// binding for callback function state machine
+
+	// state saved from gcode model and the axis
+	float saved_feed_rate;			// F setting
+	uint8_t saved_units_mode;		// G20,G21 global setting
+	uint8_t saved_coord_system;		// G54 - G59 setting
+	uint8_t saved_distance_mode;	// G90,G91 global setting
+	uint8_t saved_feed_rate_mode;   // G93,G94 global setting
+	float saved_jerk;
+	float saved_velocity_max;
+	float saved_feedrate_max;
+};
+static struct tnTuningSingleton tun;
+
+/**** NOTE: global prototypes and other .h info is located in canonical_machine.h ****/
+
+static stat_t _set_tuning_func(stat_t (*func)(int8_t axis));
+static stat_t _tuning_axis_pass(int8_t axis);
+static stat_t _tuning_axis_check(int8_t axis);
+static stat_t _tuning_finalize_exit(int8_t axis);
+static uint8_t _tuning_step_failed(int8_t axis);
+
+/*****************************************************************************
+ * cm_tuning_cycle_start() - find the highest safe jerk and velocity of an axis
+ *
+ *	{"tunx":20} runs the X axis out 20 mm from where it stands and back again, once
+ *	for each of TUNING_STEPS steps. The first step runs at TUNING_START_FACTOR times the
+ *	axis' jm and vm and each step after runs TUNING_STEP_FACTOR faster and harder. The
+ *	velocity is held to the axis step rate limit ($xvs), so the last steps may only
+ *	raise the jerk.
+ *
+ *	After each pass the peak following error of the motors of the axis that have an
+ *	encoder is checked. A step fails once a motor has lagged by TUNING_ERROR_FRACTION of
+ *	its following error limit ($1fl) - or by TUNING_FOLLOWING_ERROR steps if it has
+ *	none, which is a stall. A following error alarm, or a feedhold, ends the cycle at
+ *	once. The jerk and velocity of the last step passed are left in tunj and tunv and
+ *	reported as {"tun":{"jm":..,"vm":..,"fe":..}}, with fe the peak error of the last step.
+ *
+ *	With $tuw set the axis takes the results times the margin ($tum) as its new jm and vm.
+ *	Without an encoder on the axis a stall can't be seen, so all steps pass: the results
+ *	are then only reported and never written.
+ *
+ *	The axis jm and vm are restored when the cycle ends, and the cycle is refused
+ *	unless the machine is idle. Gcode is refused while it runs.
+ */
+
+stat_t cm_tuning_cycle_start(uint8_t axis)
+{
+	if ((cm.cycle_state != CYCLE_OFF) || (cm_get_runtime_busy() == true) ||
+		(fp_ZERO(cm.tuning_travel)) || (cm.a[axis].axis_mode == AXIS_DISABLED)) {
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	}
+	// save relevant non-axis parameters from Gcode model
+	tun.saved_units_mode = cm_get_units_mode(ACTIVE_MODEL);
+	tun.saved_coord_system = cm_get_coord_system(ACTIVE_MODEL);
+	tun.saved_distance_mode = cm_get_distance_mode(ACTIVE_MODEL);
+	tun.saved_feed_rate_mode = cm_get_feed_rate_mode(ACTIVE_MODEL);
+	tun.saved_feed_rate = cm_get_feed_rate(ACTIVE_MODEL);
+	tun.saved_jerk = cm_get_axis_jerk(axis);
+	tun.saved_velocity_max = cm.a[axis].velocity_max;
+	tun.saved_feedrate_max = cm.a[axis].feedrate_max;
+
+	// set working values
+	cm_set_units_mode(MILLIMETERS);
+	cm_set_distance_mode(ABSOLUTE_MODE);
+	cm_set_coord_system(ABSOLUTE_COORDS);			// tuning is done in machine coordinates
+	cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);
+
+	tun.watched = false;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if ((ik.axis[motor] == axis) && (en.en[motor].channel >= 0)) tun.watched = true;
+	}
+	tun.start_pos = cm_get_absolute_position(RUNTIME, axis);
+	tun.step = 0;
+	tun.error = 0;
+	cm.tuning_jerk = 0;
+	cm.tuning_velocity = 0;
+
+	tun.axis = axis;
+	tun.func = _tuning_axis_pass; 					// bind initial processing function
+
+	cm.cycle_state = CYCLE_TUNE;
+	cm_cycle_start();
+	return (STAT_OK);
+}
+
+/* Tuning moves - these alternate for each step
+ * cm_tuning_callback()			- main loop callback for running the tuning cycle
+ *	_set_tuning_func()			- a convenience for setting the next dispatch vector and exiting
+ *	_tuning_axis_pass()			- set the step's jerk and velocity and queue the pass
+ *	_tuning_axis_check()		- check the following error of the pass
+ *	_tuning_finalize_exit()		- restore the axis and report the results
+ */
+
+stat_t cm_tuning_callback(void)
+{
+	if (cm.cycle_state != CYCLE_TUNE) { return (STAT_NOOP); }		// exit if not in a tuning cycle
+	if ((cm.machine_state == MACHINE_ALARM) || (cm.hold_state != FEEDHOLD_OFF)) {
+		if ((cm.hold_state != FEEDHOLD_OFF) && (cm.hold_state != FEEDHOLD_HOLD)) {
+			return (STAT_EAGAIN);									// let the hold come to rest
+		}
+		cm_request_queue_flush();									// drop the rest of the pass
+		_tuning_step_failed(tun.axis);								// report the error that stopped it
+		return (_tuning_finalize_exit(tun.axis));
+	}
+	if (cm_get_runtime_busy() == true) { return (STAT_EAGAIN); }	// sync to planner move ends
+	return (tun.func(tun.axis));									// execute the current tuning move
+}
+
+static stat_t _set_tuning_func(stat_t (*func)(int8_t axis))
+{
+	tun.func = func;
+	return (STAT_EAGAIN);
+}
+
+static stat_t _tuning_axis_pass(int8_t axis)
+{
+	float vect[] = {0,0,0,0,0,0};
+	float flags[] = {false, false, false, false, false, false};
+	flags[axis] = true;
+
+	float factor = TUNING_START_FACTOR * pow(TUNING_STEP_FACTOR, tun.step);
+	tun.jerk = tun.saved_jerk * factor;
+	tun.velocity = tun.saved_velocity_max * factor;
+	if ((cm.a[axis].step_velocity_max > 0) && (tun.velocity > cm.a[axis].step_velocity_max)) {
+		tun.velocity = cm.a[axis].step_velocity_max;
+	}
+	cm_set_axis_jerk(axis, tun.jerk);
+	cm.a[axis].velocity_max = tun.velocity;
+	cm.a[axis].feedrate_max = tun.velocity;
+
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if (ik.axis[motor] == axis) en.en[motor].peak_error = 0;
+	}
+	cm.gm.feed_rate = tun.velocity;
+	vect[axis] = tun.start_pos + cm.tuning_travel;
+	ritorno(cm_straight_feed(vect, flags));
+	vect[axis] = tun.start_pos;
+	ritorno(cm_straight_feed(vect, flags));
+	return (_set_tuning_func(_tuning_axis_check));
+}
+
+static stat_t _tuning_axis_check(int8_t axis)
+{
+	if (_tuning_step_failed(axis) == true) {
+		return (_tuning_finalize_exit(axis));
+	}
+	cm.tuning_jerk = tun.jerk;
+	cm.tuning_velocity = tun.velocity;
+	if (++tun.step >= TUNING_STEPS) {
+		return (_tuning_finalize_exit(axis));
+	}
+	return (_set_tuning_func(_tuning_axis_pass));
+}
+
+static uint8_t _tuning_step_failed(int8_t axis)
+{
+	uint8_t failed = false;
+
+	tun.error = 0;
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		if ((ik.axis[motor] != axis) || (en.en[motor].channel < 0)) continue;
+		float limit = en.en[motor].following_error_limit;
+		limit = (limit > 0) ? (limit * TUNING_ERROR_FRACTION) : TUNING_FOLLOWING_ERROR;
+		if (en.en[motor].peak_error > limit) failed = true;
+		tun.error = max(tun.error, en.en[motor].peak_error);
+	}
+	return (failed);
+}
+
+static stat_t _tuning_finalize_exit(int8_t axis)	// finish tuning
+{
+	cm_set_axis_jerk(axis, tun.saved_jerk);
+	cm.a[axis].velocity_max = tun.saved_velocity_max;
+	cm.a[axis].feedrate_max = tun.saved_feedrate_max;
+
+	if ((cm.tuning_write == true) && (tun.watched == true) && (cm.tuning_jerk > 0)) {
+		nvObj_t nv;
+		cm_set_axis_jerk(axis, cm.tuning_jerk * cm.tuning_margin);
+		cm.a[axis].velocity_max = cm.tuning_velocity * cm.tuning_margin;
+		sprintf((char *)nv.token, "%cjm", ("xyzabc")[axis]);
+		nv.index = nv_get_index((const char_t *)"", nv.token);
+		nv.value = cm.a[axis].jerk_max;
+		nv_persist(&nv);
+		sprintf((char *)nv.token, "%cvm", ("xyzabc")[axis]);
+		nv.index = nv_get_index((const char_t *)"", nv.token);
+		nv.value = cm.a[axis].velocity_max;
+		nv_persist(&nv);
+	}
+	cm_set_coord_system(tun.saved_coord_system);	// restore to work coordinate system
+	cm_set_units_mode(tun.saved_units_mode);
+	cm_set_distance_mode(tun.saved_distance_mode);
+	cm_set_feed_rate_mode(tun.saved_feed_rate_mode);
+	cm.gm.feed_rate = tun.saved_feed_rate;
+	cm_set_motion_mode(MODEL, MOTION_MODE_CANCEL_MOTION_MODE);
+	cm_cycle_end();
+	cm.cycle_state = CYCLE_OFF;
+
+	printf_P(PSTR("{\"tun\":{\"jm\":%0.0f,\"vm\":%0.0f,\"fe\":%0.0f}}\n"),
+		cm.tuning_jerk, cm.tuning_velocity, tun.error);
+	return (STAT_OK);
+}
+
+#ifdef __cplusplus
+}
+#endif
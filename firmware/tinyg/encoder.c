@@ -28,6 +28,14 @@
 #include "tinyg.h"
 #include "config.h"
 #include "encoder.h"
+#include "hardware.h"
+#include "planner.h"
+#include "kinematics.h"
+#include "stepper.h"
+#include "canonical_machine.h"
+#include "json_parser.h"
+#include "text_parser.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -37,6 +45,12 @@ extern "C"{
 
 enEncoders_t en;
 
+static void _qdec_init(void);
+static int8_t _get_free_channel(void);
+#if (ENCODER_QDEC_CHANNELS > 0)
+static float _get_steps_per_count(uint8_t motor);
+#endif
+
 /************************************************************************************
  **** CODE **************************************************************************
  ************************************************************************************/
@@ -48,9 +62,39 @@ enEncoders_t en;
 void encoder_init()
 {
 	memset(&en, 0, sizeof(en));		// clear all values, pointers and status
+	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
+		en.en[motor].channel = -1;
+	}
+	en.fault_motor = -1;
+	en.spindle_channel = -1;
+	_qdec_init();
 	encoder_init_assertions();
 }
 
+/*
+ * _qdec_init() - start the hardware quadrature decoder
+ *
+ *	The pins feed event channel 0 with quadrature decoding on. The timer counts the
+ *	events up or down and wraps over the full 16 bits, which en_sample_counts() extends.
+ */
+
+static void _qdec_init()
+{
+#ifdef __ENCODER_QDEC
+	PORT_QDEC.DIRCLR = QDEC_PINS_bm;
+	PORT_QDEC.PIN0CTRL = PORT_ISC_LEVEL_gc;		// QDEC needs level sensing
+	PORT_QDEC.PIN1CTRL = PORT_ISC_LEVEL_gc;
+	EVSYS.CH0MUX = QDEC_EVSYS_CHMUX;
+	EVSYS.CH0CTRL = EVSYS_QDEN_bm | QDEC_EVSYS_FILTER;
+
+	TIMER_QDEC.CTRLA = 0;
+	TIMER_QDEC.CTRLD = TC_EVACT_QDEC_gc | TC_EVSEL_CH0_gc;
+	TIMER_QDEC.PER = 0xFFFF;
+	TIMER_QDEC.CNT = 0;
+	TIMER_QDEC.CTRLA = QDEC_TIMER_ENABLE;
+#endif
+}
+
 /*
  * encoder_init_assertions() - initialize encoder assertions
  * encoder_test_assertions() - test assertions, return error code if violation exists
@@ -74,12 +118,22 @@ stat_t encoder_test_assertions()
  *
  *	Sets the encoder_position steps. Takes floating point steps as input,
  *	writes integer steps. So it's not an exact representation of machine
- *	position except if the machine is at zero.
+ *	position except if the machine is at zero. A quadrature encoder keeps
+ *	counting and its offset is moved instead.
  */
 
 void en_set_encoder_steps(uint8_t motor, float steps)
 {
 	en.en[motor].encoder_steps = (int32_t)round(steps);
+#if (ENCODER_QDEC_CHANNELS > 0)
+	int8_t channel = en.en[motor].channel;
+	if (channel >= 0) {
+		cli();
+		int32_t counts = en.qdec[channel].counts;
+		sei();
+		en.en[motor].count_offset = steps - (float)counts * _get_steps_per_count(motor);
+	}
+#endif
 }
 
 /*
@@ -89,19 +143,294 @@ void en_set_encoder_steps(uint8_t motor, float steps)
  *	encoder_position during LOAD (HI interrupt level). The encoder position is
  *	therefore always stable. But be advised: the position lags target and position
  *	valaues elsewherein the system becuase the sample is taken when the steps for
- *	that segment are complete.
+ *	that segment are complete. A quadrature encoder is sampled at the same point
+ *	(see en_sample_counts()) and returned in steps.
  */
 
+static int32_t _get_reading(uint8_t motor)		// call with interrupts off
+{
+#if (ENCODER_QDEC_CHANNELS > 0)
+	if (en.en[motor].channel >= 0) {
+		return (en.qdec[en.en[motor].channel].counts);
+	}
+#endif
+	return(en.en[motor].encoder_steps);
+}
+
+static float _reading_to_steps(uint8_t motor, int32_t reading)
+{
+#if (ENCODER_QDEC_CHANNELS > 0)
+	if (en.en[motor].channel >= 0) {
+		return ((float)reading * _get_steps_per_count(motor) + en.en[motor].count_offset);
+	}
+#endif
+	return((float)reading);
+}
+
 float en_read_encoder(uint8_t motor)
 {
-	return((float)en.en[motor].encoder_steps);
+#ifdef __AVR
+	cli();
+#endif
+	int32_t reading = _get_reading(motor);
+#ifdef __AVR
+	sei();
+#endif
+	return (_reading_to_steps(motor, reading));
+}
+
+/*
+ * en_read_encoders() - read all encoders in steps and return the sample number
+ *
+ *	The readings are taken at the end of line segment (sample - 1). Read with
+ *	interrupts off so they all come from the same load.
+ */
+
+uint8_t en_read_encoders(float steps[])
+{
+	int32_t reading[MOTORS];
+	uint8_t motor;
+
+#ifdef __AVR
+	cli();
+#endif
+	uint8_t sample = en.samples;
+	for (motor = MOTOR_1; motor < MOTORS; motor++) {
+		reading[motor] = _get_reading(motor);
+	}
+#ifdef __AVR
+	sei();
+#endif
+	for (motor = MOTOR_1; motor < MOTORS; motor++) {
+		steps[motor] = _reading_to_steps(motor, reading[motor]);
+	}
+	return (sample);
+}
+
+/*
+ * en_sample_counts() - sample the quadrature decoders
+ *
+ *	Called from the loader (HI interrupt level) as each segment is loaded, so the count
+ *	lines up with the completed segment's steps. The 16 bit timer is extended by the
+ *	signed change since the last sample, so it must not move more than 32767 counts
+ *	between loads - which even idle only happens if the axis is pushed by hand.
+ */
+
+void en_sample_counts()
+{
+#ifdef __ENCODER_QDEC
+	uint16_t count = TIMER_QDEC.CNT;
+	en.qdec[0].counts += (int16_t)(count - en.qdec[0].last_count);
+	en.qdec[0].last_count = count;
+#endif
+}
+
+#if (ENCODER_QDEC_CHANNELS > 0)
+static float _get_steps_per_count(uint8_t motor)
+{
+	cfgMotor_t *m = &st_cfg.mot[motor];
+	return ((360 * m->microsteps) / (m->step_angle * en.en[motor].counts_per_rev));
+}
+#endif
+
+/*
+ * en_check_following_error()	 - latch a motor that exceeded its following error limit
+ * en_following_error_callback() - alarm on a latched following error
+ *
+ *	The check runs in the exec for each segment and keeps each motor's peak error for the
+ *	tuning cycle. Only the first motor over its limit is latched and nothing more is
+ *	latched while the machine is alarmed. The callback is a
+ *	controller critical task: it feedholds, reports the motor, its axis and the line, and
+ *	raises a soft alarm. The report is sent ahead of the exception report.
+ */
+
+void en_check_following_error(uint8_t motor, float following_error, uint32_t linenum)
+{
+	float limit = en.en[motor].following_error_limit;
+	float error = fabs(following_error);
+
+	if (error > en.en[motor].peak_error) {
+		en.en[motor].peak_error = error;
+	}
+	if ((limit > 0) && (error > limit) && (en.fault_motor < 0) &&
+		(cm.machine_state != MACHINE_ALARM)) {
+		en.fault_error = following_error;
+		en.fault_linenum = linenum;
+		en.fault_motor = motor;
+	}
+}
+
+stat_t en_following_error_callback()
+{
+	if (en.fault_motor < 0) {
+		return (STAT_NOOP);
+	}
+	uint8_t motor = en.fault_motor;
+	char axis = (ik.axis[motor] < AXES) ? "XYZABC"[ik.axis[motor]] : '-';
+
+	cm_request_feedhold();
+	if (js.json_syntax == JSON_SYNTAX_RELAXED) {
+		printf_P(PSTR("{fe:{mot:%d,axis:\"%c\",ln:%lu,err:%0.0f}}\n"),
+			motor+1, axis, en.fault_linenum, en.fault_error);
+	} else {
+		printf_P(PSTR("{\"fe\":{\"mot\":%d,\"axis\":\"%c\",\"ln\":%lu,\"err\":%0.0f}}\n"),
+			motor+1, axis, en.fault_linenum, en.fault_error);
+	}
+	en.fault_motor = -1;
+	return (cm_soft_alarm(STAT_FOLLOWING_ERROR_EXCEEDED));
+}
+
+/*
+ * en_latch_steps() 		  - latch the step counts of the motors of an axis, or all axes if -1
+ * en_clear_latch()			  - clear the latch for a bitmap of axes
+ * en_get_latched_position()  - get the absolute position of an axis at its latch
+ *
+ *	en_latch_steps() is called from the switch interrupt. The step count of a motor is the
+ *	encoder position plus the steps run in the current segment, which the DDA interrupt
+ *	counts at a higher level, so it is read with interrupts off.
+ *
+ *	en_get_latched_position() is called once the motors have stopped. It takes the steps
+ *	run since the latch back off the runtime position, using the first motor mapped to the
+ *	axis. It returns false if the axis is not latched, has no motor, or the kinematics are
+ *	not Cartesian (a motor's steps are then not a distance along a single axis).
+ */
+
+void en_latch_steps(int8_t axis)
+{
+#ifdef __AVR
+	cli();
+#endif
+	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
+		if ((axis < 0) || (ik.axis[motor] == axis)) {
+			en.en[motor].latch_steps = en.en[motor].encoder_steps + en.en[motor].steps_run;
+		}
+	}
+	en.latched |= ((axis < 0) ? 0xFF : (1 << axis));
+#ifdef __AVR
+	sei();
+#endif
+}
+
+void en_clear_latch(uint8_t axes)
+{
+#ifdef __AVR
+	cli();
+#endif
+	en.latched &= ~axes;
+#ifdef __AVR
+	sei();
+#endif
+}
+
+uint8_t en_get_latched_position(uint8_t axis, float *position)
+{
+	if (((en.latched & (1 << axis)) == 0) || (ik.kinematics != KINEMATICS_CARTESIAN)) {
+		return (false);
+	}
+	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
+		if ((ik.axis[motor] != axis) || (fp_ZERO(ik.steps_per_unit[motor]))) continue;
+#ifdef __AVR
+		cli();
+#endif
+		int32_t steps = en.en[motor].encoder_steps + en.en[motor].steps_run - en.en[motor].latch_steps;
+#ifdef __AVR
+		sei();
+#endif
+		*position = mp_get_runtime_absolute_position(axis) - (float)steps / ik.steps_per_unit[motor];
+		return (true);
+	}
+	return (false);
 }
 
+/*
+ * en_get_spindle_counts() - read the spindle encoder
+ *
+ *	Returns false if the spindle has no encoder. The counts are sampled by the loader as
+ *	for the motors (see en_sample_counts()).
+ */
+
+uint8_t en_get_spindle_counts(int32_t *counts)
+{
+#if (ENCODER_QDEC_CHANNELS > 0)
+	if (en.spindle_channel >= 0) {
+		cli();
+		*counts = en.qdec[en.spindle_channel].counts;
+		sei();
+		return (true);
+	}
+#endif
+	return (false);
+}
+
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
  * Functions to get and set variables from the cfgArray table
  ***********************************************************************************/
 
+/*
+ * en_set_ec() - set motor encoder resolution
+ *
+ *	A non-zero resolution binds the motor to a free quadrature decoder, zero releases it.
+ *	Taken up at the current step count, so the following error starts at zero.
+ */
+
+stat_t en_set_ec(nvObj_t *nv)
+{
+	uint8_t motor = (nv->group[0] ? nv->group[0] : nv->token[0]) - 0x31;
+
+	if (nv->value < 0) {
+		return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	}
+	int8_t channel = en.en[motor].channel;
+	if ((nv->value > 0) && (channel < 0)) {
+		if ((channel = _get_free_channel()) < 0) {
+			return (STAT_COMMAND_NOT_ACCEPTED);	// no encoder hardware left
+		}
+	}
+	set_flt(nv);
+	en.en[motor].channel = (nv->value > 0) ? channel : -1;
+	en_set_encoder_steps(motor, (float)en.en[motor].encoder_steps);
+	return (STAT_OK);
+}
+
+/*
+ * en_set_spindle_ec() - set spindle encoder resolution
+ *
+ *	Binds the spindle to a free quadrature decoder as en_set_ec() does for a motor.
+ */
+
+stat_t en_set_spindle_ec(nvObj_t *nv)
+{
+	if (nv->value < 0) {
+		return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	}
+	int8_t channel = en.spindle_channel;
+	if ((nv->value > 0) && (channel < 0)) {
+		if ((channel = _get_free_channel()) < 0) {
+			return (STAT_COMMAND_NOT_ACCEPTED);
+		}
+	}
+	set_flt(nv);
+	en.spindle_channel = (nv->value > 0) ? channel : -1;
+	return (STAT_OK);
+}
+
+/*
+ * _get_free_channel() - return a quadrature decoder not taken by a motor or the spindle, or -1
+ */
+
+static int8_t _get_free_channel()
+{
+	for (int8_t channel = 0; channel < ENCODER_QDEC_CHANNELS; channel++) {
+		uint8_t m;
+		for (m = MOTOR_1; (m < MOTORS) && (en.en[m].channel != channel); m++);
+		if ((m == MOTORS) && (en.spindle_channel != channel)) {
+			return (channel);
+		}
+	}
+	return (-1);
+}
+
 /***********************************************************************************
  * TEXT MODE SUPPORT
  * Functions to print variables from the cfgArray table
@@ -109,6 +438,26 @@ float en_read_encoder(uint8_t motor)
 
 #ifdef __TEXT_MODE
 
+static const char fmt_0ec[] PROGMEM = "[%s%s] m%s encoder resolution%13.0f counts/rev [0=no encoder]\n";
+static const char fmt_0fl[] PROGMEM = "[%s%s] m%s following error limit%10.0f steps [0=off]\n";
+static const char fmt_0ct[] PROGMEM = "[%s%s] m%s correction threshold%11.2f steps [0=off]\n";
+static const char fmt_0cf[] PROGMEM = "[%s%s] m%s correction factor%14.3f\n";
+static const char fmt_0cm[] PROGMEM = "[%s%s] m%s correction max%17.2f steps per segment\n";
+
+static const char fmt_p1enc[] PROGMEM = "[p1enc] pwm spindle encoder%11.0f counts/rev [0=no encoder]\n";
+
+static void _print_motor_flt(nvObj_t *nv, const char *format)
+{
+	text_printf_P(format, nv->group, nv->token, nv->group, nv->value);
+}
+
+void en_print_ec(nvObj_t *nv) { _print_motor_flt(nv, fmt_0ec);}
+void en_print_fl(nvObj_t *nv) { _print_motor_flt(nv, fmt_0fl);}
+void en_print_ct(nvObj_t *nv) { _print_motor_flt(nv, fmt_0ct);}
+void en_print_cf(nvObj_t *nv) { _print_motor_flt(nv, fmt_0cf);}
+void en_print_cm(nvObj_t *nv) { _print_motor_flt(nv, fmt_0cm);}
+void en_print_p1enc(nvObj_t *nv) { text_print_flt(nv, fmt_p1enc);}
+
 #endif // __TEXT_MODE
 
 #ifdef __cplusplus
@@ -85,6 +85,50 @@
  *	correction will be applied to moveC. (It's possible to recompute the body of moveB, but it may
  *	not be worth the trouble).
  */
+/*
+ * SWITCH LATCH
+ *
+ *	Homing and probing stop on a switch with a feedhold, so the position they read once
+ *	the machine has stopped is past the switch by the deceleration, which depends on speed
+ *	and jerk. To take the position at the switch itself the switch interrupt latches the
+ *	step counts of the motors (en_latch_steps()). Once stopped, the steps run since the
+ *	latch are taken back off the runtime position (en_get_latched_position()).
+ */
+/*
+ * QUADRATURE ENCODERS AND FOLLOWING ERROR
+ *
+ *	With __ENCODER_QDEC enabled a motor with a non-zero encoder resolution ($1ec counts
+ *	per revolution) is read from a real quadrature encoder. The xmega counts the encoder
+ *	in hardware (QDEC through the event system), so the only cost is a sample taken in
+ *	the loader next to ACCUMULATE_ENCODER. The count is then time aligned with the steps
+ *	of the segment that just finished, as the mirrored step count is, and the exec turns
+ *	it into steps for mr.encoder_steps. Motors without an encoder keep mirroring steps.
+ *
+ *	The loader counts the line segments it loads (en.samples) and the exec keeps the
+ *	targets of the segments it preps by the same count (mr.step_history), so the readings
+ *	are compared with the target of the segment they were taken at the end of however
+ *	deep the prep ring is.
+ *
+ *	This board has a single free timer (the unused PWM2 timer) so there is one channel,
+ *	taken by the first motor that asks for it. Phase A goes to PB0 and phase B to PB1.
+ *
+ *	A motor with a following error limit ($1fl steps) raises a soft alarm once its
+ *	following error exceeds the limit - a stalled motor or lost steps. The alarm reports
+ *	the motor, its axis and the line being run, and the machine feedholds. The error reads
+ *	up to a step from rounding plus the steps of one encoder count, so set it well above.
+ *
+ *	With __STEP_CORRECTION the following error is also fed back into the steps (see
+ *	st_prep_line()). A motor whose error exceeds its correction threshold ($1ct steps)
+ *	has the factor ($1cf) of the error taken off the travel of the next segment, limited
+ *	to the correction max ($1cm steps) and to the travel of the segment, so a correction
+ *	never reverses or stops a motor. The next correction waits until the corrected
+ *	segment has been measured, which is the delay of the prep ring, so the loop cannot
+ *	stack corrections on an error it has already taken out. A threshold of 0 is off.
+ *
+ *	The spindle can take the channel instead ($p1enc counts per revolution) for spindle
+ *	synchronized motion (see cm_get_spindle_turns()). Its count of 0 is the index, so
+ *	start the spindle at the same angle for each pass of a thread.
+ */
 #ifndef ENCODER_H_ONCE
 #define ENCODER_H_ONCE
 
@@ -94,12 +138,23 @@ extern "C"{
 
 /**** Configs and Constants ****/
 
+#ifdef __ENCODER_QDEC
+#define ENCODER_QDEC_CHANNELS 1		// hardware quadrature decoders (see encoder.c)
+#else
+#define ENCODER_QDEC_CHANNELS 0
+#endif
+
 /**** Macros ****/
 // used to abstract the encoder code out of the stepper so it can be managed in one place
 
 #define SET_ENCODER_STEP_SIGN(m,s)	en.en[m].step_sign = s;
 #define INCREMENT_ENCODER(m)		en.en[m].steps_run += en.en[m].step_sign;
 #define ACCUMULATE_ENCODER(m)		en.en[m].encoder_steps += en.en[m].steps_run; en.en[m].steps_run = 0;
+#ifdef __ENCODER_QDEC
+#define SAMPLE_ENCODERS()			en.samples++; en_sample_counts();
+#else
+#define SAMPLE_ENCODERS()			en.samples++;
+#endif
 
 /**** Structures ****/
 
@@ -107,11 +162,35 @@ typedef struct enEncoder { 			// one real or virtual encoder per controlled moto
 	int8_t  step_sign;				// set to +1 or -1
 	int16_t steps_run;				// steps counted during stepper interrupt
 	int32_t encoder_steps;			// counted encoder position	in steps
+	int32_t latch_steps;			// step count latched by a switch edge
+	float counts_per_rev;			// encoder resolution; 0 mirrors the step count
+	float following_error_limit;	// following error in steps that raises an alarm; 0 is off
+	float peak_error;				// largest following error in steps since cleared (tuning cycle)
+	float correction_threshold;		// following error in steps that is corrected; 0 is off
+	float correction_factor;		// fraction of the following error corrected at a time
+	float correction_max;			// max steps corrected in a single segment
+	int8_t channel;					// quadrature decoder channel or -1 if none
+	float count_offset;				// steps at a count of 0 (see en_set_encoder_steps())
 } enEncoder_t;
 
+typedef struct enQdecChannel {		// one per hardware quadrature decoder
+	uint16_t last_count;			// timer count at the last sample
+	int32_t counts;					// counts extended to 32 bits
+} enQdecChannel_t;
+
 typedef struct enEncoders {
 	magic_t magic_start;
 	enEncoder_t en[MOTORS];			// runtime encoder structures
+	volatile uint8_t latched;		// bitmap of axes with a latched step count
+	volatile uint8_t samples;		// line segments loaded, modulo 256 (see mr.step_sample)
+	int8_t fault_motor;				// motor that exceeded its following error limit or -1
+	float fault_error;				// its following error in steps
+	uint32_t fault_linenum;			// line being run when it did
+	float spindle_counts_per_rev;	// spindle encoder resolution; 0 is no encoder
+	int8_t spindle_channel;			// quadrature decoder channel of the spindle or -1 if none
+#if (ENCODER_QDEC_CHANNELS > 0)
+	enQdecChannel_t qdec[ENCODER_QDEC_CHANNELS];
+#endif
 	magic_t magic_end;
 } enEncoders_t;
 
@@ -126,6 +205,39 @@ stat_t encoder_test_assertions(void);
 
 void en_set_encoder_steps(uint8_t motor, float steps);
 float en_read_encoder(uint8_t motor);
+uint8_t en_read_encoders(float steps[]);
+
+void en_latch_steps(int8_t axis);
+void en_clear_latch(uint8_t axes);
+uint8_t en_get_latched_position(uint8_t axis, float *position);
+
+void en_sample_counts(void);
+void en_check_following_error(uint8_t motor, float following_error, uint32_t linenum);
+stat_t en_following_error_callback(void);
+uint8_t en_get_spindle_counts(int32_t *counts);
+
+stat_t en_set_ec(nvObj_t *nv);
+stat_t en_set_spindle_ec(nvObj_t *nv);
+
+#ifdef __TEXT_MODE
+
+	void en_print_ec(nvObj_t *nv);
+	void en_print_fl(nvObj_t *nv);
+	void en_print_ct(nvObj_t *nv);
+	void en_print_cf(nvObj_t *nv);
+	void en_print_cm(nvObj_t *nv);
+	void en_print_p1enc(nvObj_t *nv);
+
+#else
+
+	#define en_print_ec tx_print_stub
+	#define en_print_fl tx_print_stub
+	#define en_print_ct tx_print_stub
+	#define en_print_cf tx_print_stub
+	#define en_print_cm tx_print_stub
+	#define en_print_p1enc tx_print_stub
+
+#endif // __TEXT_MODE
 
 #endif	// End of include guard: ENCODER_H_ONCE
 
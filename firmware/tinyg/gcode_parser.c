@@ -21,8 +21,11 @@
 #include "controller.h"
 #include "gcode_parser.h"
 #include "canonical_machine.h"
+#include "planner.h"
 #include "spindle.h"
+#include "report.h"
 #include "util.h"
+#include "perf.h"
 #include "xio.h"			// for char definitions
 
 #ifdef __cplusplus
@@ -31,15 +34,84 @@ extern "C"{
 
 struct gcodeParserSingleton {	 	  // struct to manage globals
 	uint8_t modals[MODAL_GROUP_COUNT];// collects modal groups in a block
+	uint8_t axis_words;				  // X, Y, Z, A, B and C words in the block
+	uint8_t other_words;			  // all other words - any of these rule out the fast path
+	uint16_t record_wr;				  // cache index for the next word when recording a block
+	uint8_t assignments;			  // parameter settings in the block - see _apply_assignments()
+	uint16_t assign_number[GC_ASSIGNMENTS];
+	float assign_value[GC_ASSIGNMENTS];
 }; struct gcodeParserSingleton gp;
 
+enum gcodeRecordState {
+	O_RECORD_OFF = 0,				  // blocks are run as they arrive
+	O_RECORD_SUB,					  // blocks are stored in a subroutine (o.. sub)
+	O_RECORD_REPEAT					  // blocks are stored in a loop body (o.. repeat)
+};
+
+struct gcodeSubroutine {			  // a subroutine stored in the block cache
+	uint16_t number;				  // O number
+	uint16_t start;					  // cache index of the first block
+	uint16_t end;					  // cache index past the last block
+};
+
+struct gcodeCacheSingleton {		  // O word subroutines and loops - see _parse_o_word()
+	uint8_t record_state;			  // see gcodeRecordState
+	uint8_t overflow;				  // a block of the sub or loop being recorded did not fit
+	uint16_t number;				  // O number of the sub or loop being recorded
+	uint16_t loop_start;			  // cache index of the loop body being recorded
+	uint16_t loop_count;			  // times to run the loop being recorded
+	uint16_t wr;					  // cache index past the last stored block
+	uint8_t sub_count;				  // subroutines defined
+	struct gcodeSubroutine sub[O_WORD_SUBROUTINES];
+
+	uint16_t repeats;				  // replays still to run (0 = not replaying)
+	uint16_t rd;					  // cache index of the next block to replay
+	uint16_t replay_start;			  // blocks being replayed
+	uint16_t replay_end;
+	uint8_t replay_discard;			  // drop the blocks when done (loop bodies)
+	const uint8_t *program_P;		  // next block of the stored program being run (NULL if none)
+	uint8_t block[PGM_BLOCK_SIZE];	  // stored program block copied out of program memory
+	uint8_t cache[O_WORD_CACHE_SIZE]; // blocks: word slot count, then 5 byte words (letter, float) or code
+}; static struct gcodeCacheSingleton oc;
+
+struct gcodeReadAheadSingleton {	  // blocks parsed while the planner is full - see gc_read_ahead_callback()
+	uint8_t filling;				  // TRUE while a block is being parsed into the FIFO
+	uint8_t blocks;					  // blocks waiting to run
+	uint8_t rd;						  // index of the next block to run
+	uint8_t wr;						  // index past the last block stored
+	uint8_t slot;					  // index of the block being parsed
+	uint8_t word_wr;				  // index for the next word of the block being parsed
+	uint8_t buf[GC_READ_AHEAD_SIZE];  // blocks: word count, then 5 byte words (letter, float)
+}; static struct gcodeReadAheadSingleton ra;
+
 // local helper functions and macros
-static void _normalize_gcode_block(char_t *str, char_t **com, char_t **msg, uint8_t *block_delete_flag);
-static stat_t _get_next_gcode_word(char **pstr, char *letter, float *value);
+static void _get_gcode_message(const char_t *com);
 static stat_t _point(float value);
 static stat_t _validate_gcode_block(void);
 static stat_t _parse_gcode_block(char_t *line);	// Parse the block into the GN/GF structs
+static stat_t _parse_error(stat_t status);
+static void _reset_gcode_block(void);
+static stat_t _parse_gcode_word(char letter, float value);
+static stat_t _load_gcode_word(char letter, float value);
+static stat_t _record_gcode_block(void);
+static stat_t _parse_o_word(char_t *buf);
+static stat_t _compile_value(char_t *str, char_t **end);
+static stat_t _evaluate(const uint8_t *code, uint8_t len, float *value);
+static stat_t _parse_expression_word(char letter, char_t *str, char_t **end);
+static stat_t _parse_assignment(char_t *str, char_t **end);
+static void _apply_assignments(void);
+static stat_t _record_expression_word(char letter, uint16_t number);
+static uint8_t _stored_word_slots(const uint8_t *word);
+static stat_t _run_stored_word(const uint8_t *word);
+static uint8_t _decode_gcode_frame(char_t *str);
+static int16_t _read_ahead_slot(const char_t *block);
+static stat_t _read_ahead_gcode_block(char_t *block);
+static stat_t _queue_read_ahead_block(void);
+static uint8_t _is_message(const char_t *com);
+static uint8_t _word_headroom(char letter, uint8_t number);
+static uint8_t _stored_block_headroom(const uint8_t *block);
 static stat_t _execute_gcode_block(void);		// Execute the gcode block
+static stat_t _fast_forward_gcode_block(void);	// Apply a block to the model only ($ff)
 
 #define SET_MODAL(m,parm,val) ({cm.gn.parm=val; cm.gf.parm=1; gp.modals[m]+=1; break;})
 #define SET_NON_MODAL(parm,val) ({cm.gn.parm=val; cm.gf.parm=1; break;})
@@ -48,152 +120,102 @@ static stat_t _execute_gcode_block(void);		// Execute the gcode block
 /*
  * gc_gcode_parser() - parse a block (line) of gcode
  *
- *	Top level of gcode parser. Normalizes block and looks for special cases
+ *	Top level of gcode parser. Looks for special cases and hands the block to the tokenizer
  */
 stat_t gc_gcode_parser(char_t *block)
 {
-	char_t *str = block;					// gcode command or NUL string
-	char_t none = NUL;
-	char_t *com = &none;					// gcode comment or NUL string
-	char_t *msg = &none;					// gcode message or NUL string
-	uint8_t block_delete_flag;
-
 	// don't process Gcode blocks if in alarmed state
 	if (cm.machine_state == MACHINE_ALARM) return (STAT_MACHINE_ALARMED);
-
-	_normalize_gcode_block(str, &com, &msg, &block_delete_flag);
+	if ((cm.cycle_state == CYCLE_JOG) || (cm.cycle_state == CYCLE_TUNE))
+		return (STAT_COMMAND_NOT_ACCEPTED);	// not until a velocity jog or tuning cycle ends
 
 	// Block delete omits the line if a / char is present in the first space
 	// For now this is unconditional and will always delete
-//	if ((block_delete_flag == true) && (cm_get_block_delete_switch() == true)) {
-	if (block_delete_flag == true) {
+//	if ((*block == '/') && (cm_get_block_delete_switch() == true)) {
+	if (*block == '/') {
 		return (STAT_NOOP);
 	}
-
-	// queue a "(MSG" response
-	if (*msg != NUL) {
-		(void)cm_message(msg);				// queue the message
+	if ((gc_reading_ahead() == true) ||			// the planner is full - parse it now, run it later
+		(mp_planner_has_headroom(gc_block_headroom(block)) == false)) {
+		return (_read_ahead_gcode_block(block));
+	}
+	char_t *rd = block;
+	while (isspace((char)*rd)) { rd++; }
+	if ((*rd == 'o') || (*rd == 'O')) {			// O word subroutine or loop statement
+		return (_parse_o_word(rd+1));
 	}
-
 	return(_parse_gcode_block(block));
 }
 
 /*
- * _normalize_gcode_block() - normalize a block (line) of gcode in place
- *
- *	Normalization functions:
- *   - convert all letters to upper case
- *	 - remove white space, control and other invalid characters
- *	 - remove (erroneous) leading zeros that might be taken to mean Octal
- *	 - identify and return start of comments and messages
- *	 - signal if a block-delete character (/) was encountered in the first space
- *
- *	So this: "  g1 x100 Y100 f400" becomes this: "G1X100Y100F400"
+ * gc_gcode_frame_parser() - parse a pre-tokenized (binary) block of gcode
  *
- *	Comment and message handling:
- *	 - Comments field start with a '(' char or alternately a semicolon ';'
- *	 - Comments and messages are not normalized - they are left alone
- *	 - The 'MSG' specifier in comment can have mixed case but cannot cannot have embedded white spaces
- *	 - Normalization returns true if there was a message to display, false otherwise
- *	 - Comments always terminate the block - i.e. leading or embedded comments are not supported
- *	 	- Valid cases (examples)			Notes:
- *		    G0X10							 - command only - no comment
- *		    (comment text)                   - There is no command on this line
- *		    G0X10 (comment text)
- *		    G0X10 (comment text				 - It's OK to drop the trailing paren
- *		    G0X10 ;comment text				 - It's OK to drop the trailing paren
+ *	A host that has already tokenized its Gcode can send blocks as frames. The words go
+ *	straight into the GN/GF structs, skipping tokenizing and number conversion.
+ *	A frame is a single line that starts with STX (the STX is stripped by the caller):
  *
- *	 	- Invalid cases (examples)			Notes:
- *		    G0X10 comment text				 - Comment with no separator
- *		    N10 (comment) G0X10 			 - embedded comment. G0X10 will be ignored
- *		    (comment) G0X10 				 - leading comment. G0X10 will be ignored
- * 			G0X10 # comment					 - invalid separator
+ *	  - payload is a list of 5 byte words: letter (uppercase ASCII) and value (IEEE 754
+ *		float, little-endian), then the CRC-16/CCITT of the words (little-endian) - see
+ *		compute_crc16()
+ *	  - payload is sent 6 bits per char as '0' + bits ('0' to 'o'), first bits first.
+ *		4 chars carry 3 bytes, leftover bits at the end are dropped. This keeps frames
+ *		7 bit clean and clear of the line end, signal and flow control characters
  *
- *	Returns:
- *	 - com points to comment string or to NUL if no comment
- *	 - msg points to message string or to NUL if no comment
- *	 - block_delete_flag is set true if block delete encountered, false otherwise
+ *	Frames carry no comments, messages or block deletes - the host deals with those.
  */
-
-static void _normalize_gcode_block(char_t *str, char_t **com, char_t **msg, uint8_t *block_delete_flag)
+stat_t gc_gcode_frame_parser(char_t *frame)
 {
-	char_t *rd = str;				// read pointer
-	char_t *wr = str;				// write pointer
-
-	// Preset comments and messages to NUL string
-	// Not required if com and msg already point to NUL on entry
-//	for (rd = str; *rd != NUL; rd++) { if (*rd == NUL) { *com = rd; *msg = rd; rd = str;} }
+	stat_t status = STAT_OK;
 
-	// mark block deletes
-	if (*rd == '/') { *block_delete_flag = true; }
-	else { *block_delete_flag = false; }
+	// don't process Gcode blocks if in alarmed state
+	if (cm.machine_state == MACHINE_ALARM) return (STAT_MACHINE_ALARMED);
+	if ((cm.cycle_state == CYCLE_JOG) || (cm.cycle_state == CYCLE_TUNE))
+		return (STAT_COMMAND_NOT_ACCEPTED);	// not until a velocity jog or tuning cycle ends
 
-	// normalize the command block & find the comment (if any)
-	for (; *wr != NUL; rd++) {
-		if (*rd == NUL) { *wr = NUL; }
-		else if ((*rd == '(') || (*rd == ';')) { *wr = NUL; *com = rd+1; }
-		else if ((isalnum((char)*rd)) || (strchr("-.", *rd))) { // all valid characters
-			*(wr++) = (char_t)toupper((char)*(rd));
-		}
+	uint8_t len = _decode_gcode_frame(frame);
+	if ((len < 2) || (((len-2) % 5) != 0)) {
+		return (STAT_GCODE_FRAME_MALFORMED);
 	}
-
-	// Perform Octal stripping - remove invalid leading zeros in number strings
-	rd = str;
-	while (*rd != NUL) {
-		if (*rd == '.') break;							// don't strip past a decimal point
-		if ((!isdigit(*rd)) && (*(rd+1) == '0') && (isdigit(*(rd+2)))) {
-			wr = rd+1;
-			while (*wr != NUL) { *wr = *(wr+1); wr++;}	// copy forward w/overwrite
-			continue;
-		}
-		rd++;
+	len -= 2;
+	uint8_t *buf = (uint8_t *)frame;
+	if (compute_crc16(buf, len) != (buf[len] | (buf[len+1] << 8))) {
+		return (STAT_GCODE_FRAME_CRC_ERROR);
 	}
 
-	// process comments and messages
-	if (**com != NUL) {
-		rd = *com;
-		while (isspace(*rd)) { rd++; }		// skip any leading spaces before "msg"
-		if ((tolower(*rd) == 'm') && (tolower(*(rd+1)) == 's') && (tolower(*(rd+2)) == 'g')) {
-			*msg = rd+3;
-		}
-		for (; *rd != NUL; rd++) {
-			if (*rd == ')') *rd = NUL;		// NUL terminate on trailing parenthesis, if any
-		}
+	_reset_gcode_block();
+	for (uint8_t i=0; i<len; i+=5) {
+		float value;
+		if (isupper(buf[i]) == false) return (STAT_INVALID_OR_MALFORMED_COMMAND);
+		memcpy(&value, &buf[i+1], sizeof(float));
+		if ((status = _load_gcode_word((char)buf[i], value)) != STAT_OK) return (status);
 	}
+	if (oc.record_state != O_RECORD_OFF) return (_record_gcode_block());
+	ritorno(_validate_gcode_block());
+	return (_execute_gcode_block());
 }
 
 /*
- * _get_next_gcode_word() - get gcode word consisting of a letter and a value
+ * _decode_gcode_frame() - unpack the 6 bit chars of a frame in place and return the byte count
  *
- *	This function requires the Gcode string to be normalized.
- *	Normalization must remove any leading zeros or they will be converted to Octal
- *	G0X... is not interpreted as hexadecimal. This is trapped.
+ *	Returns 0 (an invalid frame) if a char is out of range.
  */
-static stat_t _get_next_gcode_word(char **pstr, char *letter, float *value)
+static uint8_t _decode_gcode_frame(char_t *str)
 {
-	if (**pstr == NUL)
-        return (STAT_COMPLETE);    // no more words to process
+	uint8_t *wr = (uint8_t *)str;
+	uint16_t bits = 0;
+	uint8_t bit_count = 0;
 
-	// get letter part
-	if(isupper(**pstr) == false)
-        return (STAT_INVALID_OR_MALFORMED_COMMAND);
-	*letter = **pstr;
-	(*pstr)++;
-
-	// X-axis-becomes-a-hexadecimal-number get-value case, e.g. G0X100 --> G255
-	if ((**pstr == '0') && (*(*pstr+1) == 'X')) {
-		*value = 0;
-		(*pstr)++;
-		return (STAT_OK);		// pointer points to X
+	for (char_t *rd = str; *rd != NUL; rd++) {
+		uint8_t c = (uint8_t)*rd - '0';		// chars below '0' wrap round and fail too
+		if (c > 0x3F) return (0);
+		bits = (bits << 6) | c;
+		if ((bit_count += 6) >= 8) {
+			bit_count -= 8;
+			*wr++ = (uint8_t)(bits >> bit_count);
+			bits &= (1 << bit_count) - 1;
+		}
 	}
-
-	// get-value general case
-	char *end;
-	*value = strtof(*pstr, &end);
-	if(end == *pstr)
-        return(STAT_BAD_NUMBER_FORMAT); // more robust test then checking for value=0;
-	*pstr = end;
-	return (STAT_OK);			// pointer points to next character after the word
+	return (wr - (uint8_t *)str);
 }
 
 /*
@@ -231,180 +253,385 @@ static stat_t _validate_gcode_block()
 
 /*
  * _parse_gcode_block() - parses one line of NULL terminated G-Code.
+ * _parse_error()		- count a block that failed to parse or validate (pfpe), return its status
+ *
+ *	Single pass tokenizer. Words, comments and messages are picked out by gc_next_word()
+ *	as the block is scanned and each word is loaded straight into gn (next model state)
+ *	and gf (model state flags). The block is never written, so an error can echo it as it
+ *	was sent. The execute routine applies the words once the whole block is read.
+ *
+ *	  - letters can have either case; white space and other invalid characters are skipped
+ *	  - values are read as decimal by parse_float() - leading zeros are not Octal and
+ *		G0X... is not taken to be hexadecimal
+ *	  - a value that is not a number is compiled as a parameter or expression, and #n=...
+ *		sets a parameter (see _compile_value())
+ *	  - a number with no letter is an error
+ *
+ *	Comment and message handling:
+ *	 - Comments field start with a '(' char or alternately a semicolon ';'
+ *	 - The 'MSG' specifier in comment can have mixed case but cannot cannot have embedded white spaces
+ *	 - Comments always terminate the block - i.e. leading or embedded comments are not supported
+ *	 	- Valid cases (examples)			Notes:
+ *		    G0X10							 - command only - no comment
+ *		    (comment text)                   - There is no command on this line
+ *		    G0X10 (comment text)
+ *		    G0X10 (comment text				 - It's OK to drop the trailing paren
+ *		    G0X10 ;comment text				 - It's OK to drop the trailing paren
  *
- *	All the parser does is load the state values in gn (next model state) and set flags
- *	in gf (model state flags). The execute routine applies them. The buffer is assumed to
- *	contain only uppercase characters and signed floats (no whitespace).
+ *	 	- Invalid cases (examples)			Notes:
+ *		    G0X10 comment text				 - Comment with no separator
+ *		    N10 (comment) G0X10 			 - embedded comment. G0X10 will be ignored
+ *		    (comment) G0X10 				 - leading comment. G0X10 will be ignored
+ * 			G0X10 # comment					 - invalid separator
  *
  *	A number of implicit things happen when the gn struct is zeroed:
  *	  - inverse feed rate mode is canceled - set back to units_per_minute mode
  */
 static stat_t _parse_gcode_block(char_t *buf)
 {
-	char *pstr = (char *)buf;		// persistent pointer into gcode block for parsing words
-  	char letter;					// parsed letter, eg.g. G or X or Y
-	float value = 0;				// value parsed from letter (e.g. 2 for G2)
+	char_t *rd = buf;				// read pointer into gcode block
+	char letter;
+	float value;
+	uint8_t token;
 	stat_t status = STAT_OK;
 
-	// set initial state for new move
+	_reset_gcode_block();
+
+	// extract commands and parameters
+	while ((token = gc_next_word(&rd, &letter, &value)) != GC_TOKEN_END) {
+		switch (token) {
+			case GC_TOKEN_WORD: { status = _load_gcode_word(letter, value); break;}
+			case GC_TOKEN_EXPRESSION: { status = _parse_expression_word(letter, rd, &rd); break;}
+			case GC_TOKEN_ASSIGNMENT: { status = _parse_assignment(rd, &rd); break;}
+			case GC_TOKEN_BAD: { status = STAT_INVALID_OR_MALFORMED_COMMAND; break;}
+		}
+		if (status != STAT_OK)
+			return (_parse_error(status));
+		if (token == GC_TOKEN_MESSAGE) {
+			if (oc.record_state == O_RECORD_OFF)
+				_get_gcode_message(rd);					// messages are not stored in subs and loops
+			break;
+		}
+	}
+	if (oc.record_state != O_RECORD_OFF) return (_record_gcode_block());
+	if (ra.filling == true) return (_queue_read_ahead_block());
+	_apply_assignments();
+	if ((status = _validate_gcode_block()) != STAT_OK)
+		return (_parse_error(status));
+	return (_execute_gcode_block());		// if successful execute the block
+}
+
+/*
+ * gc_next_word() - find the next token of a block and step over it
+ *
+ *	This is the tokenizer of _parse_gcode_block(). It is also used by the host tools that
+ *	tokenize Gcode ahead of time (sim/sim_frame.c), so frames and stored programs read a
+ *	block the same way the parser does. White space and other invalid chars are skipped.
+ *	On return str points past the token, except:
+ *
+ *	  - GC_TOKEN_EXPRESSION	str is at the value, letter is set
+ *	  - GC_TOKEN_ASSIGNMENT	str is after the #
+ *	  - GC_TOKEN_MESSAGE	str is after the comment char
+ *	  - GC_TOKEN_BAD		str is at the number
+ */
+uint8_t gc_next_word(char_t **str, char *letter, float *value)
+{
+	char_t *rd = *str;
+	char_t *end;
+
+	for (; *rd != NUL; rd++) {
+		if ((*rd == '(') || (*rd == ';')) {				// comments terminate the block
+			*str = rd+1;
+			return (_is_message(rd+1) ? GC_TOKEN_MESSAGE : GC_TOKEN_END);
+		}
+		if (isalpha((char)*rd)) {						// a word: letter and value
+			*letter = (char)toupper((char)*rd);
+			*value = parse_float(rd+1, &end);
+			if (end == rd+1) {
+				*str = rd+1;
+				return (GC_TOKEN_EXPRESSION);			// parameter or expression
+			}
+			*str = end;
+			return (GC_TOKEN_WORD);
+		}
+		if (*rd == '#') {
+			*str = rd+1;
+			return (GC_TOKEN_ASSIGNMENT);
+		}
+		if ((isdigit((char)*rd)) || (*rd == '-') || (*rd == '.')) {
+			*str = rd;
+			return (GC_TOKEN_BAD);						// value with no letter
+		}
+	}
+	*str = rd;
+	return (GC_TOKEN_END);
+}
+
+static stat_t _parse_error(stat_t status)
+{
+	PERF_COUNT(PERF_PARSE_ERROR);
+	return (status);
+}
+
+/*
+ * _get_gcode_message() - queue the message in a comment, if there is one
+ *
+ *	The message is the text after MSG up to a closing paren or the end of the line.
+ *	It is copied out so the block is left alone.
+ */
+static void _get_gcode_message(const char_t *com)
+{
+	while (isspace((char)*com)) { com++; }		// skip any leading spaces before "msg"
+	if ((tolower(*com) != 'm') || (tolower(*(com+1)) != 's') || (tolower(*(com+2)) != 'g')) {
+		return;
+	}
+	com += 3;
+	uint8_t i = 0;
+	while ((com[i] != NUL) && (com[i] != ')') && (i < MESSAGE_LEN-1)) {
+		global_string_buf[i] = com[i];
+		i++;
+	}
+	global_string_buf[i] = NUL;
+	cm_message(global_string_buf);				// queue the message
+}
+
+/*
+ * _reset_gcode_block() - set initial state for new move
+ */
+static void _reset_gcode_block()
+{
 	memset(&gp, 0, sizeof(gp));						// clear all parser values
+	gp.record_wr = oc.wr + 1;						// leave room for the word count if recording
 	memset(&cm.gf, 0, sizeof(GCodeInput_t));		// clear all next-state flags
 	memset(&cm.gn, 0, sizeof(GCodeInput_t));		// clear all next-state values
 	cm.gn.motion_mode = cm_get_motion_mode(MODEL);	// get motion mode from previous block
+}
 
-	// extract commands and parameters
-	while((status = _get_next_gcode_word(&pstr, &letter, &value)) == STAT_OK) {
-		switch(letter) {
-			case 'G':
-			switch((uint8_t)value) {
-				case 0:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_TRAVERSE);
-				case 1:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_FEED);
-				case 2:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CW_ARC);
-				case 3:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CCW_ARC);
-				case 4:  SET_NON_MODAL (next_action, NEXT_ACTION_DWELL);
-				case 10: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_COORD_DATA);
-				case 17: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XY);
-				case 18: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XZ);
-				case 19: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_YZ);
-				case 20: SET_MODAL (MODAL_GROUP_G6, units_mode, INCHES);
-				case 21: SET_MODAL (MODAL_GROUP_G6, units_mode, MILLIMETERS);
-				case 28: {
-					switch (_point(value)) {
-						case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G28_POSITION);
-						case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G28_POSITION);
-						case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SEARCH_HOME);
-						case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ABSOLUTE_ORIGIN);
-						case 4: SET_NON_MODAL (next_action, NEXT_ACTION_HOMING_NO_SET);
-						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-					}
-					break;
+/*
+ * _parse_gcode_word() - load one word (letter and value) into the GN/GF structs
+ */
+static stat_t _parse_gcode_word(char letter, float value)
+{
+	stat_t status = STAT_OK;
+
+	if (((letter >= 'X') && (letter <= 'Z')) || ((letter >= 'A') && (letter <= 'C'))) {
+		gp.axis_words++;
+	} else {
+		gp.other_words++;
+	}
+
+	switch(letter) {
+		case 'G':
+		switch((uint8_t)value) {
+			case 0:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_TRAVERSE);
+			case 1:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_FEED);
+			case 2:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CW_ARC);
+			case 3:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CCW_ARC);
+			case 4:  SET_NON_MODAL (next_action, NEXT_ACTION_DWELL);
+			case 5: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CUBIC_SPLINE);
+					case 1: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_QUADRATIC_SPLINE);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+				}
+				break;
+			}
+			case 33: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_SPINDLE_SYNC);
+					case 1: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_RIGID_TAP);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+				}
+				break;
+			}
+			case 10: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_COORD_DATA);
+			case 11: SET_NON_MODAL (next_action, NEXT_ACTION_UNRETRACT);
+			case 17: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XY);
+			case 18: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XZ);
+			case 19: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_YZ);
+			case 20: SET_MODAL (MODAL_GROUP_G6, units_mode, INCHES);
+			case 21: SET_MODAL (MODAL_GROUP_G6, units_mode, MILLIMETERS);
+			case 28: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G28_POSITION);
+					case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G28_POSITION);
+					case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SEARCH_HOME);
+					case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ABSOLUTE_ORIGIN);
+					case 4: SET_NON_MODAL (next_action, NEXT_ACTION_HOMING_NO_SET);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 				}
-				case 30: {
-					switch (_point(value)) {
-						case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G30_POSITION);
-						case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G30_POSITION);
-						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-					}
-					break;
+				break;
+			}
+			case 29: {
+				switch (_point(value)) {
+					case 0: SET_NON_MODAL (next_action, NEXT_ACTION_PROBE_GRID);
+					case 1: SET_NON_MODAL (next_action, NEXT_ACTION_CLEAR_PROBE_GRID);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+				}
+				break;
+			}
+			case 30: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G30_POSITION);
+					case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G30_POSITION);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+				}
+				break;
+			}
+			case 38: {
+				switch (_point(value)) {
+					case 2: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE);
+					case 3: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR);
+					case 4: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY);
+					case 5: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 				}
-				case 38: {
-					switch (_point(value)) {
-						case 2: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE);
-						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-					}
-					break;
+				break;
+			}
+			case 40: SET_MODAL (MODAL_GROUP_G7, cutter_comp, CUTTER_COMP_OFF);
+			case 41: SET_MODAL (MODAL_GROUP_G7, cutter_comp, CUTTER_COMP_LEFT);
+			case 42: SET_MODAL (MODAL_GROUP_G7, cutter_comp, CUTTER_COMP_RIGHT);
+			case 43: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G8, tool_length_mode, true);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 				}
-				case 40: break;	// ignore cancel cutter radius compensation
-				case 49: break;	// ignore cancel tool length offset comp.
-				case 53: SET_NON_MODAL (absolute_override, true);
-				case 54: SET_MODAL (MODAL_GROUP_G12, coord_system, G54);
-				case 55: SET_MODAL (MODAL_GROUP_G12, coord_system, G55);
-				case 56: SET_MODAL (MODAL_GROUP_G12, coord_system, G56);
-				case 57: SET_MODAL (MODAL_GROUP_G12, coord_system, G57);
-				case 58: SET_MODAL (MODAL_GROUP_G12, coord_system, G58);
-				case 59: SET_MODAL (MODAL_GROUP_G12, coord_system, G59);
-				case 61: {
-					switch (_point(value)) {
-						case 0: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_PATH);
-						case 1: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_STOP);
-						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-					}
-					break;
+				break;
+			}
+			case 49: SET_MODAL (MODAL_GROUP_G8, tool_length_mode, false);
+			case 50: SET_NON_MODAL (next_action, NEXT_ACTION_CANCEL_SCALING);
+			case 51: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_SCALING);
+			case 53: SET_NON_MODAL (absolute_override, true);
+			case 54: SET_MODAL (MODAL_GROUP_G12, coord_system, G54);
+			case 55: SET_MODAL (MODAL_GROUP_G12, coord_system, G55);
+			case 56: SET_MODAL (MODAL_GROUP_G12, coord_system, G56);
+			case 57: SET_MODAL (MODAL_GROUP_G12, coord_system, G57);
+			case 58: SET_MODAL (MODAL_GROUP_G12, coord_system, G58);
+			case 59: SET_MODAL (MODAL_GROUP_G12, coord_system, G59);
+			case 61: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_PATH);
+					case 1: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_STOP);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 				}
-				case 64: SET_MODAL (MODAL_GROUP_G13,path_control, PATH_CONTINUOUS);
-				case 80: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANCEL_MOTION_MODE);
+				break;
+			}
+			case 64: SET_MODAL (MODAL_GROUP_G13,path_control, PATH_CONTINUOUS);
+			case 68: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_ROTATION);
+			case 69: SET_NON_MODAL (next_action, NEXT_ACTION_CANCEL_ROTATION);
+			case 73: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_73);
+			case 80: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANCEL_MOTION_MODE);
+			case 81: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_81);
+			case 82: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_82);
+			case 83: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_83);
 //				case 90: SET_MODAL (MODAL_GROUP_G3, distance_mode, ABSOLUTE_MODE);
 //				case 91: SET_MODAL (MODAL_GROUP_G3, distance_mode, INCREMENTAL_MODE);
-				case 90: {
+			case 90: {
     				switch (_point(value)) {
         				case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, ABSOLUTE_MODE);
         				case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, ABSOLUTE_MODE);
         				default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
     				}
     				break;
-				}
-				case 91: {
+			}
+			case 91: {
     				switch (_point(value)) {
         				case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, INCREMENTAL_MODE);
         				case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, INCREMENTAL_MODE);
         				default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
     				}
     				break;
+			}
+			case 92: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_ORIGIN_OFFSETS);
+					case 1: SET_NON_MODAL (next_action, NEXT_ACTION_RESET_ORIGIN_OFFSETS);
+					case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS);
+					case 3: SET_NON_MODAL (next_action, NEXT_ACTION_RESUME_ORIGIN_OFFSETS);
+					default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 				}
-				case 92: {
-					switch (_point(value)) {
-						case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_ORIGIN_OFFSETS);
-						case 1: SET_NON_MODAL (next_action, NEXT_ACTION_RESET_ORIGIN_OFFSETS);
-						case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS);
-						case 3: SET_NON_MODAL (next_action, NEXT_ACTION_RESUME_ORIGIN_OFFSETS);
-						default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-					}
-					break;
-				}
-				case 93: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, INVERSE_TIME_MODE);
-				case 94: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_MINUTE_MODE);
-//				case 95: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_REVOLUTION_MODE);
-				default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+				break;
 			}
-			break;
+			case 93: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, INVERSE_TIME_MODE);
+			case 94: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_MINUTE_MODE);
+			case 96: SET_MODAL (MODAL_GROUP_G14, spindle_css_mode, true);
+			case 97: SET_MODAL (MODAL_GROUP_G14, spindle_css_mode, false);
+//				case 95: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_REVOLUTION_MODE);
+			case 98: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_INITIAL_LEVEL);
+			case 99: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_R_PLANE);
+			case 187: SET_NON_MODAL (preset_select, true);			// machining preset in P
+			default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+		}
+		break;
 
-			case 'M':
-			switch((uint16_t)value) {
-				case 0: case 1: case 60:
-						SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_STOP);
-				case 2: case 30:
-						SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_END);
-				case 3: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_CW);
-				case 4: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_CCW);
-				case 5: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_OFF);
-				case 6: SET_NON_MODAL (tool_change, true);
-				case 7: SET_MODAL (MODAL_GROUP_M8, mist_coolant, true);
-				case 8: SET_MODAL (MODAL_GROUP_M8, flood_coolant, true);
-				case 9: SET_MODAL (MODAL_GROUP_M8, flood_coolant, false);
-				case 48: SET_MODAL (MODAL_GROUP_M9, override_enables, true);
-				case 49: SET_MODAL (MODAL_GROUP_M9, override_enables, false);
-				case 50: SET_MODAL (MODAL_GROUP_M9, feed_rate_override_enable, true); // conditionally true
-				case 51: SET_MODAL (MODAL_GROUP_M9, spindle_override_enable, true);	  // conditionally true
-				case 114: SET_NON_MODAL (next_action, NEXT_ACTION_GET_POSITION);
-				case 115: SET_NON_MODAL (next_action, NEXT_ACTION_GET_FIRMWARE);
-				case 201: {
-					switch (_point(value)) { 
-						case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_JERK);
-						default: status = STAT_MCODE_COMMAND_UNSUPPORTED; 
-					}
-					break;
+		case 'M':
+		switch((uint16_t)value) {
+			case 0: case 1: case 60:
+					SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_STOP);
+			case 2: case 30:
+					SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_END);
+			case 3: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_CW);
+			case 4: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_CCW);
+			case 5: SET_MODAL (MODAL_GROUP_M7, spindle_mode, SPINDLE_OFF);
+			case 6: SET_NON_MODAL (tool_change, true);
+			case 7: SET_MODAL (MODAL_GROUP_M8, mist_coolant, true);
+			case 8: SET_MODAL (MODAL_GROUP_M8, flood_coolant, true);
+			case 9: SET_MODAL (MODAL_GROUP_M8, flood_coolant, false);
+			case 48: SET_MODAL (MODAL_GROUP_M9, override_enables, true);
+			case 49: SET_MODAL (MODAL_GROUP_M9, override_enables, false);
+			case 50: {
+				switch (_point(value)) {
+					case 0: SET_MODAL (MODAL_GROUP_M9, feed_rate_override_enable, true); // conditionally true
+					case 1: SET_MODAL (MODAL_GROUP_M9, feed_rate_override_factor, true);
+					case 2: SET_MODAL (MODAL_GROUP_M9, traverse_override_enable, true); // conditionally true
+					case 3: SET_MODAL (MODAL_GROUP_M9, traverse_override_factor, true);
+					default: status = STAT_MCODE_COMMAND_UNSUPPORTED;
 				}
-				case 400: SET_NON_MODAL (next_action, NEXT_ACTION_WAIT_FOR_COMPLETION);
-				default: status = STAT_MCODE_COMMAND_UNSUPPORTED;
+				break;
 			}
-			break;
-
-			case 'T': SET_NON_MODAL (tool_select, (uint8_t)trunc(value));
-			case 'F': SET_NON_MODAL (feed_rate, value);
-			case 'P': SET_NON_MODAL (parameter, value);				// used for dwell time, G10 coord select, rotations
-			case 'S': SET_NON_MODAL (spindle_speed, value);
-			case 'X': SET_NON_MODAL (target[AXIS_X], value);
-			case 'Y': SET_NON_MODAL (target[AXIS_Y], value);
-			case 'Z': SET_NON_MODAL (target[AXIS_Z], value);
-			case 'A': SET_NON_MODAL (target[AXIS_A], value);
-			case 'B': SET_NON_MODAL (target[AXIS_B], value);
-			case 'C': SET_NON_MODAL (target[AXIS_C], value);
-		//	case 'U': SET_NON_MODAL (target[AXIS_U], value);		// reserved
-		//	case 'V': SET_NON_MODAL (target[AXIS_V], value);		// reserved
-		//	case 'W': SET_NON_MODAL (target[AXIS_W], value);		// reserved
-			case 'I': SET_NON_MODAL (arc_offset[0], value);
-			case 'J': SET_NON_MODAL (arc_offset[1], value);
-			case 'K': SET_NON_MODAL (arc_offset[2], value);
-			case 'R': SET_NON_MODAL (arc_radius, value);
-			case 'N': SET_NON_MODAL (linenum,(uint32_t)value);		// line number
-			case 'L': break;										// not used for anything
-			default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+			case 51: SET_MODAL (MODAL_GROUP_M9, spindle_override_enable, true);	  // conditionally true
+			case 62: SET_NON_MODAL (sync_output, true);
+			case 63: SET_NON_MODAL (sync_output, false);
+			case 114: SET_NON_MODAL (next_action, NEXT_ACTION_GET_POSITION);
+			case 110: break;									// M110 sets the next line number ($lc, see controller.c)
+			case 115: SET_NON_MODAL (next_action, NEXT_ACTION_GET_FIRMWARE);
+			case 201: {
+				switch (_point(value)) { 
+					case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_JERK);
+					default: status = STAT_MCODE_COMMAND_UNSUPPORTED; 
+				}
+				break;
+			}
+			case 400: SET_NON_MODAL (next_action, NEXT_ACTION_WAIT_FOR_COMPLETION);
+			default: status = STAT_MCODE_COMMAND_UNSUPPORTED;
 		}
-		if(status != STAT_OK) break;
+		break;
+
+		case 'T': SET_NON_MODAL (tool_select, (uint8_t)trunc(value));
+		case 'F': SET_NON_MODAL (feed_rate, value);
+		case 'P': SET_NON_MODAL (parameter, value);				// used for dwell time, G10 coord select, rotations
+		case 'S': SET_NON_MODAL (spindle_speed, value);
+		case 'X': SET_NON_MODAL (target[AXIS_X], value);
+		case 'Y': SET_NON_MODAL (target[AXIS_Y], value);
+		case 'Z': SET_NON_MODAL (target[AXIS_Z], value);
+		case 'A': SET_NON_MODAL (target[AXIS_A], value);
+		case 'B': SET_NON_MODAL (target[AXIS_B], value);
+		case 'C': SET_NON_MODAL (target[AXIS_C], value);
+	//	case 'U': SET_NON_MODAL (target[AXIS_U], value);		// reserved
+	//	case 'V': SET_NON_MODAL (target[AXIS_V], value);		// reserved
+	//	case 'W': SET_NON_MODAL (target[AXIS_W], value);		// reserved
+		case 'I': SET_NON_MODAL (arc_offset[0], value);
+		case 'J': SET_NON_MODAL (arc_offset[1], value);
+		case 'K': SET_NON_MODAL (arc_offset[2], value);
+		case 'R': SET_NON_MODAL (arc_radius, value);				// also the R plane of canned cycles
+		case 'Q': SET_NON_MODAL (peck_depth, value);			// G73, G83 peck increment
+		case 'N': SET_NON_MODAL (linenum,(uint32_t)value);		// line number
+		case 'H': SET_NON_MODAL (h_word, (uint8_t)trunc(value));	// G43 tool table entry
+		case 'L': SET_NON_MODAL (l_word, (uint8_t)trunc(value));	// G10 L1 tool table, L2 (or none) coord offsets
+		case 'D': SET_NON_MODAL (d_word, value);				// G96 max spindle speed, G41/G42 tool table entry
+		default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
 	}
-	if ((status != STAT_OK) && (status != STAT_COMPLETE)) return (status);
-	ritorno(_validate_gcode_block());
-	return (_execute_gcode_block());		// if successful execute the block
+	return (status);
 }
 
 /*
@@ -415,11 +642,12 @@ static stat_t _parse_gcode_block(char_t *buf)
  *  (below, with modifications):
  *
  *	    0. record the line number
- *		1. comment (includes message) [handled during block normalization]
+ *		1. comment (includes message) [handled during block tokenizing]
  *		2. set feed rate mode (G93, G94 - inverse time or per minute)
  *		3. set feed rate (F)
  *		3a. set feed override rate (M50.1)
- *		3a. set traverse override rate (M50.2)
+ *		3a. set traverse override rate (M50.3)
+ *		3b. set spindle speed mode (G96, G97)
  *		4. set spindle speed (S)
  *		4a. set spindle override rate (M51.1)
  *		5. select tool (T)
@@ -434,6 +662,7 @@ static stat_t _parse_gcode_block(char_t *buf)
  *		14. cutter length compensation on or off (G43, G49)
  *		15. coordinate system selection (G54, G55, G56, G57, G58, G59)
  *		16. set path control mode (G61, G61.1, G64)
+ *		16a. select machining preset (G187)
  *		17. set distance mode (G90, G91)
  *		18. set retract mode (G98, G99)
  *		19a. homing functions (G28.2, G28.3, G28.1, G28, G30)
@@ -450,11 +679,36 @@ static stat_t _execute_gcode_block()
 {
 	stat_t status = STAT_OK;
 
+	if (cm.ff_line != 0) {									// $ff - resuming a job
+		cm.ff_linenum = (cm.gf.linenum == true) ? cm.gn.linenum : cm.ff_linenum+1;
+		if (cm.ff_linenum < cm.ff_line) {
+			return (_fast_forward_gcode_block());
+		}
+		ritorno(cm_fast_forward_resume());					// then run the resume line as usual
+	}
+
+	// Fast path for the X.. Y.. Z.. continuation blocks that make up most CAM output.
+	// A block of axis words only sets no modes and has no line number (which is not
+	// reported when 0), and absolute override was cleared by the block before it,
+	// so all that is left is to run the move in the motion mode in effect.
+	if ((gp.other_words == 0) && (gp.axis_words != 0)) {
+		if (cm.gn.motion_mode == MOTION_MODE_STRAIGHT_FEED) {
+			cm.gm.linenum = 0;
+			return (cm_straight_feed(cm.gn.target, cm.gf.target));
+		}
+		if (cm.gn.motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) {
+			cm.gm.linenum = 0;
+			return (cm_straight_traverse(cm.gn.target, cm.gf.target));
+		}
+	}
+
 	cm_set_model_linenum(cm.gn.linenum);
 	EXEC_FUNC(cm_set_feed_rate_mode, feed_rate_mode);
 	EXEC_FUNC(cm_set_feed_rate, feed_rate);
 	EXEC_FUNC(cm_feed_rate_override_factor, feed_rate_override_factor);
 	EXEC_FUNC(cm_traverse_override_factor, traverse_override_factor);
+	if ((cm.gf.d_word == true) && (cm.gf.cutter_comp == false)) { cm_set_spindle_css_max(cm.gn.d_word);}
+	EXEC_FUNC(cm_set_spindle_css_mode, spindle_css_mode);	// before S, which it changes the meaning of
 	EXEC_FUNC(cm_set_spindle_speed, spindle_speed);
 	EXEC_FUNC(cm_spindle_override_factor, spindle_override_factor);
 	EXEC_FUNC(cm_select_tool, tool_select);					// tool_select is where it's written
@@ -462,6 +716,10 @@ static stat_t _execute_gcode_block()
 	EXEC_FUNC(cm_spindle_control, spindle_mode); 			// spindle on or off
 	EXEC_FUNC(cm_mist_coolant_control, mist_coolant);
 	EXEC_FUNC(cm_flood_coolant_control, flood_coolant);		// also disables mist coolant if OFF
+	if (cm.gf.sync_output == true) {						// M62, M63 P - switched with the next move
+		if (fp_FALSE(cm.gf.parameter)) return (STAT_P_WORD_IS_MISSING);
+		ritorno(cm_sync_output(cm.gn.sync_output, cm.gn.parameter));
+	}
 	EXEC_FUNC(cm_feed_rate_override_enable, feed_rate_override_enable);
 	EXEC_FUNC(cm_traverse_override_enable, traverse_override_enable);
 	EXEC_FUNC(cm_spindle_override_enable, spindle_override_enable);
@@ -472,12 +730,22 @@ static stat_t _execute_gcode_block()
 	}
 	EXEC_FUNC(cm_select_plane, select_plane);
 	EXEC_FUNC(cm_set_units_mode, units_mode);
-	//--> cutter radius compensation goes here
-	//--> cutter length compensation goes here
+	if (cm.gf.cutter_comp == true) {						// G40, G41 [Dn], G42 [Dn]
+		ritorno(cm_set_cutter_comp(cm.gn.cutter_comp, (uint8_t)cm.gn.d_word, cm.gf.d_word));
+	}
+	if (cm.gf.tool_length_mode == true) {					// G43 [Hn], G49
+		ritorno(cm_set_tool_length_offset(cm.gn.tool_length_mode, cm.gn.h_word, cm.gf.h_word));
+	}
 	EXEC_FUNC(cm_set_coord_system, coord_system);
 	EXEC_FUNC(cm_set_path_control, path_control);
+	if ((cm.gf.path_control == true) && (cm.gn.path_control == PATH_CONTINUOUS)) {	// G64 P - blend tolerance
+		cm_set_path_tolerance(fp_TRUE(cm.gf.parameter) ? cm.gn.parameter : 0);
+	}
+	if (cm.gf.preset_select == true) {						// G187 [Pn] - machining preset
+		ritorno(cm_set_preset(fp_TRUE(cm.gf.parameter) ? cm.gn.parameter : 0));
+	}
 	EXEC_FUNC(cm_set_distance_mode, distance_mode);
-	//--> set retract mode goes here
+	EXEC_FUNC(cm_set_retract_mode, retract_mode);
 
 	switch (cm.gn.next_action) {
 		case NEXT_ACTION_SET_G28_POSITION:  { status = cm_set_g28_position(); break;}								// G28.1
@@ -489,19 +757,43 @@ static stat_t _execute_gcode_block()
 		case NEXT_ACTION_SET_ABSOLUTE_ORIGIN: { status = cm_set_absolute_origin(cm.gn.target, cm.gf.target); break;}// G28.3
 		case NEXT_ACTION_HOMING_NO_SET: { status = cm_homing_cycle_start_no_set(); break;}							// G28.4
 
-		case NEXT_ACTION_STRAIGHT_PROBE: { status = cm_straight_probe(cm.gn.target, cm.gf.target); break;}			// G38.2
+		case NEXT_ACTION_STRAIGHT_PROBE: { status = cm_straight_probe(cm.gn.target, cm.gf.target, false, true); break;}				// G38.2
+		case NEXT_ACTION_STRAIGHT_PROBE_NO_ERROR: { status = cm_straight_probe(cm.gn.target, cm.gf.target, false, false); break;}	// G38.3
+		case NEXT_ACTION_STRAIGHT_PROBE_AWAY: { status = cm_straight_probe(cm.gn.target, cm.gf.target, true, true); break;}			// G38.4
+		case NEXT_ACTION_STRAIGHT_PROBE_AWAY_NO_ERROR: { status = cm_straight_probe(cm.gn.target, cm.gf.target, true, false); break;}// G38.5
+		case NEXT_ACTION_PROBE_GRID: { status = cm_probe_grid(cm.gn.target, cm.gf.target, cm.gn.arc_offset, cm.gf.arc_offset); break;} // G29
+		case NEXT_ACTION_CLEAR_PROBE_GRID: { status = cm_clear_probe_grid(); break;}								// G29.1
+		case NEXT_ACTION_UNRETRACT: { status = cm_retract(false); break;}											// G11
 
-		case NEXT_ACTION_SET_COORD_DATA: { status = cm_set_coord_offsets(cm.gn.parameter, cm.gn.target, cm.gf.target); break;}
+		case NEXT_ACTION_SET_COORD_DATA: {
+			if ((cm.gf.l_word == false) && fp_FALSE(cm.gf.parameter) && (gp.axis_words == 0)) {					// G10 retract
+				status = cm_retract(true);
+			} else if (cm.gn.l_word == 1) {																			// G10 L1
+				status = cm_set_tool_table(cm.gn.parameter, cm.gn.target, cm.gf.target, cm.gn.arc_radius, cm.gf.arc_radius);
+			} else {																								// G10 L2
+				status = cm_set_coord_offsets(cm.gn.parameter, cm.gn.target, cm.gf.target);
+			}
+			break;
+		}
 		case NEXT_ACTION_SET_ORIGIN_OFFSETS: { status = cm_set_origin_offsets(cm.gn.target, cm.gf.target); break;}
 		case NEXT_ACTION_RESET_ORIGIN_OFFSETS: { status = cm_reset_origin_offsets(); break;}
 		case NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS: { status = cm_suspend_origin_offsets(); break;}
 		case NEXT_ACTION_RESUME_ORIGIN_OFFSETS: { status = cm_resume_origin_offsets(); break;}
+		case NEXT_ACTION_SET_ROTATION: { status = cm_set_rotation(cm.gn.target, cm.gf.target, cm.gn.arc_radius, cm.gf.arc_radius); break;}		// G68
+		case NEXT_ACTION_CANCEL_ROTATION: { status = cm_cancel_rotation(); break;}									// G69
+		case NEXT_ACTION_SET_SCALING: { status = cm_set_scaling(cm.gn.target, cm.gf.target, cm.gn.arc_offset, cm.gf.arc_offset,
+																 cm.gn.parameter, cm.gf.parameter); break;}			// G51
+		case NEXT_ACTION_CANCEL_SCALING: { status = cm_cancel_scaling(); break;}									// G50
 		case NEXT_ACTION_GET_POSITION: { status = cm_get_position(); break; }
 		case NEXT_ACTION_GET_FIRMWARE: { status = cm_get_firmware(); break; }
 		case NEXT_ACTION_SET_JERK: { status = cm_set_jerk(cm.gn.target, cm.gf.target); break; }
 		case NEXT_ACTION_WAIT_FOR_COMPLETION: { status = cm_wait_for_completion(); break; }
 
 		case NEXT_ACTION_DEFAULT: {
+			if ((cm.gm.cutter_comp != CUTTER_COMP_OFF) && (gp.axis_words != 0) &&
+				(cm.gn.motion_mode > MOTION_MODE_STRAIGHT_FEED)) {
+				return (STAT_CUTTER_COMPENSATION_MOTION_INVALID);	// only lines are offset
+			}
 			cm_set_absolute_override(MODEL, cm.gn.absolute_override);	// apply override setting to gm struct
 			switch (cm.gn.motion_mode) {
 				case MOTION_MODE_CANCEL_MOTION_MODE: { cm.gm.motion_mode = cm.gn.motion_mode; break;}
@@ -511,6 +803,17 @@ static stat_t _execute_gcode_block()
 					// gf.radius sets radius mode if radius was collected in gn
 					{ status = cm_arc_feed(cm.gn.target, cm.gf.target, cm.gn.arc_offset[0], cm.gn.arc_offset[1],
 										   cm.gn.arc_offset[2], cm.gn.arc_radius, cm.gn.motion_mode); break;}
+				case MOTION_MODE_CUBIC_SPLINE: case MOTION_MODE_QUADRATIC_SPLINE:
+					// P and Q come in as the parameter and peck depth words
+					{ status = cm_spline_feed(cm.gn.target, cm.gf.target, cm.gn.arc_offset[0], cm.gn.arc_offset[1],
+											  cm.gn.parameter, cm.gn.peck_depth, cm.gn.motion_mode); break;}
+				case MOTION_MODE_SPINDLE_SYNC: case MOTION_MODE_RIGID_TAP:
+					// K is the pitch
+					{ status = cm_spindle_sync_feed(cm.gn.target, cm.gf.target, cm.gn.arc_offset[2],
+													cm.gf.arc_offset[2], cm.gn.motion_mode); break;}
+				case MOTION_MODE_CANNED_CYCLE_73: case MOTION_MODE_CANNED_CYCLE_81:
+				case MOTION_MODE_CANNED_CYCLE_82: case MOTION_MODE_CANNED_CYCLE_83:
+					{ status = cm_canned_cycle(cm.gn.target, cm.gf.target, cm.gn.motion_mode); break;}
 			}
 		}
 	}
@@ -527,6 +830,1110 @@ static stat_t _execute_gcode_block()
 	return (status);
 }
 
+/*
+ * _fast_forward_gcode_block() - apply a block before the job resume line to the model
+ *
+ *	Job resume ($ff): the blocks before the resume line set the modes, offsets, tool,
+ *	spindle and coolant the job had at that line and their moves update the model
+ *	position, but nothing is planned (mp_queue_command() drops commands while $ff is set).
+ *	Blocks are matched on their N word, and blocks without one count on from the last.
+ *	Spindle and coolant are recorded for cm_fast_forward_resume() to turn on.
+ *
+ *	Dwells, homing, probing, G28/G30 moves, G28.3 and program stops are not replayed, and
+ *	a canned cycle only leaves the model over its hole. A job that uses those before the
+ *	resume line must be resumed after them.
+ */
+static stat_t _fast_forward_gcode_block()
+{
+	stat_t status = STAT_OK;
+
+	EXEC_FUNC(cm_set_feed_rate_mode, feed_rate_mode);
+	EXEC_FUNC(cm_set_feed_rate, feed_rate);
+	EXEC_FUNC(cm_feed_rate_override_factor, feed_rate_override_factor);
+	EXEC_FUNC(cm_traverse_override_factor, traverse_override_factor);
+	if ((cm.gf.d_word == true) && (cm.gf.cutter_comp == false)) { cm_set_spindle_css_max(cm.gn.d_word);}
+	if (cm.gf.spindle_css_mode == true) { cm.gmx.spindle_css_mode = cm.gn.spindle_css_mode;}
+	if (cm.gf.spindle_speed == true) { cm.ff_spindle_speed = cm.gn.spindle_speed;}
+	EXEC_FUNC(cm_spindle_override_factor, spindle_override_factor);
+	EXEC_FUNC(cm_select_tool, tool_select);
+	EXEC_FUNC(cm_change_tool, tool_change);
+	if (cm.gf.spindle_mode == true) { cm.ff_spindle_mode = cm.gn.spindle_mode;}
+	if (cm.gf.mist_coolant == true) { cm.ff_mist_coolant = cm.gn.mist_coolant;}
+	if (cm.gf.flood_coolant == true) {
+		cm.ff_flood_coolant = cm.gn.flood_coolant;
+		if (cm.gn.flood_coolant == false) { cm.ff_mist_coolant = false;}	// M9 is both off
+	}
+	EXEC_FUNC(cm_feed_rate_override_enable, feed_rate_override_enable);
+	EXEC_FUNC(cm_traverse_override_enable, traverse_override_enable);
+	EXEC_FUNC(cm_spindle_override_enable, spindle_override_enable);
+	EXEC_FUNC(cm_override_enables, override_enables);
+
+	EXEC_FUNC(cm_select_plane, select_plane);
+	EXEC_FUNC(cm_set_units_mode, units_mode);
+	if (cm.gf.cutter_comp == true) {
+		ritorno(cm_set_cutter_comp(cm.gn.cutter_comp, (uint8_t)cm.gn.d_word, cm.gf.d_word));
+	}
+	if (cm.gf.tool_length_mode == true) {
+		ritorno(cm_set_tool_length_offset(cm.gn.tool_length_mode, cm.gn.h_word, cm.gf.h_word));
+	}
+	EXEC_FUNC(cm_set_coord_system, coord_system);
+	EXEC_FUNC(cm_set_path_control, path_control);
+	if ((cm.gf.path_control == true) && (cm.gn.path_control == PATH_CONTINUOUS)) {
+		cm_set_path_tolerance(fp_TRUE(cm.gf.parameter) ? cm.gn.parameter : 0);
+	}
+	if (cm.gf.preset_select == true) {
+		ritorno(cm_set_preset(fp_TRUE(cm.gf.parameter) ? cm.gn.parameter : 0));
+	}
+	EXEC_FUNC(cm_set_distance_mode, distance_mode);
+	EXEC_FUNC(cm_set_retract_mode, retract_mode);
+
+	switch (cm.gn.next_action) {
+		case NEXT_ACTION_SET_G28_POSITION:  { status = cm_set_g28_position(); break;}
+		case NEXT_ACTION_SET_G30_POSITION:  { status = cm_set_g30_position(); break;}
+		case NEXT_ACTION_SET_COORD_DATA: {
+			if ((cm.gf.l_word == false) && fp_FALSE(cm.gf.parameter) && (gp.axis_words == 0)) {
+				break;											// a retraction is not resumed
+			} else if (cm.gn.l_word == 1) {
+				status = cm_set_tool_table(cm.gn.parameter, cm.gn.target, cm.gf.target, cm.gn.arc_radius, cm.gf.arc_radius);
+			} else {
+				status = cm_set_coord_offsets(cm.gn.parameter, cm.gn.target, cm.gf.target);
+			}
+			break;
+		}
+		case NEXT_ACTION_SET_ORIGIN_OFFSETS: { status = cm_set_origin_offsets(cm.gn.target, cm.gf.target); break;}
+		case NEXT_ACTION_RESET_ORIGIN_OFFSETS: { status = cm_reset_origin_offsets(); break;}
+		case NEXT_ACTION_SUSPEND_ORIGIN_OFFSETS: { status = cm_suspend_origin_offsets(); break;}
+		case NEXT_ACTION_RESUME_ORIGIN_OFFSETS: { status = cm_resume_origin_offsets(); break;}
+		case NEXT_ACTION_SET_ROTATION: { status = cm_set_rotation(cm.gn.target, cm.gf.target, cm.gn.arc_radius, cm.gf.arc_radius); break;}
+		case NEXT_ACTION_CANCEL_ROTATION: { status = cm_cancel_rotation(); break;}
+		case NEXT_ACTION_SET_SCALING: { status = cm_set_scaling(cm.gn.target, cm.gf.target, cm.gn.arc_offset, cm.gf.arc_offset,
+																 cm.gn.parameter, cm.gf.parameter); break;}
+		case NEXT_ACTION_CANCEL_SCALING: { status = cm_cancel_scaling(); break;}
+
+		case NEXT_ACTION_DEFAULT: {
+			cm_set_absolute_override(MODEL, cm.gn.absolute_override);
+			cm.gm.motion_mode = cm.gn.motion_mode;
+			if (cm.gn.motion_mode == MOTION_MODE_CANCEL_MOTION_MODE) break;
+			if (cm.gn.motion_mode == MOTION_MODE_RIGID_TAP) break;	// a tap comes back out to where it started
+			if ((cm.gn.motion_mode >= MOTION_MODE_CANNED_CYCLE_81) && (cm.gn.motion_mode <= MOTION_MODE_CANNED_CYCLE_73)) {
+				cm.gf.target[AXIS_Z] = 0;					// Z is the hole bottom, not where it ends up
+			}
+			cm_set_model_target(cm.gn.target, cm.gf.target);
+			cm_finalize_move();
+			break;
+		}
+		default: break;
+	}
+	cm_set_absolute_override(MODEL, false);
+	return (status);
+}
+
+
+/***********************************************************************************
+ * PARAMETERS AND EXPRESSIONS
+ ***********************************************************************************/
+
+/*
+ * _compile_value()		 - compile a word value (number, parameter or expression) into ex.code
+ * _parse_expression_word() - load a word whose value is not a plain number
+ * _parse_assignment()	 - parse a #n=value or #<name>=value parameter setting
+ * _apply_assignments()	 - set the parameters assigned in the block
+ * _evaluate()			 - run compiled code and return its value
+ *
+ *	Word values can be numbers, parameters or expressions, as in LinuxCNC:
+ *
+ *		#1 to #32			- numbered parameters, 0 at reset
+ *		#<name>				- named parameters (GC_NAMED_PARAMETERS of them, case and spaces ignored)
+ *		#[expr], ##1		- the parameter numbered by a value
+ *		[expr]				- binary operators **; * / MOD; + -; EQ NE GT GE LT LE; AND OR XOR
+ *							  in that order of precedence, and unary functions ABS ACOS ASIN
+ *							  COS EXP FIX FUP LN ROUND SIN SQRT TAN of a bracketed value.
+ *							  ATAN[y]/[x] is the four quadrant arc tangent. Angles are degrees.
+ *
+ *	Read only parameters give the probe result (#5061-#5066 X-C in work coordinates,
+ *	#5070 1 if the probe tripped), the coordinate system (#5220), the G54-G59 offsets
+ *	(#5221-#5226 for G54, on in steps of 20), the tool (#5400) and its diameter (#5410)
+ *	and the work position of the model (#5420-#5425). A probe sets its results before the
+ *	next block is parsed, so a probing macro can use them right away.
+ *
+ *	A value is compiled into a few bytes of stack machine code as the block is parsed.
+ *	Code that reads no parameter is run once and loaded as a plain number. Otherwise it is
+ *	run for the word, or, when a subroutine or loop is recorded, stored in place of the
+ *	number (see _record_expression_word()), so a stored block costs an evaluation of its
+ *	code when it is replayed - not another parse. Named parameters are bound to their slot
+ *	when they are compiled.
+ *
+ *	#n=value sets a parameter. All settings in a block take effect together once the block
+ *	is read, so the values on the line see the parameters as they were before it.
+ *	Blocks with parameters or expressions are not read ahead (see _read_ahead_slot()), as
+ *	they may depend on blocks that have not run yet.
+ */
+
+enum gcodeExprOp {					// compiled code - one byte opcodes
+	EX_CONST = 1,					// push the float that follows
+	EX_PARAM,						// push the parameter whose number follows (uint16)
+	EX_INDIRECT,					// replace the top of the stack with the parameter it numbers
+	EX_NEG,							// unary operators - replace the top of the stack
+	EX_ABS,
+	EX_ACOS,
+	EX_ASIN,
+	EX_COS,
+	EX_EXP,
+	EX_FIX,
+	EX_FUP,
+	EX_LN,
+	EX_ROUND,
+	EX_SIN,
+	EX_SQRT,
+	EX_TAN,
+	EX_POW,							// binary operators - pop two, push the result
+	EX_MUL,
+	EX_DIV,
+	EX_MOD,
+	EX_ADD,
+	EX_SUB,
+	EX_EQ,
+	EX_NE,
+	EX_GT,
+	EX_GE,
+	EX_LT,
+	EX_LE,
+	EX_AND,
+	EX_OR,
+	EX_XOR,
+	EX_ATAN							// ATAN[y]/[x]
+};
+
+#define EX_LEVELS 4					// binary operator precedence levels - 0 binds least
+#define EX_NAMED 0x8000				// parameter numbers of named parameters (slot in the low bits)
+#define EX_STORED 0x80				// set in the letter of a stored word that holds code
+
+struct gcodeExprOperator {
+	char_t name[6];
+	uint8_t op;
+	uint8_t level;
+};
+
+static const struct gcodeExprOperator ex_binary[] PROGMEM = {
+	{ "AND", EX_AND, 0 }, { "OR", EX_OR, 0 }, { "XOR", EX_XOR, 0 },
+	{ "EQ", EX_EQ, 1 }, { "NE", EX_NE, 1 }, { "GT", EX_GT, 1 },
+	{ "GE", EX_GE, 1 }, { "LT", EX_LT, 1 }, { "LE", EX_LE, 1 },
+	{ "+", EX_ADD, 2 }, { "-", EX_SUB, 2 },
+	{ "**", EX_POW, 4 }, { "*", EX_MUL, 3 }, { "/", EX_DIV, 3 }, { "MOD", EX_MOD, 3 }
+};
+
+static const struct gcodeExprOperator ex_unary[] PROGMEM = {
+	{ "ABS", EX_ABS, 0 }, { "ACOS", EX_ACOS, 0 }, { "ASIN", EX_ASIN, 0 }, { "ATAN", EX_ATAN, 0 },
+	{ "COS", EX_COS, 0 }, { "EXP", EX_EXP, 0 }, { "FIX", EX_FIX, 0 }, { "FUP", EX_FUP, 0 },
+	{ "LN", EX_LN, 0 }, { "ROUND", EX_ROUND, 0 }, { "SIN", EX_SIN, 0 }, { "SQRT", EX_SQRT, 0 },
+	{ "TAN", EX_TAN, 0 }
+};
+
+struct gcodeExprSingleton {			  // value being compiled
+	uint8_t len;					  // bytes of code
+	uint8_t depth;					  // stack depth the code leaves
+	uint8_t nest;					  // brackets and functions open
+	uint8_t variable;				  // TRUE if the code reads a parameter
+	uint8_t code[GC_EXPR_CODE_SIZE];
+}; static struct gcodeExprSingleton ex;
+
+struct gcodeParameterSingleton {	  // parameter values
+	float number[GC_PARAMETERS+1];	  // #1 to #GC_PARAMETERS (#0 is always 0)
+	float named[GC_NAMED_PARAMETERS];
+	char_t name[GC_NAMED_PARAMETERS][GC_NAME_LEN];
+	uint8_t named_count;			  // slots bound to a name
+	uint8_t named_set;				  // bit per slot - TRUE once a value is set
+}; static struct gcodeParameterSingleton gv;
+
+static stat_t _compile_expression(char_t **str, uint8_t level);
+
+static stat_t _emit(const void *bytes, uint8_t count)
+{
+	if (ex.len + count > GC_EXPR_CODE_SIZE) return (STAT_EXPRESSION_TOO_COMPLEX);
+	memcpy(&ex.code[ex.len], bytes, count);
+	ex.len += count;
+	return (STAT_OK);
+}
+
+static stat_t _emit_push(uint8_t op, const void *operand, uint8_t count)
+{
+	if (++ex.depth > GC_EXPR_STACK) return (STAT_EXPRESSION_TOO_COMPLEX);
+	ritorno(_emit(&op, 1));
+	return (_emit(operand, count));
+}
+
+static char_t *_skip_space(char_t *rd)
+{
+	while (isspace((char)*rd)) { rd++; }
+	return (rd);
+}
+
+/*
+ * _match_operator() - copy out the entry of a table that the text starts with and skip it
+ */
+static uint8_t _match_operator(char_t **str, const struct gcodeExprOperator *table, uint8_t count,
+							   struct gcodeExprOperator *match)
+{
+	for (uint8_t i=0; i<count; i++) {
+		memcpy_P(match, &table[i], sizeof(struct gcodeExprOperator));
+		uint8_t j;
+		for (j=0; (match->name[j] != NUL) && (toupper((char)(*str)[j]) == match->name[j]); j++);
+		if ((match->name[j] == NUL) && ((isalpha((char)match->name[0]) == false) || (isalpha((char)(*str)[j]) == false))) {
+			*str += j;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+static stat_t _compile_bracket(char_t **str)
+{
+	char_t *rd = _skip_space(*str);
+	if (*rd != '[') return (STAT_EXPRESSION_SYNTAX_ERROR);
+	if (++ex.nest > GC_EXPR_NEST) return (STAT_EXPRESSION_TOO_COMPLEX);
+	rd++;
+	ritorno(_compile_expression(&rd, 0));
+	rd = _skip_space(rd);
+	if (*rd != ']') return (STAT_EXPRESSION_SYNTAX_ERROR);
+	ex.nest--;
+	*str = rd+1;
+	return (STAT_OK);
+}
+
+/*
+ * _named_slot() - return the slot of a named parameter, binding a free one to the name
+ */
+static stat_t _named_slot(char_t **str, uint16_t *number)
+{
+	char_t name[GC_NAME_LEN];
+	uint8_t len = 0;
+	char_t *rd = *str;
+
+	for ( ; (*rd != '>'); rd++) {
+		if (*rd == NUL) return (STAT_EXPRESSION_SYNTAX_ERROR);
+		if (isspace((char)*rd)) continue;
+		if (len == GC_NAME_LEN-1) return (STAT_EXPRESSION_SYNTAX_ERROR);
+		name[len++] = (char_t)tolower((char)*rd);
+	}
+	if (len == 0) return (STAT_EXPRESSION_SYNTAX_ERROR);
+	name[len] = NUL;
+	*str = rd+1;
+
+	uint8_t slot;
+	for (slot=0; slot<gv.named_count; slot++) {
+		if (strcmp((char *)gv.name[slot], (char *)name) == 0) break;
+	}
+	if (slot == gv.named_count) {
+		if (slot == GC_NAMED_PARAMETERS) return (STAT_PARAMETER_INVALID);
+		strcpy((char *)gv.name[slot], (char *)name);
+		gv.named_count++;
+	}
+	*number = EX_NAMED | slot;
+	return (STAT_OK);
+}
+
+/*
+ * _compile_parameter() - compile the parameter reference after a #
+ *
+ *	A constant number or a name is compiled to EX_PARAM. Anything else is an indirect
+ *	reference whose number is worked out when the code is run. number is set for the
+ *	first two, and 0 for an indirect reference (a parameter assignment needs a number).
+ */
+static stat_t _compile_parameter(char_t **str, uint16_t *number)
+{
+	char_t *rd = _skip_space(*str);
+
+	*number = 0;
+	ex.variable = true;
+	if (*rd == '<') {
+		*str = rd+1;
+		ritorno(_named_slot(str, number));
+		return (_emit_push(EX_PARAM, number, sizeof(uint16_t)));
+	}
+	if (isdigit((char)*rd)) {
+		uint16_t value = 0;
+		for ( ; isdigit((char)*rd); rd++) {
+			if ((value = value * 10 + (*rd - '0')) >= EX_NAMED) return (STAT_PARAMETER_INVALID);
+		}
+		*number = value;
+		*str = rd;
+		return (_emit_push(EX_PARAM, number, sizeof(uint16_t)));
+	}
+	if ((*rd != '#') && (*rd != '[')) return (STAT_EXPRESSION_SYNTAX_ERROR);
+	if (++ex.nest > GC_EXPR_NEST) return (STAT_EXPRESSION_TOO_COMPLEX);
+	uint8_t op = EX_INDIRECT;
+	if (*rd == '#') {
+		rd++;
+		uint16_t inner;
+		ritorno(_compile_parameter(&rd, &inner));
+	} else {
+		ritorno(_compile_bracket(&rd));
+	}
+	ex.nest--;
+	*str = rd;
+	return (_emit(&op, 1));
+}
+
+/*
+ * _compile_operand() - number, parameter, bracketed expression, function, or a signed operand
+ */
+static stat_t _compile_operand(char_t **str)
+{
+	char_t *rd = _skip_space(*str);
+	char_t *end;
+
+	if (*rd == '#') {
+		uint16_t number;
+		*str = rd+1;
+		return (_compile_parameter(str, &number));
+	}
+	if (*rd == '[') {
+		*str = rd;
+		return (_compile_bracket(str));
+	}
+	if ((*rd == '-') || (*rd == '+')) {
+		uint8_t negate = (*rd == '-');
+		*str = rd+1;
+		if (++ex.nest > GC_EXPR_NEST) return (STAT_EXPRESSION_TOO_COMPLEX);
+		ritorno(_compile_operand(str));
+		ex.nest--;
+		if (negate == false) return (STAT_OK);
+		uint8_t op = EX_NEG;
+		return (_emit(&op, 1));
+	}
+	if (isalpha((char)*rd)) {
+		struct gcodeExprOperator fn;
+		if (_match_operator(&rd, ex_unary, sizeof(ex_unary)/sizeof(ex_unary[0]), &fn) == false) {
+			return (STAT_BAD_NUMBER_FORMAT);
+		}
+		uint8_t op = fn.op;
+		ritorno(_compile_bracket(&rd));
+		if (op == EX_ATAN) {						// ATAN[y]/[x]
+			rd = _skip_space(rd);
+			if (*rd++ != '/') return (STAT_EXPRESSION_SYNTAX_ERROR);
+			ritorno(_compile_bracket(&rd));
+			ex.depth--;
+		}
+		*str = rd;
+		return (_emit(&op, 1));
+	}
+	float value = parse_float(rd, &end);
+	if (end == rd) return (STAT_BAD_NUMBER_FORMAT);
+	*str = end;
+	return (_emit_push(EX_CONST, &value, sizeof(float)));
+}
+
+/*
+ * _compile_expression() - compile the binary operators of a level and the levels above it
+ */
+static stat_t _compile_expression(char_t **str, uint8_t level)
+{
+	if (level > EX_LEVELS) return (_compile_operand(str));
+	ritorno(_compile_expression(str, level+1));
+
+	while (true) {
+		char_t *rd = _skip_space(*str);
+		struct gcodeExprOperator bin;
+		if ((_match_operator(&rd, ex_binary, sizeof(ex_binary)/sizeof(ex_binary[0]), &bin) == false) ||
+			(bin.level != level)) {
+			return (STAT_OK);
+		}
+		*str = rd;
+		ritorno(_compile_expression(str, level+1));
+		ritorno(_emit(&bin.op, 1));
+		ex.depth--;
+	}
+}
+
+static stat_t _compile_value(char_t *str, char_t **end)
+{
+	ex.len = 0;
+	ex.depth = 0;
+	ex.nest = 0;
+	ex.variable = false;
+	*end = str;
+	ritorno(_compile_operand(end));
+	return (STAT_OK);
+}
+
+/*
+ * _get_parameter() - read a parameter
+ * _set_parameter() - write a parameter
+ */
+static float _in_units(float mm)
+{
+	return ((cm.gm.units_mode == INCHES) ? mm / MM_PER_INCH : mm);
+}
+
+static stat_t _get_parameter(uint16_t number, float *value)
+{
+	if (number <= GC_PARAMETERS) {
+		*value = (number == 0) ? 0 : gv.number[number];
+		return (STAT_OK);
+	}
+	if (number & EX_NAMED) {
+		uint8_t slot = number & ~EX_NAMED;
+		if ((slot >= GC_NAMED_PARAMETERS) || ((gv.named_set & (1<<slot)) == 0)) return (STAT_PARAMETER_UNDEFINED);
+		*value = gv.named[slot];
+		return (STAT_OK);
+	}
+	if ((number >= 5061) && (number < 5061+AXES)) {	// probe result
+		uint8_t axis = number - 5061;
+		*value = _in_units(cm.probe_results[axis] - cm_get_active_coord_offset(axis));
+		return (STAT_OK);
+	}
+	if ((number >= 5420) && (number < 5420+AXES)) {	// work position
+		*value = cm_get_work_position(MODEL, number - 5420);
+		return (STAT_OK);
+	}
+	if ((number >= 5221) && (number < 5221 + 20*COORD_SYSTEM_MAX) && (((number - 5221) % 20) < AXES)) {
+		*value = _in_units(cm.offset[G54 + (number - 5221) / 20][(number - 5221) % 20]);
+		return (STAT_OK);
+	}
+	switch (number) {
+		case 5070: { *value = (cm.probe_state == PROBE_SUCCEEDED) ? 1 : 0; return (STAT_OK);}
+		case 5220: { *value = cm.gm.coord_system; return (STAT_OK);}
+		case 5400: { *value = cm.gmx.tool; return (STAT_OK);}
+		case 5410: { *value = (cm.gmx.tool <= TOOLS) ? _in_units(cm.tool_diameter[cm.gmx.tool]) : 0; return (STAT_OK);}
+	}
+	return (STAT_PARAMETER_INVALID);
+}
+
+static stat_t _set_parameter(uint16_t number, float value)
+{
+	if ((number >= 1) && (number <= GC_PARAMETERS)) {
+		gv.number[number] = value;
+		return (STAT_OK);
+	}
+	if ((number & EX_NAMED) && ((number & ~EX_NAMED) < GC_NAMED_PARAMETERS)) {
+		gv.named[number & ~EX_NAMED] = value;
+		gv.named_set |= (1 << (number & ~EX_NAMED));
+		return (STAT_OK);
+	}
+	return (STAT_PARAMETER_INVALID);
+}
+
+static stat_t _evaluate(const uint8_t *code, uint8_t len, float *value)
+{
+	float stack[GC_EXPR_STACK];
+	uint8_t sp = 0;								// stack entries in use
+	const uint8_t *end = code + len;
+
+	while (code < end) {
+		uint8_t op = *code++;
+		if (op == EX_CONST) {
+			memcpy(&stack[sp++], code, sizeof(float));
+			code += sizeof(float);
+			continue;
+		}
+		if (op == EX_PARAM) {
+			uint16_t number;
+			memcpy(&number, code, sizeof(uint16_t));
+			code += sizeof(uint16_t);
+			ritorno(_get_parameter(number, &stack[sp++]));
+			continue;
+		}
+		float b = 0;							// right operand of a binary operator
+		if (op >= EX_POW) {
+			b = stack[--sp];
+		}
+		float *a = &stack[sp-1];				// the operand (unary) or the result (binary)
+		switch (op) {
+			case EX_INDIRECT: {
+				if ((*a < 0) || (*a >= EX_NAMED)) return (STAT_PARAMETER_INVALID);
+				ritorno(_get_parameter((uint16_t)(*a + 0.5), a)); break;
+			}
+			case EX_NEG: { *a = -*a; break;}
+			case EX_ABS: { *a = fabs(*a); break;}
+			case EX_ACOS: { if (fabs(*a) > 1) return (STAT_EXPRESSION_MATH_ERROR); *a = acos(*a) * (180/M_PI); break;}
+			case EX_ASIN: { if (fabs(*a) > 1) return (STAT_EXPRESSION_MATH_ERROR); *a = asin(*a) * (180/M_PI); break;}
+			case EX_COS: { *a = cos(*a * (M_PI/180)); break;}
+			case EX_EXP: { *a = exp(*a); break;}
+			case EX_FIX: { *a = floor(*a); break;}
+			case EX_FUP: { *a = ceil(*a); break;}
+			case EX_LN: { if (*a <= 0) return (STAT_EXPRESSION_MATH_ERROR); *a = log(*a); break;}
+			case EX_ROUND: { *a = floor(*a + 0.5); break;}
+			case EX_SIN: { *a = sin(*a * (M_PI/180)); break;}
+			case EX_SQRT: { if (*a < 0) return (STAT_EXPRESSION_MATH_ERROR); *a = sqrt(*a); break;}
+			case EX_TAN: { *a = tan(*a * (M_PI/180)); break;}
+			case EX_POW: {
+				if ((*a < 0) && (fp_NE(b, trunc(b)))) return (STAT_EXPRESSION_MATH_ERROR);
+				*a = pow(*a, b); break;
+			}
+			case EX_MUL: { *a *= b; break;}
+			case EX_DIV: { if (fp_ZERO(b)) return (STAT_EXPRESSION_MATH_ERROR); *a /= b; break;}
+			case EX_MOD: { if (fp_ZERO(b)) return (STAT_EXPRESSION_MATH_ERROR); *a -= b * floor(*a / b); break;}
+			case EX_ADD: { *a += b; break;}
+			case EX_SUB: { *a -= b; break;}
+			case EX_EQ: { *a = fp_EQ(*a, b); break;}
+			case EX_NE: { *a = fp_NE(*a, b); break;}
+			case EX_GT: { *a = (*a > b); break;}
+			case EX_GE: { *a = (*a >= b); break;}
+			case EX_LT: { *a = (*a < b); break;}
+			case EX_LE: { *a = (*a <= b); break;}
+			case EX_AND: { *a = (fp_TRUE(*a) && fp_TRUE(b)); break;}
+			case EX_OR: { *a = (fp_TRUE(*a) || fp_TRUE(b)); break;}
+			case EX_XOR: { *a = (fp_TRUE(*a) != fp_TRUE(b)); break;}
+			case EX_ATAN: { *a = atan2(*a, b) * (180/M_PI); break;}
+			default: return (STAT_EXPRESSION_SYNTAX_ERROR);
+		}
+	}
+	*value = stack[0];
+	return (STAT_OK);
+}
+
+static stat_t _parse_expression_word(char letter, char_t *str, char_t **end)
+{
+	float value;
+
+	ritorno(_compile_value(str, end));
+	if ((ex.variable == true) && (oc.record_state != O_RECORD_OFF)) {
+		return (_record_expression_word(letter, 0));
+	}
+	ritorno(_evaluate(ex.code, ex.len, &value));
+	return (_load_gcode_word(letter, value));
+}
+
+static stat_t _parse_assignment(char_t *str, char_t **end)
+{
+	uint16_t number;
+	float value;
+
+	ex.len = 0;
+	ex.depth = 0;
+	ex.nest = 0;
+	ritorno(_compile_parameter(&str, &number));	// compiled only to get the number
+	if (((number < 1) || (number > GC_PARAMETERS)) && ((number & EX_NAMED) == 0)) {
+		return (STAT_PARAMETER_INVALID);		// indirect, #0 or read only
+	}
+	str = _skip_space(str);
+	if (*str != '=') return (STAT_EXPRESSION_SYNTAX_ERROR);
+	ritorno(_compile_value(str+1, end));
+	if (oc.record_state != O_RECORD_OFF) {
+		return (_record_expression_word('#', number));
+	}
+	if (gp.assignments == GC_ASSIGNMENTS) return (STAT_EXPRESSION_TOO_COMPLEX);
+	ritorno(_evaluate(ex.code, ex.len, &value));
+	gp.assign_number[gp.assignments] = number;
+	gp.assign_value[gp.assignments++] = value;
+	return (STAT_OK);
+}
+
+static void _apply_assignments()
+{
+	for (uint8_t i=0; i<gp.assignments; i++) {
+		_set_parameter(gp.assign_number[i], gp.assign_value[i]);
+	}
+}
+
+/*
+ * _record_expression_word() - store a word whose value is compiled code
+ * _stored_word_slots()		 - 5 byte slots a stored word takes
+ * _run_stored_word()		 - load a stored word into the GN/GF structs, running its code if it has any
+ *
+ *	A word with code is stored as its letter with EX_STORED set, the code length and the
+ *	code, padded to whole 5 byte slots. A parameter setting is stored as letter '#' with the
+ *	parameter number ahead of the code.
+ */
+static stat_t _record_expression_word(char letter, uint16_t number)
+{
+	uint8_t len = ex.len + ((letter == '#') ? sizeof(uint16_t) : 0);
+	uint8_t slots = (2 + len + 4) / 5;
+
+	if ((oc.overflow == true) || (gp.record_wr + slots*5 > O_WORD_CACHE_SIZE)) {
+		oc.overflow = true;
+		return (STAT_O_WORD_CACHE_FULL);
+	}
+	uint8_t *wr = &oc.cache[gp.record_wr];
+	*wr++ = (uint8_t)letter | EX_STORED;
+	*wr++ = len;
+	if (letter == '#') {
+		memcpy(wr, &number, sizeof(uint16_t));
+		wr += sizeof(uint16_t);
+	}
+	memcpy(wr, ex.code, ex.len);
+	gp.record_wr += slots*5;
+	return (STAT_OK);
+}
+
+static uint8_t _stored_word_slots(const uint8_t *word)
+{
+	return (((word[0] & EX_STORED) == 0) ? 1 : (2 + word[1] + 4) / 5);
+}
+
+static stat_t _run_stored_word(const uint8_t *word)
+{
+	float value;
+	char letter = (char)(word[0] & ~EX_STORED);
+
+	if ((word[0] & EX_STORED) == 0) {
+		memcpy(&value, &word[1], sizeof(float));
+		return (_parse_gcode_word(letter, value));
+	}
+	if (letter == '#') {
+		uint16_t number;
+		memcpy(&number, &word[2], sizeof(uint16_t));
+		if (gp.assignments == GC_ASSIGNMENTS) return (STAT_EXPRESSION_TOO_COMPLEX);
+		ritorno(_evaluate(&word[4], word[1] - sizeof(uint16_t), &value));
+		gp.assign_number[gp.assignments] = number;
+		gp.assign_value[gp.assignments++] = value;
+		return (STAT_OK);
+	}
+	ritorno(_evaluate(&word[2], word[1], &value));
+	return (_parse_gcode_word(letter, value));
+}
+
+/***********************************************************************************
+ * O WORD SUBROUTINES AND LOOPS
+ ***********************************************************************************/
+
+/*
+ * _parse_o_word() - run an O word subroutine or loop statement
+ *
+ *	Subroutines and loops are stored parsed, so they can be run again without being
+ *	sent or tokenized again. The statements are the LinuxCNC ones:
+ *
+ *		o100 sub			- store subroutine 100 - blocks up to the endsub are not run
+ *		o100 endsub			- end of subroutine 100
+ *		o100 call			- run subroutine 100
+ *		o101 repeat [5]		- store the blocks up to the endrepeat
+ *		o101 endrepeat		- end of the loop - it runs 5 times from here
+ *
+ *	Blocks are stored in oc.cache as a word count followed by the words as letter and
+ *	float (the same 5 byte words as Gcode frames). A word whose value reads parameters is
+ *	stored as its compiled code over as many 5 byte slots as it needs, and counts as that
+ *	many words. gc_replay_callback() runs the stored blocks one per pass of the controller
+ *	loop and holds off new input until it's done.
+ *
+ *	Comments and messages are not stored. Subroutines and loops cannot be nested, and a
+ *	subroutine that is defined again replaces the old one and any defined after it.
+ *
+ *	A call to a subroutine that is not defined runs the stored program with that number
+ *	from program memory, if there is one (see xio_file.h). Its blocks are replayed the
+ *	same way, so a stored program runs with no parsing and no host connected.
+ */
+static uint8_t _o_keyword(char_t **str, const char *keyword)
+{
+	char_t *rd = *str;
+	for ( ; *keyword != NUL; keyword++, rd++) {
+		if (tolower((char)*rd) != *keyword) return (false);
+	}
+	*str = rd;
+	return (true);
+}
+
+static uint8_t _find_subroutine(uint16_t number)
+{
+	uint8_t i;
+	for (i=0; i<oc.sub_count; i++) {
+		if (oc.sub[i].number == number) break;
+	}
+	return (i);
+}
+
+static void _start_replay(uint16_t start, uint16_t end, uint16_t repeats, uint8_t discard)
+{
+	oc.program_P = NULL;
+	oc.replay_start = start;
+	oc.replay_end = end;
+	oc.rd = start;
+	oc.replay_discard = discard;
+	oc.repeats = (start < end) ? repeats : 0;
+	if ((oc.repeats == 0) && (discard == true)) oc.wr = start;
+}
+
+static stat_t _parse_o_word(char_t *buf)
+{
+	char_t *rd;
+	float value = parse_float(buf, &rd);
+	if ((rd == buf) || (value < 0)) return (STAT_BAD_NUMBER_FORMAT);
+	uint16_t number = (uint16_t)value;
+	while (isspace((char)*rd)) { rd++; }
+
+	if (_o_keyword(&rd, "endsub")) {
+		if ((oc.record_state != O_RECORD_SUB) || (oc.number != number)) return (STAT_O_WORD_IS_INVALID);
+		oc.record_state = O_RECORD_OFF;
+		if (oc.overflow == true) {
+			oc.wr = oc.sub[oc.sub_count].start;			// drop the partial subroutine
+			return (STAT_O_WORD_CACHE_FULL);
+		}
+		oc.sub[oc.sub_count].number = number;
+		oc.sub[oc.sub_count++].end = oc.wr;
+		return (STAT_OK);
+	}
+	if (_o_keyword(&rd, "endrepeat")) {
+		if ((oc.record_state != O_RECORD_REPEAT) || (oc.number != number)) return (STAT_O_WORD_IS_INVALID);
+		oc.record_state = O_RECORD_OFF;
+		if (oc.overflow == true) {
+			oc.wr = oc.loop_start;
+			return (STAT_O_WORD_CACHE_FULL);
+		}
+		_start_replay(oc.loop_start, oc.wr, oc.loop_count, true);
+		return (STAT_OK);
+	}
+	if (oc.record_state != O_RECORD_OFF) return (STAT_O_WORD_IS_INVALID);	// no nesting
+
+	uint8_t record_state;
+	if (_o_keyword(&rd, "sub")) {
+		uint8_t i = _find_subroutine(number);
+		if (i < oc.sub_count) {							// replace it and any defined after it
+			oc.sub_count = i;
+			oc.wr = oc.sub[i].start;
+		}
+		if (oc.sub_count >= O_WORD_SUBROUTINES) return (STAT_O_WORD_CACHE_FULL);
+		oc.sub[oc.sub_count].start = oc.wr;
+		record_state = O_RECORD_SUB;
+	} else if (_o_keyword(&rd, "repeat")) {
+		char_t *end;
+		float count;
+		ritorno(_compile_value(rd, &end));
+		ritorno(_evaluate(ex.code, ex.len, &count));
+		if (count < 0) return (STAT_BAD_NUMBER_FORMAT);
+		oc.loop_start = oc.wr;
+		oc.loop_count = (uint16_t)count;
+		record_state = O_RECORD_REPEAT;
+	} else if (_o_keyword(&rd, "call")) {
+		uint8_t i = _find_subroutine(number);
+		if (i < oc.sub_count) {
+			_start_replay(oc.sub[i].start, oc.sub[i].end, 1, false);
+			return (STAT_OK);
+		}
+		if ((oc.program_P = xio_open_pgm_program(number)) == NULL) return (STAT_O_WORD_NOT_DEFINED);
+		oc.repeats = 1;									// replayed until its end marker
+		return (STAT_OK);
+	} else {
+		return (STAT_O_WORD_IS_INVALID);
+	}
+	oc.record_state = record_state;
+	oc.number = number;
+	oc.overflow = false;
+	return (STAT_OK);
+}
+
+/*
+ * _load_gcode_word() - load a word into the GN/GF structs, or store it if recording
+ * _record_gcode_block() - keep the block being recorded (blocks with no words are dropped)
+ */
+static stat_t _load_gcode_word(char letter, float value)
+{
+	if (ra.filling == true) {						// room was reserved by _read_ahead_slot()
+		ra.buf[ra.word_wr] = (uint8_t)letter;
+		memcpy(&ra.buf[ra.word_wr+1], &value, sizeof(float));
+		ra.word_wr += 5;
+		return (STAT_OK);
+	}
+	if (oc.record_state == O_RECORD_OFF) {
+		return (_parse_gcode_word(letter, value));
+	}
+	if ((oc.overflow == true) || (gp.record_wr + 5 > O_WORD_CACHE_SIZE)) {
+		oc.overflow = true;
+		return (STAT_O_WORD_CACHE_FULL);
+	}
+	oc.cache[gp.record_wr] = (uint8_t)letter;
+	memcpy(&oc.cache[gp.record_wr+1], &value, sizeof(float));
+	gp.record_wr += 5;
+	return (STAT_OK);
+}
+
+static stat_t _record_gcode_block()
+{
+	uint8_t words = (gp.record_wr - oc.wr - 1) / 5;
+	if ((words != 0) && (oc.overflow == false)) {
+		oc.cache[oc.wr] = words;
+		oc.wr = gp.record_wr;
+	}
+	return (STAT_OK);
+}
+
+/*
+ * gc_replay_callback() - run the next stored block of a subroutine, loop or stored program
+ * gc_abort_replay()	- stop a subroutine, loop or stored program (queue flush)
+ *
+ *	Called from the controller loop once the planner has full headroom for a block. An error in
+ *	a stored block is reported and the replay carries on, as it would if the block had
+ *	been sent. An alarm stops the replay.
+ */
+stat_t gc_replay_callback()
+{
+	if (oc.repeats == 0)
+		return (STAT_NOOP);
+
+	if (cm.machine_state == MACHINE_ALARM) {
+		gc_abort_replay();
+		return (STAT_NOOP);
+	}
+	if (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false)
+		return (STAT_EAGAIN);							// stored blocks are not sized (see gc_block_headroom())
+
+	stat_t status = STAT_OK;
+	uint8_t *block = &oc.cache[oc.rd];
+	uint8_t words;
+
+	if (oc.program_P != NULL) {
+		if ((words = xio_read_pgm_block(&oc.program_P, oc.block)) == 0) {
+			gc_abort_replay();							// end of the stored program
+			return (STAT_OK);
+		}
+		block = oc.block;
+	} else {
+		words = block[0];
+		oc.rd += 1 + words*5;
+	}
+	nv_reset_nv_list();
+	_reset_gcode_block();
+	for (block++; words > 0; ) {
+		uint8_t slots = _stored_word_slots(block);
+		if (status == STAT_OK) status = _run_stored_word(block);
+		words -= min(slots, words);
+		block += slots*5;
+	}
+	if (status == STAT_OK) _apply_assignments();
+	if (status == STAT_OK) status = _validate_gcode_block();
+	if (status == STAT_OK) status = _execute_gcode_block();
+	rpt_exception(status);
+
+	if (oc.program_P != NULL) return (STAT_EAGAIN);
+	if (oc.rd >= oc.replay_end) {
+		oc.rd = oc.replay_start;
+		if (--oc.repeats == 0) {
+			gc_abort_replay();
+			return (STAT_OK);
+		}
+	}
+	return (STAT_EAGAIN);
+}
+
+void gc_abort_replay()
+{
+	if (oc.replay_discard == true) {
+		oc.wr = oc.replay_start;						// loop bodies are run once and dropped
+		oc.replay_discard = false;
+	}
+	oc.program_P = NULL;
+	oc.repeats = 0;
+}
+
+/*
+ * gc_reading_ahead()		- return true if new blocks go into the read-ahead FIFO
+ * gc_read_ahead_has_room() - return true if a new line may be read for the FIFO
+ * gc_read_ahead_accepts()	- return true if the block can be read ahead now
+ * gc_read_ahead_callback() - run the next block read ahead once the planner has room
+ * gc_flush_read_ahead()	- drop the blocks read ahead (queue flush)
+ *
+ *	When the planner is short of headroom the controller keeps reading lines instead of
+ *	stalling. Plain Gcode blocks are tokenized into a small FIFO in the same 5 byte words
+ *	as stored subroutines, and replayed from it as soon as a buffer frees. This moves the
+ *	tokenizing and number conversion into slack time, and a freed buffer is refilled with
+ *	no parsing. Blocks are read ahead while any are waiting, so they run in the order sent.
+ *
+ *	The reply to a block read ahead is sent when it is stored. Errors found when it runs
+ *	are reported as exceptions, as for replayed blocks. An alarm drops the FIFO.
+ *
+ *	Only blocks that can run later unchanged are read ahead. O words, messages, parameters
+ *	and expressions, blocks sent while a subroutine or loop is recorded or replayed, and
+ *	all non-Gcode lines are held back by the controller until the FIFO is empty and the
+ *	planner has room.
+ *	Each block reserves 5 bytes for every letter in it so the words always fit.
+ */
+uint8_t gc_reading_ahead()
+{
+	return ((ra.blocks != 0) || (mp_planner_has_headroom(mp_get_line_headroom()) == false));
+}
+
+static int16_t _read_ahead_fit(uint16_t len)
+{
+	if (ra.blocks == 0) {
+		return ((len <= GC_READ_AHEAD_SIZE) ? 0 : -1);
+	}
+	if (ra.wr > ra.rd) {
+		if (ra.wr + len <= GC_READ_AHEAD_SIZE) return (ra.wr);
+		if (len <= ra.rd) return (0);					// wraps to the start
+		return (-1);
+	}
+	if (ra.wr + len <= ra.rd) return (ra.wr);
+	return (-1);
+}
+
+static int16_t _read_ahead_slot(const char_t *block)
+{
+	if ((oc.record_state != O_RECORD_OFF) || (oc.repeats != 0)) return (-1);
+
+	const char_t *rd = block;
+	while (isspace((char)*rd)) { rd++; }
+	if ((*rd == 'o') || (*rd == 'O')) return (-1);
+
+	uint16_t letters = 0;
+	for ( ; *rd != NUL; rd++) {
+		if ((*rd == '(') || (*rd == ';')) {				// comments end the block...
+			if (_is_message(rd+1) == true) {
+				return (-1);							// ...and messages are queued as they are parsed
+			}
+			break;
+		}
+		if ((*rd == '#') || (*rd == '[')) return (-1);	// parameters may be set by blocks not yet run
+		if (isalpha((char)*rd)) letters++;
+	}
+	return (_read_ahead_fit(1 + letters*5));
+}
+
+uint8_t gc_read_ahead_has_room()
+{
+	return ((oc.record_state == O_RECORD_OFF) && (oc.repeats == 0) && (_read_ahead_fit(1 + 5) >= 0));
+}
+
+uint8_t gc_read_ahead_accepts(const char_t *block)
+{
+	return (_read_ahead_slot(block) >= 0);
+}
+
+static stat_t _read_ahead_gcode_block(char_t *block)
+{
+	int16_t slot = _read_ahead_slot(block);
+	if (slot < 0) return (STAT_COMMAND_NOT_ACCEPTED);	// the controller holds these back
+
+	ra.slot = (uint8_t)slot;
+	ra.word_wr = ra.slot + 1;
+	ra.filling = true;
+	stat_t status = _parse_gcode_block(block);
+	ra.filling = false;
+	return (status);
+}
+
+static stat_t _queue_read_ahead_block()
+{
+	uint8_t words = (ra.word_wr - ra.slot - 1) / 5;
+	if (words == 0) return (STAT_OK);					// nothing to run
+	if ((ra.slot != ra.wr) && (ra.wr < GC_READ_AHEAD_SIZE)) {
+		ra.buf[ra.wr] = 0;								// wrapped - mark the end for the reader
+	}
+	ra.buf[ra.slot] = words;
+	ra.wr = ra.word_wr;
+	ra.blocks++;
+	return (STAT_OK);
+}
+
+stat_t gc_read_ahead_callback()
+{
+	if (ra.blocks == 0)
+		return (STAT_NOOP);
+
+	if (cm.machine_state == MACHINE_ALARM) {
+		gc_flush_read_ahead();
+		return (STAT_NOOP);
+	}
+	if ((cm.cycle_state == CYCLE_JOG) || (cm.cycle_state == CYCLE_TUNE))
+		return (STAT_NOOP);
+
+	if ((ra.rd >= GC_READ_AHEAD_SIZE) || (ra.buf[ra.rd] == 0)) ra.rd = 0;	// wrapped
+	uint8_t *block = &ra.buf[ra.rd];
+	if (mp_planner_has_headroom(_stored_block_headroom(block)) == false)
+		return (STAT_NOOP);								// lines can still be read ahead meanwhile
+
+	uint8_t words = block[0];
+	ra.rd += 1 + words*5;
+	if (--ra.blocks == 0) gc_flush_read_ahead();		// start over at the front
+
+	stat_t status = STAT_OK;
+	nv_reset_nv_list();
+	_reset_gcode_block();
+	for (block++; words > 0; words--, block += 5) {
+		float value;
+		memcpy(&value, &block[1], sizeof(float));
+		if (status == STAT_OK) status = _parse_gcode_word((char)block[0], value);
+	}
+	if (status == STAT_OK) status = _validate_gcode_block();
+	if (status == STAT_OK) status = _execute_gcode_block();
+	rpt_exception(status);
+	return (STAT_OK);
+}
+
+void gc_flush_read_ahead()
+{
+	ra.blocks = 0;
+	ra.rd = 0;
+	ra.wr = 0;
+}
+
+/*
+ * gc_block_headroom()		- return the planner buffers to reserve before a text block runs
+ * _stored_block_headroom() - the same for a block of stored words (read ahead FIFO)
+ * _word_headroom()			- buffers a word adds to those of a line move
+ * _is_message()			- return true if a comment is a (MSG...) that gets queued
+ *
+ *	A line move takes mp_get_line_headroom() buffers - one for a plain G1 stream. Every M,
+ *	S or T word, dwell or G92 can queue a command with it, and so can a message. Arcs,
+ *	splines, canned cycles, G28/G30, probing, homing and any G code not known to only set
+ *	a mode reserve PLANNER_BUFFER_HEADROOM, as does an O word. The result is capped at
+ *	PLANNER_BUFFER_HEADROOM, which was reserved for every line before.
+ *
+ *	The text is scanned without converting the numbers - only the integer part of a G
+ *	word is read - so the scan costs little next to parsing the block.
+ */
+uint8_t gc_block_headroom(const char_t *block)
+{
+	uint8_t buffers = mp_get_line_headroom();
+
+	for (const char_t *rd = block; *rd != NUL; rd++) {
+		if ((*rd == '(') || (*rd == ';')) {				// comments end the block
+			if (_is_message(rd+1) == true) buffers++;
+			break;
+		}
+		if (isalpha((char)*rd) == false) continue;
+
+		char letter = (char)toupper((char)*rd);
+		uint16_t number = 0;
+		if (letter == 'G') {
+			while (isspace((char)*(rd+1))) { rd++; }
+			while (isdigit((char)*(rd+1))) {
+				number = min(number * 10 + (*(++rd) - '0'), 100);
+			}
+		}
+		if ((buffers += _word_headroom(letter, (uint8_t)number)) >= PLANNER_BUFFER_HEADROOM) {
+			return (PLANNER_BUFFER_HEADROOM);
+		}
+	}
+	return (min(buffers, PLANNER_BUFFER_HEADROOM));
+}
+
+static uint8_t _stored_block_headroom(const uint8_t *block)
+{
+	uint8_t buffers = mp_get_line_headroom();
+	uint8_t words = block[0];
+
+	for (block++; words > 0; words--, block += 5) {
+		float value;
+		memcpy(&value, &block[1], sizeof(float));
+		uint8_t number = ((value >= 0) && (value < 100)) ? (uint8_t)value : 100;
+		if ((buffers += _word_headroom((char)block[0], number)) >= PLANNER_BUFFER_HEADROOM) {
+			return (PLANNER_BUFFER_HEADROOM);
+		}
+	}
+	return (buffers);
+}
+
+static uint8_t _word_headroom(char letter, uint8_t number)
+{
+	switch (letter) {
+		case 'M': case 'S': case 'T': return (1);		// queued commands
+		case 'O': return (PLANNER_BUFFER_HEADROOM);
+		case 'G': {
+			switch (number) {
+				case 0: case 1: case 17: case 18: case 19: case 20: case 21: case 40: case 49:
+				case 53: case 54: case 55: case 56: case 57: case 58: case 59: case 61: case 64:
+				case 80: case 90: case 91: case 93: case 94: case 187: return (0);
+				case 4: case 92: return (1);
+				default: return (PLANNER_BUFFER_HEADROOM);
+			}
+		}
+	}
+	return (0);
+}
+
+static uint8_t _is_message(const char_t *com)
+{
+	while (isspace((char)*com)) { com++; }
+	return ((tolower(*com) == 'm') && (tolower(*(com+1)) == 's') && (tolower(*(com+2)) == 'g'));
+}
 
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
@@ -542,6 +1949,9 @@ stat_t gc_get_gc(nvObj_t *nv)
 
 stat_t gc_run_gc(nvObj_t *nv)
 {
+	if ((cs.pendant_json == true) && (cm_get_machine_state() == MACHINE_CYCLE)) {
+		return (STAT_COMMAND_NOT_ACCEPTED);			// pendant Gcode would land in the middle of the primary's moves
+	}
 	return(gc_gcode_parser(*nv->stringp));
 }
 
@@ -24,10 +24,54 @@
 extern "C"{
 #endif
 
+/*
+ * O word subroutines and loops - see _parse_o_word()
+ */
+#define O_WORD_CACHE_SIZE 512			// bytes of RAM for the parsed blocks of subroutines and loops
+#define O_WORD_SUBROUTINES 4			// subroutines that can be defined at one time
+
+/*
+ * Parameters and expressions - see _compile_value()
+ */
+#define GC_PARAMETERS 32				// numbered parameters #1 to #32
+#define GC_NAMED_PARAMETERS 8			// named parameters (#<name>) that can be defined
+#define GC_NAME_LEN 12					// chars of a parameter name, including the NUL
+#define GC_EXPR_CODE_SIZE 64			// bytes of compiled code for one word value
+#define GC_EXPR_STACK 8					// evaluation stack depth
+#define GC_EXPR_NEST 6					// brackets and functions that can be nested
+#define GC_ASSIGNMENTS 4				// parameter assignments in one block
+
+/*
+ * Read-ahead of blocks parsed while the planner is full - see gc_read_ahead_callback()
+ */
+#define GC_READ_AHEAD_SIZE 128			// bytes of RAM for parsed blocks waiting for the planner (255 max)
+
+/*
+ * Tokens returned by gc_next_word()
+ */
+enum gcToken {
+	GC_TOKEN_END = 0,					// end of the block, or a comment that is not a message
+	GC_TOKEN_WORD,						// letter and number
+	GC_TOKEN_EXPRESSION,				// letter with a parameter or expression value
+	GC_TOKEN_ASSIGNMENT,				// #n=... parameter setting
+	GC_TOKEN_MESSAGE,					// (MSG comment - ends the block
+	GC_TOKEN_BAD						// a number with no letter
+};
+
 /*
  * Global Scope Functions
  */
 stat_t gc_gcode_parser(char_t *block);
+uint8_t gc_next_word(char_t **str, char *letter, float *value);
+stat_t gc_gcode_frame_parser(char_t *frame);
+stat_t gc_replay_callback(void);
+void gc_abort_replay(void);
+uint8_t gc_reading_ahead(void);
+uint8_t gc_read_ahead_has_room(void);
+uint8_t gc_read_ahead_accepts(const char_t *block);
+stat_t gc_read_ahead_callback(void);
+void gc_flush_read_ahead(void);
+uint8_t gc_block_headroom(const char_t *block);
 stat_t gc_get_gc(nvObj_t *nv);
 stat_t gc_run_gc(nvObj_t *nv);
 
@@ -26,7 +26,9 @@
  */
 
 #ifdef __AVR
+#include <avr/interrupt.h>
 #include <avr/wdt.h>			// used for software reset
+#include <avr/sleep.h>			// used for idle sleep
 #endif
 
 #include "tinyg.h"		// #1
@@ -34,7 +36,11 @@
 #include "hardware.h"
 #include "switch.h"
 #include "controller.h"
+#include "persistence.h"
 #include "text_parser.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "xio.h"
 #ifdef __AVR
 #include "xmega/xmega_init.h"
 #include "xmega/xmega_rtc.h"
@@ -82,6 +88,164 @@ void hardware_init()
 	xmega_init();							// set system clock
 	_port_bindings(TINYG_HARDWARE_VERSION);
 	rtc_init();								// real time counter
+	TIMER_5.CNT = 0;						// start the boot stopwatch
+	TIMER_5.PER = 0xFFFF;
+	TIMER_5.CTRLA = BOOT_TIMER_ENABLE;
+#endif
+}
+
+/*
+ * Memory monitoring
+ *
+ * hw_paint_stack()		 - fill the free RAM with STACK_PAINT before anything runs
+ * hw_get_free_ram()	 - bytes between the end of static data and the stack now
+ * hw_get_min_free_ram() - fewest free bytes there have been since reset
+ *
+ *	Painting runs from .init1, before the stack is used (the xmega resets SP to the top
+ *	of RAM) and before .data and .bss are set up below _end. The stack grows down over
+ *	the paint, so the intact paint just above _end is what the deepest stack has left.
+ *	There is no heap - nothing calls malloc().
+ */
+
+#ifdef __AVR
+extern uint8_t __data_start;			// these are set by the linker
+extern uint8_t _end;
+extern uint8_t __stack;
+
+void hw_paint_stack(void) __attribute__ ((naked, used, section(".init1")));
+void hw_paint_stack(void)
+{
+	__asm volatile (
+		"	ldi r30, lo8(_end)		\n"
+		"	ldi r31, hi8(_end)		\n"
+		"	ldi r24, %0				\n"
+		"	ldi r25, hi8(__stack)	\n"
+		"	rjmp 2f					\n"
+		"1:	st Z+, r24				\n"
+		"2:	cpi r30, lo8(__stack)	\n"
+		"	cpc r31, r25			\n"
+		"	brlo 1b					\n"
+		"	breq 1b					\n"
+		:: "M" (STACK_PAINT));
+}
+#endif
+
+uint16_t hw_get_free_ram()
+{
+#ifdef __AVR
+	uint8_t top;						// a local is as deep as the stack is now
+	return ((uint16_t)(&top - &_end));
+#else
+	return (0);
+#endif
+}
+
+uint16_t hw_get_min_free_ram()
+{
+#ifdef __AVR
+	uint8_t *p = &_end;
+	while ((p < &__stack) && (*p == STACK_PAINT)) { p++; }
+	return ((uint16_t)(p - &_end));
+#else
+	return (0);
+#endif
+}
+
+/*
+ * hw_get_boot_time() - return ms from hardware_init() to hw_timebase_init()
+ *
+ *	Interrupts are off for the whole application init so SysTick can't time the boot.
+ *	Instead TIMER_5 runs as a stopwatch from hardware_init() until hw_timebase_init()
+ *	reads it and takes the timer over. Reported in the system ready message.
+ */
+
+uint16_t hw_get_boot_time()
+{
+	return (hw.boot_time);
+}
+
+/*
+ * hw_timebase_init() - start the free-running microsecond timebase
+ *
+ *	TIMER_5 counts F_CPU and wraps every 2.048 ms. The overflow interrupt extends it to
+ *	32 bits of microseconds, which wrap after about 71 minutes - so only use differences.
+ *	The same counter serves the __ISR_TIMING cycle accounting. Call just before sei()
+ *	so the overflow interrupt is serviced from the start.
+ */
+
+void hw_timebase_init()
+{
+#ifdef __AVR
+	hw.boot_time = (uint16_t)(TIMER_5.CNT / BOOT_TIMER_TICKS_PER_MS);
+	TIMER_TIMEBASE.CTRLA = 0;
+	TIMER_TIMEBASE.CNT = 0;
+	TIMER_TIMEBASE.PER = TIMEBASE_TIMER_PERIOD;
+	TIMER_TIMEBASE.INTFLAGS = TC1_OVFIF_bm;		// clear any overflow left by the stopwatch
+	TIMER_TIMEBASE.INTCTRLA = TIMER_TIMEBASE_INTLVL;
+	hw.timebase_overflows = 0;
+	TIMER_TIMEBASE.CTRLA = TIMEBASE_TIMER_ENABLE;
+#endif
+}
+
+#ifdef __AVR
+ISR(TIMER_TIMEBASE_ISR_vect)
+{
+	hw.timebase_overflows++;
+}
+#endif
+
+/*
+ * hw_get_usec() - return the timebase in microseconds
+ *
+ *	Safe from any interrupt level. If the timer has wrapped but the overflow interrupt
+ *	has not run yet (interrupts masked, or a higher level ISR is running) the pending
+ *	flag is counted here. A low count with the flag set means the wrap came first.
+ */
+
+uint32_t hw_get_usec()
+{
+#ifdef __AVR
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t count = TIMER_TIMEBASE.CNT;
+	uint32_t overflows = hw.timebase_overflows;
+	if ((TIMER_TIMEBASE.INTFLAGS & TC1_OVFIF_bm) && (count < (TIMEBASE_TIMER_PERIOD / 2))) {
+		overflows++;
+	}
+	SREG = sreg;
+	return (overflows * TIMEBASE_USEC_PER_OVERFLOW + (count >> TIMEBASE_TICKS_SHIFT));
+#else
+	return (0);
+#endif
+}
+
+/*
+ * hw_sleep() - sleep the CPU until the next interrupt unless an event is pending
+ *
+ *	The events are tested with interrupts off, so an ISR that posts one after the test
+ *	still ends the sleep: on the AVR the instruction after sei() runs before any ISR,
+ *	and on the ARM WFI wakes on an interrupt that is pending but masked.
+ */
+
+void hw_sleep(volatile uint8_t *events)
+{
+#ifdef __AVR
+	cli();
+	if (*events == 0) {
+		set_sleep_mode(SLEEP_SMODE_IDLE_gc);
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+#endif
+#ifdef __ARM
+	__disable_irq();
+	if (*events == 0) {
+		__WFI();
+	}
+	__enable_irq();
 #endif
 }
 
@@ -168,6 +332,7 @@ stat_t hw_hard_reset_handler(void)
 {
 	if (cs.hard_reset_requested == false)
         return (STAT_NOOP);
+	persistence_flush();			// commit any staged config writes first
 	hw_hard_reset();				// hard reset - identical to hitting RESET button
 	return (STAT_EAGAIN);
 }
@@ -177,6 +342,9 @@ stat_t hw_hard_reset_handler(void)
  *
  * hw_request_bootloader()
  * hw_request_bootloader_handler() - executes a software reset using CCPWrite
+ *
+ *	The software reset is the bootloader request. With ENTER_DELAY_ON_REQUEST xboot waits
+ *	for the updater only after it, and jumps straight back in on any other reset.
  */
 
 void hw_request_bootloader() { cs.bootloader_requested = true;}
@@ -213,6 +381,35 @@ stat_t hw_get_id(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+/*
+ * hw_get_mem() - get a memory usage readout, picked by the last letter of the token
+ *
+ *	memf/meml are the free RAM now and the least since reset. memd is all static data.
+ *	The rest are the static allocations of the subsystems whose buffers are sized by hand.
+ */
+
+stat_t hw_get_mem(nvObj_t *nv)
+{
+	char_t tmp[TOKEN_LEN+1];
+
+	strncpy_P(tmp, cfgArray[nv->index].token, TOKEN_LEN);
+	switch (tmp[3]) {
+		case 'f': { nv->value = hw_get_free_ram(); break; }
+		case 'l': { nv->value = hw_get_min_free_ram(); break; }
+#ifdef __AVR
+		case 'd': { nv->value = (uint16_t)(&_end - &__data_start); break; }
+#endif
+		case 'p': { nv->value = sizeof(mb) + sizeof(mm) + sizeof(mr); break; }	// planner queue and singletons
+		case 'v': { nv->value = sizeof(nvl) + sizeof(nvStr); break; }			// config object list and strings
+		case 'x': { nv->value = sizeof(ds) + sizeof(us) + sizeof(spi) + sizeof(fs); break; }	// xio incl. USART buffers
+		case 'c': { nv->value = sizeof(cs); break; }							// controller incl. in_buf and saved_buf
+		case 'm': { nv->value = sizeof(cm); break; }							// canonical machine
+		default:  { nv->value = 0; }
+	}
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
 /*
  * hw_run_boot() - invoke boot form the cfgArray
  */
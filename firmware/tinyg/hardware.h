@@ -198,12 +198,19 @@ enum cfgPortBits {			// motor control port bit positions
 #define TIMER_LOAD			TCE0		// Loader timer	(see stepper.h)
 #define TIMER_EXEC			TCF0		// Exec timer	(see stepper.h)
 #define TIMER_5				TCC1		// unallocated timer
+#define TIMER_TIMEBASE		TIMER_5		// free-running microsecond timebase (see hardware.c)
+#define TIMER_CYCLES		TIMER_5		// the timebase doubles as the __ISR_TIMING cycle counter (see stepper.c)
 #define TIMER_PWM1			TCD1		// PWM timer #1 (see pwm.c)
 #define TIMER_PWM2			TCE1		// PWM timer #2	(see pwm.c)
+#define TIMER_QDEC			TIMER_PWM2	// quadrature decoder if __ENCODER_QDEC is enabled (see encoder.c)
 
 /* Timer setup for stepper and dwells */
 
 #define FREQUENCY_DDA 		(float)50000	// DDA frequency in hz.
+#define FREQUENCY_DDA_MIN	(float)5000		// lowest DDA frequency of a variable rate segment (see stepper.h)
+#define FREQUENCY_DDA_MAX	(float)75000	// highest - the DDA interrupt takes most of the CPU above this
+#define STEP_PULSE_USEC		2				// step pulse width if __STEP_PULSE_COMPARE is enabled (see stepper.h)
+#define STEP_PULSE_CYCLES	(STEP_PULSE_USEC * (F_CPU / 1000000))	// the DDA timer runs at F_CPU
 #define FREQUENCY_DWELL		(float)10000	// Dwell count frequency in hz.
 #define LOAD_TIMER_PERIOD 	100				// cycles you have to shut off SW interrupt
 #define EXEC_TIMER_PERIOD 	100				// cycles you have to shut off SW interrupt
@@ -222,19 +229,49 @@ enum cfgPortBits {			// motor control port bit positions
 #define EXEC_TIMER_ENABLE	1				// turn exec timer clock on (F_CPU = 32 Mhz)
 #define EXEC_TIMER_WGMODE	0				// normal mode (count to TOP and rollover)
 
+#define TIMEBASE_TIMER_ENABLE 1				// turn timebase clock on (F_CPU = 32 Mhz)
+#define TIMEBASE_TIMER_PERIOD 0xFFFF		// count the full 16 bits (wraps every 2.048 ms)
+#define TIMEBASE_TICKS_SHIFT 5				// 32 timer ticks per microsecond
+#define TIMEBASE_USEC_PER_OVERFLOW 2048		// microseconds per timer wrap
+
+#define BOOT_TIMER_ENABLE	7				// boot stopwatch clock (F_CPU/1024 = 31.25 KHz, wraps after 2 s)
+#define BOOT_TIMER_TICKS_PER_MS 31.25		// boot stopwatch ticks per millisecond
+
+/* Quadrature encoder input (__ENCODER_QDEC) */
+
+#define PORT_QDEC			PORTB			// phase A on pin 0, phase B on pin 1 (PB3 is SPI SS2)
+#define QDEC_PINS_bm		0x03
+#define QDEC_EVSYS_CHMUX	EVSYS_CHMUX_PORTB_PIN0_gc	// event channel 0 can decode quadrature
+#define QDEC_EVSYS_FILTER	EVSYS_DIGFILT_4SAMPLES_gc	// reject edges shorter than 4 CPU cycles
+#define QDEC_TIMER_ENABLE	1				// count the decoder on every CPU clock
+
+/* Analog inputs (__ANALOG) */
+
+#define ANALOG_ADC			ADCB			// ADC on the PORTB pins
+#define ANALOG_PORT			PORTB
+#define ANALOG_ADC_PRESCALER ADC_PRESCALER_DIV256_gc	// 125 KHz ADC clock - about 4 KHz sweeps
+#define ANALOG_DMA_CH		CH3				// shared with the SPI slave (see xio_spi.h)
+#define ANALOG_DMA_TRIGSRC	DMA_CH_TRIGSRC_ADCB_CH0_gc	// combined request of the sweep (ADC_DMASEL_CH0123_gc)
+
 #define TIMER_DDA_ISR_vect	TCC0_OVF_vect	// must agree with assignment in system.h
+#define TIMER_DDA_CCA_ISR_vect TCC0_CCA_vect	// ends the step pulses if __STEP_PULSE_COMPARE is enabled
 #define TIMER_DWELL_ISR_vect TCD0_OVF_vect	// must agree with assignment in system.h
 #define TIMER_LOAD_ISR_vect	TCE0_OVF_vect	// must agree with assignment in system.h
 #define TIMER_EXEC_ISR_vect	TCF0_OVF_vect	// must agree with assignment in system.h
+#define TIMER_TIMEBASE_ISR_vect TCC1_OVF_vect	// must agree with TIMER_5 above
 
 #define TIMER_OVFINTLVL_HI	3				// timer interrupt level (3=hi)
 #define	TIMER_OVFINTLVL_MED 2;				// timer interrupt level (2=med)
 #define	TIMER_OVFINTLVL_LO  1;				// timer interrupt level (1=lo)
 
 #define TIMER_DDA_INTLVL 	TIMER_OVFINTLVL_HI
+#define TIMER_DDA_CCA_INTLVL TC_CCAINTLVL_HI_gc	// runs after the DDA interrupt that armed it
 #define TIMER_DWELL_INTLVL	TIMER_OVFINTLVL_HI
 #define TIMER_LOAD_INTLVL	TIMER_OVFINTLVL_HI
 #define TIMER_EXEC_INTLVL	TIMER_OVFINTLVL_LO
+#define TIMER_TIMEBASE_INTLVL TIMER_OVFINTLVL_MED	// a late overflow is caught by hw_get_usec()
+
+#define STACK_PAINT			0xC5			// fill pattern for free RAM (see hw_paint_stack())
 
 
 /**** Device singleton - global structure to allow iteration through similar devices ****/
@@ -255,6 +292,8 @@ typedef struct hmSingleton {
 	PORT_t *st_port[MOTORS];		// bindings for stepper motor ports (stepper.c)
 	PORT_t *sw_port[MOTORS];		// bindings for switch ports (GPIO2)
 	PORT_t *out_port[MOTORS];		// bindings for output ports (GPIO1)
+	uint16_t boot_time;				// ms from hardware_init() to the system ready message
+	volatile uint32_t timebase_overflows;	// wraps of the timebase timer since hw_timebase_init()
 } hwSingleton_t;
 hwSingleton_t hw;
 
@@ -268,10 +307,18 @@ stat_t hw_hard_reset_handler(void);
 void hw_request_bootloader(void);
 stat_t hw_bootloader_handler(void);
 stat_t hw_run_boot(nvObj_t *nv);
+uint16_t hw_get_boot_time(void);
+void hw_timebase_init(void);
+uint32_t hw_get_usec(void);
+void hw_sleep(volatile uint8_t *events);
 
 stat_t hw_set_hv(nvObj_t *nv);
 stat_t hw_get_id(nvObj_t *nv);
 
+uint16_t hw_get_free_ram(void);
+uint16_t hw_get_min_free_ram(void);
+stat_t hw_get_mem(nvObj_t *nv);
+
 #ifdef __TEXT_MODE
 
 	void hw_print_fb(nvObj_t *nv);
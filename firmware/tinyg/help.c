@@ -67,6 +67,7 @@ These commands are active from the command line:\n\
   $h            Show configuration help screen\n\
   $test         List self-tests\n\
   $test=N       Run self-test N\n\
+  $bench        Time the planner, stepper and parser routines (machine idle)\n\
   $home=1       Run a homing cycle\n\
   $defa=1       Restore all settings to \"factory\" defaults\n\
 "));
@@ -130,6 +131,9 @@ Invoke self test by entering $test=N where N is one of:\n\
   $test=11 small moves test\n\
   $test=12 slow moves test\n\
   $test=13 coordinate system offset test (G92, G54-G59)\n\
+  $test=60 cycle time benchmark - mudflap\n\
+  $test=61 cycle time benchmark - braid\n\
+  $test=62 cycle time benchmark - square pocket\n\
 \n\
 Tests assume a centered XY origin and at least 80mm clearance in all directions\n\
 Tests assume Z has at least 40mm posiitive clearance\n\
@@ -31,6 +31,7 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "canonical_machine.h"
+#include "planner.h"
 #include "report.h"
 #include "util.h"
 #include "xio.h"					// for char definitions
@@ -45,15 +46,20 @@ jsSingleton_t js;
 
 /**** local scope stuff ****/
 
+#define _is_json_space(c) (((c) != NUL) && (((c) <= ' ') || ((c) == DEL)))
+
 static stat_t _json_parser_kernal(char_t *str);
-static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth);
-static stat_t _normalize_json_string(char_t *str, uint16_t size);
+static stat_t _json_execute(nvObj_t *nv);
+static void _json_parser_array(char_t *str);
+static uint8_t _json_element_out(uint8_t count, uint8_t strip, uint32_t *check);
+static void _json_array_close(char_t close, stat_t status, uint32_t check);
+static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr);
+static nvObj_t *_filter_response_body(void);
 
 /****************************************************************************
  * json_parser() - exposed part of JSON parser
  * _json_parser_kernal()
- * _normalize_json_string()
- * _get_nv_pair_strict()
+ * _get_nv_pair()
  *
  *	This is a dumbed down JSON parser to fit in limited memory with no malloc
  *	or practical way to do recursion ("depth" tracks parent/child levels).
@@ -70,7 +76,7 @@ static stat_t _normalize_json_string(char_t *str, uint16_t size);
  *
  *	Numbers
  *	  - number values are not quoted and can start with a digit or -.
- *	  - numbers cannot start with + or . (period)
+ *	  - numbers can also start with + or . (period)
  *	  - exponentiated numbers are handled OK.
  *	  - hexadecimal or other non-decimal number bases are not supported
  *
@@ -89,20 +95,25 @@ static stat_t _normalize_json_string(char_t *str, uint16_t size);
 
 void json_parser(char_t *str)
 {
-	stat_t status = _json_parser_kernal(str);
-	nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+	while (_is_json_space(*str)) str++;
+	if (*str == '[') {
+		_json_parser_array(str);
+	} else {
+		stat_t status = _json_parser_kernal(str);
+		nv_print_list(status, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+	}
 	sr_request_status_report(SR_IMMEDIATE_REQUEST); // generate incremental status report to show any changes
 }
 
 static stat_t _json_parser_kernal(char_t *str)
 {
 	stat_t status;
-	int8_t depth;
 	nvObj_t *nv = nv_reset_nv_list();				// get a fresh nvObj list
 	char_t group[GROUP_LEN+1] = {""};				// group identifier - starts as NUL
 	int8_t i = NV_BODY_LEN;
 
-	ritorno(_normalize_json_string(str, JSON_OUTPUT_STRING_MAX));	// return if error
+	if (strlen(str) > JSON_OUTPUT_STRING_MAX)
+        return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
 
 	// parse the JSON command into the nv body
 	do {
@@ -111,7 +122,7 @@ static stat_t _json_parser_kernal(char_t *str)
 
         // Use relaxed parser. Will read eitehr strict or relaxed mode. To use strict-only parser refer
         // to build earlier than 407.03. Substitute _get_nv_pair_strict() for _get_nv_pair()
-		if ((status = _get_nv_pair(nv, &str, &depth)) > STAT_EAGAIN) { // erred out
+		if ((status = _get_nv_pair(nv, &str)) > STAT_EAGAIN) { // erred out
 			return (status);
 		}
 		// propagate the group from previous NV pair (if relevant)
@@ -129,8 +140,11 @@ static stat_t _json_parser_kernal(char_t *str)
             return (STAT_JSON_TOO_MANY_PAIRS);      // Not supposed to encounter a NULL
 	} while (status != STAT_OK);					// breaks when parsing is complete
 
-	// execute the command
-	nv = nv_body;
+	return (_json_execute(nv_body));				// execute the command
+}
+
+static stat_t _json_execute(nvObj_t *nv)
+{
 	if (nv->valuetype == TYPE_NULL){				// means GET the value
 		ritorno(nv_get(nv));						// ritorno returns w/status on any errors
 	} else {
@@ -143,49 +157,358 @@ static stat_t _json_parser_kernal(char_t *str)
 }
 
 /*
- * _normalize_json_string - normalize a JSON string in place
+ * _json_parser_array() - run a JSON array of commands with one combined response
+ * _json_array_out()	 - print a piece of the response and carry the footer checksum over it
+ * _json_element_out()	 - print the response body of an element (with its braces stripped)
+ * _json_array_close()	 - print the closing bracket and the footer
+ *
+ *	  [{"xvm":16000},{"yvm":16000},{"sr":null}]
  *
- *	Validate string size limits, remove all whitespace and convert
- *	to lower case, with the exception of gcode comments
+ *	Each element is one command as json_parser() takes it. The elements are split out
+ *	in place and run through _json_parser_kernal() in order, so they share the nvList
+ *	one at a time and the array can be longer than NV_BODY_LEN pairs. The first error
+ *	stops the run. The line is read with the planner headroom any JSON line gets, and
+ *	an element that would start without it (after Gcode elements filled the planner)
+ *	is not run and fails with STAT_BUFFER_FULL. A line that ends before the closing ]
+ *	fails with STAT_JSON_SYNTAX_ERROR after the elements ahead of it. In JSON mode the response is a single object
+ *
+ *	  {"r":[{"xvm":16000},{"yvm":16000},{"sr":{...}}],"f":[1,0,44,1234]}
+ *
+ *	with each element's body serialized as it completes and printed straight away,
+ *	so it is not limited by the output buffer either. The footer checksum is carried
+ *	over the pieces as they are printed. The footer is always a peer of "r" ($fd is
+ *	not used), and its status is that of the element that failed, if any.
  */
+static void _json_array_out(const char_t *str, uint32_t *check)
+{
+	if (js.json_checksum == JSON_CHECKSUM_CRC16) {
+		*check = update_crc16((uint16_t)*check, (const uint8_t *)str, strlen((const char *)str));
+	} else {
+		*check = update_checksum(*check, str, 0);
+	}
+	fputs((const char *)str, stderr);
+}
 
-static stat_t _normalize_json_string(char_t *str, uint16_t size)
+static void _json_parser_array(char_t *str)
 {
-	char_t *wr;								// write pointer
-	uint8_t in_comment = false;
+	uint8_t respond = ((cfg.comm_mode == JSON_MODE) && (js.json_verbosity != JV_SILENT));
+	uint8_t crc16 = (js.json_checksum == JSON_CHECKSUM_CRC16);
+	uint32_t check = crc16 ? 0xFFFF : 0;
+	uint8_t count = 0;
+	stat_t status = STAT_OK;
+
+	if (respond) {
+		_json_array_out((js.json_syntax == JSON_SYNTAX_RELAXED) ? (const char_t *)"{r:[" : (const char_t *)"{\"r\":[", &check);
+	}
+	str++;											// past the '['
+	while (true) {
+		while (_is_json_space(*str) || (*str == ',')) str++;
+		if (*str == ']') break;
+		if (*str == NUL) {							// the line ended before the closing bracket
+			status = STAT_JSON_SYNTAX_ERROR;
+			break;
+		}
+		if (*str != '{') {
+			status = STAT_JSON_SYNTAX_ERROR;
+			break;
+		}
+		if (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false) {
+			status = STAT_BUFFER_FULL;				// the elements so far filled the planner
+			break;
+		}
+		char_t *element = str;						// find the end of the element...
+		int8_t depth = 0;
+		uint8_t quoted = false;
+		for (; *str != NUL; str++) {
+			if (*str == '\"') { quoted ^= true;}
+			if (quoted) continue;
+			if (*str == '{') { depth++;}
+			if ((*str == '}') && (--depth == 0)) break;
+		}
+		if (*str == NUL) {
+			status = STAT_JSON_SYNTAX_ERROR;
+			break;
+		}
+		char_t next = *(++str);						//...and split it out
+		*str = NUL;
+		status = _json_parser_kernal(element);
+		*str = next;
+
+		if (respond) _json_element_out(count, false, &check);
+		count++;
+		if (status != STAT_OK) break;
+	}
+	if (respond) _json_array_close(']', status, check);
+}
 
-	if (strlen(str) > size)
-        return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+static uint8_t _json_element_out(uint8_t count, uint8_t strip, uint32_t *check)
+{
+	_filter_response_body();
+	char_t *out = cs.out_buf;
+	if (count != 0) { *out++ = ',';}
+	int16_t len = json_serialize(nv_body, out, sizeof(cs.out_buf)-1);
+	if (len <= 0) return (false);
+	out[len-1] = NUL;								// drop the newline
+	if (strip) {
+		if (len <= 3) return (false);				// nothing in the braces
+		out[len-2] = NUL;
+		memmove(out, out+1, len-2);
+	}
+	_json_array_out(cs.out_buf, check);
+	return (true);
+}
+
+static void _json_array_close(char_t close, stat_t status, uint32_t check)
+{
+	uint8_t crc16 = (js.json_checksum == JSON_CHECKSUM_CRC16);
+	char_t *out = cs.out_buf;
+	*out++ = close;
+#ifdef __AVR
+	if (cfg.enable_flow_control == FLOW_CONTROL_COUNT) {	// advertise the RX window
+		out += sprintf((char *)out, (js.json_syntax == JSON_SYNTAX_RELAXED) ? ",rx:%d" : ",\"rx\":%d", xio_get_usb_rx_free());
+	}
+#endif
+	sprintf((char *)out, (js.json_syntax == JSON_SYNTAX_RELAXED) ? ",f:[%d,%d,%d" : ",\"f\":[%d,%d,%d",
+			(crc16 ? FOOTER_REVISION_CRC16 : FOOTER_REVISION), status, cs.linelen);
+	cs.linelen = 0;
+	_json_array_out(cs.out_buf, &check);
+	fprintf(stderr, ",%u]}\n", (crc16 ? (uint16_t)check : (uint16_t)(check % HASHMASK)));
+}
 
-	for (wr = str; *str != NUL; str++) {
-		if (!in_comment) {					// normal processing
-			if (*str == '(') in_comment = true;
-			if ((*str <= ' ') || (*str == DEL)) continue; // toss ctrls, WS & DEL
-			*wr++ = tolower(*str);
-		} else {							// Gcode comment processing
-			if (*str == ')') in_comment = false;
-			*wr++ = *str;
+/*
+ * json_parse_chunk()	 - run a piece of a JSON line too long for the input buffer
+ * _json_element_end()	 - find the end of the element being scanned
+ * _json_start_string()	 - start setting a string value too long for the buffer
+ *
+ *	A line longer than the input buffer is passed in as it arrives (see xio_get_line()),
+ *	one buffer full at a time, so a large config push or raster row is sent as one
+ *	message with one response and never has to fit in RAM as a whole. The pieces are
+ *	tokenized as a stream: each complete element - a name-value pair of an object, or an
+ *	object of an array - is cut out and run through _json_parser_kernal() as if it had
+ *	come on its own line, and the chars of an element that is not complete yet are left
+ *	unused, to be passed in again at the front of the next piece. The response is
+ *	printed an element at a time, as for an array (see _json_parser_array()):
+ *
+ *	  {"xvm":16000,"yvm":16000, ...}	->	{"r":{"xvm":16000,"yvm":16000, ...},"f":[...]}
+ *
+ *	The first error stops the run and the rest of the line is dropped. An element that
+ *	needs more planner room than there is (after the ones before it queued Gcode) waits
+ *	for it - STAT_EAGAIN is returned with the rest of the piece unused.
+ *
+ *	An element too long for the buffer can only be a string value for a token that
+ *	takes its value in pieces (F_APPEND - the raster pixels of $rst). The value is set
+ *	in whole pairs of characters as they arrive, and the reply for the last piece is
+ *	the one returned. If a piece fails, or the line ends before the closing quote, the
+ *	pieces already taken are dropped again, so a failed value leaves no pixels behind.
+ *
+ *	used is set to the chars taken from the start of buf. The response is finished when
+ *	the last piece (more is false) has been run.
+ */
+
+static char_t *_json_element_end(char_t *rd)
+{
+	for ( ; *rd != NUL; rd++) {
+		if (*rd == '\"') { js.chunk_quoted ^= true;}
+		if (js.chunk_quoted) continue;
+		if ((*rd == '{') || (*rd == '[')) {
+			js.chunk_depth++;
+		} else if ((*rd == '}') || (*rd == ']')) {
+			if (--js.chunk_depth < 0) return (rd);	// closes the line
+			if ((js.chunk_depth == 0) && (js.chunk_state == JSON_CHUNK_ARRAY)) return (rd);
+		} else if ((*rd == ',') && (js.chunk_depth == 0) && (js.chunk_state == JSON_CHUNK_OBJECT)) {
+			return (rd);
 		}
 	}
-	*wr = NUL;
+	return (NULL);
+}
+
+static stat_t _json_start_string(char_t **pstr)
+{
+	char_t *rd = *pstr;
+	uint8_t j = 0;
+
+	while ((*rd == '{') || (*rd == '\"') || _is_json_space(*rd)) rd++;
+	for ( ; (*rd != ':') && (*rd != '\"'); rd++) {
+		if (*rd == NUL) return (STAT_JSON_SYNTAX_ERROR);
+		if (_is_json_space(*rd)) continue;
+		if (j == TOKEN_LEN) return (STAT_UNRECOGNIZED_NAME);
+		js.chunk_token[j++] = tolower(*rd);
+	}
+	js.chunk_token[j] = NUL;
+	if (*rd == '\"') rd++;
+	while (_is_json_space(*rd)) rd++;
+	if (*rd++ != ':') return (STAT_JSON_SYNTAX_ERROR);
+	while (_is_json_space(*rd)) rd++;
+	if (*rd++ != '\"') return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+
+	nvObj_t *nv = nv_reset_nv_list();
+	if ((nv->index = nv_get_index((const char_t *)"", js.chunk_token)) == NO_MATCH) {
+		return (STAT_UNRECOGNIZED_NAME);
+	}
+	if ((GET_TABLE_BYTE(flags) & F_APPEND) == 0) return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+	js.chunk_index = nv->index;
+	js.chunk_row = mp_get_raster_row();
+	*pstr = rd;
 	return (STAT_OK);
 }
 
+stat_t json_parse_chunk(char_t *buf, uint8_t more, uint8_t *used)
+{
+	uint8_t respond = ((cfg.comm_mode == JSON_MODE) && (js.json_verbosity != JV_SILENT));
+	char_t *rd = buf;
+	stat_t status = STAT_OK;
+
+	if (js.chunk_state == JSON_CHUNK_OFF) {			// first piece of the line
+		while (_is_json_space(*rd)) rd++;
+		js.chunk_state = (*rd++ == '[') ? JSON_CHUNK_ARRAY : JSON_CHUNK_OBJECT;
+		js.chunk_element = JSON_ELEMENT_NEXT;
+		js.chunk_status = STAT_OK;
+		js.chunk_count = 0;
+		js.chunk_check = (js.json_checksum == JSON_CHECKSUM_CRC16) ? 0xFFFF : 0;
+		if (respond) {
+			if (js.chunk_state == JSON_CHUNK_ARRAY) {
+				_json_array_out((js.json_syntax == JSON_SYNTAX_RELAXED) ? (const char_t *)"{r:[" : (const char_t *)"{\"r\":[", &js.chunk_check);
+			} else {
+				_json_array_out((js.json_syntax == JSON_SYNTAX_RELAXED) ? (const char_t *)"{r:{" : (const char_t *)"{\"r\":{", &js.chunk_check);
+			}
+		}
+	}
+	while (js.chunk_element != JSON_ELEMENT_DONE) {
+		if (js.chunk_element == JSON_ELEMENT_STRING) {	// a piece of a long string value
+			char_t *quote = strchr(rd, '\"');
+			char_t *end = quote;
+			if (quote == NULL) {
+				if (more == false) {
+					status = STAT_JSON_SYNTAX_ERROR;
+					break;
+				}
+				end = rd + strlen(rd);
+				if (((end - rd) & 1) != 0) end--;	// whole pairs only
+				if (end == rd) break;
+			}
+			char_t next = *end;
+			*end = NUL;
+			nvObj_t *nv = nv_reset_nv_list();
+			nv->index = js.chunk_index;
+			strcpy(nv->token, js.chunk_token);
+			nv->valuetype = TYPE_STRING;
+			nv->stringp = (char_t (*)[])rd;
+			status = _json_execute(nv);
+			*end = next;
+			if (status != STAT_OK) break;
+			rd = end;
+			if (quote != NULL) {					// the end of the value
+				if (respond && _json_element_out(js.chunk_count, (js.chunk_state == JSON_CHUNK_OBJECT), &js.chunk_check)) {
+					js.chunk_count++;
+				}
+				rd = quote+1;
+				js.chunk_element = JSON_ELEMENT_SKIP;
+				js.chunk_depth = (js.chunk_state == JSON_CHUNK_ARRAY) ? 1 : 0;	// in the array element's braces
+				js.chunk_quoted = false;
+			}
+			continue;
+		}
+		if (js.chunk_element == JSON_ELEMENT_SKIP) {	// the rest of the element after a long string
+			char_t *end = _json_element_end(rd);
+			if (end == NULL) {
+				rd += strlen(rd);
+				break;
+			}
+			rd = ((js.chunk_state == JSON_CHUNK_ARRAY) && (js.chunk_depth == 0)) ? end+1 : end;
+			js.chunk_element = JSON_ELEMENT_NEXT;
+			continue;
+		}
+		while (_is_json_space(*rd) || (*rd == ',')) rd++;
+		if (*rd == NUL) break;
+		if ((*rd == '}') || (*rd == ']')) {			// closes the line
+			js.chunk_element = JSON_ELEMENT_DONE;
+			break;
+		}
+		if ((js.chunk_state == JSON_CHUNK_ARRAY) && (*rd != '{')) {
+			status = STAT_JSON_SYNTAX_ERROR;
+			break;
+		}
+		char_t *element = rd;
+		js.chunk_depth = 0;
+		js.chunk_quoted = false;
+		char_t *end = _json_element_end(rd);
+		if (end == NULL) {							// the element goes on in the next piece...
+			if (more == false) {
+				status = STAT_JSON_SYNTAX_ERROR;
+				break;
+			}
+			if (element != buf) break;				//...where it will start the buffer...
+			if ((status = _json_start_string(&rd)) != STAT_OK) break;
+			js.chunk_element = JSON_ELEMENT_STRING;	//...unless it's too long to
+			continue;
+		}
+		if (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false) {
+			status = STAT_EAGAIN;					// run it when the planner has room
+			break;
+		}
+		if (js.chunk_state == JSON_CHUNK_ARRAY) {
+			char_t next = *(++end);					// split out the element...
+			*end = NUL;
+			status = _json_parser_kernal(element);
+			*end = next;
+		} else {
+			char_t term[2] = { end[0], end[1] };	// ...or close the pair as an object of its own
+			end[0] = '}';
+			end[1] = NUL;
+			status = _json_parser_kernal(element);
+			end[0] = term[0];
+			end[1] = term[1];
+		}
+		if (respond && _json_element_out(js.chunk_count, (js.chunk_state == JSON_CHUNK_OBJECT), &js.chunk_check)) {
+			js.chunk_count++;
+		}
+		if (status != STAT_OK) break;
+		rd = end;
+	}
+	if (status == STAT_EAGAIN) {
+		*used = rd - buf;
+		return (STAT_EAGAIN);
+	}
+	if ((status != STAT_OK) && (js.chunk_element == JSON_ELEMENT_STRING)) {
+		mp_cut_raster_row(js.chunk_row);			// drop the pieces of the failed value
+	}
+	if ((status != STAT_OK) && (js.chunk_status == STAT_OK)) {
+		js.chunk_status = status;					// the first error stops the run...
+		js.chunk_element = JSON_ELEMENT_DONE;
+	}
+	*used = strlen(buf);							//...and anything left is dropped
+	if (js.chunk_element != JSON_ELEMENT_DONE) *used = rd - buf;
+	if (more == true) return (STAT_OK);
+
+	if ((js.chunk_element != JSON_ELEMENT_DONE) && (js.chunk_status == STAT_OK)) {
+		js.chunk_status = STAT_JSON_SYNTAX_ERROR;	// the line ended with no closing brace
+	}
+	if (respond) _json_array_close((js.chunk_state == JSON_CHUNK_ARRAY) ? ']' : '}', js.chunk_status, js.chunk_check);
+	js.chunk_state = JSON_CHUNK_OFF;
+	sr_request_status_report(SR_IMMEDIATE_REQUEST);
+	return (js.chunk_status);
+}
+
 /*
  * _get_nv_pair() - get the next name-value pair w/relaxed JSON rules. Also parses strict JSON.
  *
  *	Parse the next statement and populate the command object (nvObj).
  *
+ *	Tokenizes in a single pass over the raw input line - there is no separate
+ *	normalization pass. Whitespace and control characters are skipped between
+ *	elements and the name is lowercased as it is copied into the token. String
+ *	values are left in place: the closing quote is overwritten with a NUL and
+ *	stringp points into the input line, so strings don't consume the shared
+ *	string area. String values are therefore taken as sent (case is kept).
+ *
  *	Leaves string pointer (str) on the first character following the object.
- *	Which is the character just past the ',' separator if it's a multi-valued
- *	object or the terminating NUL if single object or the last in a multi.
+ *	Which is the ',' separator if it's a multi-valued object or the character
+ *	past the terminator if single object or the last in a multi.
  *
  *	Keeps track of tree depth and closing braces as much as it has to.
  *	If this were to be extended to track multiple parents or more than two
  *	levels deep it would have to track closing curlies - which it does not.
  *
- *	ASSUMES INPUT STRING HAS FIRST BEEN NORMALIZED BY _normalize_json_string()
- *
  *	If a group prefix is passed in it will be pre-pended to any name parsed
  *	to form a token string. For example, if "x" is provided as a group and
  *	"fr" is found in the name string the parser will search for "xfr" in the
@@ -202,101 +525,99 @@ static stat_t _normalize_json_string(char_t *str, uint16_t size)
 #define MAX_PAD_CHARS 8
 #define MAX_NAME_CHARS 32
 
-static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth)
+static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr)
 {
-	uint8_t i;
+	char_t *rd = *pstr;
 	char_t *tmp;
-	char_t leaders[] = {"{,\""};				// open curly, quote and leading comma
-	char_t separators[] = {":\""};				// colon and quote
-	char_t terminators[] = {"},\""};			// close curly, comma and quote
-	char_t value[] = {"{\".-+"};				// open curly, quote, period, minus and plus
+	uint8_t i, j;
 
 	nv_reset_nv(nv);							// wipes the object and sets the depth
 
 	// --- Process name part ---
-	// Find, terminate and set pointers for the name. Allow for leading and trailing name quotes.
-	char_t * name = *pstr;
-	for (i=0; true; i++, (*pstr)++) {
-		if (strchr(leaders, (int)**pstr) == NULL) { 		// find leading character of name
-			name = (*pstr)++;
-			break;
-		}
-		if (i == MAX_PAD_CHARS)
+	// Skip leading curlies, commas and quotes. Allow for leading and trailing name quotes.
+	for (i=0; true; rd++) {
+		if (_is_json_space(*rd)) continue;
+		if ((*rd != '{') && (*rd != ',') && (*rd != '\"')) break;
+		if (++i > MAX_PAD_CHARS)
             return (STAT_JSON_SYNTAX_ERROR);
 	}
 
-	// Find the end of name, NUL terminate and copy token
-	for (i=0; true; i++, (*pstr)++) {
-		if (strchr(separators, (int)**pstr) != NULL) {
-			*(*pstr)++ = NUL;
-			strncpy(nv->token, name, TOKEN_LEN+1);			// copy the string to the token
-			break;
-		}
-		if (i == MAX_NAME_CHARS)
+	// Copy the name to the token up to the separator (colon or quote)
+	for (i=0, j=0; (*rd != ':') && (*rd != '\"'); rd++) {
+		if ((*rd == NUL) || (++i > MAX_NAME_CHARS))
             return (STAT_JSON_SYNTAX_ERROR);
+		if (_is_json_space(*rd)) continue;
+		if (j == TOKEN_LEN)
+            return (STAT_UNRECOGNIZED_NAME);	// too long to be any token
+		nv->token[j++] = tolower(*rd);
 	}
+	nv->token[j] = NUL;
+	rd++;
 
 	// --- Process value part ---  (organized from most to least frequently encountered)
 
 	// Find the start of the value part
-	for (i=0; true; i++, (*pstr)++) {
-		if (isalnum((int)**pstr)) break;
-		if (strchr(value, (int)**pstr) != NULL) break;
-		if (i == MAX_PAD_CHARS)
+	for (i=0; true; rd++) {
+		if (_is_json_space(*rd)) continue;
+		if (*rd == NUL)
+            return (STAT_JSON_SYNTAX_ERROR);
+		if (isalnum((int)*rd) || (strchr("{\"[.-+", (int)*rd) != NULL)) break;
+		if (++i > MAX_PAD_CHARS)
             return (STAT_JSON_SYNTAX_ERROR);
 	}
 
 	// nulls (gets)
-	if ((**pstr == 'n') || ((**pstr == '\"') && (*(*pstr+1) == '\"'))) { // process null value
+	if ((tolower(*rd) == 'n') || ((*rd == '\"') && (*(rd+1) == '\"'))) { // process null value
 		nv->valuetype = TYPE_NULL;
 		nv->value = TYPE_NULL;
+		if (*rd == '\"') rd += 2;				// skip the empty string so its quotes aren't taken as terminators
 
 	// numbers
-	} else if (isdigit(**pstr) || (**pstr == '-')) {// value is a number
-		nv->value = (float)strtod(*pstr, &tmp);	// tmp is the end pointer
-		if(tmp == *pstr)
+	} else if (isdigit(*rd) || (*rd == '-') || (*rd == '+') || (*rd == '.')) {
+		nv->value = parse_float(rd, &tmp);		// tmp is the end pointer
+		if (tmp == rd)
             return (STAT_BAD_NUMBER_FORMAT);
 		nv->valuetype = TYPE_FLOAT;
+		rd = tmp;
 
 	// object parent
-	} else if (**pstr == '{') {
+	} else if (*rd == '{') {
 		nv->valuetype = TYPE_PARENT;
 //		*depth += 1;							// nv_reset_nv() sets the next object's level so this is redundant
-		(*pstr)++;
+		*pstr = ++rd;
 		return(STAT_EAGAIN);					// signal that there is more to parse
 
 	// strings
-	} else if (**pstr == '\"') { 				// value is a string
-		(*pstr)++;
+	} else if (*rd == '\"') { 					// value is a string
+		rd++;
 		nv->valuetype = TYPE_STRING;
-		if ((tmp = strchr(*pstr, '\"')) == NULL)
+		if ((tmp = strchr(rd, '\"')) == NULL)
             return (STAT_JSON_SYNTAX_ERROR);    // find the end of the string
 		*tmp = NUL;
 
 		// if string begins with 0x it might be data, needs to be at least 3 chars long
-		if( strlen(*pstr)>=3 && (*pstr)[0]=='0' && (*pstr)[1]=='x')
-		{
+		if ((rd[0] == '0') && (tolower(rd[1]) == 'x') && (rd[2] != NUL)) {
 			uint32_t *v = (uint32_t*)&nv->value;
-			*v = strtoul((const char *)*pstr, 0L, 0);
+			*v = strtoul((const char *)rd, 0L, 0);
 			nv->valuetype = TYPE_DATA;
 		} else {
-			ritorno(nv_copy_string(nv, *pstr));
+			nv->stringp = (char_t (*)[])rd;		// string stays in the input line
 		}
-
-		*pstr = ++tmp;
+		rd = tmp+1;
 
 	// boolean true/false
-	} else if (**pstr == 't') {
+	} else if (tolower(*rd) == 't') {
 		nv->valuetype = TYPE_BOOL;
 		nv->value = true;
-	} else if (**pstr == 'f') {
+	} else if (tolower(*rd) == 'f') {
 		nv->valuetype = TYPE_BOOL;
 		nv->value = false;
 
 	// arrays
-	} else if (**pstr == '[') {
+	} else if (*rd == '[') {
 		nv->valuetype = TYPE_ARRAY;
-		ritorno(nv_copy_string(nv, *pstr));		// copy array into string for error displays
+		if ((tmp = strchr(rd, ']')) != NULL) *(++tmp) = NUL;
+		ritorno(nv_copy_string(nv, rd));		// copy array into string for error displays
 		return (STAT_UNSUPPORTED_TYPE);	        // return error as the parser doesn't do input arrays yet
 
 	// general error condition
@@ -305,17 +626,18 @@ static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth)
     }
 
 	// process comma separators and end curlies
-	if ((*pstr = strpbrk(*pstr, terminators)) == NULL) { // advance to terminator or err out
+	if ((rd = strpbrk(rd, "},\"")) == NULL) {	// advance to terminator or err out
 		return (STAT_JSON_SYNTAX_ERROR);
 	}
-	if (**pstr == '}') {
-		*depth -= 1;							// pop up a nesting level
-		(*pstr)++;								// advance to comma or whatever follows
+	if (*rd == '}') {
+		rd++;									// pop up a nesting level - advance to comma or whatever follows
+		while (_is_json_space(*rd)) rd++;
 	}
-	if (**pstr == ',')
+	if (*rd == ',') {
+		*pstr = rd;
         return (STAT_EAGAIN);                   // signal that there is more to parse
-
-	(*pstr)++;
+	}
+	*pstr = ++rd;
 	return (STAT_OK);							// signal that parsing is complete
 }
 
@@ -353,6 +675,24 @@ static stat_t _get_nv_pair(nvObj_t *nv, char_t **pstr, int8_t *depth)
 
 #define BUFFER_MARGIN 8			// safety margin to avoid buffer overruns during footer checksum generation
 
+static char_t *_copy_string(char_t *str, const char_t *src, const char_t *str_max)
+{
+	while ((*src != NUL) && (str < str_max)) { *str++ = *src++; }
+	return (str);
+}
+
+static char_t *_copy_hex(char_t *str, uint32_t value)
+{
+	uint8_t shift = 28;
+	while ((shift != 0) && ((value >> shift) == 0)) { shift -= 4; }	// no leading zeros
+	while (true) {
+		uint8_t nibble = (value >> shift) & 0x0F;
+		*str++ = (nibble < 10) ? ('0' + nibble) : ('a' - 10 + nibble);
+		if (shift == 0) { return (str); }
+		shift -= 4;
+	}
+}
+
 uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 {
 #ifdef __SILENCE_JSON_RESPONSES
@@ -371,10 +711,13 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 			if (need_a_comma) { *str++ = ',';}
 			need_a_comma = true;
 			if (js.json_syntax == JSON_SYNTAX_RELAXED) {		// write name
-				str += sprintf((char *)str, "%s:", nv->token);
+				str = _copy_string(str, nv->token, str_max);
 			} else {
-				str += sprintf((char *)str, "\"%s\":", nv->token);
+				*str++ = '"';
+				str = _copy_string(str, nv->token, str_max);
+				*str++ = '"';
 			}
+			*str++ = ':';
 
 			// check for illegal float values
 			if (nv->valuetype == TYPE_FLOAT) {
@@ -382,23 +725,30 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 			}
 
 			// serialize output value
-			if		(nv->valuetype == TYPE_NULL)		{ str += (char_t)sprintf((char *)str, "null");} // Note that that "" is NOT null.
-			else if (nv->valuetype == TYPE_INTEGER)	{
-				str += (char_t)sprintf((char *)str, "%1.0f", (double)nv->value);
-			}
+			if		(nv->valuetype == TYPE_NULL)	{ str = _copy_string(str, (char_t *)"null", str_max);} // Note that that "" is NOT null.
+			else if (nv->valuetype == TYPE_INTEGER)	{ str += fntoa(str, nv->value, 0);}
 			else if (nv->valuetype == TYPE_DATA)	{
 				uint32_t *v = (uint32_t*)&nv->value;
-				str += (char_t)sprintf((char *)str, "\"0x%lx\"", *v);
+				*str++ = '"'; *str++ = '0'; *str++ = 'x';
+				str = _copy_hex(str, *v);
+				*str++ = '"';
+			}
+			else if (nv->valuetype == TYPE_STRING)	{
+				*str++ = '"';
+				str = _copy_string(str, *nv->stringp, str_max);
+				*str++ = '"';
+			}
+			else if (nv->valuetype == TYPE_ARRAY)	{
+				*str++ = '[';
+				str = _copy_string(str, *nv->stringp, str_max);
+				*str++ = ']';
 			}
-			else if (nv->valuetype == TYPE_STRING)	{ str += (char_t)sprintf((char *)str, "\"%s\"",(char *)*nv->stringp);}
-			else if (nv->valuetype == TYPE_ARRAY)	{ str += (char_t)sprintf((char *)str, "[%s]",  (char *)*nv->stringp);}
 			else if (nv->valuetype == TYPE_FLOAT)	{ preprocess_float(nv);
-//													  str += fntoa((char *)str, nv->value, nv->precision);
 													  str += fntoa(str, nv->value, nv->precision);
 			}
 			else if (nv->valuetype == TYPE_BOOL) {
-				if (fp_FALSE(nv->value)) { str += sprintf((char *)str, "false");}
-				else { str += (char_t)sprintf((char *)str, "true"); }
+				if (fp_FALSE(nv->value)) { str = _copy_string(str, (char_t *)"false", str_max);}
+				else { str = _copy_string(str, (char_t *)"true", str_max); }
 			}
 			if (nv->valuetype == TYPE_PARENT) {
 				*str++ = '{';
@@ -417,7 +767,9 @@ uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size)
 
 	// closing curlies and NEWLINE
 	while (prev_depth-- > initial_depth) { *str++ = '}';}
-	str += sprintf((char *)str, "}\n");	// using sprintf for this last one ensures a NUL termination
+	*str++ = '}';
+	*str++ = '\n';
+	*str = NUL;
 	if (str > out_buf + size) { return (-1);}
 	return (str - out_buf);
 #endif
@@ -464,12 +816,18 @@ void json_print_list(stat_t status, uint8_t flags)
  *	JV_MESSAGES,	// echo configs; gcode messages only (if present); no block echo or line numbers
  *	JV_LINENUM,		// echo configs; gcode blocks return messages and line numbers as present
  *	JV_VERBOSE		// echos all configs and gcode blocks, line numbers and messages
+ *	JV_STREAMING	// as JV_LINENUM, but gcode blocks that are accepted get no response
+ *
+ *	In streaming mode only gcode errors get a response. The host tracks the accepted
+ *	lines from the ak reports instead (see ak_report_callback()), which about halves the
+ *	TX traffic when streaming dense jobs.
  *
  *	This gets a bit complicated. The first nvObj is the header, which must be set by reset_nv_list().
  *	The first object in the body will always have the gcode block or config command in it,
  *	which you may or may not want to display. This is followed by zero or more displayable objects.
  *	Then if you want a gcode line number you add that here to the end. Finally, a footer goes
- *	on all the (non-silent) responses.
+ *	on all the (non-silent) responses. The footer checksum is taken over the serialized
+ *	string up to the checksum (one pass, the length is known), as a hash or a CRC-16 ($jc).
  */
 #define MAX_TAIL_LEN 8
 
@@ -480,40 +838,27 @@ void json_print_response(uint8_t status)
 #endif
 
 	if (js.json_verbosity == JV_SILENT) return;			// silent responses
+	if ((js.json_verbosity == JV_STREAMING) && ((status == STAT_OK) || (status == STAT_NOOP)) &&
+		(nv_get_type(nv_body) == NV_TYPE_GCODE)) {
+		ak_accept_line(cm.gm.linenum);					// acknowledged by the next ak report
+		cs.linelen = 0;
+		return;
+	}
 
 	// Body processing
 	nvObj_t *nv = nv_body;
 	if (status == STAT_JSON_SYNTAX_ERROR) {
 		nv_reset_nv_list();
 		nv_add_string((const char_t *)"err", escape_string(cs.in_buf, cs.saved_buf));
+	} else {
+		nv = _filter_response_body();
+	}
 
-	} else if (cm.machine_state != MACHINE_INITIALIZING) {	// always do full echo during startup
-		uint8_t nv_type;
-		do {
-			if ((nv_type = nv_get_type(nv)) == NV_TYPE_NULL) break;
-
-			if (nv_type == NV_TYPE_GCODE) {
-				if (js.echo_json_gcode_block == false) {	// kill command echo if not enabled
-					nv->valuetype = TYPE_EMPTY;
-				}
-
-//++++		} else if (nv_type == NV_TYPE_CONFIG) {			// kill config echo if not enabled
-//fix me		if (js.echo_json_configs == false) {
-//					nv->valuetype = TYPE_EMPTY;
-//				}
-
-			} else if (nv_type == NV_TYPE_MESSAGE) {		// kill message echo if not enabled
-				if (js.echo_json_messages == false) {
-					nv->valuetype = TYPE_EMPTY;
-				}
-
-			} else if (nv_type == NV_TYPE_LINENUM) {		// kill line number echo if not enabled
-				if ((js.echo_json_linenum == false) || (fp_ZERO(nv->value))) { // do not report line# 0
-					nv->valuetype = TYPE_EMPTY;
-				}
-			}
-		} while ((nv = nv->nx) != NULL);
+#ifdef __AVR
+	if (cfg.enable_flow_control == FLOW_CONTROL_COUNT) {	// advertise the RX window
+		nv_add_integer((const char_t *)"rx", xio_get_usb_rx_free());
 	}
+#endif
 
 	// Footer processing
 	while(nv->valuetype != TYPE_EMPTY) {					// find a free nvObj at end of the list...
@@ -523,7 +868,8 @@ void json_print_response(uint8_t status)
 		}
 	}
 	char_t footer_string[NV_FOOTER_LEN];
-	sprintf((char *)footer_string, "%d,%d,%d,0", FOOTER_REVISION, status, cs.linelen);
+	uint8_t crc16 = (js.json_checksum == JSON_CHECKSUM_CRC16);
+	sprintf((char *)footer_string, "%d,%d,%d,0", (crc16 ? FOOTER_REVISION_CRC16 : FOOTER_REVISION), status, cs.linelen);
 	cs.linelen = 0;											// reset linelen so it's only reported once
 
 	nv_copy_string(nv, footer_string);						// link string to nv object
@@ -544,9 +890,54 @@ void json_print_response(uint8_t status)
 	strcpy(tail, cs.out_buf + strcount + 1);				// save the json termination
 
 	while (cs.out_buf[strcount2] != ',') { strcount2--; }// find start of checksum
-	sprintf((char *)cs.out_buf + strcount2 + 1, "%d%s", compute_checksum(cs.out_buf, strcount2), tail);
+	uint16_t checksum;										// over everything ahead of the checksum's comma
+	if (crc16) {
+		checksum = compute_crc16((const uint8_t *)cs.out_buf, strcount2);
+	} else {
+		checksum = compute_checksum(cs.out_buf, strcount2);
+	}
+	sprintf((char *)cs.out_buf + strcount2 + 1, "%u%s", checksum, tail);
 	fprintf(stderr, "%s", cs.out_buf);
 }
+
+/*
+ * _filter_response_body() - empty the body objects the JSON verbosity does not echo
+ *
+ *	Returns the object the filter stopped on, where the search for a free footer
+ *	object starts.
+ */
+static nvObj_t *_filter_response_body()
+{
+	nvObj_t *nv = nv_body;
+	if (cm.machine_state == MACHINE_INITIALIZING) return (nv);	// always do full echo during startup
+
+	uint8_t nv_type;
+	do {
+		if ((nv_type = nv_get_type(nv)) == NV_TYPE_NULL) break;
+
+		if (nv_type == NV_TYPE_GCODE) {
+			if (js.echo_json_gcode_block == false) {	// kill command echo if not enabled
+				nv->valuetype = TYPE_EMPTY;
+			}
+
+//++++	} else if (nv_type == NV_TYPE_CONFIG) {			// kill config echo if not enabled
+//fix me	if (js.echo_json_configs == false) {
+//				nv->valuetype = TYPE_EMPTY;
+//			}
+
+		} else if (nv_type == NV_TYPE_MESSAGE) {		// kill message echo if not enabled
+			if (js.echo_json_messages == false) {
+				nv->valuetype = TYPE_EMPTY;
+			}
+
+		} else if (nv_type == NV_TYPE_LINENUM) {		// kill line number echo if not enabled
+			if ((js.echo_json_linenum == false) || (fp_ZERO(nv->value))) { // do not report line# 0
+				nv->valuetype = TYPE_EMPTY;
+			}
+		}
+	} while ((nv = nv->nx) != NULL);
+	return (nv);
+}
 
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
@@ -559,9 +950,11 @@ void json_print_response(uint8_t status)
 
 stat_t json_set_jv(nvObj_t *nv)
 {
-	if (nv->value > JV_VERBOSE)
+	if (nv->value > JV_STREAMING)
         return (STAT_INPUT_VALUE_RANGE_ERROR);
 	js.json_verbosity = nv->value;
+	ak_init_ack_report();
+	uint8_t echo = (js.json_verbosity == JV_STREAMING) ? JV_LINENUM : js.json_verbosity;
 
 	js.echo_json_footer = false;
 	js.echo_json_messages = false;
@@ -569,11 +962,11 @@ stat_t json_set_jv(nvObj_t *nv)
 	js.echo_json_linenum = false;
 	js.echo_json_gcode_block = false;
 
-	if (nv->value >= JV_FOOTER) 	{ js.echo_json_footer = true;}
-	if (nv->value >= JV_MESSAGES)	{ js.echo_json_messages = true;}
-	if (nv->value >= JV_CONFIGS)	{ js.echo_json_configs = true;}
-	if (nv->value >= JV_LINENUM)	{ js.echo_json_linenum = true;}
-	if (nv->value >= JV_VERBOSE)	{ js.echo_json_gcode_block = true;}
+	if (echo >= JV_FOOTER) 		{ js.echo_json_footer = true;}
+	if (echo >= JV_MESSAGES)	{ js.echo_json_messages = true;}
+	if (echo >= JV_CONFIGS)		{ js.echo_json_configs = true;}
+	if (echo >= JV_LINENUM)		{ js.echo_json_linenum = true;}
+	if (echo >= JV_VERBOSE)		{ js.echo_json_gcode_block = true;}
 
 	return(STAT_OK);
 }
@@ -591,17 +984,20 @@ stat_t json_set_jv(nvObj_t *nv)
  * js_print_jv()
  * js_print_j2()
  * js_print_fs()
+ * js_print_jc()
  */
 
 static const char fmt_ej[] PROGMEM = "[ej]  enable json mode%13d [0=text,1=JSON]\n";
-static const char fmt_jv[] PROGMEM = "[jv]  json verbosity%15d [0=silent,1=footer,2=messages,3=configs,4=linenum,5=verbose]\n";
+static const char fmt_jv[] PROGMEM = "[jv]  json verbosity%15d [0=silent,1=footer,2=messages,3=configs,4=linenum,5=verbose,6=streaming]\n";
 static const char fmt_js[] PROGMEM = "[js]  json serialize style%9d [0=relaxed,1=strict]\n";
 static const char fmt_fs[] PROGMEM = "[fs]  footer style%17d [0=new,1=old]\n";
+static const char fmt_jc[] PROGMEM = "[jc]  json footer checksum%9d [0=hash,1=CRC-16]\n";
 
 void js_print_ej(nvObj_t *nv) { text_print_ui8(nv, fmt_ej);}
 void js_print_jv(nvObj_t *nv) { text_print_ui8(nv, fmt_jv);}
 void js_print_js(nvObj_t *nv) { text_print_ui8(nv, fmt_js);}
 void js_print_fs(nvObj_t *nv) { text_print_ui8(nv, fmt_fs);}
+void js_print_jc(nvObj_t *nv) { text_print_ui8(nv, fmt_jc);}
 
 #endif // __TEXT_MODE
 
@@ -39,6 +39,7 @@ extern "C"{
 // if you add these make sure there are no collisions w/present or past numbers
 
 #define FOOTER_REVISION 1
+#define FOOTER_REVISION_CRC16 2			// footer checksum is a CRC-16 ($jc=1)
 
 #define JSON_OUTPUT_STRING_MAX (OUTPUT_BUFFER_LEN)
 
@@ -48,7 +49,8 @@ enum jsonVerbosity {
 	JV_MESSAGES,					// returns footer, messages (exception and gcode messages)
 	JV_CONFIGS,						// returns footer, messages, config commands
 	JV_LINENUM,						// returns footer, messages, config commands, gcode line numbers if present
-	JV_VERBOSE						// returns footer, messages, config commands, gcode blocks
+	JV_VERBOSE,						// returns footer, messages, config commands, gcode blocks
+	JV_STREAMING					// as JV_LINENUM, but accepted gcode blocks are acknowledged by periodic ak reports
 };
 
 enum jsonFormats {					// json output print modes
@@ -57,11 +59,29 @@ enum jsonFormats {					// json output print modes
 	JSON_RESPONSE_FORMAT			// print the header/body/footer as a response object
 };
 
+enum jsonChecksum {
+	JSON_CHECKSUM_HASH = 0,			// footer checksum is the Java hashCode of the response mod 9999
+	JSON_CHECKSUM_CRC16				// footer checksum is the CRC-16/CCITT of the response (as for Gcode frames)
+};
+
 enum jsonSyntaxMode {
 	JSON_SYNTAX_RELAXED = 0,		// Does not require quotes on names
 	JSON_SYNTAX_STRICT				// requires quotes on names
 };
 
+enum jsonChunkState {				// a line too long for the input buffer - see json_parse_chunk()
+	JSON_CHUNK_OFF = 0,				// no long line is being run
+	JSON_CHUNK_OBJECT,				// the line is an object - its pairs are the elements
+	JSON_CHUNK_ARRAY				// the line is an array - its objects are the elements
+};
+
+enum jsonChunkElement {
+	JSON_ELEMENT_NEXT = 0,			// looking for the next element
+	JSON_ELEMENT_STRING,			// setting a long string value a piece at a time
+	JSON_ELEMENT_SKIP,				// skipping to the end of the element after a long string
+	JSON_ELEMENT_DONE				// the line is closed or failed - the rest is dropped
+};
+
 typedef struct jsSingleton {
 
 	/*** config values (PUBLIC) ***/
@@ -69,6 +89,7 @@ typedef struct jsSingleton {
 	uint8_t json_footer_depth;		// 0=footer is peer to response 'r', 1=child of response 'r'
 //	uint8_t json_footer_style;		// select footer style
 	uint8_t json_syntax;			// 0=relaxed syntax, 1=strict syntax
+	uint8_t json_checksum;			// footer checksum, see enum in this file
 
 	uint8_t echo_json_footer;		// flags for JSON responses serialization
 	uint8_t echo_json_messages;
@@ -77,7 +98,16 @@ typedef struct jsSingleton {
 	uint8_t echo_json_gcode_block;
 
 	/*** runtime values (PRIVATE) ***/
-
+	uint8_t chunk_state;			// see jsonChunkState
+	uint8_t chunk_element;			// see jsonChunkElement
+	uint8_t chunk_count;			// elements answered so far
+	int8_t chunk_depth;				// nesting of the element being scanned
+	uint8_t chunk_quoted;			// TRUE inside a string of the element being scanned
+	stat_t chunk_status;			// first error of the line
+	index_t chunk_index;			// token of the long string value being set
+	uint8_t chunk_row;				// raster row length before the long string value (see mp_cut_raster_row())
+	char_t chunk_token[TOKEN_LEN+1];
+	uint32_t chunk_check;			// footer checksum carried over the response pieces
 } jsSingleton_t;
 
 /**** Externs - See report.c for allocation ****/
@@ -87,6 +117,7 @@ extern jsSingleton_t js;
 /**** Function Prototypes ****/
 
 void json_parser(char_t *str);
+stat_t json_parse_chunk(char_t *buf, uint8_t more, uint8_t *used);
 uint16_t json_serialize(nvObj_t *nv, char_t *out_buf, uint16_t size);
 void json_print_object(nvObj_t *nv);
 void json_print_response(uint8_t status);
@@ -100,6 +131,7 @@ stat_t json_set_jv(nvObj_t *nv);
 	void js_print_jv(nvObj_t *nv);
 	void js_print_js(nvObj_t *nv);
 	void js_print_fs(nvObj_t *nv);
+	void js_print_jc(nvObj_t *nv);
 
 #else
 
@@ -107,6 +139,7 @@ stat_t json_set_jv(nvObj_t *nv);
 	#define js_print_jv tx_print_stub
 	#define js_print_js tx_print_stub
 	#define js_print_fs tx_print_stub
+	#define js_print_jc tx_print_stub
 
 #endif // __TEXT_MODE
 
@@ -29,19 +29,30 @@
 #include "config.h"
 #include "canonical_machine.h"
 #include "stepper.h"
+#include "planner.h"
+#include "hardware.h"
 #include "kinematics.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C"{
 #endif
 
-//static void _inverse_kinematics(float travel[], float joint[]);
+ikSingleton_t ik;
+
+static const float *_compensate(const float travel[], float compensated[]);
+static void _inverse_kinematics(const float travel[], float joint[]);
+static void _kinematics_setup(void);
+static void _compensation_setup(void);
+static void _rotation(ikRotation_t *r, float angle);
 
 /*
  * ik_kinematics() - wrapper routine for inverse kinematics
  *
- *	Calls kinematics function(s).
+ *	Calls kinematics function(s), after the machine error corrections (see _compensate()).
  *	Performs axis mapping & conversion of length units to steps (and deals with inhibited axes)
+ *	using the table built by ik_map_motors(), so it's one multiply per motor per segment.
+ *	Cartesian machines skip the transform altogether.
  *
  *	The reason steps are returned as floats (as opposed to, say, uint32_t) is to accommodate
  *	fractional DDA steps. The DDA deals with fractional step values as fixed-point binary in
@@ -51,58 +62,306 @@ extern "C"{
 
 void ik_kinematics(const float travel[], float steps[])
 {
-	float joint[AXES];
+	float joint_buf[AXES];
+	float compensated[AXES];
 
-//	_inverse_kinematics(travel, joint);				// you can insert inverse kinematics transformations here
-	memcpy(joint, travel, sizeof(float)*AXES);		//...or just do a memcpy for Cartesian machines
+#ifdef __ISR_TIMING
+	uint16_t start = TIMER_CYCLES.CNT;
+#endif
+	travel = _compensate(travel, compensated);
+	const float *joint = travel;					// Cartesian joints are the axes
+	if (ik.kinematics != KINEMATICS_CARTESIAN) {
+		_inverse_kinematics(travel, joint_buf);
+		joint = joint_buf;
+	}
 
 	// Map motors to axes and convert length units to steps
-	// Most of the conversion math has already been done in during config in steps_per_unit()
-	// which takes axis travel, step angle and microsteps into account.
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		if (cm.a[axis].axis_mode == AXIS_INHIBITED) { joint[axis] = 0;}
-		if (st_cfg.mot[MOTOR_1].motor_map == axis) { steps[MOTOR_1] = joint[axis] * st_cfg.mot[MOTOR_1].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_2].motor_map == axis) { steps[MOTOR_2] = joint[axis] * st_cfg.mot[MOTOR_2].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_3].motor_map == axis) { steps[MOTOR_3] = joint[axis] * st_cfg.mot[MOTOR_3].steps_per_unit;}
-		if (st_cfg.mot[MOTOR_4].motor_map == axis) { steps[MOTOR_4] = joint[axis] * st_cfg.mot[MOTOR_4].steps_per_unit;}
-#if (MOTORS >= 5)
-		if (st_cfg.mot[MOTOR_5].motor_map == axis) { steps[MOTOR_5] = joint[axis] * st_cfg.mot[MOTOR_5].steps_per_unit;}
+	// Motors past ACTIVE_MOTORS are compiled out of the step ISR and prep, so they get no steps
+	steps[MOTOR_1] = joint[ik.axis[MOTOR_1]] * ik.steps_per_unit[MOTOR_1];
+#if (ACTIVE_MOTORS >= 2)
+	steps[MOTOR_2] = joint[ik.axis[MOTOR_2]] * ik.steps_per_unit[MOTOR_2];
+#endif
+#if (ACTIVE_MOTORS >= 3)
+	steps[MOTOR_3] = joint[ik.axis[MOTOR_3]] * ik.steps_per_unit[MOTOR_3];
+#endif
+#if (ACTIVE_MOTORS >= 4)
+	steps[MOTOR_4] = joint[ik.axis[MOTOR_4]] * ik.steps_per_unit[MOTOR_4];
+#endif
+#if (ACTIVE_MOTORS >= 5)
+	steps[MOTOR_5] = joint[ik.axis[MOTOR_5]] * ik.steps_per_unit[MOTOR_5];
 #endif
-#if (MOTORS >= 6)
-		if (st_cfg.mot[MOTOR_6].motor_map == axis) { steps[MOTOR_6] = joint[axis] * st_cfg.mot[MOTOR_6].steps_per_unit;}
+#if (ACTIVE_MOTORS >= 6)
+	steps[MOTOR_6] = joint[ik.axis[MOTOR_6]] * ik.steps_per_unit[MOTOR_6];
 #endif
+	for (uint8_t m = ACTIVE_MOTORS; m < MOTORS; m++) {
+		steps[m] = 0;
 	}
+#ifdef __ISR_TIMING
+	st_timing_record(&st_tim.kin, TIMER_CYCLES.CNT - start, ST_TIMING_EXEC_SHIFT);
+#endif
+}
 
-/* The above is a loop unrolled version of this:
-	for (uint8_t axis=0; axis<AXES; axis++) {
-		for (uint8_t motor=0; motor<MOTORS; motor++) {
-			if (st_cfg.mot[motor].motor_map == axis) {
-				steps[motor] = joint[axis] * st_cfg.mot[motor].steps_per_unit;
-			}
+/*
+ * ik_map_motors() - rebuild the motor to axis table used by ik_kinematics()
+ *
+ *	Must be called whenever a motor map (ma), a motor's steps per unit (sa, tr, mi) or
+ *	an axis mode (am) changes. Most of the conversion math has already been done during
+ *	config in steps_per_unit() which takes axis travel, step angle and microsteps into account.
+ *	Inhibited axes and motors mapped to no axis get a zero multiplier so they never step.
+ */
+
+void ik_map_motors()
+{
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		uint8_t axis = st_cfg.mot[motor].motor_map;
+		if ((axis >= AXES) || (cm.a[axis].axis_mode == AXIS_INHIBITED)) {
+			ik.axis[motor] = AXIS_X;				// any valid index will do
+			ik.steps_per_unit[motor] = 0;
+		} else {
+			ik.axis[motor] = axis;
+			ik.steps_per_unit[motor] = st_cfg.mot[motor].steps_per_unit;
 		}
 	}
-*/
 }
 
 /*
- * _inverse_kinematics() - inverse kinematics - example is for a cartesian machine
+ * _compensate() - correct an axis position for the machine's skew and lead-screw pitch errors
+ *
+ *	Corrects measured machine errors on every segment target and position resync, so the
+ *	host sends the part as drawn. Both are set in machine units (mm) against machine
+ *	coordinates, and are applied to the axes before any kinematic transform.
+ *
+ *	Skew: $skxy is the X correction per unit of Y - the tangent of the angle the Y axis is
+ *	out of square with X, negated. Likewise $skxz and $skyz. X is moved by skxy*Y + skxz*Z
+ *	and Y by skyz*Z.
+ *
+ *	Pitch: X, Y and Z each have IK_PITCH_POINTS corrections ($pcx0 to $pcx8 for X) at
+ *	$pcxd apart from $pcxs. They are added to the commanded axis position, so enter the
+ *	error a laser or a scale measured at each point, negated. Between points they are
+ *	interpolated, and past the ends the end value holds. $pcxd=0 turns the map off.
+ *
+ *	The reciprocal spacings are kept, so a map costs a multiply, a truncation and a
+ *	multiply-add per axis per segment, and skew two more multiply-adds.
+ */
+
+static const float *_compensate(const float travel[], float compensated[])
+{
+	if (ik.compensation == false) return (travel);
+
+	memcpy(compensated, travel, sizeof(float)*AXES);
+	compensated[AXIS_X] += ik.skew[IK_SKEW_XY] * travel[AXIS_Y] + ik.skew[IK_SKEW_XZ] * travel[AXIS_Z];
+	compensated[AXIS_Y] += ik.skew[IK_SKEW_YZ] * travel[AXIS_Z];
+
+	for (uint8_t axis=0; axis<IK_PITCH_AXES; axis++) {
+		if (ik.pitch_recip_spacing[axis] == 0) continue;
+		const float *pitch = ik.pitch[axis];
+		float u = (travel[axis] - ik.pitch_start[axis]) * ik.pitch_recip_spacing[axis];	// position in points
+		if (u <= 0) {
+			compensated[axis] += pitch[0];
+		} else if (u >= IK_PITCH_POINTS-1) {
+			compensated[axis] += pitch[IK_PITCH_POINTS-1];
+		} else {
+			uint8_t i = (uint8_t)u;
+			compensated[axis] += pitch[i] + (pitch[i+1] - pitch[i]) * (u - i);
+		}
+	}
+	return (compensated);
+}
+
+/*
+ * _inverse_kinematics() - convert axis positions to joint positions
  *
  *	You can glue in inverse kinematics here, but be aware of time budget constrants.
  *	This function is run during the _exec() portion of the cycle and will therefore
  *	be run once per interpolation segment. The total time for the segment load,
  *	including the inverse kinematics transformation cannot exceed the segment time,
  *	and ideally should be no more than 25-50% of the segment time. Currently segments
- *	run avery 5 ms, but this might be lowered. To profile this time look at the
- *	time it takes to complete the mp_exec_move() function.
+ *	run avery 5 ms, but this might be lowered. To profile this time enable __ISR_TIMING
+ *	and look at the _tk group - its b value is the slowest pass as a percent of a segment.
+ *
+ *	The delta transform is three sqrts. That's already the cheapest form on the Xmega -
+ *	avr-libc's sqrt is hand-coded and about the cost of one divide, so a Newton step
+ *	seeded from the previous segment would not save anything. Points out of reach of
+ *	a rod are clamped to the rod lying flat rather than producing a NaN.
+ *
+ *	RTCP (rotary tool center point) is a table-table trunnion: the part sits on the C
+ *	table, which is tilted about the X direction by A. Both axes pass through the pivot
+ *	point ($kpx, $kpy, $kpz). XYZ are programmed as the tool tip on the part at A0 C0,
+ *	and the joints move the tool to where that point is once the table has turned the
+ *	part by C about Z and then tilted it by A about X. A and C drive their own motors.
+ *	The sin and cos of A and C are cached by _rotation(), so a segment at a steady
+ *	rotary speed costs 8 multiplies rather than 4 trig calls.
+ *
+ *	Note that the planner still limits velocity, acceleration and jerk in Cartesian
+ *	space, and lines are straight in joint space only between segment end points.
+ *	For RTCP that space is the tool tip on the part, so the feed rate is the tool tip
+ *	speed over the part - the linear joints may move faster than it near the pivot.
  */
+
+static void _inverse_kinematics(const float travel[], float joint[])
+{
+	memcpy(joint, travel, sizeof(float)*AXES);		// axes outside the transform pass through
+
+	if (ik.kinematics == KINEMATICS_DELTA) {
+		for (uint8_t tower=0; tower<3; tower++) {
+			float dx = ik.tower_x[tower] - travel[AXIS_X];
+			float dy = ik.tower_y[tower] - travel[AXIS_Y];
+			float h2 = ik.rod_length_squared - dx*dx - dy*dy;
+			joint[AXIS_X + tower] = travel[AXIS_Z] + ((h2 > 0) ? sqrt(h2) : 0);
+		}
+	} else if (ik.kinematics == KINEMATICS_RTCP) {
+		_rotation(&ik.rot_c, travel[AXIS_C]);
+		_rotation(&ik.rot_a, travel[AXIS_A]);
+		float x = travel[AXIS_X] - ik.pivot[AXIS_X];
+		float y = travel[AXIS_Y] - ik.pivot[AXIS_Y];
+		float z = travel[AXIS_Z] - ik.pivot[AXIS_Z];
+		float yc = x * ik.rot_c.sin + y * ik.rot_c.cos;	// turn by C about Z
+		joint[AXIS_X] = x * ik.rot_c.cos - y * ik.rot_c.sin + ik.pivot[AXIS_X];
+		joint[AXIS_Y] = yc * ik.rot_a.cos - z * ik.rot_a.sin + ik.pivot[AXIS_Y];	// tilt by A about X
+		joint[AXIS_Z] = yc * ik.rot_a.sin + z * ik.rot_a.cos + ik.pivot[AXIS_Z];
+	} else {										// CoreXY and H-bot
+		joint[AXIS_X] = travel[AXIS_X] + travel[AXIS_Y];
+		joint[AXIS_Y] = travel[AXIS_X] - travel[AXIS_Y];
+	}
+}
+
 /*
-static void _inverse_kinematics(float travel[], float joint[])
+ * _rotation() - bring the cached sin and cos of a rotary axis up to an angle
+ *
+ *	The exec moves rotary axes in near equal steps through the body of a move. Once a
+ *	step repeats (within IK_ROTATION_TOLERANCE) the cached values are turned on by it
+ *	with the angle sum identities, which takes the sin and cos of the step only once.
+ *	The cached angle is the one turned to, not the one asked for, so the difference
+ *	can't build up past the tolerance. Exact values are taken again every
+ *	IK_ROTATION_RESYNC steps to drop the rounding of the identities.
+ */
+
+static void _rotation(ikRotation_t *r, float angle)
 {
-	for (uint8_t i=0; i<AXES; i++) {
-		joint[i] = travel[i];
+	float step = angle - r->angle;
+
+	if (step == 0) return;							// not turning (3+2 jobs) - nothing to do
+	if ((fabs(step - r->step) < IK_ROTATION_TOLERANCE) && (r->steps < IK_ROTATION_RESYNC)) {
+		if (r->step_valid == false) {
+			r->sin_step = sin(r->step * (M_PI/180));
+			r->cos_step = cos(r->step * (M_PI/180));
+			r->step_valid = true;
+		}
+		float sin_a = r->sin * r->cos_step + r->cos * r->sin_step;
+		r->cos = r->cos * r->cos_step - r->sin * r->sin_step;
+		r->sin = sin_a;
+		r->angle += r->step;
+		r->steps++;
+		return;
+	}
+	r->sin = sin(angle * (M_PI/180));
+	r->cos = cos(angle * (M_PI/180));
+	r->step = step;
+	r->step_valid = false;
+	r->angle = angle;
+	r->steps = 0;
+}
+
+/*
+ * _kinematics_setup() - precompute the delta tower positions and reset the RTCP rotation caches
+ */
+
+static void _kinematics_setup()
+{
+	const float angle[3] = { 210, 330, 90 };		// degrees, towers for the X, Y and Z joints
+
+	for (uint8_t tower=0; tower<3; tower++) {
+		ik.tower_x[tower] = ik.delta_radius * cos(angle[tower] * M_PI / 180);
+		ik.tower_y[tower] = ik.delta_radius * sin(angle[tower] * M_PI / 180);
+	}
+	ik.rod_length_squared = ik.delta_rod_length * ik.delta_rod_length;
+
+	memset(&ik.rot_a, 0, sizeof(ikRotation_t));		// A0 and C0
+	memset(&ik.rot_c, 0, sizeof(ikRotation_t));
+	ik.rot_a.cos = 1;
+	ik.rot_c.cos = 1;
+}
+
+/*
+ * _compensation_setup() - precompute the pitch map spacings and see if any correction is set
+ */
+
+static void _compensation_setup()
+{
+	ik.compensation = false;
+	for (uint8_t axis=0; axis<IK_PITCH_AXES; axis++) {
+		ik.pitch_recip_spacing[axis] = 0;
+		if (fp_ZERO(ik.pitch_spacing[axis])) continue;
+		ik.pitch_recip_spacing[axis] = 1 / ik.pitch_spacing[axis];
+		ik.compensation = true;
+	}
+	for (uint8_t i=0; i<IK_SKEWS; i++) {
+		if (fp_NOT_ZERO(ik.skew[i])) ik.compensation = true;
 	}
 }
-*/
+
+/*
+ * ik_set_kin()	  - set the kinematics type
+ * ik_set_delta() - set a delta geometry value (radius or rod length)
+ * ik_set_pivot() - set an RTCP pivot coordinate
+ * ik_set_pc()	  - set a pitch map start or correction
+ * ik_set_pcd()	  - set a pitch map spacing
+ * ik_set_sk()	  - set a skew correction
+ *
+ *	All resync the runtime step position to the new joint space (as changing steps per
+ *	unit does) so the next move doesn't jump. Only change these while the machine is idle.
+ */
+
+stat_t ik_set_kin(nvObj_t *nv)
+{
+	if ((uint8_t)nv->value >= KINEMATICS_MAX_VALUE)
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	set_ui8(nv);
+	_kinematics_setup();
+	mp_set_steps_to_runtime_position();
+	config_mark_derived(DERIVED_STEP_VELOCITY);	// only Cartesian axes are limited
+	return (STAT_OK);
+}
+
+stat_t ik_set_delta(nvObj_t *nv)
+{
+	set_flu(nv);
+	_kinematics_setup();
+	mp_set_steps_to_runtime_position();
+	return (STAT_OK);
+}
+
+stat_t ik_set_pivot(nvObj_t *nv)
+{
+	set_flu(nv);
+	mp_set_steps_to_runtime_position();
+	return (STAT_OK);
+}
+
+stat_t ik_set_pc(nvObj_t *nv)
+{
+	set_flu(nv);
+	_compensation_setup();
+	mp_set_steps_to_runtime_position();
+	return (STAT_OK);
+}
+
+stat_t ik_set_pcd(nvObj_t *nv)
+{
+	if (nv->value < 0) return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	set_flu(nv);
+	_compensation_setup();
+	mp_set_steps_to_runtime_position();
+	return (STAT_OK);
+}
+
+stat_t ik_set_sk(nvObj_t *nv)
+{
+	set_flt(nv);
+	_compensation_setup();
+	mp_set_steps_to_runtime_position();
+	return (STAT_OK);
+}
 
 #ifdef __cplusplus
 }
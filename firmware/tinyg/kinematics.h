@@ -32,11 +32,81 @@
 extern "C"{
 #endif
 
+/*
+ * Kinematics types. CoreXY and H-bot share the same transform - they only differ in how
+ * the belts are routed. Delta towers are at 210, 330 and 90 degrees and drive the
+ * carriages of the X, Y and Z axes respectively (map motors to those axes as usual).
+ */
+enum ikKinematics {
+	KINEMATICS_CARTESIAN = 0,			// joints are the axes
+	KINEMATICS_COREXY,					// X joint = X+Y, Y joint = X-Y
+	KINEMATICS_HBOT,					// same as CoreXY
+	KINEMATICS_DELTA,					// linear delta. X, Y, Z joints are tower carriage heights
+	KINEMATICS_RTCP,					// A/C trunnion table. XYZ are the tool tip on the part
+	KINEMATICS_MAX_VALUE				// for input range checking
+};
+
+#define IK_ROTATION_TOLERANCE ((float)0.0001)	// degrees a rotation may differ from its cached step
+#define IK_PITCH_AXES 3						// X, Y and Z have lead-screw pitch maps
+#define IK_PITCH_POINTS 9					// corrections in each pitch map
+
+enum ikSkew {							// ik.skew[] - see _compensate()
+	IK_SKEW_XY = 0,						// X correction per unit of Y
+	IK_SKEW_XZ,							// X correction per unit of Z
+	IK_SKEW_YZ,							// Y correction per unit of Z
+	IK_SKEWS
+};
+#define IK_ROTATION_RESYNC 200				// cached steps taken before sin and cos are recomputed
+
+typedef struct ikRotation {				// sin and cos of a rotary axis, cached across segments
+	float angle;						// angle the cached values are for (degrees)
+	float sin;
+	float cos;
+	float step;							// angle change of the last segment
+	float sin_step;						// ...and its sin and cos, once the step repeats
+	float cos_step;
+	uint8_t step_valid;					// sin_step and cos_step are for step
+	uint8_t steps;						// cached steps taken since the last exact values
+} ikRotation_t;
+
+typedef struct ikSingleton {
+	// config
+	uint8_t kinematics;					// see ikKinematics
+	float delta_radius;					// horizontal distance from the center to each tower at the effector
+	float delta_rod_length;				// diagonal rod length
+	float pivot[3];						// RTCP: machine XYZ where the A and C axes cross
+	float pitch_start[IK_PITCH_AXES];	// axis position of the first point of each pitch map
+	float pitch_spacing[IK_PITCH_AXES];	// distance between the points; 0 = no map
+	float pitch[IK_PITCH_AXES][IK_PITCH_POINTS];// corrections added to the axis position at the points
+	float skew[IK_SKEWS];				// out-of-square corrections (see ikSkew)
+
+	// derived
+	float tower_x[3];					// tower positions for the delta transform
+	float tower_y[3];
+	float rod_length_squared;
+	uint8_t compensation;				// TRUE if any pitch map or skew correction is set
+	float pitch_recip_spacing[IK_PITCH_AXES];// 1/pitch_spacing; 0 = no map
+	ikRotation_t rot_a;					// RTCP table tilt
+	ikRotation_t rot_c;					// RTCP table rotation
+	uint8_t axis[MOTORS];				// axis that drives each motor
+	float steps_per_unit[MOTORS];		// steps per axis unit, zero if the axis is inhibited or unmapped
+} ikSingleton_t;
+
+extern ikSingleton_t ik;
+
 /*
  * Global Scope Functions
  */
 
 void ik_kinematics(const float travel[], float steps[]);
+void ik_map_motors(void);
+
+stat_t ik_set_kin(nvObj_t *nv);
+stat_t ik_set_delta(nvObj_t *nv);
+stat_t ik_set_pivot(nvObj_t *nv);
+stat_t ik_set_pc(nvObj_t *nv);
+stat_t ik_set_pcd(nvObj_t *nv);
+stat_t ik_set_sk(nvObj_t *nv);
 
 //#ifdef __UNIT_TESTS
 //void ik_unit_tests(void);
@@ -34,6 +34,7 @@
 #include "switch.h"
 #include "test.h"
 #include "pwm.h"
+#include "analog.h"
 #include "xio.h"
 
 #ifdef __AVR
@@ -115,6 +116,9 @@ static void _application_init(void)
 
 	cli();
 
+	// critical stage - motion safety, serial IO and the config shadow
+	// the rest of the boot runs from the controller after system ready (see _deferred_init())
+
 	// do these first
 	hardware_init();				// system hardware setup 			- must be first
 	persistence_init();				// set up EEPROM or other NVM		- must be second
@@ -127,12 +131,14 @@ static void _application_init(void)
 	switch_init();					// switches
 //	gpio_init();					// parallel IO
 	pwm_init();						// pulse width modulation drivers	- must follow gpio_init()
+	analog_init();					// analog inputs
 
 	controller_init(STD_IN, STD_OUT, STD_ERR);// must be first app init; reqs xio_init()
 	config_init();					// config records from eeprom 		- must be next app init
 	network_init();					// reset std devices if required	- must follow config_init()
 	planner_init();					// motion planning subsystem
 	canonical_machine_init();		// canonical machine				- must follow config_init()
+	hw_timebase_init();				// microsecond timebase				- must be last before sei()
 
 	// now bring up the interrupts and get started
 	PMIC_SetVectorLocationToApplication();// as opposed to boot ROM
@@ -302,8 +308,8 @@ static const char stat_110[] PROGMEM = "Input value range error";
 static const char stat_111[] PROGMEM = "JSON syntax error";
 static const char stat_112[] PROGMEM = "JSON input has too many pairs";
 static const char stat_113[] PROGMEM = "JSON string too long";
-static const char stat_114[] PROGMEM = "114";
-static const char stat_115[] PROGMEM = "115";
+static const char stat_114[] PROGMEM = "Gcode frame malformed";
+static const char stat_115[] PROGMEM = "Gcode frame CRC error";
 static const char stat_116[] PROGMEM = "116";
 static const char stat_117[] PROGMEM = "117";
 static const char stat_118[] PROGMEM = "118";
@@ -375,22 +381,22 @@ static const char stat_177[] PROGMEM = "R word is invalid";
 static const char stat_178[] PROGMEM = "T word is missing";
 static const char stat_179[] PROGMEM = "T word is invalid";
 
-static const char stat_180[] PROGMEM = "180";
-static const char stat_181[] PROGMEM = "181";
-static const char stat_182[] PROGMEM = "182";
-static const char stat_183[] PROGMEM = "183";
-static const char stat_184[] PROGMEM = "184";
-static const char stat_185[] PROGMEM = "185";
-static const char stat_186[] PROGMEM = "186";
-static const char stat_187[] PROGMEM = "187";
-static const char stat_188[] PROGMEM = "188";
-static const char stat_189[] PROGMEM = "189";
-
-static const char stat_190[] PROGMEM = "190";
-static const char stat_191[] PROGMEM = "191";
-static const char stat_192[] PROGMEM = "192";
-static const char stat_193[] PROGMEM = "193";
-static const char stat_194[] PROGMEM = "194";
+static const char stat_180[] PROGMEM = "O word is invalid";
+static const char stat_181[] PROGMEM = "O word cache full";
+static const char stat_182[] PROGMEM = "O word subroutine not defined";
+static const char stat_183[] PROGMEM = "Spline specification error";
+static const char stat_184[] PROGMEM = "Rotation or scaling specification error";
+static const char stat_185[] PROGMEM = "Spindle synchronized motion specification error";
+static const char stat_186[] PROGMEM = "Line missed or corrupted - resend requested";
+static const char stat_187[] PROGMEM = "Config snapshot corrupt or out of sequence";
+static const char stat_188[] PROGMEM = "Motion mode not supported with cutter compensation";
+static const char stat_189[] PROGMEM = "Cutter compensation would gouge the part";
+
+static const char stat_190[] PROGMEM = "Expression or parameter syntax error";
+static const char stat_191[] PROGMEM = "Expression too long or nested too deep";
+static const char stat_192[] PROGMEM = "Expression divides by zero or is out of range";
+static const char stat_193[] PROGMEM = "Parameter number invalid, read only or no free name";
+static const char stat_194[] PROGMEM = "Named parameter not defined";
 static const char stat_195[] PROGMEM = "195";
 static const char stat_196[] PROGMEM = "196";
 static const char stat_197[] PROGMEM = "197";
@@ -403,8 +409,8 @@ static const char stat_202[] PROGMEM = "Move less than minimum time";
 static const char stat_203[] PROGMEM = "Machine is alarmed - Command not processed";	// current longest message 43 chars (including NUL)
 static const char stat_204[] PROGMEM = "Limit switch hit - Shutdown occurred";
 static const char stat_205[] PROGMEM = "Trapezoid planner failed to converge";
-static const char stat_206[] PROGMEM = "206";
-static const char stat_207[] PROGMEM = "207";
+static const char stat_206[] PROGMEM = "Following error exceeded - motor stalled";
+static const char stat_207[] PROGMEM = "Network frame lost - slave stopped";
 static const char stat_208[] PROGMEM = "208";
 static const char stat_209[] PROGMEM = "209";
 
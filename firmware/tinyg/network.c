@@ -24,42 +24,295 @@
  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
  * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
-/* 	This module is really nothing mre than a placeholder at this time.
- * 	"Networking" refers to a planned RS485 broadcast network to support
- *	multi-board configs and external RS485 devices such as extruders.
- *	Basic operation of RS485 on the TinyG hardware has been verified
- *	using what's in this file, but you won;t find much more.
+/* 	"Networking" refers to an RS485 broadcast network to support multi-board
+ *	configs and external RS485 devices such as extruders. The master sends the
+ *	segments it runs to the slave boards (see network.h for the frames).
  */
 
 #include <util/delay.h>				// for tests
+#include <string.h>					// for memcpy
 
 #include "tinyg.h"
 #include "network.h"
 #include "controller.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "stepper.h"
 #include "gpio.h"
 #include "hardware.h"
+#include "util.h"
 #include "xio.h"
 
 /*
  * Local Scope Functions and Data
  */
 
+typedef struct netSingleton {
+	// master
+	uint8_t tx_sequence;			// sequence number of the next frame sent
+	uint32_t tx_clock;				// master time the last segment sent ends
+
+	// slave
+	uint8_t rx_count;				// bytes of the frame received so far
+	uint8_t rx_sequence;			// sequence number expected next
+	uint8_t rx_sequenced;			// true once a frame has set the sequence
+	uint8_t rx_lost;				// true from a lost frame to the next position frame
+	uint8_t rx_ready;				// type of the frame waiting to be run, or 0
+	uint8_t skew_valid;				// true once the clock offset has been measured
+	int32_t skew;					// slave time less master time (less the frame time)
+	uint32_t clock;					// slave time the last segment prepped ends
+	stat_t fault;					// latched for net_callback()
+	uint8_t rx_buf[NET_FRAME_HEADER + NET_FRAME_PAYLOAD_MAX + 1];
+	union {
+		netSegmentFrame_t segment;
+		float position[AXES];
+	} rx;
+} net_t;
+static net_t net;
+
+static void _send_frame(uint8_t type, const void *payload, uint8_t length);
+static void _receive_frames(void);
+static void _receive_frame(void);
+static stat_t _exec_segment_frame(void);
+
 /*
  * network_init()
  */
 void network_init()
 {
-	// re-point IO if in slave mode
-	if (cs.network_mode == NETWORK_SLAVE) {
-		controller_init(XIO_DEV_RS485, XIO_DEV_USB, XIO_DEV_USB);
-		tg_set_secondary_source(XIO_DEV_USB);
-	}
+	net.rx_lost = false;
+	net.rx_sequenced = false;
+	net.skew_valid = false;
 	xio_enable_rs485_rx();		// needed for clean start for RS-485;
 }
 
-void net_forward(unsigned char c)
+/*
+ * net_callback() - controller task: alarm on a lost frame and keep a slave's exec running
+ *
+ *	The slave's exec stops when it runs out of frames, so it is requested again here as
+ *	frames arrive. st_request_exec_move() does nothing if the prep ring is full.
+ */
+
+stat_t net_callback()
 {
-	xio_putc(XIO_DEV_RS485, c);	// write to RS485 port
+	if (cs.network_mode != NETWORK_SLAVE) {
+		return (STAT_NOOP);
+	}
+	if (net.fault != STAT_OK) {
+		stat_t status = net.fault;
+		net.fault = STAT_OK;
+		return (cm_soft_alarm(status));
+	}
+	st_request_exec_move();
+	return (STAT_OK);
+}
+
+/***********************************************************************************
+ * Master
+ *
+ * net_send_segment()  - broadcast a segment as it is prepped (called from the exec)
+ * net_send_position() - broadcast the runtime position when it is set (runtime idle)
+ * net_advance_clock() - account for a dwell in the master's segment clock
+ *
+ *	A segment prepped while the steppers are running starts when the last one ends.
+ *	If the master's clock has fallen behind, the steppers have run dry and the segment
+ *	starts now.
+ */
+
+void net_send_segment(const float target[], float segment_time)
+{
+	if (cs.network_mode != NETWORK_MASTER) {
+		return;
+	}
+	netSegmentFrame_t frame;
+
+	net_advance_clock(0);
+	frame.start_usec = net.tx_clock;
+	frame.segment_time = segment_time;
+	copy_vector(frame.target, target);
+	net.tx_clock += (uint32_t)(segment_time * MICROSECONDS_PER_MINUTE);
+	frame.send_usec = hw_get_usec();
+	_send_frame(NET_FRAME_SEGMENT, &frame, sizeof(frame));
+}
+
+void net_send_position(const float position[])
+{
+	if (cs.network_mode != NETWORK_MASTER) {
+		return;
+	}
+	_send_frame(NET_FRAME_POSITION, position, sizeof(float) * AXES);
+}
+
+void net_advance_clock(float microseconds)
+{
+	uint32_t now = hw_get_usec();
+
+	if ((int32_t)(net.tx_clock - now) < 0) {
+		net.tx_clock = now;
+	}
+	net.tx_clock += (uint32_t)microseconds;
+}
+
+/*
+ * _send_frame() - frame a payload and queue it for the RS485 transmitter
+ *
+ *	A frame that does not fit in the TX buffer is dropped rather than waiting on the
+ *	transmitter from the exec. The slaves find the gap in the sequence and alarm.
+ */
+
+static void _send_frame(uint8_t type, const void *payload, uint8_t length)
+{
+	uint8_t frame[NET_FRAME_HEADER + NET_FRAME_PAYLOAD_MAX + 1];
+	uint8_t size = NET_FRAME_HEADER + length;
+	uint8_t sum = 0;
+
+	frame[0] = NET_FRAME_SYNC;
+	frame[1] = type;
+	frame[2] = net.tx_sequence++;
+	frame[3] = length;
+	memcpy(&frame[NET_FRAME_HEADER], payload, length);
+	for (uint8_t i=1; i<size; i++) {
+		sum += frame[i];
+	}
+	frame[size++] = -sum;
+	if (xio_get_rs485_tx_free() < size) {
+		return;
+	}
+	for (uint8_t i=0; i<size; i++) {
+		xio_putc(XIO_DEV_NET, frame[i]);
+	}
+}
+
+/***********************************************************************************
+ * Slave
+ *
+ * net_exec_segment() - run the next frame from the master (called from the exec)
+ *
+ *	Takes the place of the planner exec on a slave board. Returns STAT_NOOP if there is
+ *	nothing to run (see net_callback()). A position frame waits for the steppers to stop.
+ */
+
+stat_t net_exec_segment()
+{
+	if (net.rx_ready == 0) {
+		_receive_frames();
+	}
+	if (net.rx_ready == NET_FRAME_SEGMENT) {
+		return (_exec_segment_frame());
+	}
+	if ((net.rx_ready == NET_FRAME_POSITION) && (st_runtime_isbusy() == false)) {
+		net.rx_ready = 0;
+		net.rx_lost = false;
+		copy_vector(mr.position, net.rx.position);
+		mp_set_steps_to_runtime_position();
+	}
+	st_prep_null();
+	return (STAT_NOOP);
+}
+
+/*
+ * _exec_segment_frame() - prep a segment so it ends when the master's does
+ */
+
+static stat_t _exec_segment_frame()
+{
+	netSegmentFrame_t *frame = &net.rx.segment;
+	uint32_t now = hw_get_usec();
+
+	if ((int32_t)(net.clock - now) < 0) {					// the steppers have run dry
+		net.clock = now;
+	}
+	int32_t early = (int32_t)(frame->start_usec + net.skew - net.clock);
+	if (early > NET_GAP_USEC) {								// the master paused - the frame waits
+		st_prep_dwell(early);
+		net.clock += early;
+		return (STAT_OK);
+	}
+	net.rx_ready = 0;
+	float trim = min(fabs(early / MICROSECONDS_PER_MINUTE), frame->segment_time * NET_TRIM_MAX);
+	float segment_time = frame->segment_time + ((early < 0) ? -trim : trim);
+	net.clock += (uint32_t)(segment_time * MICROSECONDS_PER_MINUTE);
+	return (mp_exec_network_segment(frame->target, segment_time));
+}
+
+/*
+ * _receive_frames() - read RS485 bytes up to the next frame to run
+ * _receive_frame()	 - check a complete frame and take it up
+ */
+
+static void _receive_frames()
+{
+	int c;
+
+	while ((net.rx_ready == 0) && ((c = xio_read_rs485()) != _FDEV_ERR)) {
+		if ((net.rx_count == 0) && (c != NET_FRAME_SYNC)) {
+			continue;										// hunt for the start of a frame
+		}
+		net.rx_buf[net.rx_count++] = (uint8_t)c;
+		if (net.rx_count < NET_FRAME_HEADER) {
+			continue;
+		}
+		uint8_t length = net.rx_buf[3];
+		if (length > NET_FRAME_PAYLOAD_MAX) {
+			net.rx_count = 0;								// not a frame - hunt again
+			continue;
+		}
+		if (net.rx_count == NET_FRAME_HEADER + length + 1) {
+			_receive_frame();
+			net.rx_count = 0;
+		}
+	}
+}
+
+static void _receive_frame()
+{
+	uint8_t *frame = net.rx_buf;
+	uint8_t length = frame[3];
+	uint8_t sum = 0;
+	uint32_t arrival = xio_get_rs485_rx_usec();				// read before the buffer is checked
+
+	for (uint8_t i=1; i<NET_FRAME_HEADER + length + 1; i++) {
+		sum += frame[i];
+	}
+	if ((sum != 0) || (net.rx_sequenced && (frame[2] != net.rx_sequence))) {
+		net.rx_lost = true;
+		if (cm.machine_state != MACHINE_ALARM) {
+			net.fault = STAT_NETWORK_FRAME_LOST;
+		}
+	}
+	net.rx_sequence = frame[2] + 1;
+	net.rx_sequenced = true;
+	if (sum != 0) {
+		return;
+	}
+	if ((frame[1] == NET_FRAME_POSITION) && (length == sizeof(float) * AXES)) {
+		memcpy(net.rx.position, &frame[NET_FRAME_HEADER], length);
+		net.rx_ready = NET_FRAME_POSITION;
+		return;
+	}
+	if ((frame[1] != NET_FRAME_SEGMENT) || (length != sizeof(netSegmentFrame_t)) ||
+		net.rx_lost || (cm.machine_state == MACHINE_ALARM)) {
+		return;
+	}
+	memcpy(&net.rx.segment, &frame[NET_FRAME_HEADER], length);
+
+	// The arrival time is only that of this frame if nothing has been received since
+	if (xio_get_rs485_rx_count() != 0) {
+		if (net.skew_valid) {
+			net.rx_ready = NET_FRAME_SEGMENT;
+			return;
+		}
+		arrival = hw_get_usec();
+	}
+	int32_t skew = (int32_t)(arrival - net.rx.segment.send_usec) -
+				   (NET_FRAME_HEADER + length + 1) * NET_BYTE_USEC;
+	if ((net.skew_valid == false) || (skew < net.skew + NET_DRIFT_USEC)) {
+		net.skew = skew;
+	} else {
+		net.skew += NET_DRIFT_USEC;
+	}
+	net.skew_valid = true;
+	net.rx_ready = NET_FRAME_SEGMENT;
 }
 
 /*
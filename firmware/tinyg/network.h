@@ -27,6 +27,35 @@
 #ifndef network_h
 #define network_h
 
+/*
+ * Motion network
+ *
+ *	A master board broadcasts the segments it runs over RS485 so slave boards can drive
+ *	more motors in step with it. Slaves do not plan: each segment frame carries the axis
+ *	targets the master converts to steps (after input shaping and grid compensation)
+ *	and the slave runs them through its own motor map, kinematics and st_prep_line().
+ *	A slave should therefore have shaping and grid compensation off. Its motors are
+ *	set up like any others ($1ma etc.) and can follow any axis of the master.
+ *
+ *	Frames are binary:
+ *
+ *	  sync | type | sequence | length | payload (length bytes) | checksum
+ *
+ *	The checksum makes the 8 bit sum of everything after the sync byte zero. A slave
+ *	hunts for the sync byte and drops bad frames. A bad checksum or a gap in the
+ *	sequence numbers latches a fault that alarms the slave; it then ignores segments
+ *	until the master sends the next position frame (whenever it sets its position).
+ *
+ *	Segment clocks: the master stamps each segment with the time it starts on the
+ *	master and the time the frame was sent. The slave measures the offset between the
+ *	clocks from the arrival time of each frame, keeping the smallest seen (the one that
+ *	waited least in the buffers) and letting it creep by NET_DRIFT_USEC a frame so
+ *	drift between the crystals is followed. Each segment is then stretched or shrunk
+ *	by up to NET_TRIM_MAX so it ends when the master's does, and a gap in the master's
+ *	motion (a dwell) becomes a dwell on the slave. A frame takes about 3.6 ms at
+ *	115200 baud, so a slave starting from rest is that late and catches up over the
+ *	first segments of the ramp. Spindle waits are not timed on the slaves.
+ */
 /*
  * Global Scope Functions
  */
@@ -37,12 +66,36 @@ enum networkMode {
 	NETWORK_SLAVE
 };
 
+enum netFrameType {
+	NET_FRAME_SEGMENT = 1,		// segment start time, segment time and axis targets
+	NET_FRAME_POSITION			// the master set its runtime position
+};
+
+#define NET_FRAME_SYNC		0xA5	// first byte of every frame
+#define NET_FRAME_HEADER	4		// sync, type, sequence and payload length
+#define NET_BYTE_USEC		87		// time to send a byte (10 bits at 115200 baud)
+#define NET_DRIFT_USEC		2		// allowed change of the clock offset from one frame to the next
+#define NET_TRIM_MAX		0.10	// largest fraction a slave stretches or shrinks a segment by
+#define NET_GAP_USEC		1000	// a segment starting this much after the last one ends is preceded by a dwell
+
+typedef struct netSegmentFrame {
+	uint32_t send_usec;			// master time the frame was sent
+	uint32_t start_usec;		// master time the segment starts
+	float segment_time;			// in minutes
+	float target[AXES];			// axis targets
+} netSegmentFrame_t;
+
+#define NET_FRAME_PAYLOAD_MAX (sizeof(netSegmentFrame_t))
+
 void network_init();
-void net_forward(unsigned char c);
+void net_send_segment(const float target[], float segment_time);
+void net_send_position(const float position[]);
+void net_advance_clock(float microseconds);
+stat_t net_exec_segment(void);
+stat_t net_callback(void);
 uint8_t net_test_rxtx(uint8_t c);
 uint8_t net_test_loopback(uint8_t c);
 
 #define XIO_DEV_NET XIO_DEV_RS485	// define the network channel
-//#define net_forward(c) (xio_putc(XIO_DEV_NET,c))
 
 #endif
@@ -0,0 +1,58 @@
+/*
+ * perf.c - performance counter registry
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tinyg.h"		// #1
+#include "config.h"		// #2
+#include "hardware.h"
+#include "perf.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#ifdef __PERF_COUNTERS
+uint32_t perf[PERF_COUNTERS];			// the counters - see perf.h
+#endif
+
+/*
+ * perf_clear() - clear all performance counters (get or set)
+ *
+ *	Interrupts are held off so a counter can't be part-cleared under an ISR increment.
+ */
+stat_t perf_clear(nvObj_t *nv)
+{
+#ifdef __PERF_COUNTERS
+	cli();
+	memset(perf, 0, sizeof(perf));
+	sei();
+#endif
+	return (STAT_OK);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+/*
+ * perf.h - performance counter registry
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ * PERFORMANCE COUNTERS
+ *
+ *	One place to see where the time goes. A subsystem registers a counter by adding it
+ *	to the perfCounter enum below and its token to the pf group in config_app.c, then
+ *	calls PERF_COUNT() where the event happens. That is one 32 bit increment - nothing
+ *	is timed, tested or locked - so it can sit on the hot paths and in the ISRs.
+ *
+ *	Each counter is counted from one context only (an ISR or the main loop), so the
+ *	increments don't race. Values are read without locking, like the _t? timing groups,
+ *	and may tear while the machine is running.
+ *
+ *	$pf lists the group, {"pf":n} returns it in JSON. $pfc=0 (or any value) clears all
+ *	counters, and setting a single counter (e.g. $pfrp=0) sets just that one.
+ *
+ *	Without __PERF_COUNTERS PERF_COUNT() compiles to nothing and the group is left out.
+ */
+#ifndef PERF_H_ONCE
+#define PERF_H_ONCE
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**** Registry ****/
+
+enum perfCounter {						// *** must agree with the pf group in config_app.c ***
+	PERF_REPLAN = 0,					// block list replans - _plan_block_list() (pfrp)
+	PERF_TRAPEZOID,						// trapezoids computed - mp_calculate_trapezoid() (pfzt)
+	PERF_TRAPEZOID_REUSED,				// trapezoids reused as the velocities had not changed (pfzr)
+	PERF_PARSE_ERROR,					// Gcode blocks that failed to parse (pfpe)
+	PERF_ISR_OVERRUN,					// DDA ISRs that ran past the next DDA tick (pfio)
+	PERF_TX_STALL,						// times the controller stopped for a full TX buffer (pfts)
+	PERF_XOFF,							// RX buffer reached high water - xio_xoff_usart() (pfxo)
+	PERF_COUNTERS						// count of counters - must be last
+};
+
+#ifdef __PERF_COUNTERS
+extern uint32_t perf[PERF_COUNTERS];
+#define PERF_COUNT(c) (perf[c]++)
+#else
+#define PERF_COUNT(c)
+#endif
+
+/**** Function Prototypes ****/
+
+stat_t perf_clear(nvObj_t *nv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // End of include guard: PERF_H_ONCE
@@ -26,9 +26,11 @@
  */
 #include "tinyg.h"
 #include "persistence.h"
+#include "controller.h"
 #include "report.h"
 #include "canonical_machine.h"
-#include "util.h"
+#include "util.h"
+#include "xio.h"
 
 #ifdef __AVR
 #include "xmega/xmega_eeprom.h"
@@ -44,69 +46,831 @@ nvmSingleton_t nvm;
  **** GENERIC STATIC FUNCTIONS AND VARIABLES ***************************************
  ***********************************************************************************/
 
+#ifdef __AVR
+static uint8_t _is_persisted(index_t index);
+static uint16_t _get_slot(index_t index);
+static void _write_selector(void);
+static void _erase_profiles(void);
+static uint16_t _journal_page_addr(uint16_t record);
+static void _journal_get_record(const int8_t *page, uint8_t slot, uint16_t *value_slot, float *value);
+static void _journal_scan(void);
+static void _journal_compact(void);
+static float _get_committed_value(index_t index);
+static void _commit_stage(void);
+static void _abort_stage(void);
+static void _checkpoint_scan(void);
+static uint8_t _checkpoint_check(const int8_t *page);
+static void _snapshot_put(uint8_t *chunk, uint8_t byte);
+static void _snapshot_send(const uint8_t *chunk, uint8_t length);
+static stat_t _snapshot_byte(uint8_t byte);
+static void _snapshot_apply(void);
+static stat_t _snapshot_fail(void);
+static void _write_profile(void);
+static void _journal_erase(void);
+#endif
 
 /***********************************************************************************
  **** CODE *************************************************************************
  ***********************************************************************************/
 
+/*
+ * persistence_init() - set up the profile and journal regions
+ *
+ *	NVM holds NVM_PROFILES profiles, followed by the journal. A profile holds only the
+ *	persisted values (F_PERSIST), NVM_VALUE_LEN each in config index order, and is page
+ *	aligned - a value's slot is the number of persisted values ahead of it in cfgArray.
+ *	The last page holds the active profile number (an erased page selects profile 0) and
+ *	the number of slots the profiles were written with, the NVM_CHECKPOINT_PAGES below it
+ *	are the power loss checkpoint ring and the page below that keeps the exceptions saved
+ *	at the last hard alarm. The journal always belongs to the active profile.
+ *
+ *	The profiles and at least NVM_JOURNAL_PAGES_MIN journal pages must fit below those
+ *	reserved pages (NVM_RESERVED_ADDR - see the layout in persistence.h), and the journal
+ *	ends there so it can never run into the ring. If they don't fit, nothing is read or
+ *	written to them - the config runs on the defaults, sets are refused with
+ *	STAT_PERSISTENCE_ERROR and the error is reported once the system is ready. If the profiles were written with a different
+ *	number of slots (a firmware that persists other values) they are erased along with
+ *	the journal, so config_init() loads the defaults rather than misplaced values.
+ *	Any records left in the journal from the last run are compacted into the profile
+ *	here, so config_init() can read the profile directly.
+ */
+
 void persistence_init()
 {
 #ifdef __AVR
 	nvm.base_addr = NVM_BASE_ADDR;
-	nvm.profile_base = 0;
+	nvm.slot_index = 0;
+	nvm.slot = 0;
+	nvm.profile_slots = _get_slot(nv_index_max());
+	nvm.profile_len = nvm.profile_slots * NVM_VALUE_LEN;
+	nvm.profile_len = (nvm.profile_len + NVM_PAGE_LEN-1) & ~(NVM_PAGE_LEN-1);
+	nvm.journal_base = NVM_PROFILES * nvm.profile_len;
+	nvm.shadow_valid = false;
+	nvm.stage_count = 0;
+	_checkpoint_scan();
+	if (nvm.journal_base + (NVM_JOURNAL_PAGES_MIN * NVM_PAGE_LEN) > NVM_RESERVED_ADDR) {
+		nvm.layout_error = true;
+		nvm.profile = 0;
+		nvm.journal_max = 0;
+		return;
+	}
+	nvm.journal_max = ((NVM_RESERVED_ADDR - nvm.journal_base) / NVM_PAGE_LEN) * NVM_RECORDS_PER_PAGE;
+
+	uint16_t slots;
+	(void)EEPROM_ReadBlock(NVM_SELECTOR_ADDR, nvm.page, 1 + sizeof(slots));
+	nvm.profile = (uint8_t)nvm.page[0];
+	memcpy(&slots, &nvm.page[1], sizeof(slots));
+	if (nvm.profile >= NVM_PROFILES) {
+		nvm.profile = 0;
+	}
+	if (slots != nvm.profile_slots) {
+		_erase_profiles();
+	}
+	nvm.profile_base = nvm.profile * nvm.profile_len;
+	_journal_scan();
+	if (nvm.journal_count > 0) {
+		_journal_compact();
+	}
 #endif
 	return;
 }
 
 /************************************************************************************
  * read_persistent_value()	- return value (as float) by index
- * write_persistent_value() - write to NVM by index, but only if the value has changed
+ * write_persistent_value() - stage a value to be written to NVM by index
+ * persistence_callback()	- commit staged values once writes have gone quiet
+ * persistence_flush()		- commit staged values now (unless the machine is moving)
+ * persistence_stage_room() - values that can be staged without forcing a commit
+ * persistence_select_profile() - make another stored profile the active one
  *
  *	It's the responsibility of the caller to make sure the index does not exceed range
+ *
+ *	Reads are served from a RAM shadow of NVM_SHADOW_LEN bytes. A miss reloads the shadow
+ *	with one block read starting at the value, so config_init() walking the profile in
+ *	index order costs one block read per NVM_SHADOW_LEN/NVM_VALUE_LEN values rather than
+ *	a separate read, each with its own NVM controller wait, for every value.
+ *	Reads return the profile value only - the journal is compacted by persistence_init().
+ *
+ *	Writes are staged in RAM and may be made while the machine is moving. Writing an index
+ *	that is already staged replaces the staged value. The stage is committed from the
+ *	controller when the machine is idle and no write has been staged for NVM_COMMIT_DELAY_MS,
+ *	or right away when it fills and the machine is idle. A write that finds the stage full
+ *	while moving is rejected as before (the RAM value still takes effect).
+ *
+ *	A commit drops the values that match what is already in NVM and appends the rest to the
+ *	journal as slot/value records, filling a page before writing it. A config push of N
+ *	values costs about N/NVM_RECORDS_PER_PAGE page writes. When the journal fills it is
+ *	compacted: each profile page with journalled values is written once with the latest of
+ *	them, then the journal pages are erased and refilling starts from the first page again.
+ *	This spreads the wear of frequent writes (e.g. G10 offsets) over the journal pages.
+ *
+ *	A compaction that is cut short by power loss is redone from the journal at the next
+ *	start, as the journal is erased only after the profile has been written.
+ *
+ *	Transactions ({"txn":1} begin, {"txn":2} commit, {"txn":0} abort) hold the stage so a
+ *	profile switch is written in one batch at commit and can be backed out. Sets still take
+ *	effect in RAM as they arrive, and the derived values they touch are rebuilt at commit
+ *	or abort if no move has needed them first (see config_update_derived()). Begin commits anything already staged and is refused
+ *	while the machine is moving; abort restores the persisted values from NVM. A transaction
+ *	holds at most NVM_STAGE_LEN persisted values - further writes are rejected until commit.
+ *	Only persisted values are covered - abort does not restore other settings.
+ *
+ *	Selecting a profile commits the stage and compacts the journal into the current profile,
+ *	then moves profile_base and records the choice in the selector page. A profile that has
+ *	never been written (its first value is not this firmware build) starts as a copy of the
+ *	current one. The caller reloads the config from the new profile - see set_pro().
  */
 
 #ifdef __AVR
 stat_t read_persistent_value(nvObj_t *nv)
 {
-	nvm.address = nvm.profile_base + (nv->index * NVM_VALUE_LEN);
-	(void)EEPROM_ReadBytes(nvm.address, nvm.byte_array, NVM_VALUE_LEN);
-	memcpy(&nv->value, &nvm.byte_array, NVM_VALUE_LEN);
+	if ((nvm.layout_error) || (_is_persisted(nv->index) == false)) {
+		nv->value = 0;									// not stored
+		return ((nvm.layout_error) ? STAT_PERSISTENCE_ERROR : STAT_OK);
+	}
+	nvm.address = nvm.profile_base + (_get_slot(nv->index) * NVM_VALUE_LEN);
+	if ((!nvm.shadow_valid) || (nvm.address < nvm.shadow_addr) ||
+		(nvm.address >= nvm.shadow_addr + NVM_SHADOW_LEN)) {
+		nvm.shadow_addr = min(nvm.address, NVM_SIZE - NVM_SHADOW_LEN);
+		(void)EEPROM_ReadBlock(nvm.shadow_addr, nvm.shadow, NVM_SHADOW_LEN);
+		nvm.shadow_valid = true;
+	}
+	memcpy(&nv->value, &nvm.shadow[nvm.address - nvm.shadow_addr], NVM_VALUE_LEN);
 	return (STAT_OK);
 }
-#endif // __AVR
 
-#ifdef __ARM
-stat_t read_persistent_value(nvObj_t *nv)
+stat_t write_persistent_value(nvObj_t *nv)
 {
-	nv->value = 0;
+	if (nvm.layout_error) {
+		return (STAT_PERSISTENCE_ERROR);				// reported once at boot (see persistence_init())
+	}
+	for (uint8_t i=0; i<nvm.stage_count; i++) {
+		if (nvm.stage_index[i] == nv->index) {
+			nvm.stage_value[i] = nv->value;
+			nvm.stage_tick = SysTickTimer_getValue();
+			return (STAT_OK);
+		}
+	}
+	if (nvm.stage_count == NVM_STAGE_LEN) {
+		if (nvm.txn_open)
+			return(rpt_exception(STAT_COMMAND_NOT_ACCEPTED));// transaction is full
+		if (cm.cycle_state != CYCLE_OFF)
+			return(rpt_exception(STAT_FILE_NOT_OPEN));	// can't commit when machine is moving
+		_commit_stage();
+	}
+	nvm.stage_index[nvm.stage_count] = nv->index;
+	nvm.stage_value[nvm.stage_count++] = nv->value;
+	nvm.stage_tick = SysTickTimer_getValue();
 	return (STAT_OK);
 }
-#endif // __ARM
 
-#ifdef __AVR
-stat_t write_persistent_value(nvObj_t *nv)
+stat_t persistence_callback()
 {
-	if (cm.cycle_state != CYCLE_OFF)
-        return(rpt_exception(STAT_FILE_NOT_OPEN));	// can't write when machine is moving
+	if ((nvm.stage_count == 0) || (nvm.txn_open)) return (STAT_NOOP);
+	if (cm.cycle_state != CYCLE_OFF) return (STAT_NOOP);	// EEPROM writes must wait for idle
+	if ((SysTickTimer_getValue() - nvm.stage_tick) < NVM_COMMIT_DELAY_MS) return (STAT_NOOP);
+	_commit_stage();
+	return (STAT_OK);
+}
 
-/* not needed
-	if (nv->valuetype == TYPE_FLOAT) {
-		if (isnan((double)nv->value)) return(rpt_exception(STAT_FLOAT_IS_NAN));		// bad floating point value
-		if (isinf((double)nv->value)) return(rpt_exception(STAT_FLOAT_IS_INFINITE));// bad floating point value
+void persistence_flush()
+{
+	if ((nvm.stage_count == 0) || (nvm.txn_open) || (cm.cycle_state != CYCLE_OFF)) return;
+	_commit_stage();
+}
+
+uint8_t persistence_stage_room()
+{
+	if (nvm.txn_open) return (0);				// don't mix other writes into a transaction
+	return (NVM_STAGE_LEN - nvm.stage_count);
+}
+
+stat_t persistence_set_txn(nvObj_t *nv)
+{
+	switch ((uint8_t)nv->value) {
+		case NVM_TXN_BEGIN: {
+			if ((nvm.txn_open) || (cm.cycle_state != CYCLE_OFF))
+				return (STAT_COMMAND_NOT_ACCEPTED);
+			persistence_flush();
+			nvm.txn_open = true;
+			break;
+		}
+		case NVM_TXN_COMMIT: {
+			if (!nvm.txn_open) return (STAT_COMMAND_NOT_ACCEPTED);
+			nvm.txn_open = false;
+			if (cm.cycle_state == CYCLE_OFF) {
+				_commit_stage();					// otherwise the callback commits it at idle
+			}
+			config_update_derived();				// apply the transaction's settings together
+			break;
+		}
+		case NVM_TXN_ABORT: {
+			if (!nvm.txn_open) return (STAT_COMMAND_NOT_ACCEPTED);
+			_abort_stage();
+			nvm.txn_open = false;
+			config_update_derived();				// rebuild from the restored values
+			break;
+		}
+		default: return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	return (STAT_OK);
+}
+
+stat_t persistence_select_profile(uint8_t profile)
+{
+	if (profile >= NVM_PROFILES) return (STAT_INPUT_EXCEEDS_MAX_VALUE);
+	if (nvm.layout_error) return (STAT_PERSISTENCE_ERROR);
+	if ((nvm.txn_open) || (cm.cycle_state != CYCLE_OFF)) return (STAT_COMMAND_NOT_ACCEPTED);
+
+	persistence_flush();
+	if (nvm.journal_count > 0) {
+		_journal_compact();
+	}
+	if (profile == nvm.profile) return (STAT_OK);
+
+	uint16_t base = profile * nvm.profile_len;
+	float build;
+	(void)EEPROM_ReadBlock(base, (int8_t *)&build, NVM_VALUE_LEN);	// index 0 is the firmware build
+	if (build != cs.fw_build) {
+		for (uint16_t offset = 0; offset < nvm.profile_len; offset += NVM_PAGE_LEN) {
+			(void)EEPROM_ReadBlock(nvm.profile_base + offset, nvm.page, NVM_PAGE_LEN);
+			(void)EEPROM_WritePage(base + offset, nvm.page);
+		}
+	}
+	nvm.profile = profile;
+	nvm.profile_base = base;
+	nvm.shadow_valid = false;
+	_write_selector();
+	return (STAT_OK);
+}
+
+/*
+ * _is_persisted()	 - TRUE if a config index has a slot in the profile (F_PERSIST)
+ * _get_slot()		 - slot of a config index: the persisted values ahead of it
+ * _write_selector() - write the active profile number and the layout to the selector page
+ * _erase_profiles() - erase the profiles and the journal written with another layout
+ *
+ *	_get_slot() counts from a cursor that only moves forward, so walking the config in
+ *	index order (config_init(), the snapshot) costs one flag read per index. Going back
+ *	starts the count again from index 0.
+ */
+static uint8_t _is_persisted(index_t index)
+{
+	return ((pgm_read_byte(&cfgArray[index].flags) & F_PERSIST) != 0);
+}
+
+static uint16_t _get_slot(index_t index)
+{
+	if (index < nvm.slot_index) {
+		nvm.slot_index = 0;
+		nvm.slot = 0;
+	}
+	for ( ; nvm.slot_index < index; nvm.slot_index++) {
+		if (_is_persisted(nvm.slot_index)) {
+			nvm.slot++;
+		}
+	}
+	return (nvm.slot);
+}
+
+static void _write_selector()
+{
+	memset(nvm.page, 0xFF, NVM_PAGE_LEN);
+	nvm.page[0] = nvm.profile;
+	memcpy(&nvm.page[1], &nvm.profile_slots, sizeof(nvm.profile_slots));
+	(void)EEPROM_WritePage(NVM_SELECTOR_ADDR, nvm.page);
+}
+
+static void _erase_profiles()
+{
+	memset(nvm.page, 0xFF, NVM_PAGE_LEN);
+	for (uint8_t profile=0; profile<NVM_PROFILES; profile++) {
+		(void)EEPROM_WritePage(profile * nvm.profile_len, nvm.page);	// the firmware build won't match
+	}
+	for (uint16_t addr = nvm.journal_base; addr < NVM_RESERVED_ADDR; addr += NVM_PAGE_LEN) {
+		(void)EEPROM_WritePage(addr, nvm.page);
+	}
+	nvm.profile = 0;
+	_write_selector();
+}
+
+/*
+ * persistence_write_checkpoint() - write a checkpoint to the next page of the ring
+ * persistence_read_checkpoint()  - read the newest intact checkpoint, false if there is none
+ * _checkpoint_scan()	 - find the newest page of the ring (at init)
+ * _checkpoint_check()	 - check byte of a page: XOR of the checkpoint and sequence bytes
+ * persistence_write_exceptions() - save exception records to NVM (a NULL list erases them)
+ * persistence_read_exceptions()  - read the saved exception records, return how many
+ *
+ *	A checkpoint is NVM_CHECKPOINT_LEN bytes from the caller (see cm_checkpoint_callback())
+ *	followed by a check byte and a sequence number. Each one goes whole to the page after
+ *	the last, which spreads the wear over the ring. It is not staged - a page write only
+ *	loads the page buffer and starts the erase/write, so it can be made while the machine
+ *	is moving. The caller keeps writes well apart, as the next NVM access waits for it.
+ *
+ *	The newest page is the one the next page's sequence does not follow. A write cut short
+ *	by power loss fails its check byte, and the read falls back to the page before it.
+ *
+ *	The saved exceptions (see rpt_save_exceptions()) use the same page layout with the
+ *	record count in place of the sequence. They are written whole at a hard alarm, which
+ *	may come from the exec interrupt - the write only starts the erase/write of the page.
+ */
+void persistence_write_checkpoint(const int8_t *checkpoint)
+{
+	nvm.checkpoint_slot = (nvm.checkpoint_slot + 1) % NVM_CHECKPOINT_PAGES;
+	nvm.checkpoint_sequence = (nvm.checkpoint_sequence + 1) % NVM_CHECKPOINT_ERASED;
+	memcpy(nvm.page, checkpoint, NVM_CHECKPOINT_LEN);
+	nvm.page[NVM_PAGE_LEN-1] = (int8_t)nvm.checkpoint_sequence;
+	nvm.page[NVM_PAGE_LEN-2] = (int8_t)_checkpoint_check(nvm.page);
+	(void)EEPROM_WritePage(NVM_CHECKPOINT_ADDR + (nvm.checkpoint_slot * NVM_PAGE_LEN), nvm.page);
+}
+
+uint8_t persistence_read_checkpoint(int8_t *checkpoint)
+{
+	uint8_t slot = nvm.checkpoint_slot;
+	for (uint8_t i=0; i<2; i++) {							// the newest, or the one before it
+		(void)EEPROM_ReadBlock(NVM_CHECKPOINT_ADDR + (slot * NVM_PAGE_LEN), nvm.page, NVM_PAGE_LEN);
+		if (((uint8_t)nvm.page[NVM_PAGE_LEN-1] != NVM_CHECKPOINT_ERASED) &&
+			((uint8_t)nvm.page[NVM_PAGE_LEN-2] == _checkpoint_check(nvm.page))) {
+			memcpy(checkpoint, nvm.page, NVM_CHECKPOINT_LEN);
+			return (true);
+		}
+		slot = (slot + NVM_CHECKPOINT_PAGES-1) % NVM_CHECKPOINT_PAGES;
+	}
+	return (false);
+}
+
+void persistence_write_exceptions(const int8_t *records, uint8_t count)
+{
+	memset(nvm.page, 0xFF, NVM_PAGE_LEN);
+	if (records != NULL) {
+		memcpy(nvm.page, records, min(count * EXCEPTION_RECORD_LEN, NVM_EXCEPTION_LEN));
+		nvm.page[NVM_PAGE_LEN-1] = (int8_t)count;
+		nvm.page[NVM_PAGE_LEN-2] = (int8_t)_checkpoint_check(nvm.page);
+	}
+	(void)EEPROM_WritePage(NVM_EXCEPTION_ADDR, nvm.page);
+}
+
+uint8_t persistence_read_exceptions(int8_t *records)
+{
+	(void)EEPROM_ReadBlock(NVM_EXCEPTION_ADDR, nvm.page, NVM_PAGE_LEN);
+	uint8_t count = (uint8_t)nvm.page[NVM_PAGE_LEN-1];
+	if ((count > EXCEPTION_SAVE_LEN) || ((uint8_t)nvm.page[NVM_PAGE_LEN-2] != _checkpoint_check(nvm.page))) {
+		return (0);											// erased, or cut short by power loss
+	}
+	memcpy(records, nvm.page, count * EXCEPTION_RECORD_LEN);
+	return (count);
+}
+
+static void _checkpoint_scan()
+{
+	uint8_t sequence[NVM_CHECKPOINT_PAGES];
+	for (uint8_t i=0; i<NVM_CHECKPOINT_PAGES; i++) {
+		(void)EEPROM_ReadBlock(NVM_CHECKPOINT_ADDR + (i * NVM_PAGE_LEN) + NVM_PAGE_LEN-1, (int8_t *)&sequence[i], 1);
+	}
+	nvm.checkpoint_slot = NVM_CHECKPOINT_PAGES-1;			// an erased ring starts at page 0, sequence 0
+	nvm.checkpoint_sequence = NVM_CHECKPOINT_ERASED-1;
+	for (uint8_t i=0; i<NVM_CHECKPOINT_PAGES; i++) {
+		if (sequence[i] == NVM_CHECKPOINT_ERASED) continue;
+		if (sequence[(i+1) % NVM_CHECKPOINT_PAGES] != (sequence[i]+1) % NVM_CHECKPOINT_ERASED) {
+			nvm.checkpoint_slot = i;
+			nvm.checkpoint_sequence = sequence[i];
+			break;
+		}
+	}
+}
+
+static uint8_t _checkpoint_check(const int8_t *page)
+{
+	uint8_t check = (uint8_t)page[NVM_PAGE_LEN-1];
+	for (uint8_t i=0; i<NVM_CHECKPOINT_LEN; i++) {
+		check ^= (uint8_t)page[i];
+	}
+	return (check);
+}
+
+/*
+ * persistence_get_snapshot() - send the active profile as a config snapshot, return its length
+ * persistence_set_snapshot() - 1 begins an import, "n:base64" takes snapshot line n, 0 abandons it
+ * _snapshot_put()	 - add a byte to the export, sending the line when it is full
+ * _snapshot_send()	 - send a line of the export: {"snap":"n:base64"}
+ * _snapshot_byte()	 - take the next byte of an import: EAGAIN wants more, OK when the CRC checks
+ * _snapshot_apply() - set the value of a complete record, if this firmware still has its token
+ * _snapshot_fail()	 - end an import that went wrong and reload the config from NVM
+ * _write_profile()	 - write the persisted values in RAM to the profile, a page at a time
+ *
+ *	A snapshot backs up or restores a whole machine in one go, in place of a $$ dump and
+ *	an object by object replay of it. It is the persisted values of the active profile:
+ *
+ *		version (1 byte, SNAPSHOT_VERSION) and record bytes (2 bytes, little-endian)
+ *		records - token (NUL terminated) then value (float, NVM byte order), one per value
+ *		CRC-16/CCITT of everything before it (2 bytes, little-endian) - see compute_crc16()
+ *
+ *	The records carry tokens rather than indexes so a snapshot survives firmware updates
+ *	that rearrange cfgArray: tokens this firmware doesn't have are skipped and settings the
+ *	snapshot doesn't have keep their values. The version changes if the layout ever does.
+ *
+ *	The export goes out SNAPSHOT_CHUNK_LEN bytes a line, base64 encoded and numbered from 0.
+ *	The lines are import commands already, so a restore is {"snap":1} and then the lines as
+ *	they were received (in JSON - the text parser lower-cases the line, which base64 can't
+ *	stand). Each line returns the bytes taken so far. Imported values take effect in RAM as
+ *	they arrive. A line out of sequence, bad base64 or a failed CRC ends the import with
+ *	STAT_CONFIG_SNAPSHOT_ERROR and the config is reloaded from NVM, so nothing is kept.
+ *	Once the CRC checks the profile is written in one pass - only the pages that changed,
+ *	each once - and the journal and stage are dropped, as the profile now holds what RAM
+ *	holds. Export and import need the machine idle and no config transaction open.
+ */
+stat_t persistence_get_snapshot(nvObj_t *nv)
+{
+	if ((nvm.txn_open) || (nvm.snap_open) || (cm.cycle_state != CYCLE_OFF))
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	persistence_flush();
+	if (nvm.journal_count > 0) {
+		_journal_compact();							// so the profile is all there is
+	}
+	uint8_t chunk[SNAPSHOT_CHUNK_LEN];
+	nvObj_t rec;
+	cfgItem_t item;
+	uint16_t length = 0;
+
+	for (rec.index=0; nv_index_is_single(rec.index); rec.index++) {	// size the records first
+		GET_TABLE_ITEM(rec.index, &item);
+		if (item.flags & F_PERSIST) {
+			length += strlen((const char *)item.token) + 1 + NVM_VALUE_LEN;
+		}
+	}
+	nvm.snap_pos = 0;
+	nvm.snap_line = 0;
+	nvm.snap_crc = 0xFFFF;
+	_snapshot_put(chunk, SNAPSHOT_VERSION);
+	_snapshot_put(chunk, (uint8_t)length);
+	_snapshot_put(chunk, (uint8_t)(length >> 8));
+	for (rec.index=0; nv_index_is_single(rec.index); rec.index++) {
+		GET_TABLE_ITEM(rec.index, &item);
+		if ((item.flags & F_PERSIST) == 0) continue;
+		uint8_t i = 0;
+		do {
+			_snapshot_put(chunk, item.token[i]);
+		} while (item.token[i++] != NUL);
+		read_persistent_value(&rec);
+		for (i=0; i<NVM_VALUE_LEN; i++) {
+			_snapshot_put(chunk, ((uint8_t *)&rec.value)[i]);
+		}
+	}
+	uint16_t crc = nvm.snap_crc;
+	_snapshot_put(chunk, (uint8_t)crc);
+	_snapshot_put(chunk, (uint8_t)(crc >> 8));
+	if ((nvm.snap_pos % SNAPSHOT_CHUNK_LEN) != 0) {
+		_snapshot_send(chunk, nvm.snap_pos % SNAPSHOT_CHUNK_LEN);
+	}
+	nv->value = (float)nvm.snap_pos;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t persistence_set_snapshot(nvObj_t *nv)
+{
+	if (nv->valuetype != TYPE_STRING) {
+		if (fp_ZERO(nv->value)) {					// abandon the import
+			if (nvm.snap_open == false) return (STAT_COMMAND_NOT_ACCEPTED);
+			nvm.snap_open = false;
+			config_reload_profile();
+		} else {									// begin an import
+			if (nvm.layout_error) return (STAT_PERSISTENCE_ERROR);	// nowhere to write it
+			if ((nvm.txn_open) || (nvm.snap_open) || (cm.cycle_state != CYCLE_OFF))
+				return (STAT_COMMAND_NOT_ACCEPTED);
+			nvm.snap_open = true;
+			nvm.snap_line = 0;
+			nvm.snap_pos = 0;
+			nvm.snap_crc = 0xFFFF;
+			nvm.snap_record_len = 0;
+		}
+		nv->value = 0;
+		nv->valuetype = TYPE_INTEGER;
+		return (STAT_OK);
+	}
+	if (nvm.snap_open == false) return (STAT_COMMAND_NOT_ACCEPTED);
+	if (cm.cycle_state != CYCLE_OFF) return (STAT_COMMAND_NOT_ACCEPTED);	// send the line again when idle
+
+	uint8_t chunk[SNAPSHOT_CHUNK_LEN];
+	char_t *str = *nv->stringp;
+	uint16_t line = 0;
+	int16_t length;
+
+	while ((*str >= '0') && (*str <= '9')) {
+		line = line * 10 + (*str++ - '0');
+	}
+	if ((str == *nv->stringp) || (*str++ != ':') || (line != nvm.snap_line) ||
+		(strlen((const char *)str) > SNAPSHOT_CHUNK_LEN/3*4) || ((length = base64_decode(chunk, str)) <= 0)) {
+		return (_snapshot_fail());
+	}
+	nvm.snap_line++;
+
+	stat_t status = STAT_EAGAIN;
+	uint8_t units = cm_get_units_mode(MODEL);
+	cm_set_units_mode(MILLIMETERS);					// NVM values are in canonical units
+	for (int16_t i=0; i<length; i++) {
+		if (status != STAT_EAGAIN) {
+			status = STAT_CONFIG_SNAPSHOT_ERROR;	// bytes past the CRC
+			break;
+		}
+		status = _snapshot_byte(chunk[i]);
+	}
+	cm_set_units_mode(units);
+
+	if (status == STAT_OK) {
+		nvm.snap_open = false;
+		nvm.stage_count = 0;						// RAM has it all - the profile gets it below
+		_write_profile();
+		_journal_erase();
+		config_update_derived();
+	} else if (status != STAT_EAGAIN) {
+		return (_snapshot_fail());
+	}
+	nv->value = (float)nvm.snap_pos;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+static void _snapshot_put(uint8_t *chunk, uint8_t byte)
+{
+	nvm.snap_crc = update_crc16(nvm.snap_crc, &byte, 1);
+	chunk[nvm.snap_pos++ % SNAPSHOT_CHUNK_LEN] = byte;
+	if ((nvm.snap_pos % SNAPSHOT_CHUNK_LEN) == 0) {
+		_snapshot_send(chunk, SNAPSHOT_CHUNK_LEN);
+	}
+}
+
+static void _snapshot_send(const uint8_t *chunk, uint8_t length)
+{
+	char_t line[SNAPSHOT_CHUNK_LEN/3*4 + 1];
+	base64_encode(line, chunk, length);
+	printf_P(PSTR("{\"snap\":\"%u:%s\"}\n"), nvm.snap_line++, line);
+}
+
+static stat_t _snapshot_byte(uint8_t byte)
+{
+	uint16_t pos = nvm.snap_pos++;
+
+	if (pos < SNAPSHOT_HEADER_LEN) {
+		nvm.snap_crc = update_crc16(nvm.snap_crc, &byte, 1);
+		if (pos == 0) {
+			return ((byte == SNAPSHOT_VERSION) ? STAT_EAGAIN : STAT_CONFIG_SNAPSHOT_ERROR);
+		}
+		if (pos == 1) {
+			nvm.snap_len = byte;
+		} else {
+			nvm.snap_len |= (uint16_t)byte << 8;
+		}
+		return (STAT_EAGAIN);
+	}
+	pos -= SNAPSHOT_HEADER_LEN;
+	if (pos < nvm.snap_len) {									// record bytes
+		nvm.snap_crc = update_crc16(nvm.snap_crc, &byte, 1);
+		nvm.snap_record[nvm.snap_record_len++] = byte;
+		uint8_t *end = (uint8_t *)memchr(nvm.snap_record, NUL, nvm.snap_record_len);
+		if (end == NULL) {
+			return ((nvm.snap_record_len > TOKEN_LEN) ? STAT_CONFIG_SNAPSHOT_ERROR : STAT_EAGAIN);
+		}
+		if (nvm.snap_record_len == (end - nvm.snap_record) + 1 + NVM_VALUE_LEN) {
+			_snapshot_apply();
+			nvm.snap_record_len = 0;
+		}
+		return (STAT_EAGAIN);
+	}
+	if (pos == nvm.snap_len) {									// CRC, low byte first
+		if (nvm.snap_record_len != 0) return (STAT_CONFIG_SNAPSHOT_ERROR);	// records ended mid record
+		nvm.snap_record[0] = byte;
+		return (STAT_EAGAIN);
+	}
+	if (nvm.snap_crc != (nvm.snap_record[0] | ((uint16_t)byte << 8))) {
+		return (STAT_CONFIG_SNAPSHOT_ERROR);
 	}
-*/
-	nvm.tmp_value = nv->value;
-	ritorno(read_persistent_value(nv));
-	if ((isnan((double)nv->value)) || (isinf((double)nv->value)) || (fp_NE(nv->value, nvm.tmp_value))) {
-		memcpy(&nvm.byte_array, &nvm.tmp_value, NVM_VALUE_LEN);
-		nvm.address = nvm.profile_base + (nv->index * NVM_VALUE_LEN);
-		(void)EEPROM_WriteBytes(nvm.address, nvm.byte_array, NVM_VALUE_LEN);
-	}
-	nv->value =nvm.tmp_value;		// always restore value
 	return (STAT_OK);
 }
+
+static void _snapshot_apply()
+{
+	nvObj_t rec;
+	cfgItem_t item;
+	uint8_t token_len = strlen((const char *)nvm.snap_record);
+
+	memset(&rec, 0, sizeof(nvObj_t));
+	rec.index = nv_get_index((const char_t *)"", (const char_t *)nvm.snap_record);
+	if (rec.index == NO_MATCH) return;							// a setting this firmware doesn't have
+	GET_TABLE_ITEM(rec.index, &item);
+	if ((item.flags & F_PERSIST) == 0) return;
+	memcpy(&rec.value, &nvm.snap_record[token_len + 1], NVM_VALUE_LEN);
+	if ((isnan((double)rec.value)) || (isinf((double)rec.value))) return;
+	strncpy(rec.token, item.token, TOKEN_LEN);
+	nv_set(&rec);
+}
+
+static stat_t _snapshot_fail()
+{
+	nvm.snap_open = false;
+	config_reload_profile();									// drop what was taken
+	return (STAT_CONFIG_SNAPSHOT_ERROR);
+}
+
+static void _write_profile()
+{
+	nvObj_t rec;
+	cfgItem_t item;
+	memset(&rec, 0, sizeof(nvObj_t));
+	uint8_t units = cm_get_units_mode(MODEL);
+	cm_set_units_mode(MILLIMETERS);
+
+	uint16_t page_addr = 0;
+	uint8_t loaded = false;
+	uint8_t dirty = false;
+	for (rec.index=0; nv_index_is_single(rec.index); rec.index++) {
+		GET_TABLE_ITEM(rec.index, &item);
+		if ((item.flags & F_PERSIST) == 0) continue;
+		uint16_t addr = nvm.profile_base + (_get_slot(rec.index) * NVM_VALUE_LEN);
+		if ((!loaded) || ((addr & ~(NVM_PAGE_LEN-1)) != page_addr)) {
+			if (dirty) {
+				(void)EEPROM_WritePage(page_addr, nvm.page);
+			}
+			page_addr = addr & ~(NVM_PAGE_LEN-1);
+			(void)EEPROM_ReadBlock(page_addr, nvm.page, NVM_PAGE_LEN);
+			loaded = true;
+			dirty = false;
+		}
+		strncpy(rec.token, item.token, TOKEN_LEN);
+		nv_get(&rec);
+		if (memcmp(&nvm.page[addr - page_addr], &rec.value, NVM_VALUE_LEN) != 0) {
+			memcpy(&nvm.page[addr - page_addr], &rec.value, NVM_VALUE_LEN);
+			dirty = true;
+		}
+	}
+	if (dirty) {
+		(void)EEPROM_WritePage(page_addr, nvm.page);
+	}
+	cm_set_units_mode(units);
+	nvm.shadow_valid = false;
+}
+
+/*
+ * _journal_page_addr()	 - NVM address of the journal page holding a record
+ * _journal_get_record() - unpack a record from a journal page buffer
+ * _journal_scan()		 - count the records in the journal (the first erased record ends it)
+ * _journal_compact()	 - write the journal into the profile and erase it
+ * _journal_erase()		 - erase the journal pages that were used
+ * _get_committed_value() - value of an index as it stands in NVM: latest journal record or profile
+ * _commit_stage()		 - append the staged values that changed to the journal
+ * _abort_stage()		 - set the staged indexes back to their values in NVM and drop them
+ */
+
+static uint16_t _journal_page_addr(uint16_t record)
+{
+	return (nvm.journal_base + (record / NVM_RECORDS_PER_PAGE) * NVM_PAGE_LEN);
+}
+
+static void _journal_get_record(const int8_t *page, uint8_t slot, uint16_t *value_slot, float *value)
+{
+	memcpy(value_slot, &page[slot * NVM_RECORD_LEN], sizeof(uint16_t));
+	memcpy(value, &page[slot * NVM_RECORD_LEN + sizeof(uint16_t)], NVM_VALUE_LEN);
+}
+
+static void _journal_scan()
+{
+	int8_t page[NVM_PAGE_LEN];
+	uint16_t value_slot;
+	float value;
+
+	for (nvm.journal_count = 0; nvm.journal_count < nvm.journal_max; nvm.journal_count++) {
+		uint8_t slot = nvm.journal_count % NVM_RECORDS_PER_PAGE;
+		if (slot == 0) {
+			(void)EEPROM_ReadBlock(_journal_page_addr(nvm.journal_count), page, NVM_PAGE_LEN);
+		}
+		_journal_get_record(page, slot, &value_slot, &value);
+		if (value_slot >= nvm.profile_slots) break;		// erased (or not a journal record)
+	}
+}
+
+static void _journal_compact()
+{
+	int8_t page[NVM_PAGE_LEN];
+	uint16_t value_slot;
+	float value;
+
+	for (uint16_t addr = nvm.profile_base; addr < nvm.profile_base + nvm.profile_len; addr += NVM_PAGE_LEN) {
+		uint8_t dirty = false;
+		(void)EEPROM_ReadBlock(addr, nvm.page, NVM_PAGE_LEN);
+		for (uint16_t r=0; r < nvm.journal_count; r++) {
+			uint8_t slot = r % NVM_RECORDS_PER_PAGE;
+			if (slot == 0) {
+				(void)EEPROM_ReadBlock(_journal_page_addr(r), page, NVM_PAGE_LEN);
+			}
+			_journal_get_record(page, slot, &value_slot, &value);
+			uint16_t value_addr = nvm.profile_base + (value_slot * NVM_VALUE_LEN);
+			if ((value_addr >= addr) && (value_addr < addr + NVM_PAGE_LEN)) {
+				memcpy(&nvm.page[value_addr - addr], &value, NVM_VALUE_LEN);
+				dirty = true;
+			}
+		}
+		if (dirty) {
+			(void)EEPROM_WritePage(addr, nvm.page);
+		}
+	}
+	_journal_erase();
+	nvm.shadow_valid = false;
+}
+
+static void _journal_erase()
+{
+	memset(nvm.page, 0xFF, NVM_PAGE_LEN);
+	for (uint16_t r=0; r < nvm.journal_count; r += NVM_RECORDS_PER_PAGE) {
+		(void)EEPROM_WritePage(_journal_page_addr(r), nvm.page);
+	}
+	nvm.journal_count = 0;
+}
+
+static float _get_committed_value(index_t index)
+{
+	int8_t page[NVM_PAGE_LEN];
+	uint16_t value_slot = _get_slot(index);
+	uint16_t record_slot;
+	float value;
+
+	for (uint16_t r = nvm.journal_count; r > 0; r--) {			// newest record first
+		uint8_t slot = (r-1) % NVM_RECORDS_PER_PAGE;
+		if ((r == nvm.journal_count) || (slot == NVM_RECORDS_PER_PAGE-1)) {
+			(void)EEPROM_ReadBlock(_journal_page_addr(r-1), page, NVM_PAGE_LEN);
+		}
+		_journal_get_record(page, slot, &record_slot, &value);
+		if (record_slot == value_slot) return (value);
+	}
+	nvObj_t nv;
+	nv.index = index;
+	read_persistent_value(&nv);
+	return (nv.value);
+}
+
+static void _commit_stage()
+{
+	uint8_t dirty = false;
+	(void)EEPROM_ReadBlock(_journal_page_addr(nvm.journal_count), nvm.page, NVM_PAGE_LEN);
+
+	for (uint8_t i=0; i<nvm.stage_count; i++) {
+		float committed = _get_committed_value(nvm.stage_index[i]);
+		if ((!isnan((double)committed)) && (!isinf((double)committed)) &&
+			(fp_EQ(committed, nvm.stage_value[i]))) {
+			continue;												// already in NVM
+		}
+		if (nvm.journal_count == nvm.journal_max) {					// full: fold it into the profile
+			if (dirty) {
+				(void)EEPROM_WritePage(_journal_page_addr(nvm.journal_count-1), nvm.page);
+			}
+			_journal_compact();										// leaves nvm.page erased
+			dirty = false;
+		}
+		uint8_t slot = nvm.journal_count % NVM_RECORDS_PER_PAGE;
+		uint16_t value_slot = _get_slot(nvm.stage_index[i]);
+		memcpy(&nvm.page[slot * NVM_RECORD_LEN], &value_slot, sizeof(uint16_t));
+		memcpy(&nvm.page[slot * NVM_RECORD_LEN + sizeof(uint16_t)], &nvm.stage_value[i], NVM_VALUE_LEN);
+		nvm.journal_count++;
+		dirty = true;
+		if (slot == NVM_RECORDS_PER_PAGE-1) {						// page is full - write it
+			(void)EEPROM_WritePage(_journal_page_addr(nvm.journal_count-1), nvm.page);
+			memset(nvm.page, 0xFF, NVM_PAGE_LEN);					// the next page is erased
+			dirty = false;
+		}
+	}
+	if (dirty) {
+		(void)EEPROM_WritePage(_journal_page_addr(nvm.journal_count-1), nvm.page);
+	}
+	nvm.stage_count = 0;
+}
+
+static void _abort_stage()
+{
+	nvObj_t nv;
+	memset(&nv, 0, sizeof(nvObj_t));
+	uint8_t units = cm_get_units_mode(MODEL);
+	cm_set_units_mode(MILLIMETERS);								// NVM values are in canonical units
+
+	for (uint8_t i=0; i<nvm.stage_count; i++) {
+		nv.index = nvm.stage_index[i];
+		nv.value = _get_committed_value(nv.index);
+		if ((isnan((double)nv.value)) || (isinf((double)nv.value))) continue;
+		strncpy_P(nv.token, cfgArray[nv.index].token, TOKEN_LEN);
+		nv_set(&nv);
+	}
+	cm_set_units_mode(units);
+	nvm.stage_count = 0;
+}
 #endif // __AVR
 
+#ifdef __ARM
+stat_t read_persistent_value(nvObj_t *nv)
+{
+	nv->value = 0;
+	return (STAT_OK);
+}
+#endif // __ARM
+
 #ifdef __ARM
 stat_t write_persistent_value(nvObj_t *nv)
 {
@@ -121,6 +885,18 @@ stat_t write_persistent_value(nvObj_t *nv)
 */
 	return (STAT_OK);
 }
+
+stat_t persistence_callback() { return (STAT_NOOP);}
+void persistence_flush() {}
+uint8_t persistence_stage_room() { return ((cm.cycle_state == CYCLE_OFF) ? NVM_STAGE_LEN : 0);}
+stat_t persistence_set_txn(nvObj_t *nv) { return (STAT_OK);}
+stat_t persistence_select_profile(uint8_t profile) { return (STAT_OK);}
+void persistence_write_checkpoint(const int8_t *checkpoint) {}
+uint8_t persistence_read_checkpoint(int8_t *checkpoint) { return (false);}
+void persistence_write_exceptions(const int8_t *records, uint8_t count) {}
+uint8_t persistence_read_exceptions(int8_t *records) { return (0);}
+stat_t persistence_get_snapshot(nvObj_t *nv) { return (STAT_COMMAND_NOT_ACCEPTED);}
+stat_t persistence_set_snapshot(nvObj_t *nv) { return (STAT_COMMAND_NOT_ACCEPTED);}
 #endif // __ARM
 
 #ifdef __cplusplus
@@ -32,21 +32,113 @@
 
 #define NVM_VALUE_LEN 4					// NVM value length (float, fixed length)
 #define NVM_BASE_ADDR 0x0000			// base address of usable NVM
+#define NVM_SIZE 4096					// size of usable NVM (xmega192/256 EEPROM)
+#define NVM_SHADOW_LEN 64				// RAM shadow size; must be a multiple of NVM_VALUE_LEN
+#define NVM_PAGE_LEN 32					// NVM page size (EEPROM_PAGESIZE)
+#define NVM_RECORD_LEN 6				// journal record: profile slot (2 bytes) + value (4 bytes)
+#define NVM_RECORDS_PER_PAGE (NVM_PAGE_LEN / NVM_RECORD_LEN)
+#define NVM_INDEX_EMPTY 0xFFFF			// slot of an erased journal record
+#define NVM_JOURNAL_PAGES_MIN 4			// least journal the profiles must leave room for
+#define NVM_STAGE_LEN 32				// values staged in RAM between journal commits (and per transaction)
+#define NVM_COMMIT_DELAY_MS 250			// commit staged values after this long without a new write
+#define NVM_PROFILES 2					// stored machine profiles, selected with {"pro":n}
+#define NVM_CHECKPOINT_PAGES 8			// power loss checkpoint ring
+#define NVM_CHECKPOINT_LEN (NVM_PAGE_LEN - 2)	// checkpoint bytes per page (then check byte and sequence)
+#define NVM_CHECKPOINT_ERASED 0xFF		// sequence of an erased page - sequences run 0 to 254
+#define NVM_EXCEPTION_LEN (NVM_PAGE_LEN - 2)	// exception bytes in the page (then check byte and count)
+
+/* NVM layout, low to high addresses:
+ *
+ *	NVM_BASE_ADDR		profile 0 ... profile NVM_PROFILES-1	sized at run time (see persistence_init())
+ *						journal									from there to NVM_RESERVED_ADDR
+ *	NVM_RESERVED_ADDR	exception page							NVM_EXCEPTION_ADDR
+ *						checkpoint ring							NVM_CHECKPOINT_ADDR
+ *						selector page							NVM_SELECTOR_ADDR, the last page
+ *
+ *	The reserved pages are fixed. The profiles and journal only ever use the space below
+ *	NVM_RESERVED_ADDR - persistence_init() refuses a layout that doesn't fit there.
+ */
+#define NVM_RESERVED_PAGES (1 + NVM_CHECKPOINT_PAGES + 1)	// exception page, checkpoint ring, selector
+#define NVM_RESERVED_ADDR (NVM_SIZE - (NVM_RESERVED_PAGES * NVM_PAGE_LEN))
+#define NVM_EXCEPTION_ADDR NVM_RESERVED_ADDR					// exceptions saved at a hard alarm
+#define NVM_CHECKPOINT_ADDR (NVM_EXCEPTION_ADDR + NVM_PAGE_LEN)
+#define NVM_SELECTOR_ADDR (NVM_CHECKPOINT_ADDR + (NVM_CHECKPOINT_PAGES * NVM_PAGE_LEN))
+
+#if (NVM_SELECTOR_ADDR != NVM_SIZE - NVM_PAGE_LEN)
+#error the reserved NVM pages do not add up to NVM_RESERVED_PAGES
+#endif
+#if (NVM_RESERVED_ADDR < NVM_BASE_ADDR + (NVM_JOURNAL_PAGES_MIN * NVM_PAGE_LEN))
+#error the reserved NVM pages leave no room for the profiles and the journal
+#endif
+
+#define SNAPSHOT_VERSION 1				// config snapshot layout (see persistence_get_snapshot())
+#define SNAPSHOT_HEADER_LEN 3			// version and record length
+#define SNAPSHOT_CHUNK_LEN 48			// snapshot bytes per line - must be a multiple of 3 (base64)
 
 //**** persistence singleton ****
 
 typedef struct nvmSingleton {
 	uint16_t base_addr;					// NVM base address
 	uint16_t profile_base;				// NVM base address of current profile]
+	uint16_t profile_len;				// NVM bytes per profile (page aligned)
+	uint16_t profile_slots;				// persisted values per profile - the layout (see persistence_init())
+	index_t slot_index;					// config index the slot cursor is at...
+	uint16_t slot;						// ...and its slot: the persisted values ahead of it
+	uint8_t layout_error;				// TRUE if the profiles don't fit - nothing is stored
+	uint8_t profile;					// active profile number
 	uint16_t address;
 	float tmp_value;
 	int8_t byte_array[NVM_VALUE_LEN];
+	uint16_t shadow_addr;				// NVM address of the first byte in the shadow
+	uint8_t shadow_valid;				// shadow holds NVM contents from shadow_addr
+	int8_t shadow[NVM_SHADOW_LEN];		// block of NVM read in one pass
+
+	uint16_t journal_base;				// NVM address of the first journal page (follows the profile)
+	uint16_t journal_count;				// records in the journal
+	uint16_t journal_max;				// journal capacity in records
+	int8_t page[NVM_PAGE_LEN];			// page buffer for journal and compaction writes
+
+	uint8_t stage_count;				// values waiting to be committed
+	uint32_t stage_tick;				// SysTick of the most recent staged write
+	index_t stage_index[NVM_STAGE_LEN];
+	float stage_value[NVM_STAGE_LEN];
+	uint8_t txn_open;					// a config transaction is holding the stage
+
+	uint8_t checkpoint_slot;			// ring page of the newest checkpoint
+	uint8_t checkpoint_sequence;		// ...and its sequence number
+
+	uint8_t snap_open;					// a config snapshot import is in progress
+	uint16_t snap_line;					// number of the next snapshot line
+	uint16_t snap_pos;					// snapshot bytes taken so far
+	uint16_t snap_len;					// record bytes in the snapshot (from its header)
+	uint16_t snap_crc;					// running CRC of the snapshot
+	uint8_t snap_record_len;			// bytes of the current record taken so far
+	uint8_t snap_record[TOKEN_LEN+1+NVM_VALUE_LEN];	// token and value of the current record
 } nvmSingleton_t;
 
+extern nvmSingleton_t nvm;
+
+enum nvmTransaction {					// values for {"txn":n}
+	NVM_TXN_ABORT = 0,					// restore the values set since begin and drop them
+	NVM_TXN_BEGIN,						// hold config writes in RAM until commit or abort
+	NVM_TXN_COMMIT						// write the values set since begin in one batch
+};
+
 //**** persistence function prototypes ****
 
 void persistence_init(void);
 stat_t read_persistent_value(nvObj_t *nv);
 stat_t write_persistent_value(nvObj_t *nv);
+stat_t persistence_callback(void);
+void persistence_flush(void);
+uint8_t persistence_stage_room(void);
+stat_t persistence_set_txn(nvObj_t *nv);
+stat_t persistence_select_profile(uint8_t profile);
+void persistence_write_checkpoint(const int8_t *checkpoint);
+uint8_t persistence_read_checkpoint(int8_t *checkpoint);
+void persistence_write_exceptions(const int8_t *records, uint8_t count);
+uint8_t persistence_read_exceptions(int8_t *records);
+stat_t persistence_get_snapshot(nvObj_t *nv);
+stat_t persistence_set_snapshot(nvObj_t *nv);
 
 #endif // End of include guard: PERSISTENCE_H_ONCE
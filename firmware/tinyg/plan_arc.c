@@ -42,7 +42,7 @@ arc_t arc;
 static stat_t _compute_arc(void);
 static stat_t _compute_arc_offsets_from_radius(void);
 static void _estimate_arc_time(void);
-//static stat_t _test_arc_soft_limits(void);
+static stat_t _test_arc_soft_limits(void);
 
 /*****************************************************************************
  * Canonical Machining arc functions (arc prep for planning and runtime)
@@ -68,8 +68,9 @@ void cm_arc_init()
 /*
  * cm_arc_feed() - canonical machine entry point for arc
  *
- * Generates an arc by queuing line segments to the move buffer. The arc is
- * approximated by generating a large number of tiny, linear arc_segments.
+ * Queues the arc as a single move (MOVE_TYPE_ARC) that the runtime interpolates. If the
+ * arc table is full the arc is approximated by queuing a number of tiny, linear
+ * arc_segments to the move buffer from cm_arc_callback().
 */
 //**************************************************************************************************
 
@@ -188,6 +189,14 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
         }
 	}
 
+	// G68/G51 keep arcs circular only in the XY plane and with equal X and Y scaling
+	if ((cm.gmx.transform_enable) &&
+		((cm.gm.select_plane != CANON_PLANE_XY) ||
+		 (fp_NE(fabs(cm.gmx.scaling_factor[0]), fabs(cm.gmx.scaling_factor[1])))))
+	{
+		return (STAT_TRANSFORM_SPECIFICATION_ERROR);
+	}
+
 	// set values in the Gcode model state & copy it (linenum was already captured)
 	cm_set_model_target(target, flags);
 
@@ -222,6 +231,17 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
 	arc.offset[1] = _to_millimeters(j);
 	arc.offset[2] = _to_millimeters(k);
 
+	// rotate and scale the center offset and radius. Mirroring one axis reverses the direction
+	if (cm.gmx.transform_enable)
+	{
+		cm_transform_vector(arc.offset);
+		arc.radius *= fabs(cm.gmx.scaling_factor[0]);
+		if ((cm.gmx.scaling_factor[0] * cm.gmx.scaling_factor[1]) < 0)
+		{
+			arc.gm.motion_mode = (motion_mode == MOTION_MODE_CW_ARC) ? MOTION_MODE_CCW_ARC : MOTION_MODE_CW_ARC;
+		}
+	}
+
 	// P must be a positive integer - force it if not
 	arc.rotations = floor(fabs(cm.gn.parameter));
 
@@ -237,8 +257,6 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
         return (STAT_MINIMUM_LENGTH_MOVE);
     }
 
-	//**********************************************************************************************
-	/*
     // test arc soft limits
 	stat_t status = _test_arc_soft_limits();
 	if (status != STAT_OK)
@@ -249,13 +267,31 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
     	copy_vector(cm.gm.target, cm.gmx.position);
     	return (cm_soft_alarm(status));
 	}
-	*/
-	//**********************************************************************************************
 
 	// if not already started
 	cm_cycle_start();
 
-	// enable arc to be run from the callback
+	// queue the arc as a single move if the arc table has room for it...
+	if (mp_get_arc_available() > 0)
+	{
+		mpArc_t geometry;
+
+		geometry.plane_axis_0 = arc.plane_axis_0;
+		geometry.plane_axis_1 = arc.plane_axis_1;
+		geometry.linear_axis = arc.linear_axis;
+		geometry.center_0 = arc.center_0;
+		geometry.center_1 = arc.center_1;
+		geometry.angular_rate = arc.angular_travel / arc.length;
+		geometry.linear_rate = arc.linear_travel / arc.length;
+
+		arc.gm.target[arc.linear_axis] = cm.gm.target[arc.linear_axis];
+		arc.gm.move_time = arc.arc_time;
+		stat_t status = mp_aarc(&arc.gm, &geometry, arc.length);
+		cm_finalize_move();
+		return (status);
+	}
+
+	// ...otherwise enable arc to be run as segments from the callback
 	arc.run_state = MOVE_RUN;
 	cm_finalize_move();
 	return (STAT_OK);
@@ -269,6 +305,10 @@ stat_t cm_arc_feed(float target[], float flags[],       // arc endpoints
  *	cm_arc_callback() is called from the controller main loop. Each time it's called it
  *	queues as many arc segments (lines) as it can before it blocks, then returns.
  *
+ *	Segment endpoints are found by rotating the radius vector by the constant segment angle,
+ *	which costs a few multiplies instead of a sin and a cos. The rounding error this builds up
+ *	is removed by computing every ARC_CORRECTION_SEGMENTS'th point with exact trig.
+ *
  *  Parts of this routine were originally sourced from the grbl project.
  */
 
@@ -280,11 +320,34 @@ stat_t cm_arc_callback()
 	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM)
         return (STAT_EAGAIN);
 
+	// the arc tangents at both ends of the segment, for its junctions
+	float entry_unit[AXES] = {0};
+	float exit_unit[AXES] = {0};
+	float tangent = arc.radius * arc.arc_segment_theta / arc.arc_segment_length;
+	entry_unit[arc.plane_axis_0] = tangent * cos(arc.theta);
+	entry_unit[arc.plane_axis_1] = -tangent * sin(arc.theta);
+	entry_unit[arc.linear_axis] = arc.arc_segment_linear_travel / arc.arc_segment_length;
+
+	// step the radius vector by rotation, resyncing to exact trig every few segments
 	arc.theta += arc.arc_segment_theta;
-	arc.gm.target[arc.plane_axis_0] = arc.center_0 + sin(arc.theta) * arc.radius;
-	arc.gm.target[arc.plane_axis_1] = arc.center_1 + cos(arc.theta) * arc.radius;
+	if (--arc.arc_correction_count == 0)
+	{
+		arc.arc_correction_count = ARC_CORRECTION_SEGMENTS;
+		arc.gm.target[arc.plane_axis_0] = arc.center_0 + sin(arc.theta) * arc.radius;
+		arc.gm.target[arc.plane_axis_1] = arc.center_1 + cos(arc.theta) * arc.radius;
+	}
+	else
+	{
+		float r_0 = arc.position[arc.plane_axis_0] - arc.center_0;
+		float r_1 = arc.position[arc.plane_axis_1] - arc.center_1;
+		arc.gm.target[arc.plane_axis_0] = arc.center_0 + r_0 * arc.arc_segment_cos + r_1 * arc.arc_segment_sin;
+		arc.gm.target[arc.plane_axis_1] = arc.center_1 + r_1 * arc.arc_segment_cos - r_0 * arc.arc_segment_sin;
+	}
 	arc.gm.target[arc.linear_axis] += arc.arc_segment_linear_travel;
-	mp_aline(&arc.gm);								// run the line
+	exit_unit[arc.plane_axis_0] = tangent * cos(arc.theta);
+	exit_unit[arc.plane_axis_1] = -tangent * sin(arc.theta);
+	exit_unit[arc.linear_axis] = entry_unit[arc.linear_axis];
+	mp_aline_segment(&arc.gm, arc.radius, entry_unit, exit_unit);	// run the line
 	copy_vector(arc.position, arc.gm.target);		// update arc current position
 
 	if (--arc.arc_segment_count > 0)
@@ -401,7 +464,7 @@ static stat_t _compute_arc()
 	        arc.angular_travel = arc.theta_end - arc.theta;
 
 			// reverse travel direction if it's CCW arc
-    	    if (cm.gm.motion_mode == MOTION_MODE_CCW_ARC)
+    	    if (arc.gm.motion_mode == MOTION_MODE_CCW_ARC)
 			{
                 arc.angular_travel -= (2*M_PI * g18_correction);
             }
@@ -409,7 +472,7 @@ static stat_t _compute_arc()
 	}
 
     // Add in travel for rotations
-    if (cm.gm.motion_mode == MOTION_MODE_CW_ARC)
+    if (arc.gm.motion_mode == MOTION_MODE_CW_ARC)
 	{
         arc.angular_travel += (2*M_PI * arc.rotations * g18_correction);
     }
@@ -429,12 +492,22 @@ static stat_t _compute_arc()
 	// get an estimate of execution time to inform arc_segment calculation
 	_estimate_arc_time();
 
-	// Find the minimum number of arc_segments that meets these constraints...
-	float arc_segments_for_chordal_accuracy = arc.length / sqrt(4*cm.chordal_tolerance * (2 * arc.radius - cm.chordal_tolerance));
-	float arc_segments_for_minimum_distance = arc.length / cm.arc_segment_len;
-	float arc_segments_for_minimum_time = arc.arc_time * MICROSECONDS_PER_MINUTE / MIN_ARC_SEGMENT_USEC;
+	// The chordal tolerance decides the number of arc_segments: a chord of length c on radius r
+	// has a sagitta of e where c = sqrt(4e(2r - e)). Only the planar travel counts - the linear
+	// axis of a helix moves in a straight line. Round up so the tolerance is never exceeded...
+	float arc_segments = 1;
+	float tolerance = cm_get_chordal_tolerance();					// $ct or the G187 preset's
+	if (tolerance < arc.radius) {
+		float chord_length = sqrt(4*tolerance * (2 * arc.radius - tolerance));
+		arc_segments = ceil(fabs(arc.planar_travel) / chord_length);
+	}
+
+	//...unless that makes segments shorter than the arc segment length ($ma) or faster than
+	// the planner and the DDA can take them - those limits round down
+	float arc_segments_for_minimum_distance = floor(arc.length / cm.arc_segment_len);
+	float arc_segments_for_minimum_time = floor(arc.arc_time * MICROSECONDS_PER_MINUTE / MIN_ARC_SEGMENT_USEC);
 
-	arc.arc_segments = floor(min3(arc_segments_for_chordal_accuracy, arc_segments_for_minimum_distance, arc_segments_for_minimum_time));
+	arc.arc_segments = min3(arc_segments, arc_segments_for_minimum_distance, arc_segments_for_minimum_time);
 
 	//...but is at least 1 arc_segment
 	arc.arc_segments = max(arc.arc_segments, 1);
@@ -444,6 +517,10 @@ static stat_t _compute_arc()
 	arc.arc_segment_count = (int32_t)arc.arc_segments;
 	arc.arc_segment_theta = arc.angular_travel / arc.arc_segments;
 	arc.arc_segment_linear_travel = arc.linear_travel / arc.arc_segments;
+	arc.arc_segment_length = arc.length / arc.arc_segments;
+	arc.arc_segment_sin = sin(arc.arc_segment_theta);
+	arc.arc_segment_cos = cos(arc.arc_segment_theta);
+	arc.arc_correction_count = ARC_CORRECTION_SEGMENTS;
     arc.center_0 = arc.position[arc.plane_axis_0] - sin(arc.theta) * arc.radius;
     arc.center_1 = arc.position[arc.plane_axis_1] - cos(arc.theta) * arc.radius;
 
@@ -560,7 +637,7 @@ static stat_t _compute_arc_offsets_from_radius()
 	float h_x2_div_d = (disc > 0) ? -sqrt(disc) / hypotf(x,y) : 0;
 
 	// Invert the sign of h_x2_div_d if circle is counter clockwise (see header notes)
-	if (cm.gm.motion_mode == MOTION_MODE_CCW_ARC)
+	if (arc.gm.motion_mode == MOTION_MODE_CCW_ARC)
 	{
 		h_x2_div_d = -h_x2_div_d;
 	}
@@ -626,85 +703,48 @@ static void _estimate_arc_time ()
  *
  *	Test if arc extends beyond arc plane boundaries set in soft limits.
  *
- *	The arc starting position (P) and target (T) define 2 points that divide the
- *	arc plane into 9 rectangles. The center of the arc is (C). P and T define the
- *	endpoints of two possible arcs; one that is less than or equal to 180 degrees (acute)
- *	and one that is greater than 180 degrees (obtuse), depending on the location of (C).
- *
- *	-------------------------------  plane boundaries in X and Y
- *  |         |         |         |
- *  |    1    |    2    |    3    |
- *  |                   |         |
- *	--------- P -------------------
- *  |                   |         |
- *  |    4    |    5    |    6    |
- *  |         |                   |
- *	------------------- T ---------
- *  |        C|                   |  C shows one of many possible center locations
- *  |    7    |    8    |    9    |
- *  |         |         |         |
- *	-------------------------------
+ *	The target is tested against the soft limit box like any other move. This also tests the
+ *	linear axis of a helix, which moves straight from start to target. The start is where the
+ *	machine is now, so only the bulge of the arc between the two is left to test.
  *
- *	C will fall along a diagonal bisecting 7, 5 and 3, but there is some tolerance in the
- *	circle algorithm that allows C to deviate from the centerline slightly. As the centerline
- *	approaches the line connecting S and T the acute arcs will be "above" S and T in sections
- *	5 or 3, and the obtuse arcs will be "below" in sections 5 or 7. But it's simpler, because
- *	we know that the arc is > 180 degrees (obtuse) if the angular travel value is > pi.
- *
- *	The example below only tests the X axis (0 plane axis), but testing the other axes is similar
- *
- *	  (1) If Cx <= Px and arc is acute; no test is needed
- *
- *	  (2) If Cx <= Px and arc is obtuse; test if the radius is greater than
- *			the distance from Cx to the negative X boundary
- *
- *	  (3) If Px < Cx < Tx and arc is acute; test if the radius is greater than
- *			the distance from Cx to the positive X boundary
- *
- *	  (4) If Px < Cx < Tx and arc is obtuse; test if the radius is greater than
- *			the distance from Cx to the positive X boundary
- *
- *	The arc plane is defined by 0 and 1 depending on G17/G18/G19 plane selected,
- *	corresponding to arc planes XY, XZ, YZ, respectively.
+ *	A point on the arc at angle theta is center + radius * (sin(theta), cos(theta)), so plane
+ *	axis 0 is at its extremes at theta = +/-pi/2 and plane axis 1 at theta = 0 and pi. Away
+ *	from these quadrant boundaries the axes move monotonically, so the arc only reaches past
+ *	its endpoints in an axis if its angular travel crosses the boundary for that axis - and
+ *	then by exactly center +/- radius. Most short arcs cross none and cost no more than a line.
  *
  *	Must be called with all the following set in the arc struct
- *	  -	arc starting position (arc.position)
- *	  - arc ending position (arc.gm.target)
+ *	  -	arc ending position (arc.gm.target)
  *	  - arc center (arc.center_0, arc.center_1)
  *	  - arc.radius (arc.radius)
- *	  - arc angular travel in radians (arc.angular_travel)
- *	  - max and min travel in axis 0 and axis 1 (in cm struct)
+ *	  - arc starting angle and angular travel in radians (arc.theta, arc.angular_travel)
  */
-/* UNUSED
-static stat_t _test_arc_soft_limit_plane_axis(float center, uint8_t plane_axis)
+
+static bool _arc_crosses_angle(float angle)
 {
-	if (center <= arc.position[plane_axis]) {
-		if (arc.angular_travel < M_PI) {							// case (1)
-			return (STAT_OK);
-		}
-		if ((center - arc.radius) < cm.a[plane_axis].travel_min) {	// case (2)
-			return (STAT_SOFT_LIMIT_EXCEEDED);
-		}
-	}
-	if ((center + arc.radius) > cm.a[plane_axis].travel_max) {		// cases (3) and (4)
-		return (STAT_SOFT_LIMIT_EXCEEDED);
-	}
-	return(STAT_OK);
+	float theta_min = min(arc.theta, arc.theta + arc.angular_travel);
+	float theta_max = max(arc.theta, arc.theta + arc.angular_travel);
+
+	// the first turn of angle at or after theta_min
+	angle += 2*M_PI * ceil((theta_min - angle) / (2*M_PI));
+	return (angle <= theta_max);
 }
 
 static stat_t _test_arc_soft_limits()
 {
-	if (cm.soft_limit_enable == true) {
-
-		// Test if target falls outside boundaries. This is a 3 dimensional test
-		// so it also checks the linear axis of the arc (helix axis)
-		ritorno(cm_test_soft_limits(arc.gm.target));
+	ritorno(cm_test_soft_limits(arc.gm.target));
 
-		// test arc extents
-		ritorno(_test_arc_soft_limit_plane_axis(arc.center_0, arc.plane_axis_0));
-		ritorno(_test_arc_soft_limit_plane_axis(arc.center_1, arc.plane_axis_1));
+	if (((arc.center_0 + arc.radius) > cm.soft_limit_max[arc.plane_axis_0]) && (_arc_crosses_angle(M_PI/2))) {
+		return (STAT_SOFT_LIMIT_EXCEEDED);
+	}
+	if (((arc.center_0 - arc.radius) < cm.soft_limit_min[arc.plane_axis_0]) && (_arc_crosses_angle(-M_PI/2))) {
+		return (STAT_SOFT_LIMIT_EXCEEDED);
+	}
+	if (((arc.center_1 + arc.radius) > cm.soft_limit_max[arc.plane_axis_1]) && (_arc_crosses_angle(0))) {
+		return (STAT_SOFT_LIMIT_EXCEEDED);
+	}
+	if (((arc.center_1 - arc.radius) < cm.soft_limit_min[arc.plane_axis_1]) && (_arc_crosses_angle(M_PI))) {
+		return (STAT_SOFT_LIMIT_EXCEEDED);
 	}
 	return(STAT_OK);
 }
-
-*/
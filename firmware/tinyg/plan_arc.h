@@ -54,6 +54,10 @@ typedef struct arArcSingleton {	    // persistent planner and runtime variables
 	int32_t arc_segment_count;		// count of running segments
 	float arc_segment_theta;		// angular motion per segment
 	float arc_segment_linear_travel;// linear motion per segment
+	float arc_segment_length;		// path length per segment (for the segment tangents)
+	float arc_segment_sin;			// sin of arc_segment_theta (for stepping the arc by rotation)
+	float arc_segment_cos;			// cos of arc_segment_theta
+	uint8_t arc_correction_count;	// segments left until the next exact sin/cos resync
 	float center_0;				    // center of circle at plane axis 0 (e.g. X for G17)
 	float center_1;				    // center of circle at plane axis 1 (e.g. Y for G17)
 
@@ -28,11 +28,16 @@
 
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "planner.h"
 #include "kinematics.h"
 #include "stepper.h"
 #include "encoder.h"
 #include "report.h"
+#include "hardware.h"
+#include "spindle.h"
+#include "network.h"
+#include "analog.h"
 #include "util.h"
 /*
 #ifdef __cplusplus
@@ -40,33 +45,84 @@ extern "C"{
 #endif
 */
 // execute routines (NB: These are all called from the LO interrupt)
+static void _finish_run_buffer(mpBuf_t *bf);
 static stat_t _exec_aline_head(void);
 static stat_t _exec_aline_body(void);
 static stat_t _exec_aline_tail(void);
 static stat_t _exec_aline_segment(void);
+static stat_t _prep_segment(float segment_time);
+static void _prep_raster(float segment_time);
+static stat_t _exec_shaper_settle(void);
+static float _get_segment_time(void);
+static stat_t _prep_split_segment(void);
+static float _get_adaptive_feed(void);
+static void _update_thc(void);
+static void _update_pressure_advance(float segment_time);
+static void _update_retract(float segment_time);
+static void _time_hold_latency(float segment_time);
+static void _trace_segment(float segment_time);
+static void _get_arc_point(float travel, float target[]);
+static void _get_next_arc_point(float segment_length, float target[]);
+static float _get_spline_parameter(float length);
+static void _get_spline_point(float u, float target[]);
+static void _get_next_spline_point(float segment_length, float target[]);
 
 #ifndef __JERK_EXEC
 static void _init_forward_diffs(float Vi, float Vt);
+static void _step_forward_diff_velocity(void);
+static void _advance_forward_diffs(void);
 #endif
 
 /*************************************************************************
  * mp_exec_move() - execute runtime functions to prep move for steppers
  *
  *	Dequeues the buffer queue and executes the move continuations.
- *	Manages run buffers and other details
+ *	Manages run buffers and other details. Commands chained to a move that just
+ *	finished are staged before anything else (see mp_queue_command()), except that
+ *	a shaped motion is first let settle unless another motion runs straight on.
+ *	A network slave runs the segments the master sends instead of its own planner.
  */
 
 stat_t mp_exec_move()
 {
 	mpBuf_t *bf;
 
+	if (cs.network_mode == NETWORK_SLAVE) {
+		return (net_exec_segment());
+	}
+	if (mb.dry_run == true) {							// $dry - buffers are retired by mp_dry_run_callback()
+		st_prep_null();
+		return (STAT_NOOP);
+	}
+	if (((mp_shaper_pending() == true) || (mp_retract_pending() == true)) && (mr.move_state == MOVE_OFF)) {
+		bf = mp_get_run_buffer();
+		if ((mr.command != MP_COMMAND_NONE) || (bf == NULL) || (cm.hold_state == FEEDHOLD_HOLD) ||
+			((bf->move_type != MOVE_TYPE_ALINE) && (bf->move_type != MOVE_TYPE_ARC) &&
+			 (bf->move_type != MOVE_TYPE_SPLINE) && (bf->move_type != MOVE_TYPE_JOG))) {
+			return (_exec_shaper_settle());				// a synchronized move starts once it has settled
+		}
+	}
+	if ((mr.command != MP_COMMAND_NONE) && (mr.move_state == MOVE_OFF)) {
+		st_prep_command_chain(mr.command);
+		mr.command = MP_COMMAND_NONE;
+		return (STAT_OK);
+	}
 	if ((bf = mp_get_run_buffer()) == NULL) {			// NULL means nothing's running
 		st_prep_null();
 		return (STAT_NOOP);
 	}
+	mp_swap_live_config();								// settings changed while moving start here
 	// Manage cycle and motion state transitions
-	if (bf->move_type == MOVE_TYPE_ALINE) { 			// cycle auto-start for lines only
-		if (cm.motion_state == MOTION_STOP) cm_set_motion_state(MOTION_RUN);
+	if ((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_ARC) ||
+		(bf->move_type == MOVE_TYPE_SPLINE) || (bf->move_type == MOVE_TYPE_JOG) ||
+		(bf->move_type == MOVE_TYPE_SYNC)) {			// cycle auto-start for moves only
+		if (cm.motion_state == MOTION_STOP) {
+			if (mp_prime_start() == false) {			// hold the first move until the queue is primed
+				st_prep_null();
+				return (STAT_NOOP);
+			}
+			cm_set_motion_state(MOTION_RUN);
+		}
 	}
 	if (bf->bf_func == NULL)
         return(cm_hard_alarm(STAT_INTERNAL_ERROR));     // never supposed to get here
@@ -156,13 +212,19 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 	if (bf->move_state == MOVE_OFF)
         return (STAT_NOOP);
 
+	// Start a feedhold on this segment if the move is underway and the decel fits in mr
+	// (a segment being run in parts finishes first - see _prep_split_segment())
+	if ((cm.hold_state == FEEDHOLD_SYNC) && (mr.move_state == MOVE_RUN) && (mr.split_count == 0)) {
+		mp_plan_hold_runtime(bf);						// leaves SYNC if the main loop must plan it
+	}
+
 	// start a new move by setting up local context (singleton)
 	if (mr.move_state == MOVE_OFF) {
 		if (cm.hold_state == FEEDHOLD_HOLD)
             return (STAT_NOOP);	                        // stops here if holding
 
 		// initialization to process the new incoming bf buffer (Gcode block)
-		memcpy(&mr.gm, &(bf->gm), sizeof(GCodeState_t));// copy in the gcode model state
+		mp_get_buffer_gcode_state(bf, &mr.gm);			// copy in the gcode model state
 		bf->replannable = false;
 														// too short lines have already been removed
 		if (fp_ZERO(bf->length)) {						// ...looks for an actual zero here
@@ -170,7 +232,7 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 			mr.section_state = SECTION_OFF;
 			bf->nx->replannable = false;				// prevent overplanning (Note 2)
 			st_prep_null();								// call this to keep the loader happy
-			if (mp_free_run_buffer()) cm_cycle_end();	// free buffer & end cycle if planner is empty
+			_finish_run_buffer(bf);
 			return (STAT_NOOP);
 		}
 		bf->move_state = MOVE_RUN;
@@ -188,30 +250,81 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 		mr.entry_velocity = bf->entry_velocity;
 		mr.cruise_velocity = bf->cruise_velocity;
 		mr.exit_velocity = bf->exit_velocity;
+		mr.profile_velocity = bf->cruise_vmax;
+		mr.override_limit = (bf->cruise_velocity > EPSILON) ? max(bf->override_vmax / bf->cruise_velocity, 1.0) : 1.0;
+		mr.profile_length = 0;
+		mr.profile_time = 0;
 
 		copy_vector(mr.unit, bf->unit);
-		copy_vector(mr.target, bf->gm.target);			// save the final target of the move
+		copy_vector(mr.target, bf->target);				// save the final target of the move
+		mr.move_type = bf->move_type;
+		if ((mr.gm.raster_pixels != 0) && ((fp_ZERO(mr.raster_length)) || (mr.raster_base != bf->raster_base))) {
+			mr.raster_base = bf->raster_base;			// a line resumed after a feedhold keeps its pixel spacing
+			mr.raster_length = bf->length;
+		}
 
 		// generate the waypoints for position correction at section ends
-		for (uint8_t axis=0; axis<AXES; axis++) {
-			mr.waypoint[SECTION_HEAD][axis] = mr.position[axis] + mr.unit[axis] * mr.head_length;
-			mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
-			mr.waypoint[SECTION_TAIL][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length + mr.tail_length);
+		if (mr.move_type == MOVE_TYPE_ARC) {			// arcs restart from wherever mr is (see _get_arc_point())
+			memcpy(&mr.arc, &mb.arc[bf->arc-1], sizeof(mpArc_t));
+			mr.arc_radius = hypotf(mr.position[mr.arc.plane_axis_0] - mr.arc.center_0,
+								   mr.position[mr.arc.plane_axis_1] - mr.arc.center_1);
+			mr.arc_theta = atan2(mr.position[mr.arc.plane_axis_0] - mr.arc.center_0,
+								 mr.position[mr.arc.plane_axis_1] - mr.arc.center_1);
+			mr.arc_linear_start = mr.position[mr.arc.linear_axis];
+			mr.arc_length = bf->length;
+			mr.arc_travel = 0;
+			mr.arc_correction_count = ARC_CORRECTION_SEGMENTS;
+			_get_arc_point(mr.head_length, mr.waypoint[SECTION_HEAD]);
+			_get_arc_point(mr.head_length + mr.body_length, mr.waypoint[SECTION_BODY]);
+			_get_arc_point(mr.head_length + mr.body_length + mr.tail_length, mr.waypoint[SECTION_TAIL]);
+		} else if (mr.move_type == MOVE_TYPE_SPLINE) {	// splines restart where the last part stopped
+			memcpy(&mr.spline, &mb.spline[bf->spline-1], sizeof(mpSpline_t));
+			mr.spline_index = bf->spline;
+			mr.spline_start = mr.spline.travel;
+			mr.spline_u = _get_spline_parameter(mr.spline_start);
+			mr.arc_length = bf->length;
+			mr.arc_travel = 0;
+			mr.arc_correction_count = ARC_CORRECTION_SEGMENTS;
+			_get_spline_point(_get_spline_parameter(mr.spline_start + mr.head_length), mr.waypoint[SECTION_HEAD]);
+			_get_spline_point(_get_spline_parameter(mr.spline_start + mr.head_length + mr.body_length),
+							  mr.waypoint[SECTION_BODY]);
+			_get_spline_point(_get_spline_parameter(mr.spline_start + mr.head_length + mr.body_length +
+													mr.tail_length), mr.waypoint[SECTION_TAIL]);
+		} else {
+			for (uint8_t axis=0; axis<AXES; axis++) {
+				mr.waypoint[SECTION_HEAD][axis] = mr.position[axis] + mr.unit[axis] * mr.head_length;
+				mr.waypoint[SECTION_BODY][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length);
+				mr.waypoint[SECTION_TAIL][axis] = mr.position[axis] + mr.unit[axis] * (mr.head_length + mr.body_length + mr.tail_length);
+			}
 		}
 	}
 	// NB: from this point on the contents of the bf buffer do not affect execution
 
 	//**** main dispatcher to process segments ***
 	stat_t status = STAT_OK;
+	if (mr.split_count > 0) {							// the rest of a segment stretched by the override
+		ritorno(_prep_split_segment());
+		status = (mr.split_count > 0) ? STAT_EAGAIN : mr.split_status;
+	} else
 	if (mr.section == SECTION_HEAD) { status = _exec_aline_head();} else
 	if (mr.section == SECTION_BODY) { status = _exec_aline_body();} else
 	if (mr.section == SECTION_TAIL) { status = _exec_aline_tail();} else
 	if (mr.move_state == MOVE_SKIP_BLOCK) { status = STAT_OK;}
 	else { return(cm_hard_alarm(STAT_INTERNAL_ERROR));}	// never supposed to get here
 
+	if ((status == STAT_OK) && (mr.split_count > 0)) {	// the move ends once the parts have run
+		mr.split_status = STAT_OK;
+		status = STAT_EAGAIN;
+	}
+
 	// Feedhold processing. Refer to canonical_machine.h for state machine
-	// Catch the feedhold request and start the planning the hold
-	if (cm.hold_state == FEEDHOLD_SYNC) { cm.hold_state = FEEDHOLD_PLAN;}
+	// Catch a feedhold request the runtime could not start above and plan the hold in the main loop
+	if ((cm.hold_state == FEEDHOLD_SYNC) && (mr.split_count == 0)) {
+		cm.hold_state = FEEDHOLD_PLAN;
+#ifdef __PLAN_ISR
+		st_request_plan();								// plan it in PendSV without waiting for the loop
+#endif
+	}
 
 	// Look for the end of the decel to go into HOLD state
 	if ((cm.hold_state == FEEDHOLD_DECEL) && (status == STAT_OK)) {
@@ -230,16 +343,309 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 	if (status == STAT_EAGAIN) {
 		sr_request_status_report(SR_TIMED_REQUEST);		// continue reporting mr buffer
 	} else {
+		if (jp.profile_enable == true) {				// the move (or the part before a hold) is done
+			jp_record_move(mr.gm.linenum, mr.profile_length / mr.profile_velocity, mr.profile_time);
+		}
+		if ((mr.move_type == MOVE_TYPE_SPLINE) && (bf->spline == mr.spline_index)) {
+			mb.spline[bf->spline-1].travel = mr.spline_start + mr.arc_travel;	// where the rest of a split spline starts
+		}
 		mr.move_state = MOVE_OFF;						// reset mr buffer
 		mr.section_state = SECTION_OFF;
 		bf->nx->replannable = false;					// prevent overplanning (Note 2)
 		if (bf->move_state == MOVE_RUN) {
-			if (mp_free_run_buffer()) cm_cycle_end();	// free buffer & end cycle if planner is empty
+			_finish_run_buffer(bf);
 		}
 	}
 	return (status);
 }
 
+/*
+ * _finish_run_buffer() - free a finished move's buffer and pass its command chain to mr
+ *
+ *	The chain is staged by the next mp_exec_move() call. If the planner is empty the
+ *	cycle_end is left to the loader so it follows the chained commands, or to the
+ *	shaper settling so it follows the motion.
+ */
+
+static void _finish_run_buffer(mpBuf_t *bf)
+{
+	mr.command = bf->command;
+	bf->command = MP_COMMAND_NONE;
+	mr.raster_length = 0;
+	if (mp_free_run_buffer() && (mr.command == MP_COMMAND_NONE) && (mp_shaper_pending() == false) &&
+		(mp_retract_pending() == false)) {
+		cm_cycle_end();									// free buffer & end cycle if planner is empty
+	}
+}
+
+/*
+ * _exec_shaper_settle() - run a stationary segment while the shaped output catches up
+ *
+ *	Also runs a firmware retraction that has no move to ride on. Ends the cycle the
+ *	finished move deferred once the output has arrived, unless commands or moves are
+ *	still to run.
+ */
+
+static stat_t _exec_shaper_settle()
+{
+	copy_vector(mr.gm.target, mr.position);
+	mr.segment_velocity = 0;
+	ritorno(_prep_segment(NOM_SEGMENT_TIME));
+	if ((mp_shaper_pending() == false) && (mp_retract_pending() == false) &&
+		(mr.command == MP_COMMAND_NONE) && (mb.r->buffer_state == MP_BUFFER_EMPTY)) {
+		cm_cycle_end();
+	}
+	return (STAT_OK);
+}
+
+/*
+ * mp_exec_network_segment() - prep a segment received from the network master
+ *
+ *	The target is in the master's axis positions. See net_exec_segment().
+ */
+
+stat_t mp_exec_network_segment(const float target[], float segment_time)
+{
+	copy_vector(mr.gm.target, target);
+	mr.move_type = MOVE_TYPE_NULL;
+	mr.segment_velocity = 0;
+	return (_prep_segment(segment_time));
+}
+
+/*************************************************************************
+ * mp_exec_jog() - run a velocity jog (see mp_jog())
+ *
+ *	A jog buffer has no length. Each call ramps every axis towards its target velocity
+ *	in mj and runs one nominal segment of the result. The host can change the targets
+ *	at any time and the change takes effect on the next segment, so a stop starts to
+ *	decelerate within one segment of arriving. The buffer finishes once all axes are
+ *	at zero velocity with zero targets.
+ *
+ *	Each axis ramps on its own with its jerk_max and is held to its velocity_max, both as
+ *	staged for the runtime (see mp_stage_live_config()). Acceleration is chosen so it can come
+ *	down to zero just as the velocity reaches the target (_jog_axis_velocity()).
+ *	A feedhold zeroes the targets so the jog decelerates and ends. Homed axes with
+ *	soft limits enabled stop at the travel limits.
+ */
+
+static float _jog_axis_velocity(uint8_t axis, float dt);
+static float _jog_stop_distance(float v, float a, float jerk);
+
+stat_t mp_exec_jog(mpBuf_t *bf)
+{
+	float dt = NOM_SEGMENT_TIME;
+	float velocity = 0;
+	uint8_t running = false;
+
+	if (bf->move_state == MOVE_NEW) {
+		bf->move_state = MOVE_RUN;
+		bf->replannable = false;
+		mr.move_state = MOVE_RUN;
+		mr.move_type = MOVE_TYPE_JOG;
+		mr.segment_time = dt;
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			mj.velocity[axis] = 0;
+			mj.acceleration[axis] = 0;
+		}
+	}
+	if (cm.hold_state == FEEDHOLD_SYNC) {			// a feedhold stops the jog
+		for (uint8_t axis=0; axis<AXES; axis++) {
+			mj.target_velocity[axis] = 0;
+		}
+		cm.hold_state = FEEDHOLD_DECEL;
+	}
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		float v_0 = mj.velocity[axis];
+		float v_1 = _jog_axis_velocity(axis, dt);
+		mr.gm.target[axis] = mr.position[axis] + (v_0 + v_1) / 2 * dt;
+		velocity += v_1 * v_1;
+		if ((fp_NOT_ZERO(v_1)) || (fp_NOT_ZERO(mj.target_velocity[axis]))) {
+			running = true;
+		}
+	}
+	mr.segment_velocity = sqrt(velocity);
+
+	if (running == false) {							// all axes have come to a stop
+		mr.move_state = MOVE_OFF;
+		mr.section_state = SECTION_OFF;
+		mj.run = false;
+		bf->nx->replannable = false;
+		st_prep_null();								// call this to keep the loader happy
+		_finish_run_buffer(bf);
+		return (STAT_NOOP);
+	}
+	ritorno(_prep_segment(dt));
+	sr_request_status_report(SR_TIMED_REQUEST);
+	return (STAT_EAGAIN);
+}
+
+/*
+ * _jog_axis_velocity() - ramp one axis towards its target velocity for one segment
+ *
+ *	Picks the acceleration for the end of the segment (the jerk is constant within it)
+ *	so that ramping the acceleration back to zero at full jerk lands on the target.
+ *	Returns the velocity at the end of the segment and updates mj.
+ */
+
+static float _jog_axis_velocity(uint8_t axis, float dt)
+{
+	const mpLiveSettings_t *live = &ml.set[ml.active];
+	float jerk = live->jerk_max[axis] * JERK_MULTIPLIER;
+	float v = mj.velocity[axis];
+	float a = mj.acceleration[axis];
+	float target = min(max(mj.target_velocity[axis], -live->velocity_max[axis]), live->velocity_max[axis]);
+
+	// stop short of the soft limits. Stop now if the axis could not stop in time after
+	// one more segment of full jerk towards the limit.
+	if (fp_NOT_ZERO(target)) {
+		float direction = (target > 0) ? 1 : -1;
+		float a_1 = direction * a + jerk * dt;
+		float v_1 = max(direction * v + (direction * a + a_1) / 2 * dt, 0);
+		float stop = direction * mr.position[axis] + (direction * v + v_1) / 2 * dt + _jog_stop_distance(v_1, a_1, jerk);
+		if ((direction > 0) && (stop >= cm.soft_limit_max[axis])) {
+			target = 0;
+		}
+		if ((direction < 0) && (-stop <= cm.soft_limit_min[axis])) {
+			target = 0;
+		}
+		mj.target_velocity[axis] = target;
+	}
+
+	// the end acceleration x satisfies v + (a+x)/2*dt + x*|x|/(2*jerk) = target
+	float remaining = target - v - a * dt / 2;
+	float x = remaining / dt;
+	float max_change = jerk * dt;
+	if ((fabs(x - a) > max_change) || (fabs(x) > max_change)) {
+		x = copysign(jerk * (sqrt(dt * dt / 4 + 2 * fabs(remaining) / jerk) - dt / 2), remaining);
+		x = min(max(x, a - max_change), a + max_change);
+	}
+	float v_new = v + (a + x) / 2 * dt;
+	if (((v_new - target) * (v - target) <= 0) && (fabs(a) <= max_change)) {
+		v_new = target;								// landed on (or crossed) the target
+		x = 0;
+	}
+	mj.velocity[axis] = v_new;
+	mj.acceleration[axis] = x;
+	return (v_new);
+}
+
+/*
+ * _jog_stop_distance() - distance to stop at full jerk from velocity v (>= 0)
+ *
+ *	a is the acceleration in the direction of v. If it is still accelerating it takes
+ *	a/jerk to bring it back to zero before braking from the velocity reached by then.
+ */
+
+static float _jog_stop_distance(float v, float a, float jerk)
+{
+	float distance = 0;
+
+	if (a > 0) {
+		float t_a = a / jerk;
+		distance = (v + a * t_a / 3) * t_a;
+		v += a * t_a / 2;
+	}
+	return (distance + v * sqrt(v / jerk));
+}
+
+/*************************************************************************
+ * mp_exec_sync() - run a spindle synchronized move (see mp_spindle_sync())
+ *
+ *	The move isn't planned in time. Each nominal segment moves the line on by the
+ *	spindle's turns in the segment times the pitch (see cm_get_spindle_turns()), so the
+ *	feed follows the spindle through its ramps and any load on it. The move waits at
+ *	its start for the spindle to pass its index, so repeated passes of a thread line up,
+ *	and starts from the fraction of a turn it is past it. The velocity steps at the start
+ *	and end of the move, as it does when a lathe's half nut is engaged, so keep the
+ *	spindle speed and pitch in reach of the axes' jerk.
+ *
+ *	A rigid tap (G33.1) reverses the spindle at the bottom and follows it back out to
+ *	the start, then restores the spindle direction. It overshoots the bottom by as much
+ *	as the spindle takes to reverse.
+ *
+ *	The overrides don't apply, and a feedhold waits until the move ends - stopping the
+ *	axes and not the spindle would break the thread or the tap.
+ */
+
+stat_t mp_exec_sync(mpBuf_t *bf)
+{
+	float dt = NOM_SEGMENT_TIME;
+	float angle;
+
+	if (bf->move_state == MOVE_NEW) {
+		if (cm.hold_state == FEEDHOLD_HOLD)
+			return (STAT_NOOP);						// stops here if holding
+		mp_get_buffer_gcode_state(bf, &mr.gm);
+		bf->move_state = MOVE_RUN;
+		bf->replannable = false;
+		mr.move_state = MOVE_RUN;
+		mr.move_type = MOVE_TYPE_SYNC;
+		mr.segment_time = dt;
+		mr.profile_velocity = 0;
+		copy_vector(mr.unit, bf->unit);
+		copy_vector(mr.target, bf->target);
+		copy_vector(mr.waypoint[SECTION_HEAD], mr.position);	// the start of the line
+		mr.arc_length = bf->length;
+		mr.arc_travel = 0;
+		mr.sync_pitch = bf->feed_rate;
+		mr.sync_tap = bf->move_code;
+		mr.sync_spindle_mode = mr.gm.spindle_mode;
+		mr.sync_state = SYNC_WAIT;
+		cm_get_spindle_turns(0, &angle);			// start counting from here
+	}
+	float sign = (mr.sync_spindle_mode == SPINDLE_CCW) ? -1 : 1;
+	float turns = cm_get_spindle_turns(dt, &angle) * sign;
+	float travel = mr.arc_travel;
+	uint8_t done = false;
+
+	if (mr.sync_state == SYNC_WAIT) {
+		float before = (sign > 0) ? (angle - turns) : (1 - angle - turns);
+		if (before < 0) {							// passed the index in this segment
+			mr.sync_state = SYNC_RUN;
+			travel = ((sign > 0) ? angle : (1 - angle)) * mr.sync_pitch;
+		}
+	} else {
+		travel = max(travel + turns * mr.sync_pitch, 0);
+	}
+	if ((mr.sync_state == SYNC_RUN) && (travel >= mr.arc_length)) {
+		if (mr.sync_tap == false) {
+			travel = mr.arc_length;					// a thread ends on the target
+			done = true;
+		} else {
+			mr.sync_state = SYNC_RETRACT;			// reverse at the bottom of the tap
+			cm_set_spindle_direction((mr.sync_spindle_mode == SPINDLE_CW) ? SPINDLE_CCW : SPINDLE_CW);
+		}
+	}
+	if ((mr.sync_state == SYNC_RETRACT) && (travel <= 0)) {
+		cm_set_spindle_direction(mr.sync_spindle_mode);	// back at the start
+		done = true;
+	}
+	mr.segment_velocity = fabs(travel - mr.arc_travel) / dt;
+	mr.arc_travel = travel;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		mr.gm.target[axis] = mr.waypoint[SECTION_HEAD][axis] + mr.unit[axis] * travel;
+	}
+	if ((done == true) && (mr.sync_tap == false)) {
+		copy_vector(mr.gm.target, mr.target);
+	}
+	ritorno(_prep_segment(dt));
+
+	if (done == false) {
+		sr_request_status_report(SR_TIMED_REQUEST);
+		return (STAT_EAGAIN);
+	}
+	mr.move_state = MOVE_OFF;
+	mr.section_state = SECTION_OFF;
+	bf->nx->replannable = false;
+	if (cm.hold_state == FEEDHOLD_SYNC) {			// a feedhold asked for during the move
+		cm.hold_state = FEEDHOLD_HOLD;
+		cm_set_motion_state(MOTION_HOLD);
+		sr_request_status_report(SR_IMMEDIATE_REQUEST);
+	}
+	_finish_run_buffer(bf);
+	return (STAT_OK);
+}
+
 /* Forward difference math explained:
  *
  *	We are using a quintic (fifth-degree) Bezier polynomial for the velocity curve.
@@ -340,9 +746,22 @@ stat_t mp_exec_aline(mpBuf_t *bf)
  *		F_1 = 120Ah^5
  *
  *  Note that with our current control points, D and E are actually 0.
+ *
+ *	__FIXED_FORWARD_DIFFS runs the per-segment additions in Q32.32 fixed point (int64_t) instead
+ *	of float. On the xmega each float add is a soft-float library call in the LO interrupt; the
+ *	int64 adds are a few dozen cycles and are exact, so no Kahan compensation is needed. The
+ *	initial differences are still computed in float once per section and converted with _FD().
+ *	The velocity accumulator is kept in fixed point and converted back to float for the segment.
+ *	Velocities must stay below 2^23 mm/min for the conversion, which is far above any machine.
  */
 #ifndef __JERK_EXEC
 
+#ifdef __FIXED_FORWARD_DIFFS
+#define _FD(f) ((fdiff_t)((f) * FD_ONE))		// float to Q32.32
+#else
+#define _FD(f) (f)
+#endif
+
 static void _init_forward_diffs(float Vi, float Vt)
 {
 	float A =  -6.0*Vi +  6.0*Vt;
@@ -361,19 +780,12 @@ static void _init_forward_diffs(float Vi, float Vt)
 	float Bh_4 = B * h * h * h * h;
 	float Ch_3 = C * h * h * h;
 
-	mr.forward_diff_5 = (121.0/16.0)*Ah_5 + 5.0*Bh_4 + (13.0/4.0)*Ch_3;
-	mr.forward_diff_4 = (165.0/2.0)*Ah_5 + 29.0*Bh_4 + 9.0*Ch_3;
-	mr.forward_diff_3 = 255.0*Ah_5 + 48.0*Bh_4 + 6.0*Ch_3;
-	mr.forward_diff_2 = 300.0*Ah_5 + 24.0*Bh_4;
-	mr.forward_diff_1 = 120.0*Ah_5;
-
-#ifdef __KAHAN
-	mr.forward_diff_5_c = 0;
-	mr.forward_diff_4_c = 0;
-	mr.forward_diff_3_c = 0;
-	mr.forward_diff_2_c = 0;
-	mr.forward_diff_1_c = 0;
-#endif
+	mr.forward_diff_5 = _FD((121.0/16.0)*Ah_5 + 5.0*Bh_4 + (13.0/4.0)*Ch_3);
+	mr.forward_diff_4 = _FD((165.0/2.0)*Ah_5 + 29.0*Bh_4 + 9.0*Ch_3);
+	mr.forward_diff_3 = _FD(255.0*Ah_5 + 48.0*Bh_4 + 6.0*Ch_3);
+	mr.forward_diff_2 = _FD(300.0*Ah_5 + 24.0*Bh_4);
+	mr.forward_diff_1 = _FD(120.0*Ah_5);
+
 
 	// Calculate the initial velocity by calculating V(h/2)
 	float half_h = h/2.0;
@@ -381,6 +793,31 @@ static void _init_forward_diffs(float Vi, float Vt)
 	float half_Bh_4 = B * half_h * half_h * half_h * half_h;
 	float half_Ah_5 = C * half_h * half_h * half_h * half_h * half_h;
 	mr.segment_velocity = half_Ah_5 + half_Bh_4 + half_Ch_3 + Vi;
+#ifdef __FIXED_FORWARD_DIFFS
+	mr.forward_diff_velocity = _FD(mr.segment_velocity);
+#endif
+}
+
+/*
+ * _step_forward_diff_velocity() - advance the segment velocity by one forward difference
+ * _advance_forward_diffs() 	 - advance the higher order differences for the next segment
+ */
+static void _step_forward_diff_velocity()
+{
+#if defined(__FIXED_FORWARD_DIFFS)
+	mr.forward_diff_velocity += mr.forward_diff_5;
+	mr.segment_velocity = (float)((int32_t)(mr.forward_diff_velocity >> 24)) * (1.0/256);	// Q8 is plenty
+#else
+	mr.segment_velocity += mr.forward_diff_5;
+#endif
+}
+
+static void _advance_forward_diffs()
+{
+	mr.forward_diff_5 += mr.forward_diff_4;
+	mr.forward_diff_4 += mr.forward_diff_3;
+	mr.forward_diff_3 += mr.forward_diff_2;
+	mr.forward_diff_2 += mr.forward_diff_1;
 }
 #endif
 
@@ -398,7 +835,7 @@ static stat_t _exec_aline_head()
 		}
 		mr.midpoint_velocity = (mr.entry_velocity + mr.cruise_velocity) / 2;
 		mr.gm.move_time = mr.head_length / mr.midpoint_velocity;	// time for entire accel region
-		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * NOM_SEGMENT_USEC)); // # of segments in *each half*
+		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * cm_get_segment_usec(mr.gm.preset))); // # of segments in *each half*
 		mr.segment_time = mr.gm.move_time / (2 * mr.segments);
 		mr.accel_time = 2 * sqrt((mr.cruise_velocity - mr.entry_velocity) / mr.jerk);
 		mr.midpoint_acceleration = 2 * (mr.cruise_velocity - mr.entry_velocity) / mr.accel_time;
@@ -442,7 +879,7 @@ static stat_t _exec_aline_head()
 			return(_exec_aline_body());								// skip ahead to the body generator
 		}
 		mr.gm.move_time = 2*mr.head_length / (mr.entry_velocity + mr.cruise_velocity);// time for entire accel region
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);// # of segments for the section
+		mr.segments = ceil(uSec(mr.gm.move_time) / cm_get_segment_usec(mr.gm.preset));// # of segments for the section
 		mr.segment_time = mr.gm.move_time / mr.segments;
 		_init_forward_diffs(mr.entry_velocity, mr.cruise_velocity);
 		mr.segment_count = (uint32_t)mr.segments;
@@ -463,14 +900,7 @@ static stat_t _exec_aline_head()
 		return(STAT_EAGAIN);
 	}
 	if (mr.section_state == SECTION_2nd_HALF) {						// SECOND HALF (convex part of accel curve)
-#ifndef __KAHAN
-		mr.segment_velocity += mr.forward_diff_5;
-#else	// Use Kahan summation algorithm to mitigate floating-point errors for the above
-		float y = mr.forward_diff_5 - mr.forward_diff_5_c;
-		float v = mr.segment_velocity + y;
-		mr.forward_diff_5_c = (v - mr.segment_velocity) - y;
-		mr.segment_velocity = v;
-#endif
+		_step_forward_diff_velocity();
 
 		if (_exec_aline_segment() == STAT_OK) { 					// set up for body
 			if ((fp_ZERO(mr.body_length)) && (fp_ZERO(mr.tail_length)))
@@ -478,36 +908,7 @@ static stat_t _exec_aline_head()
 			mr.section = SECTION_BODY;
 			mr.section_state = SECTION_NEW;
 		} else {
-#ifndef __KAHAN
-			mr.forward_diff_5 += mr.forward_diff_4;
-			mr.forward_diff_4 += mr.forward_diff_3;
-			mr.forward_diff_3 += mr.forward_diff_2;
-			mr.forward_diff_2 += mr.forward_diff_1;
-#else
-			//mr.forward_diff_5 += mr.forward_diff_4;
-			y = mr.forward_diff_4 - mr.forward_diff_4_c;
-			v = mr.forward_diff_5 + y;
-			mr.forward_diff_4_c = (v - mr.forward_diff_5) - y;
-			mr.forward_diff_5 = v;
-
-			//mr.forward_diff_4 += mr.forward_diff_3;
-			y = mr.forward_diff_3 - mr.forward_diff_3_c;
-			v = mr.forward_diff_4 + y;
-			mr.forward_diff_3_c = (v - mr.forward_diff_4) - y;
-			mr.forward_diff_4 = v;
-
-			//mr.forward_diff_3 += mr.forward_diff_2;
-			y = mr.forward_diff_2 - mr.forward_diff_2_c;
-			v = mr.forward_diff_3 + y;
-			mr.forward_diff_2_c = (v - mr.forward_diff_3) - y;
-			mr.forward_diff_3 = v;
-
-			//mr.forward_diff_2 += mr.forward_diff_1;
-			y = mr.forward_diff_1 - mr.forward_diff_1_c;
-			v = mr.forward_diff_2 + y;
-			mr.forward_diff_1_c = (v - mr.forward_diff_2) - y;
-			mr.forward_diff_2 = v;
-#endif
+			_advance_forward_diffs();
 		}
 	}
 	return(STAT_EAGAIN);
@@ -518,7 +919,13 @@ static stat_t _exec_aline_head()
  * _exec_aline_body()
  *
  *	The body is broken into little segments even though it is a straight line so that
- *	feedholds can happen in the middle of a line with a minimum of latency
+ *	feedholds can happen in the middle of a line with a minimum of latency. Velocity is
+ *	constant here so nothing is lost by running longer segments than the head and tail
+ *	(BODY_SEGMENT_USEC), which halves the exec and prep load during cruise. Arcs keep
+ *	the nominal segment time (NOM_SEGMENT_USEC, or the G187 preset's - see
+ *	cm_get_segment_usec()) so the chord of each runtime segment stays short, and so do lines
+ *	while the G29 height map is applied so Z follows the surface closely, or while the
+ *	torch height control or G96 constant surface speed act on each segment.
  */
 static stat_t _exec_aline_body()
 {
@@ -528,7 +935,10 @@ static stat_t _exec_aline_body()
 			return(_exec_aline_tail());						// skip ahead to tail periods
 		}
 		mr.gm.move_time = mr.body_length / mr.cruise_velocity;
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);
+		mr.segments = ceil(uSec(mr.gm.move_time) /
+			(((mr.move_type == MOVE_TYPE_ARC) || (mr.move_type == MOVE_TYPE_SPLINE) ||
+			  (cm.grid_compensation == true) || (cm.thc_input != 0) || (cm_get_spindle_css() == true)) ?
+			 cm_get_segment_usec(mr.gm.preset) : BODY_SEGMENT_USEC));
 		mr.segment_time = mr.gm.move_time / mr.segments;
 		mr.segment_velocity = mr.cruise_velocity;
 		mr.segment_count = (uint32_t)mr.segments;
@@ -561,7 +971,7 @@ static stat_t _exec_aline_tail()
             return(STAT_OK);			                            // end the move
 		mr.midpoint_velocity = (mr.cruise_velocity + mr.exit_velocity) / 2;
 		mr.gm.move_time = mr.tail_length / mr.midpoint_velocity;
-		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * NOM_SEGMENT_USEC));// # of segments in *each half*
+		mr.segments = ceil(uSec(mr.gm.move_time) / (2 * cm_get_segment_usec(mr.gm.preset)));// # of segments in *each half*
 		mr.segment_time = mr.gm.move_time / (2 * mr.segments);		// time to advance for each segment
 		mr.accel_time = 2 * sqrt((mr.cruise_velocity - mr.exit_velocity) / mr.jerk);
 		mr.midpoint_acceleration = 2 * (mr.cruise_velocity - mr.exit_velocity) / mr.accel_time;
@@ -599,7 +1009,7 @@ static stat_t _exec_aline_tail()
 		if (fp_ZERO(mr.tail_length))
             return(STAT_OK);                                        // end the move
 		mr.gm.move_time = 2*mr.tail_length / (mr.cruise_velocity + mr.exit_velocity); // len/avg. velocity
-		mr.segments = ceil(uSec(mr.gm.move_time) / NOM_SEGMENT_USEC);// # of segments for the section
+		mr.segments = ceil(uSec(mr.gm.move_time) / cm_get_segment_usec(mr.gm.preset));// # of segments for the section
 		mr.segment_time = mr.gm.move_time / mr.segments;			// time to advance for each segment
 		_init_forward_diffs(mr.cruise_velocity, mr.exit_velocity);
 		mr.segment_count = (uint32_t)mr.segments;
@@ -621,61 +1031,498 @@ static stat_t _exec_aline_tail()
 		return(STAT_EAGAIN);
 	}
 	if (mr.section_state == SECTION_2nd_HALF) {						// SECOND HALF - concave part (period 5)
-#ifndef __KAHAN
-		mr.segment_velocity += mr.forward_diff_5;
-#else	// Use Kahan summation algorithm to mitigate floating-point errors for the above
-		float y = mr.forward_diff_5 - mr.forward_diff_5_c;
-		float v = mr.segment_velocity + y;
-		mr.forward_diff_5_c = (v - mr.segment_velocity) - y;
-		mr.segment_velocity = v;
-#endif
+		_step_forward_diff_velocity();
 
 		if (_exec_aline_segment() == STAT_OK) { 					// set up for body
 			return STAT_OK;
 		} else {
-#ifndef __KAHAN
-			mr.forward_diff_5 += mr.forward_diff_4;
-			mr.forward_diff_4 += mr.forward_diff_3;
-			mr.forward_diff_3 += mr.forward_diff_2;
-			mr.forward_diff_2 += mr.forward_diff_1;
-#else
-			//mr.forward_diff_5 += mr.forward_diff_4;
-			y = mr.forward_diff_4 - mr.forward_diff_4_c;
-			v = mr.forward_diff_5 + y;
-			mr.forward_diff_4_c = (v - mr.forward_diff_5) - y;
-			mr.forward_diff_5 = v;
-
-			//mr.forward_diff_4 += mr.forward_diff_3;
-			y = mr.forward_diff_3 - mr.forward_diff_3_c;
-			v = mr.forward_diff_4 + y;
-			mr.forward_diff_3_c = (v - mr.forward_diff_4) - y;
-			mr.forward_diff_4 = v;
-
-			//mr.forward_diff_3 += mr.forward_diff_2;
-			y = mr.forward_diff_2 - mr.forward_diff_2_c;
-			v = mr.forward_diff_3 + y;
-			mr.forward_diff_2_c = (v - mr.forward_diff_3) - y;
-			mr.forward_diff_3 = v;
-
-			//mr.forward_diff_2 += mr.forward_diff_1;
-			y = mr.forward_diff_1 - mr.forward_diff_1_c;
-			v = mr.forward_diff_2 + y;
-			mr.forward_diff_1_c = (v - mr.forward_diff_2) - y;
-			mr.forward_diff_2 = v;
-#endif
+			_advance_forward_diffs();
 		}
 	}
 	return(STAT_EAGAIN);									// should never get here
 }
 #endif // __JERK_EXEC
 
+/*********************************************************************************************
+ * mp_feed_rate_override() - set the runtime feed override (M50, M50.1)
+ * mp_traverse_override()  - set the runtime traverse override (M50.2, M50.3)
+ * _get_segment_time()	   - segment time for the stepper with the override applied
+ * _prep_split_segment()   - prep the next part of a segment stretched past MAX_SEGMENT_TIME
+ *
+ *	Overrides are applied to the move that is running, not to the moves in the planner queue.
+ *	The runtime plays the planned profile back faster or slower by dividing each segment time
+ *	by the override factor. Segment lengths, segment counts and waypoints are the ones that were
+ *	planned, so the moves end where they were going to and no replanning is needed. Velocity
+ *	scales with the factor (acceleration with its square), so the queue never has to be flushed.
+ *
+ *	A change of factor is ramped over FEED_OVERRIDE_RAMP_SEGMENTS with a smoothstep so the
+ *	velocity change is jerk-limited rather than a step.
+ *
+ *	A factor above 1.0 runs the planned profile faster than the machine limits it was planned
+ *	to, so it only applies in the body of a move (constant velocity - no acceleration or jerk
+ *	to scale) and only up to the move's override_vmax, which keeps every axis within its
+ *	feedrate_max or velocity_max (see _set_override_vmax()). The head and tail run at 1.0 at
+ *	most, and the factor ramps back down over the last FEED_OVERRIDE_RAMP_SEGMENTS of the body
+ *	so the tail and the next move start at the planned velocity. Traverses are planned at the
+ *	velocity limits, so the traverse override takes them no faster than those.
+ *
+ *	A factor below 1.0 stretches the segments, down to FEED_OVERRIDE_MIN. A segment longer than
+ *	MAX_SEGMENT_TIME (which sets the stepper's DDA_SUBSTEPS) is run as equal parts along its
+ *	chord before the next segment is computed. A feedhold decelerates along the planned
+ *	profile, which is scaled by whatever factor is in effect. The underrun backoff ($urb)
+ *	scales the override and is ramped the same way. The adaptive feed (see
+ *	_get_adaptive_feed()) scales the segment time on top of the override.
+ *
+ *	The setters run in the main loop and the exec reads the values from the LO interrupt, so
+ *	on the xmega the float writes are made with interrupts off.
+ */
+static stat_t _set_override(float *override, uint8_t flag, float parameter)
+{
+	if (flag && (parameter < FEED_OVERRIDE_MIN)) return (STAT_INPUT_LESS_THAN_MIN_VALUE);
+	if (flag && (parameter > FEED_OVERRIDE_MAX)) return (STAT_INPUT_EXCEEDS_MAX_VALUE);
+#ifdef __AVR
+	cli();
+#endif
+	*override = (flag ? parameter : 1.0);
+#ifdef __AVR
+	sei();
+#endif
+	return (STAT_OK);
+}
+
+stat_t mp_feed_rate_override(uint8_t flag, float parameter)
+{
+	return (_set_override(&mr.feed_override, flag, parameter));
+}
+
+stat_t mp_traverse_override(uint8_t flag, float parameter)
+{
+	return (_set_override(&mr.traverse_override, flag, parameter));
+}
+
+static float _get_segment_time()
+{
+	float target = (mr.gm.motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ? mr.traverse_override : mr.feed_override;
+	target *= st_get_underrun_backoff();					// 1.0 unless exec is falling behind (see stepper.h)
+	if (target > 1.0) {										// only a long enough body runs faster than planned
+		float limit = ((mr.section == SECTION_BODY) && (mr.segment_count > FEED_OVERRIDE_RAMP_SEGMENTS)) ?
+					  mr.override_limit : 1.0;
+		target = min(target, limit);
+	}
+
+	if (fp_NE(target, mr.override_target)) {				// start a new ramp from wherever we are
+		mr.override_start = mr.override_factor;
+		mr.override_target = target;
+		mr.override_ramp_count = FEED_OVERRIDE_RAMP_SEGMENTS;
+	}
+	if (mr.override_ramp_count > 0) {
+		float u = 1 - (float)(--mr.override_ramp_count) / FEED_OVERRIDE_RAMP_SEGMENTS;
+		mr.override_factor = mr.override_start + (mr.override_target - mr.override_start) * u*u*(3 - 2*u);
+	}
+	float factor = mr.override_factor * _get_adaptive_feed();
+	if (fp_EQ(factor, 1.0)) return (mr.segment_time);
+	return (mr.segment_time / factor);
+}
+
+static stat_t _prep_split_segment()
+{
+	float u = 1 - (float)(--mr.split_count) / mr.split_parts;
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		mr.gm.target[axis] = mr.split_start[axis] + (mr.split_end[axis] - mr.split_start[axis]) * u;
+	}
+	stat_t status = _prep_segment(mr.split_time);
+	if (mr.split_count == 0) {
+		mr.split_parts = 0;
+	}
+	return (status);
+}
+
+/*********************************************************************************************
+ * _get_adaptive_feed() - feed factor that keeps the spindle load in its band
+ *
+ *	With an analog input set for the spindle load ($lfi) feeds slow down where the cut is heavy
+ *	and speed up where it is light. Outside the band ($lfl..$lfh) the factor heads for the one
+ *	that would bring the load to the middle of the band, taking the load to follow the feed,
+ *	limited to $lfn..$lfx. Inside the band it holds. The factor moves at a rate that closes the
+ *	gap over ADAPTIVE_FEED_RAMP_SEGMENTS, and the rate itself changes by at most
+ *	ADAPTIVE_FEED_RATE_STEP a segment, so the velocity change is jerk-limited.
+ *
+ *	The load is read once a segment in constant time (see analog.h). Traverses run unscaled,
+ *	and the factor is frozen during a feedhold so the hold decelerates along a single profile.
+ */
+static float _get_adaptive_feed()
+{
+	if (cm.adaptive_feed_input == 0) {
+		mr.adaptive_factor = 1.0;
+		mr.adaptive_rate = 0;
+		return (1.0);
+	}
+	if (mr.gm.motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) return (1.0);
+	if (cm.hold_state != FEEDHOLD_OFF) return (mr.adaptive_factor);
+
+	float load = analog_get_value(cm.adaptive_feed_input - 1);
+	float target = mr.adaptive_factor;
+	if ((load < cm.adaptive_load_lo) || (load > cm.adaptive_load_hi)) {
+		if (load > EPSILON) {
+			target *= (cm.adaptive_load_lo + cm.adaptive_load_hi) / (2 * load);
+		} else {
+			target = cm.adaptive_feed_max;					// not cutting
+		}
+	}
+	target = min(max(target, cm.adaptive_feed_min), cm.adaptive_feed_max);
+
+	float rate = (target - mr.adaptive_factor) / ADAPTIVE_FEED_RAMP_SEGMENTS;
+	rate = min(max(rate, -ADAPTIVE_FEED_RATE_MAX), ADAPTIVE_FEED_RATE_MAX);
+	mr.adaptive_rate += min(max(rate - mr.adaptive_rate, -ADAPTIVE_FEED_RATE_STEP), ADAPTIVE_FEED_RATE_STEP);
+	mr.adaptive_factor += mr.adaptive_rate;
+	mr.adaptive_factor = min(max(mr.adaptive_factor, cm.adaptive_feed_min), cm.adaptive_feed_max);
+	return (mr.adaptive_factor);
+}
+
+/*********************************************************************************************
+ * _update_thc() - torch height control: correct Z from the arc voltage once a segment
+ *
+ *	With an analog input set for the arc voltage ($thi) the runtime keeps a Z offset that is
+ *	added to each segment target after the height map and before ik_kinematics(), so a
+ *	correction reaches the steppers with the next segment rather than through the G-code
+ *	stream. The arc voltage follows the torch height, so a voltage over $thv lowers the torch
+ *	and a voltage under it raises the torch, at $thg per volt of error up to $thr. The offset
+ *	is limited to +/- $thl. Body segments are kept short (NOM_SEGMENT_USEC) while it is on.
+ *
+ *	Anti-dive: the voltage rises as the cut slows in corners and at the ends of moves, which
+ *	would drive the torch into the plate. Corrections hold while the segment velocity is
+ *	under $thd of the cruise velocity of the move, and also with no arc voltage, in a
+ *	feedhold, and with the torch off. Traverses and feeds with the torch off (M5) take the
+ *	offset back to 0 at $thr, so each pierce starts at the programmed height.
+ *
+ *	The offset is not part of the model position, as for the height map, and setting the
+ *	position from the model drops it (see mp_set_steps_to_runtime_position()).
+ */
+static void _update_thc()
+{
+	if ((cm.thc_input == 0) && fp_ZERO(mr.thc_offset)) return;
+
+	float correction = -mr.thc_offset;						// not cutting - back to programmed Z
+	if ((cm.thc_input != 0) && (mr.gm.motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE) &&
+		(mr.gm.spindle_mode != SPINDLE_OFF)) {
+		float voltage = analog_get_value(cm.thc_input - 1);
+		if ((cm.hold_state != FEEDHOLD_OFF) || (voltage < EPSILON) ||
+			(mr.segment_velocity < cm.thc_antidive * mr.profile_velocity)) {
+			return;											// anti-dive - hold the offset
+		}
+		correction = cm.thc_gain * (cm.thc_voltage - voltage) * mr.segment_time;
+	}
+	float step = cm.thc_rate * mr.segment_time;				// furthest Z may be corrected this segment
+	mr.thc_offset += min(max(correction, -step), step);
+	mr.thc_offset = min(max(mr.thc_offset, -cm.thc_limit), cm.thc_limit);
+}
+
+/*********************************************************************************************
+ * _update_pressure_advance() - lead the extruder by its velocity once a segment
+ *
+ *	The melt in the nozzle is compressed before it flows, so the flow lags the extruder and
+ *	blobs at the corners where a print slows down. With an extruder axis set ($pax) each
+ *	segment target of the extruder is led by $pak seconds of its velocity in the segment.
+ *	The velocity follows the jerk limited profile, so the lead builds up with the accel and
+ *	comes back off with the decel, and the flow tracks the motion. Only extruding moves with
+ *	other axes moving are led. Retracts and primes (extruder only moves) and traverses are
+ *	not, and what is left of the lead at the junction into one is taken off in a step.
+ *
+ *	The offset is not part of the model position and is dropped when the position is set
+ *	from the model (see mp_set_steps_to_runtime_position()).
+ */
+static void _update_pressure_advance(float segment_time)
+{
+	if (cm.pa_axis == 0) return;
+
+	uint8_t axis = cm.pa_axis - 1;
+	float velocity = (mr.gm.target[axis] - mr.position[axis]) / segment_time;
+	if ((velocity > 0) && (fabs(mr.unit[axis]) < (1 - EPSILON)) &&
+		(mr.gm.motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE)) {
+		mr.pa_offset = cm.pa_advance * velocity / 60;		// velocity is in units per minute
+	} else {
+		mr.pa_offset = 0;
+	}
+}
+
+/*********************************************************************************************
+ * mp_set_retract() - start the extruder towards a firmware retraction offset (from the loader)
+ * mp_retract_pending() - TRUE while the retraction offset is still moving
+ * _update_retract() - move the retraction offset on by one segment
+ *
+ *	G10 and G11 are queued as segment commands (see cm_retract()) that set the offset the
+ *	extruder is heading to. Each segment moves the offset towards it at $rtv, so with $sc=1
+ *	the retract runs on top of the travel move that follows it and costs no planner buffer
+ *	or stop of its own. With nothing moving the retraction runs as stationary segments
+ *	(see _exec_shaper_settle()) and the cycle ends once it is done.
+ *
+ *	The offset is not part of the model position and is dropped when the position is set
+ *	from the model (see mp_set_steps_to_runtime_position()).
+ */
+void mp_set_retract(float offset, float velocity)
+{
+	mr.retract_target = offset;
+	mr.retract_velocity = velocity;
+}
+
+uint8_t mp_retract_pending()
+{
+	return (fp_NE(mr.retract_offset, mr.retract_target));
+}
+
+static void _update_retract(float segment_time)
+{
+	if (mp_retract_pending() == false) return;
+
+	float step = mr.retract_velocity * segment_time;
+	mr.retract_offset += min(max(mr.retract_target - mr.retract_offset, -step), step);
+	if (fabs(mr.retract_target - mr.retract_offset) < EPSILON) {
+		mr.retract_offset = mr.retract_target;
+	}
+}
+
+/*********************************************************************************************
+ * _time_hold_latency() - measure the motion run between a feedhold request and its decel
+ *
+ *	Called for every segment before it is prepped. From the time a feedhold is requested until
+ *	the first decel segment the segment times are accumulated, covering the main loop sync and
+ *	any hold planning. The segments already waiting in the stepper prep ring when the request
+ *	is first seen run ahead of all of these, so their time is counted in too - and is all there
+ *	is when the hold is planned on the first segment after the request. The total is kept for
+ *	readback as _hl (ms) and _hls (segments).
+ */
+static void _time_hold_latency(float segment_time)
+{
+	uint8_t requested = ((cm.hold_state == FEEDHOLD_SYNC) || (cm.hold_state == FEEDHOLD_PLAN) ||
+						 ((cm.hold_state == FEEDHOLD_OFF) && (cm.feedhold_requested == true)));
+	uint8_t first_decel = ((cm.hold_state == FEEDHOLD_DECEL) && (mr.hold_latency_seen == false));
+
+	if ((requested || first_decel) && (mr.hold_latency_run == false)) {
+		uint8_t queued;
+		mr.hold_latency_run = true;
+		mr.hold_latency_accum = st_get_prep_ring_time(&queued) * 60000;	// minutes to ms
+		mr.hold_latency_accum_segments = queued;
+	}
+	if (requested) {
+		mr.hold_latency_accum += segment_time * 60000;
+		mr.hold_latency_accum_segments++;
+	} else if (mr.hold_latency_run == true) {				// this is the first decel segment
+		mr.hold_latency_run = false;
+		mr.hold_latency = mr.hold_latency_accum;
+		mr.hold_latency_segments = mr.hold_latency_accum_segments;
+	}
+	mr.hold_latency_seen = (cm.hold_state == FEEDHOLD_DECEL);
+}
+
+/*********************************************************************************************
+ * _trace_segment() - add the segment just prepped to the motion trace ring
+ * mp_set_tra()		- arm the trace to record every Nth segment (0 disarms) and clear the ring
+ * mp_get_trd()		- dump the trace ring, oldest record first
+ *
+ *	The trace is written from the exec (LO interrupt) and is meant to be read back after the
+ *	move, so tracing costs no serial traffic while the machine runs. The dump prints one line
+ *	per record: {"tr":[time,velocity,x,y,z,fe1..feN]} and returns the record count.
+ *	Tracing is paused while the dump runs.
+ */
+mpTrace_t mp_trace;
+
+static void _trace_segment(float segment_time)
+{
+	mp_trace.time += segment_time * 60000;					// minutes to ms
+	if (--mp_trace.skip != 0) return;
+	mp_trace.skip = mp_trace.divider;
+
+	mpTraceRecord_t *rec = &mp_trace.rec[mp_trace.head];
+	rec->time = (uint16_t)mp_trace.time;
+	rec->velocity = mr.segment_velocity * mr.segment_time / segment_time;	// as played back
+	for (uint8_t i=0; i<MP_TRACE_AXES; i++) {
+		rec->position[i] = mr.position[i];
+	}
+	for (uint8_t i=0; i<MOTORS; i++) {
+		rec->following_error[i] = (int16_t)mr.following_error[i];
+	}
+	if (++mp_trace.head == MP_TRACE_LEN) mp_trace.head = 0;
+	if (mp_trace.count < MP_TRACE_LEN) mp_trace.count++;
+}
+
+stat_t mp_set_tra(nvObj_t *nv)
+{
+	if ((nv->value < 0) || (nv->value > 255)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	mp_trace.divider = 0;									// stop the exec while resetting
+	mp_trace.head = 0;
+	mp_trace.count = 0;
+	mp_trace.time = 0;
+	mp_trace.skip = 1;										// record the first segment
+	mp_trace.divider = (uint8_t)nv->value;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t mp_get_trd(nvObj_t *nv)
+{
+	uint8_t divider = mp_trace.divider;
+	mp_trace.divider = 0;									// pause tracing while reading
+
+	uint8_t i = (mp_trace.head + MP_TRACE_LEN - mp_trace.count) % MP_TRACE_LEN;
+	for (uint8_t n=0; n<mp_trace.count; n++) {
+		mpTraceRecord_t *rec = &mp_trace.rec[i];
+		printf_P(PSTR("{\"tr\":[%u,%0.2f"), rec->time, rec->velocity);
+		for (uint8_t a=0; a<MP_TRACE_AXES; a++) {
+			printf_P(PSTR(",%0.3f"), rec->position[a]);
+		}
+		for (uint8_t m=0; m<MOTORS; m++) {
+			printf_P(PSTR(",%d"), rec->following_error[m]);
+		}
+		printf_P(PSTR("]}\n"));
+		if (++i == MP_TRACE_LEN) i = 0;
+	}
+	nv->value = (float)mp_trace.count;
+	nv->valuetype = TYPE_INTEGER;
+	mp_trace.divider = divider;
+	return (STAT_OK);
+}
+
+/*********************************************************************************************
+ * _get_arc_point() - position on the running arc after travel mm of path
+ *
+ *	The arc is generated from the position mr had when the move was loaded, not from where the
+ *	arc was planned to start. A feedhold can split an arc buffer and restart the remainder from
+ *	the point the hold stopped at - the angular and linear rates per mm of path still apply.
+ *	Axes outside the arc go straight to their target, as they did for segmented arcs.
+ */
+
+static void _get_arc_point(float travel, float target[])
+{
+	float theta = mr.arc_theta + mr.arc.angular_rate * travel;
+
+	memcpy(target, mr.target, sizeof(mr.target));		// not copy_vector() - target is a pointer here
+	target[mr.arc.plane_axis_0] = mr.arc.center_0 + sin(theta) * mr.arc_radius;
+	target[mr.arc.plane_axis_1] = mr.arc.center_1 + cos(theta) * mr.arc_radius;
+	target[mr.arc.linear_axis] = mr.arc_linear_start + mr.arc.linear_rate * travel;
+}
+
+/*
+ * _get_next_arc_point() - step the running arc on from mr.position by segment_length
+ *
+ *	Rotates the radius vector by the segment angle instead of calling sin and cos, which are
+ *	expensive in software float. The segment angle varies with velocity, so its sine and cosine
+ *	come from their Taylor series - it's at most about 0.1 radian for the smallest arcs at the
+ *	centripetal velocity limit, where the terms dropped are below 1e-5. Every
+ *	ARC_CORRECTION_SEGMENTS'th point and the waypoints are computed exactly to remove the drift.
+ */
+
+static void _get_next_arc_point(float segment_length, float target[])
+{
+	float delta = mr.arc.angular_rate * segment_length;
+	float cos_delta = 1 - square(delta)/2;
+	float sin_delta = delta * (1 - square(delta)/6);
+	float r_0 = mr.position[mr.arc.plane_axis_0] - mr.arc.center_0;
+	float r_1 = mr.position[mr.arc.plane_axis_1] - mr.arc.center_1;
+
+	memcpy(target, mr.target, sizeof(mr.target));		// not copy_vector() - target is a pointer here
+	target[mr.arc.plane_axis_0] = mr.arc.center_0 + r_0 * cos_delta + r_1 * sin_delta;
+	target[mr.arc.plane_axis_1] = mr.arc.center_1 + r_1 * cos_delta - r_0 * sin_delta;
+	target[mr.arc.linear_axis] = mr.arc_linear_start + mr.arc.linear_rate * mr.arc_travel;
+}
+
+/*********************************************************************************************
+ * mp_get_spline_speed() - |P'(u)|, the path length per unit of the curve parameter
+ * mp_get_spline_length() - path length of a spline between parameters u_0 and u_1
+ *
+ *	The length is integrated by 3 point Gauss-Legendre quadrature, which is exact for a
+ *	polynomial of degree 5. The speed of a cubic is the root of a degree 4 polynomial, so this
+ *	is very close over the short parameter intervals it is used on. The planner builds the
+ *	spline's path length table with it and the runtime uses the same function to invert the
+ *	table, so the two agree at the table points.
+ */
+
+float mp_get_spline_speed(const mpSpline_t *sp, float u)
+{
+	return (hypotf(sp->coef[0][0] + u * (2*sp->coef[1][0] + u * 3*sp->coef[2][0]),
+				   sp->coef[0][1] + u * (2*sp->coef[1][1] + u * 3*sp->coef[2][1])));
+}
+
+float mp_get_spline_length(const mpSpline_t *sp, float u_0, float u_1)
+{
+	float half = (u_1 - u_0) / 2;
+	float mid = u_0 + half;
+	float node = half * 0.7745967;						// sqrt(3/5)
+
+	return (half * ((5.0/9) * mp_get_spline_speed(sp, mid - node) +
+					(8.0/9) * mp_get_spline_speed(sp, mid) +
+					(5.0/9) * mp_get_spline_speed(sp, mid + node)));
+}
+
+/*
+ * _get_spline_parameter() - curve parameter of the running spline at a path length from its start
+ *
+ *	The starting guess is interpolated from the path length table, then refined by Newton
+ *	steps on s(u) - length, whose derivative is the speed |P'(u)|.
+ */
+
+static float _get_spline_parameter(float length)
+{
+	const float *table = mr.spline.length;
+
+	if (length <= 0) return (0);
+	if (length >= table[SPLINE_LENGTH_SAMPLES-1]) return (1);
+
+	uint8_t k = 0;
+	while (table[k] < length) k++;
+	float s_0 = (k == 0) ? 0 : table[k-1];
+	float u_0 = (float)k / SPLINE_LENGTH_SAMPLES;
+	float u = u_0 + (length - s_0) / ((table[k] - s_0) * SPLINE_LENGTH_SAMPLES);
+
+	for (uint8_t i=0; i < SPLINE_NEWTON_ITERATIONS; i++) {
+		float speed = mp_get_spline_speed(&mr.spline, u);
+		if (speed < EPSILON) break;						// stay with the estimate at a cusp
+		u -= (s_0 + mp_get_spline_length(&mr.spline, u_0, u) - length) / speed;
+	}
+	return (min(max(u, 0), 1));
+}
+
+/*
+ * _get_spline_point() - point on the running spline at parameter u
+ * _get_next_spline_point() - step the running spline on from mr.spline_u by segment_length
+ *
+ *	The polynomial is evaluated in Horner form. The parameter step for a segment is its length
+ *	over the speed at the middle of the step (a midpoint estimate), with the step over the
+ *	speed averaged from the length table as the first guess. Every ARC_CORRECTION_SEGMENTS'th
+ *	point and the waypoints are found from the path length to remove the drift.
+ *	Axes outside the XY plane go straight to their target.
+ */
+
+static void _get_spline_point(float u, float target[])
+{
+	const float (*c)[2] = mr.spline.coef;
+
+	memcpy(target, mr.target, sizeof(mr.target));		// not copy_vector() - target is a pointer here
+	target[AXIS_X] = mr.spline.start[0] + u * (c[0][0] + u * (c[1][0] + u * c[2][0]));
+	target[AXIS_Y] = mr.spline.start[1] + u * (c[0][1] + u * (c[1][1] + u * c[2][1]));
+}
+
+static void _get_next_spline_point(float segment_length, float target[])
+{
+	uint8_t k = min((uint8_t)(mr.spline_u * SPLINE_LENGTH_SAMPLES), SPLINE_LENGTH_SAMPLES-1);
+	float interval = mr.spline.length[k] - ((k == 0) ? 0 : mr.spline.length[k-1]);
+	float du = (interval > EPSILON) ? segment_length / (interval * SPLINE_LENGTH_SAMPLES) : 0;
+	float speed = mp_get_spline_speed(&mr.spline, mr.spline_u + du/2);
+	if (speed > EPSILON) du = segment_length / speed;
+
+	mr.spline_u = min(mr.spline_u + du, 1);
+	_get_spline_point(mr.spline_u, target);
+}
+
 /*********************************************************************************************
  * _exec_aline_segment() - segment runner helper
  *
  * NOTES ON STEP ERROR CORRECTION:
  *
- *	The commanded_steps are the target_steps delayed by one more segment.
- *	This lines them up in time with the encoder readings so a following error can be generated
+ *	The commanded_steps are the target_steps of the line segment the encoders were last read
+ *	at the end of, looked up by the loader's segment count (see encoder.h). This lines them up
+ *	in time with the encoder readings so a following error can be generated
  *
  *	The following_error term is positive if the encoder reading is greater than (ahead of)
  *	the commanded steps, and negative (behind) if the encoder reading is less than the
@@ -692,7 +1539,6 @@ static stat_t _exec_aline_tail()
 static stat_t _exec_aline_segment()
 {
 	uint8_t i;
-	float travel_steps[MOTORS];
 
 	// Set target position for the segment
 	// If the segment ends on a section waypoint synchronize to the head, body or tail end
@@ -702,37 +1548,254 @@ static stat_t _exec_aline_segment()
 	if ((--mr.segment_count == 0) && (mr.section_state == SECTION_2nd_HALF) &&
 		(cm.motion_state == MOTION_RUN) && (cm.cycle_state == CYCLE_MACHINING)) {
 		copy_vector(mr.gm.target, mr.waypoint[mr.section]);
+		mr.arc_travel = mr.head_length;						// path to the waypoint (only used by arcs)
+		if (mr.section != SECTION_HEAD) mr.arc_travel += mr.body_length;
+		if (mr.section == SECTION_TAIL) mr.arc_travel += mr.tail_length;
+		if (mr.move_type == MOVE_TYPE_SPLINE) mr.spline_u = _get_spline_parameter(mr.spline_start + mr.arc_travel);
 	} else {
 		float segment_length = mr.segment_velocity * mr.segment_time;
-		for (i=0; i<AXES; i++) {
-			mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
+		if (mr.move_type == MOVE_TYPE_SPLINE) {
+			mr.arc_travel += segment_length;
+			if (--mr.arc_correction_count == 0) {
+				mr.arc_correction_count = ARC_CORRECTION_SEGMENTS;
+				mr.spline_u = _get_spline_parameter(mr.spline_start + mr.arc_travel);
+				_get_spline_point(mr.spline_u, mr.gm.target);
+			} else {
+				_get_next_spline_point(segment_length, mr.gm.target);
+			}
+		} else if (mr.move_type == MOVE_TYPE_ARC) {
+			mr.arc_travel += segment_length;
+			if (--mr.arc_correction_count == 0) {
+				mr.arc_correction_count = ARC_CORRECTION_SEGMENTS;
+				_get_arc_point(mr.arc_travel, mr.gm.target);
+			} else {
+				_get_next_arc_point(segment_length, mr.gm.target);
+			}
+		} else {
+			for (i=0; i<AXES; i++) {
+				mr.gm.target[i] = mr.position[i] + (mr.unit[i] * segment_length);
+			}
 		}
 	}
 
+	_update_thc();
+	cm_update_spindle_css(mr.gm.target[AXIS_X] - mr.gm.work_offset[AXIS_X]);
+	float segment_time = _get_segment_time();
+	_update_pressure_advance(segment_time);
+	if (segment_time > MAX_SEGMENT_TIME) {					// stretched by the override - run it in parts
+		mr.split_parts = (uint8_t)ceil(segment_time / MAX_SEGMENT_TIME);
+		mr.split_count = mr.split_parts;
+		mr.split_time = segment_time / mr.split_parts;
+		mr.split_status = STAT_EAGAIN;
+		copy_vector(mr.split_start, mr.position);
+		copy_vector(mr.split_end, mr.gm.target);
+		ritorno(_prep_split_segment());
+	} else {
+		ritorno(_prep_segment(segment_time));
+	}
+#ifdef __JERK_EXEC
+	mr.elapsed_accel_time += mr.segment_accel_time;			// this is needed by jerk-based exec (NB: ignored if running the body)
+#endif
+	if (mr.segment_count == 0) return (STAT_OK);			// this section has run all its segments
+	return (STAT_EAGAIN);									// this section still has more segments to run
+}
+
+/*
+ * _prep_raster() - find the pixels of a raster line that the segment runs over
+ *
+ *	Pixels are placed by the distance left to the end of the line, which a feedhold does not
+ *	change. The DDA ticks to each pixel edge are worked out from the segment length and time,
+ *	so the pixels are resynced to the path at the start of every segment.
+ */
+
+static void _prep_raster(float segment_time)
+{
+	float remaining = 0;									// line left at the start of the segment
+	float remaining_end = 0;								// ...and at its end
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		remaining += (mr.target[axis] - mr.position[axis]) * mr.unit[axis];
+		remaining_end += (mr.target[axis] - mr.gm.target[axis]) * mr.unit[axis];
+	}
+	uint8_t pixels = mr.gm.raster_pixels;
+	float pixel_length = mr.raster_length / pixels;
+	float traveled = mr.raster_length - remaining;
+	int16_t pixel = (int16_t)(traveled / pixel_length);
+	if (pixel < 0) pixel = 0;
+	if (pixel >= pixels) pixel = pixels - 1;
+
+	uint8_t left = pixels - 1 - pixel;
+	float seconds_per_mm = 0;
+	float segment_length = remaining - remaining_end;
+	if (segment_length > EPSILON) {
+		seconds_per_mm = segment_time * 60 / segment_length;
+	} else {
+		left = 0;											// stationary - hold the pixel
+	}
+	st_prep_raster(mr.raster_base + pixel, mr.raster_base + pixels, left,
+				   ((pixel + 1) * pixel_length - traveled) * seconds_per_mm, pixel_length * seconds_per_mm);
+}
+
+/*
+ * _prep_segment() - convert the segment target in mr.gm.target to steps and prep the steppers
+ *
+ *	Shared by lines, arcs, velocity jogs and the shaper settling. Advances mr.position
+ *	to the target. The steps follow the shaped target if input shaping is on.
+ *
+ *	The step positions are kept in Q24.8 fixed point (fstep_t). Each segment's target is
+ *	rounded to 1/256 step once and the travel is the exact integer difference from the last
+ *	target, so the travels of a job add up to precisely its final target in steps however
+ *	many segments it takes. Only the travel of the current segment is handed on as float.
+ *	The range is +/- 8.3 million steps per motor - 6.5 m at 1280 steps per mm.
+ */
+
+static stat_t _prep_segment(float segment_time)
+{
+	uint8_t i;
+	float travel_steps[MOTORS];
+	float step_target[MOTORS];
+	float compensated[AXES];
+	float shaped[AXES];
+
 	// Convert target position to steps
 	// Bucket-brigade the old target down the chain before getting the new target from kinematics
 	//
 	// NB: The direct manipulation of steps to compute travel_steps only works for Cartesian kinematics.
 	//	   Other kinematics may require transforming travel distance as opposed to simply subtracting steps.
 
+	uint8_t sample = en_read_encoders(mr.encoder_steps);	// get current encoder positions
+	fstep_t *commanded = mr.step_history[(uint8_t)(sample - 1) & STEP_HISTORY_MASK];
+
 	for (i=0; i<MOTORS; i++) {
-		mr.commanded_steps[i] = mr.position_steps[i];		// previous segment's position, delayed by 1 segment
+		mr.commanded_steps[i] = commanded[i];				// target of the segment the encoders were read at the end of
 		mr.position_steps[i] = mr.target_steps[i];			// previous segment's target becomes position
-		mr.encoder_steps[i] = en_read_encoder(i);			// get current encoder position (time aligns to commanded_steps)
-		mr.following_error[i] = mr.encoder_steps[i] - mr.commanded_steps[i];
+		mr.following_error[i] = mr.encoder_steps[i] - FSTEP_TO_STEPS(mr.commanded_steps[i]);
+		en_check_following_error(i, mr.following_error[i], mr.gm.linenum);
+	}
+	const float *target = cm_grid_compensate(mp_shape_segment(mr.gm.target, segment_time, shaped), compensated);
+	if (fp_NOT_ZERO(mr.thc_offset)) {						// torch height correction goes on top
+		if (target != compensated) memcpy(compensated, target, sizeof(float)*AXES);
+		compensated[AXIS_Z] += mr.thc_offset;
+		target = compensated;
+	}
+	_update_retract(segment_time);
+	if ((cm.pa_axis != 0) && fp_NOT_ZERO(mr.pa_offset + mr.retract_offset)) {	// and the pressure advance and retraction
+		if (target != compensated) memcpy(compensated, target, sizeof(float)*AXES);
+		compensated[cm.pa_axis - 1] += mr.pa_offset + mr.retract_offset;
+		target = compensated;
 	}
-	ik_kinematics(mr.gm.target, mr.target_steps);			// now determine the target steps...
+	ik_kinematics(target, step_target);						// now determine the target steps...
 	for (i=0; i<MOTORS; i++) {								// and compute the distances to be traveled
-		travel_steps[i] = mr.target_steps[i] - mr.position_steps[i];
+		mr.target_steps[i] = STEPS_TO_FSTEP(step_target[i]);
+		travel_steps[i] = FSTEP_TO_STEPS(mr.target_steps[i] - mr.position_steps[i]);
 	}
 
 	// Call the stepper prep function
 
-	ritorno(st_prep_line(travel_steps, mr.following_error, mr.segment_time));
+	_time_hold_latency(segment_time);
+	net_send_segment(target, segment_time);					// network slaves run the same targets
+	ritorno(st_prep_line(travel_steps, mr.following_error, (uint8_t)(mr.step_sample - (sample - 1)), segment_time));
+	if ((mr.gm.outputs_on | mr.gm.outputs_off) != 0) {		// M62, M63 switch with the first segment
+		st_prep_outputs(mr.gm.outputs_on, mr.gm.outputs_off);
+		mr.gm.outputs_on = mr.gm.outputs_off = 0;
+	}
+	fstep_t *history = mr.step_history[++mr.step_sample & STEP_HISTORY_MASK];
+	for (i=0; i<MOTORS; i++) {								// the motors run off the targets by the step offsets
+		history[i] = mr.target_steps[i] + STEPS_TO_FSTEP(st_pre.mot[i].step_offset);
+	}
+	if ((cm_get_laser_mode(PWM_1) | cm_get_laser_mode(PWM_2)) == true) {	// laser power follows the segment velocity
+		float velocity_ratio = 0;								// off for traverses, jogs and settling
+		if ((mr.move_type != MOVE_TYPE_JOG) && (mr.gm.motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE) &&
+			(mr.profile_velocity > 0)) {
+			velocity_ratio = mr.segment_velocity / mr.profile_velocity;
+		}
+		for (uint8_t chan = PWM_1; chan < PWMS; chan++) {
+			if (cm_get_laser_mode(chan) == true) {
+				st_prep_laser(chan, cm_get_laser_pwm(chan, velocity_ratio));
+			}
+		}
+	}
+	st_prep_power(((mr.move_type == MOVE_TYPE_ALINE) && (mr.section != SECTION_BODY)) ?
+				  ST_POWER_BOOST : ST_POWER_NOMINAL);		// boost the current through the ramps
+	if ((mr.move_type == MOVE_TYPE_ALINE) && (mr.gm.raster_pixels != 0) && (mr.raster_length > 0)) {
+		_prep_raster(segment_time);
+	}
 	copy_vector(mr.position, mr.gm.target); 				// update position from target
-#ifdef __JERK_EXEC
-	mr.elapsed_accel_time += mr.segment_accel_time;			// this is needed by jerk-based exec (NB: ignored if running the body)
-#endif
-	if (mr.segment_count == 0) return (STAT_OK);			// this section has run all its segments
-	return (STAT_EAGAIN);									// this section still has more segments to run
+	mp_publish_runtime_snapshot();							// ...and publish it for reporting
+	if (mp_trace.divider != 0) _trace_segment(segment_time);
+	float length = mr.segment_velocity * mr.segment_time;	// path and time for the job profile
+	mr.profile_length += (mr.split_parts > 0) ? length / mr.split_parts : length;
+	mr.profile_time += segment_time;
+	return (STAT_OK);
+}
+
+#ifdef __BENCHMARKS
+/*
+ * mp_bench_exec_segment() - return the usec taken by calls of _exec_aline_segment() ($bench)
+ *
+ *	Runs body segments of an XY line at 1000 mm/min, reversing every segment so the runtime
+ *	stays within a segment of where it started. Only called with the machine idle (see
+ *	test.c). The segments are prepped into the exec's slot of the prep ring and never handed
+ *	to the loader, network slaves and the motion trace are kept out of it, and the runtime
+ *	position, steps and stepper prep state are put back afterwards. Nothing moves.
+ */
+uint32_t mp_bench_exec_segment(uint16_t calls)
+{
+	float position[AXES];
+	stPrepMotor_t mot[MOTORS];
+	float dda_residue = st_pre.dda_residue;
+	float dda_frequency = st_pre.dda_frequency;
+	float profile_length = mr.profile_length;
+	float profile_time = mr.profile_time;
+	uint8_t move_type = mr.move_type;
+	uint8_t section_state = mr.section_state;
+	uint8_t motion_mode = mr.gm.motion_mode;
+	uint8_t raster_pixels = mr.gm.raster_pixels;
+	uint8_t network_mode = cs.network_mode;
+	uint8_t trace = mp_trace.divider;
+
+	copy_vector(position, mr.position);
+	memcpy(mot, st_pre.mot, sizeof(mot));
+	cs.network_mode = NETWORK_STANDALONE;
+	mp_trace.divider = 0;
+
+	mr.move_type = MOVE_TYPE_ALINE;
+	mr.section_state = SECTION_1st_HALF;					// not at a waypoint
+	mr.gm.motion_mode = MOTION_MODE_STRAIGHT_FEED;
+	mr.gm.raster_pixels = 0;
+	mr.segment_count = (uint32_t)calls + 1;
+	mr.segment_velocity = 1000;
+	mr.segment_time = NOM_SEGMENT_TIME;
+	for (uint8_t axis=0; axis<AXES; axis++) { mr.unit[axis] = 0;}
+	mr.unit[AXIS_X] = 0.6;
+	mr.unit[AXIS_Y] = 0.8;
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<calls; i++) {
+		_exec_aline_segment();
+		mr.segment_velocity = -mr.segment_velocity;
+	}
+	uint32_t usec = hw_get_usec() - start;
+
+	copy_vector(mr.position, position);
+	copy_vector(mr.gm.target, position);
+	mp_set_steps_to_runtime_position();						// resyncs the steps, encoders and shaper
+	memcpy(st_pre.mot, mot, sizeof(mot));					// backlash and phase state as it was
+	for (uint8_t i=0; i<STEP_HISTORY_SIZE; i++) {
+		for (uint8_t motor=0; motor<MOTORS; motor++) {
+			mr.step_history[i][motor] += STEPS_TO_FSTEP(st_pre.mot[motor].step_offset);
+		}
+	}
+	st_pre.dda_residue = dda_residue;
+	st_pre.dda_frequency = dda_frequency;
+	mr.profile_length = profile_length;
+	mr.profile_time = profile_time;
+	mr.move_type = move_type;
+	mr.section_state = section_state;
+	mr.gm.motion_mode = motion_mode;
+	mr.gm.raster_pixels = raster_pixels;
+	cs.network_mode = network_mode;
+	mp_trace.divider = trace;
+	mp_zero_segment_velocity();
+	return (usec);
 }
+#endif // __BENCHMARKS
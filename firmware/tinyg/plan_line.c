@@ -34,16 +34,42 @@
 #include "canonical_machine.h"
 #include "planner.h"
 #include "stepper.h"
+#include "spindle.h"
 #include "report.h"
+#include "hardware.h"
 #include "util.h"
+#include "perf.h"
 
 
 //*** aline planner routines, feedhold planning ****************************************************
 //
 static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const float axis_square[]);
+static float _get_move_jerk(const float axis_share[], uint8_t *jerk_axis);
+static float _get_arc_axis_share(float theta_0, float theta_1, float phase);
+static void _get_spline_tangent(const mpSpline_t *sp, float u, float unit[]);
 static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag);
+static void _plan_exact_stop(mpBuf_t *bf);
 static float _get_junction_vmax(const float a_unit[], const float b_unit[]);
 static void _reset_replannable_list(void);
+static stat_t _plan_line(GCodeState_t *gm_in);
+static stat_t _commit_move(mpBuf_t *bf, const float entry_unit[], uint8_t move_type);
+static void _govern_cruise_velocity(mpBuf_t *bf, const GCodeState_t *gm_in);
+static void _limit_step_velocity(mpBuf_t *bf, const float axis_share[]);
+static void _set_cruise_limit(mpBuf_t *bf, const GCodeState_t *gm_in, const float axis_share[]);
+static void _set_override_vmax(mpBuf_t *bf, const GCodeState_t *gm_in, const float axis_share[], float radius);
+static uint8_t _is_holdable(const GCodeState_t *gm_in);
+static uint8_t _merge_line(const GCodeState_t *gm_in);
+static stat_t _blend_corner(const GCodeState_t *gm_in);
+static stat_t _queue_line(GCodeState_t *gm_in);
+static stat_t _aline(GCodeState_t *gm_in);
+static stat_t _aarc(GCodeState_t *gm_in, const mpArc_t *arc_in, float length);
+static stat_t _aspline(GCodeState_t *gm_in, const mpSpline_t *spline_in);
+static void _take_outputs(GCodeState_t *gm_in);
+static stat_t _release_outputs(GCodeState_t *gm_in, stat_t status);
+static uint8_t _is_compensated(const GCodeState_t *gm_in);
+static stat_t _comp_line(const GCodeState_t *gm_in);
+static stat_t _release_comp_lines(const GCodeState_t *gm_next);
+static stat_t _commit_merged_line(void);
 
 
 //**************************************************************************************************
@@ -55,14 +81,103 @@ static void _reset_replannable_list(void);
  * mp_set_runtime_work_offset()		- set offsets in the MR struct
  * mp_get_runtime_work_position() 	- returns current axis position in work coordinates
  *									  that were in effect at move planning time
-*/
+ *
+ * mp_publish_runtime_snapshot()	- publish the runtime position (called by the exec once per segment)
+ * mp_hold_runtime_snapshot()		- take one snapshot for all the getters of a report
+ * mp_release_runtime_snapshot()	- go back to reading the published snapshot
+ *
+ *	The getters do not read mr directly. The LO level exec updates mr.position, the velocity and
+ *	the offsets while the foreground is reading them, so a report could mix axes from two
+ *	segments. Instead the exec publishes a copy at the end of each segment, bracketed by a
+ *	sequence count that is odd while the copy is being written. Readers copy it and go round
+ *	again if the count was odd or has moved on, so nothing needs interrupts off to read it.
+ *	Setters called from the foreground publish with interrupts off as the exec could
+ *	otherwise publish in the middle of their copy.
+ *
+ *	A report holds one snapshot while it runs its getters so all its values are from the
+ *	same segment. Only the foreground reports hold it - the exec does not call the getters.
+ */
 //**************************************************************************************************
 
-void mp_zero_segment_velocity() { mr.segment_velocity = 0;}
-float mp_get_runtime_velocity(void) { return (mr.segment_velocity);}
-float mp_get_runtime_absolute_position(uint8_t axis) { return (mr.position[axis]);}
-void mp_set_runtime_work_offset(float offset[]) { copy_vector(mr.gm.work_offset, offset);}
-float mp_get_runtime_work_position(uint8_t axis) { return (mr.position[axis] - mr.gm.work_offset[axis]);}
+#define _barrier() __asm__ __volatile__ ("" ::: "memory")	// keep the copy between the counts
+
+static mpRuntimeSnapshot_t mp_snap;			// published by the runtime
+static mpRuntimeSnapshot_t mp_view;			// held by a report
+static uint8_t mp_view_held;
+
+static void _publish_snapshot()
+{
+	mp_snap.seq++;							// odd - copy in progress
+	_barrier();
+	copy_vector(mp_snap.position, mr.position);
+	copy_vector(mp_snap.work_offset, mr.gm.work_offset);
+	mp_snap.velocity = mr.segment_velocity * mr.override_factor;
+	_barrier();
+	mp_snap.seq++;							// even - copy is consistent
+}
+
+void mp_publish_runtime_snapshot() { _publish_snapshot();}
+
+void mp_publish_runtime_snapshot_locked()
+{
+#ifdef __AVR
+	cli();
+#endif
+	_publish_snapshot();
+#ifdef __AVR
+	sei();
+#endif
+}
+
+static const mpRuntimeSnapshot_t *_read_snapshot(mpRuntimeSnapshot_t *copy)
+{
+	uint8_t seq;
+
+	if (mp_view_held == true) return (&mp_view);
+	do {
+		seq = mp_snap.seq;
+		_barrier();
+		memcpy(copy, &mp_snap, sizeof(mpRuntimeSnapshot_t));
+		_barrier();
+	} while ((seq & 1) || (seq != mp_snap.seq));
+	return (copy);
+}
+
+void mp_hold_runtime_snapshot() { mp_view_held = false; _read_snapshot(&mp_view); mp_view_held = true;}
+void mp_release_runtime_snapshot() { mp_view_held = false;}
+
+void mp_zero_segment_velocity() { mr.segment_velocity = 0; mp_publish_runtime_snapshot_locked();}
+
+float mp_get_runtime_velocity(void)
+{
+	mpRuntimeSnapshot_t copy;
+	return (_read_snapshot(&copy)->velocity);
+}
+
+float mp_get_runtime_absolute_position(uint8_t axis)
+{
+	mpRuntimeSnapshot_t copy;
+	return (_read_snapshot(&copy)->position[axis]);
+}
+
+void mp_get_runtime_absolute_vector(float position[])
+{
+	mpRuntimeSnapshot_t copy;
+	memcpy(position, _read_snapshot(&copy)->position, sizeof(copy.position));
+}
+
+void mp_set_runtime_work_offset(float offset[])
+{
+	copy_vector(mr.gm.work_offset, offset);
+	mp_publish_runtime_snapshot_locked();
+}
+
+float mp_get_runtime_work_position(uint8_t axis)
+{
+	mpRuntimeSnapshot_t copy;
+	const mpRuntimeSnapshot_t *snap = _read_snapshot(&copy);
+	return (snap->position[axis] - snap->work_offset[axis]);
+}
 
 
 //**************************************************************************************************
@@ -77,13 +192,576 @@ float mp_get_runtime_work_position(uint8_t axis) { return (mr.position[axis] - m
 uint8_t mp_get_runtime_busy()
 {
 	if ((st_runtime_isbusy() == true) || (mr.move_state == MOVE_RUN)) return (true);
+	if (mr.command != MP_COMMAND_NONE) return (true);	// commands of a finished move are still to run
+	if (mm.merge_pending == true) return (true);	// a held line is still to be planned
+	if (mm.comp_count != 0) return (true);			// ...or a line held for cutter compensation
+	if (mp_shaper_pending() == true) return (true);	// the shaped motion is still settling
+	if (mp_retract_pending() == true) return (true);	// a firmware retraction is still running
 	return (false);
 }
 
 
 //**************************************************************************************************
 /*
- * mp_aline() - plan a line with acceleration / deceleration
+ * mp_aline() - queue a line, folding it into the previous line if possible
+ * mp_commit_merged_line() - plan the line held for merging, if there is one
+ * mp_discard_merged_line() - drop the line held for merging (queue flush)
+ * mp_merge_callback() - controller callback to release the held line before the queue runs low
+ * mp_get_line_headroom() - return the most buffers the next straight line can take
+ *
+ *	CAM output often describes a gentle curve or a straight edge as a long run of very short,
+ *	nearly collinear G1 moves. Planned one per buffer, these are clamped by MIN_SEGMENT_TIME and
+ *	burn through the planner queue - leaving only a few mm of lookahead.
+ *
+ *	If the line merge tolerance ($lt) is non-zero, a straight feed is not planned right away but
+ *	held in mm.merge_gm. Following feeds with the same feed rate and modal state are folded into
+ *	the held line for as long as every folded endpoint stays within $lt of the resulting chord.
+ *	The held line is planned when a line arrives that cannot be folded in, when anything else is
+ *	queued (commands, dwells, traverses, arcs), when the planner position is set, or when fewer
+ *	than LINE_MERGE_HOLD_DEPTH buffers are queued ahead of it so the runtime never waits on it.
+ *
+ *	Deviation bound: let S be the start of the held line (mm.position), P its current end and T
+ *	the new target. Points on SP are no further from line ST than P is, so the deviation of all
+ *	previously folded points from ST is at most the previous bound plus dist(P, ST). That sum is
+ *	kept in mm.merge_deviation and compared to $lt.
+ *
+ *	Corner blending: in continuous mode with a path tolerance (G64 P<tol>) lines are held the
+ *	same way. When the next line cannot be merged the corner between them is rounded off by
+ *	_blend_corner() instead of being run through at the junction velocity.
+ *
+ *	Holding is only done in a machining cycle (not in homing, probing or jogging, which sync to
+ *	individual moves), never in exact stop (G61.1) or inverse time (G93) modes, and never for
+ *	raster lines, whose pixels are spread over the line as sent.
+ *
+ *	The next line can take more than one buffer: a pending spindle wait goes ahead of a feed,
+ *	and the held line is planned with it, with BLEND_SEGMENTS_MIN more lines if its corner is
+ *	blended (sharper corners only take more if there is room). mp_get_line_headroom() adds
+ *	these up so the controller can reserve just that for a line move (see gc_block_headroom()).
+ *
+ *	Derived config values marked stale by the setters are rebuilt here before the line is
+ *	planned (see config_update_derived()).
+ *
+ *	Cutter compensation (G41, G42) comes ahead of all this - see _comp_line().
+ *
+ *	Outputs set by M62 and M63 since the last move ride on the next line (see _take_outputs()).
+ *	A line carrying outputs is never folded into the held line, so they switch where it starts.
+*/
+//**************************************************************************************************
+
+stat_t mp_aline(GCodeState_t *gm_in)
+{
+	_take_outputs(gm_in);
+	return (_release_outputs(gm_in, _aline(gm_in)));
+}
+
+static stat_t _aline(GCodeState_t *gm_in)
+{
+	if (cfg.derived_dirty != 0)
+	{
+		config_update_derived();
+	}
+	if (gm_in->motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE)
+	{
+		cm_sync_spindle();						// a feed waits for a spindle speed change to finish
+	}
+	stat_t status;
+	if (_is_compensated(gm_in) == true)
+	{
+		status = _comp_line(gm_in);
+	}
+	else if ((status = _release_comp_lines(NULL)) == STAT_OK)	// an uncompensated line starts from the offset end
+	{
+		mm.comp_chain = false;
+		status = _queue_line(gm_in);
+	}
+	return (status);
+}
+
+/*
+ * _take_outputs()	  - attach the M62, M63 outputs waiting in cm to a move (see cm_sync_output())
+ * _release_outputs() - clear them from the move's state, and from cm if the move was queued
+ *
+ *	Outputs go with the next line, arc or spline that leaves the model position - a block with
+ *	no axis words still queues a zero length line in the modal motion mode. A move that fails to
+ *	queue leaves them waiting for the next one.
+ */
+
+static void _take_outputs(GCodeState_t *gm_in)
+{
+	if ((cm.outputs_on | cm.outputs_off) == 0)
+	{
+		return;
+	}
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		if (fp_NE(gm_in->target[axis], cm.gmx.position[axis]))
+		{
+			gm_in->outputs_on = cm.outputs_on;
+			gm_in->outputs_off = cm.outputs_off;
+			return;
+		}
+	}
+}
+
+static stat_t _release_outputs(GCodeState_t *gm_in, stat_t status)
+{
+	if ((gm_in->outputs_on | gm_in->outputs_off) != 0)
+	{
+		if (status == STAT_OK)
+		{
+			cm.outputs_on = cm.outputs_off = 0;
+		}
+		gm_in->outputs_on = gm_in->outputs_off = 0;
+	}
+	return (status);
+}
+
+static stat_t _queue_line(GCodeState_t *gm_in)
+{
+	stat_t status = STAT_OK;
+
+	if (mm.merge_pending == true)
+	{
+		if (_merge_line(gm_in) == true)
+		{
+			return (STAT_OK);
+		}
+		if ((mm.merge_gm.path_control == PATH_CONTINUOUS) && (fp_NOT_ZERO(mm.merge_gm.path_tolerance)) &&
+			(_is_holdable(gm_in) == true))
+		{
+			status = _blend_corner(gm_in);
+		}
+		else
+		{
+			status = mp_commit_merged_line();
+		}
+		// a held line too short to plan leaves mm.position where it was - gm_in takes it up
+		if (status == STAT_MINIMUM_TIME_MOVE)
+		{
+			status = STAT_OK;
+		}
+	}
+	// gm_in is held or planned whatever became of the held line
+	if (_is_holdable(gm_in) == true)
+	{
+		memcpy(&mm.merge_gm, gm_in, sizeof(GCodeState_t));
+		mm.merge_deviation = 0;
+		mm.merge_pending = true;
+		return (status);
+	}
+	stat_t line_status = _plan_line(gm_in);
+	return ((status == STAT_OK) ? line_status : status);
+}
+
+stat_t mp_commit_merged_line()
+{
+	ritorno(_release_comp_lines(NULL));
+	return (_commit_merged_line());
+}
+
+static stat_t _commit_merged_line()
+{
+	if (mm.merge_pending == false)
+	{
+		return (STAT_OK);
+	}
+	mm.merge_pending = false;
+	return (_plan_line(&mm.merge_gm));
+}
+
+void mp_discard_merged_line()
+{
+	mm.merge_pending = false;
+	mm.comp_count = 0;
+	mm.comp_chain = false;
+}
+
+stat_t mp_merge_callback()
+{
+	if ((mm.comp_count != 0) && (mp_get_planner_buffers_available() == PLANNER_BUFFER_POOL_SIZE) &&
+		(SysTickTimer_getValue() > mm.comp_timeout))
+	{
+		mp_commit_merged_line();				// nothing left to run - give up the corner
+	}
+	if ((mm.merge_pending == true) &&
+		((PLANNER_BUFFER_POOL_SIZE - mp_get_planner_buffers_available()) < LINE_MERGE_HOLD_DEPTH))
+	{
+		_commit_merged_line();
+	}
+	return (STAT_OK);
+}
+
+uint8_t mp_get_line_headroom()
+{
+	uint8_t buffers = 1;						// the line
+	if (mm.merge_pending == true)
+	{
+		buffers = 2;							// the held line goes first
+		if ((mm.merge_gm.path_control == PATH_CONTINUOUS) && (fp_NOT_ZERO(mm.merge_gm.path_tolerance)))
+		{
+			buffers = 1 + BLEND_SEGMENTS_MIN;	// the held line and its corner - the new line is held in turn
+		}
+	}
+	if (mm.comp_count != 0)						// the compensated lines released and a chamfer
+	{
+		uint8_t per_line = 1;
+		if ((mm.comp_gm[0].path_control == PATH_CONTINUOUS) && (fp_NOT_ZERO(mm.comp_gm[0].path_tolerance)))
+		{
+			per_line = 1 + BLEND_SEGMENTS_MIN;
+		}
+		buffers += (mm.comp_count + 1) * per_line;
+	}
+	if (cm_spindle_wait_pending() == true)
+	{
+		buffers++;
+	}
+	return (buffers);
+}
+
+/*
+ * mp_aline_segment() - queue one chord of an arc that is being fed as line segments
+ *
+ *	cm_arc_callback() approximates an arc by chords when the arc table is full. Planned as plain
+ *	lines, every chord junction is a small corner and the transitions into and out of the arc
+ *	are taken as corners against the first and last chords, so the arc hovers below its feed.
+ *	The chord is planned with the arc's true tangent at its start (entry_unit) for the junction,
+ *	and the tangent at its end (exit_unit) is kept in mm.segment_exit for the next move's
+ *	junction. Both the junctions and the cruise velocity are limited by the centripetal
+ *	acceleration the arc radius allows - the same limit mp_aarc() uses.
+*/
+
+stat_t mp_aline_segment(GCodeState_t *gm_in, float radius, const float entry_unit[], const float exit_unit[])
+{
+	mm.segment_radius = radius;
+	copy_vector(mm.segment_entry, entry_unit);
+	copy_vector(mm.segment_exit, exit_unit);
+	stat_t status = mp_aline(gm_in);
+	mm.segment_radius = 0;
+	return (status);
+}
+
+static uint8_t _is_holdable(const GCodeState_t *gm_in)
+{
+	if (((fp_ZERO(cm.line_merge_tolerance)) &&
+		 ((gm_in->path_control != PATH_CONTINUOUS) || (fp_ZERO(gm_in->path_tolerance)))) ||
+		(cm.cycle_state != CYCLE_MACHINING) ||
+		(gm_in->motion_mode != MOTION_MODE_STRAIGHT_FEED) ||
+		(gm_in->feed_rate_mode == INVERSE_TIME_MODE) ||
+		(gm_in->path_control == PATH_EXACT_STOP) ||
+		(gm_in->raster_pixels != 0))
+	{
+		return (false);
+	}
+	return (true);
+}
+
+static uint8_t _merge_line(const GCodeState_t *gm_in)
+{
+	if ((fp_ZERO(cm.line_merge_tolerance)) ||
+		(_is_holdable(gm_in) == false) ||
+		((gm_in->outputs_on | gm_in->outputs_off) != 0) ||
+		(fp_NE(gm_in->feed_rate, mm.merge_gm.feed_rate)) ||
+		(memcmp((uint8_t *)gm_in + GM_MODAL_OFFSET, (uint8_t *)&mm.merge_gm + GM_MODAL_OFFSET, GM_MODAL_SIZE) != 0))
+	{
+		return (false);
+	}
+
+	// distance of the held endpoint P from the chord ST, and where it projects onto it
+	float chord[AXES];
+	float held[AXES];
+	float chord_square = 0;
+	float held_square = 0;
+	float dot = 0;
+
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		chord[axis] = gm_in->target[axis] - mm.position[axis];
+		held[axis] = mm.merge_gm.target[axis] - mm.position[axis];
+		chord_square += square(chord[axis]);
+		held_square += square(held[axis]);
+		dot += chord[axis] * held[axis];
+	}
+	// P must project inside the chord, else the path doubles back
+	if ((dot <= 0) || (dot >= chord_square))
+	{
+		return (false);
+	}
+	float deviation = sqrt(max(0, held_square - square(dot) / chord_square));
+
+	if ((mm.merge_deviation + deviation) > cm.line_merge_tolerance)
+	{
+		return (false);
+	}
+	mm.merge_deviation += deviation;
+	copy_vector(mm.merge_gm.target, gm_in->target);
+	mm.merge_gm.linenum = gm_in->linenum;		// report the line the merged move ends on
+	return (true);
+}
+
+/*
+ * _blend_corner() - plan the held line with its corner to gm_in rounded off
+ *
+ *	The held line SP is shortened to end at A = P - u1*d, and the corner is replaced by the
+ *	quadratic Bezier from A over control point P to C = P + u2*d, where u1 and u2 are the unit
+ *	vectors of SP and of the new line PT. The curve is planned as a short run of lines and
+ *	mm.position is left at C, so the caller holds the new line from there.
+ *
+ *	The curve comes closest to P at its midpoint, at a distance of d*|u2-u1|/4, so d is set
+ *	from the path tolerance as 4*tol/|u2-u1|. It is limited to the length of SP (which may
+ *	already have been trimmed at its start) and to half of PT, which keeps the other half for
+ *	the next corner. The curve is approximated by an even number of lines so that the midpoint
+ *	is a vertex - the chords lie outside the curve, away from P, and never cut the corner
+ *	further than the curve does.
+ *
+ *	Nearly straight junctions and reversals are not blended. A sharp corner gets more lines if
+ *	the planner queue has room for them; the controller only guarantees mp_get_line_headroom().
+ *
+ *	At small tolerances the lines can be shorter than the feed covers in MIN_BLOCK_TIME, which
+ *	_plan_line() refuses. A vertex that close to the last one planned is left out and its line
+ *	folded into the next - A into the curve, the lines after the midpoint into the new line,
+ *	which is then held from the last vertex planned instead of C. A vertex before the midpoint
+ *	is also left out if it is that close to the midpoint. The midpoint is always planned, as
+ *	it is the vertex that keeps the path within the tolerance.
+ */
+static stat_t _blend_corner(const GCodeState_t *gm_in)
+{
+	float u1[AXES];
+	float u2[AXES];
+	float corner[AXES];
+	float length1 = 0;
+	float length2 = 0;
+	float cosine = 0;
+
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		corner[axis] = mm.merge_gm.target[axis];
+		u1[axis] = corner[axis] - mm.position[axis];
+		u2[axis] = gm_in->target[axis] - corner[axis];
+		length1 += square(u1[axis]);
+		length2 += square(u2[axis]);
+	}
+	length1 = sqrt(length1);
+	length2 = sqrt(length2);
+	if ((fp_ZERO(length1)) || (fp_ZERO(length2)))
+	{
+		return (mp_commit_merged_line());
+	}
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		u1[axis] /= length1;
+		u2[axis] /= length2;
+		cosine += u1[axis] * u2[axis];
+	}
+	if ((cosine > BLEND_STRAIGHT_COSINE) || (cosine < BLEND_REVERSAL_COSINE))
+	{
+		return (mp_commit_merged_line());
+	}
+	float distance = min3(4 * mm.merge_gm.path_tolerance / sqrt(2 - 2*cosine), length1, length2/2);
+
+	uint8_t segments = BLEND_SEGMENTS_MIN;
+	if ((cosine < BLEND_SHARP_COSINE) && (mp_get_planner_buffers_available() > BLEND_SEGMENTS_MAX))
+	{
+		segments = BLEND_SEGMENTS_MAX;
+	}
+
+	float middle[AXES];
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		middle[axis] = corner[axis] + (u2[axis] - u1[axis]) * distance/4;
+	}
+	float min_length = mm.merge_gm.feed_rate * MIN_BLOCK_TIME;
+
+	// trimmed held line S-A (i = 0), then the blend A-P-C
+	mm.merge_pending = false;
+	for (uint8_t i=0; i<=segments; i++)
+	{
+		float t = (float)i / segments;
+		for (uint8_t axis=0; axis<AXES; axis++)
+		{
+			float a = corner[axis] - u1[axis] * distance;
+			float c = corner[axis] + u2[axis] * distance;
+			mm.merge_gm.target[axis] = square(1-t)*a + 2*t*(1-t)*corner[axis] + square(t)*c;
+		}
+		if (i != segments/2)
+		{
+			if ((get_axis_vector_length(mm.merge_gm.target, mm.position) < min_length) ||
+				((i < segments/2) && (get_axis_vector_length(middle, mm.merge_gm.target) < min_length)))
+			{
+				continue;						// folded into the next line
+			}
+		}
+		stat_t status = _plan_line(&mm.merge_gm);
+		if ((status != STAT_OK) && (status != STAT_MINIMUM_TIME_MOVE))
+		{
+			return (status);
+		}
+	}
+	return (STAT_OK);
+}
+
+
+/*
+ * _comp_line() - hold a line for cutter compensation, releasing the one before it
+ * _release_comp_lines() - queue the held lines, offset to the corner with the next line
+ *
+ *	Under G41 or G42 (see cm_set_cutter_comp()) the tool runs parallel to the programmed XY
+ *	path at the cutter radius, to its left or right. Where two lines meet, the offset path
+ *	turns at the intersection of the two offset lines, so the end of a line is not known until
+ *	the next line arrives. One XY line is held in mm.comp_gm[] for this, together with up to
+ *	CUTTER_COMP_HOLD_LINES-1 lines after it that only move Z (a plunge between two cuts).
+ *	When the next XY line arrives the held line is queued to the intersection, the Z lines
+ *	follow at that point, and the new line is held in turn. The lines are offset once, as
+ *	they are queued to the merge and planning stages above, so the planner sees an ordinary
+ *	stream of lines and the parser is never stalled.
+ *
+ *	The first line after G41 or G42 (the entry move) starts from where the tool is, and a
+ *	held line with no compensated line after it ends at the offset of its own end point, so
+ *	the first uncompensated line after G40 (the exit move) starts from there. Outside corners
+ *	sharper than CUTTER_COMP_MITER_LIMIT allows, and reversals, get a chamfer line from one
+ *	offset end point to the other instead of a far away intersection. An inside corner with
+ *	a line too short for the cutter is reported as a gouge; the path is still queued.
+ *
+ *	The held lines are released without a corner whenever the merged line would be (see
+ *	mp_commit_merged_line()). Unlike a merged line they are not released just because the
+ *	queue runs low, as that would cut inside corners, but only once the queue has run empty
+ *	and CUTTER_COMP_HOLD_MS has passed with no next line (mp_merge_callback()). The last line
+ *	of a job streamed without a program end still runs, and a starved queue costs a pause
+ *	rather than corner accuracy.
+ *	Compensation is only applied in a machining cycle - homing, probing and jogging moves
+ *	are not offset.
+ */
+static uint8_t _is_compensated(const GCodeState_t *gm_in)
+{
+	if ((gm_in->cutter_comp == CUTTER_COMP_OFF) ||
+		(fp_ZERO(gm_in->cutter_radius)) ||
+		(gm_in->select_plane != CANON_PLANE_XY) ||
+		(cm.cycle_state != CYCLE_MACHINING))
+	{
+		return (false);
+	}
+	return (true);
+}
+
+static stat_t _comp_line(const GCodeState_t *gm_in)
+{
+	float start[2];								// programmed start of the new line
+
+	if (mm.comp_count != 0)
+	{
+		copy_vector(start, mm.comp_gm[mm.comp_count-1].target);
+	}
+	else if (mm.comp_chain == true)
+	{
+		copy_vector(start, mm.comp_end);
+	}
+	else										// entry move - from where the tool is
+	{
+		copy_vector(start, (mm.merge_pending == true) ? mm.merge_gm.target : mm.position);
+	}
+	float length = hypotf(gm_in->target[AXIS_X] - start[0], gm_in->target[AXIS_Y] - start[1]);
+
+	if (length < EPSILON)						// a Z line stays at the offset XY
+	{
+		if ((mm.comp_count != 0) && (mm.comp_count < CUTTER_COMP_HOLD_LINES))
+		{
+			memcpy(&mm.comp_gm[mm.comp_count++], gm_in, sizeof(GCodeState_t));
+			return (STAT_OK);
+		}
+		ritorno(_release_comp_lines(NULL));
+		memcpy(&mm.comp_gm[0], gm_in, sizeof(GCodeState_t));
+		float *offset_end = (mm.merge_pending == true) ? mm.merge_gm.target : mm.position;
+		mm.comp_gm[0].target[AXIS_X] = offset_end[AXIS_X];
+		mm.comp_gm[0].target[AXIS_Y] = offset_end[AXIS_Y];
+		mm.comp_end[0] = gm_in->target[AXIS_X];
+		mm.comp_end[1] = gm_in->target[AXIS_Y];
+		mm.comp_chain = true;
+		return (_queue_line(&mm.comp_gm[0]));
+	}
+	stat_t status = _release_comp_lines(gm_in);	// the new line is held even if that gouges
+	memcpy(&mm.comp_gm[0], gm_in, sizeof(GCodeState_t));
+	copy_vector(mm.comp_start, start);
+	mm.comp_count = 1;
+	mm.comp_timeout = SysTickTimer_getValue() + CUTTER_COMP_HOLD_MS;
+	return (status);
+}
+
+static stat_t _release_comp_lines(const GCodeState_t *gm_next)
+{
+	if (mm.comp_count == 0)
+	{
+		return (STAT_OK);
+	}
+	uint8_t count = mm.comp_count;
+	mm.comp_count = 0;							// _queue_line() may commit the merged line
+
+	GCodeState_t *gm = &mm.comp_gm[0];
+	float side = (gm->cutter_comp == CUTTER_COMP_LEFT) ? 1 : -1;
+	float radius = gm->cutter_radius;
+	float end[2] = { gm->target[AXIS_X], gm->target[AXIS_Y] };
+	float u1[2] = { end[0] - mm.comp_start[0], end[1] - mm.comp_start[1] };
+	float length1 = hypotf(u1[0], u1[1]);
+	u1[0] /= length1;
+	u1[1] /= length1;
+	float n1[2] = { -side * u1[1], side * u1[0] };	// toward the tool side
+	float n2[2] = { n1[0], n1[1] };
+	float t = 0;								// corner position along the offset of the held line
+	uint8_t chamfer = false;
+	stat_t status = STAT_OK;
+
+	if ((gm_next != NULL) && (gm_next->cutter_comp == gm->cutter_comp) && (fp_EQ(gm_next->cutter_radius, radius)))
+	{
+		float u2[2] = { gm_next->target[AXIS_X] - end[0], gm_next->target[AXIS_Y] - end[1] };
+		float length2 = hypotf(u2[0], u2[1]);
+		u2[0] /= length2;
+		u2[1] /= length2;
+		n2[0] = -side * u2[1];
+		n2[1] = side * u2[0];
+		float cross = u1[0] * u2[1] - u1[1] * u2[0];
+
+		if (fabs(cross) > CUTTER_COMP_PARALLEL)
+		{
+			float w[2] = { (n2[0] - n1[0]) * radius, (n2[1] - n1[1]) * radius };
+			t = (w[0] * u2[1] - w[1] * u2[0]) / cross;
+			float s = (w[0] * u1[1] - w[1] * u1[0]) / cross;
+			if (t > CUTTER_COMP_MITER_LIMIT * radius)
+			{
+				t = 0;
+				chamfer = true;
+			}
+			else if ((-t > length1) || (s > length2))
+			{
+				status = STAT_CUTTER_COMPENSATION_GOUGE;
+			}
+		}
+		else if ((u1[0] * u2[0] + u1[1] * u2[1]) < 0)
+		{
+			chamfer = true;						// reversal - around the end point
+		}
+	}
+	gm->target[AXIS_X] = end[0] + n1[0] * radius + u1[0] * t;
+	gm->target[AXIS_Y] = end[1] + n1[1] * radius + u1[1] * t;
+	ritorno(_queue_line(gm));
+	if (chamfer == true)
+	{
+		gm->target[AXIS_X] = end[0] + n2[0] * radius;
+		gm->target[AXIS_Y] = end[1] + n2[1] * radius;
+		ritorno(_queue_line(gm));
+	}
+	for (uint8_t i=1; i<count; i++)				// the Z lines at the corner
+	{
+		mm.comp_gm[i].target[AXIS_X] = gm->target[AXIS_X];
+		mm.comp_gm[i].target[AXIS_Y] = gm->target[AXIS_Y];
+		ritorno(_queue_line(&mm.comp_gm[i]));
+	}
+	copy_vector(mm.comp_end, end);
+	mm.comp_chain = true;
+	return (status);
+}
+
+
+//**************************************************************************************************
+/*
+ * _plan_line() - plan a line with acceleration / deceleration
  *
  *	This function uses constant jerk motion equations to plan acceleration and deceleration
  *	The jerk is the rate of change of acceleration; it's the 1st derivative of acceleration,
@@ -99,16 +777,11 @@ uint8_t mp_get_runtime_busy()
 */
 //**************************************************************************************************
 
-stat_t mp_aline(GCodeState_t *gm_in)
+static stat_t _plan_line(GCodeState_t *gm_in)
 {
 	// current move pointer
 	mpBuf_t *bf;
 
-	// preset this value OFF
-	float 	 junction_velocity;
-	float 	 exact_stop = 0;
-	uint8_t  mr_flag    = false;
-
 	// compute some reusable terms
 	float axis_length[AXES];
 	float axis_square[AXES];
@@ -127,6 +800,18 @@ stat_t mp_aline(GCodeState_t *gm_in)
 		return (STAT_OK);
 	}
 
+	// unit vector and the jerk that keeps every axis within its own limit
+	float unit[AXES];
+	float axis_share[AXES];
+
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		unit[axis] = axis_length[axis] / length;
+		axis_share[axis] = fabs(unit[axis]);
+	}
+	uint8_t jerk_axis;
+	float jerk = _get_move_jerk(axis_share, &jerk_axis);
+
 	//**********************************************************************************************
 	/*
 	 * If _calc_move_times() says the move will take less than the minimum move time
@@ -140,36 +825,340 @@ stat_t mp_aline(GCodeState_t *gm_in)
 	*/
 	//**********************************************************************************************
 
-	// set move time and minimum time in the state
-	_calc_move_times(gm_in, axis_length, axis_square);
+	// set move time and minimum time in the state
+	_calc_move_times(gm_in, axis_length, axis_square);
+
+	if (gm_in->move_time < MIN_BLOCK_TIME)
+	{
+		// max velocity change for this move
+		float delta_velocity = pow(length, 0.66666666) * cbrt(jerk);
+
+		// pre-set as if no previous block
+		float entry_velocity = 0;
+
+		if ((bf = mp_get_run_buffer()) != NULL)
+		{
+			// block's not optimally planned
+			if (bf->replannable == true)
+			{
+				entry_velocity = bf->entry_velocity + bf->delta_vmax;
+			}
+			// block's optimally planned
+			else
+			{
+				entry_velocity = bf->exit_velocity;
+			}
+		}
+
+		// compute execution time for this move
+		float move_time = (2 * length) / (2*entry_velocity + delta_velocity);
+		if (move_time < MIN_BLOCK_TIME)
+		{
+			return (STAT_MINIMUM_TIME_MOVE);
+		}
+	}
+
+	// get a cleared buffer and setup move variables
+	if ((bf = mp_get_write_buffer()) == NULL)
+	{
+		// never supposed to fail
+        return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+
+	// register the callback to the exec function
+	bf->bf_func = mp_exec_aline;
+	bf->length = length;
+
+	// copy model state into planner buffer (per-move values) and modal table (shared values)
+	if (mp_set_buffer_gcode_state(bf, gm_in) != STAT_OK)
+	{
+		// never supposed to fail - modal headroom is checked upstream
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+	if (gm_in->raster_pixels != 0)
+	{
+		bf->raster_base = mp_claim_raster_row();
+	}
+	copy_vector(bf->unit, unit);
+	bf->jerk = jerk;
+	bf->jerk_axis = jerk_axis;
+
+	// target velocity requested - an arc segment stays within the centripetal limit of its arc
+	bf->cruise_vmax = bf->length / bf->move_time;
+	if (fp_NOT_ZERO(mm.segment_radius))
+	{
+		bf->cruise_vmax = min(bf->cruise_vmax, sqrt(mm.segment_radius * cm_get_junction_acceleration()));
+	}
+	_limit_step_velocity(bf, axis_share);
+	_govern_cruise_velocity(bf, gm_in);
+	_set_cruise_limit(bf, gm_in, axis_share);
+	_set_override_vmax(bf, gm_in, axis_share, mm.segment_radius);
+
+	return (_commit_move(bf, bf->unit, MOVE_TYPE_ALINE));
+}
+
+
+//**************************************************************************************************
+/*
+ * _commit_move() - finish planning a line or arc buffer and queue it
+ *
+ *	Expects bf->length, jerk, cruise_vmax and the Gcode state to be set. entry_unit is the
+ *	direction the move starts in, which is used with the previous buffer's unit vector for the
+ *	junction velocity. bf->unit must hold the direction the move ends in for the next junction.
+ *	Arc segments use the true arc tangents for their junctions instead (see mp_aline_segment()).
+*/
+//**************************************************************************************************
+
+static stat_t _commit_move(mpBuf_t *bf, const float entry_unit[], uint8_t move_type)
+{
+	float 	 junction_velocity;
+	uint8_t  mr_flag    = false;
+	uint8_t  exact_stop = (cm_get_path_control(MODEL) == PATH_EXACT_STOP);
+
+	// specialized comparison for tolerance of delta
+	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_PRECISION)
+	{
+		// used before this point next time around
+		mm.jerk = bf->jerk;
+
+		// compute cached jerk terms used by planning
+		mm.recip_jerk = 1/bf->jerk;
+
+		mm.cbrt_jerk = cbrt(bf->jerk);
+	}
+	bf->recip_jerk = mm.recip_jerk;
+	bf->cbrt_jerk = mm.cbrt_jerk;
+
+	// exact stop moves start and end at rest - there is no junction to size and they stay unreplannable
+	if (exact_stop == true)
+	{
+		mm.segment_bf = (fp_NOT_ZERO(mm.segment_radius)) ? bf : NULL;
+		mm.command_barrier = false;
+		bf->entry_vmax = 0;
+		bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
+		bf->exit_vmax = 0;
+	}
+	else
+	{
+		bf->replannable = true;
+
+		// the previous move ends on the arc tangent if it was the last arc segment planned
+		const float *exit_unit = (bf->pv == mm.segment_bf) ? mm.segment_exit : bf->pv->unit;
+		if (fp_NOT_ZERO(mm.segment_radius))
+		{
+			junction_velocity = min(_get_junction_vmax(exit_unit, mm.segment_entry),
+									sqrt(mm.segment_radius * cm_get_junction_acceleration()));
+			mm.segment_bf = bf;
+		}
+		else
+		{
+			junction_velocity = _get_junction_vmax(exit_unit, entry_unit);
+			mm.segment_bf = NULL;
+		}
+		bf->entry_vmax = min(bf->cruise_vmax, junction_velocity);
+		if (mm.command_barrier == true) {	// a command is chained to the previous buffer
+			bf->entry_vmax = 0;
+			mm.command_barrier = false;
+		}
+		bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
+		bf->exit_vmax = min(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax));
+	}
+	bf->braking_velocity = bf->delta_vmax;
+
+	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
+
+	// replan block list
+	mm.plan_lock = true;						// keep the PendSV planning out (__PLAN_ISR)
+	if ((exact_stop == true) && (bf->pv->replannable == false))
+	{
+		_plan_exact_stop(bf);					// nothing queued ahead of it can change
+	}
+	else
+	{
+		_plan_block_list(bf, &mr_flag);
+	}
+
+	// set the planner position
+	copy_vector(mm.position, bf->target);
+
+	// commit current block (must follow the position update)
+	mp_commit_write_buffer(move_type);
+	mm.plan_lock = false;
+#ifdef __PLAN_ISR
+	if (mm.plan_requested == true) {			// the exec asked for a plan while locked
+		mm.plan_requested = false;
+		st_request_plan();
+	}
+#endif
+	return (STAT_OK);
+}
+
+
+//**************************************************************************************************
+/*
+ * mp_aarc() - plan an arc or helix as a single move
+ *
+ *	The arc takes one planner buffer (MOVE_TYPE_ARC) and is planned along its path length like a
+ *	line. Its geometry goes into the arc table and the runtime generates the points on the curve
+ *	as it runs the segments - see _exec_aline_segment().
+ *
+ *	A point on the arc at angle theta is center + radius * (sin(theta), cos(theta)), so the unit
+ *	tangent at theta is (radius * k * cos(theta), -radius * k * sin(theta), m) in plane axis 0,
+ *	plane axis 1 and the linear axis, where k and m are the angular and linear rates per mm of
+ *	path. The entry tangent is used for the junction with the previous move and the exit tangent
+ *	is left in bf->unit for the next one.
+ *
+ *	The cruise velocity is limited so the centripetal acceleration v^2/r stays within the junction
+ *	acceleration, the same limit junction cornering works to. The jerk is that of the slowest axis
+ *	taking part in the move. Arcs too short to plan as a block are run as a line to the target.
+*/
+//**************************************************************************************************
+
+stat_t mp_aarc(GCodeState_t *gm_in, const mpArc_t *arc_in, float length)
+{
+	_take_outputs(gm_in);
+	return (_release_outputs(gm_in, _aarc(gm_in, arc_in, length)));
+}
+
+static stat_t _aarc(GCodeState_t *gm_in, const mpArc_t *arc_in, float length)
+{
+	mpBuf_t *bf;
+
+	if (cfg.derived_dirty != 0)
+	{
+		config_update_derived();
+	}
+	// a line held for merging or blending goes first
+	ritorno(mp_commit_merged_line());
+	cm_sync_spindle();
+
+	if (fp_ZERO(length))
+	{
+		return (STAT_OK);
+	}
+	if (gm_in->move_time < MIN_BLOCK_TIME)
+	{
+		return (_plan_line(gm_in));
+	}
+
+	float radius = hypotf(mm.position[arc_in->plane_axis_0] - arc_in->center_0,
+						  mm.position[arc_in->plane_axis_1] - arc_in->center_1);
+	// an arc with no planar travel is a straight line (e.g. a modal G2/G3 with only Z words)
+	if (fp_ZERO(radius) || fp_ZERO(arc_in->angular_rate))
+	{
+		return (_plan_line(gm_in));
+	}
+	float theta = atan2(mm.position[arc_in->plane_axis_0] - arc_in->center_0,
+						mm.position[arc_in->plane_axis_1] - arc_in->center_1);
+	float theta_end = theta + arc_in->angular_rate * length;
+	float tangent = radius * arc_in->angular_rate;
+	float entry_unit[AXES] = {0};
+
+	// get a cleared buffer and setup move variables
+	if ((bf = mp_get_write_buffer()) == NULL)
+	{
+		// never supposed to fail
+        return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+	bf->bf_func = mp_exec_aline;
+	bf->length = length;
+
+	// never supposed to fail - arc and modal availability are checked upstream
+	if ((mp_set_buffer_gcode_state(bf, gm_in) != STAT_OK) || (mp_set_buffer_arc(bf, arc_in) != STAT_OK))
+	{
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
+
+	entry_unit[arc_in->plane_axis_0] = tangent * cos(theta);
+	entry_unit[arc_in->plane_axis_1] = -tangent * sin(theta);
+	entry_unit[arc_in->linear_axis] = arc_in->linear_rate;
+	bf->unit[arc_in->plane_axis_0] = tangent * cos(theta_end);
+	bf->unit[arc_in->plane_axis_1] = -tangent * sin(theta_end);
+	bf->unit[arc_in->linear_axis] = arc_in->linear_rate;
+
+	// the jerk is limited by the largest share each axis takes anywhere along the arc
+	float axis_share[AXES] = {0};
+	axis_share[arc_in->plane_axis_0] = fabs(tangent) * _get_arc_axis_share(theta, theta_end, 0);
+	axis_share[arc_in->plane_axis_1] = fabs(tangent) * _get_arc_axis_share(theta, theta_end, M_PI/2);
+	axis_share[arc_in->linear_axis] = fabs(arc_in->linear_rate);
+	bf->jerk = _get_move_jerk(axis_share, &bf->jerk_axis);
+
+	bf->cruise_vmax = min(length / gm_in->move_time, sqrt(radius * cm_get_junction_acceleration()));
+	_limit_step_velocity(bf, axis_share);
+	_govern_cruise_velocity(bf, gm_in);
+	_set_cruise_limit(bf, gm_in, axis_share);
+	_set_override_vmax(bf, gm_in, axis_share, radius);
+
+	return (_commit_move(bf, entry_unit, MOVE_TYPE_ARC));
+}
+
+//**************************************************************************************************
+/*
+ * mp_aspline() - plan a G5/G5.1 spline as a single move
+ *
+ *	The spline takes one planner buffer (MOVE_TYPE_SPLINE) and is planned along its path length
+ *	like an arc. Its coefficients and path length table go into the spline table and the runtime
+ *	generates the points on the curve as it runs the segments - see _exec_aline_segment().
+ *
+ *	The curve is sampled at SPLINE_CURVATURE_SAMPLES points for its tightest radius of curvature
+ *	|P'|^3 / |P' x P''|, and the cruise velocity is limited so the centripetal acceleration stays
+ *	within the junction acceleration there - the same limit arcs are planned to. The jerk is that
+ *	of the slowest axis for the largest share it takes anywhere along the curve. Splines too short
+ *	to plan as a block are run as a line to the target.
+*/
+//**************************************************************************************************
+
+stat_t mp_aspline(GCodeState_t *gm_in, const mpSpline_t *spline_in)
+{
+	_take_outputs(gm_in);
+	return (_release_outputs(gm_in, _aspline(gm_in, spline_in)));
+}
+
+static stat_t _aspline(GCodeState_t *gm_in, const mpSpline_t *spline_in)
+{
+	mpBuf_t *bf;
+	float length = spline_in->length[SPLINE_LENGTH_SAMPLES-1];
 
-	if (gm_in->move_time < MIN_BLOCK_TIME)
+	if (cfg.derived_dirty != 0)
 	{
-		// max velocity change for this move
-		float delta_velocity = pow(length, 0.66666666) * mm.cbrt_jerk;
+		config_update_derived();
+	}
+	// a line held for merging or blending goes first
+	ritorno(mp_commit_merged_line());
+	cm_sync_spindle();
 
-		// pre-set as if no previous block
-		float entry_velocity = 0;
+	if (fp_ZERO(length))
+	{
+		return (STAT_OK);
+	}
+	if (gm_in->move_time < MIN_BLOCK_TIME)
+	{
+		return (_plan_line(gm_in));
+	}
 
-		if ((bf = mp_get_run_buffer()) != NULL)
-		{
-			// block's not optimally planned
-			if (bf->replannable == true)
-			{
-				entry_velocity = bf->entry_velocity + bf->delta_vmax;
-			}
-			// block's optimally planned
-			else
-			{
-				entry_velocity = bf->exit_velocity;
-			}
+	// sample the curve for the tightest radius and the largest share of each axis
+	const float (*c)[2] = spline_in->coef;
+	float axis_share[AXES] = {0};
+	float radius = 0;							// 0 until a curved sample is found
+	for (uint8_t i=0; i <= SPLINE_CURVATURE_SAMPLES; i++)
+	{
+		float u = (float)i / SPLINE_CURVATURE_SAMPLES;
+		float d1_x = c[0][0] + u * (2*c[1][0] + u * 3*c[2][0]);
+		float d1_y = c[0][1] + u * (2*c[1][1] + u * 3*c[2][1]);
+		float d2_x = 2*c[1][0] + u * 6*c[2][0];
+		float d2_y = 2*c[1][1] + u * 6*c[2][1];
+		float speed = hypotf(d1_x, d1_y);
+		if (speed < EPSILON)					// a control point on an end point - the tangent
+		{										// turns there without the curve bending
+			continue;
 		}
-
-		// compute execution time for this move
-		float move_time = (2 * length) / (2*entry_velocity + delta_velocity);
-		if (move_time < MIN_BLOCK_TIME)
+		axis_share[AXIS_X] = max(axis_share[AXIS_X], fabs(d1_x) / speed);
+		axis_share[AXIS_Y] = max(axis_share[AXIS_Y], fabs(d1_y) / speed);
+		float cross = fabs(d1_x * d2_y - d1_y * d2_x);
+		float speed_cubed = speed * speed * speed;
+		if ((cross > EPSILON) && ((radius == 0) || (speed_cubed < radius * cross)))
 		{
-			return (STAT_MINIMUM_TIME_MOVE);
+			radius = speed_cubed / cross;
 		}
 	}
 
@@ -179,156 +1168,151 @@ stat_t mp_aline(GCodeState_t *gm_in)
 		// never supposed to fail
         return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
 	}
-
-	// register the callback to the exec function
 	bf->bf_func = mp_exec_aline;
 	bf->length = length;
 
-	// copy model state into planner buffer
-	memcpy(&bf->gm, gm_in, sizeof(GCodeState_t));
+	// never supposed to fail - spline and modal availability are checked upstream
+	if ((mp_set_buffer_gcode_state(bf, gm_in) != STAT_OK) || (mp_set_buffer_spline(bf, spline_in) != STAT_OK))
+	{
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));
+	}
 
+	float entry_unit[AXES];
+	_get_spline_tangent(spline_in, 0, entry_unit);
+	_get_spline_tangent(spline_in, 1, bf->unit);
+	bf->jerk = _get_move_jerk(axis_share, &bf->jerk_axis);
 
-	//**********************************************************************************************
-	/*
-	 * Compute the unit vector and find the right jerk to use (combined operations)
-	 * To determine the jerk value to use for the block we want to find the axis for which
-	 * the jerk cannot be exceeded - the 'jerk-limit' axis. This is the axis for which
-	 * the time to decelerate from the target velocity to zero would be the longest.
-	 *
-	 *	We can determine the "longest" deceleration in terms of time or distance.
-	 *
-	 *  The math for time-to-decelerate T from speed S to speed E with constant
-	 *  jerk J is:
-	 *
-	 *		T = 2*sqrt((S-E)/J[n])
-	 *
-	 *	Since E is always zero in this calculation, we can simplify:
-	 *		T = 2*sqrt(S/J[n])
-	 *
-	 *	The math for distance-to-decelerate l from speed S to speed E with constant
-	 *  jerk J is:
-	 *
-	 *		l = (S+E)*sqrt((S-E)/J)
-	 *
-	 *	Since E is always zero in this calculation, we can simplify:
-	 *		l = S*sqrt(S/J)
-	 *
-	 *  The final value we want is to know which one is *longest*, compared to the others,
-	 *	so we don't need the actual value. This means that the scale of the value doesn't
-	 *	matter, so for T we can remove the "2 *" and For L we can remove the "S*".
-	 *	This leaves both to be simply "sqrt(S/J)". Since we don't need the scale,
-	 *	it doesn't matter what speed we're coming from, so S can be replaced with 1.
-	 *
-	 *  However, we *do* need to compensate for the fact that each axis contributes
-	 *	differently to the move, so we will scale each contribution C[n] by the
-	 *	proportion of the axis movement length D[n] to the total length of the move L.
-	 *	Using that, we construct the following, with these definitions:
-	 *
-	 *		J[n] = max_jerk for axis n
-	 *		D[n] = distance traveled for this move for axis n
-	 *		L = total length of the move in all axes
-	 *		C[n] = "axis contribution" of axis n
-	 *
-	 *  For each axis n: C[n] = sqrt(1/J[n]) * (D[n]/L)
-	 *
-	 *	Keeping in mind that we only need a rank compared to the other axes, we can further
-	 *	optimize the calculations::
-	 *
-	 *	Square the expression to remove the square root:
-	 *		C[n]^2 = (1/J[n]) * (D[n]/L)^2	(We don't care the C is squared, we'll use it that way.)
-	 *
-	 *	Re-arranged to optimize divides for pre-calculated values, we create a value
-	 *  M that we compute once:
-	 *		M = (1/(L^2))
-	 *  Then we use it in the calculations for every axis:
-	 *		C[n] = (1/J[n]) * D[n]^2 * M
-	 *
-	 *  Also note that we already have (1/J[n]) calculated for each axis, which simplifies it further.
-	 *
-	 * Finally, the selected jerk term needs to be scaled by the reciprocal of the absolute value
-	 * of the jerk-limit axis's unit vector term. This way when the move is finally decomposed into
-	 * its constituent axes for execution the jerk for that axis will be at it's maximum value.
-	*/
-	//**********************************************************************************************
+	bf->cruise_vmax = length / gm_in->move_time;
+	if (radius > 0)								// a straight spline has no curvature limit
+	{
+		bf->cruise_vmax = min(bf->cruise_vmax, sqrt(radius * cm_get_junction_acceleration()));
+	}
+	_limit_step_velocity(bf, axis_share);
+	_govern_cruise_velocity(bf, gm_in);
+	_set_cruise_limit(bf, gm_in, axis_share);
+	_set_override_vmax(bf, gm_in, axis_share, radius);
+
+	return (_commit_move(bf, entry_unit, MOVE_TYPE_SPLINE));
+}
 
-	// contribution term. C = T * a
-	float C;
-	float maxC = 0;
-	float recip_L2 = 1/length_square;
+/*
+ * _govern_cruise_velocity() - slow a feed down if the queue is about to run dry ($qg)
+ *
+ *	If the host can't keep the queue filled (dense 3D finishing over USB, for example) the
+ *	last move queued decelerates to a stop and the machine waits for the next, leaving a
+ *	witness mark. With $qg set, a feed queued while the machine runs with less than $qg ms
+ *	of motion queued has its cruise velocity scaled by the queued time over $qg, down to
+ *	QUEUE_GOVERNOR_MIN_FACTOR. A slower move runs longer and gives the host time to catch
+ *	up, so the feed sags gradually and recovers as the queue fills again. Traverses and an
+ *	idle machine are left alone - a cycle starts at full speed.
+ */
+static void _govern_cruise_velocity(mpBuf_t *bf, const GCodeState_t *gm_in)
+{
+	if ((cm.queue_governor_time == 0) || (cm.motion_state != MOTION_RUN) ||
+		(cm.cycle_state != CYCLE_MACHINING) || (gm_in->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE))
+	{
+		return;
+	}
+	float factor = mp_get_planner_queue_time() / cm.queue_governor_time;
+	if (factor < 1)
+	{
+		bf->cruise_vmax *= max(factor, QUEUE_GOVERNOR_MIN_FACTOR);
+	}
+}
 
+/*
+ * _limit_step_velocity() - keep a move's cruise velocity within what the steppers can deliver
+ *
+ *	An axis taking axis_share of the path velocity moves at velocity * axis_share, so the move
+ *	may go no faster than the axis step rate limit over its share (see cm_update_step_velocity()).
+ *	A vm or fr set above the limit would otherwise ask the DDA for more steps than it can run.
+ */
+static void _limit_step_velocity(mpBuf_t *bf, const float axis_share[])
+{
 	for (uint8_t axis=0; axis<AXES; axis++)
 	{
-		// You cannot use the fp_XXX comparisons here!
-		if (fabs(axis_length[axis]) > 0)
+		if ((axis_share[axis] > 0) && (cm.a[axis].step_velocity_max > 0))
 		{
-			// compute unit vector term (zeros are already zero)
-			bf->unit[axis] = axis_length[axis] / bf->length;
+			bf->cruise_vmax = min(bf->cruise_vmax, cm.a[axis].step_velocity_max / axis_share[axis]);
+		}
+	}
+}
 
-			// squaring axis_length ensures it's positive
-			C = axis_square[axis] * recip_L2 * cm.a[axis].recip_jerk;
-			if (C > maxC)
-			{
-				maxC = C;
 
-				// also needed for junction vmax calculation
-				bf->jerk_axis = axis;
-			}
+/*
+ * _set_cruise_limit() - note whether the feed rate or a velocity limit set a move's cruise_vmax
+ *
+ *	A traverse always runs at the axis velocity limits. A feed is held by a limit if the
+ *	cruise was cut below length / move_time (step rate, arc curvature, queue governor) or if
+ *	an axis runs at its feedrate_max at that cruise. Only done while the job profile is on
+ *	(see mp_get_cruise_limit()).
+ */
+static void _set_cruise_limit(mpBuf_t *bf, const GCodeState_t *gm_in, const float axis_share[])
+{
+	if (jp.profile_enable == false)
+	{
+		return;
+	}
+	bf->cruise_limit = MP_LIMIT_VMAX;
+	if ((gm_in->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ||
+		(bf->cruise_vmax < bf->length / gm_in->move_time * MP_LIMIT_MATCH))
+	{
+		return;
+	}
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		if (axis_share[axis] * bf->cruise_vmax >= cm.a[axis].feedrate_max * MP_LIMIT_MATCH)
+		{
+			return;
 		}
 	}
-	// set up and pre-compute the jerk terms needed for this round of planning, scale the jerk
-	bf->jerk = cm.a[bf->jerk_axis].jerk_max * JERK_MULTIPLIER / fabs(bf->unit[bf->jerk_axis]);
+	bf->cruise_limit = MP_LIMIT_FEED;
+}
 
-	// specialized comparison for tolerance of delta
-	if (fabs(bf->jerk - mm.jerk) > JERK_MATCH_PRECISION)
+/*
+ * _set_override_vmax() - fastest cruise a feed or traverse override above 100% may run the move at
+ *
+ *	The override speeds up the cruise (body) of the running move only, so this is a velocity
+ *	limit - each axis stays within its feedrate_max (velocity_max for a traverse) and step rate
+ *	limit at its share of the path velocity, and a curve (radius > 0) within the centripetal
+ *	limit it was planned to. A move already held below its requested feed (curvature, step
+ *	rate, queue governor) keeps the cruise it was planned with, and so does a traverse, which
+ *	is planned at the velocity limits.
+ */
+static void _set_override_vmax(mpBuf_t *bf, const GCodeState_t *gm_in, const float axis_share[], float radius)
+{
+	bf->override_vmax = bf->cruise_vmax;
+	if ((gm_in->motion_mode == MOTION_MODE_STRAIGHT_TRAVERSE) ||
+		(bf->cruise_vmax < bf->length / gm_in->move_time * MP_LIMIT_MATCH))
 	{
-		// used before this point next time around
-		mm.jerk = bf->jerk;
-
-		// compute cached jerk terms used by planning
-		mm.recip_jerk = 1/bf->jerk;
-
-		mm.cbrt_jerk = cbrt(bf->jerk);
+		return;
 	}
-	bf->recip_jerk = mm.recip_jerk;
-	bf->cbrt_jerk = mm.cbrt_jerk;
-
-	// finish up the current block variables, exact stop cases already zeroed
-	if (cm_get_path_control(MODEL) != PATH_EXACT_STOP)
+	float vmax = bf->cruise_vmax * FEED_OVERRIDE_MAX;
+	if (radius > 0)
 	{
-		bf->replannable = true;
-
-		// an arbitrarily large floating point number
-		exact_stop = 8675309;
+		vmax = min(vmax, sqrt(radius * cm_get_junction_acceleration()));
 	}
-
-	// target velocity requested
-	bf->cruise_vmax = bf->length / bf->gm.move_time;
-	junction_velocity = _get_junction_vmax(bf->pv->unit, bf->unit);
-	bf->entry_vmax = min3(bf->cruise_vmax, junction_velocity, exact_stop);
-	bf->delta_vmax = mp_get_target_velocity(0, bf->length, bf);
-	bf->exit_vmax = min3(bf->cruise_vmax, (bf->entry_vmax + bf->delta_vmax), exact_stop);
-	bf->braking_velocity = bf->delta_vmax;
-
-	// Note: these next lines must remain in exact order. Position must update before committing the buffer.
-
-	// replan block list
-	_plan_block_list(bf, &mr_flag);
-
-	// set the planner position
-	copy_vector(mm.position, bf->gm.target);
-
-	// commit current block (must follow the position update)
-	mp_commit_write_buffer(MOVE_TYPE_ALINE);
-
-	return (STAT_OK);
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		if (axis_share[axis] > 0)
+		{
+			vmax = min(vmax, cm.a[axis].feedrate_max / axis_share[axis]);
+			if (cm.a[axis].step_velocity_max > 0)
+			{
+				vmax = min(vmax, cm.a[axis].step_velocity_max / axis_share[axis]);
+			}
+		}
+	}
+	bf->override_vmax = max(vmax, bf->cruise_vmax);
 }
 
 
-
 //**************************************************************************************************
 /* ALINE HELPERS
  * _calc_move_times()
+ * _get_move_jerk()
  * _plan_block_list()
+ * _plan_exact_stop()
  * _get_junction_vmax()
  * _reset_replannable_list()
 */
@@ -358,10 +1342,99 @@ stat_t mp_aline(GCodeState_t *gm_in)
  *	Sets the following variables in the gcode_state struct
  *	  - move_time is set to optimal time
  *	  - minimum_time is set to minimum time
+ *
+ *	G93 feeds take a fast path. The block's time is the move time unless an axis would have to
+ *	exceed its feedrate_max - a multiply per moving axis, and a divide only for an axis that
+ *	does. That skips the per-axis time divisions of the general case, which 4 axis inverse time
+ *	files pay at a high block rate. minimum_time is left at the move time.
 */
 //**************************************************************************************************
 
 
+//**************************************************************************************************
+/*
+ * _get_move_jerk() - highest path jerk that keeps every axis within its own jerk_max
+ *
+ *	axis_share[] is how far each axis moves per mm of path - the absolute value of the unit
+ *	vector for a line, or the largest value anywhere along the move for an arc. An axis sees
+ *	that share of the path jerk, so the path jerk is the smallest jerk_max / share and the
+ *	rate limiting axis runs at exactly its own limit. Returns the jerk (in mm/min^3) and the
+ *	rate limiting axis. A G187 preset scales the jerk (see cm_get_jerk_scale()).
+ */
+//**************************************************************************************************
+
+static float _get_move_jerk(const float axis_share[], uint8_t *jerk_axis)
+{
+	float jerk = 0;
+
+	*jerk_axis = AXIS_X;
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		// You cannot use the fp_XXX comparisons here!
+		if (axis_share[axis] > 0)
+		{
+			float axis_jerk = cm.a[axis].jerk_max / axis_share[axis];
+			if ((jerk == 0) || (axis_jerk < jerk))
+			{
+				jerk = axis_jerk;
+				*jerk_axis = axis;
+			}
+		}
+	}
+	return (jerk * JERK_MULTIPLIER * cm_get_jerk_scale());		// scaled by the G187 preset
+}
+
+/*
+ * _get_arc_axis_share() - largest |cos(theta - phase)| for theta between theta_0 and theta_1
+ *
+ *	Use phase 0 for plane axis 0 and PI/2 for plane axis 1 (see mp_aarc()).
+ */
+
+static float _get_arc_axis_share(float theta_0, float theta_1, float phase)
+{
+	float lo = min(theta_0, theta_1) - phase;
+	float hi = max(theta_0, theta_1) - phase;
+
+	if ((ceil(lo / M_PI) * M_PI) <= hi)		// the arc passes through a point where the axis leads
+	{
+		return (1);
+	}
+	return (max(fabs(cos(lo)), fabs(cos(hi))));
+}
+
+/*
+ * _get_spline_tangent() - unit direction of travel at the start (u = 0) or end (u = 1) of a spline
+ *
+ *	If a control point sits on the end point the first derivative is zero there, and the
+ *	direction is that of the first non-zero higher derivative. Going into the end point the
+ *	second derivative points back along the curve, so it is reversed for u = 1.
+ */
+
+static void _get_spline_tangent(const mpSpline_t *sp, float u, float unit[])
+{
+	const float (*c)[2] = sp->coef;
+	float d[3][2];
+	float sign = (u > 0.5) ? -1 : 1;
+
+	for (uint8_t i=0; i<2; i++)
+	{
+		d[0][i] = c[0][i] + u * (2*c[1][i] + u * 3*c[2][i]);
+		d[1][i] = sign * (2*c[1][i] + u * 6*c[2][i]);
+		d[2][i] = c[2][i];
+	}
+	memset(unit, 0, sizeof(float) * AXES);
+	for (uint8_t n=0; n<3; n++)
+	{
+		float speed = hypotf(d[n][0], d[n][1]);
+		if (speed > EPSILON)
+		{
+			unit[AXIS_X] = d[n][0] / speed;
+			unit[AXIS_Y] = d[n][1] / speed;
+			return;
+		}
+	}
+}
+
 //**************************************************************************************************
 /* --- NIST RS274NGC_v3 Guidance ---
  *
@@ -404,32 +1477,40 @@ stat_t mp_aline(GCodeState_t *gm_in)
 //
 static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const float axis_square[])
 {
-	float inv_time=0;				// inverse time if doing a feed in G93 mode
 	float xyz_time=0;				// coordinated move linear part at requested feed rate
 	float abc_time=0;				// coordinated move rotary part at requested feed rate
 	float max_time=0;				// time required for the rate-limiting axis
 	float tmp_time=0;				// used in computation
+
+	if ((gms->motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE) && (gms->feed_rate_mode == INVERSE_TIME_MODE))
+	{
+		// NB: feed rate was un-inverted to minutes by cm_set_feed_rate()
+		gms->move_time = gms->feed_rate;
+		gms->feed_rate_mode = UNITS_PER_MINUTE_MODE;
+
+		for (uint8_t axis = AXIS_X; axis < AXES; axis++)
+		{
+			float length = fabs(axis_length[axis]);
+			if (length > gms->move_time * cm.a[axis].feedrate_max)
+			{
+				gms->move_time = length / cm.a[axis].feedrate_max;
+			}
+		}
+		gms->minimum_time = gms->move_time;
+		return;
+	}
 	gms->minimum_time = 8675309;	// arbitrarily large number
 
 	// compute times for feed motion
 	if (gms->motion_mode != MOTION_MODE_STRAIGHT_TRAVERSE)
 	{
-		if (gms->feed_rate_mode == INVERSE_TIME_MODE)
-		{
-			// NB: feed rate was un-inverted to minutes by cm_set_feed_rate()
-			inv_time = gms->feed_rate;
-			gms->feed_rate_mode = UNITS_PER_MINUTE_MODE;
-		}
-		else
-		{
-			// compute length of linear move in millimeters. Feed rate is provided as mm/min
-			xyz_time = sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]) / gms->feed_rate;
+		// compute length of linear move in millimeters. Feed rate is provided as mm/min
+		xyz_time = sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]) / gms->feed_rate;
 
-			// if no linear axes, compute length of multi-axis rotary move in degrees. Feed rate is provided as degrees/min
-			if (fp_ZERO(xyz_time))
-			{
-				abc_time = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]) / gms->feed_rate;
-			}
+		// if no linear axes, compute length of multi-axis rotary move in degrees. Feed rate is provided as degrees/min
+		if (fp_ZERO(xyz_time))
+		{
+			abc_time = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]) / gms->feed_rate;
 		}
 	}
 
@@ -453,7 +1534,7 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
 			gms->minimum_time = min(gms->minimum_time, tmp_time);
 		}
 	}
-	gms->move_time = max4(inv_time, max_time, xyz_time, abc_time);
+	gms->move_time = max3(max_time, xyz_time, abc_time);
 }
 
 
@@ -531,22 +1612,41 @@ static void _calc_move_times(GCodeState_t *gms, const float axis_length[], const
  *
  *	[2] The mr_flag is used to tell replan to account for mr buffer's exit velocity (Vx)
  *		mr's Vx is always found in the provided bf buffer. Used to replan feedholds
+ *
+ *	[3]	The backward pass also stops at the first block whose braking velocity comes
+ *		out the same as it already was. A block's braking velocity only depends on the
+ *		block after it, so once one is unchanged every block before it is unchanged too.
+ *		The exit velocity of the block before it is unchanged as well, so the forward
+ *		pass only has to start at that block. This happens as soon as the backward pass
+ *		reaches a block whose successor is limited by its entry_vmax and not by braking,
+ *		which keeps the cost of adding a move roughly constant with a deep queue of short
+ *		moves. The cutoff is not used when the mr_flag is set (full replan for feedholds).
 */
 //**************************************************************************************************
 
 static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag)
 {
 	mpBuf_t *bp = bf;
+	float braking_velocity;
 
+	PERF_COUNT(PERF_REPLAN);
 	// Backward planning pass. Find first block and update the braking velocities.
-	// At the end *bp points to the buffer before the first block.
+	// At the end *bp points to the buffer before the first block. [Note 3]
 	while ((bp = mp_get_prev_buffer(bp)) != bf)
 	{
 		if (bp->replannable == false)
 		{
 			break;
 		}
-		bp->braking_velocity = min(bp->nx->entry_vmax, bp->nx->braking_velocity) + bp->delta_vmax;
+		braking_velocity = min(bp->nx->entry_vmax, bp->nx->braking_velocity) + bp->delta_vmax;
+
+		// braking velocity did not change, so no block before this one can improve
+		if ((*mr_flag == false) && (fp_EQ(braking_velocity, bp->braking_velocity)))
+		{
+			bp = mp_get_prev_buffer(bp);
+			break;
+		}
+		bp->braking_velocity = braking_velocity;
 	}
 
 	// forward planning pass - recomputes trapezoids in the list from the first block to the bf block.
@@ -564,6 +1664,7 @@ static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag)
 			bp->entry_velocity = bp->pv->exit_velocity;
 		}
 		
+		if (bp->replans < 255) bp->replans++;
 		bp->cruise_velocity = bp->cruise_vmax;
 		bp->exit_velocity = min4(bp->exit_vmax, bp->nx->entry_vmax, bp->nx->braking_velocity, (bp->entry_velocity + bp->delta_vmax));
 		mp_calculate_trapezoid(bp);
@@ -584,9 +1685,31 @@ static void _plan_block_list(mpBuf_t *bf, uint8_t *mr_flag)
 }
 
 
+//**************************************************************************************************
+/*
+ * _plan_exact_stop() - plan a G61.1 exact stop block by itself
+ *
+ *	An exact stop block starts and ends at rest, so once the block before it is no longer
+ *	replannable nothing in the list can change and the block is planned alone - a single
+ *	trapezoid from zero to zero, with no backward pass and no replannable bookkeeping. This
+ *	keeps point to point jobs (drilling, pick and place) at constant planning cost. An exact
+ *	stop block that follows replannable continuous moves goes through _plan_block_list().
+*/
+//**************************************************************************************************
+
+static void _plan_exact_stop(mpBuf_t *bf)
+{
+	bf->entry_velocity = 0;
+	bf->cruise_velocity = bf->cruise_vmax;
+	bf->exit_velocity = 0;
+	mp_calculate_trapezoid(bf);
+}
+
+
 
 //**************************************************************************************************
 //	_reset_replannable_list() - resets all blocks in the planning list to be replannable
+//								and drops their cached trapezoids (see mp_calculate_trapezoid())
 //**************************************************************************************************
 
 static void _reset_replannable_list()
@@ -597,6 +1720,7 @@ static void _reset_replannable_list()
 	do
 	{
 		bp->replannable = true;
+		bp->zoid_cruise = 0;			// lengths may have changed - don't reuse the trapezoids
 	}
 	while (((bp = mp_get_next_buffer(bp)) != bf) && (bp->move_state != MOVE_OFF));
 }
@@ -645,20 +1769,28 @@ static void _reset_replannable_list()
  *		float theta = acos(costheta);
  *		float radius = delta * sin(theta/2)/(1-sin(theta/2));
  */
-/*  This version extends Chamnit's algorithm by computing a value for delta that takes
- *	the contributions of the individual axes in the move into account. This allows the
- *	control radius to vary by axis. This is necessary to support axes that have
- *	different dynamics; such as a Z axis that doesn't move as fast as X and Y (such as a
- *	screw driven Z axis on machine with a belt driven XY - like a Shapeoko), or rotary
- *	axes ABC that have completely different dynamics than their linear counterparts.
- *
- *	The function takes the absolute values of the sum of the unit vector components as
- *	a measure of contribution to the move, then scales the delta values from the non-zero
- *	axes into a composite delta to be used for the move. Shown for an XY vector:
- *
- *	 	U[i]	Unit sum of i'th axis	fabs(unit_a[i]) + fabs(unit_b[i])
- *	 	Usum	Length of sums			Ux + Uy
- *	 	d		Delta of sums			(Dx*Ux+DY*UY)/Usum
+/*  This version extends Chamnit's algorithm by limiting each axis separately. This is
+ *	necessary to support axes that have different dynamics; such as a Z axis that doesn't
+ *	move as fast as X and Y (such as a screw driven Z axis on machine with a belt driven
+ *	XY - like a Shapeoko), or rotary axes ABC that have completely different dynamics than
+ *	their linear counterparts.
+ *
+ *	Going through the corner at velocity v the velocity of axis i jumps by v * |b[i] - a[i]|.
+ *	On the control circle the acceleration v^2/R points along (b - a). Theta is the angle
+ *	between the reversed entry vector and the exit vector (a straight line is theta = pi),
+ *	so (b - a) has the length 2*cos(theta/2) and axis i takes the share
+ *	|b[i] - a[i]| / (2*cos(theta/2)) of the acceleration. Giving each axis its own control
+ *	radius R[i] from its junction deviation (Dx...Dc), and holding every axis to the
+ *	junction acceleration, the corner velocity is:
+ *
+ *		v^2 = Ja * sin(theta/2) / (1-sin(theta/2)) * 2*cos(theta/2) * min(D[i] / |b[i] - a[i]|)
+ *
+ *	With equal deviations and a jump on one axis this is Chamnit's velocity; a jump shared
+ *	by several axes is taken faster, as each of them sees only part of it.
+ *
+ *	Only the axes whose velocity actually changes take part, so a corner that is mostly
+ *	taken by a stiff axis is no longer held to the deviation of a weak axis that barely
+ *	moves through it.
 */
 //**************************************************************************************************
 
@@ -683,30 +1815,47 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
 		return (0);
 	}
 
-	// Fuse the junction deviations into a vector sum
-	float a_delta = square(a_unit[AXIS_X] * cm.a[AXIS_X].junction_dev);
-
-	a_delta += square(a_unit[AXIS_Y] * cm.a[AXIS_Y].junction_dev);
-	a_delta += square(a_unit[AXIS_Z] * cm.a[AXIS_Z].junction_dev);
-	a_delta += square(a_unit[AXIS_A] * cm.a[AXIS_A].junction_dev);
-	a_delta += square(a_unit[AXIS_B] * cm.a[AXIS_B].junction_dev);
-	a_delta += square(a_unit[AXIS_C] * cm.a[AXIS_C].junction_dev);
-
-	float b_delta = square(b_unit[AXIS_X] * cm.a[AXIS_X].junction_dev);
+	// the axis with the least deviation per unit of its velocity jump sets the limit
+	// the junction limit is the deviation already multiplied by the junction acceleration
+	float delta = 10000000;
+	for (uint8_t axis=0; axis<AXES; axis++)
+	{
+		float jump = fabs(b_unit[axis] - a_unit[axis]);
+		if (jump > EPSILON)
+		{
+			delta = min(delta, cm.a[axis].junction_limit * mp_recip(jump));
+		}
+	}
+	if (cm.gm.preset != 0) {						// the junction limits are made with $ja
+		delta *= cm_get_junction_acceleration() / cm.junction_acceleration;
+	}
+	float sintheta_over2 = mp_sqrt((1 - costheta)/2);
+	float jump_length = mp_sqrt(2 * (1 + costheta));	// |b - a| = 2*cos(theta/2)
+	float velocity = mp_sqrt(delta * jump_length * sintheta_over2 * mp_recip(1-sintheta_over2));
 
-	b_delta += square(b_unit[AXIS_Y] * cm.a[AXIS_Y].junction_dev);
-	b_delta += square(b_unit[AXIS_Z] * cm.a[AXIS_Z].junction_dev);
-	b_delta += square(b_unit[AXIS_A] * cm.a[AXIS_A].junction_dev);
-	b_delta += square(b_unit[AXIS_B] * cm.a[AXIS_B].junction_dev);
-	b_delta += square(b_unit[AXIS_C] * cm.a[AXIS_C].junction_dev);
+	return (velocity);
+}
 
-	float delta = (sqrt(a_delta) + sqrt(b_delta))/2;
-	float sintheta_over2 = sqrt((1 - costheta)/2);
-	float radius = delta * sintheta_over2 / (1-sintheta_over2);
-	float velocity = sqrt(radius * cm.junction_acceleration);
+#ifdef __BENCHMARKS
+/*
+ * mp_bench_junction_vmax() - return the usec taken by calls of _get_junction_vmax() ($bench)
+ *
+ *	The junction is a 90 degree XY corner, which takes the full vector sum path.
+ */
+uint32_t mp_bench_junction_vmax(uint16_t calls)
+{
+	const float a_unit[AXES] = { 1, 0, 0, 0, 0, 0 };
+	const float b_unit[AXES] = { 0, 1, 0, 0, 0, 0 };
+	volatile float sink;
 
-	return (velocity);
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<calls; i++) {
+		sink = _get_junction_vmax(a_unit, b_unit);
+	}
+	(void)sink;
+	return (hw_get_usec() - start);
 }
+#endif // __BENCHMARKS
 
 /*************************************************************************
  * feedholds - functions for performing holds
@@ -764,22 +1913,126 @@ static float _get_junction_vmax(const float a_unit[], const float b_unit[])
  *		  organized for clarity and hoped for the best from compiler optimization.
  */
 
+static float _get_mr_available_length()
+{
+	if ((mr.move_type == MOVE_TYPE_ARC) || (mr.move_type == MOVE_TYPE_SPLINE)) return (mr.arc_length - mr.arc_travel);
+	return (get_axis_vector_length(mr.target, mr.position));
+}
+
 static float _compute_next_segment_velocity()
 {
 	if (mr.section == SECTION_BODY) return (mr.segment_velocity);
 #ifdef __JERK_EXEC
 	return (mr.segment_velocity);	// an approximation
+#elif defined(__FIXED_FORWARD_DIFFS)
+	return (mr.segment_velocity + (float)mr.forward_diff_5 * (1.0/FD_ONE));
 #else
 	return (mr.segment_velocity + mr.forward_diff_5);
 #endif
 }
 
+// Case 1 (below): set mr to a tail to perform the deceleration and re-use bp+0 to be the hold point
+static void _plan_hold_in_mr(mpBuf_t *bp, float braking_velocity, float braking_length, float mr_available_length)
+{
+	mr.exit_velocity = 0;
+	mr.tail_length = braking_length;
+	mr.cruise_velocity = braking_velocity;
+	mr.section = SECTION_TAIL;
+	mr.section_state = SECTION_NEW;
+
+	bp->length = mr_available_length - braking_length;	// bp+0 runs the remaining block length
+	bp->entry_vmax = 0;							// set bp+0 as hold point
+	bp->move_state = MOVE_NEW;					// tell _exec to re-use the bf buffer
+}
+
+/*
+ * _replan_from_hold() - plan the queue up from the bp+0 hold point (Case 1)
+ *
+ *	Only bp+0 changed - it is shorter and starts from rest - so the braking velocities of the
+ *	blocks behind it, which depend only on the blocks after them, are what they were. A forward
+ *	pass from bp+0 carries the lower entry velocity on until a block's entry comes out as it
+ *	was planned, and the rest of the queue keeps its trapezoids, junction velocities and
+ *	replannable flags. Resuming from the hold then only has to run what is planned here.
+ *	Runs in the main loop, so the Newton iterations stay out of the exec.
+ */
+static void _replan_from_hold(mpBuf_t *bp)
+{
+	mpBuf_t *last = mp_get_last_buffer();
+	float entry_velocity = bp->entry_vmax;
+
+	bp->delta_vmax = mp_get_target_velocity(0, bp->length, bp);
+	bp->zoid_cruise = 0;						// its length changed - don't reuse the trapezoid
+	PERF_COUNT(PERF_REPLAN);
+	while (true)
+	{
+		bp->entry_velocity = entry_velocity;
+		bp->cruise_velocity = bp->cruise_vmax;
+		if (bp == last)
+		{
+			bp->exit_velocity = 0;
+			mp_calculate_trapezoid(bp);
+			return;
+		}
+		bp->exit_velocity = min4(bp->exit_vmax, bp->nx->entry_vmax, bp->nx->braking_velocity, (bp->entry_velocity + bp->delta_vmax));
+		mp_calculate_trapezoid(bp);
+		bp->replannable = !((fp_EQ(bp->exit_velocity, bp->exit_vmax)) || (fp_EQ(bp->exit_velocity, bp->nx->entry_vmax)));
+
+		entry_velocity = bp->exit_velocity;
+		bp = bp->nx;
+		if (fp_EQ(bp->entry_velocity, entry_velocity))
+		{
+			return;								// planned from here on as it was
+		}
+	}
+}
+
+/*
+ * mp_plan_hold_runtime() - start a hold from the exec when the decel fits in the mr buffer
+ *
+ *	Called from mp_exec_aline() (LO interrupt) before the next segment of a running move is
+ *	computed. The braking velocity and length come straight from the runtime, so Case 1 holds -
+ *	nearly every hold on a reasonably long move - decelerate from the first segment after the
+ *	sync instead of waiting for the main loop to get around to mp_plan_hold_callback().
+ *	Replanning the queue behind the hold point is left to the callback (mr.hold_replan).
+ *
+ *	Returns STAT_EAGAIN if the decel does not fit. The callback plans those as before (Case 2).
+ */
+stat_t mp_plan_hold_runtime(mpBuf_t *bp)
+{
+	float mr_available_length = _get_mr_available_length();
+	float braking_velocity = _compute_next_segment_velocity();
+	float braking_length = mp_get_target_length(braking_velocity, 0, bp);
+
+	if ((braking_length > mr_available_length) && (fp_ZERO(bp->exit_velocity))) {
+		braking_length = mr_available_length;	// see the perfect-fit hack in mp_plan_hold_callback()
+	}
+	if (braking_length > mr_available_length) return (STAT_EAGAIN);
+
+	_plan_hold_in_mr(bp, braking_velocity, braking_length, mr_available_length);
+	mr.hold_replan = true;
+	cm.hold_state = FEEDHOLD_DECEL;
+#ifdef __PLAN_ISR
+	st_request_plan();
+#endif
+	return (STAT_OK);
+}
+
 stat_t mp_plan_hold_callback()
 {
+	mpBuf_t *bp; 				                // working buffer pointer
+
+	if (mm.plan_lock == true) {					// PendSV came in on a commit (__PLAN_ISR)
+		mm.plan_requested = true;
+		return (STAT_EAGAIN);
+	}
+	if (mr.hold_replan) {						// the exec started the hold - replan behind it
+		mr.hold_replan = false;
+		if ((bp = mp_get_run_buffer()) != NULL) _replan_from_hold(bp);
+		return (STAT_OK);
+	}
 	if (cm.hold_state != FEEDHOLD_PLAN)
         return (STAT_NOOP);                     // not planning a feedhold
 
-	mpBuf_t *bp; 				                // working buffer pointer
 	if ((bp = mp_get_run_buffer()) == NULL)
         return (STAT_NOOP);                     // Oops! nothing's running
 
@@ -789,7 +2042,7 @@ stat_t mp_plan_hold_callback()
 	float braking_length;                       // distance required to brake to zero from braking_velocity
 
 	// examine and process mr buffer
-	mr_available_length = get_axis_vector_length(mr.target, mr.position);
+	mr_available_length = _get_mr_available_length();
 
 /*	mr_available_length =
 		(sqrt(square(mr.endpoint[AXIS_X] - mr.position[AXIS_X]) +
@@ -818,21 +2071,8 @@ stat_t mp_plan_hold_callback()
 
 	// Case 1: deceleration fits entirely into the length remaining in mr buffer
 	if (braking_length <= mr_available_length) {
-		// set mr to a tail to perform the deceleration
-		mr.exit_velocity = 0;
-		mr.tail_length = braking_length;
-		mr.cruise_velocity = braking_velocity;
-		mr.section = SECTION_TAIL;
-		mr.section_state = SECTION_NEW;
-
-		// re-use bp+0 to be the hold point and to run the remaining block length
-		bp->length = mr_available_length - braking_length;
-		bp->delta_vmax = mp_get_target_velocity(0, bp->length, bp);
-		bp->entry_vmax = 0;						// set bp+0 as hold point
-		bp->move_state = MOVE_NEW;				// tell _exec to re-use the bf buffer
-
-		_reset_replannable_list();				// make it replan all the blocks
-		_plan_block_list(mp_get_last_buffer(), &mr_flag);
+		_plan_hold_in_mr(bp, braking_velocity, braking_length, mr_available_length);
+		_replan_from_hold(bp);
 		cm.hold_state = FEEDHOLD_DECEL;			// set state to decelerate and exit
 		return (STAT_OK);
 	}
@@ -849,9 +2089,12 @@ stat_t mp_plan_hold_callback()
 	// Find the point where deceleration reaches zero. This could span multiple buffers.
 	braking_velocity = mr.exit_velocity;		// adjust braking velocity downward
 	bp->move_state = MOVE_NEW;					// tell _exec to re-use buffer
+	mr.command = bp->command;					// mr runs the end of the move, so it takes its commands
+	bp->command = MP_COMMAND_NONE;
 	for (uint8_t i=0; i<PLANNER_BUFFER_POOL_SIZE; i++) {// a safety to avoid wraparound
 		mp_copy_buffer(bp, bp->nx);				// copy bp+1 into bp+0 (and onward...)
-		if (bp->move_type != MOVE_TYPE_ALINE) {	// skip any non-move buffers
+		if ((bp->move_type != MOVE_TYPE_ALINE) && (bp->move_type != MOVE_TYPE_ARC) &&
+			(bp->move_type != MOVE_TYPE_SPLINE)) {	// skip any non-move buffers
 			bp = mp_get_next_buffer(bp);		// point to next buffer
 			continue;
 		}
@@ -870,6 +2113,7 @@ stat_t mp_plan_hold_callback()
 	// Plan the first buffer of the pair as the decel, the second as the accel
 	bp->length = braking_length;
 	bp->exit_vmax = 0;
+	bp->command = MP_COMMAND_NONE;				// the commands run after the accel part
 
 	bp = mp_get_next_buffer(bp);				// point to the acceleration buffer
 	bp->entry_vmax = 0;
@@ -888,6 +2132,7 @@ stat_t mp_plan_hold_callback()
  */
 stat_t mp_end_hold()
 {
+	mp_plan_hold_callback();					// finish a replan the exec may have left pending
 	if (cm.hold_state == FEEDHOLD_END_HOLD) {
 		cm.hold_state = FEEDHOLD_OFF;
 		mpBuf_t *bf;
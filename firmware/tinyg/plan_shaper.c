@@ -0,0 +1,237 @@
+//**************************************************************************************************
+/*
+ * plan_shaper.c - input shaping of the segment positions
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+//**************************************************************************************************
+/* Input shaping
+ *
+ *	A frame that rings at a known frequency can be driven so that it does not ring by
+ *	convolving the commanded motion with a short train of impulses that cancel each
+ *	other's vibration. The shaped position is sum(A[i] * x(t - T[i])). The amplitudes
+ *	are positive and sum to 1, so the shaped path stays inside the commanded one and
+ *	ends on the same point. The price is a lag of up to one damped period, which rounds
+ *	the corners slightly. In return the jerk can be set well above the ringing limit.
+ *
+ *	With K = exp(-zeta*pi / sqrt(1-zeta^2)) and Td = 1 / (f * sqrt(1-zeta^2)):
+ *
+ *	  ZV	[1, K] / (1+K)					at [0, Td/2]		sensitive to frequency error
+ *	  ZVD	[1, 2K, K^2] / (1+K)^2			at [0, Td/2, Td]	tolerates about +/-20% error
+ *	  EI	[(1+V)/4, (1-V)/2, (1+V)/4]		at [0, Td/2, Td]	allows V residual vibration
+ *										  (undamped form)		for a wider tolerance
+ *
+ *	The X, Y and Z positions of each segment are shaped just before kinematics. The
+ *	segment end points go into a short history - the commanded path is linear between
+ *	them - and the delayed positions are interpolated from it. Times are in minutes,
+ *	like the segment times. Once the input stops the exec keeps preparing stationary
+ *	segments until the output has caught up (see mp_exec_move()).
+ *
+ *	The settings are latched while the shaper is idle so a change never lands in the
+ *	middle of a motion. Homing and probing run unshaped as they stop on switch edges.
+ */
+
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "util.h"
+
+typedef struct mpShaperAxis {
+	uint8_t impulses;						// number of impulses; 0 if the axis is not shaped
+	float amplitude[SHAPER_IMPULSES];
+	float delay[SHAPER_IMPULSES];			// in minutes, ascending; delay[0] is always 0
+} mpShaperAxis_t;
+
+typedef struct mpShaper {
+	uint8_t active;							// true if any axis is shaped (latched while idle)
+	uint8_t newest;							// index of the newest sample in the history
+	uint8_t samples;						// number of valid samples in the history
+	float span;								// longest delay of any axis
+	float settle_time;						// time left until the output reaches the input
+	float time[SHAPER_HISTORY];				// time of the segment ending at each sample
+	float position[SHAPER_HISTORY][SHAPER_AXES];	// segment end points
+	mpShaperAxis_t a[SHAPER_AXES];
+} mpShaper_t;
+
+static mpShaper_t sh;
+
+static void _latch_shaper(void);
+static float _get_delayed_position(uint8_t axis, const float target);
+
+/*
+ * mp_shaper_reset() - restart the shaper at rest at a position
+ *
+ *	Called whenever the runtime position is set (see mp_set_steps_to_runtime_position()).
+ */
+
+void mp_shaper_reset(const float position[])
+{
+	sh.newest = 0;
+	sh.samples = 1;
+	sh.settle_time = 0;
+	sh.time[0] = 0;
+	for (uint8_t axis=0; axis<SHAPER_AXES; axis++) {
+		sh.position[0][axis] = position[axis];
+	}
+}
+
+/*
+ * mp_shaper_pending() - return true if the shaped output has not caught up with the input
+ */
+
+uint8_t mp_shaper_pending()
+{
+	return (sh.settle_time > 0);
+}
+
+/*
+ * mp_shape_segment() - shape the end point of a segment
+ *
+ *	Returns the target if there is nothing to shape, otherwise the shaped position
+ *	written to shaped[]. Unshaped axes are passed through. Called from the exec for
+ *	each segment before mr.position is advanced to the target.
+ */
+
+const float *mp_shape_segment(const float target[], float segment_time, float shaped[])
+{
+	uint8_t axis;
+
+	if (sh.settle_time <= 0) {						// idle - take up any new settings
+		_latch_shaper();
+		if (sh.active == false) {
+			return (target);
+		}
+		mp_shaper_reset(mr.position);				// the segment starts from rest
+	}
+	uint8_t moved = false;
+	uint8_t previous = sh.newest;
+	if (++sh.newest >= SHAPER_HISTORY) {
+		sh.newest = 0;
+	}
+	if (sh.samples < SHAPER_HISTORY) {
+		sh.samples++;
+	}
+	sh.time[sh.newest] = segment_time;
+	for (axis=0; axis<SHAPER_AXES; axis++) {
+		sh.position[sh.newest][axis] = target[axis];
+		if (target[axis] != sh.position[previous][axis]) {
+			moved = true;
+		}
+	}
+	if (moved == true) {
+		sh.settle_time = sh.span;
+	} else {
+		sh.settle_time -= segment_time;
+		if (sh.settle_time <= 0) {					// the output has caught up - land on the input exactly
+			return (target);
+		}
+	}
+	for (axis=0; axis<AXES; axis++) {
+		if ((axis < SHAPER_AXES) && (sh.a[axis].impulses != 0)) {
+			shaped[axis] = _get_delayed_position(axis, target[axis]);
+		} else {
+			shaped[axis] = target[axis];
+		}
+	}
+	return (shaped);
+}
+
+/*
+ * _get_delayed_position() - sum the impulses of one axis over the history
+ *
+ *	Walks back through the history once, as the delays are ascending. A delay that runs
+ *	past the oldest sample takes the oldest sample.
+ */
+
+static float _get_delayed_position(uint8_t axis, const float target)
+{
+	mpShaperAxis_t *s = &sh.a[axis];
+	float position = s->amplitude[0] * target;		// the first impulse has no delay
+	float back = 0;									// time from the newest sample back to sample k
+	uint8_t k = sh.newest;
+	uint8_t left = sh.samples - 1;					// samples older than k
+
+	for (uint8_t i=1; i<s->impulses; i++) {
+		while ((left > 0) && (back + sh.time[k] < s->delay[i])) {
+			back += sh.time[k];
+			k = (k == 0) ? (SHAPER_HISTORY - 1) : (k - 1);
+			left--;
+		}
+		if (left == 0) {
+			position += s->amplitude[i] * sh.position[k][axis];
+		} else {
+			uint8_t p = (k == 0) ? (SHAPER_HISTORY - 1) : (k - 1);
+			float fraction = (s->delay[i] - back) / sh.time[k];
+			position += s->amplitude[i] *
+				(sh.position[k][axis] + (sh.position[p][axis] - sh.position[k][axis]) * fraction);
+		}
+	}
+	return (position);
+}
+
+/*
+ * _latch_shaper() - compute the impulses from the axis settings
+ */
+
+static void _latch_shaper()
+{
+	sh.active = false;
+	sh.span = 0;
+	for (uint8_t axis=0; axis<SHAPER_AXES; axis++) {
+		cfgAxis_t *a = &cm.a[axis];
+		mpShaperAxis_t *s = &sh.a[axis];
+
+		s->impulses = 0;
+		if ((a->shaper_type == SHAPER_OFF) || (fp_ZERO(a->shaper_frequency)) ||
+			(cm.cycle_state == CYCLE_HOMING) || (cm.cycle_state == CYCLE_PROBE)) {
+			continue;
+		}
+		float root = sqrt(1 - square(a->shaper_damping));
+		float K = exp(-a->shaper_damping * M_PI / root);
+		float half_period = 0.5 / (a->shaper_frequency * root * 60);	// in minutes
+
+		s->delay[0] = 0;
+		s->delay[1] = half_period;
+		s->delay[2] = 2 * half_period;
+		if (a->shaper_type == SHAPER_ZV) {
+			s->impulses = 2;
+			s->amplitude[0] = 1 / (1 + K);
+			s->amplitude[1] = K / (1 + K);
+		} else if (a->shaper_type == SHAPER_ZVD) {
+			float D = square(1 + K);
+			s->impulses = 3;
+			s->amplitude[0] = 1 / D;
+			s->amplitude[1] = 2 * K / D;
+			s->amplitude[2] = K * K / D;
+		} else {
+			s->impulses = 3;
+			s->amplitude[0] = (1 + SHAPER_EI_VIBRATION) / 4;
+			s->amplitude[1] = (1 - SHAPER_EI_VIBRATION) / 2;
+			s->amplitude[2] = (1 + SHAPER_EI_VIBRATION) / 4;
+		}
+		sh.span = max(sh.span, s->delay[s->impulses - 1]);
+		sh.active = true;
+	}
+}
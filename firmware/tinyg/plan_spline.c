@@ -0,0 +1,307 @@
+//**************************************************************************************************
+/*
+ * plan_spline.c - G5 and G5.1 spline planning
+ * This file is part of the TinyG project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+//**************************************************************************************************
+
+//**************************************************************************************************
+/*
+ * Like plan_arc.c this module has a canonical machine part (cm_spline_feed()) and a motion
+ * planner part. The spline is turned into a cubic polynomial in X and Y and queued as a single
+ * move, or as line segments if the spline table is full.
+ *
+ *	G5   X Y I J P Q - cubic spline. I J is the offset of the 1st control point from the start
+ *		 point, P Q the offset of the 2nd control point from the end point. I and J may be left
+ *		 out on a G5 that follows a G5 - the 1st control point then mirrors the last 2nd one, so
+ *		 the curves join without a corner.
+ *	G5.1 X Y I J - quadratic spline. I J is the offset of the control point from the start point.
+ *		 It is raised to the cubic with the same curve.
+ *
+ *	Splines run in the G17 (XY) plane only and can't move any other axis.
+*/
+//**************************************************************************************************
+
+#include "tinyg.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "plan_spline.h"
+#include "util.h"
+
+// Allocate spline planner singleton structure
+
+spline_t spline;
+
+// Local functions
+static float _get_spline_time(float length);
+static void _init_spline_segments(float time);
+
+/*****************************************************************************
+ * Canonical Machining spline functions
+ *
+ * cm_spline_init()	    - initialize splines
+ * cm_spline_feed()	    - canonical machine entry point for G5 and G5.1
+ * cm_spline_callback() - main-loop callback for spline segment generation
+ * cm_abort_spline()    - stop a spline in process
+ */
+
+void cm_spline_init()
+{
+	spline.magic_start = MAGICNUM;
+	spline.magic_end = MAGICNUM;
+}
+
+//**************************************************************************************************
+/*
+ * cm_spline_feed() - canonical machine entry point for splines
+ *
+ *	The control points C1 and C2 and end points P0 and P3 of the Bezier curve give the
+ *	polynomial P(u) = P0 + 3(C1-P0)u + 3(P0-2C1+C2)u^2 + (P3-P0+3(C1-C2))u^3 for u = 0..1.
+ *	A quadratic with control point Q is the cubic with C1 = P0 + 2/3(Q-P0), C2 = P3 + 2/3(Q-P3).
+ *	The path length table is integrated once here for the planner and the runtime.
+*/
+//**************************************************************************************************
+
+stat_t cm_spline_feed(float target[], float flags[],		// spline end point
+					  float i, float j, float p, float q,	// raw control point offsets
+					  uint8_t motion_mode)					// G5 or G5.1
+{
+	bool offset_ij = (fp_NOT_ZERO(cm.gf.arc_offset[0]) || fp_NOT_ZERO(cm.gf.arc_offset[1]));
+	bool offset_pq = (fp_NOT_ZERO(cm.gf.parameter) || fp_NOT_ZERO(cm.gf.peck_depth));
+
+	// a block with no spline words in G5 mode (e.g. an M code) does not move
+	if (fp_ZERO(flags[AXIS_X]) && fp_ZERO(flags[AXIS_Y]) && (!offset_ij) && (!offset_pq))
+	{
+		for (uint8_t axis = AXIS_Z; axis < AXES; axis++)
+		{
+			if (fp_NOT_ZERO(flags[axis])) return (STAT_SPLINE_SPECIFICATION_ERROR);
+		}
+		return (STAT_OK);
+	}
+
+	// trap missing feed rate
+	if ((cm.gm.feed_rate_mode != INVERSE_TIME_MODE) && (fp_ZERO(cm.gm.feed_rate)))
+	{
+		return (STAT_GCODE_FEEDRATE_NOT_SPECIFIED);
+	}
+
+	// splines are only defined in the XY plane, and only move X and Y
+	if (cm.gm.select_plane != CANON_PLANE_XY)
+	{
+		return (STAT_SPLINE_SPECIFICATION_ERROR);
+	}
+	for (uint8_t axis = AXIS_Z; axis < AXES; axis++)
+	{
+		if (fp_NOT_ZERO(flags[axis]))
+		{
+			return (STAT_SPLINE_SPECIFICATION_ERROR);
+		}
+	}
+
+	float control_1[2] = { _to_millimeters(i), _to_millimeters(j) };
+	float control_2[2] = { _to_millimeters(p), _to_millimeters(q) };
+	cm_transform_vector(control_1);					// G68/G51 - control offsets follow the transform
+	cm_transform_vector(control_2);
+
+	if (motion_mode == MOTION_MODE_CUBIC_SPLINE)
+	{
+		// P and Q are required, I and J can follow on from the last cubic
+		if (fp_ZERO(cm.gf.parameter) || fp_ZERO(cm.gf.peck_depth))
+		{
+			return (STAT_SPLINE_SPECIFICATION_ERROR);
+		}
+		if (!offset_ij)
+		{
+			if (cm.gm.motion_mode != MOTION_MODE_CUBIC_SPLINE)
+			{
+				return (STAT_SPLINE_SPECIFICATION_ERROR);
+			}
+			control_1[0] = -spline.control[0];
+			control_1[1] = -spline.control[1];
+		}
+	}
+	else
+	{
+		// the quadratic needs its control point
+		if ((!offset_ij) || (offset_pq))
+		{
+			return (STAT_SPLINE_SPECIFICATION_ERROR);
+		}
+	}
+
+	// set values in the Gcode model state & copy it (linenum was already captured)
+	cm_set_model_target(target, flags);
+	cm.gm.motion_mode = motion_mode;
+	cm_set_work_offsets(&cm.gm);
+	memcpy(&spline.gm, &cm.gm, sizeof(GCodeState_t));
+
+	// control points in machine coordinates
+	float start[2] = { cm.gmx.position[AXIS_X], cm.gmx.position[AXIS_Y] };
+	float c_1[2], c_2[2];
+	for (uint8_t n=0; n<2; n++)
+	{
+		spline.end[n] = cm.gm.target[AXIS_X + n];
+		if (motion_mode == MOTION_MODE_CUBIC_SPLINE)
+		{
+			c_1[n] = start[n] + control_1[n];
+			c_2[n] = spline.end[n] + control_2[n];
+			spline.control[n] = control_2[n];
+		}
+		else
+		{
+			float control = start[n] + control_1[n];
+			c_1[n] = start[n] + (control - start[n]) * 2/3;
+			c_2[n] = spline.end[n] + (control - spline.end[n]) * 2/3;
+		}
+		spline.geometry.start[n] = start[n];
+		spline.geometry.coef[0][n] = 3 * (c_1[n] - start[n]);
+		spline.geometry.coef[1][n] = 3 * (start[n] - 2*c_1[n] + c_2[n]);
+		spline.geometry.coef[2][n] = spline.end[n] - start[n] + 3 * (c_1[n] - c_2[n]);
+	}
+
+	// path length table
+	float length = 0;
+	for (uint8_t k=0; k < SPLINE_LENGTH_SAMPLES; k++)
+	{
+		length += mp_get_spline_length(&spline.geometry, (float)k / SPLINE_LENGTH_SAMPLES,
+									   (float)(k+1) / SPLINE_LENGTH_SAMPLES);
+		spline.geometry.length[k] = length;
+	}
+	if (fp_ZERO(length))
+	{
+		// trap zero length splines - all four points in one place
+		return (STAT_MINIMUM_LENGTH_MOVE);
+	}
+	spline.gm.move_time = _get_spline_time(length);
+
+	// if not already started
+	cm_cycle_start();
+
+	// queue the spline as a single move if the spline table has room for it...
+	if (mp_get_spline_available() > 0)
+	{
+		stat_t status = mp_aspline(&spline.gm, &spline.geometry);
+		cm_finalize_move();
+		return (status);
+	}
+
+	// ...otherwise enable it to be run as segments from the callback
+	_init_spline_segments(spline.gm.move_time);
+	spline.run_state = MOVE_RUN;
+	cm_finalize_move();
+	return (STAT_OK);
+}
+
+/*
+ * cm_spline_callback() - generate a spline as line segments
+ *
+ *	Called from the controller main loop when a spline did not fit in the spline table. Each
+ *	call queues as many segments as it can before it blocks. The segments are equal steps in
+ *	the curve parameter, so the points are stepped on by forward differences - three adds per
+ *	axis and no multiplies. The last segment goes to the end point exactly.
+ */
+
+stat_t cm_spline_callback()
+{
+	if (spline.run_state == MOVE_OFF)
+		return (STAT_NOOP);
+
+	if (mp_get_planner_buffers_available() < PLANNER_BUFFER_HEADROOM)
+		return (STAT_EAGAIN);
+
+	for (uint8_t n=0; n<2; n++)
+	{
+		spline.point[n] += spline.delta_1[n];
+		spline.delta_1[n] += spline.delta_2[n];
+		spline.delta_2[n] += spline.delta_3[n];
+		spline.gm.target[AXIS_X + n] = (spline.segment_count == 1) ? spline.end[n] : spline.point[n];
+	}
+	mp_aline(&spline.gm);							// run the line
+
+	if (--spline.segment_count > 0)
+		return (STAT_EAGAIN);
+	spline.run_state = MOVE_OFF;
+	return (STAT_OK);
+}
+
+/*
+ * cm_abort_spline() - stop spline segment generation without maintaining position
+ *
+ *	OK to call if no spline is running
+ */
+
+void cm_abort_spline()
+{
+	spline.run_state = MOVE_OFF;
+}
+
+/*
+ * _get_spline_time() - move time of the spline at the requested feed rate
+ *
+ *	Like arcs, the time is not allowed to be less than the path length takes at the maximum
+ *	feed rate of the slower of X and Y.
+ */
+
+static float _get_spline_time(float length)
+{
+	float time;
+
+	if (cm.gm.feed_rate_mode == INVERSE_TIME_MODE) {
+		time = cm.gm.feed_rate;							// inverse feed rate has been normalized to minutes
+		cm.gm.feed_rate = 0;							// reset feed rate so next block requires an explicit feed rate setting
+		cm.gm.feed_rate_mode = UNITS_PER_MINUTE_MODE;
+	} else {
+		time = length / cm.gm.feed_rate;
+	}
+	time = max(time, length / cm.a[AXIS_X].feedrate_max);
+	time = max(time, length / cm.a[AXIS_Y].feedrate_max);
+	return (time);
+}
+
+/*
+ * _init_spline_segments() - set up the forward differences for the line segment fallback
+ *
+ *	A chord over a parameter step h deviates from the curve by at most h^2/8 * max|P''|, and
+ *	P'' is linear in u so its largest value is at one of the end points. The number of
+ *	segments is set by the chordal tolerance, then limited by the arc segment length ($ma)
+ *	and the minimum arc segment time the way arc segments are.
+ */
+
+static void _init_spline_segments(float time)
+{
+	const float (*c)[2] = spline.geometry.coef;
+	float length = spline.geometry.length[SPLINE_LENGTH_SAMPLES-1];
+	float bend = max(hypotf(2*c[1][0], 2*c[1][1]), hypotf(2*c[1][0] + 6*c[2][0], 2*c[1][1] + 6*c[2][1]));
+
+	float segments = 1;
+	if (bend > EPSILON) {
+		segments = ceil(1 / sqrt(8 * cm_get_chordal_tolerance() / bend));
+	}
+	float segments_for_minimum_distance = floor(length / cm.arc_segment_len);
+	float segments_for_minimum_time = floor(time * MICROSECONDS_PER_MINUTE / MIN_ARC_SEGMENT_USEC);
+	segments = max(min3(segments, segments_for_minimum_distance, segments_for_minimum_time), 1);
+
+	spline.segment_count = (uint32_t)segments;
+	spline.gm.move_time = time / segments;
+
+	float h = 1 / segments;
+	for (uint8_t n=0; n<2; n++) {
+		spline.point[n] = spline.geometry.start[n];
+		spline.delta_1[n] = h * (c[0][n] + h * (c[1][n] + h * c[2][n]));
+		spline.delta_2[n] = h * h * (2*c[1][n] + h * 6*c[2][n]);
+		spline.delta_3[n] = h * h * h * 6*c[2][n];
+	}
+}
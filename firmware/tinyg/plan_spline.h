@@ -0,0 +1,44 @@
+/*
+ * plan_spline.h - G5 and G5.1 spline planning
+ * This file is part of the TinyG project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAN_SPLINE_H_ONCE
+#define PLAN_SPLINE_H_ONCE
+
+// See planner.h for PLANNER_SPLINE_POOL_SIZE and the other spline #defines
+
+typedef struct spSplineSingleton {	// persistent planner variables
+	magic_t magic_start;
+	uint8_t run_state;				// MOVE_RUN while cm_spline_callback() queues line segments
+
+	float control[2];				// P and Q of the last cubic spline in mm (for I and J to follow it)
+	float end[2];					// X and Y of the spline end point
+	mpSpline_t geometry;			// coefficients and path length table of the spline being queued
+
+	uint32_t segment_count;			// line segments left to queue (table full fallback)
+	float point[2];					// forward differences of the curve for the line segments:
+	float delta_1[2];				// 1st
+	float delta_2[2];				// 2nd
+	float delta_3[2];				// 3rd (constant for a cubic)
+
+	GCodeState_t gm;				// Gcode state passed to the spline move or each of its segments
+
+	magic_t magic_end;
+} spline_t;
+extern spline_t spline;
+
+
+/* spline function prototypes */	// NOTE: See canonical_machine.h for cm_spline_feed() prototype
+
+void cm_spline_init(void);
+stat_t cm_spline_callback(void);
+void cm_abort_spline(void);
+
+#endif	// End of include guard: PLAN_SPLINE_H_ONCE
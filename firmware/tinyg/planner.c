@@ -53,13 +53,18 @@
  */
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "canonical_machine.h"
 #include "plan_arc.h"
 #include "planner.h"
+#include "plan_spline.h"
 #include "kinematics.h"
 #include "stepper.h"
 #include "encoder.h"
 #include "report.h"
+#include "hardware.h"
+#include "spindle.h"
+#include "network.h"
 #include "util.h"
 /*
 #ifdef __cplusplus
@@ -71,18 +76,25 @@ extern "C"{
 mpBufferPool_t mb;				// move buffer queue
 mpMoveMasterSingleton_t mm;		// context for line planning
 mpMoveRuntimeSingleton_t mr;	// context for line runtime
+mpJogRuntime_t mj;				// context for velocity jogs
+mpLiveConfig_t ml;				// motion settings for the runtime
 
 /*
  * Local Scope Data and Functions
  */
 #define _bump(a) ((a<PLANNER_BUFFER_POOL_SIZE-1)?(a+1):0) // buffer incr & wrap
 #define spindle_speed move_time	// local alias for spindle_speed to the time variable
-#define value_vector gm.target	// alias for vector of values
+#define value_vector target		// alias for vector of values
 #define flag_vector unit		// alias for vector of flags
 
 // execution routines (NB: These are all called from the LO interrupt)
 static stat_t _exec_dwell(mpBuf_t *bf);
+static stat_t _exec_spindle_wait(mpBuf_t *bf);
 static stat_t _exec_command(mpBuf_t *bf);
+static void _release_modal(mpBuf_t *bf);
+static void _release_arc(mpBuf_t *bf);
+static void _release_spline(mpBuf_t *bf);
+static void _release_command(mpBuf_t *bf);
 
 /*
  * planner_init()
@@ -92,6 +104,13 @@ void planner_init()
 // If you know all memory has been zeroed by a hard reset you don't need these next 2 lines
 	memset(&mr, 0, sizeof(mr));	// clear all values, pointers and status
 	memset(&mm, 0, sizeof(mm));	// clear all values, pointers and status
+	mr.feed_override = 1.0;
+	mr.traverse_override = 1.0;
+	mr.override_factor = 1.0;
+	mr.override_target = 1.0;
+	mr.adaptive_factor = 1.0;
+	mp_stage_live_config();		// the settings have been loaded by config_init()
+	mp_swap_live_config();
 	planner_init_assertions();
 	mp_init_buffers();
 }
@@ -99,6 +118,11 @@ void planner_init()
 /*
  * planner_init_assertions()
  * planner_test_assertions() - test assertions, return error code if violation exists
+ * planner_test_queue_assertions() - walk the buffer ring, return error code if it is damaged
+ *
+ *	The queue walk visits every planner buffer so it is one of the full assertions
+ *	(see _system_assertions()). The counts are not checked as the loader frees buffers
+ *	from interrupts.
  */
 void planner_init_assertions()
 {
@@ -116,6 +140,22 @@ stat_t planner_test_assertions()
 	return (STAT_OK);
 }
 
+#define _in_pool(b) (((b) >= mb.bf) && ((b) < &mb.bf[PLANNER_BUFFER_POOL_SIZE]))
+
+stat_t planner_test_queue_assertions()
+{
+	if (!_in_pool(mb.w) || !_in_pool(mb.q) || !_in_pool(mb.r)) return (STAT_PLANNER_ASSERTION_FAILURE);
+
+	for (mpBuf_t *bf = mb.bf; bf < &mb.bf[PLANNER_BUFFER_POOL_SIZE]; bf++) {
+		if (!_in_pool(bf->nx) || (bf->nx->pv != bf)) return (STAT_PLANNER_ASSERTION_FAILURE);
+		if (bf->buffer_state > MP_BUFFER_RUNNING) return (STAT_PLANNER_ASSERTION_FAILURE);
+		if ((bf->modal > PLANNER_MODAL_POOL_SIZE) || (bf->arc > PLANNER_ARC_POOL_SIZE) ||
+			(bf->spline > PLANNER_SPLINE_POOL_SIZE) ||
+			(bf->command > PLANNER_COMMAND_POOL_SIZE)) return (STAT_PLANNER_ASSERTION_FAILURE);
+	}
+	return (STAT_OK);
+}
+
 /*
  * mp_flush_planner() - flush all moves in the planner and all arcs
  *
@@ -123,14 +163,102 @@ stat_t planner_test_assertions()
  *	Does not affect mm or gm model positions
  *	This function is designed to be called during a hold to reset the planner
  *	This function should not generally be called; call cm_queue_flush() instead
+ *
+ *	The flush does not wipe and relink the pool like mp_init_buffers(). The ring links never
+ *	change, so the queue just restarts at the write pointer and the buffers left in it are
+ *	marked stale by bumping mb.generation. mp_get_write_buffer() clears a stale buffer when
+ *	the write pointer reaches it, which keeps the buffer under mb.w clean as it always is.
+ *	The buffer the queue restarts at and the one behind it are cleared now, the latter so
+ *	the backward planning pass and the command chainer stop at it. The tag wraps after 256 flushes, so that one rebuilds the pool.
  */
+static void _flush_buffers()
+{
+	if (++mb.generation == 0) {
+		mp_init_buffers();
+		return;
+	}
+	mpBuf_t *bf = mb.w;							// not clean if the queue was full
+	mp_clear_buffer(bf);
+	bf->generation = mb.generation;
+	mp_clear_buffer(bf->pv);
+	bf->pv->generation = mb.generation;
+	mb.q = bf;
+	mb.r = bf;
+	mb.buffers_available = PLANNER_BUFFER_POOL_SIZE;
+	controller_publish(TOPIC_BUFFER_FREE);
+
+	for (uint8_t i=0; i < PLANNER_MODAL_POOL_SIZE; i++) mb.modal[i].refcount = 0;
+	for (uint8_t i=0; i < PLANNER_ARC_POOL_SIZE; i++) mb.arc[i].refcount = 0;
+	for (uint8_t i=0; i < PLANNER_SPLINE_POOL_SIZE; i++) mb.spline[i].refcount = 0;
+	for (uint8_t i=0; i < PLANNER_COMMAND_POOL_SIZE; i++) mb.cmd[i].cm_func = NULL;
+	mb.raster_w = 0;
+	mb.raster_r = 0;
+	mb.raster_row = 0;
+	mb.prime_state = MP_PRIME_OFF;
+	mb.prime_timeout = 0;
+	mb.dry_run = false;
+	mb.dry_run_report = false;
+	mb.dry_run_moves = 0;
+	mb.dry_run_time = 0;
+}
+
 void mp_flush_planner()
 {
 	cm_abort_arc();
-	mp_init_buffers();
+	cm_abort_spline();
+	cm_abort_canned_cycle();
+	mp_discard_merged_line();
+	_flush_buffers();
+	mr.command = MP_COMMAND_NONE;				// the command table went with the buffers
+	mj.run = false;								// ...and so did any jog buffer
+	mr.raster_length = 0;						// ...and the pixels of any raster line
+	mr.split_count = 0;							// ...and the parts of a stretched segment
+	mr.split_parts = 0;
+	mm.command_barrier = false;
+	mm.segment_bf = NULL;						// ...and the last arc segment
 	cm_set_motion_state(MOTION_STOP);
 }
 
+/*
+ * mp_stage_live_config() - hand the current motion settings over to the runtime
+ * mp_swap_live_config()  - swap the staged settings in at a segment boundary (exec only)
+ *
+ *	The setters write cm.a and st_cfg directly, which is safe for the planner as it reads
+ *	them from the foreground and keeps what it needs in each buffer. The runtime must not
+ *	read them as a float written by the foreground can be caught half written. So the
+ *	settings the runtime uses are double buffered: the jerk and velocity limits for the
+ *	velocity jogs and the motor power levels (see st_prep_power()). A setter stages a copy into the set the
+ *	runtime is not reading and the exec swaps it in before it runs the next segment, so
+ *	these can be changed while a job or jog is moving.
+ *
+ *	Staging clears the pending flag before it reads which set is active and only sets it
+ *	once the copy is complete, so the exec never swaps in a set that is being written.
+ */
+
+void mp_stage_live_config()
+{
+	ml.pending = false;									// the exec may swap before this, not after
+	mpLiveSettings_t *set = &ml.set[ml.active ^ 1];
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		set->jerk_max[axis] = cm.a[axis].jerk_max;
+		set->velocity_max[axis] = cm.a[axis].velocity_max;
+	}
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		set->power_level[motor] = st_cfg.mot[motor].power_level_scaled;
+		set->power_boost[motor] = st_cfg.mot[motor].power_boost_scaled;
+		set->power_idle[motor] = st_cfg.mot[motor].power_idle_scaled;
+	}
+	ml.pending = true;
+}
+
+void mp_swap_live_config()
+{
+	if (ml.pending == false) return;
+	ml.active ^= 1;
+	ml.pending = false;
+	st_apply_power_levels();
+}
+
 /*
  * mp_set_planner_position() - set planner position for a single axis
  * mp_set_runtime_position() - set runtime position for a single axis
@@ -154,28 +282,76 @@ void mp_flush_planner()
  *	still close to the starting point.
  */
 
-void mp_set_planner_position(uint8_t axis, const float position) { mm.position[axis] = position; }
-void mp_set_runtime_position(uint8_t axis, const float position) { mr.position[axis] = position; }
+void mp_set_planner_position(uint8_t axis, const float position)
+{
+	mp_commit_merged_line();							// a held line starts from the old position
+	mm.comp_chain = false;								// ...and the next compensated line from the new one
+	mm.position[axis] = position;
+}
+
+void mp_set_runtime_position(uint8_t axis, const float position)
+{
+	mr.position[axis] = position;
+	mp_publish_runtime_snapshot_locked();
+}
+
+void mp_set_runtime_position_vector(const float position[])
+{
+	memcpy(mr.position, position, sizeof(mr.position));
+	mp_publish_runtime_snapshot_locked();
+}
 
 void mp_set_steps_to_runtime_position()
 {
 	float step_position[MOTORS];
-	ik_kinematics(mr.position, step_position);				// convert lengths to steps in floating point
+	float compensated[AXES];
+	mr.thc_offset = 0;									// the steps are taken from the model - drop the torch height offset
+	mr.pa_offset = 0;									// ...and the pressure advance
+	mr.retract_offset = 0;								// ...and the firmware retraction
+	mr.retract_target = 0;
+	const float *position = cm_grid_compensate(mr.position, compensated);
+	ik_kinematics(position, step_position);				// convert lengths to steps in floating point
+	net_send_position(position);						// network slaves take the same position
+	mp_shaper_reset(mr.position);						// the shaper restarts at rest at the new position
 	for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
-		mr.target_steps[motor] = step_position[motor];
-		mr.position_steps[motor] = step_position[motor];
-		mr.commanded_steps[motor] = step_position[motor];
-		en_set_encoder_steps(motor, step_position[motor]);	// write steps to encoder register
+		fstep_t steps = STEPS_TO_FSTEP(step_position[motor]);
+		mr.target_steps[motor] = steps;
+		mr.position_steps[motor] = steps;
+		mr.commanded_steps[motor] = steps;
+		en_set_encoder_steps(motor, FSTEP_TO_STEPS(steps));	// write steps to encoder register
 
 		// These must be zero:
 		mr.following_error[motor] = 0;
 		st_pre.mot[motor].corrected_steps = 0;
+		st_pre.mot[motor].correction_age = 255;			// no correction in flight
+		st_pre.mot[motor].step_offset = 0;			// the new position is where the motors are
+		for (uint8_t i=0; i<STEP_HISTORY_SIZE; i++) {
+			mr.step_history[i][motor] = steps;
+		}
 	}
+	mr.step_sample = en_read_encoders(mr.encoder_steps);	// restart the history at the current sample
+	mp_publish_runtime_snapshot_locked();				// the position may have been written directly
+}
+
+/*
+ * mp_get_steps() - get a fixed point runtime step position as steps (_ts1, _ps1, _cs1...)
+ */
+
+stat_t mp_get_steps(nvObj_t *nv)
+{
+	nv->value = FSTEP_TO_STEPS(*((fstep_t *)GET_TABLE_WORD(target)));
+	nv->precision = (int8_t)GET_TABLE_WORD(precision);
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
 }
 
 /************************************************************************************
  * mp_queue_command() - queue a synchronous Mcode, program control, or other command
+ * mp_queue_segment_command() - queue a command that does not need the machine to stop
+ * _chain_command()	  - chain a command to the last queued move or command buffer
  * _exec_command() 	  - callback to execute command
+ * mp_runtime_command() - run a command buffer and its chained commands (from the loader)
+ * mp_runtime_command_chain() - run the commands chained to a finished move (from the loader)
  *
  *	How this works:
  *	  - The command is called by the Gcode interpreter (cm_<command>, e.g. an M code)
@@ -192,12 +368,81 @@ void mp_set_steps_to_runtime_position()
  *	Doing it this way instead of synchronizing on queue empty simplifies the
  *	handling of feedholds, feed overrides, buffer flushes, and thread blocking,
  *	and makes keeping the queue full much easier - therefore avoiding Q starvation
+ *
+ *	Most commands sit between two moves, so a whole planner buffer is a lot to spend on
+ *	a callback and two vectors. If the last queued buffer is a move or command that has
+ *	not started running the command is put in the command table (mb.cmd[]) and chained
+ *	to that buffer instead. When the move finishes the exec stages the chain to the
+ *	loader (st_prep_command_chain()), which runs the commands in queued order at the same
+ *	point a command buffer would have run. The next move is still planned from a stop
+ *	(mm.command_barrier) so the machine behaves exactly as it does with command buffers.
+ *	Flags are stored as a bit per axis - the callbacks only test them for true/false.
+ *
+ *	Spindle and coolant commands are queued with mp_queue_segment_command(). If segment
+ *	commands are enabled ($sc=1) they are chained without the barrier, so the planner
+ *	carries the velocity through the command and it fires on the segment boundary at the
+ *	end of the move - e.g. laser or plasma on/off without a stop at each Mcode. If they
+ *	are disabled, or the command can't be chained, they behave as mp_queue_command().
+ *
+ *	Commands are dropped while a job resume is fast forwarding ($ff) - the skipped blocks
+ *	only set the model, and cm_fast_forward_resume() queues the state they leave.
  */
 
+static uint8_t _chain_command(cm_exec_t cm_exec, float *value, float *flag)
+{
+	mpBuf_t *bf = mb.q->pv;								// last committed buffer
+	uint8_t chained = false;
+
+#ifdef __AVR
+	cli();												// the exec and loader also walk the chains
+#endif
+	if (((bf->buffer_state == MP_BUFFER_QUEUED) || (bf->buffer_state == MP_BUFFER_PENDING)) &&
+		((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_ARC) ||
+		 (bf->move_type == MOVE_TYPE_SPLINE) || (bf->move_type == MOVE_TYPE_COMMAND))) {
+		for (uint8_t i=0; i < PLANNER_COMMAND_POOL_SIZE; i++) {
+			if (mb.cmd[i].cm_func != NULL) continue;
+			mpCommand_t *cmd = &mb.cmd[i];
+			cmd->cm_func = cm_exec;
+			cmd->flags = 0;
+			for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+				cmd->value[axis] = value[axis];
+				if (fp_TRUE(flag[axis])) cmd->flags |= (1 << axis);
+			}
+			cmd->next = MP_COMMAND_NONE;
+			uint8_t *link = &bf->command;				// append to the end of the chain
+			while (*link != MP_COMMAND_NONE) link = &mb.cmd[*link-1].next;
+			*link = i+1;
+			chained = true;
+			break;
+		}
+	}
+#ifdef __AVR
+	sei();
+#endif
+	return (chained);
+}
+
+void mp_queue_segment_command(void(*cm_exec)(float[], float[]), float *value, float *flag)
+{
+	if (cm.segment_commands == true) {
+		mp_commit_merged_line();
+		if (_chain_command(cm_exec, value, flag) == true) {
+			return;										// motion carries on through the command
+		}
+	}
+	mp_queue_command(cm_exec, value, flag);
+}
+
 void mp_queue_command(void(*cm_exec)(float[], float[]), float *value, float *flag)
 {
 	mpBuf_t *bf;
 
+	if (cm.ff_line != 0) return;						// fast forwarding - model only
+	mp_commit_merged_line();							// a held line must run before the command
+	if (_chain_command(cm_exec, value, flag) == true) {
+		mm.command_barrier = true;						// next move starts from a stop
+		return;
+	}
 	// Never supposed to fail as buffer availability was checked upstream in the controller
 	if ((bf = mp_get_write_buffer()) == NULL) {
 		cm_hard_alarm(STAT_BUFFER_FULL_FATAL);
@@ -221,14 +466,50 @@ static stat_t _exec_command(mpBuf_t *bf)
 	return (STAT_OK);
 }
 
+static void _run_command_chain(uint8_t command)
+{
+	float flag[AXES];
+
+	while (command != MP_COMMAND_NONE) {
+		mpCommand_t *cmd = &mb.cmd[command-1];
+		if (cmd->cm_func == NULL) break;				// table was reset by a queue flush
+		for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+			flag[axis] = (cmd->flags & (1 << axis)) ? 1.0 : 0.0;
+		}
+		cmd->cm_func(cmd->value, flag);
+		cmd->cm_func = NULL;							// free the entry
+		command = cmd->next;
+	}
+}
+
 stat_t mp_runtime_command(mpBuf_t *bf)
 {
 	bf->cm_func(bf->value_vector, bf->flag_vector);		// 2 vectors used by callbacks
-	if (mp_free_run_buffer())
+	_run_command_chain(bf->command);
+	bf->command = MP_COMMAND_NONE;
+	if (mp_free_run_buffer() && (mp_retract_pending() == false))
 		cm_cycle_end();									// free buffer & perform cycle_end if planner is empty
 	return (STAT_OK);
 }
 
+stat_t mp_runtime_command_chain(uint8_t command)
+{
+	_run_command_chain(command);
+	if ((mb.r->buffer_state == MP_BUFFER_EMPTY) && (mp_retract_pending() == false))
+		cm_cycle_end();									// perform the cycle_end the finished move deferred
+	return (STAT_OK);
+}
+
+static void _release_command(mpBuf_t *bf)
+{
+	uint8_t command = bf->command;
+	while (command != MP_COMMAND_NONE) {
+		mb.cmd[command-1].cm_func = NULL;
+		command = mb.cmd[command-1].next;
+	}
+	bf->command = MP_COMMAND_NONE;
+}
+
 /*************************************************************************
  * mp_dwell() 	 - queue a dwell
  * _exec_dwell() - dwell execution
@@ -241,11 +522,12 @@ stat_t mp_dwell(float seconds)
 {
 	mpBuf_t *bf;
 
+	mp_commit_merged_line();							// a held line must run before the dwell
 	if ((bf = mp_get_write_buffer()) == NULL)			// get write buffer or fail
 		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// not ever supposed to fail
 
 	bf->bf_func = _exec_dwell;							// register callback to dwell start
-	bf->gm.move_time = seconds;							// in seconds, not minutes
+	bf->move_time = seconds;							// in seconds, not minutes
 	bf->move_state = MOVE_NEW;
 	mp_commit_write_buffer(MOVE_TYPE_DWELL);			// must be final operation before exit
 	return (STAT_OK);
@@ -253,11 +535,107 @@ stat_t mp_dwell(float seconds)
 
 static stat_t _exec_dwell(mpBuf_t *bf)
 {
-	st_prep_dwell((uint32_t)(bf->gm.move_time * 1000000));// convert seconds to uSec
+	st_prep_dwell((uint32_t)(bf->move_time * 1000000));	// convert seconds to uSec
+	net_advance_clock(bf->move_time * 1000000);			// network slaves wait it out too
+	if (mp_free_run_buffer()) cm_cycle_end();			// free buffer & perform cycle_end if planner is empty
+	return (STAT_OK);
+}
+
+/*
+ * mp_spindle_wait() - queue a dwell that lasts until the spindle should be at speed
+ *
+ *	The loader works out how long it is when it gets to it (see cm_get_spindle_wait()).
+ */
+stat_t mp_spindle_wait()
+{
+	mpBuf_t *bf;
+
+	mp_commit_merged_line();
+	if ((bf = mp_get_write_buffer()) == NULL)			// get write buffer or fail
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// not ever supposed to fail
+
+	bf->bf_func = _exec_spindle_wait;
+	bf->move_state = MOVE_NEW;
+	mp_commit_write_buffer(MOVE_TYPE_DWELL);			// must be final operation before exit
+	return (STAT_OK);
+}
+
+static stat_t _exec_spindle_wait(mpBuf_t *bf)
+{
+	st_prep_spindle_wait();
 	if (mp_free_run_buffer()) cm_cycle_end();			// free buffer & perform cycle_end if planner is empty
 	return (STAT_OK);
 }
 
+/*************************************************************************
+ * mp_jog() - set the velocity jog targets (mm/min per axis, signed)
+ *
+ *	Queues a jog buffer if none is running (see mp_exec_jog()). Otherwise the new
+ *	targets take over from the next segment - nothing is replanned or flushed.
+ *	The caller must make sure the planner is otherwise empty.
+ */
+stat_t mp_jog(const float velocity[])
+{
+	mpBuf_t *bf;
+	uint8_t moving = false;
+
+#ifdef __AVR
+	cli();												// the exec reads the targets from the LO interrupt
+#endif
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		mj.target_velocity[axis] = velocity[axis];
+		if (fp_NOT_ZERO(velocity[axis])) moving = true;
+	}
+#ifdef __AVR
+	sei();
+#endif
+	if ((mj.run == true) || (moving == false)) return (STAT_OK);
+
+	if ((bf = mp_get_write_buffer()) == NULL)			// get write buffer or fail
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// not ever supposed to fail
+
+	mj.run = true;
+	bf->bf_func = mp_exec_jog;							// register callback to jog start
+	bf->move_state = MOVE_NEW;
+	mp_commit_write_buffer(MOVE_TYPE_JOG);				// must be final operation before exit
+	return (STAT_OK);
+}
+
+/*************************************************************************
+ * mp_spindle_sync() - queue a spindle synchronized move (G33, G33.1 - see mp_exec_sync())
+ *
+ *	The move takes a buffer of its own and is not velocity planned - the runtime follows
+ *	the spindle along it. The moves either side of it stop, as they do for a command
+ *	buffer. The pitch is in mm per revolution. A rigid tap (tap = TRUE) comes back to
+ *	where it started, so the planner position is left there.
+ */
+stat_t mp_spindle_sync(const GCodeState_t *gm_in, float pitch, uint8_t tap)
+{
+	mpBuf_t *bf;
+
+	mp_commit_merged_line();							// a held line must run before the move
+	float length = get_axis_vector_length(gm_in->target, mm.position);
+	if (length < EPSILON) return (STAT_MINIMUM_LENGTH_MOVE);
+
+	if ((bf = mp_get_write_buffer()) == NULL)			// get write buffer or fail
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// not ever supposed to fail
+	if (mp_set_buffer_gcode_state(bf, gm_in) != STAT_OK)
+		return(cm_hard_alarm(STAT_BUFFER_FULL_FATAL));	// modal headroom is checked upstream
+
+	for (uint8_t axis=0; axis<AXES; axis++) {
+		bf->unit[axis] = (gm_in->target[axis] - mm.position[axis]) / length;
+	}
+	bf->length = length;
+	bf->feed_rate = pitch;
+	bf->move_code = tap;
+	bf->bf_func = mp_exec_sync;							// register callback to the runtime
+	bf->move_state = MOVE_NEW;
+	if (tap == false) copy_vector(mm.position, bf->target);
+	mm.command_barrier = true;							// the next move starts from a stop
+	mp_commit_write_buffer(MOVE_TYPE_SYNC);				// must be final operation before exit
+	return (STAT_OK);
+}
+
 /**** PLANNER BUFFERS *****************************************************
  *
  * Planner buffers are used to queue and operate on Gcode blocks. Each buffer
@@ -280,8 +658,12 @@ static stat_t _exec_dwell(mpBuf_t *bf)
  *	(test, get and unget have no effect)
  *
  * mp_get_planner_buffers_available()   Returns # of available planner buffers
+ * mp_planner_has_headroom()	Returns true if a new input line that takes up to 'buffers' can be run
+ *							(buffer and modal headroom - see gc_block_headroom())
+ * mp_get_planner_queue_time()			Returns estimated time to run the queued buffers (ms)
  *
  * mp_init_buffers()		Initializes or resets buffers
+ *							(a flush restarts the queue instead - see mp_flush_planner())
  *
  * mp_get_write_buffer()	Get pointer to next available write buffer
  *							Returns pointer or NULL if no buffer available.
@@ -303,6 +685,9 @@ static stat_t _exec_dwell(mpBuf_t *bf)
  * mp_free_run_buffer()		Release the run buffer & return to buffer pool.
  *							Returns true if queue is empty, false otherwise.
  *							This is useful for doing queue empty / end move functions.
+ *							With $jp set the move's limit and replans go to the job profile.
+ *
+ * mp_get_cruise_limit(bf)	Returns what held a planned move below its cruise (see mpCruiseLimit)
  *
  * mp_get_prev_buffer(bf)	Returns pointer to prev buffer in linked list
  * mp_get_next_buffer(bf)	Returns pointer to next buffer in linked list
@@ -310,10 +695,285 @@ static stat_t _exec_dwell(mpBuf_t *bf)
  * mp_get_last_buffer(bf)	Returns pointer to last buffer, i.e. last block (zero)
  * mp_clear_buffer(bf)		Zeroes the contents of the buffer
  * mp_copy_buffer(bf,bp)	Copies the contents of bp into bf - preserves links
+ *							and keeps the modal table reference counts straight.
+ *							A command chain is not counted - it moves with the
+ *							contents, so the caller must drop one of the copies
  */
 
 uint8_t mp_get_planner_buffers_available(void) { return (mb.buffers_available);}
 
+uint8_t mp_planner_has_headroom(uint8_t buffers)
+{
+	return ((mb.buffers_available >= buffers) && (mp_get_modal_available() >= PLANNER_MODAL_HEADROOM));
+}
+
+/*
+ *	The queue time is summed from the planned velocities of the moves waiting to run and the
+ *	dwell times, so it tracks replanning. The move in the runtime is not counted - the result
+ *	is the motion time a sender can count on before the queue starves. Feed and traverse
+ *	overrides in effect are applied. It walks the queue, so call it from the main loop only.
+ */
+static float _get_section_time(float length, float v_0, float v_1)
+{
+	if (fp_ZERO(length) || fp_ZERO(v_0 + v_1)) return (0);
+	return ((2 * length) / (v_0 + v_1));		// constant acceleration is close enough for a time estimate
+}
+
+static float _get_move_time(mpBuf_t *bf)	// minutes, 0 if not a move
+{
+	if ((bf->move_type != MOVE_TYPE_ALINE) && (bf->move_type != MOVE_TYPE_ARC) &&
+		(bf->move_type != MOVE_TYPE_SPLINE)) return (0);
+	return (_get_section_time(bf->head_length, bf->entry_velocity, bf->cruise_velocity) +
+			_get_section_time(bf->body_length, bf->cruise_velocity, bf->cruise_velocity) +
+			_get_section_time(bf->tail_length, bf->cruise_velocity, bf->exit_velocity));
+}
+
+float mp_get_planner_queue_time(void)
+{
+	mpBuf_t *bf = mb.r;
+	float move_time = 0;						// minutes
+	float dwell_time = 0;						// seconds
+
+	for (uint8_t i=0; i < PLANNER_BUFFER_POOL_SIZE; i++) {
+		if ((bf->buffer_state == MP_BUFFER_EMPTY) || (bf->buffer_state == MP_BUFFER_LOADING)) {
+			break;								// the end of the queue
+		}
+		if (bf->buffer_state == MP_BUFFER_RUNNING) {
+			// not counted
+		} else if (bf->move_type == MOVE_TYPE_DWELL) {
+			dwell_time += bf->move_time;
+		} else {
+			move_time += _get_move_time(bf);
+		}
+		bf = bf->nx;
+	}
+	return ((move_time * 60000 / mr.override_factor) + (dwell_time * 1000));
+}
+
+/*
+ * mp_prime_start() - return true if the runtime may start the first move of a cycle
+ * mp_prime_callback() - controller callback to release the first move once the queue is primed
+ * mp_planner_is_priming() - return true if the first move of a cycle is waiting
+ *
+ *	When the machine is stopped the first move would otherwise start as soon as it is queued
+ *	and the blocks behind it would be planned against an almost empty queue. If priming is on
+ *	($pb or $pt non-zero) mp_exec_move() holds the first move of a machining cycle until $pb
+ *	buffers or $pt ms of motion are queued, the planner can't take another line, or the move
+ *	has waited $px ms - so short jobs and the last lines of a file still run.
+ *
+ *	mp_prime_start() runs in the exec (LO) interrupt and only flips the state. The queue time
+ *	walks the queue, so the test is done from the main loop, which then requests the exec.
+ */
+static uint8_t _planner_is_primed(void)
+{
+	if (mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false) return (true);
+	if ((cm.prime_buffers != 0) &&
+		((PLANNER_BUFFER_POOL_SIZE - mb.buffers_available) >= cm.prime_buffers)) return (true);
+	if ((cm.prime_time != 0) && (mp_get_planner_queue_time() >= cm.prime_time)) return (true);
+	return (false);
+}
+
+uint8_t mp_prime_start(void)
+{
+	if (mb.prime_state == MP_PRIME_RELEASED) {
+		mb.prime_state = MP_PRIME_OFF;
+		return (true);
+	}
+	if (((cm.prime_buffers == 0) && (cm.prime_time == 0)) || (cm.cycle_state != CYCLE_MACHINING)) {
+		return (true);
+	}
+	if (mb.prime_state == MP_PRIME_OFF) {
+		mb.prime_state = MP_PRIME_WAITING;
+		mb.prime_timeout = 0;					// started by the callback
+	}
+	return (false);
+}
+
+stat_t mp_prime_callback(void)
+{
+	if (mb.prime_state != MP_PRIME_WAITING) return (STAT_NOOP);
+	if (mb.prime_timeout == 0) {
+		mb.prime_timeout = SysTickTimer_getValue() + cm.prime_timeout;
+	}
+	if ((_planner_is_primed() == false) && (SysTickTimer_getValue() < mb.prime_timeout)) {
+		return (STAT_OK);
+	}
+	mb.prime_state = MP_PRIME_RELEASED;
+	st_request_exec_move();
+	return (STAT_OK);
+}
+
+uint8_t mp_planner_is_priming(void) { return (mb.prime_state == MP_PRIME_WAITING);}
+
+/*
+ * mp_dry_run_callback() - controller callback to retire planned buffers in a dry run
+ * mp_end_dry_run()		 - retire the rest of the queue and report the estimate
+ * mp_set_dry()			 - start ($dry=1) or end ($dry=0) a dry run
+ *
+ *	A dry run estimates a job's run time with the real planner. The Gcode streams through
+ *	mp_aline() and the planning chain as usual, but mp_exec_move() doesn't take buffers.
+ *	Instead this callback retires the oldest buffer whenever the planner has no headroom,
+ *	so each move is retired with the lookahead a streamed job would have when it ran. Its
+ *	planned head, body and tail times (or dwell time) are summed. The new oldest buffer is
+ *	made non-replannable, as the runtime would have started it. Commands are dropped unrun.
+ *
+ *	Program end (M2, M30) or $dry=0 ends the run. The rest of the queue is retired, the
+ *	model is put back at the machine position and a single line is sent:
+ *	  {"dry":{"mv":moves,"t":ms}}
+ *
+ *	The estimate is at 100% overrides, and from a primed start (see mp_prime_callback()).
+ *	Homing, probing and jogging wait on real motion and can't be dry run. A queue flush
+ *	cancels the dry run with no report.
+ */
+static void _retire_dry_run_buffer(void)
+{
+	mpBuf_t *bf = mb.r;
+	if (bf->move_type == MOVE_TYPE_DWELL) {
+		mb.dry_run_time += bf->move_time * 1000;
+	} else if ((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_ARC) ||
+			   (bf->move_type == MOVE_TYPE_SPLINE)) {
+		mb.dry_run_time += _get_move_time(bf) * 60000;
+		mb.dry_run_moves++;
+	}
+	mp_free_run_buffer();
+	if (mb.r->buffer_state != MP_BUFFER_EMPTY) {
+		mb.r->replannable = false;				// the runtime would be running it now
+	}
+}
+
+stat_t mp_dry_run_callback(void)
+{
+	if (mb.dry_run_report == true) {
+		if (rpt_tx_has_room(RPT_PRIORITY_MESSAGE) == false) return (STAT_NOOP);
+		printf_P(PSTR("{\"dry\":{\"mv\":%lu,\"t\":%0.0f}}\n"), mb.dry_run_moves, mb.dry_run_time);
+		mb.dry_run_report = false;
+	}
+	if (mb.dry_run == false) return (STAT_NOOP);
+	while ((mp_planner_has_headroom(PLANNER_BUFFER_HEADROOM) == false) && (mb.r->buffer_state != MP_BUFFER_EMPTY)) {
+		_retire_dry_run_buffer();
+	}
+	return (STAT_OK);
+}
+
+void mp_end_dry_run(void)
+{
+	if (mb.dry_run == false) return;
+	mp_commit_merged_line();
+	while (mb.r->buffer_state != MP_BUFFER_EMPTY) {
+		_retire_dry_run_buffer();
+	}
+	mb.dry_run = false;
+	mb.dry_run_report = true;
+	cm_set_position_to_runtime();						// nothing moved
+	cm_cycle_end();
+}
+
+stat_t mp_set_dry(nvObj_t *nv)
+{
+	if (fp_ZERO(nv->value)) {
+		mp_end_dry_run();
+	} else if (mb.dry_run == false) {
+		if (cm.machine_state == MACHINE_CYCLE) {
+			return (STAT_COMMAND_NOT_ACCEPTED);
+		}
+		mb.dry_run = true;
+		mb.dry_run_moves = 0;
+		mb.dry_run_time = 0;
+	}
+	nv->value = (float)mb.dry_run;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+/*
+ * mp_preview_callback() - controller callback to send the queue preview a move at a time
+ * mp_get_pvw()			 - start the preview ($pvw) and return the number of moves queued
+ *
+ *	The preview lets a host draw the upcoming path and speed profile. The queued moves and
+ *	dwells are sent oldest first, each as it is planned when it is sent:
+ *	  {"pvw":[line,x,y,z,a,b,c,ve,vc,vx,th,tb,tt]}
+ *	ve, vc and vx are the entry, cruise and exit velocities (mm/min) and th, tb and tt the
+ *	head, body and tail times (ms, at 100% overrides). A dwell has its time in tb. The
+ *	preview ends with {"pvw":{"n":moves sent}}. Chained commands are not sent.
+ *
+ *	One move is sent per pass, and only when the TX buffer has room, so the preview never
+ *	holds up planning. The queue keeps running and being replanned meanwhile, so the next
+ *	buffer to send is looked for in the queue each pass. If the runtime has passed it the
+ *	preview goes on from the oldest buffer still queued.
+ */
+static uint8_t _preview_sends(mpBuf_t *bf)
+{
+	return ((bf->move_type == MOVE_TYPE_ALINE) || (bf->move_type == MOVE_TYPE_ARC) ||
+			(bf->move_type == MOVE_TYPE_SPLINE) || (bf->move_type == MOVE_TYPE_DWELL));
+}
+
+static uint8_t _preview_is_queued(mpBuf_t *bf)
+{
+	return ((bf->buffer_state != MP_BUFFER_EMPTY) && (bf->buffer_state != MP_BUFFER_LOADING));
+}
+
+static float *_preview_target(mpBuf_t *bf)				// a dwell is where the move ahead of it ends
+{
+	while ((bf->move_type == MOVE_TYPE_DWELL) || (_preview_sends(bf) == false)) {
+		if (bf == mb.r) return (mr.position);
+		bf = bf->pv;
+	}
+	return (bf->target);
+}
+
+stat_t mp_preview_callback(void)
+{
+	if (mb.preview == false) return (STAT_NOOP);
+	if (rpt_tx_has_room(RPT_PRIORITY_MESSAGE) == false) return (STAT_NOOP);
+
+	mpBuf_t *bf = mb.r;
+	for (uint8_t i=0; (i < PLANNER_BUFFER_POOL_SIZE) && (bf != mb.preview_bf) && (_preview_is_queued(bf)); i++) {
+		bf = bf->nx;
+	}
+	if (bf != mb.preview_bf) bf = mb.r;					// the runtime has passed it
+	while ((_preview_is_queued(bf) == true) && (_preview_sends(bf) == false) && (bf->nx != mb.r)) {
+		bf = bf->nx;
+	}
+	if ((_preview_is_queued(bf) == false) || (_preview_sends(bf) == false)) {
+		printf_P(PSTR("{\"pvw\":{\"n\":%u}}\n"), mb.preview_sent);
+		mb.preview = false;
+		return (STAT_OK);
+	}
+	printf_P(PSTR("{\"pvw\":[%lu"), (unsigned long)bf->linenum);
+	float *target = _preview_target(bf);
+	for (uint8_t axis=0; axis < AXES; axis++) {
+		printf_P(PSTR(",%0.3f"), (double)target[axis]);
+	}
+	if (bf->move_type == MOVE_TYPE_DWELL) {
+		printf_P(PSTR(",0,0,0,0,%0.0f,0]}\n"), (double)(bf->move_time * 1000));
+	} else {
+		printf_P(PSTR(",%0.0f,%0.0f,%0.0f,%0.1f,%0.1f,%0.1f]}\n"),
+			(double)bf->entry_velocity, (double)bf->cruise_velocity, (double)bf->exit_velocity,
+			(double)(_get_section_time(bf->head_length, bf->entry_velocity, bf->cruise_velocity) * 60000),
+			(double)(_get_section_time(bf->body_length, bf->cruise_velocity, bf->cruise_velocity) * 60000),
+			(double)(_get_section_time(bf->tail_length, bf->cruise_velocity, bf->exit_velocity) * 60000));
+	}
+	mb.preview_sent++;
+	mb.preview_bf = bf->nx;
+	return (STAT_OK);
+}
+
+stat_t mp_get_pvw(nvObj_t *nv)
+{
+	uint8_t moves = 0;
+	mpBuf_t *bf = mb.r;
+	for (uint8_t i=0; (i < PLANNER_BUFFER_POOL_SIZE) && (_preview_is_queued(bf)); i++) {
+		if (_preview_sends(bf) == true) moves++;
+		bf = bf->nx;
+	}
+	mb.preview = true;									// a preview already running starts over
+	mb.preview_sent = 0;
+	mb.preview_bf = mb.r;
+	nv->value = (float)moves;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
 void mp_init_buffers(void)
 {
 	mpBuf_t *pv;
@@ -344,9 +1004,14 @@ mpBuf_t * mp_get_write_buffer() 				// get & clear a buffer
 		memset(mb.w, 0, sizeof(mpBuf_t));		// clear all values
 		w->nx = nx;								// restore pointers
 		w->pv = pv;
+		w->generation = mb.generation;
 		w->buffer_state = MP_BUFFER_LOADING;
 		mb.buffers_available--;
 		mb.w = w->nx;
+		if (mb.w->generation != mb.generation) {// left over from before a flush
+			mp_clear_buffer(mb.w);
+			mb.w->generation = mb.generation;
+		}
 		return (w);
 	}
 	rpt_exception(STAT_FAILED_TO_GET_PLANNER_BUFFER);
@@ -358,6 +1023,7 @@ void mp_unget_write_buffer()
 	mb.w = mb.w->pv;							// queued --> write
 	mb.w->buffer_state = MP_BUFFER_EMPTY; 		// not loading anymore
 	mb.buffers_available++;
+	controller_publish(TOPIC_BUFFER_FREE);
 }
 
 /*** WARNING: The routine calling mp_commit_write_buffer() must not use the write buffer
@@ -382,6 +1048,7 @@ mpBuf_t * mp_get_run_buffer()
 	if ((mb.r->buffer_state == MP_BUFFER_QUEUED) ||
 		(mb.r->buffer_state == MP_BUFFER_PENDING)) {
 		 mb.r->buffer_state = MP_BUFFER_RUNNING;
+		 controller_publish(TOPIC_MOVE_START);
 	}
 	// CASE: asking for the same run buffer for the Nth time
 	if (mb.r->buffer_state == MP_BUFFER_RUNNING) {	// return same buffer
@@ -392,6 +1059,13 @@ mpBuf_t * mp_get_run_buffer()
 
 uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 {
+	if (jp.profile_enable == true) {
+		jp_record_limit(mp_get_cruise_limit(mb.r), mb.r->replans, mb.r->cruise_velocity);
+	}
+	_release_modal(mb.r);						// drop the buffer's hold on its modal state
+	_release_arc(mb.r);							// ...and on its arc geometry
+	_release_spline(mb.r);						// ...or spline geometry
+	_release_command(mb.r);						// ...and any commands that were never run
 	mp_clear_buffer(mb.r);						// clear it out (& reset replannable)
 //	mb.r->buffer_state = MP_BUFFER_EMPTY;		// redundant after the clear, above
 	mb.r = mb.r->nx;							// advance to next run buffer
@@ -399,10 +1073,39 @@ uint8_t mp_free_run_buffer()					// EMPTY current run buf & adv to next
 		mb.r->buffer_state = MP_BUFFER_PENDING;	// pend next buffer
 	}
 	mb.buffers_available++;
+	controller_publish(TOPIC_MOVE_END | TOPIC_BUFFER_FREE);
 	qr_request_queue_report(-1);				// request a QR and add to the "removed buffers" count
 	return ((mb.w == mb.r) ? true : false); 	// return true if the queue emptied
 }
 
+/*
+ *	A move that reached its cruise_vmax was held by whatever set it when it was planned.
+ *	Otherwise it was too short to get there. That is a junction limit if it entered or left
+ *	at a corner velocity below both moves' cruise, and a length limit if it started or ended
+ *	at rest or was braking for the moves after it. Call it before the buffer is freed.
+ */
+uint8_t mp_get_cruise_limit(const mpBuf_t *bf)
+{
+	if ((bf->move_type != MOVE_TYPE_ALINE) && (bf->move_type != MOVE_TYPE_ARC) &&
+		(bf->move_type != MOVE_TYPE_SPLINE)) {
+		return (MP_LIMIT_NONE);
+	}
+	if (bf->cruise_velocity >= bf->cruise_vmax * MP_LIMIT_MATCH) {
+		return (bf->cruise_limit);
+	}
+	if ((bf->entry_vmax > 0) && (bf->entry_vmax < bf->cruise_vmax) &&
+		(bf->entry_velocity >= bf->entry_vmax * MP_LIMIT_MATCH)) {
+		return (MP_LIMIT_JUNCTION);
+	}
+	const mpBuf_t *nx = bf->nx;
+	if ((nx->buffer_state != MP_BUFFER_EMPTY) && (nx->entry_vmax > 0) &&
+		(nx->entry_vmax < min(bf->cruise_vmax, nx->cruise_vmax)) &&
+		(bf->exit_velocity >= nx->entry_vmax * MP_LIMIT_MATCH)) {
+		return (MP_LIMIT_JUNCTION);
+	}
+	return (MP_LIMIT_LENGTH);
+}
+
 mpBuf_t * mp_get_first_buffer(void)
 {
 	return(mp_get_run_buffer());	// returns buffer or NULL if nothing's running
@@ -427,18 +1130,337 @@ void mp_clear_buffer(mpBuf_t *bf)
 {
 	mpBuf_t *nx = bf->nx;			// save pointers
 	mpBuf_t *pv = bf->pv;
+	uint8_t generation = bf->generation;
 	memset(bf, 0, sizeof(mpBuf_t));
 	bf->nx = nx;					// restore pointers
 	bf->pv = pv;
+	bf->generation = generation;
 }
 
 void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp)
 {
 	mpBuf_t *nx = bf->nx;			// save pointers
 	mpBuf_t *pv = bf->pv;
+	_release_modal(bf);				// bf gives up its modal state and arc geometry...
+	_release_arc(bf);
+	_release_spline(bf);
  	memcpy(bf, bp, sizeof(mpBuf_t));
 	bf->nx = nx;					// restore pointers
 	bf->pv = pv;
+	if (bf->modal != MP_MODAL_NONE) {
+		mb.modal[bf->modal-1].refcount++;	// ...and shares bp's
+	}
+	if (bf->arc != MP_ARC_NONE) {
+		mb.arc[bf->arc-1].refcount++;
+	}
+	if (bf->spline != MP_SPLINE_NONE) {
+		mb.spline[bf->spline-1].refcount++;
+	}
+}
+
+/**** MODAL STATE TABLE ***************************************************
+ *
+ * Only the per-move part of the Gcode model (line number, target, move time,
+ * feed rate, motion mode) is carried in each planner buffer. The modal part
+ * (work offsets, spindle, tool, coolant, units, plane, path control...) rarely
+ * changes from one block to the next, so it is kept once in mb.modal[] and
+ * shared by every queued move that uses it. Entries are reference counted by
+ * the planner buffers that point to them and return to the pool when the last
+ * of those buffers is freed by the runtime.
+ *
+ * The modal part is everything in GCodeState_t from work_offset onwards, which
+ * lets it be compared and copied as a block (GM_MODAL_OFFSET, GM_MODAL_SIZE).
+ *
+ * mp_get_modal_available()		Returns # of free modal table entries. The controller
+ *								holds off new input if this drops below headroom.
+ *
+ * mp_set_buffer_gcode_state()	Load bf from a Gcode model. The modal part is matched
+ *								against the live table entries and shares one if it
+ *								can, otherwise it takes a free entry. Fails only if the
+ *								table is full, which headroom checking should prevent.
+ *
+ * mp_get_buffer_gcode_state()	Reassemble the full Gcode model for bf into gm_out.
+ *								Called by the runtime when it starts a move.
+ */
+
+uint8_t mp_get_modal_available(void)
+{
+	uint8_t available = 0;
+	for (uint8_t i=0; i < PLANNER_MODAL_POOL_SIZE; i++) {
+		if (mb.modal[i].refcount == 0) available++;
+	}
+	return (available);
+}
+
+stat_t mp_set_buffer_gcode_state(mpBuf_t *bf, const GCodeState_t *gm_in)
+{
+	const uint8_t *modal_in = (const uint8_t *)gm_in + GM_MODAL_OFFSET;
+	uint8_t free_entry = PLANNER_MODAL_POOL_SIZE;
+	uint8_t i;
+
+	bf->linenum = gm_in->linenum;
+	bf->motion_mode = gm_in->motion_mode;
+	copy_vector(bf->target, gm_in->target);
+	bf->move_time = gm_in->move_time;
+	bf->feed_rate = gm_in->feed_rate;
+	bf->raster_pixels = gm_in->raster_pixels;
+	bf->outputs_on = gm_in->outputs_on;
+	bf->outputs_off = gm_in->outputs_off;
+
+	for (i=0; i < PLANNER_MODAL_POOL_SIZE; i++) {
+		if (mb.modal[i].refcount == 0) {
+			if (free_entry == PLANNER_MODAL_POOL_SIZE) free_entry = i;
+			continue;
+		}
+		if (memcmp((uint8_t *)&mb.modal[i].gm + GM_MODAL_OFFSET, modal_in, GM_MODAL_SIZE) == 0) {
+			break;								// share an existing entry
+		}
+	}
+	if (i == PLANNER_MODAL_POOL_SIZE) {			// no match - take a free entry
+		if ((i = free_entry) == PLANNER_MODAL_POOL_SIZE) {
+			return (STAT_BUFFER_FULL_FATAL);
+		}
+		memcpy((uint8_t *)&mb.modal[i].gm + GM_MODAL_OFFSET, modal_in, GM_MODAL_SIZE);
+	}
+	mb.modal[i].refcount++;
+	bf->modal = i+1;
+	return (STAT_OK);
+}
+
+void mp_get_buffer_gcode_state(const mpBuf_t *bf, GCodeState_t *gm_out)
+{
+	if (bf->modal != MP_MODAL_NONE) {
+		memcpy((uint8_t *)gm_out + GM_MODAL_OFFSET, (uint8_t *)&mb.modal[bf->modal-1].gm + GM_MODAL_OFFSET, GM_MODAL_SIZE);
+	}
+	gm_out->linenum = bf->linenum;
+	gm_out->motion_mode = bf->motion_mode;
+	copy_vector(gm_out->target, bf->target);
+	gm_out->move_time = bf->move_time;
+	gm_out->feed_rate = bf->feed_rate;
+	gm_out->raster_pixels = bf->raster_pixels;
+	gm_out->outputs_on = bf->outputs_on;
+	gm_out->outputs_off = bf->outputs_off;
+}
+
+static void _release_modal(mpBuf_t *bf)
+{
+	if ((bf->modal != MP_MODAL_NONE) && (mb.modal[bf->modal-1].refcount > 0)) {
+		mb.modal[bf->modal-1].refcount--;
+	}
+	bf->modal = MP_MODAL_NONE;
+}
+
+/**** ARC GEOMETRY TABLE **************************************************
+ *
+ * An arc queued as a single move (MOVE_TYPE_ARC) needs its center, plane and
+ * rates to be generated by the runtime. Only a few arcs are in the queue at any
+ * time, so the geometry is kept in mb.arc[] rather than in every planner buffer.
+ * Entries are reference counted the same way as the modal table - a feedhold
+ * can copy an arc buffer to split it.
+ *
+ * mp_get_arc_available()	Returns # of free arc table entries. cm_arc_feed()
+ *							falls back to line segments if there are none.
+ *
+ * mp_set_buffer_arc()		Copy arc_in into a free entry and attach it to bf.
+ *							Fails only if the table is full.
+ */
+
+uint8_t mp_get_arc_available(void)
+{
+	uint8_t available = 0;
+	for (uint8_t i=0; i < PLANNER_ARC_POOL_SIZE; i++) {
+		if (mb.arc[i].refcount == 0) available++;
+	}
+	return (available);
+}
+
+stat_t mp_set_buffer_arc(mpBuf_t *bf, const mpArc_t *arc_in)
+{
+	for (uint8_t i=0; i < PLANNER_ARC_POOL_SIZE; i++) {
+		if (mb.arc[i].refcount == 0) {
+			memcpy(&mb.arc[i], arc_in, sizeof(mpArc_t));
+			mb.arc[i].refcount = 1;
+			bf->arc = i+1;
+			return (STAT_OK);
+		}
+	}
+	return (STAT_BUFFER_FULL_FATAL);
+}
+
+static void _release_arc(mpBuf_t *bf)
+{
+	if ((bf->arc != MP_ARC_NONE) && (mb.arc[bf->arc-1].refcount > 0)) {
+		mb.arc[bf->arc-1].refcount--;
+	}
+	bf->arc = MP_ARC_NONE;
+}
+
+/**** SPLINE GEOMETRY TABLE ***********************************************
+ *
+ * A G5 or G5.1 spline queued as a single move (MOVE_TYPE_SPLINE) keeps its curve
+ * coefficients and path length table in mb.spline[], reference counted like the
+ * arc table. A feedhold can split a spline buffer in two - both halves share the
+ * entry, and the runtime leaves in spline->travel where the next half starts.
+ *
+ * mp_get_spline_available()	Returns # of free spline table entries.
+ *							cm_spline_feed() falls back to line segments if there are none.
+ *
+ * mp_set_buffer_spline()	Copy spline_in into a free entry and attach it to bf.
+ *							Fails only if the table is full.
+ */
+
+uint8_t mp_get_spline_available(void)
+{
+	uint8_t available = 0;
+	for (uint8_t i=0; i < PLANNER_SPLINE_POOL_SIZE; i++) {
+		if (mb.spline[i].refcount == 0) available++;
+	}
+	return (available);
+}
+
+stat_t mp_set_buffer_spline(mpBuf_t *bf, const mpSpline_t *spline_in)
+{
+	for (uint8_t i=0; i < PLANNER_SPLINE_POOL_SIZE; i++) {
+		if (mb.spline[i].refcount == 0) {
+			memcpy(&mb.spline[i], spline_in, sizeof(mpSpline_t));
+			mb.spline[i].refcount = 1;
+			mb.spline[i].travel = 0;
+			bf->spline = i+1;
+			return (STAT_OK);
+		}
+	}
+	return (STAT_BUFFER_FULL_FATAL);
+}
+
+static void _release_spline(mpBuf_t *bf)
+{
+	if ((bf->spline != MP_SPLINE_NONE) && (mb.spline[bf->spline-1].refcount > 0)) {
+		mb.spline[bf->spline-1].refcount--;
+	}
+	bf->spline = MP_SPLINE_NONE;
+}
+
+/**** RASTER PIXEL POOL ***************************************************
+ *
+ * A raster line is a G1 that carries a row of pixel power values, so a photo
+ * can be engraved without a block per pixel. The host sends the row as hex
+ * pairs in one or more {"rst":"..."} lines, then the G1 the row is spread
+ * over. A whole row fits in one line, as a value too long for the input buffer
+ * is taken a piece at a time (see json_parse_chunk()). The line is not merged or blended, and the laser power of each pixel
+ * is its value/256 of the power the segment would have (see cm_get_laser_pwm()).
+ * The DDA interrupt steps through the pixels (see st_prep_raster()). Rows longer
+ * than RASTER_ROW_MAX are sent as several collinear lines.
+ *
+ * Pixels go into mb.raster[] in queue order. The loader moves the release index
+ * up as the steppers run past them, so the free count only grows as pixels are
+ * engraved. The host should keep the reply to $rst - the pixels still free - in
+ * mind rather than wait for STAT_BUFFER_FULL.
+ *
+ * mp_get_raster_available()	Returns # of free pixels.
+ *
+ * mp_get_raster_row()			Returns # of pixels written for the next line.
+ *
+ * mp_claim_raster_row()		Attach the row to the line being queued. Returns
+ *								the index of its first pixel.
+ *
+ * mp_discard_raster_row()		Drop a row no line has claimed - e.g. one whose
+ *								line was too short to plan.
+ *
+ * mp_cut_raster_row()			Cut the row back to the pixels it had - drops the
+ *								pieces of a long $rst value that failed part way.
+ */
+
+uint16_t mp_get_raster_available(void)
+{
+#ifdef __AVR
+	cli();
+#endif
+	uint16_t used = mb.raster_w - mb.raster_r;
+#ifdef __AVR
+	sei();
+#endif
+	return (PLANNER_RASTER_POOL_SIZE - used);
+}
+
+uint8_t mp_get_raster_row(void)
+{
+	return (mb.raster_row);
+}
+
+uint16_t mp_claim_raster_row(void)
+{
+	uint16_t base = mb.raster_w - mb.raster_row;
+	mb.raster_row = 0;
+	return (base);
+}
+
+void mp_discard_raster_row(void)
+{
+	mb.raster_w -= mb.raster_row;
+	mb.raster_row = 0;
+}
+
+void mp_cut_raster_row(uint8_t pixels)
+{
+	if (pixels < mb.raster_row) {
+		mb.raster_w -= mb.raster_row - pixels;
+		mb.raster_row = pixels;
+	}
+}
+
+/*
+ * mp_get_rst() - get the number of free pixels
+ * mp_set_rst() - add a string of hex pixel values to the next raster line
+ *
+ *	Raster lines only run in laser mode, so the pixels are refused otherwise. The reply
+ *	is the number of pixels still free.
+ */
+
+static int8_t _get_hex_digit(char_t c)
+{
+	if ((c >= '0') && (c <= '9')) return (c - '0');
+	if ((c >= 'a') && (c <= 'f')) return (c - 'a' + 10);
+	if ((c >= 'A') && (c <= 'F')) return (c - 'A' + 10);
+	return (-1);
+}
+
+stat_t mp_get_rst(nvObj_t *nv)
+{
+	nv->value = (float)mp_get_raster_available();
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t mp_set_rst(nvObj_t *nv)
+{
+	if (nv->valuetype != TYPE_STRING) {
+		return (STAT_BAD_NUMBER_FORMAT);
+	}
+	if (cm_get_laser_mode(PWM_1) == false) {		// pixels are PWM_1 only
+		return (STAT_COMMAND_NOT_ACCEPTED);
+	}
+	char_t *str = *nv->stringp;
+	uint16_t pixels = strlen(str) / 2;
+
+	if ((strlen(str) & 1) != 0) {
+		return (STAT_BAD_NUMBER_FORMAT);
+	}
+	if (mb.raster_row + pixels > RASTER_ROW_MAX) {
+		return (STAT_INPUT_EXCEEDS_MAX_VALUE);
+	}
+	if (pixels > mp_get_raster_available()) {
+		return (STAT_BUFFER_FULL);
+	}
+	for (uint16_t i=0; i<pixels; i++) {			// check it all before taking any of it
+		if ((_get_hex_digit(str[2*i]) < 0) || (_get_hex_digit(str[2*i+1]) < 0)) {
+			return (STAT_BAD_NUMBER_FORMAT);
+		}
+	}
+	for (uint16_t i=0; i<pixels; i++) {
+		mb.raster[mb.raster_w++ & PLANNER_RASTER_MASK] = (_get_hex_digit(str[2*i]) << 4) | _get_hex_digit(str[2*i+1]);
+	}
+	mb.raster_row += pixels;
+	return (mp_get_rst(nv));
 }
 
 /*
@@ -40,12 +40,16 @@ extern "C"{
 enum moveType {				// bf->move_type values
 	MOVE_TYPE_NULL = 0,		// null move - does a no-op
 	MOVE_TYPE_ALINE,		// acceleration planned line
+	MOVE_TYPE_ARC,			// acceleration planned arc or helix (see mp_aarc())
+	MOVE_TYPE_SPLINE,		// acceleration planned cubic spline (see mp_aspline())
 	MOVE_TYPE_DWELL,		// delay with no movement
 	MOVE_TYPE_COMMAND,		// general command
 	MOVE_TYPE_TOOL,			// T command
 	MOVE_TYPE_SPINDLE_SPEED,// S command
 	MOVE_TYPE_STOP,			// program stop
-	MOVE_TYPE_END			// program end
+	MOVE_TYPE_END,			// program end
+	MOVE_TYPE_JOG,			// velocity jog (see mp_jog())
+	MOVE_TYPE_SYNC			// spindle synchronized move (see mp_spindle_sync())
 };
 
 enum moveState {
@@ -71,17 +75,21 @@ enum sectionState {
 
 /*** Most of these factors are the result of a lot of tweaking. Change with caution.***/
 
-#define ARC_SEGMENT_LENGTH      ((float)0.1)		// Arc segment size (mm).(0.03)
+#define ARC_SEGMENT_LENGTH      ((float)0.1)		// minimum arc segment length (mm) - segment count is set by $ct
 #define MIN_ARC_RADIUS          ((float)0.1)
+#define ARC_CORRECTION_SEGMENTS 12					// arc points stepped by rotation between exact sin/cos resyncs
 
 #define JERK_MULTIPLIER         ((float)1000000)
 #define JERK_MATCH_PRECISION    ((float)1000)		// precision to which jerk must match to be considered effectively the same
 
-#define NOM_SEGMENT_USEC        ((float)5000)		// nominal segment time
+#define NOM_SEGMENT_USEC        ((float)5000)		// nominal segment time - used in head and tail sections
+#define BODY_SEGMENT_USEC       ((float)10000)		// nominal segment time in constant velocity body sections
+#define MAX_SEGMENT_USEC        BODY_SEGMENT_USEC	// longest segment the steppers take (sets DDA_SUBSTEPS) - longer ones are split
 #define MIN_SEGMENT_USEC        ((float)2500)		// minimum segment time / minimum move time
 #define MIN_ARC_SEGMENT_USEC    ((float)10000)		// minimum arc segment time
 
 #define NOM_SEGMENT_TIME        (NOM_SEGMENT_USEC / MICROSECONDS_PER_MINUTE)
+#define MAX_SEGMENT_TIME        (MAX_SEGMENT_USEC / MICROSECONDS_PER_MINUTE)
 #define MIN_SEGMENT_TIME        (MIN_SEGMENT_USEC / MICROSECONDS_PER_MINUTE)
 #define MIN_ARC_SEGMENT_TIME    (MIN_ARC_SEGMENT_USEC / MICROSECONDS_PER_MINUTE)
 #define MIN_TIME_MOVE           MIN_SEGMENT_TIME 	// minimum time a move can be is one segment
@@ -89,30 +97,150 @@ enum sectionState {
 
 #define MIN_SEGMENT_TIME_PLUS_MARGIN ((MIN_SEGMENT_USEC+1) / MICROSECONDS_PER_MINUTE)
 
-/* PLANNER_STARTUP_DELAY_SECONDS
- *	Used to introduce a short dwell before planning an idle machine.
+#define FEED_OVERRIDE_MIN		((float)0.10)	// runtime feed and traverse override limits (M50.1, M50.3)
+#define FEED_OVERRIDE_MAX		((float)2.00)
+#define FEED_OVERRIDE_RAMP_SEGMENTS	20			// segments to ramp to a new override factor (~100 ms)
+#define ADAPTIVE_FEED_RAMP_SEGMENTS	20			// segments the adaptive feed takes to close a load error (~100 ms)
+#define ADAPTIVE_FEED_RATE_MAX	((float)0.02)	// max adaptive feed factor change per segment
+#define ADAPTIVE_FEED_RATE_STEP	((float)0.002)	// max change of that rate per segment - the jerk limit
+
+#define LINE_MERGE_HOLD_DEPTH	8			// hold a line for merging only if this many buffers are queued
+#define BLEND_SEGMENTS_MIN		2			// lines per blended corner (must be even, see plan_line.c)
+#define BLEND_SEGMENTS_MAX		4			// lines per blended corner sharper than BLEND_SHARP_COSINE
+#define BLEND_SHARP_COSINE		0.7071		// cosine of the direction change above which a corner is sharp (45 deg)
+#define BLEND_STRAIGHT_COSINE	0.99999		// direction changes smaller than this are not blended
+#define BLEND_REVERSAL_COSINE	-0.99		// reversals are not blended - they come to a stop
+
+#define CUTTER_COMP_HOLD_LINES	3			// lines held for cutter compensation: an XY line and the Z lines after it
+#define CUTTER_COMP_MITER_LIMIT	2			// outside corners reaching further than this x radius are chamfered
+#define CUTTER_COMP_PARALLEL	((float)0.0001)	// sine of the direction change below which lines are parallel
+#define CUTTER_COMP_HOLD_MS		100			// ms a compensated line waits for the next line once the queue is empty
+
+#define QUEUE_GOVERNOR_MIN_FACTOR	0.25	// the queue governor ($qg) slows feeds down to no less than this
+
+/* Planner priming ($pb, $pt, $px)
+ *	Used to introduce a short wait before an idle machine starts moving.
  *  If you don't do this the first block will always plan to zero as it will
  *	start executing before the next block arrives from the serial port.
  *	This causes the machine to stutter once on startup.
+ *	See mp_prime_callback() - the settings are in settings.h
  */
-//#define PLANNER_STARTUP_DELAY_SECONDS ((float)0.05)	// in seconds
 
 /* PLANNER_BUFFER_POOL_SIZE
  *	Should be at least the number of buffers requires to support optimal
  *	planning in the case of very short lines or arc segments.
  *	Suggest 12 min. Limit is 255
+ *
+ *	Buffers only carry the per-move part of the Gcode model; the modal part is
+ *	held in the modal table (below), which is what makes room for a deeper queue.
+ */
+#ifdef __AVR
+#define PLANNER_BUFFER_POOL_SIZE 48
+#else
+#define PLANNER_BUFFER_POOL_SIZE 64
+#endif
+#define PLANNER_BUFFER_HEADROOM 4			// buffers to reserve in planner before processing a line that may expand
+											// (plain line moves reserve less - see mp_get_line_headroom())
+
+/* PLANNER_MODAL_POOL_SIZE
+ *	Number of distinct Gcode modal states (offsets, spindle, tool, coolant, modes...)
+ *	that can be referenced by queued moves at any one time. Moves that share modal
+ *	state share a table entry, so this only has to cover the number of modal changes
+ *	in flight, not the number of moves. Values that change from line to line (S, P)
+ *	are kept out of the modal part of GCodeState_t so they don't use up entries.
+ *	Limit is 254.
+ */
+#define PLANNER_MODAL_POOL_SIZE 8
+#define PLANNER_MODAL_HEADROOM 2			// modal entries to reserve before processing new input line
+#define MP_MODAL_NONE 0						// bf->modal value for buffers that carry no modal state
+
+/* PLANNER_ARC_POOL_SIZE
+ *	Number of arcs that can be queued as single moves at any one time. Their geometry
+ *	is kept in mb.arc[] so ordinary lines don't pay for it. Arcs that find the table
+ *	full are run as line segments instead (see cm_arc_feed()). Limit is 254.
+ */
+#ifdef __AVR
+#define PLANNER_ARC_POOL_SIZE 4
+#else
+#define PLANNER_ARC_POOL_SIZE 8
+#endif
+#define MP_ARC_NONE 0						// bf->arc value for buffers that are not arcs
+
+/* PLANNER_SPLINE_POOL_SIZE
+ *	Number of G5/G5.1 splines that can be queued as single moves at any one time, kept in
+ *	mb.spline[] the same way as arcs. Splines that find the table full are run as line
+ *	segments instead (see cm_spline_feed()). Limit is 254.
+ *
+ *	SPLINE_LENGTH_SAMPLES is the number of equal parameter intervals the path length table
+ *	of a spline is kept for. The runtime finds the curve parameter for a path length from it.
+ *	SPLINE_CURVATURE_SAMPLES is the number of intervals the planner samples the curvature at.
+ */
+#ifdef __AVR
+#define PLANNER_SPLINE_POOL_SIZE 2
+#else
+#define PLANNER_SPLINE_POOL_SIZE 12
+#endif
+#define MP_SPLINE_NONE 0					// bf->spline value for buffers that are not splines
+#define SPLINE_LENGTH_SAMPLES 4
+#define SPLINE_CURVATURE_SAMPLES 16
+#define SPLINE_NEWTON_ITERATIONS 2			// refinement steps finding the parameter for a path length
+
+/* PLANNER_COMMAND_POOL_SIZE
+ *	Number of synchronous commands (Mcodes etc.) that can ride on queued buffers at any
+ *	one time. A command queued behind a move is chained to that move's buffer and runs
+ *	when the move finishes, so it does not take a planner buffer of its own. Commands
+ *	that find the table full get a full planner buffer instead (see mp_queue_command()).
+ *	Limit is 254.
+ */
+#ifdef __AVR
+#define PLANNER_COMMAND_POOL_SIZE 8
+#else
+#define PLANNER_COMMAND_POOL_SIZE 16
+#endif
+#define MP_COMMAND_NONE 0					// bf->command value for buffers that carry no commands
+
+/* PLANNER_RASTER_POOL_SIZE
+ *	Number of pixel power values that can be queued for raster lines. A row of up to
+ *	RASTER_ROW_MAX pixels is sent ahead of the G1 that engraves it ($rst) and stays in
+ *	mb.raster[] until the steppers have run past it (see mp_set_rst()). Power of 2.
+ */
+#ifdef __AVR
+#define PLANNER_RASTER_POOL_SIZE 256
+#else
+#define PLANNER_RASTER_POOL_SIZE 1024
+#endif
+#define PLANNER_RASTER_MASK (PLANNER_RASTER_POOL_SIZE-1)
+#define RASTER_ROW_MAX 255					// most pixels one line can carry
+
+/* SHAPER_HISTORY
+ *	Number of segment end points the input shaper keeps (see plan_shaper.c). It must
+ *	cover the longest shaper - one damped period at SHAPER_MIN_FREQUENCY and
+ *	SHAPER_MAX_DAMPING - in MIN_SEGMENT_TIME segments. Limit is 255.
+ */
+#define SHAPER_HISTORY 32
+#define SHAPER_AXES 3						// X, Y and Z can be shaped
+#define SHAPER_IMPULSES 3					// most impulses of any shaper type
+#define SHAPER_MIN_FREQUENCY ((float)15)	// Hz
+#define SHAPER_MAX_DAMPING ((float)0.3)
+#define SHAPER_EI_VIBRATION ((float)0.05)	// residual vibration the EI shaper allows
+
+/* STEP_HISTORY_SIZE
+ *	Number of line segment targets kept to line the encoder readings up with (see
+ *	_prep_segment()). It must exceed the segments the loader can be behind the exec -
+ *	PREP_RING_SIZE plus the one running. Power of 2.
  */
-#define PLANNER_BUFFER_POOL_SIZE 32
-#define PLANNER_BUFFER_HEADROOM 4			// buffers to reserve in planner before processing new input line
+#define STEP_HISTORY_SIZE 8
+#define STEP_HISTORY_MASK (STEP_HISTORY_SIZE-1)
+
+#define GM_MODAL_OFFSET offsetof(GCodeState_t, work_offset)	// start of the modal part of GCodeState_t
+#define GM_MODAL_SIZE (sizeof(GCodeState_t) - GM_MODAL_OFFSET)	// size of the modal part of GCodeState_t
 
 /* Some parameters for _generate_trapezoid()
- * TRAPEZOID_ITERATION_MAX	 				Max iterations for convergence in the HT asymmetric case.
- * TRAPEZOID_ITERATION_ERROR_PERCENT		Error percentage for iteration convergence. As percent - 0.01 = 1%
+ * TRAPEZOID_NEWTON_ITERATIONS	 			Fixed Newton-Raphson iterations for the HT asymmetric case.
  * TRAPEZOID_LENGTH_FIT_TOLERANCE			Tolerance for "exact fit" for H and T cases
  * TRAPEZOID_VELOCITY_TOLERANCE				Adaptive velocity tolerance term
  */
-#define TRAPEZOID_ITERATION_MAX				10
-#define TRAPEZOID_ITERATION_ERROR_PERCENT	((float)0.10)
+#define TRAPEZOID_NEWTON_ITERATIONS			2
 #define TRAPEZOID_LENGTH_FIT_TOLERANCE		((float)0.0001)	// allowable mm of error in planning phase
 #define TRAPEZOID_VELOCITY_TOLERANCE		(max(2,bf->entry_velocity/100))
 
@@ -122,6 +250,28 @@ enum sectionState {
 
 typedef void (*cm_exec_t)(float[], float[]);	// callback to canonical_machine execution function
 
+#ifdef __FIXED_FORWARD_DIFFS
+typedef int64_t fdiff_t;						// Q32.32 forward differences (see plan_exec.c)
+#define FD_ONE 4294967296.0						// 1.0 in Q32.32
+#else
+typedef float fdiff_t;
+#endif
+
+#ifdef __APPROX_MATH
+#define mp_sqrt(x) fast_sqrt(x)					// table seeded Newton kernels (see util.c)
+#define mp_cbrt(x) fast_cbrt(x)
+#define mp_recip(x) fast_recip(x)
+#else
+#define mp_sqrt(x) sqrt(x)
+#define mp_cbrt(x) cbrt(x)
+#define mp_recip(x) (1/(x))
+#endif
+
+typedef int32_t fstep_t;						// Q24.8 fixed point steps (see _prep_segment())
+#define FSTEP_ONE 256.0							// 1 step in Q24.8
+#define STEPS_TO_FSTEP(s) ((fstep_t)lround((s) * FSTEP_ONE))
+#define FSTEP_TO_STEPS(q) ((float)(q) * (1/FSTEP_ONE))
+
 /*
  *	Planner structures
  */
@@ -136,6 +286,35 @@ enum mpBufferState {				// bf->buffer_state values
 	MP_BUFFER_RUNNING				// current running buffer
 };
 
+enum mpCruiseLimit {				// bf->cruise_limit values - what held a move below its cruise (see mp_get_cruise_limit())
+	MP_LIMIT_NONE = 0,				// not a planned move (MUST BE 0)
+	MP_LIMIT_FEED,					// cruised at the programmed feed rate
+	MP_LIMIT_VMAX,					// an axis velocity or step rate, an arc's centripetal limit or the queue governor
+	MP_LIMIT_JUNCTION,				// too short to reach cruise between its corner velocities
+	MP_LIMIT_LENGTH					// too short to reach cruise between stops, or braking for the moves after it
+};
+#define MP_LIMITS 4					// limits other than MP_LIMIT_NONE
+#define MP_LIMIT_MATCH 0.999		// a velocity within 0.1% of a limit is held by it
+
+enum mpPrimeState {					// mb.prime_state values
+	MP_PRIME_OFF = 0,				// runtime may start the next move (MUST BE 0)
+	MP_PRIME_WAITING,				// first move of a cycle is waiting for the queue to fill
+	MP_PRIME_RELEASED				// queue is primed (or timed out) - start the move
+};
+
+enum mpShaperType {					// cm.a[axis].shaper_type values
+	SHAPER_OFF = 0,					// axis is not shaped
+	SHAPER_ZV,						// zero vibration - 2 impulses over half a period
+	SHAPER_ZVD,						// zero vibration and derivative - 3 impulses over a period
+	SHAPER_EI						// extra insensitive - 3 impulses over a period
+};
+
+enum mpSyncState {					// mr.sync_state values (see mp_exec_sync())
+	SYNC_WAIT = 0,					// waiting for the spindle to pass its index
+	SYNC_RUN,						// following the spindle along the line
+	SYNC_RETRACT					// rigid tap: following the reversed spindle back out
+};
+
 typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	struct mpBuffer *pv;			// static pointer to previous buffer
 	struct mpBuffer *nx;			// static pointer to next buffer
@@ -143,12 +322,19 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	cm_exec_t cm_func;				// callback to canonical machine execution function
 
 	float   naive_move_time;
+	float zoid_entry;				// velocities the trapezoid was last computed for (see mp_calculate_trapezoid())
+	float zoid_cruise;				// ...requested cruise; 0 if there is no trapezoid to reuse
+	float zoid_exit;
+	float zoid_cruise_velocity;		// cruise velocity that trapezoid achieved
 
 	uint8_t buffer_state;			// used to manage queuing/dequeuing
+	uint8_t generation;				// flush it was last cleared in - stale if not mb.generation (see mp_flush_planner())
 	uint8_t move_type;				// used to dispatch to run routine
 	uint8_t move_code;				// byte that can be used by used exec functions
 	uint8_t move_state;				// move state machine sequence
 	uint8_t replannable;			// TRUE if move can be re-planned
+	uint8_t replans;				// times the move was replanned after it was queued (saturates at 255)
+	uint8_t cruise_limit;			// what set cruise_vmax - MP_LIMIT_FEED or MP_LIMIT_VMAX ($jp only)
 
 	float unit[AXES];				// unit vector for axis scaling & planning
 
@@ -163,6 +349,7 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 
 	float entry_vmax;				// max junction velocity at entry of this move
 	float cruise_vmax;				// max cruise velocity requested for move
+	float override_vmax;			// fastest cruise an override may take the move to (see _set_override_vmax())
 	float exit_vmax;				// max exit velocity possible (redundant)
 	float delta_vmax;				// max velocity difference for this move
 	float braking_velocity;			// current value for braking velocity
@@ -172,17 +359,79 @@ typedef struct mpBuffer {			// See Planning Velocity Notes for variable usage
 	float recip_jerk;				// 1/Jm used for planning (computed and cached)
 	float cbrt_jerk;				// cube root of Jm used for planning (computed and cached)
 
-	GCodeState_t gm;				// Gode model state - passed from model, used by planner and runtime
+	// per-move part of the Gcode model state (see GCodeState_t)
+	uint32_t linenum;				// Gcode block line number
+	uint8_t motion_mode;			// motion mode the move was issued in
+	uint8_t modal;					// 1-based index of the modal state in mb.modal[], or MP_MODAL_NONE
+	uint8_t arc;					// 1-based index of the arc geometry in mb.arc[], or MP_ARC_NONE
+	uint8_t spline;					// 1-based index of the spline geometry in mb.spline[], or MP_SPLINE_NONE
+	uint8_t command;				// 1-based index of the first chained command in mb.cmd[], or MP_COMMAND_NONE
+	uint8_t raster_pixels;			// number of pixels of a raster line; 0 for other moves
+	uint8_t outputs_on;				// M62, M63 outputs switched as the move starts (see cm_sync_output())
+	uint8_t outputs_off;
+	uint16_t raster_base;			// index of the first pixel of a raster line in mb.raster[]
+	float target[AXES];				// XYZABC where the move should go
+	float move_time;				// optimal time for move (minutes); dwell time (seconds)
+	float feed_rate;				// F - normalized to millimeters/minute or in inverse time mode; mm/rev for MOVE_TYPE_SYNC
 
 } mpBuf_t;
 
+typedef struct mpModal {			// modal Gcode state shared by queued planner buffers
+	uint8_t refcount;				// number of planner buffers referencing the entry; 0 = free
+	GCodeState_t gm;				// only the modal values (work_offset onwards) are meaningful
+} mpModal_t;
+
+typedef struct mpArc {				// geometry of a queued arc or helix (MOVE_TYPE_ARC)
+	uint8_t refcount;				// number of planner buffers referencing the entry; 0 = free
+	uint8_t plane_axis_0;			// arc plane axis 0 - e.g. X for G17
+	uint8_t plane_axis_1;			// arc plane axis 1 - e.g. Y for G17
+	uint8_t linear_axis;			// linear axis (normal to arc plane)
+	float center_0;					// center of arc - plane axis 0
+	float center_1;					// center of arc - plane axis 1
+	float angular_rate;				// radians of angular travel per mm of path
+	float linear_rate;				// mm of linear axis travel per mm of path
+} mpArc_t;
+
+typedef struct mpSpline {			// geometry of a queued cubic spline in the XY plane (MOVE_TYPE_SPLINE)
+	uint8_t refcount;				// number of planner buffers referencing the entry; 0 = free
+	float start[2];					// X and Y of the start point - P(0)
+	float coef[3][2];				// P(u) = start + coef[0]*u + coef[1]*u^2 + coef[2]*u^3, u = 0..1
+	float length[SPLINE_LENGTH_SAMPLES];// path length from the start to u = (i+1)/SPLINE_LENGTH_SAMPLES
+	float travel;					// path length the next buffer of the spline starts at (see mp_exec_aline())
+} mpSpline_t;
+
+typedef struct mpCommand {			// synchronous command chained to a queued planner buffer
+	cm_exec_t cm_func;				// callback to canonical machine execution function; NULL = free
+	float value[AXES];				// values passed to the callback
+	uint8_t flags;					// flags passed to the callback - one bit per axis
+	uint8_t next;					// 1-based index of the next command in the chain, or MP_COMMAND_NONE
+} mpCommand_t;
+
 typedef struct mpBufferPool {		// ring buffer for sub-moves
 	magic_t magic_start;			// magic number to test memory integrity
 	uint8_t buffers_available;		// running count of available buffers
+	uint8_t generation;				// bumped by each flush; buffers tagged otherwise are left over
+	uint8_t prime_state;			// see mp_prime_callback()
+	uint32_t prime_timeout;			// SysTick value at which a waiting first move is started anyway
+	uint8_t dry_run;				// $dry - plan only, buffers are retired unrun (see mp_dry_run_callback())
+	uint8_t dry_run_report;			// TRUE to send the dry run estimate
+	uint32_t dry_run_moves;			// moves retired in the dry run
+	float dry_run_time;				// motion and dwell time of the moves retired in the dry run (ms)
+	uint8_t preview;				// TRUE while the queue preview is sent (see mp_preview_callback())
+	uint16_t preview_sent;			// moves sent in the preview so far
+	mpBuf_t *preview_bf;			// next buffer to send in the preview
 	mpBuf_t *w;						// get_write_buffer pointer
 	mpBuf_t *q;						// queue_write_buffer pointer
 	mpBuf_t *r;						// get/end_run_buffer pointer
 	mpBuf_t bf[PLANNER_BUFFER_POOL_SIZE];// buffer storage
+	mpModal_t modal[PLANNER_MODAL_POOL_SIZE];// modal state storage
+	mpArc_t arc[PLANNER_ARC_POOL_SIZE];// arc geometry storage
+	mpSpline_t spline[PLANNER_SPLINE_POOL_SIZE];// spline geometry storage
+	mpCommand_t cmd[PLANNER_COMMAND_POOL_SIZE];// chained command storage
+	uint16_t raster_w;				// pixel write index (free running - mask to use)
+	uint16_t raster_r;				// pixel release index - written by the loader
+	uint8_t raster_row;				// pixels written for the next raster line so far
+	uint8_t raster[PLANNER_RASTER_POOL_SIZE];// pixel power values, 0-255
 	magic_t magic_end;
 } mpBufferPool_t;
 
@@ -194,6 +443,26 @@ typedef struct mpMoveMasterSingleton { // common variables for planning (move ma
 	float recip_jerk;
 	float cbrt_jerk;
 
+	uint8_t merge_pending;			// TRUE if a line is being held in merge_gm (see mp_aline())
+	float merge_deviation;			// accumulated deviation bound of the lines folded into merge_gm
+	GCodeState_t merge_gm;			// line being held for merging
+
+	uint8_t comp_count;				// lines held in comp_gm[] for cutter compensation (see mp_aline())
+	uint8_t comp_chain;				// TRUE if the next compensated line starts at comp_end
+	uint32_t comp_timeout;			// SysTick time after which the held lines are released on an empty queue
+	float comp_start[2];			// programmed XY start of the held XY line
+	float comp_end[2];				// programmed XY end of the last compensated line released
+	GCodeState_t comp_gm[CUTTER_COMP_HOLD_LINES];// held XY line followed by held Z lines
+
+	uint8_t command_barrier;		// TRUE if the next move must start from zero (a command was chained)
+	volatile uint8_t plan_lock;		// TRUE while a move is being planned and committed (__PLAN_ISR)
+	volatile uint8_t plan_requested;// TRUE if the PendSV planning found the planner locked
+
+	float segment_radius;			// radius of the arc segment being planned, 0 if not an arc segment
+	float segment_entry[AXES];		// arc tangent at the start of the segment being planned
+	float segment_exit[AXES];		// arc tangent at the end of the last arc segment planned
+	mpBuf_t *segment_bf;			// buffer of the last arc segment planned (see mp_aline_segment())
+
 	magic_t magic_end;
 } mpMoveMasterSingleton_t;
 
@@ -203,18 +472,21 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	uint8_t move_state;				// state of the overall move
 	uint8_t section;				// what section is the move in?
 	uint8_t section_state;			// state within a move section
+	uint8_t move_type;				// MOVE_TYPE_ALINE, MOVE_TYPE_ARC or MOVE_TYPE_SPLINE
+	uint8_t command;				// command chain to stage when the move in mr has finished
 
 	float unit[AXES];				// unit vector for axis scaling & planning
 	float target[AXES];				// final target for bf (used to correct rounding errors)
 	float position[AXES];			// current move position
-	float position_c[AXES];			// for Kahan summation in _exec_aline_segment()
 	float waypoint[SECTIONS][AXES];	// head/body/tail endpoints for correction
 
-	float target_steps[MOTORS];		// current MR target (absolute target as steps)
-	float position_steps[MOTORS];	// current MR position (target from previous segment)
-	float commanded_steps[MOTORS];	// will align with next encoder sample (target from 2nd previous segment)
+	fstep_t target_steps[MOTORS];	// current MR target (absolute target as Q24.8 steps)
+	fstep_t position_steps[MOTORS];	// current MR position (target from previous segment)
+	fstep_t commanded_steps[MOTORS];// aligns with the encoder sample (target of the segment last finished)
 	float encoder_steps[MOTORS];	// encoder position in steps - ideally the same as commanded_steps
 	float following_error[MOTORS];	// difference between encoder_steps and commanded steps
+	fstep_t step_history[STEP_HISTORY_SIZE][MOTORS];	// target_steps by line segment count
+	uint8_t step_sample;			// line segments prepped, modulo 256 (see en.samples)
 
 	float head_length;				// copies of bf variables of same name
 	float body_length;
@@ -230,6 +502,58 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float segment_time;				// actual time increment per aline segment
 	float jerk;						// max linear jerk
 
+	mpArc_t arc;					// geometry of the running arc (MOVE_TYPE_ARC only)
+	float arc_radius;				// radius of the running arc
+	float arc_theta;				// angle of the arc start point (radians from the plane axis 1)
+	float arc_linear_start;			// linear axis position at the arc start point
+	float arc_length;				// path length of the running arc (or spline) from its start point
+	float arc_travel;				// path travelled from the arc (or spline) start point
+	uint8_t arc_correction_count;	// segments left until the next exact arc point
+
+	mpSpline_t spline;				// geometry of the running spline (MOVE_TYPE_SPLINE only)
+	uint8_t spline_index;			// bf->spline of the running spline
+	float spline_start;				// spline path length at the start of the running buffer
+	float spline_u;					// curve parameter of mr.position
+
+	uint16_t raster_base;			// first pixel of the running raster line
+	float raster_length;			// full length of the running raster line; 0 if none
+
+	float feed_override;			// override requested for feeds (1.0 when disabled)
+	float traverse_override;		// override requested for traverses (1.0 when disabled)
+	float override_factor;			// override applied to the running segments (see _get_segment_time())
+	float override_start;			// factor at the start of the current override ramp
+	float override_target;			// factor the current override ramp is heading to
+	uint8_t override_ramp_count;	// segments left in the current override ramp
+	float override_limit;			// highest factor the running move's body takes (see _get_segment_time())
+	uint8_t split_parts;			// parts of a segment stretched past MAX_SEGMENT_TIME; 0 if none
+	uint8_t split_count;			// parts left to run
+	stat_t split_status;			// status the stretched segment returns once its parts have run
+	float split_time;				// time of each part
+	float split_start[AXES];		// start and end of the stretched segment
+	float split_end[AXES];
+	float adaptive_factor;			// adaptive feed factor applied to feeds (see _get_adaptive_feed())
+	float adaptive_rate;			// its change per segment
+	float thc_offset;				// Z offset applied by the torch height control (see _update_thc())
+	float pa_offset;				// extruder offset applied by the pressure advance (see _update_pressure_advance())
+	float retract_offset;			// extruder offset applied by the firmware retraction (see mp_set_retract())
+	float retract_target;			// offset the retraction is heading to
+	float retract_velocity;			// and its velocity in axis units per minute
+	uint8_t sync_state;				// spindle synchronized move state (see mp_exec_sync())
+	uint8_t sync_tap;				// TRUE for a rigid tap (G33.1)
+	uint8_t sync_spindle_mode;		// spindle direction the move follows
+	float sync_pitch;				// mm along the line per spindle revolution
+
+	uint8_t hold_replan;			// TRUE if the exec started a hold and the queue must be replanned
+	uint8_t hold_latency_run;		// TRUE while timing a feedhold request (see _time_hold_latency())
+	uint8_t hold_latency_seen;		// TRUE while in the decel whose latency was recorded
+	float hold_latency_accum;		// segment time run since the feedhold request (ms)
+	uint32_t hold_latency_accum_segments;
+	float hold_latency;				// last hold: ms of motion from the request to the first decel segment
+	float profile_velocity;			// job profile: cruise velocity requested for the running move
+	float profile_length;			// job profile: path run by the move so far (mm)
+	float profile_time;				// job profile: segment time run by the move so far (minutes)
+	uint32_t hold_latency_segments;	// last hold: segments run from the request to the first decel segment
+
 #ifdef __JERK_EXEC					// values used exclusively by computed jerk acceleration
 	float jerk_div2;				// cached value for efficiency
 	float midpoint_velocity;		// velocity at accel/decel midpoint
@@ -238,17 +562,13 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	float segment_accel_time;		//
 	float elapsed_accel_time;		//
 #else								// values used exclusively by forward differencing acceleration
-	float forward_diff_1;			// forward difference level 1
-	float forward_diff_2;			// forward difference level 2
-	float forward_diff_3;			// forward difference level 3
-	float forward_diff_4;			// forward difference level 4
-	float forward_diff_5;			// forward difference level 5
-#ifdef __KAHAN
-	float forward_diff_1_c;			// forward difference level 1 floating-point compensation
-	float forward_diff_2_c;			// forward difference level 2 floating-point compensation
-	float forward_diff_3_c;			// forward difference level 3 floating-point compensation
-	float forward_diff_4_c;			// forward difference level 4 floating-point compensation
-	float forward_diff_5_c;			// forward difference level 5 floating-point compensation
+	fdiff_t forward_diff_1;			// forward difference level 1
+	fdiff_t forward_diff_2;			// forward difference level 2
+	fdiff_t forward_diff_3;			// forward difference level 3
+	fdiff_t forward_diff_4;			// forward difference level 4
+	fdiff_t forward_diff_5;			// forward difference level 5
+#ifdef __FIXED_FORWARD_DIFFS
+	fdiff_t forward_diff_velocity;	// segment velocity accumulator (segment_velocity is the float copy)
 #endif
 #endif
 
@@ -257,10 +577,65 @@ typedef struct mpMoveRuntimeSingleton {	// persistent runtime variables
 	magic_t magic_end;
 } mpMoveRuntimeSingleton_t;
 
+/* MP_TRACE_LEN
+ *	Records in the motion trace ring. Arm with $tra=N to record every Nth segment and
+ *	read back with $trd once the move is done (see plan_exec.c). Each record is 26 bytes
+ *	(4 motors), so keep this small on the AVR.
+ */
+#define MP_TRACE_LEN 32
+#define MP_TRACE_AXES 3						// positions recorded for X, Y and Z
+
+typedef struct mpTraceRecord {		// one traced segment
+	uint16_t time;					// ms of motion since the trace was armed (wraps at 65 seconds)
+	float velocity;					// segment velocity incl. override (mm/min)
+	float position[MP_TRACE_AXES];	// runtime position at the segment end (absolute mm)
+	int16_t following_error[MOTORS];// following error in steps (see _exec_aline_segment())
+} mpTraceRecord_t;
+
+typedef struct mpTrace {			// motion trace ring - written by the exec, read by $trd
+	uint8_t divider;				// record every Nth segment, 0 = tracing off ($tra)
+	uint8_t skip;					// segments left until the next record
+	uint8_t head;					// next record to write
+	uint8_t count;					// valid records (up to MP_TRACE_LEN, oldest overwritten)
+	float time;						// ms of motion since the trace was armed
+	mpTraceRecord_t rec[MP_TRACE_LEN];
+} mpTrace_t;
+
+typedef struct mpJogRuntime {		// velocity jog - targets written by mp_jog(), ramped by the exec
+	uint8_t run;					// true while a jog buffer is queued or running
+	float target_velocity[AXES];	// commanded axis velocities (mm/min, signed)
+	float velocity[AXES];			// axis velocities at the end of the last segment
+	float acceleration[AXES];		// axis accelerations at the end of the last segment
+} mpJogRuntime_t;
+
+typedef struct mpLiveSettings {		// motion settings read by the runtime (see mp_stage_live_config())
+	float jerk_max[AXES];			// axis jerk for velocity jogs (divided by JERK_MULTIPLIER)
+	float velocity_max[AXES];		// axis velocity limits for velocity jogs
+	float power_level[MOTORS];		// scaled motor power levels (ARM only)
+	float power_boost[MOTORS];		// ...while accelerating; 0 uses power_level
+	float power_idle[MOTORS];		// ...while stopped; 0 uses power_level
+} mpLiveSettings_t;
+
+typedef struct mpLiveConfig {		// double buffered - the runtime reads one set while the other is written
+	mpLiveSettings_t set[2];
+	volatile uint8_t active;		// set the runtime reads
+	volatile uint8_t pending;		// true if the other set is waiting to be swapped in
+} mpLiveConfig_t;
+
 // Reference global scope structures
 extern mpBufferPool_t mb;				// move buffer queue
 extern mpMoveMasterSingleton_t mm;		// context for line planning
 extern mpMoveRuntimeSingleton_t mr;		// context for line runtime
+extern mpJogRuntime_t mj;				// context for velocity jogs
+extern mpLiveConfig_t ml;				// motion settings for the runtime
+extern mpTrace_t mp_trace;				// motion trace ring
+
+typedef struct mpRuntimeSnapshot {		// runtime position as published for reporting
+	volatile uint8_t seq;				// odd while the copy is being written
+	float position[AXES];				// runtime position in absolute machine coordinates
+	float work_offset[AXES];			// work offsets of the running move
+	float velocity;						// segment velocity with the override applied
+} mpRuntimeSnapshot_t;
 
 /*
  * Global Scope Functions
@@ -269,26 +644,71 @@ extern mpMoveRuntimeSingleton_t mr;		// context for line runtime
 void planner_init(void);
 void planner_init_assertions(void);
 stat_t planner_test_assertions(void);
+stat_t planner_test_queue_assertions(void);
 
 void mp_flush_planner(void);
 void mp_set_planner_position(uint8_t axis, const float position);
 void mp_set_runtime_position(uint8_t axis, const float position);
+void mp_set_runtime_position_vector(const float position[]);
 void mp_set_steps_to_runtime_position(void);
+void mp_stage_live_config(void);
+void mp_swap_live_config(void);
+stat_t mp_get_steps(nvObj_t *nv);
 
 void mp_queue_command(void(*cm_exec_t)(float[], float[]), float *value, float *flag);
+void mp_queue_segment_command(void(*cm_exec_t)(float[], float[]), float *value, float *flag);
 stat_t mp_runtime_command(mpBuf_t *bf);
+stat_t mp_runtime_command_chain(uint8_t command);
 
 stat_t mp_dwell(const float seconds);
+stat_t mp_spindle_wait(void);
 void mp_end_dwell(void);
+stat_t mp_jog(const float velocity[]);
+stat_t mp_spindle_sync(const GCodeState_t *gm_in, float pitch, uint8_t tap);
 
 stat_t mp_aline(GCodeState_t *gm_in);
+stat_t mp_aline_segment(GCodeState_t *gm_in, float radius, const float entry_unit[], const float exit_unit[]);
+stat_t mp_aarc(GCodeState_t *gm_in, const mpArc_t *arc_in, float length);
+stat_t mp_aspline(GCodeState_t *gm_in, const mpSpline_t *spline_in);
+stat_t mp_commit_merged_line(void);
+void mp_discard_merged_line(void);
+stat_t mp_merge_callback(void);
+uint8_t mp_get_line_headroom(void);
+uint8_t mp_prime_start(void);
+stat_t mp_prime_callback(void);
+uint8_t mp_planner_is_priming(void);
+stat_t mp_dry_run_callback(void);
+void mp_end_dry_run(void);
+stat_t mp_set_dry(nvObj_t *nv);
+stat_t mp_preview_callback(void);
+stat_t mp_get_pvw(nvObj_t *nv);
 
 stat_t mp_plan_hold_callback(void);
+stat_t mp_plan_hold_runtime(mpBuf_t *bp);
 stat_t mp_end_hold(void);
 stat_t mp_feed_rate_override(uint8_t flag, float parameter);
+stat_t mp_traverse_override(uint8_t flag, float parameter);
 
 // planner buffer handlers
 uint8_t mp_get_planner_buffers_available(void);
+uint8_t mp_planner_has_headroom(uint8_t buffers);
+float mp_get_planner_queue_time(void);
+uint8_t mp_get_modal_available(void);
+uint8_t mp_get_arc_available(void);
+stat_t mp_set_buffer_arc(mpBuf_t *bf, const mpArc_t *arc_in);
+uint8_t mp_get_spline_available(void);
+float mp_get_spline_speed(const mpSpline_t *sp, float u);
+float mp_get_spline_length(const mpSpline_t *sp, float u_0, float u_1);
+stat_t mp_set_buffer_spline(mpBuf_t *bf, const mpSpline_t *spline_in);
+stat_t mp_set_buffer_gcode_state(mpBuf_t *bf, const GCodeState_t *gm_in);
+void mp_get_buffer_gcode_state(const mpBuf_t *bf, GCodeState_t *gm_out);
+uint16_t mp_get_raster_available(void);
+uint8_t mp_get_raster_row(void);
+uint16_t mp_claim_raster_row(void);
+void mp_discard_raster_row(void);
+void mp_cut_raster_row(uint8_t pixels);
+stat_t mp_get_rst(nvObj_t *nv);
+stat_t mp_set_rst(nvObj_t *nv);
 void mp_init_buffers(void);
 mpBuf_t * mp_get_write_buffer(void);
 void mp_unget_write_buffer(void);
@@ -296,6 +716,7 @@ void mp_commit_write_buffer(const uint8_t move_type);
 
 mpBuf_t * mp_get_run_buffer(void);
 uint8_t mp_free_run_buffer(void);
+uint8_t mp_get_cruise_limit(const mpBuf_t *bf);
 mpBuf_t * mp_get_first_buffer(void);
 mpBuf_t * mp_get_last_buffer(void);
 
@@ -310,19 +731,42 @@ void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp);
 float mp_get_runtime_velocity(void);
 float mp_get_runtime_work_position(uint8_t axis);
 float mp_get_runtime_absolute_position(uint8_t axis);
+void mp_get_runtime_absolute_vector(float position[]);
 void mp_set_runtime_work_offset(float offset[]);
 void mp_zero_segment_velocity(void);
+void mp_publish_runtime_snapshot(void);
+void mp_publish_runtime_snapshot_locked(void);
+void mp_hold_runtime_snapshot(void);
+void mp_release_runtime_snapshot(void);
 uint8_t mp_get_runtime_busy(void);
 float* mp_get_planner_position_vector(void);
+#ifdef __BENCHMARKS
+uint32_t mp_bench_junction_vmax(uint16_t calls);
+#endif
 
 // plan_zoid.c functions
 void mp_calculate_trapezoid(mpBuf_t *bf);
 float mp_get_target_length(const float Vi, const float Vf, const mpBuf_t *bf);
 float mp_get_target_velocity(const float Vi, const float L, const mpBuf_t *bf);
 
+// plan_shaper.c functions
+void mp_shaper_reset(const float position[]);
+const float *mp_shape_segment(const float target[], float segment_time, float shaped[]);
+uint8_t mp_shaper_pending(void);
+
 // plan_exec.c functions
 stat_t mp_exec_move(void);
 stat_t mp_exec_aline(mpBuf_t *bf);
+void mp_set_retract(float offset, float velocity);
+uint8_t mp_retract_pending(void);
+stat_t mp_exec_jog(mpBuf_t *bf);
+stat_t mp_exec_sync(mpBuf_t *bf);
+stat_t mp_exec_network_segment(const float target[], float segment_time);
+stat_t mp_set_tra(nvObj_t *nv);
+stat_t mp_get_trd(nvObj_t *nv);
+#ifdef __BENCHMARKS
+uint32_t mp_bench_exec_segment(uint16_t calls);
+#endif
 /*
 #ifdef __cplusplus
 }
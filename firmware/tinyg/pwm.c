@@ -95,12 +95,14 @@ void pwm_init()
 	pwm.p[PWM_1].timer->CTRLB = PWM1_CTRLB;
 	pwm.p[PWM_1].timer->INTCTRLB = PWM1_INTCTRLB;		// set interrupt level
 
-	// setup PWM channel 2
+	// setup PWM channel 2 - its timer is the quadrature decoder with __ENCODER_QDEC
+#ifndef __ENCODER_QDEC
 	memset(&pwm.p[PWM_2], 0, sizeof(pwmChannel_t));		// clear all values, pointers and status
 	pwm.p[PWM_2].timer = &TIMER_PWM2;
 	pwm.p[PWM_2].ctrla = PWM2_CTRLA_CLKSEL;
 	pwm.p[PWM_2].timer->CTRLB = PWM2_CTRLB;
 	pwm.p[PWM_2].timer->INTCTRLB = PWM2_INTCTRLB;
+#endif
 #endif // __AVR
 }
 
@@ -144,7 +146,7 @@ ISR(PWM2_ISR_vect)
 
 stat_t pwm_set_freq(uint8_t chan, float freq)
 {
-	if (chan > PWMS) { return (STAT_NO_SUCH_DEVICE);}
+	if (chan >= PWMS) { return (STAT_NO_SUCH_DEVICE);}
 	if (freq > PWM_MAX_FREQ) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
 	if (freq < PWM_MIN_FREQ) { return (STAT_INPUT_LESS_THAN_MIN_VALUE);}
 
@@ -199,10 +201,7 @@ stat_t pwm_set_duty(uint8_t chan, float duty)
 	if (duty > 1.0) { return (STAT_INPUT_EXCEEDS_MAX_VALUE);}
 
 	#ifdef __AVR
-//  Ffrq = Fper/(2N(CCA+1))
-//  Fpwm = Fper/((N(PER+1))
-	float period_scalar = pwm.p[chan].timer->PER;
-	pwm.p[chan].timer->CCB = (uint16_t)(period_scalar * duty) + 1;
+	pwm.p[chan].timer->CCB = pwm_get_compare(chan, duty);
 	#endif // __AVR
 
 	#ifdef __ARM
@@ -217,6 +216,59 @@ stat_t pwm_set_duty(uint8_t chan, float duty)
 }
 
 
+/*
+ * pwm_enable_output() - drive the channel's output pin from its timer
+ *
+ *	PWM_1 drives its pin from pwm_init(). PWM_2's pin (PE5) is also a gpio1 output bit, so
+ *	it is only taken over if PWM_2 is in use (see cm_spindle_init()).
+ */
+
+stat_t pwm_enable_output(uint8_t chan)
+{
+	if (chan >= PWMS) { return (STAT_NO_SUCH_DEVICE);}
+#ifdef __ENCODER_QDEC
+	if (chan == PWM_2) { return (STAT_NO_SUCH_DEVICE);}	// its timer is the quadrature decoder
+#endif
+
+	#ifdef __AVR
+	pwm.p[chan].timer->CTRLB |= TC0_CCBEN_bm;
+	#endif // __AVR
+	return (STAT_OK);
+}
+
+/*
+ * pwm_get_compare() - return the timer compare value for a PWM channel duty cycle
+ *
+ *	Lets an ISR load a duty cycle with a single register write (see _load_move())
+ */
+
+#ifdef __AVR
+uint16_t pwm_get_compare(uint8_t chan, float duty)
+{
+//  Ffrq = Fper/(2N(CCA+1))
+//  Fpwm = Fper/((N(PER+1))
+	float period_scalar = pwm.p[chan].timer->PER;
+	return ((uint16_t)(period_scalar * duty) + 1);
+}
+
+/*
+ * pwm_get_fraction() - return the part of a count pwm_get_compare() drops, in 1/256 counts
+ *
+ *	pwm_set_freq() already picks the prescaler that gives the longest period, but at laser
+ *	frequencies that is still only a few hundred or thousand counts, and a duty cycle falls
+ *	between two compare values. With dithering on ($p1dth=1) the DDA interrupt adds the
+ *	fraction up every tick and writes the compare one count higher on each carry, so the
+ *	average power gets 8 more bits of resolution. Returns 0 if dithering is off.
+ */
+
+uint8_t pwm_get_fraction(uint8_t chan, float duty)
+{
+	if (pwm.c[chan].dither == false) { return (0);}
+	float counts = pwm.p[chan].timer->PER * duty;
+	return ((uint8_t)((counts - (uint16_t)counts) * 256));
+}
+#endif // __AVR
+
 /***********************************************************************************
  * CONFIGURATION AND INTERFACE FUNCTIONS
  * Functions to get and set variables from the cfgArray table
@@ -242,6 +294,21 @@ static const char fmt_p1wsh[] PROGMEM = "[p1wsh] pwm ccw speed hi%15.0f RPM\n";
 static const char fmt_p1wpl[] PROGMEM = "[p1wpl] pwm ccw phase lo%15.3f [0..1]\n";
 static const char fmt_p1wph[] PROGMEM = "[p1wph] pwm ccw phase hi%15.3f [0..1]\n";
 static const char fmt_p1pof[] PROGMEM = "[p1pof] pwm phase off   %15.3f [0..1]\n";
+static const char fmt_p1lsr[] PROGMEM = "[p1lsr] pwm laser mode  %15d [0=off,1=on]\n";
+static const char fmt_p1dth[] PROGMEM = "[p1dth] pwm dithering   %15d [0=off,1=on]\n";
+static const char fmt_p1acc[] PROGMEM = "[p1acc] pwm spindle accel %13.0f RPM/s\n";
+static const char fmt_p2frq[] PROGMEM = "[p2frq] pwm frequency   %15.0f Hz\n";
+static const char fmt_p2csl[] PROGMEM = "[p2csl] pwm cw speed lo %15.0f RPM\n";
+static const char fmt_p2csh[] PROGMEM = "[p2csh] pwm cw speed hi %15.0f RPM\n";
+static const char fmt_p2cpl[] PROGMEM = "[p2cpl] pwm cw phase lo %15.3f [0..1]\n";
+static const char fmt_p2cph[] PROGMEM = "[p2cph] pwm cw phase hi %15.3f [0..1]\n";
+static const char fmt_p2wsl[] PROGMEM = "[p2wsl] pwm ccw speed lo%15.0f RPM\n";
+static const char fmt_p2wsh[] PROGMEM = "[p2wsh] pwm ccw speed hi%15.0f RPM\n";
+static const char fmt_p2wpl[] PROGMEM = "[p2wpl] pwm ccw phase lo%15.3f [0..1]\n";
+static const char fmt_p2wph[] PROGMEM = "[p2wph] pwm ccw phase hi%15.3f [0..1]\n";
+static const char fmt_p2pof[] PROGMEM = "[p2pof] pwm phase off   %15.3f [0..1]\n";
+static const char fmt_p2lsr[] PROGMEM = "[p2lsr] pwm laser mode  %15d [0=off,1=on]\n";
+static const char fmt_p2tn[] PROGMEM =  "[p2tn]  pwm tool number %15d [0=off]\n";
 
 void pwm_print_p1frq(nvObj_t *nv) { text_print_flt(nv, fmt_p1frq);}
 void pwm_print_p1csl(nvObj_t *nv) { text_print_flt(nv, fmt_p1csl);}
@@ -253,6 +320,21 @@ void pwm_print_p1wsh(nvObj_t *nv) { text_print_flt(nv, fmt_p1wsh);}
 void pwm_print_p1wpl(nvObj_t *nv) { text_print_flt(nv, fmt_p1wpl);}
 void pwm_print_p1wph(nvObj_t *nv) { text_print_flt(nv, fmt_p1wph);}
 void pwm_print_p1pof(nvObj_t *nv) { text_print_flt(nv, fmt_p1pof);}
+void pwm_print_p1lsr(nvObj_t *nv) { text_print_ui8(nv, fmt_p1lsr);}
+void pwm_print_p1dth(nvObj_t *nv) { text_print_ui8(nv, fmt_p1dth);}
+void pwm_print_p1acc(nvObj_t *nv) { text_print_flt(nv, fmt_p1acc);}
+void pwm_print_p2frq(nvObj_t *nv) { text_print_flt(nv, fmt_p2frq);}
+void pwm_print_p2csl(nvObj_t *nv) { text_print_flt(nv, fmt_p2csl);}
+void pwm_print_p2csh(nvObj_t *nv) { text_print_flt(nv, fmt_p2csh);}
+void pwm_print_p2cpl(nvObj_t *nv) { text_print_flt(nv, fmt_p2cpl);}
+void pwm_print_p2cph(nvObj_t *nv) { text_print_flt(nv, fmt_p2cph);}
+void pwm_print_p2wsl(nvObj_t *nv) { text_print_flt(nv, fmt_p2wsl);}
+void pwm_print_p2wsh(nvObj_t *nv) { text_print_flt(nv, fmt_p2wsh);}
+void pwm_print_p2wpl(nvObj_t *nv) { text_print_flt(nv, fmt_p2wpl);}
+void pwm_print_p2wph(nvObj_t *nv) { text_print_flt(nv, fmt_p2wph);}
+void pwm_print_p2pof(nvObj_t *nv) { text_print_flt(nv, fmt_p2pof);}
+void pwm_print_p2lsr(nvObj_t *nv) { text_print_ui8(nv, fmt_p2lsr);}
+void pwm_print_p2tn(nvObj_t *nv) { text_print_ui8(nv, fmt_p2tn);}
 
 #endif //__TEXT_MODE
 
@@ -43,6 +43,10 @@ typedef struct pwmConfigChannel {
 	float ccw_phase_lo;				// pwm phase at minimum CCW spindle speed, clamped [0..1]
 	float ccw_phase_hi;				// pwm phase at maximum CCW spindle speed, clamped
 	float phase_off;				// pwm phase when spindle is disabled
+	uint8_t laser_mode;				// TRUE = phase follows the segment velocity (see cm_get_laser_pwm())
+	uint8_t dither;					// TRUE = dither the compare count fraction in laser mode (see pwm_get_fraction())
+	float spindle_accel;			// spindle acceleration in RPM per second; 0 = no at-speed wait
+	uint8_t tool;					// PWM_2: tool that M3, M4, M5 and S drive it for; 0 = off (see spindle.c)
 } pwmConfigChannel_t;
 
 typedef struct pwmChannel {
@@ -64,6 +68,11 @@ extern pwmSingleton_t pwm;
 void pwm_init(void);
 stat_t pwm_set_freq(uint8_t channel, float freq);
 stat_t pwm_set_duty(uint8_t channel, float duty);
+stat_t pwm_enable_output(uint8_t channel);
+#ifdef __AVR
+uint16_t pwm_get_compare(uint8_t channel, float duty);
+uint8_t pwm_get_fraction(uint8_t channel, float duty);
+#endif
 
 #ifdef __TEXT_MODE
 
@@ -77,6 +86,21 @@ stat_t pwm_set_duty(uint8_t channel, float duty);
 	void pwm_print_p1wpl(nvObj_t *nv);
 	void pwm_print_p1wph(nvObj_t *nv);
 	void pwm_print_p1pof(nvObj_t *nv);
+	void pwm_print_p1lsr(nvObj_t *nv);
+	void pwm_print_p1dth(nvObj_t *nv);
+	void pwm_print_p1acc(nvObj_t *nv);
+	void pwm_print_p2frq(nvObj_t *nv);
+	void pwm_print_p2csl(nvObj_t *nv);
+	void pwm_print_p2csh(nvObj_t *nv);
+	void pwm_print_p2cpl(nvObj_t *nv);
+	void pwm_print_p2cph(nvObj_t *nv);
+	void pwm_print_p2wsl(nvObj_t *nv);
+	void pwm_print_p2wsh(nvObj_t *nv);
+	void pwm_print_p2wpl(nvObj_t *nv);
+	void pwm_print_p2wph(nvObj_t *nv);
+	void pwm_print_p2pof(nvObj_t *nv);
+	void pwm_print_p2lsr(nvObj_t *nv);
+	void pwm_print_p2tn(nvObj_t *nv);
 
 #else
 
@@ -90,6 +114,21 @@ stat_t pwm_set_duty(uint8_t channel, float duty);
 	#define pwm_print_p1wpl tx_print_stub
 	#define pwm_print_p1wph tx_print_stub
 	#define pwm_print_p1pof tx_print_stub
+	#define pwm_print_p1lsr tx_print_stub
+	#define pwm_print_p1dth tx_print_stub
+	#define pwm_print_p1acc tx_print_stub
+	#define pwm_print_p2frq tx_print_stub
+	#define pwm_print_p2csl tx_print_stub
+	#define pwm_print_p2csh tx_print_stub
+	#define pwm_print_p2cpl tx_print_stub
+	#define pwm_print_p2cph tx_print_stub
+	#define pwm_print_p2wsl tx_print_stub
+	#define pwm_print_p2wsh tx_print_stub
+	#define pwm_print_p2wpl tx_print_stub
+	#define pwm_print_p2wph tx_print_stub
+	#define pwm_print_p2pof tx_print_stub
+	#define pwm_print_p2lsr tx_print_stub
+	#define pwm_print_p2tn tx_print_stub
 
 #endif // __TEXT_MODE
 
@@ -32,7 +32,10 @@
 #include "json_parser.h"
 #include "text_parser.h"
 #include "planner.h"
+#include "canonical_machine.h"
 #include "settings.h"
+#include "hardware.h"
+#include "persistence.h"
 #include "util.h"
 #include "xio.h"
 
@@ -45,6 +48,10 @@ extern "C"{
 srSingleton_t sr;
 qrSingleton_t qr;
 rxSingleton_t rx;
+akSingleton_t ak;
+elSingleton_t el;
+
+static void _print_exception(const elEntry_t *e, const char *name);
 
 /**** Exception Reports ************************************************************
  * rpt_exception() - generate an exception message - always in JSON format
@@ -57,6 +64,15 @@ rxSingleton_t rx;
 stat_t rpt_exception(uint8_t status)
 {
 	if (status != STAT_OK) {	// makes it possible to call exception reports w/o checking status value
+		if (status != STAT_EOF) {					// not really an exception
+			elEntry_t *e = &el.ex[el.next];
+			e->systick = SysTickTimer_getValue();
+			e->linenum = cm_get_linenum(MODEL);
+			e->status = status;
+			e->machine_state = cm.machine_state;
+			if (++el.next >= EXCEPTION_LOG_LEN) el.next = 0;
+			if (el.count < EXCEPTION_LOG_LEN) el.count++;
+		}
 		if (js.json_syntax == JSON_SYNTAX_RELAXED) {
 			printf_P(PSTR("{er:{fb:%0.2f,st:%d,msg:\"%s\"}}\n"),
 				TINYG_FIRMWARE_BUILD, status, get_status_message(status));
@@ -76,12 +92,116 @@ stat_t rpt_er(nvObj_t *nv)
 	return(rpt_exception(STAT_GENERIC_EXCEPTION_REPORT)); // bogus exception report for testing
 }
 
+/*
+ * rpt_save_exceptions() - write the newest exceptions in the log to NVM (at a hard alarm)
+ * rpt_get_exl()		 - print the exception log, oldest first, and return its length
+ * rpt_set_exl()		 - clear the exception log
+ * rpt_get_exs()		 - print the exceptions saved at the last hard alarm, return how many
+ * rpt_set_exs()		 - erase the saved exceptions
+ * _print_exception()	 - {"name":[systick, status, linenum, machine state]}
+ *
+ *	rpt_exception() also logs each exception in a RAM ring of the last EXCEPTION_LOG_LEN,
+ *	so an error on an unattended job can be read back later even if the host missed it.
+ *	It costs nothing until an exception is reported. cm_hard_alarm() writes the newest
+ *	EXCEPTION_SAVE_LEN of them to a page of NVM (see persistence_write_exceptions()), so
+ *	what led up to the alarm survives the reset. Timestamps are SysTick ms since reset.
+ */
+void rpt_save_exceptions()
+{
+	int8_t buf[EXCEPTION_SAVE_LEN * EXCEPTION_RECORD_LEN];
+	uint8_t count = min(el.count, EXCEPTION_SAVE_LEN);
+	uint8_t slot = (el.next + EXCEPTION_LOG_LEN - count) % EXCEPTION_LOG_LEN;
+
+	memset(buf, 0xFF, sizeof(buf));						// unused records read back as erased
+	for (uint8_t i=0; i<count; i++) {
+		elEntry_t *e = &el.ex[slot];
+		int8_t *r = &buf[i * EXCEPTION_RECORD_LEN];
+		memcpy(&r[0], &e->systick, 4);
+		memcpy(&r[4], &e->linenum, 4);
+		r[8] = (int8_t)e->status;
+		r[9] = (int8_t)e->machine_state;
+		if (++slot >= EXCEPTION_LOG_LEN) slot = 0;
+	}
+	persistence_write_exceptions(buf, count);
+}
+
+stat_t rpt_get_exl(nvObj_t *nv)
+{
+	uint8_t slot = (el.next + EXCEPTION_LOG_LEN - el.count) % EXCEPTION_LOG_LEN;
+	for (uint8_t i=0; i<el.count; i++) {
+		_print_exception(&el.ex[slot], PSTR("exl"));
+		if (++slot >= EXCEPTION_LOG_LEN) slot = 0;
+	}
+	nv->value = el.count;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t rpt_set_exl(nvObj_t *nv)
+{
+	memset(&el, 0, sizeof(el));
+	return (STAT_OK);
+}
+
+stat_t rpt_get_exs(nvObj_t *nv)
+{
+	int8_t buf[EXCEPTION_SAVE_LEN * EXCEPTION_RECORD_LEN];
+	uint8_t count = persistence_read_exceptions(buf);
+
+	for (uint8_t i=0; i<count; i++) {
+		elEntry_t e;
+		int8_t *r = &buf[i * EXCEPTION_RECORD_LEN];
+		memcpy(&e.systick, &r[0], 4);
+		memcpy(&e.linenum, &r[4], 4);
+		e.status = (uint8_t)r[8];
+		e.machine_state = (uint8_t)r[9];
+		_print_exception(&e, PSTR("exs"));
+	}
+	nv->value = count;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t rpt_set_exs(nvObj_t *nv)
+{
+	persistence_write_exceptions(NULL, 0);
+	return (STAT_OK);
+}
+
+static void _print_exception(const elEntry_t *e, const char *name)
+{
+	printf_P(PSTR("{\""));
+	printf_P(name);
+	printf_P(PSTR("\":[%lu,%d,%lu,%d]}\n"), (unsigned long)e->systick, e->status,
+		(unsigned long)e->linenum, e->machine_state);
+}
+
+/*
+ * rpt_tx_has_room() - return true if there is TX room for output of the given priority
+ *
+ *	Writing to a full TX buffer waits on the transmitter and stalls the controller loop.
+ *	Report callbacks check here first and hold their report while the buffer is backed
+ *	up. A held report is not lost: the request stays pending and is merged with any
+ *	later changes, so it goes out with the latest values once the TX buffer drains.
+ *	Responses and exceptions are never held.
+ */
+uint8_t rpt_tx_has_room(uint8_t priority)
+{
+	buffer_t tx_free = xio_get_usb_tx_free();
+
+	if (priority == RPT_PRIORITY_QUEUE) return (tx_free >= RPT_TX_FREE_QUEUE);
+	if (priority == RPT_PRIORITY_STATUS) return (tx_free >= RPT_TX_FREE_STATUS);
+	if (priority == RPT_PRIORITY_MESSAGE) return (tx_free >= RPT_TX_FREE_MESSAGE);
+	return (true);
+}
+
 /**** Application Messages *********************************************************
  * rpt_print_initializing_message()	   - initializing configs from hard-coded profile
  * rpt_print_loading_configs_message() - loading configs from EEPROM
  * rpt_print_system_ready_message()    - system ready message
  *
  *	These messages are always in JSON format to allow UIs to sync
+ *	The system ready message also carries the boot time in ms as "bt"
  */
 
 //void _startup_helper(stat_t status, const char_t *msg)
@@ -96,6 +216,9 @@ void _startup_helper(stat_t status, const char *msg)
 	nv_add_object((const char_t *)"hv");		// hardware version
 	nv_add_object((const char_t *)"id");		// hardware ID
 	nv_add_string((const char_t *)"msg", pstr2str(msg));	// startup message
+	if (status == STAT_OK) {
+		nv_add_integer((const char_t *)"bt", hw_get_boot_time());	// boot time (system ready only)
+	}
 	json_print_response(status);
 #endif
 }
@@ -161,6 +284,11 @@ void rpt_print_system_ready_message(void)
  */
 static stat_t _populate_unfiltered_status_report(void);
 static uint8_t _populate_filtered_status_report(void);
+static void _build_status_report_table(void);
+static uint8_t _status_report_template_ready(void);
+static uint8_t _print_status_report_template(uint8_t filtered);
+static uint8_t _populate_binary_status_report(uint8_t *buf);
+static void _send_binary_status_report(uint8_t *buf, uint8_t length);
 
 uint8_t _is_stat(nvObj_t *nv)
 {
@@ -187,7 +315,6 @@ void sr_init_status_report()
 
 	for (uint8_t i=0; i < NV_STATUS_REPORT_LEN ; i++) {
 		if (sr_defaults[i][0] == NUL) break;				// quit on first blank array entry
-		sr.status_report_value[i] = -1234567;				// pre-load values with an unlikely number
 		nv->value = nv_get_index((const char_t *)"", sr_defaults[i]);// load the index for the SR element
 		if (nv->value == NO_MATCH) {
 			rpt_exception(STAT_BAD_STATUS_REPORT_SETTING);	// trap mis-configured profile settings
@@ -199,6 +326,7 @@ void sr_init_status_report()
 		nv_persist(nv);										// conditionally persist - automatic by nv_persist()
 		nv->index++;										// increment SR NVM index
 	}
+	_build_status_report_table();
 }
 
 /*
@@ -230,9 +358,30 @@ stat_t sr_set_status_report(nvObj_t *nv)
 	if (elements == 0)
         return (STAT_INVALID_OR_MALFORMED_COMMAND);
 	memcpy(sr.status_report_list, status_report_list, sizeof(status_report_list));
+	_build_status_report_table();
 	return(_populate_unfiltered_status_report());			// return current values
 }
 
+/*
+ * _build_status_report_table() - resolve the SR list into get functions for filtered reports
+ *
+ *	Run whenever the SR list changes. Also forces the next filtered report to send all values.
+ */
+static void _build_status_report_table()
+{
+	nvObj_t tmp;
+	nvObj_t *nv = &tmp;						// GET_TABLE_WORD() works off nv->index
+	uint8_t i;
+
+	for (i=0; i<NV_STATUS_REPORT_LEN; i++) {
+		if ((nv->index = sr.status_report_list[i]) == 0) { break;}
+		sr.status_report_get[i] = (fptrCmd)GET_TABLE_WORD(get);
+		sr.status_report_value[i] = -1234567;				// pre-load values with an unlikely number
+	}
+	sr.status_report_count = i;
+	sr.template_syntax = SR_TEMPLATE_STALE;
+}
+
 /*
  * sr_request_status_report()	- request a status report to run after minimum interval
  * sr_status_report_callback()	- main loop callback to send a report if one is ready
@@ -244,29 +393,70 @@ stat_t sr_set_status_report(nvObj_t *nv)
  *
  *	Status reports are generally returned with minimal delay (from the controller callback),
  *	but will not be provided more frequently than the status report interval
+ *
+ *	Adaptive mode ($sa=1) paces timed reports from the runtime instead of a fixed interval.
+ *	Timed requests are checked every STATUS_REPORT_MIN_MS and a report is sent if:
+ *	  - the combined state has changed since the last report, or
+ *	  - the machine is moving and the velocity has changed by more than
+ *		SR_ADAPTIVE_VELOCITY_CHANGE (accel, decel and feedhold ramps), or
+ *	  - the machine is moving and the status report interval has run out (steady cruise)
+ *	Timed requests made while the machine is idle and unchanged are dropped. Immediate
+ *	requests are always sent.
  */
 stat_t sr_request_status_report(uint8_t request_type)
 {
+	uint32_t interval = (sr.status_report_adaptive == true) ? STATUS_REPORT_MIN_MS : sr.status_report_interval;
+
 #ifdef __ARM
 	if (request_type == SR_IMMEDIATE_REQUEST) {
 		sr.status_report_systick = SysTickTimer.getValue();
+		sr.status_report_immediate = true;
 	}
 	if ((request_type == SR_TIMED_REQUEST) && (sr.status_report_requested == false)) {
-		sr.status_report_systick = SysTickTimer.getValue() + sr.status_report_interval;
+		sr.status_report_systick = SysTickTimer.getValue() + interval;
 	}
 #endif
 #ifdef __AVR
 	if (request_type == SR_IMMEDIATE_REQUEST) {
 		sr.status_report_systick = SysTickTimer_getValue();
+		sr.status_report_immediate = true;
 	}
 	if ((request_type == SR_TIMED_REQUEST) && (sr.status_report_requested == false)) {
-		sr.status_report_systick = SysTickTimer_getValue() + sr.status_report_interval;
+		sr.status_report_systick = SysTickTimer_getValue() + interval;
 	}
 #endif
 	sr.status_report_requested = true;
 	return (STAT_OK);
 }
 
+/*
+ * _adaptive_report_is_due() - decide if a pending timed request should be sent now
+ *
+ *	Re-arms the request for the next check if the report is not due yet, or drops it if idle.
+ */
+static uint8_t _adaptive_report_is_due(uint32_t tick)
+{
+	uint8_t state = cm_get_combined_state();
+	if (state != sr.adaptive_state) {
+		return (true);
+	}
+	if ((state == COMBINED_RUN) || (state == COMBINED_CYCLE) || (state == COMBINED_PROBE) ||
+		(state == COMBINED_HOMING) || (state == COMBINED_JOG)) {
+		float velocity = mp_get_runtime_velocity();
+		float change = max(sr.adaptive_velocity * SR_ADAPTIVE_VELOCITY_CHANGE, SR_ADAPTIVE_VELOCITY_MIN);
+		if (fabs(velocity - sr.adaptive_velocity) > change) {
+			return (true);
+		}
+		if ((tick - sr.adaptive_systick) >= sr.status_report_interval) {
+			return (true);
+		}
+		sr.status_report_systick = tick + STATUS_REPORT_MIN_MS;	// check again later
+		return (false);
+	}
+	sr.status_report_requested = false;		// idle and nothing has changed
+	return (false);
+}
+
 stat_t sr_status_report_callback() 		// called by controller dispatcher
 {
 #ifdef __SUPPRESS_STATUS_REPORTS
@@ -279,6 +469,9 @@ stat_t sr_status_report_callback() 		// called by controller dispatcher
 	if (sr.status_report_requested == false)
         return (STAT_NOOP);
 
+	if ((sr.status_report_immediate == false) && (controller_take_events(SUB_STATUS_REPORT) == 0))
+		return (STAT_NOOP);					// nothing has moved or ticked since the last look
+
 #ifdef __ARM
 	if (SysTickTimer.getValue() < sr.status_report_systick)
         return (STAT_NOOP);
@@ -288,14 +481,49 @@ stat_t sr_status_report_callback() 		// called by controller dispatcher
         return (STAT_NOOP);
 #endif
 
+	if (rpt_tx_has_room(RPT_PRIORITY_STATUS) == false)
+		return (STAT_NOOP);					// hold the report - it's merged with later changes
+
+	if ((sr.status_report_adaptive == true) && (sr.status_report_immediate == false)) {
+		if (_adaptive_report_is_due(SysTickTimer_getValue()) == false)
+			return (STAT_NOOP);
+	}
 	sr.status_report_requested = false;		// disable reports until requested again
+	sr.status_report_immediate = false;
+	sr.adaptive_state = cm_get_combined_state();
+	sr.adaptive_velocity = mp_get_runtime_velocity();
+	sr.adaptive_systick = SysTickTimer_getValue();
+
+	if (sr.status_report_binary != 0) {
+		uint8_t buf[SR_BINARY_PAYLOAD_MAX];
+		mp_hold_runtime_snapshot();				// all axes from the same segment
+		uint8_t length = _populate_binary_status_report(buf);
+		mp_release_runtime_snapshot();
+		if ((sr.status_report_verbosity == SR_FILTERED) && (length == sr.binary_length) &&
+			(memcmp(buf, sr.binary_payload, length) == 0)) {
+			return (STAT_OK);					// no new data
+		}
+		sr.binary_length = length;
+		memcpy(sr.binary_payload, buf, length);
+		_send_binary_status_report(buf, length);
+		return (STAT_OK);
+	}
 
+	mp_hold_runtime_snapshot();
+	if ((cfg.comm_mode == JSON_MODE) && (_status_report_template_ready() == true)) {
+		_print_status_report_template(sr.status_report_verbosity == SR_FILTERED);
+		mp_release_runtime_snapshot();
+		return (STAT_OK);
+	}
+	uint8_t changed = true;
 	if (sr.status_report_verbosity == SR_VERBOSE) {
 		_populate_unfiltered_status_report();
 	} else {
-		if (_populate_filtered_status_report() == false) {	// no new data
-			return (STAT_OK);
-		}
+		changed = _populate_filtered_status_report();
+	}
+	mp_release_runtime_snapshot();
+	if (changed == false) {					// no new data
+		return (STAT_OK);
 	}
 	nv_print_list(STAT_OK, TEXT_INLINE_PAIRS, JSON_OBJECT_FORMAT);
 	return (STAT_OK);
@@ -306,7 +534,9 @@ stat_t sr_status_report_callback() 		// called by controller dispatcher
  */
 stat_t sr_run_text_status_report()
 {
+	mp_hold_runtime_snapshot();
 	_populate_unfiltered_status_report();
+	mp_release_runtime_snapshot();
 	nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
 	return (STAT_OK);
 }
@@ -351,45 +581,196 @@ static stat_t _populate_unfiltered_status_report()
  *	the SR index, which is a relatively expensive operation. In current use this
  *	doesn't matter, but if the caller assumes its set it may lead to a side-effect (bug)
  *
- *	NOTE: Room for improvement - look up the SR index initially and cache it, use the
- *		  cached value for all remaining reports.
+ *	Values are read through the get functions resolved by _build_status_report_table()
+ *	into a scratch nvObj. The nvObj list is not touched until a value has changed; only
+ *	then is the list reset and the changed element populated. Strings made by the scratch
+ *	reads are dropped by winding the shared string back.
  */
 static uint8_t _populate_filtered_status_report()
 {
-	const char_t sr_str[] = "sr";
-	uint8_t has_data = false;
-	char_t tmp[TOKEN_LEN+1];
-	nvObj_t *nv = nv_reset_nv_list();		// sets nv to the start of the body
-
-	nv->valuetype = TYPE_PARENT; 			// setup the parent object (no need to length check the copy)
-	strcpy(nv->token, sr_str);
-//	nv->index = nv_get_index((const char_t *)"", sr_str);// OMITTED - set the index - may be needed by calling function
-	nv = nv->nx;							// no need to check for NULL as list has just been reset
+	nvObj_t scratch;
+	nvObj_t *nv = NULL;
+
+	for (uint8_t i=0; i<sr.status_report_count; i++) {
+		uint16_t wp = nvStr.wp;
+		scratch.index = sr.status_report_list[i];
+		sr.status_report_get[i](&scratch);
+		nvStr.wp = wp;
+
+		// do not report values that have not changed
+		if (fp_EQ(scratch.value, sr.status_report_value[i])) { continue;}
+
+		if (nv == NULL) {					// first change - set up the list
+			nv = nv_reset_nv_list();		// sets nv to the start of the body
+			nv->valuetype = TYPE_PARENT; 	// setup the parent object (no need to length check the copy)
+			strcpy(nv->token, "sr");
+			nv = nv->nx;					// no need to check for NULL as list has just been reset
+		} else if ((nv = nv->nx) == NULL) {
+			return (false);					// should never be NULL unless SR length exceeds available buffer array
+		}
+		nv_reset_nv(nv);
+		nv->index = scratch.index;
+		strcpy_P(nv->token, cfgArray[nv->index].token); // full token - same as flattening out the group
+		sr.status_report_get[i](nv);
+		sr.status_report_value[i] = nv->value;
+	}
+	return (nv != NULL);
+}
 
-	for (uint8_t i=0; i<NV_STATUS_REPORT_LEN; i++) {
-		if ((nv->index = sr.status_report_list[i]) == 0) { break;}
+/*
+ * _status_report_template_ready() - (re)build the SR template if needed; true if it can be used
+ * _print_status_report_template() - format a JSON SR straight into the output buffer
+ *
+ *	The SR list is fixed until it is set again, so the literal parts of a JSON SR - the
+ *	{"sr":{ head and the "token": name of each element - are built once into a template.
+ *	A report then only reads the values through the resolved get functions and formats
+ *	each one into its slot, as json_serialize() would format it. There is no nvObj list.
+ *
+ *	The template is built on the first report after the SR list or $js changes. It is
+ *	only used if every element reads as a float or integer (the SR values all do); any
+ *	other element sends reports the nvObj way. Filtered reports carry the changed
+ *	values only, like _populate_filtered_status_report(). Values that don't fit in the
+ *	output buffer are left for the next report. Text mode reports are not affected.
+ */
+static uint8_t _status_report_template_ready()
+{
+	if (sr.template_syntax == js.json_syntax) {
+		return (sr.template_ready);
+	}
+	nvObj_t scratch;
+	const char_t *quote = (js.json_syntax == JSON_SYNTAX_RELAXED) ? (const char_t *)"" : (const char_t *)"\"";
+
+	sprintf((char *)sr.template_head, "{%ssr%s:{", quote, quote);
+	sr.template_ready = true;
+	for (uint8_t i=0; i<sr.status_report_count; i++) {
+		uint16_t wp = nvStr.wp;
+		scratch.index = sr.status_report_list[i];
+		sr.status_report_get[i](&scratch);
+		nvStr.wp = wp;
+		if ((scratch.valuetype != TYPE_FLOAT) && (scratch.valuetype != TYPE_INTEGER)) {
+			sr.template_ready = false;
+		}
+		char_t token[TOKEN_LEN+1];
+		strcpy_P(token, cfgArray[scratch.index].token);
+		sprintf((char *)sr.template_name[i], "%s%s%s:", quote, token, quote);
+	}
+	sr.template_syntax = js.json_syntax;
+	return (sr.template_ready);
+}
 
-		nv_get_nvObj(nv);
-		// do not report values that have not changed...
-		// ...except for stat=3 (STOP), which is an exception
-		if (fp_EQ(nv->value, sr.status_report_value[i])) {
-//			if (nv->index != sr.stat_index) {
-//				if (fp_EQ(nv->value, COMBINED_PROGRAM_STOP)) {
-					nv->valuetype = TYPE_EMPTY;
-					continue;
-//				}
-//			}
-			// report anything that has changed
+static uint8_t _print_status_report_template(uint8_t filtered)
+{
+	char_t *str = cs.out_buf;
+	char_t *str_max = cs.out_buf + sizeof(cs.out_buf) - SR_TEMPLATE_VALUE_MAX;
+	nvObj_t scratch;
+	uint8_t count = 0;
+
+	str += strlen(strcpy(str, sr.template_head));
+	for (uint8_t i=0; i<sr.status_report_count; i++) {
+		uint16_t wp = nvStr.wp;
+		scratch.index = sr.status_report_list[i];
+		sr.status_report_get[i](&scratch);
+		nvStr.wp = wp;
+
+		if ((filtered == true) && (fp_EQ(scratch.value, sr.status_report_value[i]))) { continue;}
+		if (str > str_max) { break;}
+		sr.status_report_value[i] = scratch.value;
+
+		if (count++ != 0) { *str++ = ',';}
+		str += strlen(strcpy(str, sr.template_name[i]));
+		if (scratch.valuetype == TYPE_FLOAT) {
+			if (isnan((double)scratch.value) || isinf((double)scratch.value)) { scratch.value = 0;}
+			preprocess_float(&scratch);
+			str += fntoa(str, scratch.value, scratch.precision);
 		} else {
-			strcpy(tmp, nv->group);		// flatten out groups - WARNING - you cannot use strncpy here...
-			strcat(tmp, nv->token);
-			strcpy(nv->token, tmp);		//...or here.
-			sr.status_report_value[i] = nv->value;
-			if ((nv = nv->nx) == NULL) return (false); // should never be NULL unless SR length exceeds available buffer array
-			has_data = true;
+			str += fntoa(str, scratch.value, 0);
+		}
+	}
+	if (count == 0) {
+		return (false);						// no new data
+	}
+	strcpy(str, "}}\n");
+	fprintf(stderr, "%s", (char *)cs.out_buf);
+	return (true);
+}
+
+/*
+ * _populate_binary_status_report() - pack the fields selected by $sb into a payload
+ * _send_binary_status_report()	   - send a payload as a binary SR frame
+ *
+ *	Binary status reports skip the nvObj list and serialization entirely. The payload is
+ *	the 16 bit field mask followed by the selected fields in mask bit order (see report.h).
+ *	Values are the same as the JSON SR values (e.g. positions are in the active units).
+ *
+ *	The frame is a single line: STX, then the 1 byte payload length, the CRC-16/CCITT of
+ *	the payload (little-endian) and the payload, all sent 6 bits per char as '0' + bits -
+ *	the same packing as inbound Gcode frames (see gc_gcode_frame_parser()). That keeps
+ *	frames clear of line ends and flow control chars. Hosts can tell them from JSON and
+ *	text output by the leading STX. Filtered reports are only sent if the payload changed.
+ */
+static uint8_t *_pack_sr_float(uint8_t *wr, float value)
+{
+	memcpy(wr, &value, sizeof(float));
+	return (wr + sizeof(float));
+}
+
+static uint8_t _populate_binary_status_report(uint8_t *buf)
+{
+	uint16_t mask = (uint16_t)(sr.status_report_binary & SRB_FIELDS_MASK);
+	uint8_t *wr = buf;
+
+	*wr++ = (uint8_t)mask;
+	*wr++ = (uint8_t)(mask >> 8);
+	for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+		if (mask & (SRB_POSX << axis)) {
+			wr = _pack_sr_float(wr, cm_get_work_position(ACTIVE_MODEL, axis));
+		}
+	}
+	if (mask & SRB_VEL) {
+		float velocity = 0;
+		if (cm_get_motion_state() != MOTION_STOP) {
+			velocity = mp_get_runtime_velocity();
+			if (cm_get_units_mode(RUNTIME) == INCHES) velocity *= INCHES_PER_MM;
+		}
+		wr = _pack_sr_float(wr, velocity);
+	}
+	if (mask & SRB_FEED) {
+		float feed = cm_get_feed_rate(ACTIVE_MODEL);
+		if (cm_get_units_mode(ACTIVE_MODEL) == INCHES) feed *= INCHES_PER_MM;
+		wr = _pack_sr_float(wr, feed);
+	}
+	if (mask & SRB_LINE) {
+		int32_t linenum = (int32_t)cm_get_linenum(ACTIVE_MODEL);
+		memcpy(wr, &linenum, sizeof(int32_t));
+		wr += sizeof(int32_t);
+	}
+	if (mask & SRB_STAT) *wr++ = cm_get_combined_state();
+	if (mask & SRB_MOMO) *wr++ = cm_get_motion_mode(ACTIVE_MODEL);
+	if (mask & SRB_UNIT) *wr++ = cm_get_units_mode(ACTIVE_MODEL);
+	if (mask & SRB_COOR) *wr++ = cm_get_coord_system(ACTIVE_MODEL);
+	return (wr - buf);
+}
+
+static void _send_binary_status_report(uint8_t *buf, uint8_t length)
+{
+	uint16_t crc = compute_crc16(buf, length);
+	uint8_t header[3] = { length, (uint8_t)crc, (uint8_t)(crc >> 8) };
+	uint16_t bits = 0;
+	uint8_t bit_count = 0;
+
+	putchar(STX);
+	for (uint8_t i=0; i < length+3; i++) {
+		bits = (bits << 8) | ((i < 3) ? header[i] : buf[i-3]);
+		bit_count += 8;
+		while (bit_count >= 6) {
+			bit_count -= 6;
+			putchar('0' + ((bits >> bit_count) & 0x3F));
 		}
 	}
-	return (has_data);
+	if (bit_count != 0) {
+		putchar('0' + ((bits << (6 - bit_count)) & 0x3F));	// pad the leftover bits
+	}
+	putchar('\n');
 }
 
 /*
@@ -409,6 +790,17 @@ stat_t sr_set_si(nvObj_t *nv)
 	return(STAT_OK);
 }
 
+stat_t sr_set_sb(nvObj_t *nv)
+{
+	if ((nv->value < 0) || (nv->value > SRB_FIELDS_MASK)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	sr.status_report_binary = (uint32_t)nv->value;
+	sr.binary_length = 0;						// send the next report in full
+	nv->valuetype = TYPE_INTEGER;
+	return(STAT_OK);
+}
+
 /*********************
  * TEXT MODE SUPPORT *
  *********************/
@@ -416,10 +808,16 @@ stat_t sr_set_si(nvObj_t *nv)
 
 static const char fmt_si[] PROGMEM = "[si]  status interval%14.0f ms\n";
 static const char fmt_sv[] PROGMEM = "[sv]  status report verbosity%6d [0=off,1=filtered,2=verbose]\n";
+static const char fmt_jp[] PROGMEM = "[jp]  job profile%18d [0=off,1=on]\n";
+static const char fmt_sa[] PROGMEM = "[sa]  status report adaptive%7d [0=fixed interval,1=adaptive]\n";
+static const char fmt_sb[] PROGMEM = "[sb]  status report binary mask%4lu [0=off]\n";
 
 void sr_print_sr(nvObj_t *nv) { _populate_unfiltered_status_report();}
 void sr_print_si(nvObj_t *nv) { text_print_flt(nv, fmt_si);}
 void sr_print_sv(nvObj_t *nv) { text_print_ui8(nv, fmt_sv);}
+void jp_print_jp(nvObj_t *nv) { text_print_ui8(nv, fmt_jp);}
+void sr_print_sa(nvObj_t *nv) { text_print_ui8(nv, fmt_sa);}
+void sr_print_sb(nvObj_t *nv) { text_print_int(nv, fmt_sb);}
 
 #endif // __TEXT_MODE
 
@@ -427,19 +825,25 @@ void sr_print_sv(nvObj_t *nv) { text_print_ui8(nv, fmt_sv);}
 /*****************************************************************************
  * Queue Reports
  *
- *	Queue reports can report three values:
+ *	Queue reports can report four values:
  *	  - qr	queue depth - # of buffers availabel in planner queue
  *	  - qi	buffers added to planner queue since las report
  *	  - qo	buffers removed from planner queue since last report
+ *	  - qt	estimated time to run the moves queued behind the running move, in ms
  *
- *	A QR_SINGLE report returns qr only. A QR_TRIPLE returns all 3 values
+ *	A QR_SINGLE report returns qr only. A QR_TRIPLE returns the first 3 values and
+ *	QR_TIME returns all 4. qt lets a sender throttle on queued motion time rather than
+ *	on buffer count, which says little when the moves are of very different lengths.
  *
  *	There are 2 ways to get queue reports:
  *
  *	 1.	Enable single or triple queue reports using the QV variable. This will
- *		return a queue report every time the buffer depth changes
+ *		return a queue report when the buffer depth changes. Changes are coalesced:
+ *		a report is held until the depth has moved by $qd buffers since the last
+ *		report, $qm ms have passed, or the queue has drained. qi and qo accumulate
+ *		while a report is held. $qd=1 and $qm=0 report every change.
  *
- *	 2.	Add qr, qi and qo (or some combination) to the status report. This will
+ *	 2.	Add qr, qi, qo and qt (or some combination) to the status report. This will
  *		return queue report data when status reports are generated.
  */
 /*
@@ -500,11 +904,29 @@ stat_t qr_queue_report_callback() 		// called by controller dispatcher
 	if (qr.queue_report_requested == false)
         return (STAT_NOOP);
 
+	if (rpt_tx_has_room(RPT_PRIORITY_QUEUE) == false)
+		return (STAT_NOOP);					// hold the report - qi and qo keep accumulating
+
+	// coalesce changes until the depth has moved far enough, the interval has run or the queue drained
+	uint8_t delta = (qr.buffers_available > qr.prev_available) ?
+		qr.buffers_available - qr.prev_available : qr.prev_available - qr.buffers_available;
+	if ((delta < qr.queue_report_delta) && (qr.buffers_available != PLANNER_BUFFER_POOL_SIZE) &&
+		((SysTickTimer_getValue() - qr.report_tick) < qr.queue_report_interval)) {
+		return (STAT_NOOP);
+	}
+	qr.prev_available = qr.buffers_available;
+	qr.report_tick = SysTickTimer_getValue();
+
 	qr.queue_report_requested = false;
+	if (qr.queue_report_verbosity == QR_TIME) {
+		qr.queue_time = (uint32_t)mp_get_planner_queue_time();
+	}
 
 	if (cfg.comm_mode == TEXT_MODE) {
 		if (qr.queue_report_verbosity == QR_SINGLE) {
 			fprintf(stderr, "qr:%d\n", qr.buffers_available);
+		} else if (qr.queue_report_verbosity == QR_TIME) {
+			fprintf(stderr, "qr:%d, qi:%d, qo:%d, qt:%lu\n", qr.buffers_available,qr.buffers_added,qr.buffers_removed,qr.queue_time);
 		} else  {
 			fprintf(stderr, "qr:%d, qi:%d, qo:%d\n", qr.buffers_available,qr.buffers_added,qr.buffers_removed);
 		}
@@ -512,6 +934,8 @@ stat_t qr_queue_report_callback() 		// called by controller dispatcher
 	} else if (js.json_syntax == JSON_SYNTAX_RELAXED) {
 		if (qr.queue_report_verbosity == QR_SINGLE) {
 			fprintf(stderr, "{qr:%d}\n", qr.buffers_available);
+		} else if (qr.queue_report_verbosity == QR_TIME) {
+			fprintf(stderr, "{qr:%d,qi:%d,qo:%d,qt:%lu}\n", qr.buffers_available, qr.buffers_added,qr.buffers_removed,qr.queue_time);
 		} else {
 			fprintf(stderr, "{qr:%d,qi:%d,qo:%d}\n", qr.buffers_available, qr.buffers_added,qr.buffers_removed);
 		}
@@ -519,6 +943,8 @@ stat_t qr_queue_report_callback() 		// called by controller dispatcher
 	} else {
 		if (qr.queue_report_verbosity == QR_SINGLE) {
 			fprintf(stderr, "{\"qr\":%d}\n", qr.buffers_available);
+		} else if (qr.queue_report_verbosity == QR_TIME) {
+			fprintf(stderr, "{\"qr\":%d,\"qi\":%d,\"qo\":%d,\"qt\":%lu}\n", qr.buffers_available, qr.buffers_added,qr.buffers_removed,qr.queue_time);
 		} else {
 			fprintf(stderr, "{\"qr\":%d,\"qi\":%d,\"qo\":%d}\n", qr.buffers_available, qr.buffers_added,qr.buffers_removed);
 		}
@@ -548,6 +974,48 @@ stat_t rx_report_callback(void) {
     return (STAT_OK);
 }
 
+/*
+ * ak_init_ack_report() - reset the line count (when $jv is set)
+ * ak_accept_line() - record a gcode line whose OK response was suppressed
+ * ak_report_callback() - acknowledge the accepted lines, at most once per AK_REPORT_INTERVAL
+ *
+ *	In streaming mode ($jv=6) gcode lines that are accepted get no response (see
+ *	json_print_response()), and errors are reported as usual. The host is kept in step by
+ *	an ack carrying the count of lines accepted since streaming was selected, the last line
+ *	number received, and the free RX bytes:
+ *
+ *		{"ak":{"c":1234,"n":1230,"rx":212}}
+ *
+ *	The count is a running total, so a host that misses an ack is corrected by the next one.
+ */
+
+void ak_init_ack_report()
+{
+	ak.ack_pending = false;
+	ak.lines = 0;
+	ak.linenum = 0;
+}
+
+void ak_accept_line(uint32_t linenum)
+{
+	ak.ack_pending = true;
+	ak.lines++;
+	if (linenum != 0) ak.linenum = linenum;		// unnumbered lines keep the last line number
+}
+
+stat_t ak_report_callback()
+{
+	if (ak.ack_pending == false) return (STAT_NOOP);
+	uint32_t tick = SysTickTimer_getValue();
+	if ((tick - ak.ack_systick) < AK_REPORT_INTERVAL) return (STAT_NOOP);
+	if (rpt_tx_has_room(RPT_PRIORITY_QUEUE) == false) return (STAT_NOOP);
+
+	ak.ack_pending = false;
+	ak.ack_systick = tick;
+	fprintf(stderr, "{\"ak\":{\"c\":%lu,\"n\":%lu,\"rx\":%d}}\n", ak.lines, ak.linenum, xio_get_usb_rx_free());
+	return (STAT_OK);
+}
+
 /* Alternate Formulation for a Single report - using nvObj list
 
 	// get a clean nv object
@@ -570,6 +1038,7 @@ stat_t rx_report_callback(void) {
  * qr_get() - run a queue report (as data)
  * qi_get() - run a queue report - buffers in
  * qo_get() - run a queue report - buffers out
+ * qt_get() - run a queue report - time queued in the planner (ms)
  */
 stat_t qr_get(nvObj_t *nv)
 {
@@ -594,6 +1063,154 @@ stat_t qo_get(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+stat_t qt_get(nvObj_t *nv)
+{
+	nv->value = (float)((uint32_t)mp_get_planner_queue_time());
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+/*****************************************************************************
+ * JOB PROFILE
+ *
+ *	jp_init_job_profile()	  - clear the profile
+ *	jp_record_move()		  - add a finished move (called from the exec)
+ *	jp_record_limit()		  - add what held a retired move down (called from mp_free_run_buffer())
+ *	jp_request_job_profile()  - request a report (called at program end)
+ *	jp_job_profile_callback() - send a requested report and clear the profile
+ *	jp_set_jp()				  - enable or disable profiling ($jp) - clears the profile
+ *	jp_get_jpr()			  - send the report now ({"jpr":n})
+ *
+ *	When $jp is set the exec hands over each move as it finishes with its planned time
+ *	(length at the cruise velocity requested for the move) and the actual run time of its
+ *	segments. The difference is the time lost to acceleration, junctions and overrides.
+ *	Moves are grouped by line number as they arrive, so a line that is split into several
+ *	moves (blended corners, feedholds) counts once as long as its moves run back to back.
+ *	The JOB_PROFILE_LINES lines with the most excess time are kept.
+ *
+ *	As each buffer is retired the planner adds what held it below its cruise (see
+ *	mpCruiseLimit) and how many times it was replanned. The excess time is summed for
+ *	each limit, and each slow line keeps the limit and cruise velocity of its slowest move.
+ *	Lots of JUNCTION time points at the junction settings, LENGTH at short CAM segments,
+ *	VMAX at the axis limits, and a high replan count at a backward pass that keeps moving
+ *	(short blocks with a long braking distance). Dry runs ($dry) retire buffers too, so
+ *	the limits can be had without motion (with no times).
+ *
+ *	The report is a single JSON line sent at program end (M2, M30) or on request:
+ *	  {"jp":{"mv":moves,"pt":planned ms,"at":actual ms,"xt":excess ms,
+ *		"lm":[[moves,ms] for FEED,VMAX,JUNCTION,LENGTH],"rp":replans,"rx":most replans,
+ *		"sl":[[line,ms,limit,velocity],...]}}
+ */
+jpSingleton_t jp;
+
+static void _jp_commit_line(void)
+{
+	uint8_t i = JOB_PROFILE_LINES;
+	while ((i > 0) && (jp.line_excess > jp.slowest[i-1].excess_time)) {
+		if (i < JOB_PROFILE_LINES) jp.slowest[i] = jp.slowest[i-1];
+		i--;
+	}
+	if (i < JOB_PROFILE_LINES) {
+		jp.slowest[i].linenum = jp.linenum;
+		jp.slowest[i].excess_time = jp.line_excess;
+		jp.slowest[i].limit = jp.line_limit;
+		jp.slowest[i].velocity = jp.line_velocity;
+	}
+	jp.line_excess = 0;
+	jp.line_worst = 0;
+	jp.line_limit = MP_LIMIT_NONE;
+	jp.line_velocity = 0;
+}
+
+void jp_init_job_profile()
+{
+	uint8_t enable = jp.profile_enable;
+	memset(&jp, 0, sizeof(jp));
+	jp.profile_enable = enable;
+}
+
+void jp_record_move(uint32_t linenum, float planned_time, float actual_time)
+{
+	planned_time *= 60000;					// minutes to ms
+	actual_time *= 60000;
+	if (linenum != jp.linenum) {
+		_jp_commit_line();
+		jp.linenum = linenum;
+	}
+	jp.moves++;
+	jp.planned_time += planned_time;
+	jp.actual_time += actual_time;
+	jp.line_excess += actual_time - planned_time;
+	jp.move_excess += actual_time - planned_time;	// a move split by a hold is recorded in parts
+}
+
+void jp_record_limit(uint8_t limit, uint8_t replans, float velocity)
+{
+	if (limit != MP_LIMIT_NONE) {
+		jp.limit_moves[limit-1]++;
+		jp.limit_excess[limit-1] += jp.move_excess;
+		if ((jp.line_limit == MP_LIMIT_NONE) || (jp.move_excess > jp.line_worst)) {
+			jp.line_worst = jp.move_excess;
+			jp.line_limit = limit;
+			jp.line_velocity = velocity;
+		}
+		jp.replans += replans;
+		jp.replans_max = max(jp.replans_max, replans);
+	}
+	jp.move_excess = 0;
+}
+
+void jp_request_job_profile()
+{
+	if (jp.profile_enable == true) {
+		jp.report_requested = true;
+	}
+}
+
+static void _jp_print_job_profile(void)
+{
+	_jp_commit_line();						// include the last line
+	printf_P(PSTR("{\"jp\":{\"mv\":%lu,\"pt\":%0.0f,\"at\":%0.0f,\"xt\":%0.0f,\"lm\":["),
+		jp.moves, jp.planned_time, jp.actual_time, jp.actual_time - jp.planned_time);
+	for (uint8_t i=0; i < JOB_PROFILE_LIMITS; i++) {
+		printf_P(PSTR("%s[%lu,%0.0f]"), (i == 0) ? "" : ",", jp.limit_moves[i], jp.limit_excess[i]);
+	}
+	printf_P(PSTR("],\"rp\":%lu,\"rx\":%d,\"sl\":["), jp.replans, jp.replans_max);
+	for (uint8_t i=0; (i < JOB_PROFILE_LINES) && (jp.slowest[i].excess_time > 0); i++) {
+		printf_P(PSTR("%s[%lu,%0.0f,%d,%0.0f]"), (i == 0) ? "" : ",", jp.slowest[i].linenum,
+			jp.slowest[i].excess_time, jp.slowest[i].limit, jp.slowest[i].velocity);
+	}
+	printf_P(PSTR("]}}\n"));
+}
+
+stat_t jp_job_profile_callback()			// called by controller dispatcher
+{
+	if (jp.report_requested == false)
+		return (STAT_NOOP);
+	if (rpt_tx_has_room(RPT_PRIORITY_MESSAGE) == false)
+		return (STAT_NOOP);
+
+	_jp_print_job_profile();
+	jp_init_job_profile();					// clears the request, too
+	return (STAT_OK);
+}
+
+stat_t jp_set_jp(nvObj_t *nv)
+{
+	jp.profile_enable = (fp_ZERO(nv->value) ? false : true);
+	jp_init_job_profile();
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t jp_get_jpr(nvObj_t *nv)
+{
+	_jp_print_job_profile();
+	nv->value = (float)jp.moves;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
 /*****************************************************************************
  * JOB ID REPORTS
  *
@@ -675,12 +1292,18 @@ void job_print_job(nvObj_t *nv) { job_populate_job_report();}
 static const char fmt_qr[] PROGMEM = "qr:%d\n";
 static const char fmt_qi[] PROGMEM = "qi:%d\n";
 static const char fmt_qo[] PROGMEM = "qo:%d\n";
-static const char fmt_qv[] PROGMEM = "[qv]  queue report verbosity%7d [0=off,1=single,2=triple]\n";
+static const char fmt_qt[] PROGMEM = "qt:%d\n";
+static const char fmt_qv[] PROGMEM = "[qv]  queue report verbosity%7d [0=off,1=single,2=triple,3=time]\n";
+static const char fmt_qd[] PROGMEM = "[qd]  queue report buffer delta%4d buffers\n";
+static const char fmt_qm[] PROGMEM = "[qm]  queue report interval%8lu ms\n";
 
 void qr_print_qr(nvObj_t *nv) { text_print_int(nv, fmt_qr);}
 void qr_print_qi(nvObj_t *nv) { text_print_int(nv, fmt_qi);}
 void qr_print_qo(nvObj_t *nv) { text_print_int(nv, fmt_qo);}
+void qr_print_qt(nvObj_t *nv) { text_print_int(nv, fmt_qt);}
 void qr_print_qv(nvObj_t *nv) { text_print_ui8(nv, fmt_qv);}
+void qr_print_qd(nvObj_t *nv) { text_print_ui8(nv, fmt_qd);}
+void qr_print_qm(nvObj_t *nv) { text_print_int(nv, fmt_qm);}
 
 #endif // __TEXT_MODE
 
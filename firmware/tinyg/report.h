@@ -39,6 +39,7 @@ extern "C"{
 //		- The status report defaults can be found in settings.h
 
 #define MIN_ARC_QR_INTERVAL 200					// minimum interval between QRs during arc generation (in system ticks)
+#define AK_REPORT_INTERVAL 100					// ms between line acknowledgements in streaming mode ($jv=6)
 
 enum srVerbosity {								// status report enable and verbosity
 	SR_OFF = 0,									// no reports
@@ -46,15 +47,53 @@ enum srVerbosity {								// status report enable and verbosity
 	SR_VERBOSE									// reports all values specified
 };
 
+enum rptPriority {								// priority classes for output that competes for the TX buffer
+	RPT_PRIORITY_RESPONSE = 0,					// responses and exceptions - always sent
+	RPT_PRIORITY_QUEUE,							// queue reports
+	RPT_PRIORITY_STATUS,						// status reports
+	RPT_PRIORITY_MESSAGE						// other unsolicited reports (e.g. job profile)
+};
+
+#define RPT_TX_FREE_QUEUE	48					// TX chars that must be free to send a queue report
+#define RPT_TX_FREE_STATUS	128					// ...a status report
+#define RPT_TX_FREE_MESSAGE	192					// ...an unsolicited message
+
 enum cmStatusReportRequest {
 	SR_TIMED_REQUEST = 0,						// request a status report at next timer interval
 	SR_IMMEDIATE_REQUEST						// request a status report ASAP
 };
 
+// Binary status report fields. Set bits in $sb to select the fields for the frame.
+// Fields are packed in bit order: positions, vel and feed are floats, line is an
+// int32 and the enumerations are one byte each - all little-endian
+#define SRB_POSX	0x0001						// work positions (float)
+#define SRB_POSY	0x0002
+#define SRB_POSZ	0x0004
+#define SRB_POSA	0x0008
+#define SRB_POSB	0x0010
+#define SRB_POSC	0x0020
+#define SRB_VEL		0x0040						// runtime velocity (float)
+#define SRB_FEED	0x0080						// feed rate (float)
+#define SRB_LINE	0x0100						// line number (int32)
+#define SRB_STAT	0x0200						// combined machine state (uint8)
+#define SRB_MOMO	0x0400						// motion mode (uint8)
+#define SRB_UNIT	0x0800						// units mode (uint8)
+#define SRB_COOR	0x1000						// coordinate system (uint8)
+#define SRB_FIELDS_MASK 0x1FFF
+
+#define SR_BINARY_PAYLOAD_MAX 44				// mask + all fields
+
+#define SR_TEMPLATE_STALE 0xFF					// template_syntax value that forces a rebuild
+#define SR_TEMPLATE_VALUE_MAX 48				// room left in the output buffer for one value
+
+#define SR_ADAPTIVE_VELOCITY_CHANGE 0.05		// fractional velocity change that triggers an adaptive report
+#define SR_ADAPTIVE_VELOCITY_MIN 10.0			// ...but never less than this (mm/min)
+
 enum qrVerbosity {								// planner queue enable and verbosity
 	QR_OFF = 0,									// no response is provided
 	QR_SINGLE,									// queue depth reported
-	QR_TRIPLE									// queue depth reported for buffers, buffers added, buffered removed
+	QR_TRIPLE,									// queue depth reported for buffers, buffers added, buffered removed
+	QR_TIME										// triple report plus the time queued in the planner
 };
 
 typedef struct srSingleton {
@@ -62,13 +101,29 @@ typedef struct srSingleton {
 	/*** config values (PUBLIC) ***/
 	uint8_t status_report_verbosity;
 	uint32_t status_report_interval;					// in milliseconds
+	uint8_t status_report_adaptive;						// pace timed reports from the runtime state
 
 	/*** runtime values (PRIVATE) ***/
 	uint8_t status_report_requested;					// flag that SR has been requested
 	uint32_t status_report_systick;						// SysTick value for next status report
+	uint8_t status_report_immediate;					// an immediate report is pending
+	uint8_t adaptive_state;								// combined state at the last report
+	float adaptive_velocity;							// runtime velocity at the last report
+	uint32_t adaptive_systick;							// SysTick value of the last report
 	index_t stat_index;									// table index value for stat - determined during initialization
 	index_t status_report_list[NV_STATUS_REPORT_LEN];	// status report elements to report
 	float status_report_value[NV_STATUS_REPORT_LEN];	// previous values for filtered reporting
+	fptrCmd status_report_get[NV_STATUS_REPORT_LEN];	// resolved get functions for the SR elements
+	uint8_t status_report_count;						// number of elements in the SR list
+
+	uint8_t template_syntax;							// JSON syntax the SR template was built for
+	uint8_t template_ready;								// every SR element fits a numeric value slot
+	char_t template_head[8];							// {"sr":{ in the template syntax
+	char_t template_name[NV_STATUS_REPORT_LEN][TOKEN_LEN+4];	// "token": for each SR element
+
+	uint32_t status_report_binary;						// binary SR field mask - 0 = text/JSON reports
+	uint8_t binary_length;								// payload length of the last binary frame sent
+	uint8_t binary_payload[SR_BINARY_PAYLOAD_MAX];		// payload of the last binary frame sent
 
 } srSingleton_t;
 
@@ -76,6 +131,8 @@ typedef struct qrSingleton {		// data for queue reports
 
 	/*** config values (PUBLIC) ***/
 	uint8_t queue_report_verbosity;	// queue reports enabled and verbosity level
+	uint8_t queue_report_delta;		// report once the depth has moved this many buffers...
+	uint32_t queue_report_interval;	// ...or this many ms have passed since the last report
 
 	/*** runtime values (PRIVATE) ***/
 	uint8_t queue_report_requested;	// set to true to request a report
@@ -83,28 +140,95 @@ typedef struct qrSingleton {		// data for queue reports
 	uint8_t prev_available;			// buffers available at last count
 	uint16_t buffers_added;			// buffers added since last count
 	uint16_t buffers_removed;		// buffers removed since last report
+	uint32_t queue_time;			// estimated time to run the queued moves (ms)
 	uint8_t motion_mode;			// used to detect arc movement
 	uint32_t init_tick;				// time when values were last initialized or cleared
+	uint32_t report_tick;			// time of the last report
 
 } qrSingleton_t;
 
+#define JOB_PROFILE_LINES 5						// slowest lines kept by the job profile
+#define JOB_PROFILE_LIMITS 4					// MP_LIMITS - one per mpCruiseLimit except MP_LIMIT_NONE
+
+typedef struct jpLine {							// a line in the job profile
+	uint32_t linenum;							// Gcode line number
+	float excess_time;							// ms run beyond the planned time
+	uint8_t limit;								// what held its slowest move (see mpCruiseLimit)
+	float velocity;								// cruise velocity of that move (mm/min)
+} jpLine_t;
+
+typedef struct jpSingleton {					// job profile - planned vs. actual move times
+	/*** config values (PUBLIC) ***/
+	uint8_t profile_enable;						// $jp
+
+	/*** runtime values (PRIVATE) ***/
+	uint8_t report_requested;					// report at the next callback (program end)
+	uint32_t moves;								// moves profiled
+	float planned_time;							// total planned time (ms)
+	float actual_time;							// total actual time (ms)
+	uint32_t linenum;							// line being accumulated
+	float line_excess;							// excess time of that line so far (ms)
+	float line_worst;							// excess time of its slowest move so far (ms)
+	uint8_t line_limit;							// ...what held that move
+	float line_velocity;						// ...and its cruise velocity
+	float move_excess;							// excess time of the move being retired (ms)
+	uint32_t limit_moves[JOB_PROFILE_LIMITS];			// moves retired by each limit (FEED, VMAX, JUNCTION, LENGTH)
+	float limit_excess[JOB_PROFILE_LIMITS];				// excess time of those moves (ms)
+	uint32_t replans;							// replans of the retired moves
+	uint8_t replans_max;						// most replans of a single move
+	jpLine_t slowest[JOB_PROFILE_LINES];		// most accel-limited lines, worst first
+} jpSingleton_t;
+
 typedef struct rxSingleton {
     uint8_t rx_report_requested;
     uint16_t space_available;       // space available in usb rx buffer at time of request
 } rxSingleton_t;
 
+#define EXCEPTION_LOG_LEN 8						// exceptions kept in RAM (see rpt_exception())
+#define EXCEPTION_SAVE_LEN 3					// newest exceptions saved to NVM at a hard alarm
+#define EXCEPTION_RECORD_LEN 10					// NVM bytes per saved exception
+
+typedef struct elEntry {						// an exception as logged
+	uint32_t systick;							// time of the exception (ms since reset)
+	uint32_t linenum;							// model line number
+	uint8_t status;								// status code reported
+	uint8_t machine_state;						// cm.machine_state when it was reported
+} elEntry_t;
+
+typedef struct elSingleton {					// exception log - ring of the latest exceptions
+	uint8_t next;								// slot for the next exception
+	uint8_t count;								// exceptions in the ring
+	elEntry_t ex[EXCEPTION_LOG_LEN];
+} elSingleton_t;
+
+typedef struct akSingleton {					// line acknowledgements for streaming mode ($jv=6)
+	uint8_t ack_pending;						// lines were accepted since the last ack
+	uint32_t lines;								// gcode lines accepted since streaming mode was selected
+	uint32_t linenum;							// line number of the last accepted line
+	uint32_t ack_systick;						// time of the last ack
+} akSingleton_t;
+
 /**** Externs - See report.c for allocation ****/
 
 extern srSingleton_t sr;
 extern qrSingleton_t qr;
 extern rxSingleton_t rx;
+extern akSingleton_t ak;
+extern jpSingleton_t jp;
+extern elSingleton_t el;
 
 /**** Function Prototypes ****/
 
 void rpt_print_message(char *msg);
 stat_t rpt_exception(uint8_t status);
+uint8_t rpt_tx_has_room(uint8_t priority);
 
 stat_t rpt_er(nvObj_t *nv);
+void rpt_save_exceptions(void);
+stat_t rpt_get_exl(nvObj_t *nv);
+stat_t rpt_set_exl(nvObj_t *nv);
+stat_t rpt_get_exs(nvObj_t *nv);
+stat_t rpt_set_exs(nvObj_t *nv);
 void rpt_print_loading_configs_message(void);
 void rpt_print_initializing_message(void);
 void rpt_print_system_ready_message(void);
@@ -118,6 +242,7 @@ stat_t sr_run_text_status_report(void);
 stat_t sr_get(nvObj_t *nv);
 stat_t sr_set(nvObj_t *nv);
 stat_t sr_set_si(nvObj_t *nv);
+stat_t sr_set_sb(nvObj_t *nv);
 //void sr_print_sr(nvObj_t *nv);
 
 void qr_init_queue_report(void);
@@ -127,29 +252,54 @@ stat_t qr_queue_report_callback(void);
 void rx_request_rx_report(void);
 stat_t rx_report_callback(void);
 
+void ak_init_ack_report(void);
+void ak_accept_line(uint32_t linenum);
+stat_t ak_report_callback(void);
+
+void jp_init_job_profile(void);
+void jp_record_move(uint32_t linenum, float planned_time, float actual_time);
+void jp_record_limit(uint8_t limit, uint8_t replans, float velocity);
+void jp_request_job_profile(void);
+stat_t jp_job_profile_callback(void);
+stat_t jp_set_jp(nvObj_t *nv);
+stat_t jp_get_jpr(nvObj_t *nv);
+
 stat_t qr_get(nvObj_t *nv);
 stat_t qi_get(nvObj_t *nv);
 stat_t qo_get(nvObj_t *nv);
+stat_t qt_get(nvObj_t *nv);
 
 #ifdef __TEXT_MODE
 
 	void sr_print_sr(nvObj_t *nv);
 	void sr_print_si(nvObj_t *nv);
 	void sr_print_sv(nvObj_t *nv);
+	void sr_print_sa(nvObj_t *nv);
+	void jp_print_jp(nvObj_t *nv);
+	void sr_print_sb(nvObj_t *nv);
 	void qr_print_qv(nvObj_t *nv);
+	void qr_print_qd(nvObj_t *nv);
+	void qr_print_qm(nvObj_t *nv);
 	void qr_print_qr(nvObj_t *nv);
 	void qr_print_qi(nvObj_t *nv);
 	void qr_print_qo(nvObj_t *nv);
+	void qr_print_qt(nvObj_t *nv);
 
 #else
 
 	#define sr_print_sr tx_print_stub
 	#define sr_print_si tx_print_stub
 	#define sr_print_sv tx_print_stub
+	#define sr_print_sa tx_print_stub
+	#define jp_print_jp tx_print_stub
+	#define sr_print_sb tx_print_stub
 	#define qr_print_qv tx_print_stub
+	#define qr_print_qd tx_print_stub
+	#define qr_print_qm tx_print_stub
 	#define qr_print_qr tx_print_stub
 	#define qr_print_qi tx_print_stub
 	#define qr_print_qo tx_print_stub
+	#define qr_print_qt tx_print_stub
 
 #endif // __TEXT_MODE
 
@@ -42,8 +42,44 @@
 
 // Machine configuration settings
 #define CHORDAL_TOLERANCE 			0.01					// chordal accuracy for arc drawing
+#define LINE_MERGE_TOLERANCE		0.0						// max deviation for merging short collinear lines (0 = off)
+#define QUEUE_GOVERNOR_TIME_MS		0						// slow feeds down when less than this much motion is queued (0 = off)
+#define PLANNER_PRIME_BUFFERS		0						// start a cycle once this many buffers are queued (0 = off)
+#define PLANNER_PRIME_TIME_MS		0						// ...or once this much motion is queued (0 = off)
+#define PLANNER_PRIME_TIMEOUT_MS	100						// ...or once the first move has waited this long
 #define SOFT_LIMIT_ENABLE			0						// 0 = off, 1 = on
+#define SEGMENT_COMMANDS			0						// 0 = spindle and coolant commands stop motion, 1 = run them at segment boundaries
+#define TUNING_MARGIN				0.75					// fraction of the tuning cycle results written to the axis
+#define TUNING_WRITE				false					// true = the tuning cycle writes its results to the axis jm and vm
 #define SWITCH_TYPE 				SW_TYPE_NORMALLY_OPEN	// one of: SW_TYPE_NORMALLY_OPEN, SW_TYPE_NORMALLY_CLOSED
+#define SWITCH_FILTER				SW_FILTER_RTC			// one of: SW_FILTER_RTC, SW_FILTER_EDGE
+#define KINEMATICS					KINEMATICS_CARTESIAN	// one of: KINEMATICS_CARTESIAN, KINEMATICS_COREXY, KINEMATICS_HBOT, KINEMATICS_DELTA, KINEMATICS_RTCP
+#define DELTA_RADIUS				100.0					// delta only: horizontal distance from center to each tower at the effector
+#define DELTA_ROD_LENGTH			250.0					// delta only: diagonal rod length
+#define RTCP_PIVOT_X				0.0						// RTCP only: machine position where the A and C axes cross
+#define RTCP_PIVOT_Y				0.0
+#define RTCP_PIVOT_Z				0.0
+#define PITCH_X_START				0.0						// pitch map: machine position of the first correction point
+#define PITCH_X_SPACING			0.0						// pitch map: distance between correction points (0 = no map)
+#define PITCH_Y_START				0.0
+#define PITCH_Y_SPACING			0.0
+#define PITCH_Z_START				0.0
+#define PITCH_Z_SPACING			0.0
+#define SKEW_XY					0.0						// skew: X correction per unit of Y (0 = square)
+#define SKEW_XZ					0.0						// skew: X correction per unit of Z
+#define SKEW_YZ					0.0						// skew: Y correction per unit of Z
+#define PRESET_1_JERK_SCALE		1.5						// G187 P1 rough: jerk multiplier (0 = base jerk)
+#define PRESET_1_JUNCTION_ACCEL	0.0						// junction acceleration (0 = $ja)
+#define PRESET_1_SEGMENT_USEC		7500.0					// segment time in ramps and arcs (0 = 5000 uSec)
+#define PRESET_1_CHORDAL_TOLERANCE	0.02					// chordal tolerance (0 = $ct)
+#define PRESET_2_JERK_SCALE		1.0						// G187 P2 medium
+#define PRESET_2_JUNCTION_ACCEL	0.0
+#define PRESET_2_SEGMENT_USEC		0.0
+#define PRESET_2_CHORDAL_TOLERANCE	0.0
+#define PRESET_3_JERK_SCALE		0.5						// G187 P3 finish
+#define PRESET_3_JUNCTION_ACCEL	0.0
+#define PRESET_3_SEGMENT_USEC		3750.0
+#define PRESET_3_CHORDAL_TOLERANCE	0.005
 
 #define MOTOR_POWER_MODE			MOTOR_POWERED_IN_CYCLE	// one of: MOTOR_DISABLED					(0)
 															//		   MOTOR_ALWAYS_POWERED				(1)
@@ -52,24 +88,35 @@
 
 #define MOTOR_IDLE_TIMEOUT			2.00					// seconds to maintain motor at full power before idling
 #define MOTOR_POWER_LEVEL			0.25					// default motor power level (0,000 - 1.000, ARM only)
+#define DDA_MODE				DDA_CONSTANT_RATE			// one of: DDA_CONSTANT_RATE, DDA_VARIABLE_RATE (Xmega only)
+#define MICROSTEP_MORPH_RATE		0						// microsteps/sec above which motors run full steps, 0 = off
+#define UNDERRUN_BACKOFF			0						// fraction to slow motion by on repeated stepper underruns, 0 = off
 
 // Communications and reporting settings
 #define COMM_MODE					JSON_MODE				// one of: TEXT_MODE, JSON_MODE
 #define TEXT_VERBOSITY				TV_VERBOSE				// one of: TV_SILENT, TV_VERBOSE
 #define NETWORK_MODE				NETWORK_STANDALONE
+#define PENDANT_ENABLE				false					// true = read pendant lines from RS485 (standalone only)
+#define PENDANT_MIRROR				0						// output mirrored to RS485: 0=off, else a mask of XIO_OUT_ classes (see xio.h)
 
-#define JSON_VERBOSITY				JV_MESSAGES				// one of: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE
+#define JSON_VERBOSITY				JV_MESSAGES				// one of: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE, JV_STREAMING
 #define JSON_SYNTAX_MODE 			JSON_SYNTAX_STRICT		// one of JSON_SYNTAX_RELAXED, JSON_SYNTAX_STRICT
+#define JSON_FOOTER_CHECKSUM		JSON_CHECKSUM_HASH		// one of JSON_CHECKSUM_HASH, JSON_CHECKSUM_CRC16
 #define JSON_FOOTER_DEPTH			0						// 0 = new style, 1 = old style
 
 #define STATUS_REPORT_VERBOSITY		SR_FILTERED				// one of: SR_OFF, SR_FILTERED, SR_VERBOSE=
 #define STATUS_REPORT_MIN_MS		100						// milliseconds - enforces a viable minimum
 #define STATUS_REPORT_INTERVAL_MS	500						// milliseconds - set $SV=0 to disable
+#define JOB_PROFILE_ENABLE			false					// true = report planned vs. actual move times at program end
+#define STATUS_REPORT_ADAPTIVE		false					// true = pace timed reports by motion (see report.c)
+#define STATUS_REPORT_BINARY		0						// binary SR field mask (SRB_xxx), 0 = off
 #define STATUS_REPORT_DEFAULTS "posx","posy","posz","posa","feed","vel","unit","coor","dist","frmo","stat"
 //tgfx-friendly defaults
 //#define STATUS_REPORT_DEFAULTS "line","vel","mpox","mpoy","mpoz","mpoa","coor","ofsa","ofsx","ofsy","ofsz","dist","unit","stat","homz","homy","homx","momo"
 
 #define QUEUE_REPORT_VERBOSITY		QR_OFF					// one of: QR_OFF, QR_SINGLE, QR_TRIPLE
+#define QUEUE_REPORT_BUFFER_DELTA	4						// buffers - coalesce queue reports until the depth moves this far...
+#define QUEUE_REPORT_INTERVAL_MS	50						// ...or this many ms have passed. $qd=1, $qm=0 reports every change
 
 // Gcode startup defaults
 #define GCODE_DEFAULT_UNITS			MILLIMETERS				// MILLIMETERS or INCHES
@@ -81,7 +128,14 @@
 // Comm mode and echo levels
 #define COM_EXPAND_CR				false
 #define COM_ENABLE_ECHO				false
-#define COM_ENABLE_FLOW_CONTROL		FLOW_CONTROL_XON		// FLOW_CONTROL_OFF, FLOW_CONTROL_XON, FLOW_CONTROL_RTS
+#define COM_ENABLE_FLOW_CONTROL		FLOW_CONTROL_XON		// FLOW_CONTROL_OFF, FLOW_CONTROL_XON, FLOW_CONTROL_RTS, FLOW_CONTROL_COUNT
+#define COM_LINE_CHECK				false					// N line numbers and *checksums with resend requests
+
+// System integrity assertions
+#define ASSERTION_LEVEL				ASSERT_SLICED			// one of: ASSERT_CHEAP, ASSERT_SLICED, ASSERT_FULL
+
+// Controller idle
+#define IDLE_SLEEP					true					// sleep the CPU between passes when there is nothing to do
 
 //**** DEBUG SETTINGS ****
 
@@ -91,7 +145,7 @@
 #define QUEUE_REPORT_VERBOSITY		QR_SINGLE				// one of: QR_OFF, QR_SINGLE, QR_TRIPLE
 
 #undef JSON_VERBOSITY
-#define JSON_VERBOSITY				JV_MESSAGES				// one of: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE
+#define JSON_VERBOSITY				JV_MESSAGES				// one of: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE, JV_STREAMING
 
 #undef STATUS_REPORT_DEFAULTS
 #define STATUS_REPORT_DEFAULTS "posx","posy","posz","posa","feed","vel","unit","coor","dist","frmo","stat"
@@ -132,6 +186,377 @@
 #define P1_PWM_PHASE_OFF                0.1
 #endif //P1_PWM_FREQUENCY
 
+#ifndef P1_LASER_MODE
+#define P1_LASER_MODE					0					// p1lsr	1 = PWM_1 power follows the segment velocity
+#endif
+
+#ifndef P1_DITHER
+#define P1_DITHER						0					// p1dth	1 = dither the laser power below one PWM count
+#endif
+
+#ifndef P1_SPINDLE_ACCEL
+#define P1_SPINDLE_ACCEL				0					// p1acc	RPM/s the spindle ramps at; 0 = feeds don't wait for it
+#endif
+
+#ifndef P1_ENCODER_COUNTS
+#define P1_ENCODER_COUNTS				0					// p1enc	spindle encoder counts/rev for G33; 0 = no encoder
+#endif
+
+// PWM_2 is a second spindle or laser, driven while tool P2_TOOL is loaded (see spindle.c)
+#ifndef	P2_PWM_FREQUENCY
+#define P2_PWM_FREQUENCY                1000				// in Hz
+#define P2_CW_SPEED_LO                  0					// in RPM (arbitrary units)
+#define P2_CW_SPEED_HI                  1000
+#define P2_CW_PHASE_LO                  0					// phase [0..1]
+#define P2_CW_PHASE_HI                  1
+#define P2_CCW_SPEED_LO                 0
+#define P2_CCW_SPEED_HI                 1000
+#define P2_CCW_PHASE_LO                 0
+#define P2_CCW_PHASE_HI                 1
+#define P2_PWM_PHASE_OFF                0
+#endif //P2_PWM_FREQUENCY
+
+#ifndef P2_LASER_MODE
+#define P2_LASER_MODE					0					// p2lsr	1 = PWM_2 power follows the segment velocity
+#endif
+
+#ifndef P2_TOOL
+#define P2_TOOL							0					// p2tn		tool that drives PWM_2; 0 = PWM_2 off
+#endif
+
+// Analog inputs read PB4-PB7 at full scale = 1 (see analog.h)
+#ifndef AN1_PIN
+#define AN1_PIN							4					// an1p		PORTB pin read by the input
+#define AN2_PIN							5
+#define AN3_PIN							6
+#define AN4_PIN							7
+#endif
+#ifndef AN1_SCALE
+#define AN1_SCALE						1					// an1k		units at the ADC reference voltage
+#define AN2_SCALE						1
+#define AN3_SCALE						1
+#define AN4_SCALE						1
+#endif
+
+
+// Encoders and following error limits default to off. Step correction defaults (see encoder.h)
+#ifndef M1_ENCODER_COUNTS
+#define M1_ENCODER_COUNTS				0					// 1ec		counts per revolution; 0 = no encoder
+#endif
+#ifndef M1_FOLLOWING_ERROR_LIMIT
+#define M1_FOLLOWING_ERROR_LIMIT		0					// 1fl		steps of following error that alarm; 0 = off
+#endif
+#ifndef M1_CORRECTION_THRESHOLD
+#define M1_CORRECTION_THRESHOLD		2.0					// 1ct		steps of following error that are corrected; 0 = off
+#endif
+#ifndef M1_CORRECTION_FACTOR
+#define M1_CORRECTION_FACTOR		0.25					// 1cf		fraction of the error corrected at a time
+#endif
+#ifndef M1_CORRECTION_MAX
+#define M1_CORRECTION_MAX		0.60					// 1cm		max steps corrected per segment
+#endif
+#ifndef M2_ENCODER_COUNTS
+#define M2_ENCODER_COUNTS				0
+#endif
+#ifndef M2_FOLLOWING_ERROR_LIMIT
+#define M2_FOLLOWING_ERROR_LIMIT		0
+#endif
+#ifndef M2_CORRECTION_THRESHOLD
+#define M2_CORRECTION_THRESHOLD		2.0
+#endif
+#ifndef M2_CORRECTION_FACTOR
+#define M2_CORRECTION_FACTOR		0.25
+#endif
+#ifndef M2_CORRECTION_MAX
+#define M2_CORRECTION_MAX		0.60
+#endif
+#ifndef M3_ENCODER_COUNTS
+#define M3_ENCODER_COUNTS				0
+#endif
+#ifndef M3_FOLLOWING_ERROR_LIMIT
+#define M3_FOLLOWING_ERROR_LIMIT		0
+#endif
+#ifndef M3_CORRECTION_THRESHOLD
+#define M3_CORRECTION_THRESHOLD		2.0
+#endif
+#ifndef M3_CORRECTION_FACTOR
+#define M3_CORRECTION_FACTOR		0.25
+#endif
+#ifndef M3_CORRECTION_MAX
+#define M3_CORRECTION_MAX		0.60
+#endif
+#ifndef M4_ENCODER_COUNTS
+#define M4_ENCODER_COUNTS				0
+#endif
+#ifndef M4_FOLLOWING_ERROR_LIMIT
+#define M4_FOLLOWING_ERROR_LIMIT		0
+#endif
+#ifndef M4_CORRECTION_THRESHOLD
+#define M4_CORRECTION_THRESHOLD		2.0
+#endif
+#ifndef M4_CORRECTION_FACTOR
+#define M4_CORRECTION_FACTOR		0.25
+#endif
+#ifndef M4_CORRECTION_MAX
+#define M4_CORRECTION_MAX		0.60
+#endif
+#ifndef M5_ENCODER_COUNTS
+#define M5_ENCODER_COUNTS				0
+#endif
+#ifndef M5_FOLLOWING_ERROR_LIMIT
+#define M5_FOLLOWING_ERROR_LIMIT		0
+#endif
+#ifndef M5_CORRECTION_THRESHOLD
+#define M5_CORRECTION_THRESHOLD		2.0
+#endif
+#ifndef M5_CORRECTION_FACTOR
+#define M5_CORRECTION_FACTOR		0.25
+#endif
+#ifndef M5_CORRECTION_MAX
+#define M5_CORRECTION_MAX		0.60
+#endif
+#ifndef M6_ENCODER_COUNTS
+#define M6_ENCODER_COUNTS				0
+#endif
+#ifndef M6_FOLLOWING_ERROR_LIMIT
+#define M6_FOLLOWING_ERROR_LIMIT		0
+#endif
+#ifndef M6_CORRECTION_THRESHOLD
+#define M6_CORRECTION_THRESHOLD		2.0
+#endif
+#ifndef M6_CORRECTION_FACTOR
+#define M6_CORRECTION_FACTOR		0.25
+#endif
+#ifndef M6_CORRECTION_MAX
+#define M6_CORRECTION_MAX		0.60
+#endif
+
+// Backlash compensation defaults to off (see stepper.h)
+#ifndef M1_BACKLASH
+#define M1_BACKLASH			0					// 1bl		mm of travel taken up on a direction change; 0 = off
+#endif
+#ifndef M2_BACKLASH
+#define M2_BACKLASH			0
+#endif
+#ifndef M3_BACKLASH
+#define M3_BACKLASH			0
+#endif
+#ifndef M4_BACKLASH
+#define M4_BACKLASH			0
+#endif
+#ifndef M5_BACKLASH
+#define M5_BACKLASH			0
+#endif
+#ifndef M6_BACKLASH
+#define M6_BACKLASH			0
+#endif
+
+// Motors default to squaring on their axis switches (see stepper.h)
+#ifndef M1_SQUARE_SWITCHES
+#define M1_SQUARE_SWITCHES		0					// 1sq		axis of the switches a gantry motor squares on; 0 = its own axis
+#endif
+#ifndef M2_SQUARE_SWITCHES
+#define M2_SQUARE_SWITCHES		0
+#endif
+#ifndef M3_SQUARE_SWITCHES
+#define M3_SQUARE_SWITCHES		0
+#endif
+#ifndef M4_SQUARE_SWITCHES
+#define M4_SQUARE_SWITCHES		0
+#endif
+#ifndef M5_SQUARE_SWITCHES
+#define M5_SQUARE_SWITCHES		0
+#endif
+#ifndef M6_SQUARE_SWITCHES
+#define M6_SQUARE_SWITCHES		0
+#endif
+
+// Boost and idle power levels default to off - the power level is used throughout (ARM only)
+#ifndef M1_POWER_BOOST
+#define M1_POWER_BOOST			0					// 1pb		power level in the head and tail of lines; 0 = power level
+#endif
+#ifndef M2_POWER_BOOST
+#define M2_POWER_BOOST			0
+#endif
+#ifndef M3_POWER_BOOST
+#define M3_POWER_BOOST			0
+#endif
+#ifndef M4_POWER_BOOST
+#define M4_POWER_BOOST			0
+#endif
+#ifndef M5_POWER_BOOST
+#define M5_POWER_BOOST			0
+#endif
+#ifndef M6_POWER_BOOST
+#define M6_POWER_BOOST			0
+#endif
+#ifndef M1_POWER_IDLE
+#define M1_POWER_IDLE			0					// 1pi		power level once the runtime has stopped; 0 = power level
+#endif
+#ifndef M2_POWER_IDLE
+#define M2_POWER_IDLE			0
+#endif
+#ifndef M3_POWER_IDLE
+#define M3_POWER_IDLE			0
+#endif
+#ifndef M4_POWER_IDLE
+#define M4_POWER_IDLE			0
+#endif
+#ifndef M5_POWER_IDLE
+#define M5_POWER_IDLE			0
+#endif
+#ifndef M6_POWER_IDLE
+#define M6_POWER_IDLE			0
+#endif
+
+// Homing groups default to homing each axis on its own
+#ifndef X_HOMING_GROUP
+#define X_HOMING_GROUP					0					// xhg		axes with the same non-zero group home together
+#endif
+#ifndef Y_HOMING_GROUP
+#define Y_HOMING_GROUP					0
+#endif
+#ifndef Z_HOMING_GROUP
+#define Z_HOMING_GROUP					0
+#endif
+#ifndef A_HOMING_GROUP
+#define A_HOMING_GROUP					0
+#endif
+
+// Quick re-homing is off until a window is set (see cycle_homing.c)
+#ifndef X_HOMING_WINDOW
+#define X_HOMING_WINDOW					0					// xhw		mm either side of the known switch, 0=full search
+#endif
+#ifndef Y_HOMING_WINDOW
+#define Y_HOMING_WINDOW					0
+#endif
+#ifndef Z_HOMING_WINDOW
+#define Z_HOMING_WINDOW					0
+#endif
+#ifndef A_HOMING_WINDOW
+#define A_HOMING_WINDOW					0
+#endif
+
+// Input shaping defaults to off (see plan_shaper.c)
+#ifndef X_SHAPER_TYPE
+#define X_SHAPER_TYPE					0					// xit		0=off, 1=ZV, 2=ZVD, 3=EI
+#endif
+#ifndef X_SHAPER_FREQUENCY
+#define X_SHAPER_FREQUENCY				0					// xif		Hz - the frame's ringing frequency
+#endif
+#ifndef X_SHAPER_DAMPING
+#define X_SHAPER_DAMPING				0.1					// xiz		damping ratio of the ringing
+#endif
+#ifndef Y_SHAPER_TYPE
+#define Y_SHAPER_TYPE					0
+#endif
+#ifndef Y_SHAPER_FREQUENCY
+#define Y_SHAPER_FREQUENCY				0
+#endif
+#ifndef Y_SHAPER_DAMPING
+#define Y_SHAPER_DAMPING				0.1
+#endif
+#ifndef Z_SHAPER_TYPE
+#define Z_SHAPER_TYPE					0
+#endif
+#ifndef Z_SHAPER_FREQUENCY
+#define Z_SHAPER_FREQUENCY				0
+#endif
+#ifndef Z_SHAPER_DAMPING
+#define Z_SHAPER_DAMPING				0.1
+#endif
+
+// Probing runs a slow second pass off the contact (see cycle_probing.c)
+#ifndef PROBE_LATCH_VELOCITY
+#define PROBE_LATCH_VELOCITY			25					// plv		mm/min of the slow pass; 0 = probe once at F
+#endif
+#ifndef PROBE_LATCH_BACKOFF
+#define PROBE_LATCH_BACKOFF				2					// plb		mm the slow pass may travel to clear the contact
+#endif
+
+// Power loss checkpoints while running (see cm_checkpoint_callback())
+#ifndef CHECKPOINT_INTERVAL_MS
+#define CHECKPOINT_INTERVAL_MS			5000				// cpi		ms between checkpoints; 0 = off
+#endif
+
+// Adaptive feed from the spindle load (see _get_adaptive_feed() in plan_exec.c)
+#ifndef ADAPTIVE_FEED_INPUT
+#define ADAPTIVE_FEED_INPUT				0					// lfi		analog input reading the load (1-4); 0 = off
+#endif
+#ifndef ADAPTIVE_LOAD_LO
+#define ADAPTIVE_LOAD_LO				0.4					// lfl		load band low edge, in the input's units
+#endif
+#ifndef ADAPTIVE_LOAD_HI
+#define ADAPTIVE_LOAD_HI				0.6					// lfh		load band high edge
+#endif
+#ifndef ADAPTIVE_FEED_MIN
+#define ADAPTIVE_FEED_MIN				0.25				// lfn		lowest feed factor
+#endif
+#ifndef ADAPTIVE_FEED_MAX
+#define ADAPTIVE_FEED_MAX				1.0					// lfx		highest feed factor
+#endif
+
+// Plasma torch height control from the arc voltage (see _update_thc() in plan_exec.c)
+#ifndef THC_INPUT
+#define THC_INPUT						0					// thi		analog input reading the arc voltage (1-4); 0 = off
+#endif
+#ifndef THC_VOLTAGE
+#define THC_VOLTAGE						120					// thv		arc voltage to hold, in the input's units
+#endif
+#ifndef THC_GAIN
+#define THC_GAIN						10					// thg		mm/min of Z correction per volt of error
+#endif
+#ifndef THC_RATE
+#define THC_RATE						500					// thr		mm/min max Z correction velocity
+#endif
+#ifndef THC_LIMIT
+#define THC_LIMIT						5					// thl		mm max Z offset either way
+#endif
+#ifndef THC_ANTIDIVE
+#define THC_ANTIDIVE					0.8					// thd		corrections hold below this fraction of cruise velocity
+#endif
+
+// Extruder pressure advance (see _update_pressure_advance() in plan_exec.c)
+#ifndef PA_AXIS
+#define PA_AXIS							0					// pax		axis driving the extruder (1-6 = X-C); 0 = off
+#endif
+#ifndef PA_ADVANCE
+#define PA_ADVANCE						0					// pak		seconds of extruder velocity added to its position
+#endif
+
+// Firmware retraction, G10/G11 on the pressure advance extruder axis (see mp_set_retract() in plan_exec.c)
+#ifndef RETRACT_LENGTH
+#define RETRACT_LENGTH					1					// rtl		extruder units retracted by G10
+#endif
+#ifndef RETRACT_VELOCITY
+#define RETRACT_VELOCITY				1800				// rtv		extruder units per minute
+#endif
+
+// The tool table defaults to empty (see G10 L1 and G43)
+#ifndef T1_LENGTH
+#define T1_LENGTH						0					// tt1l		mm the tool tip is below the spindle reference
+#endif
+#ifndef T1_DIAMETER
+#define T1_DIAMETER						0					// tt1d		mm cutter diameter
+#endif
+#ifndef T2_LENGTH
+#define T2_LENGTH						0
+#endif
+#ifndef T2_DIAMETER
+#define T2_DIAMETER						0
+#endif
+#ifndef T3_LENGTH
+#define T3_LENGTH						0
+#endif
+#ifndef T3_DIAMETER
+#define T3_DIAMETER						0
+#endif
+#ifndef T4_LENGTH
+#define T4_LENGTH						0
+#endif
+#ifndef T4_DIAMETER
+#define T4_DIAMETER						0
+#endif
 
 /*** User-Defined Data Defaults ***/
 
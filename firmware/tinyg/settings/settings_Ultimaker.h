@@ -52,6 +52,8 @@
 
 #undef SWITCH_TYPE
 #define SWITCH_TYPE 			SW_TYPE_NORMALLY_CLOSED
+
+#define PA_AXIS					4						// pax		the extruder is on A; set $pak to turn on pressure advance
 
 // *** motor settings ***
 
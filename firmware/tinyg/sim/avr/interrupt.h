@@ -0,0 +1,2 @@
+/* sim/avr/interrupt.h - host mock; see sim/avr/io.h */
+#include <avr/io.h>
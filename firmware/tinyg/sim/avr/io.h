@@ -0,0 +1,50 @@
+/*
+ * sim/avr/io.h - host mock of the xmega register file for the simulation build
+ *
+ * Only the peripherals and bit names referenced by the firmware are declared.
+ * Registers are plain memory; the simulator polls the timer CTRLA registers
+ * to decide which ISRs to run (see sim_main.c).
+ */
+#ifndef SIM_AVR_IO_H_ONCE
+#define SIM_AVR_IO_H_ONCE
+
+#include <stdint.h>
+
+#define ISR(vector) void vector(void)
+#define sei()
+#define cli()
+
+extern uint8_t SREG;
+
+typedef struct { volatile uint8_t DIR, DIRSET, DIRCLR, OUT, OUTSET, OUTCLR, OUTTGL, IN, INTCTRL, INT0MASK, INT1MASK, INTFLAGS, PIN0CTRL, PIN1CTRL, PIN2CTRL, PIN3CTRL, PIN4CTRL, PIN5CTRL, PIN6CTRL, PIN7CTRL, REMAP; } PORT_t;
+typedef struct { volatile uint8_t DATA, STATUS, CTRLA, CTRLB, CTRLC, BAUDCTRLA, BAUDCTRLB; } USART_t;
+typedef struct { volatile uint8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLE, INTCTRLA, INTCTRLB, CTRLFCLR, CTRLFSET, CTRLGCLR, CTRLGSET, INTFLAGS; volatile uint16_t CNT, PER, CCA, CCB, CCC, CCD, PERBUF, CCABUF, CCBBUF; } TC0_t;
+typedef TC0_t TC1_t;
+typedef struct { volatile uint8_t CTRLA, CTRLB, INTCTRL, INTFLAGS; volatile uint16_t CNT, PER, COMP; volatile uint8_t STATUS; } RTC_t;
+typedef struct { volatile uint8_t VPCTRLA, VPCTRLB, CLKEVOUT, MPCMASK; } PORTCFG_t;
+typedef struct { volatile uint8_t STATUS, INTPRI, CTRL; } PMIC_t;
+
+extern PORTCFG_t PORTCFG;
+extern PMIC_t PMIC;
+extern PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTQ, PORTR, VPORT0, VPORT1, VPORT2, VPORT3;
+extern TC0_t TCC0, TCD0, TCE0, TCF0, TCC1, TCD1, TCE1, TCF1;
+extern USART_t USARTC0, USARTC1, USARTD0, USARTD1, USARTE0, USARTF0;
+extern RTC_t RTC;
+
+enum {
+	PORTCFG_VP0MAP_PORTA_gc, PORTCFG_VP1MAP_PORTF_gc, PORTCFG_VP2MAP_PORTE_gc, PORTCFG_VP3MAP_PORTD_gc,
+	PORT_INT0LVL_MED_gc, PORT_INT1LVL_MED_gc, PORT_ISC_BOTHEDGES_gc, PORT_OPC_PULLUP_gc,
+	TC_CLKSEL_DIV1_gc, TC_CLKSEL_DIV2_gc, TC_CLKSEL_DIV4_gc, TC_CLKSEL_DIV8_gc, TC_CLKSEL_DIV64_gc, TC_CLKSEL_OFF_gc,
+	TC_WGMODE_NORMAL_gc, TC_WGMODE_SS_gc, TC_WGMODE_DS_T_gc,
+	TC_OVFINTLVL_OFF_gc, TC_OVFINTLVL_LO_gc, TC_OVFINTLVL_MED_gc, TC_OVFINTLVL_HI_gc, TC_OVFINTLVL_gm,
+	TC0_CCBEN_bm, TC1_CCAEN_bm, TC1_CCBEN_bm, _FDEV_SETUP_RW
+};
+
+#define TC0_OVFIF_bm		0x01
+
+#define PMIC_LOLVLEN_bm		0x01
+#define PMIC_MEDLVLEN_bm	0x02
+#define PMIC_HILVLEN_bm		0x04
+#define PMIC_RREN_bm		0x80
+
+#endif // SIM_AVR_IO_H_ONCE
@@ -0,0 +1,33 @@
+/*
+ * sim/avr/pgmspace.h - host mock of avr-libc program memory access
+ *
+ * There is only one address space on the host, so PROGMEM is a no-op and
+ * the _P variants alias the standard library functions.
+ */
+#ifndef SIM_AVR_PGMSPACE_H_ONCE
+#define SIM_AVR_PGMSPACE_H_ONCE
+
+#include <avr/io.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(a) (*(a))
+#define pgm_read_word(a) (*(a))
+#define pgm_read_dword(a) (*(a))
+#define pgm_read_float(a) (*(a))
+
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+#define printf_P printf
+#define fprintf_P fprintf
+
+#endif // SIM_AVR_PGMSPACE_H_ONCE
@@ -0,0 +1,2 @@
+/* sim/avr/sleep.h - host mock; see sim/avr/io.h */
+#include <avr/io.h>
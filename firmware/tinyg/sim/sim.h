@@ -0,0 +1,34 @@
+/*
+ * sim.h - host simulation build of the planner and stepper
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIM_H_ONCE
+#define SIM_H_ONCE
+
+#define SIM_LINE_MAX 4096				// longest replayed line (longer ones reach the controller in chunks)
+#define SIM_STALL_PASSES 100000			// controller passes with no motion before declaring a stall
+#define SIM_JOB_TOLERANCE 0.5			// percent the job time may move from its baseline (see sim_main.c)
+#define SIM_CPU_TOLERANCE 200			// percent the planner CPU time may grow (host times are noisy)
+
+int sim_get_line(char *buf, const int size, uint8_t *more);	// replay source for xio_get_line()
+void sim_keep_line(const uint8_t keep);	// read the end of a chunk again (see xio_keep_line())
+void sim_controller_pass(void);			// one pass through the controller dispatch list
+int sim_encode_frame(const char *line, char *buf, const int size);	// Gcode frame encoder (sim_frame.c)
+int sim_json_bench(char **line, const uint32_t count, FILE *report);	// JSON command benchmark (sim_json.c)
+
+#endif // End of include guard: SIM_H_ONCE
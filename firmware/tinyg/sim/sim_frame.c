@@ -0,0 +1,105 @@
+/*
+ * sim_frame.c - host encoder for pre-tokenized Gcode frames
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	Turns text lines into the frames gc_gcode_frame_parser() reads. The words are found
+ *	by gc_next_word() and converted by parse_float() - the firmware's own tokenizer - so
+ *	a frame loads exactly the words the text block would have. A sender links this file
+ *	with gcode_parser.c and util.c, or runs "tinyg_sim -e" to encode files ahead of time.
+ *
+ *	A line is left as text if the controller would not hand it to the Gcode parser as a
+ *	plain block, or if a frame can't carry it:
+ *
+ *	  - blank lines, signals, $ ? H text commands, JSON, block deletes and O words
+ *	  - parameters, expressions and parameter settings (evaluated by the firmware)
+ *	  - (MSG comments - a frame has no text
+ *	  - numbers with no letter - the parser reports the error on the text line
+ *	  - blocks too long for one frame in the controller's input buffer
+ *
+ *	Lines holding only a comment encode to an empty frame (just the CRC), as the parser
+ *	would run an empty block for them.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "controller.h"
+#include "gcode_parser.h"
+#include "xio.h"
+#include "util.h"
+#include "sim.h"
+
+/*
+ * _is_text_line() - true if the controller would not run the line as a Gcode block
+ */
+
+static bool _is_text_line(const char *line)
+{
+	if ((*line == NUL) || (strchr("!%~$?Hh{[/", *line) != NULL) || (*line == STX)) return (true);
+	while (isspace(*line)) line++;
+	return ((*line == 'O') || (*line == 'o'));
+}
+
+/*
+ * sim_encode_frame() - encode a line as a Gcode frame
+ *
+ *	Writes the frame to buf (STX, 6 bit chars, NUL) and returns its length without the
+ *	NUL. Returns 0 if the line has to be sent as text (see above). size is the longest
+ *	line the controller reads, NUL included - use INPUT_BUFFER_LEN.
+ */
+
+int sim_encode_frame(const char *line, char *buf, const int size)
+{
+	uint8_t bytes[INPUT_BUFFER_LEN];
+	uint16_t len = 0;
+	char_t *rd = (char_t *)line;
+	char letter;
+	float value;
+	uint8_t token;
+
+	if (_is_text_line(line)) return (0);
+	while ((token = gc_next_word(&rd, &letter, &value)) == GC_TOKEN_WORD) {
+		if ((len + 5 + 2 > (size - 2) * 6 / 8) ||		// STX and NUL don't carry bits
+			(len + 5 + 2 > sizeof(bytes))) return (0);
+		bytes[len++] = (uint8_t)letter;
+		memcpy(&bytes[len], &value, sizeof(float));		// the host is little-endian too
+		len += sizeof(float);
+	}
+	if (token != GC_TOKEN_END) return (0);
+
+	uint16_t crc = compute_crc16(bytes, len);
+	bytes[len++] = (uint8_t)crc;
+	bytes[len++] = (uint8_t)(crc >> 8);
+
+	char *wr = buf;
+	uint16_t bits = 0;
+	uint8_t bit_count = 0;
+
+	*wr++ = STX;
+	for (uint16_t i = 0; i < len; i++) {				// first bits first, as _decode_gcode_frame() reads them
+		bits = (bits << 8) | bytes[i];
+		bit_count += 8;
+		while (bit_count >= 6) {
+			bit_count -= 6;
+			*wr++ = '0' + ((bits >> bit_count) & 0x3F);
+		}
+	}
+	if (bit_count > 0) {
+		*wr++ = '0' + ((bits << (6 - bit_count)) & 0x3F);	// leftover bits are padded with zeros
+	}
+	*wr = NUL;
+	return (wr - buf);
+}
@@ -0,0 +1,226 @@
+/*
+ * sim_hardware.c - host stand-ins for the xmega hardware layer
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	Replaces hardware.c, network.c, xio.c and the xmega drivers in the simulation build.
+ *	Registers are plain memory (see sim/avr/io.h), EEPROM is a RAM array, and the
+ *	xio layer reads lines from the replay source provided by sim_main.c.
+ */
+#include "tinyg.h"
+#include "config.h"
+#include "hardware.h"
+#include "network.h"
+#include "switch.h"
+#include "text_parser.h"
+#include "xio.h"
+#include "xmega/xmega_rtc.h"
+#include "xmega/xmega_eeprom.h"
+#include "xmega/xmega_interrupts.h"
+#include "sim.h"
+
+/**** register file ****/
+
+PORTCFG_t PORTCFG;
+PMIC_t PMIC;
+uint8_t SREG;
+PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTQ, PORTR, VPORT0, VPORT1, VPORT2, VPORT3;
+TC0_t TCC0, TCD0, TCE0, TCF0, TCC1, TCD1, TCE1, TCF1;
+USART_t USARTC0, USARTC1, USARTD0, USARTD1, USARTE0, USARTF0;
+RTC_t RTC;
+
+rtClock_t rtc;
+
+#define SIM_EEPROM_SIZE 4096
+static int8_t eeprom[SIM_EEPROM_SIZE];
+
+/**** hardware.c ****/
+
+static void _port_bindings(float hw_version)
+{
+	hw.st_port[0] = &PORT_MOTOR_1;
+	hw.st_port[1] = &PORT_MOTOR_2;
+	hw.st_port[2] = &PORT_MOTOR_3;
+	hw.st_port[3] = &PORT_MOTOR_4;
+
+	hw.sw_port[0] = &PORT_SWITCH_X;
+	hw.sw_port[1] = &PORT_SWITCH_Y;
+	hw.sw_port[2] = &PORT_SWITCH_Z;
+	hw.sw_port[3] = &PORT_SWITCH_A;
+
+	if (hw_version > 6.9) {
+		hw.out_port[0] = &PORT_OUT_V7_X;
+		hw.out_port[1] = &PORT_OUT_V7_Y;
+		hw.out_port[2] = &PORT_OUT_V7_Z;
+		hw.out_port[3] = &PORT_OUT_V7_A;
+	} else {
+		hw.out_port[0] = &PORT_OUT_V6_X;
+		hw.out_port[1] = &PORT_OUT_V6_Y;
+		hw.out_port[2] = &PORT_OUT_V6_Z;
+		hw.out_port[3] = &PORT_OUT_V6_A;
+	}
+}
+
+void hardware_init()
+{
+	memset(eeprom, 0xFF, sizeof(eeprom));		// erased EEPROM forces a load of the default profile
+	_port_bindings(TINYG_HARDWARE_VERSION);
+	rtc_init();
+}
+
+stat_t hw_hard_reset_handler(void) { return (STAT_NOOP);}
+stat_t hw_bootloader_handler(void) { return (STAT_NOOP);}
+stat_t hw_run_boot(nvObj_t *nv) { return (STAT_OK);}
+uint16_t hw_get_boot_time(void) { return (0);}
+void hw_timebase_init(void) {}
+void hw_sleep(volatile uint8_t *events) {}
+uint32_t hw_get_usec(void) { return (rtc.sys_ticks * 1000);}
+
+stat_t hw_get_id(nvObj_t *nv)
+{
+	nv->valuetype = TYPE_STRING;
+	return (nv_copy_string(nv, "SIM"));
+}
+
+uint16_t hw_get_free_ram(void) { return (0);}
+uint16_t hw_get_min_free_ram(void) { return (0);}
+
+stat_t hw_get_mem(nvObj_t *nv)
+{
+	nv->value = 0;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+
+stat_t hw_set_hv(nvObj_t *nv)
+{
+	if (nv->value > TINYG_HARDWARE_VERSION_MAX)
+		return (STAT_INPUT_EXCEEDS_MAX_VALUE);
+	set_flt(nv);
+	_port_bindings(nv->value);
+	switch_init();
+	return (STAT_OK);
+}
+
+#ifdef __TEXT_MODE
+static const char fmt_fb[] PROGMEM = "[fb]  firmware build%18.2f\n";
+static const char fmt_fv[] PROGMEM = "[fv]  firmware version%16.2f\n";
+static const char fmt_hp[] PROGMEM = "[hp]  hardware platform%15.2f\n";
+static const char fmt_hv[] PROGMEM = "[hv]  hardware version%16.2f\n";
+static const char fmt_id[] PROGMEM = "[id]  TinyG ID%30s\n";
+
+void hw_print_fb(nvObj_t *nv) { text_print_flt(nv, fmt_fb);}
+void hw_print_fv(nvObj_t *nv) { text_print_flt(nv, fmt_fv);}
+void hw_print_hp(nvObj_t *nv) { text_print_flt(nv, fmt_hp);}
+void hw_print_hv(nvObj_t *nv) { text_print_flt(nv, fmt_hv);}
+void hw_print_id(nvObj_t *nv) { text_print_str(nv, fmt_id);}
+#endif // __TEXT_MODE
+
+/**** xmega drivers ****/
+
+void rtc_init()
+{
+	rtc.rtc_ticks = 0;
+	rtc.sys_ticks = 0;
+	rtc.magic_end = MAGICNUM;
+}
+
+void PMIC_SetVectorLocationToApplication(void) {}
+
+uint16_t EEPROM_ReadBytes(const uint16_t address, int8_t *buf, const uint16_t size)
+{
+	if (address + size > SIM_EEPROM_SIZE) return (0);
+	memcpy(buf, &eeprom[address], size);
+	return (size);
+}
+
+uint16_t EEPROM_ReadBlock(const uint16_t address, int8_t *buf, const uint16_t size)
+{
+	return (EEPROM_ReadBytes(address, buf, size));
+}
+
+uint16_t EEPROM_WritePage(const uint16_t address, const int8_t *buf)
+{
+	return (EEPROM_WriteBytes(address, buf, EEPROM_PAGESIZE));
+}
+
+uint16_t EEPROM_WriteBytes(const uint16_t address, const int8_t *buf, const uint16_t size)
+{
+	if (address + size > SIM_EEPROM_SIZE) return (0);
+	memcpy(&eeprom[address], buf, size);
+	return (size);
+}
+
+/**** network.c ****/
+
+void network_init() {}
+void net_send_segment(const float target[], float segment_time) {}
+void net_send_position(const float position[]) {}
+void net_advance_clock(float microseconds) {}
+stat_t net_exec_segment() { return (STAT_NOOP);}
+stat_t net_callback() { return (STAT_NOOP);}
+
+/**** xio.c ****
+ *	All input comes from the replay source, all output goes to the host's stdio.
+ */
+
+void xio_init() {}
+uint8_t xio_test_assertions() { return (STAT_OK);}
+uint8_t xio_isbusy() { return (false);}
+void xio_set_stdin(const uint8_t dev) {}
+void xio_set_stdout(const uint8_t dev) {}
+void xio_set_stderr(const uint8_t dev) {}
+void xio_set_output(const uint8_t dev, const uint8_t filter) {}
+FILE *xio_open(const uint8_t dev, const char *addr, const flags_t flags) { return (NULL);}
+int xio_ctrl(const uint8_t dev, const flags_t flags) { return (XIO_OK);}
+int xio_set_baud(const uint8_t dev, const uint8_t baud_rate) { return (XIO_OK);}
+buffer_t xio_get_tx_bufcount_usart(const xioUsart_t *dx) { return (0);}
+buffer_t xio_get_usb_rx_free(void) { return (RX_BUFFER_SIZE-2);}
+buffer_t xio_get_usb_tx_free(void) { return (TX_BUFFER_SIZE-2);}
+void xio_reset_usb_rx_buffers(void) {}
+const uint8_t *xio_open_pgm_program(const uint16_t number) { return (NULL);}
+uint8_t xio_read_pgm_block(const uint8_t **rd_P, uint8_t *block) { return (0);}
+int xio_open_flash_upload(void) { return (XIO_NO_SUCH_DEVICE);}
+int xio_close_flash_upload(void) { return (XIO_FILE_NOT_OPEN);}
+uint8_t xio_flash_is_storing(void) { return (false);}
+int xio_store_flash_line(const char *line, const uint8_t len) { return (XIO_FILE_NOT_OPEN);}
+uint32_t xio_get_flash_job_length(void) { return (0);}
+uint16_t xio_get_flash_job_crc(void) { return (0xFFFF);}
+void xio_set_flash_runs(const uint16_t runs) {}
+uint16_t xio_get_flash_runs_left(void) { return (0);}
+
+int xio_gets(const uint8_t dev, char *buf, const int size)
+{
+	uint8_t more;
+	return (sim_get_line(buf, size, &more));
+}
+
+int xio_get_line(const uint8_t dev, char *buf, const int size, xioLine_t *line)
+{
+	if (dev != STD_IN) return (XIO_EAGAIN);				// the job file is the only source
+	int status = sim_get_line(buf, size, &line->more);
+	if (status == STAT_OK) {
+		line->buf = buf;
+		line->len = strlen(buf)+1;
+	}
+	return (status);
+}
+
+void xio_keep_line(const uint8_t dev, const uint8_t keep)
+{
+	if (dev == STD_IN) sim_keep_line(keep);
+}
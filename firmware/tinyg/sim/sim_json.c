@@ -0,0 +1,286 @@
+/*
+ * sim_json.c - host benchmark of the JSON and config command path
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	Times the command traffic a host sends between moves - the part of the controller's
+ *	foreground that $bench (see test.c) only samples one call of. Each traffic set runs
+ *	in whole passes for at least SIM_JSON_BENCH_SEC and is reported as commands/sec and
+ *	bytes/sec in (command text) and out (responses):
+ *
+ *	  sr	status report and position queries, as a host polls them while a job runs
+ *	  dump	a get of every config group ({"sys":n}, {"x":n}, {"1":n}...), as a host reads
+ *			the whole configuration on connect
+ *	  set	every axis and motor setting written back with its own value, one per command
+ *	  file	the lines of the input files (make jsonbench sends tests/test_008_json.h)
+ *
+ *	These go through json_parser(), so they include nv_get_index(), nv_get()/nv_set(),
+ *	json_serialize() and the response printing. The last lines time those calls alone,
+ *	once per config table entry, so a change can be placed:
+ *
+ *	  index		nv_get_index() of every token
+ *	  get		nv_get_nvObj() of every single value (the value getter and the token copy)
+ *	  put		nv_set() of every axis and motor value with the value it holds
+ *	  ser		json_serialize() of every config group, as populated by get_grp()
+ *
+ *	Responses are written to a scratch file so their bytes can be counted; the host's
+ *	terminal speed is not part of the figure. Gcode in the file set is planned but never
+ *	run - the planner is flushed after each command so the queue can't fill up.
+ */
+#include <time.h>
+
+#include "tinyg.h"
+#include "config.h"
+#include "controller.h"
+#include "canonical_machine.h"
+#include "json_parser.h"
+#include "planner.h"
+#include "report.h"
+#include "xio.h"
+#include "util.h"
+#include "sim.h"
+
+#define SIM_JSON_BENCH_SEC 0.5			// least time each traffic set runs
+#define SIM_JSON_SET_GROUPS "xyzabc123456"	// groups written back by the set traffic
+
+typedef struct simJsonSet {
+	const char *name;
+	char **line;
+	uint32_t count;
+} simJsonSet_t;
+
+static const char *sr_traffic[] = {
+	"{\"sr\":null}",
+	"{\"stat\":null}",
+	"{\"qr\":null}",
+	"{\"posx\":null,\"posy\":null,\"posz\":null}",
+	"{\"sr\":\"\"}",
+	"{\"line\":null}",
+	"{\"vel\":null,\"feed\":null}",
+	"{\"qr\":\"\"}"
+};
+
+static double _now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+static bool _is_set_group(index_t i)
+{
+	char_t group[GROUP_LEN+1];
+	strncpy_P(group, cfgArray[i].group, GROUP_LEN+1);
+	return ((strlen(group) == 1) && (strchr(SIM_JSON_SET_GROUPS, group[0]) != NULL));
+}
+
+static void _add(simJsonSet_t *set, const char *text)
+{
+	if ((set->count & 0x3F) == 0) {
+		set->line = realloc(set->line, (set->count + 0x40) * sizeof(char *));
+	}
+	set->line[set->count++] = strdup(text);
+}
+
+/*
+ * _build_dump() - a group get of every config group
+ * _build_set()	 - every axis and motor value, as {"token":value} with its own value
+ */
+
+static void _build_dump(simJsonSet_t *set)
+{
+	char_t text[TOKEN_LEN+16];
+	char_t token[TOKEN_LEN+1];
+
+	for (index_t i=0; i<nv_index_max(); i++) {
+		if (!nv_index_is_group(i)) continue;
+		strncpy_P(token, cfgArray[i].token, TOKEN_LEN+1);
+		sprintf(text, "{\"%s\":null}", token);
+		_add(set, text);
+	}
+}
+
+static void _build_set(simJsonSet_t *set)
+{
+	for (index_t i=0; nv_index_is_single(i); i++) {
+		if (!_is_set_group(i)) continue;
+		nvObj_t *nv = nv_reset_nv_list();
+		nv->index = i;
+		nv_get_nvObj(nv);
+		if ((nv->valuetype != TYPE_FLOAT) && (nv->valuetype != TYPE_INTEGER)) continue;
+		strncpy_P(nv->token, cfgArray[i].token, TOKEN_LEN+1);	// full token, no group object
+		nv->group[0] = NUL;
+		json_serialize(nv_body, cs.out_buf, sizeof(cs.out_buf));
+		_add(set, (char *)cs.out_buf);
+	}
+	nv_reset_nv_list();
+}
+
+/*
+ * _run_set() - run a traffic set through json_parser() in whole passes
+ */
+
+static void _run_set(simJsonSet_t *set, FILE *out, FILE *report)
+{
+	char_t buf[SIM_LINE_MAX];
+	uint64_t commands = 0, bytes_in = 0, bytes_out = 0;
+	double start = _now(), elapsed;
+
+	if (set->count == 0) return;
+	do {
+		for (uint32_t i=0; i<set->count; i++) {
+			strncpy(buf, set->line[i], sizeof(buf)-1);		// json_parser() writes in the string
+			buf[sizeof(buf)-1] = NUL;
+			json_parser(buf);
+			mp_flush_planner();
+			bytes_in += strlen(set->line[i]) + 1;
+		}
+		commands += set->count;
+		fflush(stdout);
+		fflush(stderr);
+		bytes_out += ftell(out);
+		rewind(out);
+	} while ((elapsed = _now() - start) < SIM_JSON_BENCH_SEC);
+
+	fprintf(report, "json %-6s %5lu cmds %10.0f cmds/sec %9.0f kB/s in %9.0f kB/s out %7.2f us/cmd\n",
+		set->name, (unsigned long)set->count, commands / elapsed,
+		bytes_in / elapsed / 1000, bytes_out / elapsed / 1000, elapsed / commands * 1e6);
+}
+
+/*
+ * _report_calls() - report a call timing (objs is the count per pass)
+ * _run_calls()	   - time the config calls alone, once per table entry each pass
+ */
+
+static void _report_calls(FILE *report, const char *name, uint32_t objs, uint64_t calls, uint64_t bytes, double elapsed)
+{
+	fprintf(report, "json %-6s %5lu objs %10.0f objs/sec", name, (unsigned long)objs, calls / elapsed);
+	if (bytes > 0) fprintf(report, " %9.0f kB/s out", bytes / elapsed / 1000);
+	fprintf(report, " %7.3f us/obj\n", elapsed / calls * 1e6);
+}
+
+static void _run_calls(FILE *report)
+{
+	char_t token[TOKEN_LEN+1];
+	volatile index_t sink = 0;
+	uint64_t calls, bytes;
+	uint32_t objs;
+	double start, elapsed;
+	nvObj_t *nv;
+
+	calls = 0;
+	start = _now();
+	do {
+		for (index_t i=0; i<nv_index_max(); i++) {
+			strncpy_P(token, cfgArray[i].token, TOKEN_LEN+1);	// table tokens carry their group
+			sink += nv_get_index((const char_t *)"", token);
+			calls++;
+		}
+	} while ((elapsed = _now() - start) < SIM_JSON_BENCH_SEC);
+	(void)sink;
+	_report_calls(report, "index", nv_index_max(), calls, 0, elapsed);
+
+	calls = 0;
+	objs = 0;
+	start = _now();
+	do {
+		for (index_t i=0; nv_index_is_single(i); i++) {
+			nv = nv_reset_nv_list();
+			nv->index = i;
+			nv_get_nvObj(nv);
+			calls++;
+		}
+		if (objs == 0) objs = calls;
+	} while ((elapsed = _now() - start) < SIM_JSON_BENCH_SEC);
+	_report_calls(report, "get", objs, calls, 0, elapsed);
+
+	calls = 0;
+	objs = 0;
+	start = _now();
+	do {
+		for (index_t i=0; nv_index_is_single(i); i++) {
+			if (!_is_set_group(i)) continue;
+			nv = nv_reset_nv_list();
+			nv->index = i;
+			nv_get_nvObj(nv);
+			if ((nv->valuetype != TYPE_FLOAT) && (nv->valuetype != TYPE_INTEGER)) continue;
+			nv_set(nv);
+			calls++;
+		}
+		if (objs == 0) objs = calls;
+	} while ((elapsed = _now() - start) < SIM_JSON_BENCH_SEC);
+	_report_calls(report, "put", objs, calls, 0, elapsed);
+
+	calls = 0;
+	objs = 0;
+	bytes = 0;
+	elapsed = 0;
+	do {
+		for (index_t i=0; i<nv_index_max(); i++) {
+			if (!nv_index_is_group(i)) continue;
+			nv = nv_reset_nv_list();
+			nv->index = i;
+			nv_get_nvObj(nv);								// get_grp() populates the children
+			start = _now();
+			bytes += json_serialize(nv_body, cs.out_buf, sizeof(cs.out_buf));
+			elapsed += _now() - start;
+			calls++;
+		}
+		if (objs == 0) objs = calls;
+	} while (elapsed < SIM_JSON_BENCH_SEC);
+	_report_calls(report, "ser", objs, calls, bytes, elapsed);
+	nv_reset_nv_list();
+}
+
+/*
+ * sim_json_bench() - run the JSON benchmark over the file lines
+ *
+ *	Call after the firmware is initialized. Responses go to stdout and stderr, which are
+ *	pointed at a scratch file for the run. Returns 0, or 2 if the scratch file can't be made.
+ */
+
+int sim_json_bench(char **line, const uint32_t count, FILE *report)
+{
+	simJsonSet_t sr = { "sr", NULL, 0 };
+	simJsonSet_t dump = { "dump", NULL, 0 };
+	simJsonSet_t set = { "set", NULL, 0 };
+	simJsonSet_t file = { "file", line, count };
+	FILE *out;
+
+	for (uint8_t i=0; i<sizeof(sr_traffic)/sizeof(sr_traffic[0]); i++) {
+		_add(&sr, sr_traffic[i]);
+	}
+	_build_dump(&dump);
+	_build_set(&set);
+
+	if ((out = tmpfile()) == NULL) return (2);
+	FILE *saved_out = stdout;
+	FILE *saved_err = stderr;
+	stdout = out;
+	stderr = out;
+
+	_run_set(&sr, out, report);
+	_run_set(&dump, out, report);
+	_run_set(&set, out, report);
+	_run_set(&file, out, report);
+	_run_calls(report);
+
+	stdout = saved_out;
+	stderr = saved_err;
+	fclose(out);
+	return (0);
+}
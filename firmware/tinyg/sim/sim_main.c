@@ -0,0 +1,646 @@
+/*
+ * sim_main.c - host simulation build of the planner and stepper
+ * This file is part of the TinyG project
+ *
+ * Copyright (c) 2010 - 2015 Alden S. Hart, Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *	Runs the real controller, canonical machine, planner, exec and stepper prep/loader
+ *	code on the host. The interrupt levels are emulated by polling the timer CTRLA
+ *	registers in priority order:
+ *
+ *	  - TIMER_LOAD and TIMER_EXEC are software interrupts and are serviced as soon
+ *		as they are requested (after every foreground pass and every DDA segment).
+ *	  - TIMER_DDA and TIMER_DWELL are ticked one segment at a time, and only when the
+ *		foreground did not read a line on its last pass. The host is treated as an
+ *		infinitely fast foreground, so the planner queue is always as full as
+ *		_sync_to_planner() allows.
+ *
+ *	Input files are replayed as one job. Plain files (gcode_samples/) are read line
+ *	by line. C headers in gcode/ and tests/ have their string literals extracted,
+ *	so the same PROGMEM programs run by the on-board test command can be replayed.
+ *
+ *	Reported on stderr:
+ *	  - blocks/sec	lines read divided by foreground time (parse + plan)
+ *	  - segs/sec	exec segments divided by time spent in the exec ISR (mp_exec_move + st_prep)
+ *	  - ns/blk float	time parse_float() takes for the word values of a block (see _time_float_parse())
+ *	  - us max blk	slowest foreground pass that read a line - the worst case parse + plan latency
+ *	  - job time	DDA timer periods / F_CPU + dwell ticks / FREQUENCY_DWELL
+ *					(time the runtime was starved is not counted)
+ *
+ *	With -b the input files are not run but written to stdout as a stored block program
+ *	header (see xio_file.h). With -e they are written to stdout as Gcode frames, one line
+ *	per line, with the lines a frame can't carry left as text (see sim_frame.c). The
+ *	output can be streamed by a host or replayed by the simulator.
+ *
+ *	With -f the job is encoded as frames before it starts and then replayed, so blocks/sec
+ *	compares frame streaming with text streaming of the same file. make framebench runs
+ *	the sample programs both ways.
+ *
+ *	With -r the job is checked against its line in a cycle time baseline file (see
+ *	_check_baseline()), and -w appends the job's line to one. make regress runs the
+ *	regression corpus this way and make baseline rewrites the stored baselines.
+ *
+ *	With -j the files are not run as a job but sent through json_parser() among the
+ *	status report, config dump and config set traffic of the JSON benchmark, which
+ *	reports commands/sec and bytes/sec (see sim_json.c). make jsonbench runs it on
+ *	tests/test_008_json.h.
+ */
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+
+#include "tinyg.h"
+#include "config.h"
+#include "hardware.h"
+#include "persistence.h"
+#include "controller.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "planner.h"
+#include "stepper.h"
+#include "encoder.h"
+#include "switch.h"
+#include "network.h"
+#include "pwm.h"
+#include "xio.h"
+#include "util.h"
+#include "xmega/xmega_rtc.h"
+#include "sim.h"
+
+void TIMER_DDA_ISR_vect(void);			// emulated interrupt levels (see stepper.c)
+void TIMER_DWELL_ISR_vect(void);
+void TIMER_LOAD_ISR_vect(void);
+void TIMER_EXEC_ISR_vect(void);
+
+typedef struct simSingleton {
+	char **line;						// replay source
+	uint32_t line_count;
+	uint32_t line_index;
+	uint32_t line_offset;				// chars of the current line passed on in chunks
+	bool eof_sent;
+	bool line_read;						// foreground consumed a line on this pass
+
+	uint32_t blocks;					// lines handed to the controller
+	uint32_t segments;					// segments prepped by the exec ISR
+	uint64_t dda_cycles;				// CPU cycles of DDA ticks - the DDA rate can vary by segment
+	uint64_t dwell_ticks;
+	uint64_t prime_ms;					// wall time the first move of a cycle waited for priming
+	double plan_time;					// seconds in the controller (foreground)
+	double exec_time;					// seconds in the exec ISR
+	double max_block;					// seconds of the slowest foreground pass that read a line
+	FILE *report;						// summary output (survives -q)
+} simSingleton_t;
+static simSingleton_t sim;
+
+/*
+ * _now() - monotonic time in seconds
+ */
+
+static double _now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+/*
+ * _add_line() - append a line to the replay source
+ */
+
+static void _add_line(const char *text, size_t len)
+{
+	while ((len > 0) && ((text[len-1] == '\r') || (text[len-1] == '\n'))) len--;
+	if ((sim.line_count & 0x3FF) == 0) {
+		sim.line = realloc(sim.line, (sim.line_count + 0x400) * sizeof(char *));
+	}
+	if (len >= SIM_LINE_MAX) len = SIM_LINE_MAX-1;
+	sim.line[sim.line_count] = strndup(text, len);
+	sim.line_count++;
+}
+
+/*
+ * _load_text() - read a plain gcode file line by line
+ */
+
+static void _load_text(FILE *f)
+{
+	char buf[SIM_LINE_MAX];
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		_add_line(buf, strlen(buf));
+	}
+}
+
+/*
+ * _load_header() - extract the string literals of a PROGMEM gcode header
+ *
+ *	Comments are skipped, adjacent literals are concatenated and "\n" ends a line.
+ *	A ';' outside a literal ends the declaration and flushes any partial line.
+ */
+
+static void _load_header(FILE *f)
+{
+	char buf[SIM_LINE_MAX];
+	uint16_t len = 0;
+	int c, prev = 0;
+	enum { IN_CODE, IN_STRING, IN_LINE_COMMENT, IN_BLOCK_COMMENT } state = IN_CODE;
+
+	while ((c = fgetc(f)) != EOF) {
+		switch (state) {
+			case IN_CODE: {
+				if (c == '"') { state = IN_STRING;}
+				else if ((prev == '/') && (c == '/')) { state = IN_LINE_COMMENT;}
+				else if ((prev == '/') && (c == '*')) { state = IN_BLOCK_COMMENT; c = 0;}
+				else if ((c == ';') && (len > 0)) { _add_line(buf, len); len = 0;}
+				break;
+			}
+			case IN_LINE_COMMENT: { if (c == '\n') state = IN_CODE; break;}
+			case IN_BLOCK_COMMENT: { if ((prev == '*') && (c == '/')) { state = IN_CODE; c = 0;} break;}
+			case IN_STRING: {
+				if (c == '"') { state = IN_CODE; break;}
+				if (c == '\\') {
+					if ((c = fgetc(f)) == EOF) break;
+					if ((c == '\r') && ((c = fgetc(f)) == EOF)) break;	// CRLF headers continue lines with \<CR><LF>
+					if (c == '\n') { c = 0; break;}				// line continuation
+					if (c == 'n') { _add_line(buf, len); len = 0; c = 0; break;}
+					if (c == 't') c = '\t';
+					if (c == 'r') { c = 0; break;}
+				}
+				if (len < SIM_LINE_MAX-1) buf[len++] = c;
+				c = 0;
+				break;
+			}
+		}
+		prev = c;
+	}
+	if (len > 0) _add_line(buf, len);
+}
+
+static int _load_file(const char *name)
+{
+	FILE *f;
+	size_t n = strlen(name);
+
+	if ((f = fopen(name, "r")) == NULL) {
+		perror(name);
+		return (-1);
+	}
+	if ((n > 2) && (strcmp(&name[n-2], ".h") == 0)) {
+		_load_header(f);
+	} else {
+		_load_text(f);
+	}
+	fclose(f);
+	return (0);
+}
+
+/*
+ * sim_get_line()  - replay source for xio_get_line()
+ * sim_keep_line() - read the end of a chunk again with the next one
+ *
+ *	A line holding only !, ~ or %, or one of the 8 bit realtime override chars, is taken
+ *	as the signal character the USB RX interrupt would have trapped. It is acted on when the controller gets to that line, which is
+ *	while the moves ahead of it are running.
+ *
+ *	A line too long for the buffer is passed on in chunks with more set, as the USB
+ *	device does it.
+ */
+
+int sim_get_line(char *buf, const int size, uint8_t *more)
+{
+	while ((sim.line_offset == 0) && (sim.line_index < sim.line_count)) {
+		const char *line = sim.line[sim.line_index];
+		if ((line[0] == NUL) || (line[1] != NUL)) break;
+		if (line[0] == CHAR_FEEDHOLD) { cm_request_feedhold();} else
+		if (line[0] == CHAR_CYCLE_START) { cm_request_cycle_start();} else
+		if (line[0] == CHAR_QUEUE_FLUSH) { cm_request_queue_flush();} else
+		if (CHAR_IS_OVERRIDE(line[0])) { cm_request_override(line[0]);}
+		else break;
+		sim.line_index++;
+	}
+	if (sim.line_index < sim.line_count) {
+		const char *line = sim.line[sim.line_index] + sim.line_offset;
+		size_t len = strlen(line);
+		if ((*more = (len > (size_t)size-1)) == true) {
+			len = size-1;
+			sim.line_offset += len;
+		} else {
+			sim.line_index++;
+			sim.line_offset = 0;
+			sim.blocks++;
+		}
+		memcpy(buf, line, len);
+		buf[len] = NUL;
+		sim.line_read = true;
+		return (STAT_OK);
+	}
+	if (sim.eof_sent == false) {
+		sim.eof_sent = true;
+		return (STAT_EOF);
+	}
+	return (STAT_EAGAIN);
+}
+
+void sim_keep_line(const uint8_t keep)
+{
+	sim.line_offset -= keep;
+}
+
+/*
+ * _write_blocks() - write the loaded lines as a stored block program header
+ *
+ *	Each line is tokenized by gc_next_word(), as _parse_gcode_block() does it. Lines that
+ *	are not Gcode - config, JSON, O words and signals - are skipped with a warning, as a
+ *	stored program can't hold them. Messages are dropped.
+ */
+
+static int _write_blocks(const char *name)
+{
+	uint8_t block[PGM_BLOCK_SIZE];
+	int status = 0;
+
+	printf("/*\n * stored block program made by tinyg_sim -b %s - see xio_file.h\n */\n", name);
+	printf("const uint8_t %s[] PROGMEM = {\n", name);
+	for (uint32_t i = 0; i < sim.line_count; i++) {
+		char_t *rd = (char_t *)sim.line[i];
+		uint8_t words = 0;
+		uint8_t token;
+		char letter;
+		float value;
+
+		while (isspace(*rd)) rd++;
+		const char *text = (const char *)rd;
+		if ((*rd == NUL) || (*rd == '/') || (*rd == '(') || (*rd == ';')) continue;
+		if ((strchr("$?{%!~Oo", *rd) != NULL)) {
+			fprintf(stderr, "line %lu skipped - not a Gcode block: %s\n", (unsigned long)i+1, text);
+			continue;
+		}
+		while ((token = gc_next_word(&rd, &letter, &value)) == GC_TOKEN_WORD) {
+			if (words == PGM_BLOCK_WORDS_MAX) break;
+			block[1 + words*5] = letter;
+			memcpy(&block[2 + words*5], &value, sizeof(float));	// the host is little-endian too
+			words++;
+		}
+		if ((token != GC_TOKEN_END) && (token != GC_TOKEN_MESSAGE)) {
+			fprintf(stderr, "line %lu: bad word or more than %u words: %s\n", (unsigned long)i+1,
+				PGM_BLOCK_WORDS_MAX, text);
+			status = 1;
+			continue;
+		}
+		if (words == 0) continue;
+		printf("\t%u,", words);
+		for (uint8_t w = 0; w < words; w++) {
+			uint8_t *word = &block[1 + w*5];
+			printf(" '%c',0x%02X,0x%02X,0x%02X,0x%02X,", word[0], word[1], word[2], word[3], word[4]);
+		}
+		printf("\t// %s\n", text);
+	}
+	printf("\t0 };\n");
+	return (status);
+}
+
+/*
+ * _write_frames()  - write the loaded lines as Gcode frames, or as text if they can't be framed
+ * _encode_frames() - replace the loaded lines with their frames
+ */
+
+static int _write_frames(void)
+{
+	char frame[INPUT_BUFFER_LEN];
+
+	for (uint32_t i = 0; i < sim.line_count; i++) {
+		puts((sim_encode_frame(sim.line[i], frame, sizeof(frame)) > 0) ? frame : sim.line[i]);
+	}
+	return (0);
+}
+
+static void _encode_frames(void)
+{
+	char frame[INPUT_BUFFER_LEN];
+
+	for (uint32_t i = 0; i < sim.line_count; i++) {
+		if (sim_encode_frame(sim.line[i], frame, sizeof(frame)) > 0) {
+			free(sim.line[i]);
+			sim.line[i] = strdup(frame);
+		}
+	}
+}
+
+/*
+ * _sim_init() - the non-hardware part of _application_init() in main.c
+ */
+
+static void _sim_init(void)
+{
+	hardware_init();
+	persistence_init();
+	rtc_init();
+	xio_init();
+	stepper_init();
+	encoder_init();
+	switch_init();
+	pwm_init();
+	controller_init(STD_IN, STD_OUT, STD_ERR);
+	config_init();
+	network_init();
+	planner_init();
+	canonical_machine_init();
+}
+
+/*
+ * _service_interrupts() - run any pending software interrupts (load is higher priority)
+ */
+
+static void _service_interrupts(void)
+{
+	double start;
+
+	while ((TIMER_LOAD.CTRLA != 0) || (TIMER_EXEC.CTRLA != 0)) {
+		if (TIMER_LOAD.CTRLA != 0) {
+			TIMER_LOAD_ISR_vect();
+			continue;
+		}
+		uint8_t prep_index = st_pre.prep_index;
+		start = _now();
+		TIMER_EXEC_ISR_vect();
+		sim.exec_time += _now() - start;
+		if (st_pre.prep_index != prep_index) sim.segments++;
+	}
+}
+
+/*
+ * _run_segment() - tick the DDA or dwell timer to the end of the current segment
+ *
+ *	Returns false if no timer is running. The simulated clock drives rtc.sys_ticks
+ *	so the status report and motor timeout callbacks see realistic time. While the
+ *	first move of a cycle waits for the planner to prime the clock runs on in 1 ms
+ *	steps so the priming timeout ($px) can expire.
+ */
+
+static bool _run_segment(void)
+{
+	if (TIMER_DDA.CTRLA != 0) {
+		do {
+			TIMER_DDA_ISR_vect();
+			sim.dda_cycles += TIMER_DDA.PER;
+		} while ((TIMER_DDA.CTRLA != 0) && (TIMER_EXEC.CTRLA == 0) && (TIMER_LOAD.CTRLA == 0));
+
+	} else if (TIMER_DWELL.CTRLA != 0) {
+		do {
+			TIMER_DWELL_ISR_vect();
+			sim.dwell_ticks++;
+		} while ((TIMER_DWELL.CTRLA != 0) && (TIMER_EXEC.CTRLA == 0) && (TIMER_LOAD.CTRLA == 0));
+
+	} else if (mp_planner_is_priming()) {
+		sim.prime_ms++;
+
+	} else {
+		return (false);
+	}
+	rtc.sys_ticks = (uint32_t)(sim.dda_cycles * 1000 / (uint64_t)F_CPU +
+							   sim.dwell_ticks * 1000 / (uint64_t)FREQUENCY_DWELL + sim.prime_ms);
+	uint32_t rtc_ticks = rtc.sys_ticks / RTC_MILLISECONDS;
+	if (rtc_ticks != rtc.rtc_ticks) {
+		rtc.rtc_ticks = rtc_ticks;
+		controller_publish(TOPIC_TICK);				// as the RTC ISR does
+	}
+	return (true);
+}
+
+static bool _job_is_done(void)
+{
+	return (sim.eof_sent &&
+			(gc_reading_ahead() == false) &&				// no blocks read ahead still to run
+			(cm_get_motion_state() == MOTION_STOP) &&
+			(mp_get_planner_buffers_available() == PLANNER_BUFFER_POOL_SIZE));
+}
+
+/*
+ * _time_float_parse() - return the seconds parse_float() takes per replayed line
+ *
+ *	Parses the value of every word (a letter followed by a number) in every line, which is
+ *	the number conversion the Gcode parser does for a block. Repeated until the time is
+ *	long enough to measure.
+ */
+
+static double _time_float_parse(void)
+{
+	volatile float sink = 0;
+	uint32_t passes = 0;
+	double start = _now();
+	double elapsed;
+
+	if (sim.line_count == 0) return (0);
+	do {
+		for (uint32_t i = 0; i < sim.line_count; i++) {
+			for (const char *p = sim.line[i]; *p != NUL; p++) {
+				if (isalpha(*p) && isnumber(*(p+1))) sink += parse_float(p+1, NULL);
+			}
+		}
+		passes++;
+	} while ((elapsed = _now() - start) < 0.05);
+	return (elapsed / ((double)passes * sim.line_count));
+}
+
+static float _job_time(void)
+{
+	return ((float)sim.dda_cycles / F_CPU + sim.dwell_ticks / FREQUENCY_DWELL + sim.prime_ms / 1000.0);
+}
+
+static void _print_report(char *name)
+{
+	float job_time = _job_time();
+
+	fprintf(sim.report, "%-28s %7lu blocks %10.0f blocks/sec %8lu segs %10.0f segs/sec %6.0f ns/blk float %6.0f us max blk   job %02u:%02u:%05.2f\n",
+		basename(name),
+		(unsigned long)sim.blocks, (sim.plan_time > 0) ? sim.blocks / sim.plan_time : 0,
+		(unsigned long)sim.segments, (sim.exec_time > 0) ? sim.segments / sim.exec_time : 0,
+		_time_float_parse() * 1e9, sim.max_block * 1e6,
+		(unsigned)(job_time / 3600), (unsigned)(fmod(job_time, 3600) / 60), fmod(job_time, 60));
+}
+
+/*
+ * _write_baseline() - append the job's cycle time baseline line to a file
+ * _check_baseline() - compare the job with its line in a baseline file
+ *
+ *	A baseline line is: name, job time (sec), planner CPU time (ms), max block latency (usec).
+ *	Lines starting with # are comments. The job time is the simulated motion time and is
+ *	deterministic, so any change beyond SIM_JOB_TOLERANCE fails - a job that got faster
+ *	has changed its motion as much as one that got slower. The planner CPU time is a host
+ *	time and fails if it grows by more than SIM_CPU_TOLERANCE. It is only comparable on
+ *	the host that wrote the baseline. The max block latency is marked if it grows by as
+ *	much but does not fail the job: a single preemption of the host process swamps it.
+ *	The latency check that counts is the one $test=60.. makes on the board (see test.c).
+ *
+ *	Returns 0 if the job passes, 1 if it fails and 2 if it has no baseline.
+ */
+
+static int _write_baseline(const char *file, char *name)
+{
+	FILE *f;
+
+	if ((f = fopen(file, "a")) == NULL) {
+		perror(file);
+		return (2);
+	}
+	fprintf(f, "%-28s %10.2f %10.3f %8.0f\n", basename(name), _job_time(), sim.plan_time * 1e3, sim.max_block * 1e6);
+	fclose(f);
+	return (0);
+}
+
+static bool _exceeds(double value, double base, double tolerance)
+{
+	return (value > base * (1 + tolerance / 100));
+}
+
+static int _check_baseline(const char *file, char *name)
+{
+	char buf[SIM_LINE_MAX];
+	char base_name[SIM_LINE_MAX];
+	double base_job, base_plan, base_block;
+	double job = _job_time(), plan = sim.plan_time * 1e3, block = sim.max_block * 1e6;
+	FILE *f;
+
+	if ((f = fopen(file, "r")) == NULL) {
+		perror(file);
+		return (2);
+	}
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		if (buf[0] == '#') continue;
+		if (sscanf(buf, "%255s %lf %lf %lf", base_name, &base_job, &base_plan, &base_block) != 4) continue;
+		if (strcmp(base_name, basename(name)) != 0) continue;
+		fclose(f);
+
+		bool job_fail = (fabs(job - base_job) > base_job * SIM_JOB_TOLERANCE / 100);
+		bool plan_fail = _exceeds(plan, base_plan, SIM_CPU_TOLERANCE);
+		bool block_warn = _exceeds(block, base_block, SIM_CPU_TOLERANCE);
+		fprintf(sim.report, "%-28s job %10.2f s (%10.2f)%s  plan %9.3f ms (%9.3f)%s  max blk %6.0f us (%6.0f)%s  %s\n",
+			basename(name), job, base_job, job_fail ? "*" : " ", plan, base_plan, plan_fail ? "*" : " ",
+			block, base_block, block_warn ? "?" : " ", (job_fail || plan_fail) ? "FAIL" : "PASS");
+		return ((job_fail || plan_fail) ? 1 : 0);
+	}
+	fclose(f);
+	fprintf(sim.report, "%-28s no baseline in %s\n", basename(name), file);
+	return (2);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t idle_passes = 0;
+	bool quiet = false;
+	bool frames = false;
+	bool encode = false;
+	bool json = false;
+	int arg = 1;
+	double start, pass;
+
+	const char *blocks = NULL;
+	const char *check = NULL;
+	const char *write = NULL;
+	while (arg < argc) {
+		if (strcmp(argv[arg], "-q") == 0) {
+			quiet = true;
+			arg++;
+		} else if (strcmp(argv[arg], "-e") == 0) {
+			encode = true;
+			arg++;
+		} else if (strcmp(argv[arg], "-f") == 0) {
+			frames = true;
+			arg++;
+		} else if (strcmp(argv[arg], "-j") == 0) {
+			json = true;
+			arg++;
+		} else if ((arg+1 < argc) && (strcmp(argv[arg], "-b") == 0)) {
+			blocks = argv[arg+1];
+			arg += 2;
+		} else if ((arg+1 < argc) && (strcmp(argv[arg], "-r") == 0)) {
+			check = argv[arg+1];
+			arg += 2;
+		} else if ((arg+1 < argc) && (strcmp(argv[arg], "-w") == 0)) {
+			write = argv[arg+1];
+			arg += 2;
+		} else {
+			break;
+		}
+	}
+	if (arg >= argc) {
+		fprintf(stderr, "usage: %s [-q] [-f] [-r baseline | -w baseline] file...\n", argv[0]);
+		fprintf(stderr, "       %s -b name file...\n", argv[0]);
+		fprintf(stderr, "       %s -e file...\n", argv[0]);
+		fprintf(stderr, "       %s -j file...\n", argv[0]);
+		fprintf(stderr, "  replays gcode files (or PROGMEM .h headers) as a single job\n");
+		fprintf(stderr, "  -q  discard controller responses; only the summary is printed\n");
+		fprintf(stderr, "  -f  stream the job as Gcode frames, encoded before it starts\n");
+		fprintf(stderr, "  -r  check the job against its line in a cycle time baseline file\n");
+		fprintf(stderr, "  -w  append the job's cycle time line to a baseline file\n");
+		fprintf(stderr, "  -b  write the files as stored block program <name> to stdout instead\n");
+		fprintf(stderr, "  -e  write the files as Gcode frames to stdout instead\n");
+		fprintf(stderr, "  -j  time the files as JSON commands among status and config traffic instead\n");
+		return (2);
+	}
+	for (int i = arg; i < argc; i++) {
+		if (_load_file(argv[i]) != 0) return (2);
+	}
+	if (blocks != NULL) {
+		return (_write_blocks(blocks));
+	}
+	if (encode) {
+		return (_write_frames());
+	}
+	if (frames) {
+		_encode_frames();
+	}
+	sim.report = stderr;
+	if (quiet) {									// controller output goes to stdout and stderr
+		sim.report = fdopen(dup(fileno(stderr)), "w");
+		if ((sim.report == NULL) ||
+			(freopen("/dev/null", "w", stdout) == NULL) ||
+			(freopen("/dev/null", "w", stderr) == NULL)) return (2);
+	}
+
+	_sim_init();
+	if (json) {
+		return (sim_json_bench(sim.line, sim.line_count, sim.report));
+	}
+
+	while (_job_is_done() == false) {
+		sim.line_read = false;
+		start = _now();
+		sim_controller_pass();
+		pass = _now() - start;
+		sim.plan_time += pass;
+		if (sim.line_read && (pass > sim.max_block)) sim.max_block = pass;
+		_service_interrupts();
+		if (sim.line_read) {
+			idle_passes = 0;
+			continue;
+		}
+		if (_run_segment()) {
+			idle_passes = 0;
+		} else if (++idle_passes > SIM_STALL_PASSES) {
+			fprintf(sim.report, "%s: stalled at line %lu with %u planner buffers queued\n", argv[arg],
+				(unsigned long)sim.line_index,
+				(unsigned)(PLANNER_BUFFER_POOL_SIZE - mp_get_planner_buffers_available()));
+			_print_report(argv[arg]);
+			return (1);
+		}
+	}
+	char *name = (argc - arg == 1) ? argv[arg] : (char *)"(job)";
+	_print_report(name);
+	if (write != NULL) return (_write_baseline(write, name));
+	if (check != NULL) return (_check_baseline(check, name));
+	return (0);
+}
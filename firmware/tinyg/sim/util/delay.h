@@ -0,0 +1,3 @@
+/* sim/util/delay.h - host mock; delays are no-ops in the simulation */
+#define _delay_ms(ms)
+#define _delay_us(us)
@@ -30,8 +30,10 @@
 #include "spindle.h"
 #include "gpio.h"
 #include "planner.h"
+#include "encoder.h"
 #include "hardware.h"
 #include "pwm.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -39,6 +41,39 @@ extern "C"{
 
 static void _exec_spindle_control(float *value, float *flag);
 static void _exec_spindle_speed(float *value, float *flag);
+static void _exec_spindle_css(float *value, float *flag);
+static void _queue_spindle_css(void);
+static void _set_spindle(uint8_t spindle_mode);
+static void _start_spindle_ramp(uint8_t spindle_mode);
+static uint8_t _pwm2_in_use(void);
+static uint8_t _pwm2_selected(void);
+static void _exec_pwm2(float *value, float *flag);
+static float _get_phase(uint8_t chan, uint8_t spindle_mode, float *speed);
+
+/*
+ * Spindle ramp
+ *
+ *	A VFD spindle takes seconds to change speed. With $p1acc set the ramp is modelled
+ *	from the speed the spindle should be at when each speed or direction change runs,
+ *	and the first feed move after a change waits only for what is left of the ramp -
+ *	traverses carry on meanwhile. Direction changes ramp through zero. Laser mode
+ *	never waits.
+ */
+typedef struct spSpindleRamp {
+	uint8_t wait_pending;				// TRUE if the next feed must wait (model - main loop)
+	float start_speed;					// signed speed at the start of the ramp, CCW negative (runtime)
+	float end_speed;					// signed speed the spindle is ramping to
+	uint32_t start_time;				// SysTick time of the start of the ramp (ms)
+	uint32_t ramp_time;					// length of the ramp (ms)
+	float angle;						// spindle angle in revolutions, 0 to 1 (see cm_get_spindle_turns())
+	int32_t last_counts;				// spindle encoder count at the last reading
+	float css_speed;					// G96 surface speed in mm/min, 0 if off (runtime)
+	float css_max;						// G96 max speed in RPM, 0 if none
+	uint8_t pwm2_mode;					// PWM_2 spindle mode (runtime - see _exec_pwm2())
+	float pwm2_speed;					// PWM_2 speed
+} spSpindleRamp_t;
+
+static spSpindleRamp_t sp;
 
 /*
  * cm_spindle_init()
@@ -50,36 +85,177 @@ void cm_spindle_init()
 
     pwm_set_freq(PWM_1, pwm.c[PWM_1].frequency);
     pwm_set_duty(PWM_1, pwm.c[PWM_1].phase_off);
+
+	sp.pwm2_mode = SPINDLE_OFF;
+	if (_pwm2_in_use() == true) {				// else its pin stays a gpio1 output
+		pwm_set_freq(PWM_2, pwm.c[PWM_2].frequency);
+		pwm_set_duty(PWM_2, pwm.c[PWM_2].phase_off);
+		pwm_enable_output(PWM_2);
+	}
+}
+
+/*
+ * Second PWM channel
+ *
+ *	PWM_2 drives a second spindle or a laser - the laser of a hybrid head, say - picked
+ *	by tool number. While the tool loaded by M6 is $p2tn, M3, M4, M5 and S drive PWM_2
+ *	instead of the spindle, which carries on as it was. Both can be on at once, and going
+ *	from one to the other in a job is just a T M6. Its commands are queued and run in
+ *	step with the moves like the spindle's, and with $p2lsr=1 its power follows the
+ *	segment velocity (without dithering or raster pixels). Ramps ($p1acc), G96 and the
+ *	spindle wait are PWM_1 only - an S is taken as is. Program end, alarms and probing
+ *	turn both off (cm_spindle_stop()).
+ *
+ *	$p2tn = 0 leaves PWM_2 off and its pin to gpio1. It is read at reset.
+ *
+ * _pwm2_in_use()	- return TRUE if PWM_2 is set up ($p2tn)
+ * _pwm2_selected() - return TRUE if M3, M4, M5 and S go to PWM_2 (model)
+ * _exec_pwm2()		- set the PWM_2 mode (flag[0]) or speed (flag[1]) (runtime)
+ */
+
+static uint8_t _pwm2_in_use()
+{
+#ifdef __ENCODER_QDEC
+	return (false);								// its timer is the quadrature decoder
+#else
+	return (pwm.c[PWM_2].tool != 0);
+#endif
+}
+
+static uint8_t _pwm2_selected()
+{
+	return ((_pwm2_in_use() == true) && (cm.gmx.tool == pwm.c[PWM_2].tool));
+}
+
+static void _exec_pwm2(float *value, float *flag)
+{
+	if (fp_TRUE(flag[0])) { sp.pwm2_mode = (uint8_t)value[0];}
+	if (fp_TRUE(flag[1])) { sp.pwm2_speed = value[1];}
+	if ((pwm.c[PWM_2].laser_mode == false) || (sp.pwm2_mode == SPINDLE_OFF)) {
+		pwm_set_duty(PWM_2, _get_phase(PWM_2, sp.pwm2_mode, &sp.pwm2_speed));
+	}
 }
 
 /*
  * cm_get_spindle_pwm() - return PWM phase (duty cycle) for dir and speed
+ * _get_phase() - return the phase of a PWM channel for dir and speed
+ *
+ *	The spindle override (M51, or the realtime override chars) scales S after it is
+ *	clamped, and the result is clamped again so the override can't leave the speed range.
+ *	The speed is clamped in place.
  */
 float cm_get_spindle_pwm( uint8_t spindle_mode )
-{
+{
+	return (_get_phase(PWM_1, spindle_mode, &cm.gm.spindle_speed));
+}
+
+static float _get_phase(uint8_t chan, uint8_t spindle_mode, float *speed)
+{
 	float speed_lo=0, speed_hi=0, phase_lo=0, phase_hi=0;
 	if (spindle_mode == SPINDLE_CW ) {
-		speed_lo = pwm.c[PWM_1].cw_speed_lo;
-		speed_hi = pwm.c[PWM_1].cw_speed_hi;
-		phase_lo = pwm.c[PWM_1].cw_phase_lo;
-		phase_hi = pwm.c[PWM_1].cw_phase_hi;
+		speed_lo = pwm.c[chan].cw_speed_lo;
+		speed_hi = pwm.c[chan].cw_speed_hi;
+		phase_lo = pwm.c[chan].cw_phase_lo;
+		phase_hi = pwm.c[chan].cw_phase_hi;
 	} else if (spindle_mode == SPINDLE_CCW ) {
-		speed_lo = pwm.c[PWM_1].ccw_speed_lo;
-		speed_hi = pwm.c[PWM_1].ccw_speed_hi;
-		phase_lo = pwm.c[PWM_1].ccw_phase_lo;
-		phase_hi = pwm.c[PWM_1].ccw_phase_hi;
+		speed_lo = pwm.c[chan].ccw_speed_lo;
+		speed_hi = pwm.c[chan].ccw_speed_hi;
+		phase_lo = pwm.c[chan].ccw_phase_lo;
+		phase_hi = pwm.c[chan].ccw_phase_hi;
 	}
 
 	if (spindle_mode==SPINDLE_CW || spindle_mode==SPINDLE_CCW ) {
 		// clamp spindle speed to lo/hi range
-		if( cm.gm.spindle_speed < speed_lo ) cm.gm.spindle_speed = speed_lo;
-		if( cm.gm.spindle_speed > speed_hi ) cm.gm.spindle_speed = speed_hi;
+		if( *speed < speed_lo ) *speed = speed_lo;
+		if( *speed > speed_hi ) *speed = speed_hi;
+
+		float speed_rpm = *speed;
+		if (cm.gmx.spindle_override_enable == true) {
+			speed_rpm *= cm.gmx.spindle_override_factor;
+			if (speed_rpm < speed_lo) speed_rpm = speed_lo;
+			if (speed_rpm > speed_hi) speed_rpm = speed_hi;
+		}
 
 		// normalize speed to [0..1]
-		float speed = (cm.gm.spindle_speed - speed_lo) / (speed_hi - speed_lo);
-		return (speed * (phase_hi - phase_lo)) + phase_lo;
+		float speed_n = (speed_rpm - speed_lo) / (speed_hi - speed_lo);
+		return (speed_n * (phase_hi - phase_lo)) + phase_lo;
+	} else {
+		return pwm.c[chan].phase_off;
+	}
+}
+
+/*
+ * cm_get_laser_pwm() - return PWM phase for a segment in laser mode ($p1lsr=1, $p2lsr=1)
+ * cm_get_laser_mode() - return TRUE if the channel is a laser in use
+ *
+ *	In laser mode the power set by S is scaled by the segment velocity over the velocity
+ *	the move was planned for, so the energy put into each mm stays the same through
+ *	accel ramps and corners. The exec computes the phase for every segment and the
+ *	loader applies it as the segment starts (see st_prep_laser()). Spindle commands
+ *	only turn the laser off - it is never on while the machine is standing still.
+ */
+float cm_get_laser_pwm(uint8_t chan, float velocity_ratio)
+{
+	float phase_off = pwm.c[chan].phase_off;
+
+	if (velocity_ratio <= 0) { return (phase_off);}
+	if (velocity_ratio > 1) { velocity_ratio = 1;}
+	float phase = (chan == PWM_1) ? cm_get_spindle_pwm(cm.gm.spindle_mode) :
+									_get_phase(PWM_2, sp.pwm2_mode, &sp.pwm2_speed);
+	return (phase_off + (phase - phase_off) * velocity_ratio);
+}
+
+uint8_t cm_get_laser_mode(uint8_t chan)
+{
+	if ((chan == PWM_2) && (_pwm2_in_use() == false)) { return (false);}
+	return (pwm.c[chan].laser_mode);
+}
+
+/*
+ * cm_sync_spindle() - queue a wait for the spindle ramp if a speed change is pending
+ * cm_spindle_wait_pending() - return true if the next feed queues a spindle wait (planner headroom)
+ * cm_get_spindle_wait() - return the ms left until the ramp should finish (from the loader)
+ * _start_spindle_ramp() - start a ramp to the runtime spindle mode and speed
+ *
+ *	cm_sync_spindle() is called by the planner ahead of each feed move (see mp_aline()).
+ *	The wait is a dwell the loader sizes when it reaches it, so it is timed from when
+ *	the spindle command actually ran.
+ */
+
+void cm_sync_spindle()
+{
+	if (sp.wait_pending == false) return;
+	sp.wait_pending = false;
+	if ((fp_ZERO(pwm.c[PWM_1].spindle_accel)) || (pwm.c[PWM_1].laser_mode == true)) return;
+	mp_spindle_wait();
+}
+
+uint8_t cm_spindle_wait_pending() { return (sp.wait_pending);}
+
+uint32_t cm_get_spindle_wait()
+{
+	uint32_t elapsed = SysTickTimer_getValue() - sp.start_time;
+	if (elapsed >= sp.ramp_time) return (0);
+	return (sp.ramp_time - elapsed);
+}
+
+static void _start_spindle_ramp(uint8_t spindle_mode)
+{
+	float speed = 0;
+	if (spindle_mode == SPINDLE_CW) { speed = cm.gm.spindle_speed;}
+	if (spindle_mode == SPINDLE_CCW) { speed = -cm.gm.spindle_speed;}
+
+	uint32_t remaining = cm_get_spindle_wait();		// it may still be ramping to the last speed
+	if (remaining != 0) {
+		sp.start_speed = sp.end_speed - (sp.end_speed - sp.start_speed) * remaining / sp.ramp_time;
 	} else {
-		return pwm.c[PWM_1].phase_off;
+		sp.start_speed = sp.end_speed;
+	}
+	sp.end_speed = speed;
+	sp.start_time = SysTickTimer_getValue();
+	sp.ramp_time = 0;
+	if (fp_NOT_ZERO(pwm.c[PWM_1].spindle_accel)) {
+		sp.ramp_time = (uint32_t)(fabs(sp.end_speed - sp.start_speed) * 1000 / pwm.c[PWM_1].spindle_accel);
 	}
 }
 
@@ -91,7 +267,15 @@ float cm_get_spindle_pwm( uint8_t spindle_mode )
 stat_t cm_spindle_control(uint8_t spindle_mode)
 {
 	float value[AXES] = { (float)spindle_mode, 0,0,0,0,0 };
-	mp_queue_command(_exec_spindle_control, value, value);
+	if (_pwm2_selected() == true) {
+		float flag[AXES] = { 1,0,0,0,0,0 };
+		mp_queue_segment_command(_exec_pwm2, value, flag);
+		return (STAT_OK);
+	}
+	mp_queue_segment_command(_exec_spindle_control, value, value);
+	if (spindle_mode != SPINDLE_OFF) {
+		sp.wait_pending = true;						// feeds wait for it to spin up (not down)
+	}
 	return(STAT_OK);
 }
 
@@ -100,7 +284,38 @@ static void _exec_spindle_control(float *value, float *flag)
 {
 	uint8_t spindle_mode = (uint8_t)value[0];
 	cm_set_spindle_mode(MODEL, spindle_mode);
+	_set_spindle(spindle_mode);
+}
+
+/*
+ * cm_spindle_stop() - queue the spindle and PWM_2 off (program end, alarms and probing)
+ */
+
+void cm_spindle_stop()
+{
+	float value[AXES] = { SPINDLE_OFF, 0,0,0,0,0 };
+	if (_pwm2_in_use() == true) {
+		float flag[AXES] = { 1,0,0,0,0,0 };
+		mp_queue_segment_command(_exec_pwm2, value, flag);
+	}
+	mp_queue_segment_command(_exec_spindle_control, value, value);
+}
+
+/*
+ * cm_set_spindle_direction() - run the spindle in a direction without changing the Gcode model
+ * _set_spindle() - drive the spindle outputs and start the ramp
+ *
+ *	cm_set_spindle_direction() reverses the spindle for a rigid tap from the runtime and
+ *	puts it back once the tap is out (see mp_exec_sync()).
+ */
+
+void cm_set_spindle_direction(uint8_t spindle_mode)
+{
+	_set_spindle(spindle_mode);
+}
 
+static void _set_spindle(uint8_t spindle_mode)
+{
  #ifdef __AVR
 	if (spindle_mode == SPINDLE_CW) {
 		gpio_set_bit_on(SPINDLE_BIT);
@@ -124,8 +339,11 @@ static void _exec_spindle_control(float *value, float *flag)
 	}
 #endif // __ARM
 
-	// PWM spindle control
-	pwm_set_duty(PWM_1, cm_get_spindle_pwm(spindle_mode) );
+	// PWM spindle control. In laser mode the segments turn the power on
+	if ((pwm.c[PWM_1].laser_mode == false) || (spindle_mode == SPINDLE_OFF)) {
+		pwm_set_duty(PWM_1, cm_get_spindle_pwm(spindle_mode) );
+	}
+	_start_spindle_ramp(spindle_mode);
 }
 
 /*
@@ -138,8 +356,21 @@ stat_t cm_set_spindle_speed(float speed)
 //	if (speed > cfg.max_spindle speed)
 //        return (STAT_MAX_SPINDLE_SPEED_EXCEEDED);
 
+	if (_pwm2_selected() == true) {
+		float value[AXES] = { 0, speed, 0,0,0,0 };
+		float flag[AXES] = { 0,1,0,0,0,0 };
+		mp_queue_segment_command(_exec_pwm2, value, flag);
+		return (STAT_OK);
+	}
+	if (cm.gmx.spindle_css_mode == true) {		// G96 - S is the surface speed in m/min or ft/min
+		cm.gmx.spindle_css_speed = speed * ((cm.gm.units_mode == INCHES) ? (12 * MM_PER_INCH) : 1000);
+		_queue_spindle_css();
+		sp.wait_pending = true;
+		return (STAT_OK);
+	}
 	float value[AXES] = { speed, 0,0,0,0,0 };
-	mp_queue_command(_exec_spindle_speed, value, value);
+	mp_queue_segment_command(_exec_spindle_speed, value, value);
+	sp.wait_pending = true;
 	return (STAT_OK);
 }
 
@@ -150,8 +381,123 @@ void cm_exec_spindle_speed(float speed)
 
 static void _exec_spindle_speed(float *value, float *flag)
 {
+	sp.css_speed = 0;							// an RPM ends constant surface speed
 	cm_set_spindle_speed_parameter(MODEL, value[0]);
-	pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode) ); // update spindle speed if we're running
+	if (pwm.c[PWM_1].laser_mode == false) {		// in laser mode the next segment picks it up
+		pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode) ); // update spindle speed if we're running
+	}
+	_start_spindle_ramp(cm.gm.spindle_mode);
+}
+
+/*
+ * cm_update_spindle_override() - apply a new spindle override factor to the running spindle
+ *
+ *	Overrides act on the spindle that is running now, not on the queued S words, so the
+ *	PWM is updated directly - PWM_2's too. In laser mode the next segment picks it up.
+ */
+
+void cm_update_spindle_override()
+{
+	if ((_pwm2_in_use() == true) && (pwm.c[PWM_2].laser_mode == false) && (sp.pwm2_mode != SPINDLE_OFF)) {
+		pwm_set_duty(PWM_2, _get_phase(PWM_2, sp.pwm2_mode, &sp.pwm2_speed));
+	}
+	if ((pwm.c[PWM_1].laser_mode == true) || (cm.gm.spindle_mode == SPINDLE_OFF)) return;
+	pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode));
+}
+
+/*
+ * cm_set_spindle_css_mode() - G96, G97 - S is a surface speed (G96) or RPM (G97)
+ * cm_set_spindle_css_max()	 - G96 D - max spindle speed in constant surface speed
+ * cm_update_spindle_css()	 - set the spindle speed for the X radius of a segment (runtime)
+ * cm_get_spindle_css()		 - return TRUE if constant surface speed is on (runtime)
+ *
+ *	With G96 the runtime sets the speed from the surface speed and the X radius (in work
+ *	coordinates, X0 on the spindle axis) of each segment it preps, so the speed follows
+ *	the tool across a facing pass without a queued S word per step. The speed is limited
+ *	to D and, by cm_get_spindle_pwm(), to the PWM speed range - which is also what it
+ *	runs at on the axis. G97 leaves the spindle at the speed it got to, until an S.
+ *
+ *	The speed is set when the segment is prepped, a few segments ahead of the steppers.
+ *	The ramp ($p1acc) is not modelled through the changes.
+ */
+
+stat_t cm_set_spindle_css_mode(uint8_t css_mode)
+{
+	cm.gmx.spindle_css_mode = css_mode;
+	if (cm.gf.spindle_speed == false) {			// else the S in the block queues it
+		_queue_spindle_css();
+	}
+	return (STAT_OK);
+}
+
+void cm_set_spindle_css_max(float speed)
+{
+	cm.gmx.spindle_css_max = speed;
+}
+
+static void _queue_spindle_css()
+{
+	float value[AXES] = { 0, cm.gmx.spindle_css_max, 0,0,0,0 };
+	if (cm.gmx.spindle_css_mode == true) { value[0] = cm.gmx.spindle_css_speed;}
+	mp_queue_segment_command(_exec_spindle_css, value, value);
+}
+
+static void _exec_spindle_css(float *value, float *flag)
+{
+	sp.css_speed = value[0];
+	sp.css_max = value[1];
+}
+
+void cm_update_spindle_css(float radius)
+{
+	if ((fp_ZERO(sp.css_speed)) || (pwm.c[PWM_1].laser_mode == true)) return;
+
+	float speed = sp.css_speed / (2 * M_PI * max(fabs(radius), EPSILON));
+	if ((sp.css_max > 0) && (speed > sp.css_max)) { speed = sp.css_max;}
+	cm_set_spindle_speed_parameter(MODEL, speed);
+	if (cm.gm.spindle_mode != SPINDLE_OFF) {
+		pwm_set_duty(PWM_1, cm_get_spindle_pwm(cm.gm.spindle_mode));	// clamps the speed to the PWM range
+	}
+}
+
+uint8_t cm_get_spindle_css() { return (fp_NOT_ZERO(sp.css_speed));}
+
+/*
+ * cm_get_spindle_turns() - return the revolutions the spindle turned since the last call
+ *
+ *	Read by the runtime once a segment for spindle synchronized motion (see mp_exec_sync()),
+ *	with the segment time in minutes. CW is positive. The spindle angle is returned in
+ *	revolutions from 0 to 1, where 0 is the index each thread pass starts from.
+ *
+ *	A spindle encoder ($p1enc counts per revolution) is read as sampled by the loader, and
+ *	its count of 0 is the index. Without one the spindle is modelled by running the speed
+ *	and its ramp ($p1acc) over the segment - which holds for a spindle that follows S
+ *	closely, such as a servo spindle, and in the simulator. The model ignores the
+ *	spindle override.
+ */
+
+float cm_get_spindle_turns(float segment_time, float *angle)
+{
+	float turns;
+	int32_t counts;
+
+	if (en_get_spindle_counts(&counts) == true) {
+		float counts_per_rev = en.spindle_counts_per_rev;
+		turns = (float)(counts - sp.last_counts) / counts_per_rev;
+		sp.last_counts = counts;
+		sp.angle = (float)counts / counts_per_rev;
+	} else {
+		float speed = sp.end_speed;
+		uint32_t remaining = cm_get_spindle_wait();
+		if (remaining != 0) {
+			speed -= (sp.end_speed - sp.start_speed) * remaining / sp.ramp_time;
+		}
+		turns = speed * segment_time;
+		sp.angle += turns;
+	}
+	sp.angle -= floor(sp.angle);
+	*angle = sp.angle;
+	return (turns);
 }
 
 #ifdef __cplusplus
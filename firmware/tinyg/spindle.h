@@ -43,6 +43,23 @@ void cm_exec_spindle_speed(float speed);			// callback for above
 
 stat_t cm_spindle_control(uint8_t spindle_mode);	// M3, M4, M5 integrated spindle control
 void cm_exec_spindle_control(uint8_t spindle_mode);	// callback for above
+void cm_spindle_stop(void);							// spindle and PWM_2 off
+
+float cm_get_spindle_pwm(uint8_t spindle_mode);	// PWM phase for the spindle mode and S
+float cm_get_laser_pwm(uint8_t chan, float velocity_ratio);	// PWM phase for a segment in laser mode
+uint8_t cm_get_laser_mode(uint8_t chan);			// TRUE if the PWM channel is a laser in use
+void cm_update_spindle_override(void);				// apply the spindle override to the PWM
+
+stat_t cm_set_spindle_css_mode(uint8_t css_mode);	// G96, G97
+void cm_set_spindle_css_max(float speed);			// G96 D
+void cm_update_spindle_css(float radius);			// set the speed for a segment in G96
+uint8_t cm_get_spindle_css(void);
+
+void cm_sync_spindle(void);							// make the next feed wait for the spindle
+uint8_t cm_spindle_wait_pending(void);				// true if the next feed queues a spindle wait
+uint32_t cm_get_spindle_wait(void);				// ms until the spindle should be at speed
+void cm_set_spindle_direction(uint8_t spindle_mode);	// drive the spindle without changing the model
+float cm_get_spindle_turns(float segment_time, float *angle);	// revolutions since the last call
 
 #ifdef __cplusplus
 }
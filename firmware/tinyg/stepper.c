@@ -34,21 +34,34 @@
 #include "stepper.h"
 #include "encoder.h"
 #include "planner.h"
+#include "kinematics.h"
 #include "report.h"
 #include "hardware.h"
+#include "controller.h"
+#include "pwm.h"
+#include "gpio.h"
+#include "spindle.h"
 #include "text_parser.h"
 #include "util.h"
+#include "perf.h"
 
 /**** Allocate structures ****/
 
 stConfig_t st_cfg;
 stPrepSingleton_t st_pre;
 static stRunSingleton_t st_run;
+#ifdef __ISR_TIMING
+stTimingSingleton_t st_tim;
+#endif
 
 /**** Setup local functions ****/
 
 static void _load_move(void);
 static void _request_load_move(void);
+static void _release_raster(void);
+static float _get_accumulator_correction(const uint32_t ticks, const uint32_t prev_ticks);
+static float _get_dda_frequency(const float travel_steps[], const float segment_time);
+static void _set_hw_microsteps(const uint8_t motor, const uint8_t microsteps);
 #ifdef __ARM
 static void _set_motor_power_level(const uint8_t motor, const float power_level);
 #endif
@@ -56,6 +69,30 @@ static void _set_motor_power_level(const uint8_t motor, const float power_level)
 // handy macro
 #define _f_to_period(f) (uint16_t)((float)F_CPU / (float)f)
 
+/**** ISR timing (see stepper.h) ****/
+
+#ifdef __ISR_TIMING
+#ifndef __AVR
+#error "__ISR_TIMING is only supported on the AVR"
+#endif
+#define TIMING_START(t)				uint16_t t = TIMER_CYCLES.CNT
+#define TIMING_END(stat, t, shift)	st_timing_record(&st_tim.stat, TIMER_CYCLES.CNT - t, shift)
+#define TIMING_SEGMENT_END()		{ st_tim.segment_end = TIMER_CYCLES.CNT; st_tim.segment_ended = true;}
+#define TIMING_SEGMENT_START()		if (st_tim.segment_ended) { st_tim.segment_ended = false; \
+										TIMING_END(gap, st_tim.segment_end, ST_TIMING_ISR_SHIFT);}
+#define TIMING_SEGMENT_STARVED()	if (st_tim.segment_ended) { st_tim.segment_ended = false; st_tim.starved++;}
+#else
+#define TIMING_START(t)
+#define TIMING_END(stat, t, shift)
+#define TIMING_SEGMENT_END()
+#define TIMING_SEGMENT_START()
+#define TIMING_SEGMENT_STARVED()
+#endif
+
+#if defined(__PLAN_ISR) && !defined(__ARM)
+#error "__PLAN_ISR is only supported on the ARM"
+#endif
+
 /**** Setup motate ****/
 
 #ifdef __ARM
@@ -199,6 +236,11 @@ Stepper<kSocket6_StepPinNumber,
 void stepper_init()
 {
 	memset(&st_run, 0, sizeof(st_run));			// clear all values, pointers and status
+	memset(&st_pre, 0, sizeof(st_pre));
+	for (uint8_t i=0; i<PREP_RING_SIZE; i++) {
+		st_pre.seg[i].buffer_state = PREP_BUFFER_OWNED_BY_EXEC;	// prep ring starts empty
+	}
+	st_pre.backoff_factor = 1.0;
 	stepper_init_assertions();
 
 #ifdef __AVR
@@ -233,7 +275,6 @@ void stepper_init()
 	TIMER_EXEC.INTCTRLA = TIMER_EXEC_INTLVL;	// interrupt mode
 	TIMER_EXEC.PER = EXEC_TIMER_PERIOD;			// set period
 
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;
 	st_reset();									// reset steppers to known state
 #endif // __AVR
 
@@ -250,7 +291,11 @@ void stepper_init()
 
 	// setup software interrupt exec timer & initial condition
 	exec_timer.setInterrupts(kInterruptOnSoftwareTrigger | kInterruptPriorityLowest);
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;
+
+#ifdef __PLAN_ISR
+	// PendSV runs the planning at the lowest priority (see st_request_plan())
+	NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+#endif
 
 	// setup motor power levels and apply power level to stepper drivers
 	for (uint8_t motor=0; motor<MOTORS; motor++) {
@@ -309,20 +354,99 @@ void st_reset()
 		st_pre.mot[motor].prev_direction = STEP_INITIAL_DIRECTION;
 		st_run.mot[motor].substep_accumulator = 0;	// will become max negative during per-motor setup;
 		st_pre.mot[motor].corrected_steps = 0;		// diagnostic only - no action effect
+		st_pre.mot[motor].corrections = 0;
+		st_pre.mot[motor].correction_age = 255;		// no correction in flight
+		st_pre.mot[motor].backlash_direction = 0;	// backlash side is not known
+		st_pre.mot[motor].backlash_takeup = 0;
+		st_pre.mot[motor].full_steps = false;
+		if (st_run.mot[motor].microstep_shift != 0) {	// full steps are also a microstep boundary
+			st_run.mot[motor].microstep_shift = 0;
+			_set_hw_microsteps(motor, (uint8_t)st_cfg.mot[motor].microsteps);
+		}
 	}
+	st_pre.dda_residue = 0;
+	st_pre.cached_segment_time = 0;						// recompute the segment timing
+	st_pre.held_motors = 0;
 	mp_set_steps_to_runtime_position();
 }
 
 /*
  * st_clc() - clear counters
+ * _clear_underruns() - clear the underrun and late load totals (see stepper.h)
  */
 
+static void _clear_underruns()
+{
+#ifdef __AVR
+	cli();										// exec totals them from the LO interrupt
+#endif
+	st_pre.underrun_count = 0;
+	st_pre.underrun_line = 0;
+	st_pre.late_load_count = 0;
+	st_pre.late_load_line = 0;
+	st_pre.backoff_seen = 0;
+#ifdef __AVR
+	sei();
+#endif
+}
+
 stat_t st_clc(nvObj_t *nv)	// clear diagnostic counters, reset stepper prep
 {
+	_clear_underruns();
 	st_reset();
 	return(STAT_OK);
 }
 
+/*
+ * st_clear_timing()	 - clear ISR timing counters
+ * st_get_timing_mean()	 - get mean cycles of the timing stat the table entry points to
+ * st_get_timing_budget() - get the slowest pass as a percent of a nominal segment
+ * st_timing_record()	 - add a pass to a timing stat (called from the ISRs and exec)
+ */
+#ifdef __ISR_TIMING
+stat_t st_clear_timing(nvObj_t *nv)
+{
+	cli();
+	memset(&st_tim, 0, sizeof(st_tim));
+	sei();
+	return(STAT_OK);
+}
+
+stat_t st_get_timing_mean(nvObj_t *nv)
+{
+	stTimingStat_t *t = (stTimingStat_t *)GET_TABLE_WORD(target);
+	nv->value = (t->n == 0) ? 0 : (float)t->sum / (float)t->n;
+	nv->precision = (int8_t)GET_TABLE_WORD(precision);
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+stat_t st_get_timing_budget(nvObj_t *nv)
+{
+	stTimingStat_t *t = (stTimingStat_t *)GET_TABLE_WORD(target);
+	nv->value = t->max * 100 / (NOM_SEGMENT_USEC * (F_CPU / 1000000));
+	nv->precision = (int8_t)GET_TABLE_WORD(precision);
+	nv->valuetype = TYPE_FLOAT;
+	return (STAT_OK);
+}
+
+void st_timing_record(stTimingStat_t *t, const uint16_t cycles, const uint8_t shift)
+{
+	if ((t->count++ == 0) || (cycles < t->min)) t->min = cycles;
+	if (cycles > t->max) t->max = cycles;
+	if (t->sum & 0x80000000) {					// halve the history before the sum can overflow
+		t->sum >>= 1;
+		t->n >>= 1;
+	}
+	t->sum += cycles;
+	t->n++;
+
+	uint8_t bin = 0;
+	for (uint16_t c = cycles >> shift; (c != 0) && (bin < ST_TIMING_BINS-1); c >>= 1) bin++;
+	t->hist[bin]++;
+}
+#endif // __ISR_TIMING
+
 /*
  * Motor power management functions
  *
@@ -446,6 +570,11 @@ void st_deenergize_motors()
  */
 stat_t st_motor_power_callback() 	// called by controller
 {
+#ifdef __ARM
+	if ((st_run.power_phase != ST_POWER_IDLE) && (mp_get_runtime_busy() == false)) {
+		_apply_power_phase(ST_POWER_IDLE);				// stopped - drop to the idle levels
+	}
+#endif
 	// manage power for each motor individually
 	for (uint8_t m = MOTOR_1; m < MOTORS; m++) {
 
@@ -499,44 +628,171 @@ stat_t st_motor_power_callback() 	// called by controller
  * ISR - DDA timer interrupt routine - service ticks from DDA timer
  */
 
+/*
+ * _get_raster_compare() - PWM_1 compare value for the raster pixel being engraved
+ *
+ *	The pixel value is worked out in 1/256 counts. With dithering on the part below a
+ *	count is kept for the dither (see pwm_get_fraction()).
+ */
+static inline uint16_t _get_raster_compare(void)
+{
+	uint8_t pixel = mb.raster[st_run.raster_index & PLANNER_RASTER_MASK];
+	int32_t compare = ((int32_t)st_run.laser_off << 8) + st_run.laser_span * pixel;
+	st_run.laser_compare = (uint16_t)(compare >> 8);
+	if (pwm.c[PWM_1].dither == true) {
+		st_run.laser_fraction = (uint8_t)compare;
+	}
+	return (st_run.laser_compare);
+}
+
 #ifdef __AVR
 /*
  *	Uses direct struct addresses and literal values for hardware devices - it's faster than
  *	using indexed timer and port accesses. I checked. Even when -0s or -03 is used.
  */
+#ifndef __STEP_PULSE_COMPARE
 ISR(TIMER_DDA_ISR_vect)
 {
+	TIMING_START(start);
 	if ((st_run.mot[MOTOR_1].substep_accumulator += st_run.mot[MOTOR_1].substep_increment) > 0) {
 		PORT_MOTOR_1_VPORT.OUT |= STEP_BIT_bm;		// turn step bit on
 		st_run.mot[MOTOR_1].substep_accumulator -= st_run.dda_ticks_X_substeps;
 		INCREMENT_ENCODER(MOTOR_1);
 	}
+#if (ACTIVE_MOTORS >= 2)
 	if ((st_run.mot[MOTOR_2].substep_accumulator += st_run.mot[MOTOR_2].substep_increment) > 0) {
 		PORT_MOTOR_2_VPORT.OUT |= STEP_BIT_bm;
 		st_run.mot[MOTOR_2].substep_accumulator -= st_run.dda_ticks_X_substeps;
 		INCREMENT_ENCODER(MOTOR_2);
 	}
+#endif
+#if (ACTIVE_MOTORS >= 3)
 	if ((st_run.mot[MOTOR_3].substep_accumulator += st_run.mot[MOTOR_3].substep_increment) > 0) {
 		PORT_MOTOR_3_VPORT.OUT |= STEP_BIT_bm;
 		st_run.mot[MOTOR_3].substep_accumulator -= st_run.dda_ticks_X_substeps;
 		INCREMENT_ENCODER(MOTOR_3);
 	}
+#endif
+#if (ACTIVE_MOTORS >= 4)
 	if ((st_run.mot[MOTOR_4].substep_accumulator += st_run.mot[MOTOR_4].substep_increment) > 0) {
 		PORT_MOTOR_4_VPORT.OUT |= STEP_BIT_bm;
 		st_run.mot[MOTOR_4].substep_accumulator -= st_run.dda_ticks_X_substeps;
 		INCREMENT_ENCODER(MOTOR_4);
 	}
+#endif
 
 	// pulse stretching for using external drivers.- turn step bits off
+	// (all four are cleared regardless of ACTIVE_MOTORS - the clears set the pulse width)
 	PORT_MOTOR_1_VPORT.OUT &= ~STEP_BIT_bm;				// ~ 5 uSec pulse width
 	PORT_MOTOR_2_VPORT.OUT &= ~STEP_BIT_bm;				// ~ 4 uSec
 	PORT_MOTOR_3_VPORT.OUT &= ~STEP_BIT_bm;				// ~ 3 uSec
 	PORT_MOTOR_4_VPORT.OUT &= ~STEP_BIT_bm;				// ~ 2 uSec
+#else
+/*
+ *	Timed pulse variant (see stepper.h). The DDA interrupt only decides which motors step,
+ *	then sets their step bits together and arms compare A to end the pulses.
+ */
+static inline void _clear_step_bits(void)
+{
+	PORT_MOTOR_1_VPORT.OUT &= ~STEP_BIT_bm;
+#if (ACTIVE_MOTORS >= 2)
+	PORT_MOTOR_2_VPORT.OUT &= ~STEP_BIT_bm;
+#endif
+#if (ACTIVE_MOTORS >= 3)
+	PORT_MOTOR_3_VPORT.OUT &= ~STEP_BIT_bm;
+#endif
+#if (ACTIVE_MOTORS >= 4)
+	PORT_MOTOR_4_VPORT.OUT &= ~STEP_BIT_bm;
+#endif
+}
 
-	if (--st_run.dda_ticks_downcount != 0) return;
+ISR(TIMER_DDA_CCA_ISR_vect)
+{
+	_clear_step_bits();
+	TIMER_DDA.INTCTRLB = 0;							// no more compares until the next step
+}
 
+ISR(TIMER_DDA_ISR_vect)
+{
+	TIMING_START(start);
+	uint8_t steps = 0;
+	if ((st_run.mot[MOTOR_1].substep_accumulator += st_run.mot[MOTOR_1].substep_increment) > 0) {
+		steps |= 0x01;
+		st_run.mot[MOTOR_1].substep_accumulator -= st_run.dda_ticks_X_substeps;
+		INCREMENT_ENCODER(MOTOR_1);
+	}
+#if (ACTIVE_MOTORS >= 2)
+	if ((st_run.mot[MOTOR_2].substep_accumulator += st_run.mot[MOTOR_2].substep_increment) > 0) {
+		steps |= 0x02;
+		st_run.mot[MOTOR_2].substep_accumulator -= st_run.dda_ticks_X_substeps;
+		INCREMENT_ENCODER(MOTOR_2);
+	}
+#endif
+#if (ACTIVE_MOTORS >= 3)
+	if ((st_run.mot[MOTOR_3].substep_accumulator += st_run.mot[MOTOR_3].substep_increment) > 0) {
+		steps |= 0x04;
+		st_run.mot[MOTOR_3].substep_accumulator -= st_run.dda_ticks_X_substeps;
+		INCREMENT_ENCODER(MOTOR_3);
+	}
+#endif
+#if (ACTIVE_MOTORS >= 4)
+	if ((st_run.mot[MOTOR_4].substep_accumulator += st_run.mot[MOTOR_4].substep_increment) > 0) {
+		steps |= 0x08;
+		st_run.mot[MOTOR_4].substep_accumulator -= st_run.dda_ticks_X_substeps;
+		INCREMENT_ENCODER(MOTOR_4);
+	}
+#endif
+	if (steps != 0) {
+		if (steps & 0x01) { PORT_MOTOR_1_VPORT.OUT |= STEP_BIT_bm;}	// turn step bits on
+#if (ACTIVE_MOTORS >= 2)
+		if (steps & 0x02) { PORT_MOTOR_2_VPORT.OUT |= STEP_BIT_bm;}
+#endif
+#if (ACTIVE_MOTORS >= 3)
+		if (steps & 0x04) { PORT_MOTOR_3_VPORT.OUT |= STEP_BIT_bm;}
+#endif
+#if (ACTIVE_MOTORS >= 4)
+		if (steps & 0x08) { PORT_MOTOR_4_VPORT.OUT |= STEP_BIT_bm;}
+#endif
+		uint16_t clear = TIMER_DDA.CNT + STEP_PULSE_CYCLES;	// end the pulses STEP_PULSE_USEC from now...
+		if (clear >= TIMER_DDA.PER) {
+			clear = TIMER_DDA.PER - 1;						// ...or before the next tick at high rates
+		}
+		TIMER_DDA.CCA = clear;
+		TIMER_DDA.INTFLAGS = TC0_CCAIF_bm;					// drop any stale match
+		TIMER_DDA.INTCTRLB = TIMER_DDA_CCA_INTLVL;
+	}
+#endif // __STEP_PULSE_COMPARE
+
+	if ((st_run.raster_left != 0) && (--st_run.raster_countdown == 0)) {	// next pixel of a raster line
+		st_run.raster_countdown = st_run.raster_period;
+		st_run.raster_left--;
+		st_run.raster_index++;
+		pwm.p[PWM_1].timer->CCB = _get_raster_compare();
+	}
+	if (st_run.laser_fraction != 0) {					// dither the laser power below one count
+		uint8_t dither = st_run.laser_dither + st_run.laser_fraction;
+		pwm.p[PWM_1].timer->CCB = st_run.laser_compare + (dither < st_run.laser_dither);	// +1 on carry
+		st_run.laser_dither = dither;
+	}
+	if (TIMER_DDA.INTFLAGS & TC0_OVFIF_bm) {			// the next tick came before this one was done
+		PERF_COUNT(PERF_ISR_OVERRUN);
+	}
+
+	if (--st_run.dda_ticks_downcount != 0) {
+		TIMING_END(dda, start, ST_TIMING_ISR_SHIFT);
+		return;
+	}
 	TIMER_DDA.CTRLA = STEP_TIMER_DISABLE;				// disable DDA timer
+	TIMING_SEGMENT_END();
+	st_run.segment_ended = true;
 	_load_move();										// load the next move
+#ifdef __STEP_PULSE_COMPARE
+	if (TIMER_DDA.CTRLA == STEP_TIMER_DISABLE) {		// nothing loaded - the compare would never come
+		_clear_step_bits();
+		TIMER_DDA.INTCTRLB = 0;
+	}
+#endif
+	TIMING_END(dda, start, ST_TIMING_ISR_SHIFT);
 }
 #endif // __AVR
 
@@ -562,31 +818,41 @@ MOTATE_TIMER_INTERRUPT(dda_timer_num)
 			st_run.mot[MOTOR_1].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_1);
 		}
+#if (ACTIVE_MOTORS >= 2)
 		if (!motor_2.step.isNull() && (st_run.mot[MOTOR_2].substep_accumulator += st_run.mot[MOTOR_2].substep_increment) > 0) {
 			motor_2.step.set();
 			st_run.mot[MOTOR_2].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_2);
 		}
+#endif
+#if (ACTIVE_MOTORS >= 3)
 		if (!motor_3.step.isNull() && (st_run.mot[MOTOR_3].substep_accumulator += st_run.mot[MOTOR_3].substep_increment) > 0) {
 			motor_3.step.set();
 			st_run.mot[MOTOR_3].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_3);
 		}
+#endif
+#if (ACTIVE_MOTORS >= 4)
 		if (!motor_4.step.isNull() && (st_run.mot[MOTOR_4].substep_accumulator += st_run.mot[MOTOR_4].substep_increment) > 0) {
 			motor_4.step.set();
 			st_run.mot[MOTOR_4].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_4);
 		}
+#endif
+#if (ACTIVE_MOTORS >= 5)
 		if (!motor_5.step.isNull() && (st_run.mot[MOTOR_5].substep_accumulator += st_run.mot[MOTOR_5].substep_increment) > 0) {
 			motor_5.step.set();
 			st_run.mot[MOTOR_5].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_5);
 		}
+#endif
+#if (ACTIVE_MOTORS >= 6)
 		if (!motor_6.step.isNull() && (st_run.mot[MOTOR_6].substep_accumulator += st_run.mot[MOTOR_6].substep_increment) > 0) {
 			motor_6.step.set();
 			st_run.mot[MOTOR_6].substep_accumulator -= st_run.dda_ticks_X_substeps;
 			INCREMENT_ENCODER(MOTOR_6);
 		}
+#endif
 
 	} else if (interrupt_cause == kInterruptOnMatchA) {
 //		dda_debug_pin2 = 1;
@@ -601,6 +867,7 @@ MOTATE_TIMER_INTERRUPT(dda_timer_num)
 
 		// process end of segment
 		dda_timer.stop();								// turn it off or it will keep stepping out the last segment
+		st_run.segment_ended = true;
 		_load_move();									// load the next move at the current interrupt level
 //		dda_debug_pin2 = 0;
 	}
@@ -616,10 +883,14 @@ MOTATE_TIMER_INTERRUPT(dda_timer_num)
 
 #ifdef __AVR
 ISR(TIMER_DWELL_ISR_vect) {								// DWELL timer interrupt
+	TIMING_START(start);
 	if (--st_run.dda_ticks_downcount == 0) {
 		TIMER_DWELL.CTRLA = STEP_TIMER_DISABLE;			// disable DWELL timer
+		TIMING_SEGMENT_END();
+		st_run.segment_ended = true;
 		_load_move();
 	}
+	TIMING_END(dwell, start, ST_TIMING_ISR_SHIFT);
 }
 #endif
 #ifdef __ARM
@@ -629,6 +900,7 @@ MOTATE_TIMER_INTERRUPT(dwell_timer_num)
 	dwell_timer.getInterruptCause(); // read SR to clear interrupt condition
 	if (--st_run.dda_ticks_downcount == 0) {
 		dwell_timer.stop();
+		st_run.segment_ended = true;
 		_load_move();
 	}
 }
@@ -639,12 +911,68 @@ MOTATE_TIMER_INTERRUPT(dwell_timer_num)
  * Exec sequencing code		- computes and prepares next load segment
  * st_request_exec_move()	- SW interrupt to request to execute a move
  * exec_timer interrupt		- interrupt handler for calling exec function
+ * _exec_move()				- exec into the free prep slot and hand it to the loader
+ * _count_underruns()		- total the loader's underrun and late load events with their line
+ *
+ *	Exec keeps requesting itself until the prep ring is full, so up to PREP_RING_SIZE
+ *	segments are ready when the loader asks. Exec stops behind a queued command as the
+ *	command's planner buffer is not released until the loader runs it (mp_runtime_command()).
+ *	Chained commands (st_prep_command_chain()) hold no buffer, so exec carries on behind
+ *	them and the loader goes straight on to the next segment (see _load_move()).
  */
 
+static uint8_t _prep_ring_has_room()
+{
+	if (st_pre.seg[st_pre.prep_index].buffer_state != PREP_BUFFER_OWNED_BY_EXEC) {
+		return (false);									// ring is full
+	}
+	stPrepSegment_t *prev = &st_pre.seg[(st_pre.prep_index - 1) & PREP_RING_MASK];
+	if ((prev->buffer_state == PREP_BUFFER_OWNED_BY_LOADER) && (prev->move_type == MOVE_TYPE_COMMAND) &&
+		(prev->bf != NULL)) {
+		return (false);									// wait for the command to be loaded
+	}
+	return (true);
+}
+
+static void _count_underruns()
+{
+	uint8_t events = st_run.underruns - st_pre.underruns_seen;	// the loader's counts wrap
+	if (events != 0) {
+		st_pre.underruns_seen += events;
+		st_pre.underrun_count += events;
+		st_pre.underrun_line = mr.gm.linenum;			// exec is still on the move that fell behind
+	}
+	events = st_run.late_loads - st_pre.late_loads_seen;
+	if (events != 0) {
+		st_pre.late_loads_seen += events;
+		st_pre.late_load_count += events;
+		st_pre.late_load_line = mr.gm.linenum;
+	}
+}
+
+static void _exec_move()
+{
+	if (_prep_ring_has_room() == false) {
+		return;
+	}
+	_count_underruns();
+	TIMING_START(start);
+	stat_t status = mp_exec_move();
+	TIMING_END(exec, start, ST_TIMING_EXEC_SHIFT);
+
+	if (status != STAT_NOOP) {
+		stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+		st_pre.prep_index = (st_pre.prep_index + 1) & PREP_RING_MASK;
+		seg->buffer_state = PREP_BUFFER_OWNED_BY_LOADER;// flip it back - must follow the index update
+		_request_load_move();
+		st_request_exec_move();							// keep filling the ring
+	}
+}
+
 #ifdef __AVR
 void st_request_exec_move()
 {
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {// bother interrupting
+	if (_prep_ring_has_room()) {						// bother interrupting
 		TIMER_EXEC.PER = EXEC_TIMER_PERIOD;
 		TIMER_EXEC.CTRLA = EXEC_TIMER_ENABLE;				// trigger a LO interrupt
 	}
@@ -652,21 +980,14 @@ void st_request_exec_move()
 
 ISR(TIMER_EXEC_ISR_vect) {								// exec move SW interrupt
 	TIMER_EXEC.CTRLA = EXEC_TIMER_DISABLE;				// disable SW interrupt timer
-
-	// exec_move
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {
-		if (mp_exec_move() != STAT_NOOP) {
-			st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER; // flip it back
-			_request_load_move();
-		}
-	}
+	_exec_move();
 }
 #endif // __AVR
 
 #ifdef __ARM
 void st_request_exec_move()
 {
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {// bother interrupting
+	if (_prep_ring_has_room()) {						// bother interrupting
 		exec_timer.setInterruptPending();
 	}
 }
@@ -675,17 +996,38 @@ namespace Motate {	// Define timer inside Motate namespace
 	MOTATE_TIMER_INTERRUPT(exec_timer_num)				// exec move SW interrupt
 	{
 		exec_timer.getInterruptCause();					// clears the interrupt condition
-		if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_EXEC) {
-			if (mp_exec_move() != STAT_NOOP) {
-				st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER; // flip it back
-				_request_load_move();
-			}
-		}
+		_exec_move();
 	}
 } // namespace Motate
 
 #endif // __ARM
 
+/****************************************************************************************
+ * st_request_plan() - pend the PendSV interrupt to run the planning the exec asked for
+ * PendSV_Handler()	 - PendSV interrupt handler for the planning (__PLAN_ISR)
+ *
+ *	The exec starts a feedhold but leaves the hold planning and the replan behind it to
+ *	mp_plan_hold_callback(). In the controller loop that waits behind whatever the loop
+ *	is busy with - a large JSON response or config dump takes many milliseconds to
+ *	serialize. With __PLAN_ISR the exec pends PendSV instead, which runs the callback as
+ *	soon as the exec returns. PendSV has the lowest priority, the same as the exec, so the
+ *	two never interrupt each other, and it preempts all of the controller loop. A plan
+ *	requested while the loop is committing a move is run once the commit is done (see
+ *	_commit_move()).
+ */
+
+#ifdef __PLAN_ISR
+void st_request_plan()
+{
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+extern "C" void PendSV_Handler(void)
+{
+	mp_plan_hold_callback();
+}
+#endif // __PLAN_ISR
+
 /****************************************************************************************
  * Loader sequencing code
  * st_request_load_move() - fires a software interrupt (timer) to request to load a move
@@ -702,7 +1044,7 @@ static void _request_load_move()
 	if (st_runtime_isbusy()) {
 		return;													// don't request a load if the runtime is busy
 	}
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
+	if (st_pre.seg[st_pre.load_index].buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
 		TIMER_LOAD.PER = LOAD_TIMER_PERIOD;
 		TIMER_LOAD.CTRLA = LOAD_TIMER_ENABLE;					// trigger a HI interrupt
 	}
@@ -720,7 +1062,7 @@ static void _request_load_move()
 	if (st_runtime_isbusy()) {
 		return;													// don't request a load if the runtime is busy
 	}
-	if (st_pre.buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
+	if (st_pre.seg[st_pre.load_index].buffer_state == PREP_BUFFER_OWNED_BY_LOADER) {	// bother interrupting
 		load_timer.setInterruptPending();
 	}
 }
@@ -748,26 +1090,102 @@ namespace Motate {	// Define timer inside Motate namespace
  */
 /****** WARNING - THIS CODE IS SPECIFIC TO AVR. SEE G2 FOR ARM CODE ******/
 
+/*
+ * _release_raster() - give the pixels of a finished raster line back to the planner
+ */
+
+static void _release_raster()
+{
+	st_run.raster_left = 0;
+	if (st_run.raster_pinned == true) {
+		mb.raster_r = st_run.raster_end;
+		st_run.raster_pinned = false;
+	}
+}
+
+/*
+ * _load_microsteps() - count a motor's microstep phase and morph it at a full step boundary
+ *
+ *	Called for every motor as its segment is loaded, before the step count of the segment
+ *	that just finished is accumulated (see Microstep morphing in stepper.h).
+ */
+
+static inline void _load_microsteps(const uint8_t motor, const stPrepSegmentMotor_t *sm)
+{
+	stRunMotor_t *run = &st_run.mot[motor];
+	uint8_t morph_shift = st_cfg.mot[motor].morph_shift;
+	if ((morph_shift | run->microstep_shift) == 0) return;		// not a morphing motor
+
+	run->microstep_phase = (run->microstep_phase + (uint8_t)en.en[motor].steps_run) & ((1 << morph_shift) - 1);
+	if (run->substep_increment == 0) return;					// no steps in the new segment
+
+	int32_t progress = max(run->substep_accumulator + (int32_t)st_run.dda_ticks_X_substeps, 0);
+	if (run->microstep_shift == 0) {
+		if ((sm->full_steps == true) && (run->microstep_phase == 0)) {
+			run->substep_accumulator = (progress >> morph_shift) - st_run.dda_ticks_X_substeps;
+			run->microstep_shift = morph_shift;
+			_set_hw_microsteps(motor, 1);
+		}
+	} else if ((sm->full_steps == false) || (run->microstep_shift != morph_shift)) {
+		if ((progress < (int32_t)(st_run.dda_ticks_X_substeps >> run->microstep_shift)) || (morph_shift == 0)) {
+			run->substep_accumulator = (progress << run->microstep_shift) - st_run.dda_ticks_X_substeps;
+			run->microstep_shift = 0;
+			_set_hw_microsteps(motor, (uint8_t)st_cfg.mot[motor].microsteps);
+		}
+	}
+	if (run->microstep_shift != 0) {
+		run->substep_increment = sm->full_step_increment;
+		SET_ENCODER_STEP_SIGN(motor, sm->step_sign * (1 << run->microstep_shift));
+	}
+}
+
 static void _load_move()
 {
+	uint8_t chained = false;							// TRUE if a command chain ran in place of a segment
+	uint8_t timed = false;								// TRUE if a DDA segment or dwell was loaded
+	TIMING_START(start);
+
 	// Be aware that dda_ticks_downcount must equal zero for the loader to run.
 	// So the initial load must also have this set to zero as part of initialization
 	if (st_runtime_isbusy()) {
 		return;													// exit if the runtime is busy
 	}
-	if (st_pre.buffer_state != PREP_BUFFER_OWNED_BY_LOADER) {	// if there are no moves to load...
+	uint8_t segment_ended = st_run.segment_ended;				// TRUE if called at the end of a segment
+	st_run.segment_ended = false;
+	controller_post_event(EVENT_MOTION);						// the controller sees the end of a move in its next pass
+
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.load_index];
+	if (seg->buffer_state != PREP_BUFFER_OWNED_BY_LOADER) {		// if there are no moves to load...
+		TIMING_SEGMENT_STARVED();
+		if ((segment_ended == true) && (cm.motion_state == MOTION_RUN)) {
+			st_run.underruns++;									// ...in the middle of motion (see stepper.h)
+		}
+		_release_raster();
+		if (pwm.c[PWM_1].laser_mode == true) {						// ...the laser goes off as motion stops
+			pwm_set_duty(PWM_1, pwm.c[PWM_1].phase_off);
+		}
+		if (cm_get_laser_mode(PWM_2) == true) {
+			pwm_set_duty(PWM_2, pwm.c[PWM_2].phase_off);
+		}
 //		for (uint8_t motor = MOTOR_1; motor < MOTORS; motor++) {
 //			st_run.mot[motor].power_state = MOTOR_POWER_TIMEOUT_START;	// ...start motor power timeouts
 //		}
 		return;
 	}
 	// handle aline loads first (most common case)
-	if (st_pre.move_type == MOVE_TYPE_ALINE) {
+	if (seg->move_type == MOVE_TYPE_ALINE) {
+		timed = true;
+#ifdef __ARM
+		if (seg->power_phase != st_run.power_phase) {
+			_apply_power_phase(seg->power_phase);
+		}
+#endif
 
 		//**** setup the new segment ****
 
-		st_run.dda_ticks_downcount = st_pre.dda_ticks;
-		st_run.dda_ticks_X_substeps = st_pre.dda_ticks_X_substeps;
+		st_run.dda_ticks_downcount = seg->dda_ticks;
+		st_run.dda_ticks_X_substeps = seg->dda_ticks_X_substeps;
+		SAMPLE_ENCODERS();									// lines up with the step counts accumulated below
 
 		//**** MOTOR_1 LOAD ****
 
@@ -775,30 +1193,29 @@ static void _load_move()
 		// is supposed to take < 10 uSec (Xmega). Be careful if you mess with this.
 
 		// the following if() statement sets the runtime substep increment value or zeroes it
-		if ((st_run.mot[MOTOR_1].substep_increment = st_pre.mot[MOTOR_1].substep_increment) != 0) {
+		if ((st_run.mot[MOTOR_1].substep_increment = seg->mot[MOTOR_1].substep_increment) != 0) {
 
 			// NB: If motor has 0 steps the following is all skipped. This ensures that state comparisons
 			//	   always operate on the last segment actually run by this motor, regardless of how many
 			//	   segments it may have been inactive in between.
 
 			// Apply accumulator correction if the time base has changed since previous segment
-			if (st_pre.mot[MOTOR_1].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_1].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_1].substep_accumulator *= st_pre.mot[MOTOR_1].accumulator_correction;
+			if (seg->mot[MOTOR_1].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_1].substep_accumulator *= seg->mot[MOTOR_1].accumulator_correction;
 			}
 
 			// Detect direction change and if so:
 			//	- Set the direction bit in hardware.
 			//	- Compensate for direction change by flipping substep accumulator value about its midpoint.
 
-			if (st_pre.mot[MOTOR_1].direction != st_pre.mot[MOTOR_1].prev_direction) {
-				st_pre.mot[MOTOR_1].prev_direction = st_pre.mot[MOTOR_1].direction;
+			if (seg->mot[MOTOR_1].direction != st_pre.mot[MOTOR_1].prev_direction) {
+				st_pre.mot[MOTOR_1].prev_direction = seg->mot[MOTOR_1].direction;
 				st_run.mot[MOTOR_1].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_1].substep_accumulator);
-				if (st_pre.mot[MOTOR_1].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_1].direction == DIRECTION_CW)
 				PORT_MOTOR_1_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_1_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_1, st_pre.mot[MOTOR_1].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_1, seg->mot[MOTOR_1].step_sign);
 
 			// Enable the stepper and start motor power management
 			if (st_cfg.mot[MOTOR_1].power_mode != MOTOR_DISABLED) {
@@ -813,22 +1230,22 @@ static void _load_move()
 			}
 		}
 		// accumulate counted steps to the step position and zero out counted steps for the segment currently being loaded
+		_load_microsteps(MOTOR_1, &seg->mot[MOTOR_1]);
 		ACCUMULATE_ENCODER(MOTOR_1);
 
-#if (MOTORS >= 2)	//**** MOTOR_2 LOAD ****
-		if ((st_run.mot[MOTOR_2].substep_increment = st_pre.mot[MOTOR_2].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_2].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_2].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_2].substep_accumulator *= st_pre.mot[MOTOR_2].accumulator_correction;
+#if (ACTIVE_MOTORS >= 2)	//**** MOTOR_2 LOAD ****
+		if ((st_run.mot[MOTOR_2].substep_increment = seg->mot[MOTOR_2].substep_increment) != 0) {
+			if (seg->mot[MOTOR_2].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_2].substep_accumulator *= seg->mot[MOTOR_2].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_2].direction != st_pre.mot[MOTOR_2].prev_direction) {
-				st_pre.mot[MOTOR_2].prev_direction = st_pre.mot[MOTOR_2].direction;
+			if (seg->mot[MOTOR_2].direction != st_pre.mot[MOTOR_2].prev_direction) {
+				st_pre.mot[MOTOR_2].prev_direction = seg->mot[MOTOR_2].direction;
 				st_run.mot[MOTOR_2].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_2].substep_accumulator);
-				if (st_pre.mot[MOTOR_2].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_2].direction == DIRECTION_CW)
 				PORT_MOTOR_2_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_2_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_2, st_pre.mot[MOTOR_2].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_2, seg->mot[MOTOR_2].step_sign);
 			if (st_cfg.mot[MOTOR_2].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_2_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_2].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -839,22 +1256,22 @@ static void _load_move()
 				st_run.mot[MOTOR_2].power_state = MOTOR_POWER_TIMEOUT_START;
 			}
 		}
+		_load_microsteps(MOTOR_2, &seg->mot[MOTOR_2]);
 		ACCUMULATE_ENCODER(MOTOR_2);
 #endif
-#if (MOTORS >= 3)	//**** MOTOR_3 LOAD ****
-		if ((st_run.mot[MOTOR_3].substep_increment = st_pre.mot[MOTOR_3].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_3].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_3].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_3].substep_accumulator *= st_pre.mot[MOTOR_3].accumulator_correction;
+#if (ACTIVE_MOTORS >= 3)	//**** MOTOR_3 LOAD ****
+		if ((st_run.mot[MOTOR_3].substep_increment = seg->mot[MOTOR_3].substep_increment) != 0) {
+			if (seg->mot[MOTOR_3].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_3].substep_accumulator *= seg->mot[MOTOR_3].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_3].direction != st_pre.mot[MOTOR_3].prev_direction) {
-				st_pre.mot[MOTOR_3].prev_direction = st_pre.mot[MOTOR_3].direction;
+			if (seg->mot[MOTOR_3].direction != st_pre.mot[MOTOR_3].prev_direction) {
+				st_pre.mot[MOTOR_3].prev_direction = seg->mot[MOTOR_3].direction;
 				st_run.mot[MOTOR_3].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_3].substep_accumulator);
-				if (st_pre.mot[MOTOR_3].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_3].direction == DIRECTION_CW)
 				PORT_MOTOR_3_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_3_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_3, st_pre.mot[MOTOR_3].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_3, seg->mot[MOTOR_3].step_sign);
 			if (st_cfg.mot[MOTOR_3].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_3_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_3].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -865,22 +1282,22 @@ static void _load_move()
 				st_run.mot[MOTOR_3].power_state = MOTOR_POWER_TIMEOUT_START;
 			}
 		}
+		_load_microsteps(MOTOR_3, &seg->mot[MOTOR_3]);
 		ACCUMULATE_ENCODER(MOTOR_3);
 #endif
-#if (MOTORS >= 4)  //**** MOTOR_4 LOAD ****
-		if ((st_run.mot[MOTOR_4].substep_increment = st_pre.mot[MOTOR_4].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_4].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_4].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_4].substep_accumulator *= st_pre.mot[MOTOR_4].accumulator_correction;
+#if (ACTIVE_MOTORS >= 4)  //**** MOTOR_4 LOAD ****
+		if ((st_run.mot[MOTOR_4].substep_increment = seg->mot[MOTOR_4].substep_increment) != 0) {
+			if (seg->mot[MOTOR_4].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_4].substep_accumulator *= seg->mot[MOTOR_4].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_4].direction != st_pre.mot[MOTOR_4].prev_direction) {
-				st_pre.mot[MOTOR_4].prev_direction = st_pre.mot[MOTOR_4].direction;
+			if (seg->mot[MOTOR_4].direction != st_pre.mot[MOTOR_4].prev_direction) {
+				st_pre.mot[MOTOR_4].prev_direction = seg->mot[MOTOR_4].direction;
 				st_run.mot[MOTOR_4].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_4].substep_accumulator);
-				if (st_pre.mot[MOTOR_4].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_4].direction == DIRECTION_CW)
 				PORT_MOTOR_4_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_4_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
-			SET_ENCODER_STEP_SIGN(MOTOR_4, st_pre.mot[MOTOR_4].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_4, seg->mot[MOTOR_4].step_sign);
 			if (st_cfg.mot[MOTOR_4].power_mode != MOTOR_DISABLED) {
 				PORT_MOTOR_4_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_4].power_state = MOTOR_POWER_TIMEOUT_START;
@@ -891,76 +1308,138 @@ static void _load_move()
 				st_run.mot[MOTOR_4].power_state = MOTOR_POWER_TIMEOUT_START;
 			}
 		}
+		_load_microsteps(MOTOR_4, &seg->mot[MOTOR_4]);
 		ACCUMULATE_ENCODER(MOTOR_4);
 #endif
-#if (MOTORS >= 5)	//**** MOTOR_5 LOAD ****
-		if ((st_run.mot[MOTOR_5].substep_increment = st_pre.mot[MOTOR_5].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_5].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_5].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_5].substep_accumulator *= st_pre.mot[MOTOR_5].accumulator_correction;
+#if (ACTIVE_MOTORS >= 5)	//**** MOTOR_5 LOAD ****
+		if ((st_run.mot[MOTOR_5].substep_increment = seg->mot[MOTOR_5].substep_increment) != 0) {
+			if (seg->mot[MOTOR_5].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_5].substep_accumulator *= seg->mot[MOTOR_5].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_5].direction != st_pre.mot[MOTOR_5].prev_direction) {
-				st_pre.mot[MOTOR_5].prev_direction = st_pre.mot[MOTOR_5].direction;
+			if (seg->mot[MOTOR_5].direction != st_pre.mot[MOTOR_5].prev_direction) {
+				st_pre.mot[MOTOR_5].prev_direction = seg->mot[MOTOR_5].direction;
 				st_run.mot[MOTOR_5].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_5].substep_accumulator);
-				if (st_pre.mot[MOTOR_5].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_5].direction == DIRECTION_CW)
 				PORT_MOTOR_5_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_5_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
 			PORT_MOTOR_5_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 			st_run.mot[MOTOR_5].power_state = MOTOR_POWER_TIMEOUT_START;
-			SET_ENCODER_STEP_SIGN(MOTOR_5, st_pre.mot[MOTOR_5].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_5, seg->mot[MOTOR_5].step_sign);
 		} else {
 			if (st_cfg.mot[MOTOR_5].power_mode == MOTOR_POWERED_IN_CYCLE) {
 				PORT_MOTOR_5_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_5].power_state = MOTOR_POWER_TIMEOUT_START;
 			}
 		}
+		_load_microsteps(MOTOR_5, &seg->mot[MOTOR_5]);
 		ACCUMULATE_ENCODER(MOTOR_5);
 #endif
-#if (MOTORS >= 6)	//**** MOTOR_6 LOAD ****
-		if ((st_run.mot[MOTOR_6].substep_increment = st_pre.mot[MOTOR_6].substep_increment) != 0) {
-			if (st_pre.mot[MOTOR_6].accumulator_correction_flag == true) {
-				st_pre.mot[MOTOR_6].accumulator_correction_flag = false;
-				st_run.mot[MOTOR_6].substep_accumulator *= st_pre.mot[MOTOR_6].accumulator_correction;
+#if (ACTIVE_MOTORS >= 6)	//**** MOTOR_6 LOAD ****
+		if ((st_run.mot[MOTOR_6].substep_increment = seg->mot[MOTOR_6].substep_increment) != 0) {
+			if (seg->mot[MOTOR_6].accumulator_correction_flag == true) {
+				st_run.mot[MOTOR_6].substep_accumulator *= seg->mot[MOTOR_6].accumulator_correction;
 			}
-			if (st_pre.mot[MOTOR_6].direction != st_pre.mot[MOTOR_6].prev_direction) {
-				st_pre.mot[MOTOR_6].prev_direction = st_pre.mot[MOTOR_6].direction;
+			if (seg->mot[MOTOR_6].direction != st_pre.mot[MOTOR_6].prev_direction) {
+				st_pre.mot[MOTOR_6].prev_direction = seg->mot[MOTOR_6].direction;
 				st_run.mot[MOTOR_6].substep_accumulator = -(st_run.dda_ticks_X_substeps + st_run.mot[MOTOR_6].substep_accumulator);
-				if (st_pre.mot[MOTOR_6].direction == DIRECTION_CW)
+				if (seg->mot[MOTOR_6].direction == DIRECTION_CW)
 				PORT_MOTOR_6_VPORT.OUT &= ~DIRECTION_BIT_bm; else
 				PORT_MOTOR_6_VPORT.OUT |= DIRECTION_BIT_bm;
 			}
 			PORT_MOTOR_6_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 			st_run.mot[MOTOR_6].power_state = MOTOR_POWER_TIMEOUT_START;
-			SET_ENCODER_STEP_SIGN(MOTOR_6, st_pre.mot[MOTOR_6].step_sign);
+			SET_ENCODER_STEP_SIGN(MOTOR_6, seg->mot[MOTOR_6].step_sign);
 		} else {
 			if (st_cfg.mot[MOTOR_6].power_mode == MOTOR_POWERED_IN_CYCLE) {
 				PORT_MOTOR_6_VPORT.OUT &= ~MOTOR_ENABLE_BIT_bm;
 				st_run.mot[MOTOR_6].power_state = MOTOR_POWER_TIMEOUT_START;
 			}
 		}
+		_load_microsteps(MOTOR_6, &seg->mot[MOTOR_6]);
 		ACCUMULATE_ENCODER(MOTOR_6);
 #endif
+		if (seg->raster == true) {
+			mb.raster_r = seg->raster_index;			// the steppers are past the pixels before it
+			st_run.raster_end = seg->raster_end;
+			st_run.raster_pinned = true;
+		} else {
+			_release_raster();
+		}
+		st_run.laser_fraction = 0;
+		if (pwm.c[PWM_1].laser_mode == true) {
+			if (seg->raster == true) {					// pixel power for this segment
+				st_run.raster_index = seg->raster_index;
+				st_run.raster_left = seg->raster_left;
+				st_run.raster_countdown = seg->raster_countdown;
+				st_run.raster_period = seg->raster_period;
+				st_run.laser_off = seg->laser_off;
+				st_run.laser_span = (int32_t)seg->laser_compare - seg->laser_off;
+				pwm.p[PWM_1].timer->CCB = _get_raster_compare();
+			} else {
+				pwm.p[PWM_1].timer->CCB = seg->laser_compare;	// laser power for this segment
+				st_run.laser_compare = seg->laser_compare;
+				st_run.laser_fraction = seg->laser_fraction;
+			}
+		}
+#ifndef __ENCODER_QDEC
+		if (pwm.c[PWM_2].laser_mode == true) {			// its pin is only driven if it is in use
+			pwm.p[PWM_2].timer->CCB = seg->laser2_compare;
+		}
+#endif
+
+		if ((seg->outputs_on | seg->outputs_off) != 0) {	// M62, M63 outputs switch as the move starts
+			gpio_set_bit_on(seg->outputs_on);
+			gpio_set_bit_off(seg->outputs_off);
+		}
+
 		//**** do this last ****
 
-		TIMER_DDA.PER = st_pre.dda_period;
+		TIMER_DDA.PER = seg->dda_period;
 		TIMER_DDA.CTRLA = STEP_TIMER_ENABLE;			// enable the DDA timer
+		TIMING_SEGMENT_START();
 
 	// handle dwells
-	} else if (st_pre.move_type == MOVE_TYPE_DWELL) {
-		st_run.dda_ticks_downcount = st_pre.dda_ticks;
-		TIMER_DWELL.PER = st_pre.dda_period;			// load dwell timer period
+	} else if (seg->move_type == MOVE_TYPE_DWELL) {
+		timed = true;
+		_release_raster();
+		if (pwm.c[PWM_1].laser_mode == true) {
+			pwm_set_duty(PWM_1, pwm.c[PWM_1].phase_off);
+		}
+		if (cm_get_laser_mode(PWM_2) == true) {
+			pwm_set_duty(PWM_2, pwm.c[PWM_2].phase_off);
+		}
+		st_run.dda_ticks_downcount = seg->dda_ticks;
+		if (seg->spindle_wait == true) {				// timed from when the spindle command ran
+			st_run.dda_ticks_downcount = max(1, cm_get_spindle_wait() * (uint32_t)(FREQUENCY_DWELL / 1000));
+		}
+		TIMER_DWELL.PER = seg->dda_period;			// load dwell timer period
 		TIMER_DWELL.CTRLA = STEP_TIMER_ENABLE;			// enable the dwell timer
+		TIMING_SEGMENT_START();
 
 	// handle synchronous commands
-	} else if (st_pre.move_type == MOVE_TYPE_COMMAND) {
-		mp_runtime_command(st_pre.bf);
+	} else if (seg->move_type == MOVE_TYPE_COMMAND) {
+		if (seg->bf != NULL) {
+			mp_runtime_command(seg->bf);
+		} else {
+			mp_runtime_command_chain(seg->command);
+			chained = true;
+		}
 	}
 
 	// all other cases drop to here (e.g. Null moves after Mcodes skip to here)
-	st_pre.move_type = MOVE_TYPE_NULL;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;	// we are done with the prep buffer - flip the flag back
+	seg->move_type = MOVE_TYPE_NULL;
+	seg->buffer_state = PREP_BUFFER_OWNED_BY_EXEC;		// we are done with the prep slot - flip the flag back
+	st_pre.load_index = (st_pre.load_index + 1) & PREP_RING_MASK;
+	if ((timed == true) && (segment_ended == true) && (cm.motion_state == MOTION_RUN) &&
+		(st_pre.seg[st_pre.load_index].buffer_state != PREP_BUFFER_OWNED_BY_LOADER)) {
+		st_run.late_loads++;							// running the last segment exec had ready
+	}
 	st_request_exec_move();								// exec and prep next move
+	if (chained == true) {
+		_request_load_move();							// a move running through the commands carries on
+	}
+	TIMING_END(load, start, ST_TIMING_ISR_SHIFT);
 }
 
 /***********************************************************************************
@@ -979,18 +1458,30 @@ static void _load_move()
  *
  *	  - following_error[] is a vector of measured errors to the step count. Used for correction.
  *
+ *	  - error_age is the number of segments prepped after the one the errors were measured
+ *		at. They are still in the prep ring or running, so corrections made in them are not
+ *		in the errors yet.
+ *
  *	  - segment_time - how many minutes the segment should run. If timing is not
  *		100% accurate this will affect the move velocity, but not the distance traveled.
  *
+ *	Most segments of a section share the segment time, so in constant rate mode the DDA ticks
+ *	and their substep scaling are kept from the last segment time and only redone when it
+ *	changes. The accumulator correction ratio is likewise kept for the last pair of segment
+ *	lengths, so all motors share one divide. A segment of an unchanged time costs a few
+ *	integer operations per motor on top of the travel conversion.
+ *
  * NOTE:  Many of the expressions are sensitive to casting and execution order to avoid long-term
  *		  accuracy errors due to floating point round off. One earlier failed attempt was:
  *		    dda_ticks_X_substeps = (int32_t)((microseconds/1000000) * f_dda * dda_substeps);
  */
 
-stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time)
+stat_t st_prep_line(float travel_steps[], float following_error[], uint8_t error_age, float segment_time)
 {
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+
 	// trap conditions that would prevent queueing the line
-	if (st_pre.buffer_state != PREP_BUFFER_OWNED_BY_EXEC) {
+	if (seg->buffer_state != PREP_BUFFER_OWNED_BY_EXEC) {
 		return (cm_hard_alarm(STAT_INTERNAL_ERROR));
 	} else if (isinf(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_INFINITE));	// never supposed to happen
 	} else if (isnan(segment_time)) { return (cm_hard_alarm(STAT_PREP_LINE_MOVE_TIME_IS_NAN));		// never supposed to happen
@@ -1000,79 +1491,287 @@ stat_t st_prep_line(float travel_steps[], float following_error[], float segment
 	// - dda_ticks is the integer number of DDA clock ticks needed to play out the segment
 	// - ticks_X_substeps is the maximum depth of the DDA accumulator (as a negative number)
 
-	st_pre.dda_period = _f_to_period(FREQUENCY_DDA);
-	st_pre.dda_ticks = (int32_t)(segment_time * 60 * FREQUENCY_DDA);// NB: converts minutes to seconds
-	st_pre.dda_ticks_X_substeps = st_pre.dda_ticks * DDA_SUBSTEPS;
+	if (st_cfg.dda_mode == DDA_CONSTANT_RATE) {
+		if (segment_time != st_pre.cached_segment_time) {
+			st_pre.cached_segment_time = segment_time;
+			st_pre.cached_ticks = (int32_t)(segment_time * 60 * FREQUENCY_DDA);// NB: converts minutes to seconds
+			st_pre.cached_ticks_X_substeps = st_pre.cached_ticks * DDA_SUBSTEPS;
+		}
+		st_pre.dda_frequency = FREQUENCY_DDA;
+		seg->dda_period = _f_to_period(FREQUENCY_DDA);	// constant
+		seg->dda_ticks = st_pre.cached_ticks;
+		seg->dda_ticks_X_substeps = st_pre.cached_ticks_X_substeps;
+	} else {											// carry the fraction of a tick so slow clocks don't lose time
+		st_pre.dda_frequency = _get_dda_frequency(travel_steps, segment_time);
+		seg->dda_period = _f_to_period(st_pre.dda_frequency);
+		float seconds = segment_time * 60 + st_pre.dda_residue;
+		seg->dda_ticks = (int32_t)(seconds * st_pre.dda_frequency);
+		st_pre.dda_residue = seconds - seg->dda_ticks / st_pre.dda_frequency;
+		seg->dda_ticks_X_substeps = seg->dda_ticks * DDA_SUBSTEPS;
+	}
 
 	// setup motor parameters
 
 	float correction_steps;
-	for (uint8_t motor=0; motor<MOTORS; motor++) {	// I want to remind myself that this is motors, not axes
+	for (uint8_t motor=0; motor<ACTIVE_MOTORS; motor++) {	// I want to remind myself that this is motors, not axes
+
+		// The correction age is the number of segments prepped after the last corrected one
+		uint8_t correction_age = st_pre.mot[motor].correction_age;
+		if (st_pre.mot[motor].correction_age < 255) {
+			st_pre.mot[motor].correction_age++;
+		}
+
+		// A motor held while squaring a gantry stays put (see stepper.h)
+		if ((st_pre.held_motors & (1 << motor)) != 0) {
+			st_pre.mot[motor].step_offset -= travel_steps[motor];
+			travel_steps[motor] = 0;
+		}
 
 		// Skip this motor if there are no new steps. Leave all other values intact.
-		if (fp_ZERO(travel_steps[motor])) { st_pre.mot[motor].substep_increment = 0; continue;}
+		if (fp_ZERO(travel_steps[motor])) { seg->mot[motor].substep_increment = 0; continue;}
+
+		// Take up the backlash after a direction change, spread over the following
+		// segments. Each takes up at most its own travel (see stepper.h)
+
+		stPrepMotor_t *pre = &st_pre.mot[motor];
+		int8_t direction = (travel_steps[motor] > 0) ? 1 : -1;
+		if (direction != pre->backlash_direction) {
+			if (pre->backlash_direction != 0) {
+				pre->backlash_takeup += direction * st_cfg.mot[motor].backlash * st_cfg.mot[motor].steps_per_unit;
+			}
+			pre->backlash_direction = direction;
+		}
+		if (pre->backlash_takeup * direction > 0) {
+			float takeup_steps;
+			if (direction > 0) {
+				takeup_steps = min(pre->backlash_takeup, travel_steps[motor]);
+			} else {
+				takeup_steps = max(pre->backlash_takeup, travel_steps[motor]);
+			}
+			pre->backlash_takeup -= takeup_steps;
+			pre->step_offset += takeup_steps;
+			travel_steps[motor] += takeup_steps;
+		} else {
+			pre->backlash_takeup = 0;					// the setting was changed while taking up
+		}
 
 		// Setup the direction, compensating for polarity.
 		// Set the step_sign which is used by the stepper ISR to accumulate step position
 
 		if (travel_steps[motor] >= 0) {					// positive direction
-			st_pre.mot[motor].direction = DIRECTION_CW ^ st_cfg.mot[motor].polarity;
-			st_pre.mot[motor].step_sign = 1;
+			seg->mot[motor].direction = DIRECTION_CW ^ st_cfg.mot[motor].polarity;
+			seg->mot[motor].step_sign = 1;
 		} else {
-			st_pre.mot[motor].direction = DIRECTION_CCW ^ st_cfg.mot[motor].polarity;
-			st_pre.mot[motor].step_sign = -1;
+			seg->mot[motor].direction = DIRECTION_CCW ^ st_cfg.mot[motor].polarity;
+			seg->mot[motor].step_sign = -1;
 		}
 
-		// Detect segment time changes and setup the accumulator correction factor and flag.
+		// Detect segment length changes and setup the accumulator correction factor and flag.
 		// Putting this here computes the correct factor even if the motor was dormant for some
-		// number of previous moves. Correction is computed based on the last segment time actually used.
+		// number of previous moves. Correction is computed based on the last segment actually used.
+		// The length is in DDA ticks, which covers both segment time and DDA rate changes.
+
+		seg->mot[motor].accumulator_correction_flag = false;
+		if (seg->dda_ticks != st_pre.mot[motor].prev_segment_ticks) {
+			if (st_pre.mot[motor].prev_segment_ticks != 0) {							// special case to skip first move
+				seg->mot[motor].accumulator_correction_flag = true;
+				seg->mot[motor].accumulator_correction = _get_accumulator_correction(seg->dda_ticks, st_pre.mot[motor].prev_segment_ticks);
+			}
+			st_pre.mot[motor].prev_segment_ticks = seg->dda_ticks;
+		}
 
-		if (fabs(segment_time - st_pre.mot[motor].prev_segment_time) > 0.0000001) { // highly tuned FP != compare
-			if (fp_NOT_ZERO(st_pre.mot[motor].prev_segment_time)) {					// special case to skip first move
-				st_pre.mot[motor].accumulator_correction_flag = true;
-				st_pre.mot[motor].accumulator_correction = segment_time / st_pre.mot[motor].prev_segment_time;
+		// Microstep morphing: ask for full steps above the morph rate, with hysteresis.
+		// Full steps are up to a full step off the target, so following errors are not
+		// corrected until the segments run at full steps have been measured
+
+		uint8_t morph_shift = st_cfg.mot[motor].morph_shift;
+		seg->mot[motor].full_steps = false;
+		if (morph_shift != 0) {
+			float rate = fabs(travel_steps[motor]) / (segment_time * 60);
+			if (rate > st_cfg.morph_rate) {
+				pre->full_steps = true;
+			} else if (rate < st_cfg.morph_rate * MICROSTEP_MORPH_HYSTERESIS) {
+				pre->full_steps = false;
+			}
+			seg->mot[motor].full_steps = pre->full_steps;
+			if ((pre->full_steps == true) || (st_run.mot[motor].microstep_shift != 0)) {
+				pre->correction_age = 0;
+				correction_age = 0;
 			}
-			st_pre.mot[motor].prev_segment_time = segment_time;
 		}
 
 #ifdef __STEP_CORRECTION
 		// 'Nudge' correction strategy. Inject a single, scaled correction value then hold off
+		// until the corrected segment has been measured. Corrections take the encoder reading
+		// as the reference (see encoder.h)
 
-		if ((--st_pre.mot[motor].correction_holdoff < 0) &&
-			(fabs(following_error[motor]) > STEP_CORRECTION_THRESHOLD)) {
+		enEncoder_t *e = &en.en[motor];
+		if ((fp_NOT_ZERO(e->correction_threshold)) && (correction_age >= error_age) &&
+			(fabs(following_error[motor]) > e->correction_threshold)) {
 
-			st_pre.mot[motor].correction_holdoff = STEP_CORRECTION_HOLDOFF;
-			correction_steps = following_error[motor] * STEP_CORRECTION_FACTOR;
+			st_pre.mot[motor].correction_age = 0;
+			correction_steps = following_error[motor] * e->correction_factor;
 
 			if (correction_steps > 0) {
-				correction_steps = min3(correction_steps, fabs(travel_steps[motor]), STEP_CORRECTION_MAX);
+				correction_steps = min3(correction_steps, fabs(travel_steps[motor]), e->correction_max);
 			} else {
-				correction_steps = max3(correction_steps, -fabs(travel_steps[motor]), -STEP_CORRECTION_MAX);
+				correction_steps = max3(correction_steps, -fabs(travel_steps[motor]), -e->correction_max);
 			}
 			st_pre.mot[motor].corrected_steps += correction_steps;
+			st_pre.mot[motor].corrections++;
 			travel_steps[motor] -= correction_steps;
 		}
 #endif
 		// Compute substeb increment. The accumulator must be *exactly* the incoming
 		// fractional steps times the substep multiplier or positional drift will occur.
 		// Rounding is performed to eliminate a negative bias in the uint32 conversion
-		// that results in long-term negative drift. (fabs/round order doesn't matter)
+		// that results in long-term negative drift. Adding a half before the conversion
+		// rounds the same as round() for the positive value without the library call.
 
-		st_pre.mot[motor].substep_increment = round(fabs(travel_steps[motor] * DDA_SUBSTEPS));
+		seg->mot[motor].substep_increment = (uint32_t)(fabs(travel_steps[motor] * DDA_SUBSTEPS) + 0.5);
+
+		// The full step increment is given whenever the motor morphs, as the loader only
+		// switches at a full step and may still be running full steps when asked not to
+		if (morph_shift != 0) {
+			seg->mot[motor].full_step_increment = (uint32_t)(fabs(travel_steps[motor] * DDA_SUBSTEPS) / (1 << morph_shift) + 0.5);
+		}
 	}
-	st_pre.move_type = MOVE_TYPE_ALINE;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	seg->raster = false;								// st_prep_raster() sets it for raster lines
+	seg->outputs_on = seg->outputs_off = 0;				// st_prep_outputs() sets them for the first segment
+	seg->move_type = MOVE_TYPE_ALINE;					// _exec_move() signals the loader
 	return (STAT_OK);
 }
 
+/*
+ * st_hold_motors() - hold the motors in the bitmap still from the next segment prepped
+ *
+ *	Used to square gantries at homing. Call while the motors are stopped - any segments
+ *	already prepped still run.
+ */
+
+void st_hold_motors(uint8_t motors)
+{
+	st_pre.held_motors = motors;
+}
+
+/*
+ * _get_accumulator_correction() - return the accumulator correction from prev_ticks to ticks
+ *
+ *	All motors that ran the previous segment ask for the same ratio, so it is kept for the
+ *	last pair of segment lengths.
+ */
+
+static float _get_accumulator_correction(const uint32_t ticks, const uint32_t prev_ticks)
+{
+	if ((ticks != st_pre.correction_ticks) || (prev_ticks != st_pre.correction_prev_ticks)) {
+		st_pre.correction_ticks = ticks;
+		st_pre.correction_prev_ticks = prev_ticks;
+		st_pre.correction_ratio = (float)ticks / (float)prev_ticks;
+	}
+	return (st_pre.correction_ratio);
+}
+
+/*
+ * _get_dda_frequency() - return the DDA frequency for a segment
+ *
+ *	In variable rate mode this is the lowest that gives the fastest motor of the segment
+ *	DDA_STEP_OVERSAMPLING ticks per step (see stepper.h). The frequency returned is the one
+ *	the timer period actually gives so dda_ticks come out right.
+ */
+
+static float _get_dda_frequency(const float travel_steps[], const float segment_time)
+{
+#ifdef __AVR
+	if (st_cfg.dda_mode == DDA_VARIABLE_RATE) {
+		float steps = 0;
+		for (uint8_t motor=0; motor<ACTIVE_MOTORS; motor++) {
+			steps = max(steps, fabs(travel_steps[motor]));
+		}
+		float frequency = steps * DDA_STEP_OVERSAMPLING / (segment_time * 60);
+		frequency = min(max(frequency, FREQUENCY_DDA_MIN), FREQUENCY_DDA_MAX);
+		frequency = min(frequency, FREQUENCY_DDA * MAX_SEGMENT_TIME / segment_time);	// keep ticks_X_substeps in range
+		return ((float)F_CPU / (float)_f_to_period(frequency));
+	}
+#endif
+	return (FREQUENCY_DDA);
+}
+
+/*
+ * st_prep_laser() - set the laser power of a channel for the segment just prepped by st_prep_line()
+ *
+ *	The duty cycle is converted here so the loader only has to write the compare register
+ *	(and, with $p1dth=1, hand the compare fraction to the DDA interrupt for dithering).
+ *	PWM_2 is not dithered.
+ */
+
+void st_prep_laser(uint8_t chan, float duty)
+{
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+	if (chan == PWM_2) {
+		seg->laser2_compare = pwm_get_compare(PWM_2, duty);
+		return;
+	}
+	seg->laser_compare = pwm_get_compare(PWM_1, duty);
+	seg->laser_fraction = pwm_get_fraction(PWM_1, duty);
+}
+
+/*
+ * st_prep_power() - set the stPowerPhase of the line segment just prepped (see _apply_power_phase())
+ */
+
+void st_prep_power(uint8_t phase)
+{
+	st_pre.seg[st_pre.prep_index].power_phase = phase;
+}
+
+/*
+ * st_prep_outputs() - set the M62, M63 outputs switched as the segment just prepped is loaded
+ *
+ *	on and off are gpio1 bits (see cm_sync_output()). Only set on the first segment of a move.
+ */
+
+void st_prep_outputs(uint8_t on, uint8_t off)
+{
+	st_pre.seg[st_pre.prep_index].outputs_on = on;
+	st_pre.seg[st_pre.prep_index].outputs_off = off;
+}
+
+/*
+ * st_prep_raster() - set the pixels of the raster line segment just prepped by st_prep_line()
+ *
+ *	index		pixel the segment starts on
+ *	end			index past the last pixel of the line
+ *	left		pixels of the line after the first one
+ *	countdown	seconds to the next pixel
+ *	period		seconds per pixel
+ *
+ *	The segment carries the laser power set by st_prep_laser(). Each pixel gets its value/256
+ *	of it, stepped by the DDA interrupt. Ticks are clamped to what the counters hold - a pixel
+ *	shorter than a tick falls behind until the next segment resyncs it.
+ */
+
+void st_prep_raster(uint16_t index, uint16_t end, uint8_t left, float countdown, float period)
+{
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+
+	seg->raster = true;
+	seg->raster_index = index;
+	seg->raster_end = end;
+	seg->raster_left = left;
+	countdown *= st_pre.dda_frequency;						// convert to DDA ticks of the segment
+	period *= st_pre.dda_frequency;
+	seg->raster_countdown = (uint16_t)min(max(countdown, 1), 65535);
+	seg->raster_period = (uint16_t)min(max(period, 1), 65535);
+	seg->laser_off = pwm_get_compare(PWM_1, pwm.c[PWM_1].phase_off);
+}
+
 /*
  * st_prep_null() - Keeps the loader happy. Otherwise performs no action
  */
 
 void st_prep_null()
 {
-	st_pre.move_type = MOVE_TYPE_NULL;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_EXEC;	// signal that prep buffer is empty
+	st_pre.seg[st_pre.prep_index].move_type = MOVE_TYPE_NULL;
 }
 
 /*
@@ -1081,21 +1780,41 @@ void st_prep_null()
 
 void st_prep_command(void *bf)
 {
-	st_pre.move_type = MOVE_TYPE_COMMAND;
-	st_pre.bf = (mpBuf_t *)bf;
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+	seg->move_type = MOVE_TYPE_COMMAND;
+	seg->bf = (mpBuf_t *)bf;
+}
+
+/*
+ * st_prep_command_chain() - Stage the commands chained to a finished move to execution
+ */
+
+void st_prep_command_chain(uint8_t command)
+{
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+	seg->move_type = MOVE_TYPE_COMMAND;
+	seg->bf = NULL;
+	seg->command = command;
 }
 
 /*
  * st_prep_dwell() 	 - Add a dwell to the move buffer
+ * st_prep_spindle_wait() - Add a dwell the loader sizes to finish the spindle ramp
  */
 
 void st_prep_dwell(float microseconds)
 {
-	st_pre.move_type = MOVE_TYPE_DWELL;
-	st_pre.dda_period = _f_to_period(FREQUENCY_DWELL);
-	st_pre.dda_ticks = (uint32_t)(max(1, (microseconds/1000000) * FREQUENCY_DWELL)); // Make sure it is positive.
-	st_pre.buffer_state = PREP_BUFFER_OWNED_BY_LOADER;	// signal that prep buffer is ready
+	stPrepSegment_t *seg = &st_pre.seg[st_pre.prep_index];
+	seg->move_type = MOVE_TYPE_DWELL;
+	seg->spindle_wait = false;
+	seg->dda_period = _f_to_period(FREQUENCY_DWELL);
+	seg->dda_ticks = (uint32_t)(max(1, (microseconds/1000000) * FREQUENCY_DWELL)); // Make sure it is positive.
+}
+
+void st_prep_spindle_wait()
+{
+	st_prep_dwell(0);
+	st_pre.seg[st_pre.prep_index].spindle_wait = true;
 }
 
 /*
@@ -1150,19 +1869,110 @@ static int8_t _get_motor(const nvObj_t *nv)
 }
 
 /*
- * _set_motor_steps_per_unit() - what it says
- * This function will need to be rethought if microstep morphing is implemented
+ * st_update_steps_per_unit() - what it says, for all motors
+ *
+ *	Run from config_update_derived() once the sa, tr, mi or msr setters have marked the
+ *	steps per unit stale. Steps stay in the configured microsteps with microstep morphing,
+ *	which is set up here as well. A motor whose morphing changes restarts its microstep
+ *	count (see stepper.h).
  */
 
-static void _set_motor_steps_per_unit(nvObj_t *nv)
+void st_update_steps_per_unit()
 {
-	uint8_t m = _get_motor(nv);
-//	st_cfg.mot[m].units_per_step = (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle) / (360 * st_cfg.mot[m].microsteps); // unused
-    st_cfg.mot[m].steps_per_unit = (360 * st_cfg.mot[m].microsteps) / (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle);
-	st_reset();
+	for (uint8_t m=0; m<MOTORS; m++) {
+//		st_cfg.mot[m].units_per_step = (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle) / (360 * st_cfg.mot[m].microsteps); // unused
+		st_cfg.mot[m].steps_per_unit = (360 * st_cfg.mot[m].microsteps) / (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle);
+
+		uint8_t morph_shift = 0;
+		if (st_cfg.morph_rate != 0) {
+			switch (st_cfg.mot[m].microsteps) {
+				case 2: { morph_shift = 1; break; }
+				case 4: { morph_shift = 2; break; }
+				case 8: { morph_shift = 3; break; }
+			}
+		}
+		if (morph_shift != st_cfg.mot[m].morph_shift) {
+			st_cfg.mot[m].morph_shift = morph_shift;
+			st_run.mot[m].microstep_phase = 0;
+		}
+	}
+}
+
+/*
+ * st_get_step_rate_max() - the highest step rate a motor can be run at, in steps/sec
+ *
+ *	The DDA puts out at most one step per tick, so this is the DDA frequency - FREQUENCY_DDA_MAX
+ *	for the fastest segments in variable rate mode. A motor that morphs below that rate runs
+ *	full steps at the top, so it gets microsteps times as many steps (in its configured steps).
+ */
+
+float st_get_step_rate_max(uint8_t motor)
+{
+	float rate = FREQUENCY_DDA;
+#ifdef __AVR
+	if (st_cfg.dda_mode == DDA_VARIABLE_RATE) {
+		rate = FREQUENCY_DDA_MAX;
+	}
+#endif
+	uint8_t morph_shift = st_cfg.mot[motor].morph_shift;
+	if ((morph_shift != 0) && (st_cfg.morph_rate < rate)) {
+		rate *= (1 << morph_shift);
+	}
+	return (rate);
+}
+
+/*
+ * st_get_prep_ring_time() - time of the motion segments prepped and waiting for the loader
+ *
+ *	Returns minutes and the number of those segments. The time is taken from each slot's
+ *	DDA ticks and period, so it is what the DDA will run. Called from exec.
+ */
+
+float st_get_prep_ring_time(uint8_t *segments)
+{
+	float ticks = 0;
+	*segments = 0;
+	for (uint8_t i=0; i<PREP_RING_SIZE; i++) {
+		stPrepSegment_t *seg = &st_pre.seg[i];
+		if ((seg->buffer_state == PREP_BUFFER_OWNED_BY_LOADER) && (seg->move_type == MOVE_TYPE_ALINE)) {
+			ticks += (float)seg->dda_ticks * seg->dda_period;
+			(*segments)++;
+		}
+	}
+	return (ticks / F_CPU / 60);
+}
+
+/*
+ * st_get_underrun_backoff() - motion speed factor of the underrun backoff (see stepper.h)
+ *
+ *	Called by exec once per segment, after it has totalled the loader's underruns.
+ */
+
+float st_get_underrun_backoff()
+{
+	if (fp_ZERO(st_cfg.underrun_backoff)) {
+		st_pre.backoff_factor = 1.0;
+		return (1.0);
+	}
+	uint32_t events = st_pre.underrun_count - st_pre.backoff_seen;
+	st_pre.backoff_seen = st_pre.underrun_count;
+	if (events != 0) {
+		st_pre.backoff_clean = 0;
+		st_pre.backoff_events += (uint8_t)min(events, UNDERRUN_BACKOFF_COUNT);
+		if (st_pre.backoff_events >= UNDERRUN_BACKOFF_COUNT) {
+			st_pre.backoff_events = 0;
+			st_pre.backoff_factor = max(st_pre.backoff_factor * (1 - st_cfg.underrun_backoff), FEED_OVERRIDE_MIN);
+		}
+	} else if (++st_pre.backoff_clean >= UNDERRUN_BACKOFF_SEGMENTS) {
+		st_pre.backoff_clean = 0;
+		st_pre.backoff_events = 0;
+		st_pre.backoff_factor = min(st_pre.backoff_factor / (1 - st_cfg.underrun_backoff), 1.0);
+	}
+	return (st_pre.backoff_factor);
 }
 
 /* PER-MOTOR FUNCTIONS
+ * st_set_ma() - set motor to axis mapping
  * st_set_sa() - set motor step angle
  * st_set_tr() - set travel per motor revolution
  * st_set_mi() - set motor microsteps
@@ -1170,17 +1980,24 @@ static void _set_motor_steps_per_unit(nvObj_t *nv)
  * st_set_pl() - set motor power level
  */
 
+stat_t st_set_ma(nvObj_t *nv)			// motor to axis mapping
+{
+	set_ui8(nv);
+	config_mark_derived(DERIVED_MOTOR_MAP);
+	return(STAT_OK);
+}
+
 stat_t st_set_sa(nvObj_t *nv)			// motor step angle
 {
 	set_flt(nv);
-	_set_motor_steps_per_unit(nv);
+	config_mark_derived(DERIVED_STEPS_PER_UNIT);
 	return(STAT_OK);
 }
 
 stat_t st_set_tr(nvObj_t *nv)			// motor travel per revolution
 {
 	set_flu(nv);
-	_set_motor_steps_per_unit(nv);
+	config_mark_derived(DERIVED_STEPS_PER_UNIT);
 	return(STAT_OK);
 }
 
@@ -1191,7 +2008,7 @@ stat_t st_set_mi(nvObj_t *nv)			// motor microsteps
 		nv_add_conditional_message((const char_t *)"*** WARNING *** Setting non-standard microstep value");
 	}
 	set_int(nv);						// set it anyway, even if it's unsupported. It could also be > 255
-	_set_motor_steps_per_unit(nv);
+	config_mark_derived(DERIVED_STEPS_PER_UNIT);
 	_set_hw_microsteps(_get_motor(nv), (uint8_t)nv->value);
 	return (STAT_OK);
 }
@@ -1212,24 +2029,87 @@ stat_t st_set_pm(nvObj_t *nv)			// motor power mode
  *	This function sets both the scaled and dynamic power levels, and applies the
  *	scaled value to the vref.
  */
-stat_t st_set_pl(nvObj_t *nv)	// motor power level
-{
 #ifdef __ARM
+static float _set_power_value(nvObj_t *nv)
+{
 	if (nv->value < (float)0.0) nv->value = 0.0;
 	if (nv->value > (float)1.0) {
 		if (nv->value > (float)100) nv->value = 1;
  		nv->value /= 100;		// accommodate old 0-100 inputs
 	}
 	set_flt(nv);	// set power_setting value in the motor config struct (st)
+	return (nv->value * POWER_LEVEL_SCALE_FACTOR);
+}
+#endif
 
+stat_t st_set_pl(nvObj_t *nv)	// motor power level
+{
+#ifdef __ARM
 	uint8_t m = _get_motor(nv);
-	st_cfg.mot[m].power_level_scaled = (nv->value * POWER_LEVEL_SCALE_FACTOR);
-	st_run.mot[m].power_level_dynamic = (st_cfg.mot[m].power_level_scaled);
-	_set_motor_power_level(m, st_cfg.mot[m].power_level_scaled);
+	st_cfg.mot[m].power_level_scaled = _set_power_value(nv);
+	mp_stage_live_config();		// applied by the exec at the next segment (st_apply_power_levels())
+	if (mp_get_runtime_busy() == false) {	// ...or now if nothing is running
+		st_run.mot[m].power_level_dynamic = (st_cfg.mot[m].power_level_scaled);
+		_set_motor_power_level(m, st_cfg.mot[m].power_level_scaled);
+	}
+#endif
+	return(STAT_OK);
+}
+
+stat_t st_set_pb(nvObj_t *nv)	// motor power level while accelerating
+{
+#ifdef __ARM
+	st_cfg.mot[_get_motor(nv)].power_boost_scaled = _set_power_value(nv);
+	mp_stage_live_config();
+#endif
+	return(STAT_OK);
+}
+
+stat_t st_set_pi(nvObj_t *nv)	// motor power level while stopped
+{
+#ifdef __ARM
+	st_cfg.mot[_get_motor(nv)].power_idle_scaled = _set_power_value(nv);
+	mp_stage_live_config();
 #endif
 	return(STAT_OK);
 }
 
+/*
+ * st_apply_power_levels() - apply the power levels staged for the runtime (see mp_swap_live_config())
+ * _apply_power_phase()	   - set the motor power levels for a stPowerPhase
+ *
+ *	Each line segment is prepped with the phase it should run at (st_prep_power()): the boost
+ *	level in the head and tail of a line, the power level elsewhere. The loader changes the
+ *	levels when a segment's phase differs from the one they are set for, so the current
+ *	follows the ramps a segment at a time. Once the runtime has stopped the motor power
+ *	callback drops them to the idle level. A boost or idle level of 0 uses the power level.
+ *	The levels are read from the live settings so they can be changed while moving.
+ *
+ *	The phase is written last. If the loader changes levels while the callback is setting
+ *	the idle levels the next segment finds the phase wrong and sets them again.
+ */
+#ifdef __ARM
+static void _apply_power_phase(uint8_t phase)
+{
+	const mpLiveSettings_t *live = &ml.set[ml.active];
+	for (uint8_t motor=0; motor<MOTORS; motor++) {
+		float level = live->power_level[motor];
+		if ((phase == ST_POWER_BOOST) && (live->power_boost[motor] > 0)) level = live->power_boost[motor];
+		if ((phase == ST_POWER_IDLE) && (live->power_idle[motor] > 0)) level = live->power_idle[motor];
+		st_run.mot[motor].power_level_dynamic = level;
+		_set_motor_power_level(motor, level);
+	}
+	st_run.power_phase = phase;
+}
+#endif
+
+void st_apply_power_levels()
+{
+#ifdef __ARM
+	_apply_power_phase(st_run.power_phase);
+#endif
+}
+
 /*
  * st_get_pwr()	- get motor enable power state
  */
@@ -1257,6 +2137,50 @@ stat_t st_set_mt(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+stat_t st_set_sq(nvObj_t *nv)	// squaring switches - the axis of the switch pair, or 0
+{
+	if (nv->value > HOMING_AXES) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	return (set_ui8(nv));
+}
+
+stat_t st_set_msr(nvObj_t *nv)	// microstep morph rate
+{
+	set_int(nv);
+	config_mark_derived(DERIVED_STEPS_PER_UNIT);
+	return (STAT_OK);
+}
+
+stat_t st_set_urn(nvObj_t *nv)	// underrun count - only clears
+{
+	if (fp_NOT_ZERO(nv->value)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	_clear_underruns();
+	return (STAT_OK);
+}
+
+stat_t st_set_urb(nvObj_t *nv)	// underrun backoff fraction
+{
+	if ((nv->value < 0) || (nv->value > UNDERRUN_BACKOFF_MAX)) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+	return (set_flt(nv));
+}
+
+stat_t st_set_dda(nvObj_t *nv)	// DDA rate mode - the ARM always runs a constant rate
+{
+#ifndef __AVR
+	if (nv->value != DDA_CONSTANT_RATE) {
+		return (STAT_INPUT_VALUE_RANGE_ERROR);
+	}
+#endif
+	ritorno(set_01(nv));
+	config_mark_derived(DERIVED_STEP_VELOCITY);
+	return (STAT_OK);
+}
+
 stat_t st_set_md(nvObj_t *nv)	// Make sure this function is not part of initialization --> f00
 {
 	if (((uint8_t)nv->value == 0) || (nv->valuetype == TYPE_NULL)) {
@@ -1301,37 +2225,57 @@ static const char *const msg_units[] PROGMEM = { msg_units0, msg_units1, msg_uni
 static const char fmt_me[] PROGMEM = "motors energized\n";
 static const char fmt_md[] PROGMEM = "motors de-energized\n";
 static const char fmt_mt[] PROGMEM = "[mt]  motor idle timeout%14.2f Sec\n";
+static const char fmt_dda[] PROGMEM = "[dda] dda clock rate%18d [0=constant,1=variable]\n";
+static const char fmt_msr[] PROGMEM = "[msr] microstep morph rate%12lu steps/sec [0=off]\n";
+static const char fmt_urn[] PROGMEM = "[urn] underruns%23lu\n";
+static const char fmt_url[] PROGMEM = "[url] underrun line number%12lu\n";
+static const char fmt_urlc[] PROGMEM = "[urlc] late loads%20lu\n";
+static const char fmt_urll[] PROGMEM = "[urll] late load line number%9lu\n";
+static const char fmt_urb[] PROGMEM = "[urb] underrun backoff%16.3f [0=off]\n";
+static const char fmt_urf[] PROGMEM = "[urf] underrun backoff factor%9.3f\n";
 static const char fmt_0ma[] PROGMEM = "[%s%s] m%s map to axis%15d [0=X,1=Y,2=Z...]\n";
 static const char fmt_0sa[] PROGMEM = "[%s%s] m%s step angle%20.3f%s\n";
 static const char fmt_0tr[] PROGMEM = "[%s%s] m%s travel per revolution%10.4f%s\n";
 static const char fmt_0mi[] PROGMEM = "[%s%s] m%s microsteps%16d [1,2,4,8]\n";
 static const char fmt_0po[] PROGMEM = "[%s%s] m%s polarity%18d [0=normal,1=reverse]\n";
 static const char fmt_0pm[] PROGMEM = "[%s%s] m%s power management%10d [0=disabled,1=always on,2=in cycle,3=when moving]\n";
+static const char fmt_0bl[] PROGMEM = "[%s%s] m%s backlash%23.4f%s\n";
+static const char fmt_0sq[] PROGMEM = "[%s%s] m%s squaring switches%9d [0=none,1=x,2=y,3=z,4=a]\n";
 static const char fmt_0pl[] PROGMEM = "[%s%s] m%s motor power level%13.3f [0.000=minimum, 1.000=maximum]\n";
+static const char fmt_0pb[] PROGMEM = "[%s%s] m%s motor boost level%13.3f [power level in accel and decel, 0=use pl]\n";
+static const char fmt_0pi[] PROGMEM = "[%s%s] m%s motor idle level%14.3f [power level when stopped, 0=use pl]\n";
 static const char fmt_pwr[] PROGMEM = "Motor %c power enabled state:%2.0f\n";
 
 void st_print_mt(nvObj_t *nv) { text_print_flt(nv, fmt_mt);}
+void st_print_dda(nvObj_t *nv) { text_print_ui8(nv, fmt_dda);}
+void st_print_msr(nvObj_t *nv) { text_print_int(nv, fmt_msr);}
+void st_print_urn(nvObj_t *nv) { text_print_int(nv, fmt_urn);}
+void st_print_url(nvObj_t *nv) { text_print_int(nv, fmt_url);}
+void st_print_urlc(nvObj_t *nv) { text_print_int(nv, fmt_urlc);}
+void st_print_urll(nvObj_t *nv) { text_print_int(nv, fmt_urll);}
+void st_print_urb(nvObj_t *nv) { text_print_flt(nv, fmt_urb);}
+void st_print_urf(nvObj_t *nv) { text_print_flt(nv, fmt_urf);}
 void st_print_me(nvObj_t *nv) { text_print_nul(nv, fmt_me);}
 void st_print_md(nvObj_t *nv) { text_print_nul(nv, fmt_md);}
 
 static void _print_motor_ui8(nvObj_t *nv, const char *format)
 {
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, (uint8_t)nv->value);
+	text_printf_P(format, nv->group, nv->token, nv->group, (uint8_t)nv->value);
 }
 
 static void _print_motor_flt_units(nvObj_t *nv, const char *format, uint8_t units)
 {
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->value, GET_TEXT_ITEM(msg_units, units));
+	text_printf_P(format, nv->group, nv->token, nv->group, nv->value, GET_TEXT_ITEM(msg_units, units));
 }
 
 static void _print_motor_flt(nvObj_t *nv, const char *format)
 {
-	fprintf_P(stderr, format, nv->group, nv->token, nv->group, nv->value);
+	text_printf_P(format, nv->group, nv->token, nv->group, nv->value);
 }
 
 static void _print_motor_pwr(nvObj_t *nv, const char *format)
 {
-	fprintf_P(stderr, format, nv->token[0], nv->value);
+	text_printf_P(format, nv->token[0], nv->value);
 }
 
 void st_print_ma(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0ma);}
@@ -1341,6 +2285,10 @@ void st_print_mi(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0mi);}
 void st_print_po(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0po);}
 void st_print_pm(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0pm);}
 void st_print_pl(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pl);}
+void st_print_pb(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pb);}
+void st_print_pi(nvObj_t *nv) { _print_motor_flt(nv, fmt_0pi);}
+void st_print_sq(nvObj_t *nv) { _print_motor_ui8(nv, fmt_0sq);}
+void st_print_bl(nvObj_t *nv) { _print_motor_flt_units(nv, fmt_0bl, cm_get_units_mode(MODEL));}
 void st_print_pwr(nvObj_t *nv){ _print_motor_pwr(nv, fmt_pwr);}
 
 #endif // __TEXT_MODE
@@ -54,11 +54,40 @@
  *		If we were running from batteries or otherwise cared about the energy budget we
  *		might not be so cavalier about this.
  *
+ *		The Xmega can instead run a variable rate DDA ($dda=1). Each segment then picks the
+ *		lowest clock that gives the fastest motor of the segment DDA_STEP_OVERSAMPLING
+ *		ticks per step, between FREQUENCY_DDA_MIN and FREQUENCY_DDA_MAX. Slow moves give
+ *		the freed cycles back to planning and serial, and fast moves with fine microstepping
+ *		can go above FREQUENCY_DDA. The clock never runs so fast that the segment's ticks
+ *		times DDA_SUBSTEPS overflow the accumulator, which is what sets FREQUENCY_DDA's
+ *		limit in the constant rate case (see DDA substepping, below).
+ *
+ *    - Microstep morphing ($msr steps/sec, 0 is off) drops a motor to full steps while its
+ *		step rate is above the morph rate and goes back to the configured microsteps once
+ *		it falls below MICROSTEP_MORPH_HYSTERESIS of it, so rapids with fine microstepping
+ *		need 1/microsteps of the DDA rate. Only motors set to 2, 4 or 8 microsteps morph.
+ *		Prep asks for full steps and always gives the full step increment as well; the
+ *		loader makes the switch only at a full step boundary - going down when the count
+ *		of microsteps since the last full step is zero and going back when the accumulator
+ *		is less than a microstep into the next full step - and rescales the accumulator
+ *		by the microsteps. Steps run at full steps count as that many microsteps, so the
+ *		step position and the encoders stay in microsteps. The count starts at zero when
+ *		morphing is turned on or the microsteps change, so do that with the drivers at
+ *		their home state (e.g. after a power up). Following errors are not corrected while
+ *		a motor runs full steps, as they are then up to a full step by design.
+ *
  *		At 50 KHz constant clock rate we have 20 uSec between pulse timer (DDA) interrupts.
  *		On the Xmega we consume <10 uSec in the interrupt - a whopping 50% of available cycles
  *		going into pulse generation. On the ARM this is less of an issue, and we run a
  *		100 Khz (or higher) pulse rate.
  *
+ *    - With __STEP_PULSE_COMPARE the pulse width no longer depends on the ISR code path.
+ *		The DDA interrupt only decides which motors step and sets their step bits together,
+ *		then arms the DDA timer's compare A interrupt to clear them STEP_PULSE_USEC later.
+ *		Pulses are the same width for every motor and every rate, as external drivers want.
+ *		The pulses can't come from timer compare outputs directly: motor 1 is on PORTA,
+ *		which has no timer outputs, and all the type 0 timers are already taken.
+ *
  *    - Pulse timing is also helped by minimizing the time spent loading the next move
  *		segment. The time budget for the load is less than the time remaining before the
  *		next DDA clock tick. This means that the load must take < 10 uSec or the time
@@ -211,7 +240,8 @@
  *		be needed to run the move - in this example st_prep_line().
  *
  *	 7	st_prep_line() generates the timer and DDA values and stages these into
- *		the prep structure (sp) - ready for loading into the stepper runtime struct
+ *		the next free slot of the prep ring (st_pre.seg[]) - ready for loading into
+ *		the stepper runtime struct. Exec repeats 4-7 until the ring is full.
  *
  *	 8	stepper.st_prep_line() returns back to planner.mp_exec_move(), which
  *		frees the planning buffer (bf) back to the planner buffer pool if the
@@ -223,9 +253,9 @@
  *		to receive the next Gcode block. This handoff prevents possible data
  *		conflicts between the interrupt and main loop.
  *
- *	10	The final step in the sequence is _load_move() requesting the next
- *		segment to be executed and prepared by calling st_request_exec()
- *		- control goes back to step 4.
+ *	10	The final step in the sequence is _load_move() taking the oldest slot from
+ *		the ring and requesting the next segment to be executed and prepared by
+ *		calling st_request_exec() - control goes back to step 4.
  *
  *	Note: For this to work you have to be really careful about what structures
  *	are modified at what level, and use volatiles where necessary.
@@ -276,6 +306,12 @@ enum cmMotorPowerMode {
 #define Vcc	3.3							// volts
 #define MaxVref	2.25					// max vref for driver circuit. Our ckt is 2.25 volts
 #define POWER_LEVEL_SCALE_FACTOR ((MaxVref/Vcc)) // scale power level setting for voltage range
+
+enum stPowerPhase {						// power level a segment runs at (see st_prep_power())
+	ST_POWER_NOMINAL = 0,				// power level (pl) - cruise and everything but line ramps
+	ST_POWER_BOOST,						// boost level (pb) - head and tail of a line
+	ST_POWER_IDLE						// idle level (pi) - runtime stopped
+};
 
 // Min/Max timeouts allowed for motor disable. Allow for inertial stop; must be non-zero
 #define MOTOR_TIMEOUT_SECONDS_MIN 	(float)0.1		// seconds !!! SHOULD NEVER BE ZERO !!!
@@ -295,29 +331,77 @@ enum cmMotorPowerMode {
  *
  *		MAX_LONG == 2^31, maximum signed long (depth of accumulator. NB: accumulator values are negative)
  *		FREQUENCY_DDA == DDA clock rate in Hz.
- *		NOM_SEGMENT_TIME == upper bound of segment time in minutes
- *		0.90 == a safety factor used to reduce the result from theoretical maximum
+ *		MAX_SEGMENT_TIME == longest segment time in minutes (body segments - exec splits longer ones)
+ *		0.90 == a safety factor used to reduce the result from theoretical maximum (it also covers
+ *				a network slave stretching a segment by up to NET_TRIM_MAX)
  *
- *	The number is about 8.5 million for the Xmega running a 50 KHz DDA with 5 millisecond segments
+ *	The number is about 3,900,000 for the Xmega running a 50 KHz DDA with 10 millisecond segments
  *	The ARM is about 1/4 that (or less) as the DDA clock rate is 4x higher. Decreasing the nominal
  *	segment time increases the number precision.
  */
-#define DDA_SUBSTEPS ((MAX_LONG * 0.90) / (FREQUENCY_DDA * (NOM_SEGMENT_TIME * 60)))
+#define DDA_SUBSTEPS ((MAX_LONG * 0.90) / (FREQUENCY_DDA * (MAX_SEGMENT_TIME * 60)))
+#define DDA_STEP_OVERSAMPLING		8				// min DDA ticks per step of the fastest motor in variable rate mode
+#define MICROSTEP_MORPH_HYSTERESIS	0.75			// fraction of the morph rate that returns to microsteps
+
+enum stDdaMode {
+	DDA_CONSTANT_RATE = 0,				// DDA runs at FREQUENCY_DDA
+	DDA_VARIABLE_RATE					// DDA rate is chosen for each segment (Xmega only)
+};
 
 /* Step correction settings
  *	Step correction settings determine how the encoder error is fed back to correct position errors.
- *	Since the following_error is running 2 segments behind the current segment you have to be careful
- *	not to overcompensate. The threshold determines if a correction should be applied, and the factor
- *	is how much. The holdoff is how many segments to wait before applying another correction. If threshold
- *	is too small and/or amount too large and/or holdoff is too small you may get a runaway correction
- *	and error will grow instead of shrink (or oscillate).
+ *	They are per-motor settings ($1ct, $1cf, $1cm - see encoder.h). Since the following_error is
+ *	running up to PREP_RING_SIZE+1 segments behind the current segment you have to be careful not
+ *	to overcompensate. A correction is held off until the segment it went into has been measured.
+ *	If the threshold is too small and/or the factor too large you may still get an oscillating
+ *	correction and the error will grow instead of shrink.
+ */
+/* Backlash compensation
+ *	A motor with a backlash setting ($1bl, in length units) takes up the backlash on
+ *	each direction change in st_prep_line(). The take-up steps are added to the travel
+ *	of the segments that follow the reversal, at most as many as the segment already
+ *	has, so the motor runs no more than twice its commanded speed while taking up and
+ *	the planner never sees the extra motion. The first move after reset takes up nothing
+ *	as the side the backlash is on is not known yet. The take-up is kept out of the
+ *	following error as the motors run it but the targets don't include it.
+ */
+/* Squared gantries
+ *	Two motors mapped to the same axis share its steps, so normal motion costs nothing extra.
+ *	To square the gantry at homing a motor can be given its own switches ($4sq - the axis
+ *	whose min/max switch inputs it uses). Homing then holds each side as its switch is
+ *	reached (st_hold_motors()) and runs the axis on with the other (see cycle_homing.c).
+ *	A held motor's steps go into its step offset so the following error doesn't see them.
  */
-#define STEP_CORRECTION_THRESHOLD	(float)2.00		// magnitude of forwarding error to apply correction (in steps)
-#define STEP_CORRECTION_FACTOR		(float)0.25		// factor to apply to step correction for a single segment
-#define STEP_CORRECTION_MAX			(float)0.60		// max step correction allowed in a single segment
-#define STEP_CORRECTION_HOLDOFF		 	 	  5		// minimum number of segments to wait between error correction
 #define STEP_INITIAL_DIRECTION		DIRECTION_CW
 
+/* Prep ring
+ *	Exec prepares segments into a small ring that the loader drains. Keeping a few segments
+ *	ready lets the DDA ride through a late exec (e.g. a busy serial RX or a slow velocity
+ *	computation) without starving. The cost is that exec runs that many segments ahead of the
+ *	motors, so feedholds start decelerating up to PREP_RING_SIZE segments later.
+ *	Must be a power of 2.
+ */
+#define PREP_RING_SIZE				4				// number of prepared segments queued ahead of the loader
+#define PREP_RING_MASK				(PREP_RING_SIZE-1)
+
+/* Underruns
+ *	An underrun is a segment ending with nothing in the prep ring while the machine is in
+ *	motion - the DDA idles until exec catches up and the motors stutter. A late load is a
+ *	segment loaded in motion that leaves the ring empty, so the DDA is running the last one
+ *	exec had ready: the warning before an underrun. Loads made on request (the start of a
+ *	motion, after a command) don't count. The loader counts events, and exec totals them
+ *	with the line number of the move it is on ($ur group; $urn=0 clears them).
+ *
+ *	With an underrun backoff ($urb, 0 is off) exec slows the motion by that fraction each
+ *	time UNDERRUN_BACKOFF_COUNT underruns come with less than UNDERRUN_BACKOFF_SEGMENTS clean
+ *	segments between them, down to FEED_OVERRIDE_MIN, and speeds back up by the same step
+ *	after every UNDERRUN_BACKOFF_SEGMENTS clean segments. The factor ($urf) is applied on
+ *	top of the feed and traverse overrides and ramps like them (see _get_segment_time()).
+ */
+#define UNDERRUN_BACKOFF_COUNT		3				// underruns close together that slow the motion
+#define UNDERRUN_BACKOFF_SEGMENTS	200				// clean segments that reset the count or speed back up
+#define UNDERRUN_BACKOFF_MAX		0.5				// largest $urb
+
 /*
  * Stepper control structures
  *
@@ -344,17 +428,27 @@ typedef struct cfgMotor {				// per-motor configs
 	uint8_t polarity;					// 0=normal polarity, 1=reverse motor direction
 	uint8_t power_mode;					// See cmMotorPowerMode for enum
 	float power_level;					// set 0.000 to 1.000 for PMW vref setting
+	float power_boost;					// power level while accelerating; 0 uses power_level (ARM only)
+	float power_idle;					// power level while stopped; 0 uses power_level (ARM only)
 	float step_angle;					// degrees per whole step (ex: 1.8)
 	float travel_rev;					// mm or deg of travel per motor revolution
 	float steps_per_unit;				// microsteps per mm (or degree) of travel
+	float backlash;						// mm or deg of travel taken up on a direction change
+	uint8_t square_switches;			// axis whose switches the motor is squared on (1=X...4=A), 0=none
 	float units_per_step;				// mm or degrees of travel per microstep
 
-	// private
+	// private
 	float power_level_scaled;			// scaled to internal range - must be between 0 and 1
+	float power_boost_scaled;			// ...for power_boost
+	float power_idle_scaled;			// ...for power_idle
+	uint8_t morph_shift;				// log2 of the microsteps if the motor morphs to full steps, else 0
 } cfgMotor_t;
 
 typedef struct stConfig {				// stepper configs
 	float motor_power_timeout;			// seconds before setting motors to idle current (currently this is OFF)
+	uint8_t dda_mode;					// see stDdaMode
+	uint32_t morph_rate;				// microsteps/sec above which motors run full steps; 0 is off
+	float underrun_backoff;				// fraction the feed is slowed by on repeated underruns; 0 is off
 	cfgMotor_t mot[MOTORS];				// settings for motors 1-N
 } stConfig_t;
 
@@ -363,6 +457,8 @@ typedef struct stConfig {				// stepper configs
 typedef struct stRunMotor {				// one per controlled motor
 	uint32_t substep_increment;			// total steps in axis times substeps factor
 	int32_t substep_accumulator;		// DDA phase angle accumulator
+	uint8_t microstep_shift;			// 0 at the configured microsteps, morph_shift at full steps
+	uint8_t microstep_phase;			// microsteps run since the last full step (loader only)
 	uint8_t power_state;				// state machine for managing motor power
 	uint32_t power_systick;				// sys_tick for next motor power state transition
 	float power_level_dynamic;			// power level for this segment of idle (ARM only)
@@ -372,6 +468,21 @@ typedef struct stRunSingleton {			// Stepper static values and axis parameters
 	uint16_t magic_start;				// magic number to test memory integrity
 	uint32_t dda_ticks_downcount;		// tick down-counter (unscaled)
 	uint32_t dda_ticks_X_substeps;		// ticks multiplied by scaling factor
+	uint8_t raster_left;				// pixels left to step through in the raster line; 0 if none
+	uint8_t raster_pinned;				// TRUE if pixels up to raster_end are still to be released
+	uint16_t raster_index;				// pixel being engraved (index into mb.raster[])
+	uint16_t raster_end;				// index past the last pixel of the raster line
+	uint16_t raster_countdown;			// DDA ticks to the next pixel
+	uint16_t raster_period;				// DDA ticks per pixel
+	uint16_t laser_off;					// PWM_1 compare value for laser off
+	int32_t laser_span;					// PWM_1 compare value change from off to a full power pixel
+	uint16_t laser_compare;				// PWM_1 compare value the dither steps up from
+	uint8_t laser_fraction;				// 1/256 compare counts dithered in every DDA tick; 0 = none
+	uint8_t laser_dither;				// dither accumulator
+	uint8_t segment_ended;				// TRUE if the loader is called at the end of a segment
+	uint8_t underruns;					// underrun events (wraps - totalled by exec)
+	uint8_t late_loads;					// late load events (wraps - totalled by exec)
+	uint8_t power_phase;				// stPowerPhase the motor power levels are set for
 	stRunMotor_t mot[MOTORS];			// runtime motor structures
 	uint16_t magic_end;
 } stRunSingleton_t;
@@ -380,39 +491,141 @@ typedef struct stRunSingleton {			// Stepper static values and axis parameters
 // Must be careful about volatiles in this one
 
 typedef struct stPrepMotor {
-	uint32_t substep_increment;	 		// total steps in axis times substep factor
-
 	// direction and direction change
-	int8_t direction;					// travel direction corrected for polarity
-	uint8_t prev_direction;				// travel direction from previous segment run for this motor
-	int8_t step_sign;					// set to +1 or -1 for encoders
+	uint8_t prev_direction;				// travel direction from previous segment run for this motor (loader only)
+
+	// backlash compensation and gantry squaring
+	int8_t backlash_direction;			// sign of the last travel prepped; 0 if there was none yet
+	float backlash_takeup;				// signed steps of backlash still to take up
+	float step_offset;					// steps run off the targets since the position was last set
 
 	// following error correction
-	int32_t correction_holdoff;			// count down segments between corrections
+	uint8_t correction_age;				// segments prepped since the last correction (saturates at 255)
+	uint32_t corrections;				// number of corrections applied (for diagnostic display only)
 	float corrected_steps;				// accumulated correction steps for the cycle (for diagnostic display only)
 
 	// accumulator phase correction
-	float prev_segment_time;			// segment time from previous segment run for this motor
-	float accumulator_correction;		// factor for adjusting accumulator between segments
-	uint8_t accumulator_correction_flag;// signals accumulator needs correction
+	uint32_t prev_segment_ticks;		// DDA ticks of the previous segment prepped for this motor
 
+	// microstep morphing
+	uint8_t full_steps;					// TRUE if the last segment prepped asked for full steps
 } stPrepMotor_t;
 
-typedef struct stPrepSingleton {
-	uint16_t magic_start;				// magic number to test memory integrity
+// Prepared segment structure. One slot of the prep ring - written by exec, read by the loader
+
+typedef struct stPrepSegmentMotor {
+	uint32_t substep_increment;	 		// total steps in axis times substep factor
+	int8_t direction;					// travel direction corrected for polarity
+	int8_t step_sign;					// set to +1 or -1 for encoders
+	float accumulator_correction;		// factor for adjusting accumulator between segments
+	uint8_t accumulator_correction_flag;// signals accumulator needs correction
+	uint8_t full_steps;					// TRUE to run full steps (microstep morphing)
+	uint32_t full_step_increment;		// substep_increment at full steps (morphing motors only)
+} stPrepSegmentMotor_t;
+
+typedef struct stPrepSegment {
 	volatile uint8_t buffer_state;		// prep buffer state - owned by exec or loader
-	struct mpBuffer *bf;				// static pointer to relevant buffer
 	uint8_t move_type;					// move type
+	struct mpBuffer *bf;				// static pointer to relevant buffer (commands only)
+	uint8_t command;					// command chain to run if bf is NULL (commands only)
 
 	uint16_t dda_period;				// DDA or dwell clock period setting
 	uint32_t dda_ticks;					// DDA or dwell ticks for the move
 	uint32_t dda_ticks_X_substeps;		// DDA ticks scaled by substep factor
-	stPrepMotor_t mot[MOTORS];			// prep time motor structs
+	uint16_t laser_compare;				// PWM_1 compare value for the segment in laser mode
+	uint8_t laser_fraction;				// compare value fraction for dithering (see pwm_get_fraction())
+	uint16_t laser2_compare;			// PWM_2 compare value for the segment in laser mode
+	uint8_t spindle_wait;				// TRUE if a dwell lasts until the spindle is at speed
+	uint8_t raster;						// TRUE if the segment is part of a raster line
+	uint8_t power_phase;				// stPowerPhase to run the segment at (ARM only)
+	uint8_t outputs_on;					// gpio1 bits switched on as the segment is loaded (M62)
+	uint8_t outputs_off;				// gpio1 bits switched off as the segment is loaded (M63)
+	uint8_t raster_left;				// raster values - see stRunSingleton_t
+	uint16_t raster_index;
+	uint16_t raster_end;
+	uint16_t raster_countdown;
+	uint16_t raster_period;
+	uint16_t laser_off;
+	stPrepSegmentMotor_t mot[MOTORS];	// per-motor segment values
+} stPrepSegment_t;
+
+typedef struct stPrepSingleton {
+	uint16_t magic_start;				// magic number to test memory integrity
+	uint8_t prep_index;					// slot being prepped by exec (only changed by exec)
+	uint8_t load_index;					// slot to be loaded next (only changed by the loader)
+	stPrepSegment_t seg[PREP_RING_SIZE];// ring of prepared segments
+	stPrepMotor_t mot[MOTORS];			// prep time motor state carried across segments
+	uint8_t held_motors;				// bitmap of motors that don't step while a gantry is squared
+	float dda_frequency;				// DDA frequency of the segment last prepped by st_prep_line()
+	float dda_residue;					// seconds of a tick carried to the next segment in variable rate mode
+
+	// timing cached across segments of the same time (see st_prep_line())
+	float cached_segment_time;			// segment time of the cached ticks; 0 if none (constant rate only)
+	uint32_t cached_ticks;				// DDA ticks for cached_segment_time
+	uint32_t cached_ticks_X_substeps;	// ...scaled by the substep factor
+	uint32_t correction_ticks;			// DDA ticks of the cached accumulator correction
+	uint32_t correction_prev_ticks;		// previous segment ticks it corrects from
+	float correction_ratio;				// correction_ticks / correction_prev_ticks
+
+	// underruns and late loads (see Underruns, above)
+	uint8_t underruns_seen;				// loader underrun events already totalled
+	uint8_t late_loads_seen;			// loader late load events already totalled
+	uint32_t underrun_count;			// underruns since the last clear
+	uint32_t underrun_line;				// line being executed at the last underrun
+	uint32_t late_load_count;			// late loads since the last clear
+	uint32_t late_load_line;			// line being executed at the last late load
+	uint32_t backoff_seen;				// underrun_count already seen by the backoff
+	uint16_t backoff_clean;				// segments since the last underrun or backoff step
+	uint8_t backoff_events;				// underruns close together since the last backoff step
+	float backoff_factor;				// underrun backoff applied to motion (1.0 when off)
 	uint16_t magic_end;
 } stPrepSingleton_t;
 
+/* ISR timing structures (__ISR_TIMING)
+ *	Cycle accounting for the stepper interrupts and the exec. Durations are in CPU cycles read
+ *	from the free-running TIMER_CYCLES, so they are wall time including any higher level ISRs
+ *	that ran in between. Anything over 2 ms aliases as the counter is only 16 bits.
+ *
+ *	Histogram bin 0 counts durations under 2^shift cycles, each following bin doubles the upper
+ *	bound, and the last bin takes everything above. The mean halves sum and n together before
+ *	the sum overflows, so it follows recent behavior. Values are read without locking and may
+ *	tear while the machine is running.
+ *
+ *	Groups: _td DDA ISR, _tw dwell ISR, _tl load, _tx exec, _tk kinematics, _tg load latency.
+ *	Members are l (min), h (max), m (mean), c (count) and 0-7 (histogram). _tx and _tk also
+ *	have b, the slowest pass as a percent of a nominal segment. $_tcl clears them all.
+ */
+#define ST_TIMING_BINS				8
+#define ST_TIMING_ISR_SHIFT			6		// ISR bins start at 64 cycles (2 uSec)
+#define ST_TIMING_EXEC_SHIFT		9		// exec bins start at 512 cycles (16 uSec)
+
+typedef struct stTimingStat {
+	uint32_t min;						// fastest pass in cycles
+	uint32_t max;						// slowest pass in cycles
+	uint32_t count;						// passes recorded since last clear
+	uint32_t sum;						// cycles summed for the mean
+	uint32_t n;							// passes summed for the mean
+	uint32_t hist[ST_TIMING_BINS];		// duration histogram
+} stTimingStat_t;
+
+typedef struct stTimingSingleton {
+	stTimingStat_t dda;					// DDA ISR, including the load at the end of a segment
+	stTimingStat_t dwell;				// dwell ISR
+	stTimingStat_t load;				// _load_move() when it loads something
+	stTimingStat_t exec;				// mp_exec_move()
+	stTimingStat_t kin;					// ik_kinematics() - part of exec
+	stTimingStat_t gap;					// load latency: end of a segment to start of the next
+	uint32_t starved;					// segment ends with nothing to load (includes normal stops)
+	uint16_t segment_end;				// cycle count at the end of the last segment
+	uint8_t segment_ended;				// segment_end is valid
+} stTimingSingleton_t;
+
 extern stConfig_t st_cfg;				// config struct is exposed. The rest are private
 extern stPrepSingleton_t st_pre;		// only used by config_app diagnostics
+#ifdef __ISR_TIMING
+extern stTimingSingleton_t st_tim;		// only used by config_app diagnostics and kinematics
+void st_timing_record(stTimingStat_t *t, const uint16_t cycles, const uint8_t shift);
+#endif
 
 /**** FUNCTION PROTOTYPES ****/
 
@@ -422,9 +635,16 @@ stat_t stepper_test_assertions(void);
 
 uint8_t st_runtime_isbusy(void);
 void st_reset(void);
+void st_update_steps_per_unit(void);
+float st_get_step_rate_max(uint8_t motor);
+float st_get_underrun_backoff(void);
+float st_get_prep_ring_time(uint8_t *segments);
 void st_cycle_start(void);
 void st_cycle_end(void);
 stat_t st_clc(nvObj_t *nv);
+stat_t st_clear_timing(nvObj_t *nv);
+stat_t st_get_timing_mean(nvObj_t *nv);
+stat_t st_get_timing_budget(nvObj_t *nv);
 
 void st_energize_motors(void);
 void st_deenergize_motors(void);
@@ -432,19 +652,36 @@ void st_set_motor_power(const uint8_t motor);
 stat_t st_motor_power_callback(void);
 
 void st_request_exec_move(void);
+void st_request_plan(void);
 void st_prep_null(void);
 void st_prep_command(void *bf);		// use a void pointer since we don't know about mpBuf_t yet)
+void st_prep_command_chain(uint8_t command);
 void st_prep_dwell(float microseconds);
-stat_t st_prep_line(float travel_steps[], float following_error[], float segment_time);
-
+void st_prep_spindle_wait(void);
+stat_t st_prep_line(float travel_steps[], float following_error[], uint8_t error_age, float segment_time);
+void st_hold_motors(uint8_t motors);
+void st_prep_laser(uint8_t chan, float duty);
+void st_prep_power(uint8_t phase);
+void st_prep_outputs(uint8_t on, uint8_t off);
+void st_prep_raster(uint16_t index, uint16_t end, uint8_t left, float countdown, float period);
+
+stat_t st_set_ma(nvObj_t *nv);
 stat_t st_set_sa(nvObj_t *nv);
 stat_t st_set_tr(nvObj_t *nv);
 stat_t st_set_mi(nvObj_t *nv);
 stat_t st_set_pm(nvObj_t *nv);
 stat_t st_set_pl(nvObj_t *nv);
+stat_t st_set_pb(nvObj_t *nv);
+stat_t st_set_pi(nvObj_t *nv);
+void st_apply_power_levels(void);
 stat_t st_get_pwr(nvObj_t *nv);
 
 stat_t st_set_mt(nvObj_t *nv);
+stat_t st_set_dda(nvObj_t *nv);
+stat_t st_set_msr(nvObj_t *nv);
+stat_t st_set_urn(nvObj_t *nv);
+stat_t st_set_urb(nvObj_t *nv);
+stat_t st_set_sq(nvObj_t *nv);
 stat_t st_set_md(nvObj_t *nv);
 stat_t st_set_me(nvObj_t *nv);
 
@@ -457,8 +694,20 @@ stat_t st_set_me(nvObj_t *nv);
 	void st_print_po(nvObj_t *nv);
 	void st_print_pm(nvObj_t *nv);
 	void st_print_pl(nvObj_t *nv);
+	void st_print_pb(nvObj_t *nv);
+	void st_print_pi(nvObj_t *nv);
+	void st_print_bl(nvObj_t *nv);
+	void st_print_sq(nvObj_t *nv);
 	void st_print_pwr(nvObj_t *nv);
 	void st_print_mt(nvObj_t *nv);
+	void st_print_dda(nvObj_t *nv);
+	void st_print_msr(nvObj_t *nv);
+	void st_print_urn(nvObj_t *nv);
+	void st_print_url(nvObj_t *nv);
+	void st_print_urlc(nvObj_t *nv);
+	void st_print_urll(nvObj_t *nv);
+	void st_print_urb(nvObj_t *nv);
+	void st_print_urf(nvObj_t *nv);
 	void st_print_me(nvObj_t *nv);
 	void st_print_md(nvObj_t *nv);
 
@@ -471,8 +720,20 @@ stat_t st_set_me(nvObj_t *nv);
 	#define st_print_po tx_print_stub
 	#define st_print_pm tx_print_stub
 	#define st_print_pl tx_print_stub
+	#define st_print_pb tx_print_stub
+	#define st_print_pi tx_print_stub
+	#define st_print_bl tx_print_stub
+	#define st_print_sq tx_print_stub
 	#define st_print_pwr tx_print_stub
 	#define st_print_mt tx_print_stub
+	#define st_print_dda tx_print_stub
+	#define st_print_msr tx_print_stub
+	#define st_print_urn tx_print_stub
+	#define st_print_url tx_print_stub
+	#define st_print_urlc tx_print_stub
+	#define st_print_urll tx_print_stub
+	#define st_print_urb tx_print_stub
+	#define st_print_urf tx_print_stub
 	#define st_print_me tx_print_stub
 	#define st_print_md tx_print_stub
 
@@ -45,10 +45,14 @@
 #include "config.h"
 #include "switch.h"
 #include "hardware.h"
+#include "controller.h"
 #include "canonical_machine.h"
+#include "encoder.h"
 #include "text_parser.h"
 
 static void _switch_isr_helper(uint8_t sw_num);
+static uint8_t _switch_is_steady(uint8_t sw_num);
+static void _switch_trip(uint8_t sw_num, uint32_t now);
 
 /*
  * switch_init() - initialize homing/limit switches
@@ -98,10 +102,18 @@ void switch_init(void)
  * switch_rtc_callback() - called from RTC for each RTC tick.
  *
  *	These functions interact with each other to process switch closures and firing.
- *	Each switch has a counter which is initially set to negative SW_DEGLITCH_TICKS.
- *	When a switch closure is DETECTED the count increments for each RTC tick.
- *	When the count reaches zero the switch is tripped and action occurs.
- *	The counter continues to increment positive until the lockout is exceeded.
+ *	The ISR timestamps each edge from the microsecond timebase. Each RTC tick checks
+ *	the time since the last edge: once the switch has held for SW_DEGLITCH_USEC it is
+ *	tripped and action occurs. It is then locked out for SW_LOCKOUT_USEC from the trip.
+ *	An edge during deglitching restarts the deglitch time.
+ *
+ *	With the edge filter ($sf=1) the ISR trips the switch itself if the pin reads the
+ *	same SW_FILTER_SAMPLES times running, which rejects noise spikes of a few usec.
+ *	That takes out the RTC tick and the deglitch time - up to some 11ms, or 1.8mm at
+ *	10 m/min. Contact bounce after the trip falls into the lockout, which the RTC still
+ *	times, as it does the re-arm. An edge that does not read steady is deglitched on the
+ *	RTC as usual. The xmega ports have no input filter of their own and the event system's
+ *	digital filter only spans 8 peripheral clocks, so the pins are sampled in software.
  */
 
 ISR(X_MIN_ISR_vect)	{ _switch_isr_helper(SW_MIN_X);}
@@ -117,37 +129,73 @@ static void _switch_isr_helper(uint8_t sw_num)
 {
 	if (sw.mode[sw_num] == SW_MODE_DISABLED) return;	// this is never supposed to happen
 	if (sw.debounce[sw_num] == SW_LOCKOUT) return;		// exit if switch is in lockout
+	controller_post_event(EVENT_SWITCH);
+
+	// latch the step position at the edge - a probe stops all axes, a homing switch its own axis
+	if (cm.cycle_state == CYCLE_PROBE) {
+		en_latch_steps(-1);
+	} else if (cm.cycle_state == CYCLE_HOMING) {
+		en_latch_steps(SWITCH_AXIS(sw_num));
+	}
+	if ((sw.filter == SW_FILTER_EDGE) && (_switch_is_steady(sw_num) == true)) {
+		_switch_trip(sw_num, hw_get_usec());
+		return;
+	}
+	sw.edge_time[sw_num] = hw_get_usec();				// restart deglitch time regardless of entry state
 	sw.debounce[sw_num] = SW_DEGLITCHING;				// either transitions state from IDLE or overwrites it
-	sw.count[sw_num] = -SW_DEGLITCH_TICKS;				// reset deglitch count regardless of entry state
 	read_switch(sw_num);							// sets the state value in the struct
 }
 
+static uint8_t _switch_is_steady(uint8_t sw_num)
+{
+	uint8_t state = read_switch(sw_num);
+	for (uint8_t i=1; i<SW_FILTER_SAMPLES; i++) {
+		if (read_switch(sw_num) != state) return (false);
+	}
+	return (true);
+}
+
+static void _switch_trip(uint8_t sw_num, uint32_t now)
+{
+	sw.sw_num_thrown = sw_num;							// record number of thrown switch
+	sw.edge_time[sw_num] = now;							// lockout runs from the trip
+	sw.debounce[sw_num] = SW_LOCKOUT;
+//	sw_show_switch();									// only called if __DEBUG enabled
+
+	if ((cm.cycle_state == CYCLE_HOMING) || (cm.cycle_state == CYCLE_PROBE)) {		// regardless of switch type
+		cm_request_feedhold();
+	} else if (sw.mode[sw_num] & SW_LIMIT_BIT) {		// should be a limit switch, so fire it.
+		sw.limit_flag = true;							// triggers an emergency shutdown
+	}
+}
+
 void switch_rtc_callback(void)
 {
+	uint32_t now = hw_get_usec();
+
 	for (uint8_t i=0; i < NUM_SWITCHES; i++) {
 		if (sw.mode[i] == SW_MODE_DISABLED || sw.debounce[i] == SW_IDLE)
             continue;
 
-		if (++sw.count[i] == SW_LOCKOUT_TICKS) {		// state is either lockout or deglitching
+		cli();											// the switch ISR may rewrite the edge time
+		int32_t elapsed = (int32_t)(now - sw.edge_time[i]);	// negative if an edge came after now
+		sei();
+		if (sw.debounce[i] == SW_LOCKOUT) {
+			if (elapsed < SW_LOCKOUT_USEC)
+				continue;
 			sw.debounce[i] = SW_IDLE;
             // check if the state has changed while we were in lockout...
             uint8_t old_state = sw.state[i];
             if(old_state != read_switch(i)) {
+                sw.edge_time[i] = now;
                 sw.debounce[i] = SW_DEGLITCHING;
-                sw.count[i] = -SW_DEGLITCH_TICKS;
             }
             continue;
 		}
-		if (sw.count[i] == 0) {							// trigger point
-			sw.sw_num_thrown = i;						// record number of thrown switch
-			sw.debounce[i] = SW_LOCKOUT;
-//			sw_show_switch();							// only called if __DEBUG enabled
-
-			if ((cm.cycle_state == CYCLE_HOMING) || (cm.cycle_state == CYCLE_PROBE)) {		// regardless of switch type
-				cm_request_feedhold();
-			} else if (sw.mode[i] & SW_LIMIT_BIT) {		// should be a limit switch, so fire it.
-				sw.limit_flag = true;					// triggers an emergency shutdown
-			}
+		if (elapsed >= SW_DEGLITCH_USEC) {				// trigger point
+			cli();										// the edge filter may trip it too
+			if (sw.debounce[i] == SW_DEGLITCHING) _switch_trip(i, now);
+			sei();
 		}
 	}
 }
@@ -235,6 +283,13 @@ stat_t sw_set_st(nvObj_t *nv)			// switch type (global)
 	return (STAT_OK);
 }
 
+stat_t sw_set_sf(nvObj_t *nv)			// switch filter (global)
+{
+	set_01(nv);
+	reset_switches();
+	return (STAT_OK);
+}
+
 stat_t sw_set_sw(nvObj_t *nv)			// switch setting
 {
 	if (nv->value > SW_MODE_MAX_VALUE)
@@ -254,6 +309,9 @@ stat_t sw_set_sw(nvObj_t *nv)			// switch setting
 static const char fmt_st[] PROGMEM = "[st]  switch type%18d [0=NO,1=NC]\n";
 void sw_print_st(nvObj_t *nv) { text_print_ui8(nv, fmt_st);}
 
+static const char fmt_sf[] PROGMEM = "[sf]  switch filter%16d [0=RTC deglitch,1=trip on edge]\n";
+void sw_print_sf(nvObj_t *nv) { text_print_ui8(nv, fmt_sf);}
+
 //static const char fmt_ss[] PROGMEM = "Switch %s state:     %d\n";
 //void sw_print_ss(nvObj_t *nv) { fprintf(stderr, fmt_ss, nv->token, (uint8_t)nv->value);}
 
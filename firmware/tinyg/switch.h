@@ -43,9 +43,10 @@
 /*
  * Common variables and settings
  */
-											// timer for debouncing switches
-#define SW_LOCKOUT_TICKS 25					// 25=250ms. RTC ticks are ~10ms each
-#define SW_DEGLITCH_TICKS 3					// 3=30ms
+											// times for debouncing switches (see hw_get_usec())
+#define SW_LOCKOUT_USEC 250000				// 250ms after a trip before the switch is looked at again
+#define SW_DEGLITCH_USEC 1000				// 1ms the switch must hold after its last edge to trip
+#define SW_FILTER_SAMPLES 8					// pin reads that must agree for an edge to trip in the ISR
 
 // switch modes
 #define SW_HOMING_BIT 0x01
@@ -61,6 +62,11 @@ enum swType {
 	SW_TYPE_NORMALLY_CLOSED
 };
 
+enum swFilter {						// how an edge becomes a trip (see _switch_isr_helper())
+	SW_FILTER_RTC = 0,				// deglitch on the RTC tick (up to ~10ms latency)
+	SW_FILTER_EDGE					// trip in the edge ISR once the pin reads steady
+};
+
 enum swState {
 	SW_DISABLED = -1,
 	SW_OPEN = 0,					// also read as 'false'
@@ -73,6 +79,7 @@ enum swState {
 // macros for finding the index into the switch table give the axis number
 #define MIN_SWITCH(axis) (axis*2)
 #define MAX_SWITCH(axis) (axis*2+1)
+#define SWITCH_AXIS(sw_num) (sw_num/2)
 
 enum swDebounce {							// state machine for managing debouncing and lockout
 	SW_IDLE = 0,
@@ -139,12 +146,13 @@ enum swEdge {
  */
 struct swStruct {								// switch state
 	uint8_t switch_type;						// 0=NO, 1=NC - applies to all switches
+	uint8_t filter;								// swFilter: 0=RTC deglitch, 1=trip on the edge
 	uint8_t limit_flag;							// 1=limit switch thrown - do a lockout
 	uint8_t sw_num_thrown;						// number of switch that was just thrown
 	uint8_t state[NUM_SWITCHES];				// 0=OPEN, 1=CLOSED (depends on switch type)
 	volatile uint8_t mode[NUM_SWITCHES];		// 0=disabled, 1=homing, 2=homing+limit, 3=limit
 	volatile uint8_t debounce[NUM_SWITCHES];	// switch debouncer state machine - see swDebounce
-	volatile int8_t count[NUM_SWITCHES];		// deglitching and lockout counter
+	volatile uint32_t edge_time[NUM_SWITCHES];	// uSec timestamp of the last edge, or of the trip in lockout
 };
 struct swStruct sw;
 
@@ -193,11 +201,14 @@ uint8_t get_switch_type();
  */
 stat_t sw_set_st(nvObj_t *nv);
 stat_t sw_set_sw(nvObj_t *nv);
+stat_t sw_set_sf(nvObj_t *nv);
 
 #ifdef __TEXT_MODE
 	void sw_print_st(nvObj_t *nv);
+	void sw_print_sf(nvObj_t *nv);
 #else
 	#define sw_print_st tx_print_stub
+	#define sw_print_sf tx_print_stub
 #endif // __TEXT_MODE
 
 #endif // End of include guard: SWITCH_H_ONCE
@@ -20,7 +20,14 @@
 #include "tinyg.h"			// #1
 #include "config.h"			// #2
 #include "controller.h"
+#include "canonical_machine.h"
+#include "gcode_parser.h"
+#include "json_parser.h"
+#include "kinematics.h"
 #include "planner.h"
+#include "stepper.h"
+#include "hardware.h"
+#include "report.h"
 #include "test.h"
 #include "util.h"
 #include "xio.h"
@@ -44,6 +51,7 @@
 #include "tests/test_014_microsteps.h"		// test all microstep settings
 #include "tests/test_050_mudflap.h"			// mudflap test - entire drawing
 #include "tests/test_051_braid.h"			// braid test - partial drawing
+#include "tests/test_052_square_pocket.h"	// square pocket - short moves and corners
 
 #endif
 
@@ -51,6 +59,92 @@
 #include "tests/test_099.h"					// diagnostic test file. used to diagnose specific issues
 #endif
 
+/*
+ * CYCLE TIME BENCHMARKS
+ *
+ *	_start_benchmark()	  - arm the benchmark for the test about to run
+ *	bm_record_block()	  - add a dispatched block (called from the controller)
+ *	bm_request_report()	  - stop the clock and request a report (called at program end)
+ *	bm_report_callback()  - send a requested report and disarm
+ *
+ *	Motion time is the SysTick time from the $test command to the end of the program, so
+ *	starved or stalled motion counts against the job. Planner CPU time is the usec the
+ *	controller spent in the parser and planner, summed over the blocks dispatched, and the
+ *	slowest of those is the max block latency. The report is a single JSON line:
+ *	  {"bm":{"t":test,"mt":motion ms,"pt":planner ms,"bl":max block usec,"bk":blocks,"ok":1,"fl":0}}
+ *
+ *	ok is 0 if a result exceeds its baseline by more than BENCH_TOLERANCE percent, and fl
+ *	is a bitmap of the results that failed: 1 motion, 2 planner, 4 block latency. The host
+ *	simulator runs the same corpus with "make regress" (see sim/Makefile).
+ *
+ *	The motion time baselines are the simulator's job times. The CPU baselines are zero,
+ *	which skips the check, until they have been captured on a board.
+ */
+bmSingleton_t bm;
+
+typedef struct bmBaseline {
+	uint32_t motion_time;				// ms
+	uint32_t plan_time;					// ms
+	uint32_t max_block;					// usec
+} bmBaseline_t;
+
+static const bmBaseline_t bm_baseline[] PROGMEM = {
+	{ 71130, 0, 0 },					// 60 mudflap
+	{ 3270, 0, 0 },						// 61 braid
+	{ 86590, 0, 0 }						// 62 square pocket
+};
+
+#ifdef __CANNED_TESTS
+static void _start_benchmark(uint8_t test)
+{
+	memset(&bm, 0, sizeof(bm));
+	bm.test = test;
+	bm.start_time = SysTickTimer_getValue();
+}
+#endif
+
+void bm_record_block(uint32_t start)
+{
+	if (bm.test == 0) return;
+	uint32_t usec = hw_get_usec() - start;
+	bm.plan_time += usec;
+	if (usec > bm.max_block) bm.max_block = usec;
+	bm.blocks++;
+}
+
+void bm_request_report()
+{
+	if (bm.test == 0) return;
+	bm.motion_time = SysTickTimer_getValue() - bm.start_time;
+	bm.report_requested = true;
+}
+
+static bool _bm_exceeds(uint32_t value, uint32_t base)
+{
+	return ((base != 0) && (value > base + (base / 100) * BENCH_TOLERANCE));
+}
+
+stat_t bm_report_callback()				// called by controller dispatcher
+{
+	if (bm.report_requested == false)
+		return (STAT_NOOP);
+	if (rpt_tx_has_room(RPT_PRIORITY_MESSAGE) == false)
+		return (STAT_NOOP);
+
+	bmBaseline_t base;
+	uint8_t fail = 0;
+	uint32_t plan_ms = bm.plan_time / 1000;
+	memcpy_P(&base, &bm_baseline[bm.test - BENCH_TEST_BASE], sizeof(base));
+	if (_bm_exceeds(bm.motion_time, base.motion_time)) fail |= 0x01;
+	if (_bm_exceeds(plan_ms, base.plan_time)) fail |= 0x02;
+	if (_bm_exceeds(bm.max_block, base.max_block)) fail |= 0x04;
+
+	printf_P(PSTR("{\"bm\":{\"t\":%d,\"mt\":%lu,\"pt\":%lu,\"bl\":%lu,\"bk\":%lu,\"ok\":%d,\"fl\":%d}}\n"),
+		bm.test, bm.motion_time, plan_ms, bm.max_block, bm.blocks, (fail == 0), fail);
+	memset(&bm, 0, sizeof(bm));			// disarm - clears the request, too
+	return (STAT_OK);
+}
+
 /*
  * run_test() - system tests from FLASH invoked by $test=n command
  *
@@ -79,6 +173,10 @@ uint8_t run_test(nvObj_t *nv)
 		case 14: { xio_open(XIO_DEV_PGM, PGMFILE(&test_microsteps),PGM_FLAGS); break;}
 		case 50: { xio_open(XIO_DEV_PGM, PGMFILE(&test_mudflap),PGM_FLAGS); break;}
 		case 51: { xio_open(XIO_DEV_PGM, PGMFILE(&test_braid),PGM_FLAGS); break;}
+		case 52: { xio_open(XIO_DEV_PGM, PGMFILE(&test_square_pocket),PGM_FLAGS); break;}
+		case 60: { _start_benchmark(60); xio_open(XIO_DEV_PGM, PGMFILE(&test_mudflap),PGM_FLAGS); break;}
+		case 61: { _start_benchmark(61); xio_open(XIO_DEV_PGM, PGMFILE(&test_braid),PGM_FLAGS); break;}
+		case 62: { _start_benchmark(62); xio_open(XIO_DEV_PGM, PGMFILE(&test_square_pocket),PGM_FLAGS); break;}
 #endif
 #ifdef __TEST_99
 		case 99: { xio_open(XIO_DEV_PGM, PGMFILE(&test_99),PGM_FLAGS); break;}
@@ -92,6 +190,213 @@ uint8_t run_test(nvObj_t *nv)
 	return (STAT_OK);
 }
 
+#ifdef __BENCHMARKS
+/*
+ * MICRO-BENCHMARKS
+ *
+ *	run_bench() - time the hot routines in isolation ($bench)
+ *
+ *	Each routine is called BENCH_CALLS times on fixed inputs and timed with the microsecond
+ *	timebase. The result is the mean CPU cycles per call, including any interrupts that ran
+ *	in between - the machine must be idle, so those are only the timebase and the RTC. The
+ *	report is a single JSON line, sent ahead of the response:
+ *	  {"bench":{"zoid":c,"jvm":c,"seg":c,"prep":c,"kin":c,"gc":c,"json":c,"idx":c,"n":calls}}
+ *
+ *	  zoid	mp_calculate_trapezoid() of a 10 mm line too short to reach its cruise velocity
+ *	  jvm	_get_junction_vmax() at a 90 degree corner
+ *	  seg	_exec_aline_segment() of an XY line body, including kinematics and the stepper prep
+ *	  prep	st_prep_line() of a 4 motor segment
+ *	  kin	ik_kinematics() of an XYZ position
+ *	  gc	gc_gcode_parser() of BENCH_GCODE_BLOCK, a block that sets modes but does not move
+ *	  json	json_serialize() of the status report
+ *	  idx	nv_get_index() of a token halfway down the config table
+ *
+ *	A second line compares the approximation kernels in util.c with the libm routines and the
+ *	division they stand in for, and gives the largest relative error of each in parts per million.
+ *	Both sides are called through a pointer over the same inputs, 0.001 to about 80000:
+ *	  {"bmath":{"sqrt":c,"fsqrt":c,"esqrt":ppm,"cbrt":c,"fcbrt":c,"ecbrt":ppm,"rcp":c,"frcp":c,"ercp":ppm}}
+ *	The zoid and jvm times above use whichever the planner was built with (__APPROX_MATH).
+ *
+ *	The routines that keep state have it put back afterwards - the runtime and stepper prep
+ *	state by mp_bench_exec_segment() and _bench_prep_line(), and the Gcode model by _bench_gcode().
+ *	$bench resets the nvObj list to build the status report, so send it on its own.
+ */
+#define BENCH_CALLS 100
+#define BENCH_GCODE_BLOCK "N1234 G80 G17 G90 G94 F1234.5"
+
+static uint32_t _bench_trapezoid(void)
+{
+	mpBuf_t bf;
+	memset(&bf, 0, sizeof(bf));
+	bf.pv = &bf;
+	bf.length = 10;
+	bf.cruise_vmax = 3000;
+	bf.delta_vmax = 3000;
+	bf.jerk = cm.a[AXIS_X].jerk_max * JERK_MULTIPLIER;
+	bf.recip_jerk = 1/bf.jerk;
+	bf.cbrt_jerk = cbrt(bf.jerk);
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		bf.entry_velocity = 300;						// the requested velocities are changed by rate limited fits
+		bf.cruise_velocity = 3000;
+		bf.exit_velocity = 600;
+		bf.zoid_cruise = 0;								// time the calculation, not the reuse
+		mp_calculate_trapezoid(&bf);
+	}
+	return (hw_get_usec() - start);
+}
+
+static uint32_t _bench_prep_line(void)
+{
+	float travel_steps[MOTORS];
+	float following_error[MOTORS];
+	stPrepMotor_t mot[MOTORS];
+	float dda_residue = st_pre.dda_residue;
+	float dda_frequency = st_pre.dda_frequency;
+	memcpy(mot, st_pre.mot, sizeof(mot));
+	memset(following_error, 0, sizeof(following_error));
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		for (uint8_t motor=0; motor<MOTORS; motor++) {	// st_prep_line() takes up backlash in travel_steps
+			travel_steps[motor] = (motor < 4) ? 10.5 * (motor+1) : 0;
+		}
+		st_prep_line(travel_steps, following_error, 0, NOM_SEGMENT_TIME);
+	}
+	uint32_t usec = hw_get_usec() - start;
+	memcpy(st_pre.mot, mot, sizeof(mot));
+	st_pre.dda_residue = dda_residue;
+	st_pre.dda_frequency = dda_frequency;
+	return (usec);
+}
+
+static uint32_t _bench_kinematics(void)
+{
+	float travel[AXES] = { 12.5, -37.25, 3.125, 0, 0, 0 };
+	float steps[MOTORS];
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		ik_kinematics(travel, steps);
+	}
+	return (hw_get_usec() - start);
+}
+
+static uint32_t _bench_gcode(void)
+{
+	char_t block[] = BENCH_GCODE_BLOCK;
+	GCodeState_t gm = cm.gm;						// the block sets modes in the model
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		gc_gcode_parser(block);
+	}
+	uint32_t usec = hw_get_usec() - start;
+	cm.gm = gm;
+	return (usec);
+}
+
+static uint32_t _bench_json(void)
+{
+	sr_get(NULL);									// populates the nvObj list
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		json_serialize(nv_body, cs.out_buf, sizeof(cs.out_buf));
+	}
+	uint32_t usec = hw_get_usec() - start;
+	nv_reset_nv_list();
+	return (usec);
+}
+
+static uint32_t _bench_get_index(void)
+{
+	volatile index_t sink;
+	index_t target = nv_index_max() / 2;
+	char_t group[GROUP_LEN+1];
+	char_t token[TOKEN_LEN+1];
+	strncpy_P(group, cfgArray[target].group, GROUP_LEN+1);
+	strncpy_P(token, cfgArray[target].token, TOKEN_LEN+1);
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		sink = nv_get_index(group, token);
+	}
+	(void)sink;
+	return (hw_get_usec() - start);
+}
+
+static float _libm_sqrt(float x) { return (sqrt(x));}
+static float _libm_cbrt(float x) { return (cbrt(x));}
+static float _divide_recip(float x) { return (1/x);}
+
+#define BENCH_MATH_START ((float)0.001)
+#define BENCH_MATH_STEP ((float)1.2)
+
+static uint32_t _bench_math(float (*kernel)(float))
+{
+	volatile float sink;
+	float x = BENCH_MATH_START;
+
+	uint32_t start = hw_get_usec();
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		sink = kernel(x);
+		x *= BENCH_MATH_STEP;
+	}
+	(void)sink;
+	return (hw_get_usec() - start);
+}
+
+static float _bench_math_error(float (*kernel)(float), float (*reference)(float))
+{
+	float error = 0;
+	float x = BENCH_MATH_START;
+	for (uint16_t i=0; i<BENCH_CALLS; i++) {
+		error = max(error, fabs(kernel(x) / reference(x) - 1));
+		x *= BENCH_MATH_STEP;
+	}
+	return (error * 1000000);
+}
+
+static float _cycles(uint32_t usec)
+{
+	return ((float)usec * (F_CPU / 1000000) / BENCH_CALLS);
+}
+
+stat_t run_bench(nvObj_t *nv)
+{
+	if ((cm_get_machine_state() == MACHINE_CYCLE) || (cm_get_motion_state() != MOTION_STOP) ||
+		(mp_get_planner_buffers_available() != PLANNER_BUFFER_POOL_SIZE) ||
+		(st_runtime_isbusy() == true) || (mp_shaper_pending() == true) ||
+		(st_pre.seg[st_pre.prep_index].buffer_state != PREP_BUFFER_OWNED_BY_EXEC)) {
+		return (STAT_COMMAND_NOT_ACCEPTED);			// the machine must be idle
+	}
+	nvObj_t request = *nv;							// the status report reuses the nvObj list
+
+	float zoid = _cycles(_bench_trapezoid());
+	float jvm = _cycles(mp_bench_junction_vmax(BENCH_CALLS));
+	float seg = _cycles(mp_bench_exec_segment(BENCH_CALLS));
+	float prep = _cycles(_bench_prep_line());
+	float kin = _cycles(_bench_kinematics());
+	float gc = _cycles(_bench_gcode());
+	float json = _cycles(_bench_json());
+	float idx = _cycles(_bench_get_index());
+
+	printf_P(PSTR("{\"bench\":{\"zoid\":%0.0f,\"jvm\":%0.0f,\"seg\":%0.0f,\"prep\":%0.0f,\"kin\":%0.0f,\"gc\":%0.0f,\"json\":%0.0f,\"idx\":%0.0f,\"n\":%d}}\n"),
+		zoid, jvm, seg, prep, kin, gc, json, idx, BENCH_CALLS);
+	printf_P(PSTR("{\"bmath\":{\"sqrt\":%0.0f,\"fsqrt\":%0.0f,\"esqrt\":%0.2f,\"cbrt\":%0.0f,\"fcbrt\":%0.0f,\"ecbrt\":%0.2f,\"rcp\":%0.0f,\"frcp\":%0.0f,\"ercp\":%0.2f}}\n"),
+		_cycles(_bench_math(_libm_sqrt)), _cycles(_bench_math(fast_sqrt)), _bench_math_error(fast_sqrt, _libm_sqrt),
+		_cycles(_bench_math(_libm_cbrt)), _cycles(_bench_math(fast_cbrt)), _bench_math_error(fast_cbrt, _libm_cbrt),
+		_cycles(_bench_math(_divide_recip)), _cycles(_bench_math(fast_recip)), _bench_math_error(fast_recip, _divide_recip));
+
+	*nv = request;
+	nv->value = BENCH_CALLS;
+	nv->valuetype = TYPE_INTEGER;
+	return (STAT_OK);
+}
+#endif // __BENCHMARKS
+
 /*
  * run_canned_startup() - run a string on startup
  *
@@ -23,6 +23,34 @@
 
 uint8_t run_test(nvObj_t *nv);
 void run_canned_startup(void);
+#ifdef __BENCHMARKS
+stat_t run_bench(nvObj_t *nv);
+#endif
+
+/***** Cycle time benchmarks ******
+ *
+ *	$test=60 and up run a corpus file with the benchmark armed (see test.c). A report with
+ *	the motion time, planner CPU time and slowest block is sent at program end and checked
+ *	against the baseline stored for the test.
+ */
+#define BENCH_TEST_BASE 60				// $test number of the first benchmark
+#define BENCH_TOLERANCE 5				// percent a result may exceed its baseline
+
+typedef struct bmSingleton {
+	uint8_t test;						// $test number of the armed benchmark, 0 if none
+	uint8_t report_requested;
+	uint32_t start_time;				// SysTick when the benchmark was armed
+	uint32_t motion_time;				// ms from arming to program end
+	uint32_t plan_time;					// usec the foreground spent dispatching blocks
+	uint32_t max_block;					// usec of the slowest block
+	uint32_t blocks;					// blocks dispatched
+} bmSingleton_t;
+
+extern bmSingleton_t bm;
+
+void bm_record_block(uint32_t start);
+void bm_request_report(void);
+stat_t bm_report_callback(void);
 
 /***** DEBUG support ******
  *
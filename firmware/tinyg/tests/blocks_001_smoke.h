@@ -0,0 +1,31 @@
+/*
+ * stored block program made by tinyg_sim -b blocks_smoke - see xio_file.h
+ */
+const uint8_t blocks_smoke[] PROGMEM = {
+	7, 'G',0x00,0x00,0x00,0x00, 'G',0x00,0x00,0x88,0x41, 'G',0x00,0x00,0xA8,0x41, 'G',0x00,0x00,0x20,0x42, 'G',0x00,0x00,0x44,0x42, 'G',0x00,0x00,0xA0,0x42, 'G',0x00,0x00,0xB4,0x42,	// G00 G17 G21 G40 G49 G80 G90
+	3, 'M',0x00,0x00,0x40,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m3g4p1
+	3, 'M',0x00,0x00,0xA0,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m5g4p1
+	3, 'M',0x00,0x00,0x80,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m4g4p1
+	3, 'M',0x00,0x00,0x40,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m3g4p1
+	3, 'M',0x00,0x00,0xA0,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m5g4p1
+	3, 'M',0x00,0x00,0xE0,0x40, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m7g4p1
+	3, 'M',0x00,0x00,0x10,0x41, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m9g4p1
+	3, 'M',0x00,0x00,0x00,0x41, 'G',0x00,0x00,0x80,0x40, 'P',0x00,0x00,0x80,0x3F,	// m8g4p1
+	1, 'M',0x00,0x00,0x10,0x41,	// m9
+	4, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0x00,0x00, 'Y',0x00,0x00,0x00,0x00, 'Z',0x00,0x00,0x00,0x00,	// g0x0y0z0
+	2, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0xA0,0x41,	// g00 x20
+	1, 'X',0x00,0x00,0x00,0x00,	// x0
+	1, 'Y',0x00,0x00,0xA0,0x41,	// y20
+	1, 'Y',0x00,0x00,0x00,0x00,	// y0
+	1, 'Z',0x00,0x00,0xA0,0x41,	// z20
+	1, 'Z',0x00,0x00,0x00,0x00,	// z0
+	1, 'A',0x00,0x00,0xA0,0x41,	// a20
+	1, 'A',0x00,0x00,0x00,0x00,	// a0
+	5, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0xA0,0x41, 'Y',0x00,0x00,0xA0,0x41, 'Z',0x00,0x00,0xA0,0x41, 'A',0x00,0x00,0xA0,0x41,	// G00 x20 y20 z20 a20
+	5, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0x00,0x00, 'Y',0x00,0x00,0x00,0x00, 'Z',0x00,0x00,0x00,0x00, 'A',0x00,0x00,0x00,0x00,	// G00 x0 y0 z0 a0
+	6, 'G',0x00,0x00,0x80,0x3F, 'F',0x00,0x00,0xF0,0x41, 'X',0x00,0x00,0x00,0x40, 'Y',0x00,0x00,0x00,0x40, 'Z',0x00,0x00,0x00,0x40, 'A',0x00,0x00,0x00,0x40,	// G01 f30 x2 y2 z2 a2
+	4, 'X',0x00,0x00,0x00,0x00, 'Y',0x00,0x00,0x00,0x00, 'Z',0x00,0x00,0x00,0x00, 'A',0x00,0x00,0x00,0x00,	// x0 y0 z0 a0
+	2, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0x80,0x3F,	// g0x1
+	2, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0x00,0x00,	// g0x0
+	1, 'M',0x00,0x00,0x00,0x40,	// m2
+	0 };
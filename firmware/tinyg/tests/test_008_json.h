@@ -30,6 +30,8 @@ const char test_json[] PROGMEM= "\
 {\"gc\":\"g0x0y0\"}\n\
 {\"gc\":\"g2x0y0i10\"}\n\
 {\"gc\":\"g3x0y0i10\"}\n\
+[{\"gc\":\"g1x10\"},{\"gc\":\"y10\"},{\"gc\":\"x0\"},{\"gc\":\"y0\"}]\n\
+[{\"gc\":\"g0x0y0\"}\n\
 {\"gc\":\"g54\"}\n\
 {\"gc\":\"g0x0y0\"}\n\
 {\"gc\":\"m30\"}";
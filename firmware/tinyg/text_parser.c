@@ -27,6 +27,7 @@
 
 #include "tinyg.h"
 #include "config.h"
+#include "controller.h"
 #include "canonical_machine.h"
 #include "text_parser.h"
 #include "json_parser.h"
@@ -34,6 +35,7 @@
 #include "help.h"
 #include "util.h"
 #include "xio.h"					// for ASCII char definitions
+#include <stdarg.h>					// for text_printf_P()
 
 #ifdef __cplusplus
 extern "C"{
@@ -86,6 +88,12 @@ stat_t text_parser(char_t *str)
 	// parse and execute the command (only processes 1 command per line)
 	ritorno(_text_parser_kernal(str, nv));			// run the parser to decode the command
 	if ((nv->valuetype == TYPE_NULL) || (nv->valuetype == TYPE_PARENT)) {
+		if (nv_index_is_group(nv->index)) {			// group displays are printed by the dump (see config.c)
+			nv_stream_start();
+			nv_stream_add(nv->token);
+			nv_stream_run(nv);
+			return (STAT_OK);
+		}
 		if (nv_get(nv) == STAT_COMPLETE){			// populate value, group values, or run uber-group displays
 			return (STAT_OK);						// return for uber-group displays so they don't print twice
 		}
@@ -125,7 +133,7 @@ static stat_t _text_parser_kernal(char_t *str, nvObj_t *nv)
 		*rd = NUL;									// terminate at end of name
 		strncpy(nv->token, str, TOKEN_LEN);
 		str = ++rd;
-		nv->value = strtof(str, &rd);				// rd used as end pointer
+		nv->value = parse_float(str, &rd);			// rd used as end pointer
 		if (rd != str) {
 			nv->valuetype = TYPE_FLOAT;
 		}
@@ -152,6 +160,7 @@ static stat_t _text_parser_kernal(char_t *str, nvObj_t *nv)
  */
 static const char prompt_ok[] PROGMEM = "tinyg [%s] ok> ";
 static const char prompt_err[] PROGMEM = "tinyg [%s] err: %s: %s ";
+static const char prompt_rx[] PROGMEM = "rx:%d ";	// FLOW_CONTROL_COUNT window, ahead of the prompt
 
 void text_response(const stat_t status, char_t *buf)
 {
@@ -164,16 +173,26 @@ void text_response(const stat_t status, char_t *buf)
 		if (cm_get_buffer_drain_state() == DRAIN_REQUESTED) {
 			return;	// postpone prompt
 		}
-		fprintf_P(stderr, prompt_ok, units);
+		if (nv_stream_active() == true) {
+			return;	// the dump prints it after its last line
+		}
+	}
+#ifdef __AVR
+	if (cfg.enable_flow_control == FLOW_CONTROL_COUNT) {
+		text_printf_P(prompt_rx, xio_get_usb_rx_free());
+	}
+#endif
+	if ((status == STAT_OK) || (status == STAT_EAGAIN) || (status == STAT_NOOP)) {
+		text_printf_P(prompt_ok, units);
 	} else {
-		fprintf_P(stderr, prompt_err, units, get_status_message(status), buf);
+		text_printf_P(prompt_err, units, get_status_message(status), buf);
 	}
 	nvObj_t *nv = nv_body+1;
 
 	if (nv_get_type(nv) == NV_TYPE_MESSAGE) {
-		fprintf(stderr, (char *)*nv->stringp);
+		fputs((char *)*nv->stringp, stderr);
 	}
-	fprintf(stderr, "\n");
+	fputc('\n', stderr);
 }
 
 /***** PRINT FUNCTIONS ********************************************************
@@ -201,15 +220,15 @@ void text_print_inline_pairs(nvObj_t *nv)
 			case TYPE_PARENT: 	{ if ((nv = nv->nx) == NULL) return; continue;} // NULL means parent with no child
 			case TYPE_FLOAT:	{ preprocess_float(nv);
 								  fntoa(global_string_buf, nv->value, nv->precision);
-								  fprintf_P(stderr,PSTR("%s:%s"), nv->token, global_string_buf) ; break;
+								  text_printf_P(PSTR("%s:%s"), nv->token, global_string_buf) ; break;
 								}
-			case TYPE_INTEGER:	{ fprintf_P(stderr,PSTR("%s:%1.0f"), nv->token, nv->value); break;}
-			case TYPE_DATA:	    { fprintf_P(stderr,PSTR("%s:%lu"), nv->token, *v); break;}
-			case TYPE_STRING:	{ fprintf_P(stderr,PSTR("%s:%s"), nv->token, *nv->stringp); break;}
-			case TYPE_EMPTY:	{ fprintf_P(stderr,PSTR("\n")); return; }
+			case TYPE_INTEGER:	{ text_printf_P(PSTR("%s:%1.0f"), nv->token, nv->value); break;}
+			case TYPE_DATA:	    { text_printf_P(PSTR("%s:%lu"), nv->token, *v); break;}
+			case TYPE_STRING:	{ text_printf_P(PSTR("%s:%s"), nv->token, *nv->stringp); break;}
+			case TYPE_EMPTY:	{ fputc('\n', stderr); return; }
 		}
 		if ((nv = nv->nx) == NULL) return;
-		if (nv->valuetype != TYPE_EMPTY) { fprintf_P(stderr,PSTR(","));}
+		if (nv->valuetype != TYPE_EMPTY) { fputc(',', stderr);}
 	}
 }
 
@@ -221,15 +240,15 @@ void text_print_inline_values(nvObj_t *nv)
 			case TYPE_PARENT: 	{ if ((nv = nv->nx) == NULL) return; continue;} // NULL means parent with no child
 			case TYPE_FLOAT:	{ preprocess_float(nv);
 								  fntoa(global_string_buf, nv->value, nv->precision);
-								  fprintf_P(stderr,PSTR("%s"), global_string_buf) ; break;
+								  fputs((char *)global_string_buf, stderr); break;
 								}
-			case TYPE_INTEGER:	{ fprintf_P(stderr,PSTR("%1.0f"), nv->value); break;}
-			case TYPE_DATA:	    { fprintf_P(stderr,PSTR("%lu"), *v); break;}
-			case TYPE_STRING:	{ fprintf_P(stderr,PSTR("%s"), *nv->stringp); break;}
-			case TYPE_EMPTY:	{ fprintf_P(stderr,PSTR("\n")); return; }
+			case TYPE_INTEGER:	{ text_printf_P(PSTR("%1.0f"), nv->value); break;}
+			case TYPE_DATA:	    { text_printf_P(PSTR("%lu"), *v); break;}
+			case TYPE_STRING:	{ fputs((char *)*nv->stringp, stderr); break;}
+			case TYPE_EMPTY:	{ fputc('\n', stderr); return; }
 		}
 		if ((nv = nv->nx) == NULL) return;
-		if (nv->valuetype != TYPE_EMPTY) { fprintf_P(stderr,PSTR(","));}
+		if (nv->valuetype != TYPE_EMPTY) { fputc(',', stderr);}
 	}
 }
 
@@ -245,6 +264,88 @@ void text_print_multiline_formatted(nvObj_t *nv)
 	}
 }
 
+/*
+ * text_printf_P() - lightweight fprintf_P(stderr, ...) for the text mode printers
+ *
+ *	avr-libc fprintf_P runs every char through the stdio FILE layer and formats floats
+ *	with its own slow %f conversion, which made $ listings and text status reports take
+ *	milliseconds per line. The print formats only use %s, %c, %d, %u, %lu and %f with
+ *	an optional '-', width and precision (and %%), so they are expanded here with intoa(),
+ *	uintoa() and fntoa() into cs.out_buf - the buffer the JSON serializer writes into -
+ *	and sent with a single fputs(). The arguments are the same as for fprintf_P. Any
+ *	other conversion is copied out as written, without consuming an argument.
+ */
+#define TEXT_NUMBER_LEN 48					// fntoa() falls back to sprintf() beyond 32 bits
+
+void text_printf_P(const char *format, ...)
+{
+	char_t *wr = cs.out_buf;
+	char_t *end = cs.out_buf + OUTPUT_BUFFER_LEN - 1;
+	char_t number[TEXT_NUMBER_LEN];
+	va_list ap;
+	char c;
+
+	va_start(ap, format);
+	while (((c = GET_FORMAT_BYTE(format++)) != NUL) && (wr < end)) {
+		if (c != '%') {
+			*wr++ = c;
+			continue;
+		}
+		const char *conversion = format;	// first char after the '%'
+		uint8_t left = false;
+		uint8_t width = 0;
+		int8_t precision = -1;
+		uint8_t is_long = false;
+		if ((c = GET_FORMAT_BYTE(format)) == '-') {
+			left = true;
+			c = GET_FORMAT_BYTE(++format);
+		}
+		while ((c >= '0') && (c <= '9')) {
+			width = width * 10 + (c - '0');
+			c = GET_FORMAT_BYTE(++format);
+		}
+		if (c == '.') {
+			precision = 0;
+			while (((c = GET_FORMAT_BYTE(++format)) >= '0') && (c <= '9')) {
+				precision = precision * 10 + (c - '0');
+			}
+		}
+		if (c == 'l') {
+			is_long = true;
+			c = GET_FORMAT_BYTE(++format);
+		}
+		format++;							// past the conversion char
+
+		const char_t *value = number;
+		uint8_t len;
+		switch (c) {
+			case 'd': case 'i': { len = intoa(number, is_long ? va_arg(ap, int32_t) : va_arg(ap, int)); break;}
+			case 'u': { len = uintoa(number, is_long ? va_arg(ap, uint32_t) : va_arg(ap, unsigned int)); break;}
+			case 'c': { number[0] = (char_t)va_arg(ap, int); number[1] = NUL; len = 1; break;}
+			case 'f': { len = fntoa(number, (float)va_arg(ap, double), (precision < 0) ? 6 : precision); break;}
+			case 's': {
+				if ((value = va_arg(ap, const char_t *)) == NULL) { value = (const char_t *)"";}
+				len = strlen((const char *)value);
+				break;
+			}
+			case '%': { *wr++ = '%'; continue;}
+			default: {						// not one we know - copy it out as written
+				*wr++ = '%';
+				format = conversion;
+				continue;
+			}
+		}
+		if (left == false) {
+			for (; (len < width) && (wr < end); width--) { *wr++ = ' ';}
+		}
+		for (uint8_t i=0; (i < len) && (wr < end); i++) { *wr++ = value[i];}
+		for (; (len < width) && (wr < end); width--) { *wr++ = ' ';}
+	}
+	va_end(ap);
+	*wr = NUL;
+	fputs((char *)cs.out_buf, stderr);
+}
+
 /*
  * Text print primitives using generic formats
  */
@@ -265,15 +366,15 @@ void tx_print_flt(nvObj_t *nv) { text_print_flt(nv, fmt_flt);}
  *	NOTE: format's are passed in as flash strings (PROGMEM)
  */
 
-void text_print_nul(nvObj_t *nv, const char *format) { fprintf_P(stderr, format);}	// just print the format string
-void text_print_str(nvObj_t *nv, const char *format) { fprintf_P(stderr, format, *nv->stringp);}
-void text_print_ui8(nvObj_t *nv, const char *format) { fprintf_P(stderr, format, (uint8_t)nv->value);}
-void text_print_int(nvObj_t *nv, const char *format) { fprintf_P(stderr, format, (uint32_t)nv->value);}
-void text_print_flt(nvObj_t *nv, const char *format) { fprintf_P(stderr, format, nv->value);}
+void text_print_nul(nvObj_t *nv, const char *format) { text_printf_P(format);}	// just print the format string
+void text_print_str(nvObj_t *nv, const char *format) { text_printf_P(format, *nv->stringp);}
+void text_print_ui8(nvObj_t *nv, const char *format) { text_printf_P(format, (uint8_t)nv->value);}
+void text_print_int(nvObj_t *nv, const char *format) { text_printf_P(format, (uint32_t)nv->value);}
+void text_print_flt(nvObj_t *nv, const char *format) { text_printf_P(format, nv->value);}
 
 void text_print_flt_units(nvObj_t *nv, const char *format, const char *units)
 {
-	fprintf_P(stderr, format, nv->value, units);
+	text_printf_P(format, nv->value, units);
 }
 
 /*
@@ -80,6 +80,7 @@ extern txtSingleton_t txt;
 	void text_print_int(nvObj_t *nv, const char *format);
 	void text_print_flt(nvObj_t *nv, const char *format);
 	void text_print_flt_units(nvObj_t *nv, const char *format, const char *units);
+	void text_printf_P(const char *format, ...);
 
 	void tx_print_tv(nvObj_t *nv);
 
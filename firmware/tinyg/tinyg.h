@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -58,16 +59,27 @@
 #define __STEP_CORRECTION
 //#define __NEW_SWITCHES					// Using v9 style switch code
 //#define __JERK_EXEC						// Use computed jerk (versus forward difference based exec)
-//#define __KAHAN							// Use Kahan summation in aline exec functions
+#define __FIXED_FORWARD_DIFFS				// Use Q32.32 fixed point forward differences in aline exec (AVR)
 
 #define __TEXT_MODE							// enables text mode	(~10Kb)
 #define __HELP_SCREENS						// enables help screens (~3.5Kb)
 #define __CANNED_TESTS 						// enables $tests 		(~12Kb)
 #define __TEST_99 							// enables diagnostic test 99 (independent of other tests)
+#define __STORED_PROGRAMS					// enables the stored block programs run by O<n> call (see xio_file.h)
+#define __APPROX_MATH						// planner roots and reciprocals by the table seeded kernels in util.c instead of libm
+#define __BENCHMARKS						// enables the $bench micro-benchmarks of the hot routines (see test.c)
+//#define __XIO_SPI_SLAVE					// runs SPI channel 1 as a DMA slave of an embedded host and makes it stdin/out (see xio_spi.h)
+//#define __PLAN_ISR						// plans feedholds in the PendSV interrupt instead of the controller loop (see stepper.c). ARM only
 
 /****** DEVELOPMENT SETTINGS ******/
 
 #define __DIAGNOSTIC_PARAMETERS				// enables system diagnostic parameters (_xx) in config_app
+#define __PERF_COUNTERS						// enables the performance counter registry (pf group, see perf.h)
+//#define __ISR_TIMING						// enables stepper ISR and exec cycle accounting (_t? groups). AVR only
+//#define __ENCODER_QDEC					// enables the quadrature encoder input on PORTB; takes the PWM2 timer. AVR only
+//#define __ANALOG							// samples the analog inputs on PORTB by DMA (see analog.h). AVR only
+//#define __STEP_PULSE_COMPARE				// times step pulses with the DDA timer's compare A interrupt. AVR only
+//#define __TASK_TIMING						// enables controller task run time accounting ($_tsk)
 //#define __DEBUG_SETTINGS					// special settings. See settings.h
 //#define __CANNED_STARTUP					// run any canned startup moves
 
@@ -98,6 +110,12 @@ typedef char char_t;			// ARM/C++ version uses uint8_t as char_t
 #define GET_TABLE_FLOAT(a) pgm_read_float(&cfgArray[nv->index].a)	// get float value from cfgArray
 #define GET_TOKEN_BYTE(a)  (char_t)pgm_read_byte(&cfgArray[i].a)	// get token byte value from cfgArray
 
+// copy a whole cfgArray entry to RAM in one sequential flash read - cheaper than field by field
+#define GET_TABLE_ITEM(i,item) memcpy_P(item, &cfgArray[(index_t)i], sizeof(cfgItem_t))
+
+// get a char from a format string in PGM
+#define GET_FORMAT_BYTE(p) (char)pgm_read_byte(p)
+
 // populate the shared buffer with the token string given the index
 #define GET_TOKEN_STRING(i,a) strcpy_P(a, (char *)&cfgArray[(index_t)i].token);
 
@@ -108,9 +126,15 @@ typedef char char_t;			// ARM/C++ version uses uint8_t as char_t
 #define GET_UNITS(a) strncpy_P(global_string_buf,(const char *)pgm_read_word(&msg_units[cm_get_units_mode(a)]), MESSAGE_LEN-1)
 
 // IO settings
+#ifndef __XIO_SPI_SLAVE
 #define STD_IN 	XIO_DEV_USB		// default IO settings
 #define STD_OUT	XIO_DEV_USB
 #define STD_ERR	XIO_DEV_USB
+#else
+#define STD_IN 	XIO_DEV_SPI1	// the embedded host is on the SPI slave channel
+#define STD_OUT	XIO_DEV_SPI1
+#define STD_ERR	XIO_DEV_SPI1
+#endif
 
 // String compatibility
 #define strtof strtod			// strtof is not in the AVR lib
@@ -121,6 +145,7 @@ typedef char char_t;			// ARM/C++ version uses uint8_t as char_t
  * ARM Compatibility *
  *********************/
 #ifdef __ARM
+#undef __FIXED_FORWARD_DIFFS			// the ARM FPU makes float forward differences cheaper
 								// Use macros to fake out AVR's PROGMEM and other AVRisms.
 #define PROGMEM					// ignore PROGMEM declarations in ARM/GCC++
 #define PSTR (const char *)		// AVR macro is: PSTR(s) ((const PROGMEM char *)(s))
@@ -134,6 +159,8 @@ typedef char char_t;			// In the ARM/GCC++ version char_t is typedef'd to uint8_
 #define GET_TABLE_BYTE(a)  cfgArray[nv->index].a	// get byte value from cfgArray
 #define GET_TABLE_FLOAT(a) cfgArray[nv->index].a	// get byte value from cfgArray
 #define GET_TOKEN_BYTE(i,a) (char_t)cfgArray[i].a	// get token byte value from cfgArray
+#define GET_TABLE_ITEM(i,item) memcpy(item, &cfgArray[(index_t)i], sizeof(cfgItem_t))
+#define GET_FORMAT_BYTE(p) (*(p))
 
 #define GET_TOKEN_STRING(i,a) cfgArray[(index_t)i].a
 //#define GET_TOKEN_STRING(i,a) (char_t)cfgArray[i].token)// populate the token string given the index
@@ -176,6 +203,7 @@ typedef char char_t;			// In the ARM/GCC++ version char_t is typedef'd to uint8_
 #define fprintf_P fprintf	// just sayin'
 #define sprintf_P sprintf
 #define strcpy_P strcpy
+#define memcpy_P memcpy
 
 #endif // __ARM
 
@@ -192,10 +220,17 @@ typedef uint16_t magic_t;		// magic number size
 #define AXES		6			// number of axes supported in this version
 #define HOMING_AXES	4			// number of axes that can be homed (assumes Zxyabc sequence)
 #define MOTORS		4			// number of motors on the board
+#ifndef ACTIVE_MOTORS
+#define ACTIVE_MOTORS MOTORS		// motors the step ISR, prep and kinematics handle (1-MOTORS)
+#endif
+#if (ACTIVE_MOTORS < 1) || (ACTIVE_MOTORS > MOTORS)
+#error ACTIVE_MOTORS must be between 1 and MOTORS
+#endif
 #define COORDS		6			// number of supported coordinate systems (1-6)
+#define TOOLS		4			// number of tool table entries (1-4)
 #define PWMS		2			// number of supported PWM channels
 
-// Note: If you change COORDS you must adjust the entries in cfgArray table in config.c
+// Note: If you change COORDS or TOOLS you must adjust the entries in cfgArray table in config.c
 
 #define AXIS_X		0
 #define AXIS_Y		1
@@ -390,8 +425,8 @@ char *get_status_message(stat_t status);
 #define	STAT_JSON_SYNTAX_ERROR 111              // JSON input string is not well formed
 #define	STAT_JSON_TOO_MANY_PAIRS 112            // JSON input string has too many JSON pairs
 #define	STAT_JSON_TOO_LONG 113					// JSON input or output exceeds buffer size
-#define	STAT_ERROR_114 114
-#define	STAT_ERROR_115 115
+#define	STAT_GCODE_FRAME_MALFORMED 114			// binary Gcode frame is not well formed
+#define	STAT_GCODE_FRAME_CRC_ERROR 115			// binary Gcode frame failed its CRC check
 #define	STAT_ERROR_116 116
 #define	STAT_ERROR_117 117
 #define	STAT_ERROR_118 118
@@ -466,22 +501,22 @@ char *get_status_message(stat_t status);
 #define STAT_T_WORD_IS_MISSING 178
 #define STAT_T_WORD_IS_INVALID 179
 
-#define	STAT_ERROR_180 180									// reserved for Gcode errors
-#define	STAT_ERROR_181 181
-#define	STAT_ERROR_182 182
-#define	STAT_ERROR_183 183
-#define	STAT_ERROR_184 184
-#define	STAT_ERROR_185 185
-#define	STAT_ERROR_186 186
-#define	STAT_ERROR_187 187
-#define	STAT_ERROR_188 188
-#define	STAT_ERROR_189 189
-
-#define	STAT_ERROR_190 190
-#define	STAT_ERROR_191 191
-#define	STAT_ERROR_192 192
-#define	STAT_ERROR_193 193
-#define	STAT_ERROR_194 194
+#define STAT_O_WORD_IS_INVALID 180						// malformed, unsupported or out of place O word statement
+#define STAT_O_WORD_CACHE_FULL 181						// subroutine or loop does not fit in the block cache
+#define STAT_O_WORD_NOT_DEFINED 182						// call to a subroutine that has not been defined
+#define STAT_SPLINE_SPECIFICATION_ERROR 183				// G5, G5.1 spline specification error
+#define STAT_TRANSFORM_SPECIFICATION_ERROR 184			// G68, G51 or a move under them is not specified correctly
+#define STAT_SPINDLE_SYNC_SPECIFICATION_ERROR 185		// G33, G33.1 pitch missing or too fast for the axes
+#define STAT_LINE_RESEND 186							// numbered line missed or corrupted - resend requested
+#define STAT_CONFIG_SNAPSHOT_ERROR 187					// config snapshot import is corrupt or out of sequence
+#define STAT_CUTTER_COMPENSATION_MOTION_INVALID 188	// motion mode other than G0 or G1 under G41, G42
+#define STAT_CUTTER_COMPENSATION_GOUGE 189				// G41, G42 inside corner is too tight for the cutter
+
+#define STAT_EXPRESSION_SYNTAX_ERROR 190				// malformed [expression] or #parameter
+#define STAT_EXPRESSION_TOO_COMPLEX 191				// expression is too long or nested too deep
+#define STAT_EXPRESSION_MATH_ERROR 192					// divide by zero or argument out of range
+#define STAT_PARAMETER_INVALID 193						// parameter number not known, read only, or no free name
+#define STAT_PARAMETER_UNDEFINED 194					// named parameter read before it was set
 #define	STAT_ERROR_195 195
 #define	STAT_ERROR_196 196
 #define	STAT_ERROR_197 197
@@ -496,8 +531,8 @@ char *get_status_message(stat_t status);
 #define	STAT_MACHINE_ALARMED 203						// machine is alarmed. Command not processed
 #define	STAT_LIMIT_SWITCH_HIT 204						// a limit switch was hit causing shutdown
 #define	STAT_PLANNER_FAILED_TO_CONVERGE 205				// trapezoid generator can through this exception
-#define	STAT_ERROR_206 206
-#define	STAT_ERROR_207 207
+#define	STAT_FOLLOWING_ERROR_EXCEEDED 206				// a motor's following error exceeded its limit
+#define	STAT_NETWORK_FRAME_LOST 207						// a network slave lost a frame from the master
 #define	STAT_ERROR_208 208
 #define	STAT_ERROR_209 209
 
@@ -157,10 +157,119 @@ float max4(float x1, float x2, float x3, float x4)
 	return (max);
 }
 
+/* Approximation kernels for the planner's roots and reciprocals
+ * 	fast_sqrt()	 - square root of x, 0 for x <= 0
+ * 	fast_cbrt()	 - cube root of x
+ * 	fast_recip() - reciprocal of x, x != 0
+ *
+ *	x is split into its exponent and its mantissa. The top FAST_MATH_SEED_BITS of the mantissa
+ *	index a table of starting values, the exponent scales the start directly in the float's
+ *	exponent field, and FAST_MATH_ITERATIONS Newton steps refine it. The steps work on the
+ *	reciprocal (square or cube) root so they only multiply - soft-float division and the libm
+ *	sqrt(), cbrt() and pow() are several times slower on the xmega. The seeds are good to about
+ *	3%, one step to about 0.1% and two steps to about 1 part in 10^6. The planner uses them in place
+ *	of libm when __APPROX_MATH is defined (see planner.h); $bench reports both (see test.c).
+ *
+ *	Infinite, NaN and denormal inputs are not handled. Nothing the planner passes in is one.
+ */
+
+typedef union {
+	float f;
+	uint32_t i;
+} floatBits_t;
+
+#define FAST_MATH_SEED_BITS 4
+#define FAST_MATH_SEEDS (1 << FAST_MATH_SEED_BITS)
+#define _mantissa_index(i) ((uint8_t)(((i) >> (23 - FAST_MATH_SEED_BITS)) & (FAST_MATH_SEEDS-1)))
+#define _exponent(i) ((int16_t)(((i) >> 23) & 0xFF) - 127)
+
+// 1/sqrt(m) for m in [1,4), 1/cbrt(m) for m in [1,8) and 1/m for m in [1,2), in 1/16 octave steps
+static const float PROGMEM rsqrt_seed[2*FAST_MATH_SEEDS] = {
+	0.98484500, 0.95628049, 0.93006605, 0.90589609,
+	0.88351792, 0.86272052, 0.84332611, 0.82518370,
+	0.80816412, 0.79215611, 0.77706327, 0.76280160,
+	0.74929748, 0.73648614, 0.72431030, 0.71271909,
+	0.69639058, 0.67619242, 0.65765601, 0.64056527,
+	0.62474151, 0.61003553, 0.59632161, 0.58349299,
+	0.57145833, 0.56013896, 0.54946671, 0.53938218,
+	0.52983333, 0.52077435, 0.51216473, 0.50396850
+};
+
+static const float PROGMEM rcbrt_seed[3*FAST_MATH_SEEDS] = {
+	0.98989624, 0.97065907, 0.95283568, 0.93625365,
+	0.92076914, 0.90626097, 0.89262625, 0.87977690,
+	0.86763701, 0.85614073, 0.84523061, 0.83485628,
+	0.82497330, 0.81554235, 0.80652844, 0.79790031,
+	0.78568117, 0.77041261, 0.75626618, 0.74310502,
+	0.73081495, 0.71929981, 0.70847793, 0.69827939,
+	0.68864395, 0.67951934, 0.67085998, 0.66262587,
+	0.65478175, 0.64729639, 0.64014204, 0.63329390,
+	0.62359556, 0.61147690, 0.60024886, 0.58980284,
+	0.58004821, 0.57090864, 0.56231930, 0.55422472,
+	0.54657706, 0.53933486, 0.53246192, 0.52592650,
+	0.51970062, 0.51375949, 0.50808108, 0.50264570
+};
+
+static const float PROGMEM recip_seed[FAST_MATH_SEEDS] = {
+	0.96969697, 0.91428571, 0.86486486, 0.82051282,
+	0.78048780, 0.74418605, 0.71111111, 0.68085106,
+	0.65306122, 0.62745098, 0.60377358, 0.58181818,
+	0.56140351, 0.54237288, 0.52459016, 0.50793651
+};
+
+static float _seed(const float *table, uint8_t index, int16_t exponent)
+{
+	floatBits_t seed;
+	seed.f = pgm_read_float(&table[index]);
+	seed.i += (int32_t)exponent << 23;				// times 2^exponent
+	return (seed.f);
+}
+
+float fast_sqrt(float x)
+{
+	if (x <= 0) { return (0);}
+	floatBits_t bits = { .f = x };
+	int16_t exponent = _exponent(bits.i);
+	uint8_t odd = exponent & 1;						// x = (m * 2^odd) * 2^(exponent-odd)
+	float y = _seed(rsqrt_seed, (odd << FAST_MATH_SEED_BITS) | _mantissa_index(bits.i), -(exponent - odd) / 2);
+
+	for (uint8_t i=0; i<FAST_MATH_ITERATIONS; i++) {
+		y = y * (1.5 - 0.5 * x * y * y);
+	}
+	return (x * y);
+}
+
+float fast_cbrt(float x)
+{
+	if (x == 0) { return (0);}
+	floatBits_t bits = { .f = fabs(x) };
+	int16_t exponent = _exponent(bits.i);
+	int16_t third = (exponent >= 0) ? (exponent / 3) : -((2 - exponent) / 3);	// rounded down
+	uint8_t rest = exponent - 3 * third;			// x = (m * 2^rest) * 2^(3*third)
+	float y = _seed(rcbrt_seed, (rest << FAST_MATH_SEED_BITS) | _mantissa_index(bits.i), -third);
+
+	for (uint8_t i=0; i<FAST_MATH_ITERATIONS; i++) {
+		y = y * (1.33333333 - 0.33333333 * bits.f * y * y * y);
+	}
+	return (copysign(bits.f * y * y, x));
+}
+
+float fast_recip(float x)
+{
+	floatBits_t bits = { .f = fabs(x) };
+	float y = _seed(recip_seed, _mantissa_index(bits.i), -_exponent(bits.i));
+
+	for (uint8_t i=0; i<FAST_MATH_ITERATIONS; i++) {
+		y = y * (2 - bits.f * y);
+	}
+	return (copysign(y, x));
+}
+
 
 /**** String utilities ****
  * strcpy_U() 	   - strcpy workalike to get around initial NUL for blank string - possibly wrong
  * isnumber() 	   - isdigit that also accepts plus, minus, and decimal point
+ * parse_float()   - fast strtof() workalike
  * escape_string() - add escapes to a string - currently for quotes only
  */
 
@@ -218,10 +327,112 @@ char_t *pstr2str(const char *pgm_string)
 }
 
 /*
+ * parse_float() - fast strtof() workalike for Gcode and JSON numbers
+ *
+ *	Accepts leading whitespace, an optional sign, digits with an optional decimal point
+ *	and an optional exponent. The digits are accumulated in an integer mantissa which is
+ *	scaled once from a power of ten table, so only one or two float operations are done.
+ *	Digits past the 9th significant one are dropped - a float only holds about 7.
+ *	There is no locale, hex, inf or nan handling. Sets end past the last char used, or
+ *	to str if there was no number (in which case 0 is returned), same as strtof().
+ */
+static const float pow10_table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+#define POW10_TABLE_MAX 10
+#define MANTISSA_MAX 100000000			// stop accumulating beyond 9 digits
+
+float parse_float(const char_t *str, char_t **end)
+{
+	const char_t *rd = str;
+	uint32_t mantissa = 0;
+	int16_t exponent = 0;
+	uint8_t digits = 0;
+	uint8_t negative = false;
+
+	while (isspace(*rd)) { rd++; }
+	if (*rd == '-') { negative = true; rd++; }
+	else if (*rd == '+') { rd++; }
+
+	for (; isdigit(*rd); rd++, digits++) {			// integer part
+		if (mantissa < MANTISSA_MAX) { mantissa = mantissa * 10 + (*rd - '0'); }
+		else { exponent++; }
+	}
+	if (*rd == '.') {								// fraction
+		for (rd++; isdigit(*rd); rd++, digits++) {
+			if (mantissa < MANTISSA_MAX) { mantissa = mantissa * 10 + (*rd - '0'); exponent--; }
+		}
+	}
+	if (digits == 0) {								// no number here
+		if (end != NULL) { *end = (char_t *)str; }
+		return (0);
+	}
+	if ((*rd == 'e') || (*rd == 'E')) {				// exponent - only taken if it has digits
+		const char_t *ex = rd+1;
+		int16_t exp_value = 0;
+		uint8_t exp_negative = false;
+		if (*ex == '-') { exp_negative = true; ex++; }
+		else if (*ex == '+') { ex++; }
+		if (isdigit(*ex)) {
+			for (; isdigit(*ex); ex++) {
+				if (exp_value < 1000) { exp_value = exp_value * 10 + (*ex - '0'); }
+			}
+			exponent += (exp_negative ? -exp_value : exp_value);
+			rd = ex;
+		}
+	}
+	if (end != NULL) { *end = (char_t *)rd; }
+
+	float value = (float)mantissa;
+	if (mantissa != 0) {
+		while (exponent > POW10_TABLE_MAX) { value *= pow10_table[POW10_TABLE_MAX]; exponent -= POW10_TABLE_MAX; }
+		while (exponent < -POW10_TABLE_MAX) { value /= pow10_table[POW10_TABLE_MAX]; exponent += POW10_TABLE_MAX; }
+		if (exponent > 0) { value *= pow10_table[exponent]; }
+		else if (exponent < 0) { value /= pow10_table[-exponent]; }	// divide - 1e-n isn't exact
+	}
+	return (negative ? -value : value);
+}
+
+/*
+ * intoa() - return ASCII string given an integer
+ * uintoa() - return ASCII string given an unsigned integer
  * fntoa() - return ASCII string given a float and a decimal precision value
  *
- *	Returns length of string, less the terminating NUL character
+ *	Both return length of string, less the terminating NUL character
+ *
+ *	fntoa() splits the value into integer and fraction parts, scales the fraction by
+ *	10^precision and rounds it, then writes both parts as integers. That costs one float
+ *	multiply and some integer divides instead of a printf. Values that don't fit in 32
+ *	bits fall back to sprintf(). A value that rounds to zero is written without a sign. Precisions
+ *	over 7 are written with 6 places, as "%f" would.
  */
+#define FNTOA_INTEGER_MAX ((float)4294967040.0)	// largest float below 2^32
+
+static char_t _utoa(char_t *str, uint32_t n, uint8_t min_digits)
+{
+	char_t digits[10];
+	uint8_t len = 0;
+	do {
+		digits[len++] = '0' + (n % 10);
+		n /= 10;
+	} while ((n != 0) || (len < min_digits));
+	for (uint8_t i=0; i<len; i++) { str[i] = digits[len-1-i]; }
+	str[len] = 0;								// NUL
+	return (len);
+}
+
+char_t intoa(char_t *str, int32_t n)
+{
+	if (n < 0) {
+		*str = '-';
+		return (_utoa(str+1, (uint32_t)(-(n+1)) + 1, 1) + 1);	// -(n+1) can't overflow
+	}
+	return (_utoa(str, (uint32_t)n, 1));
+}
+
+char_t uintoa(char_t *str, uint32_t n)
+{
+	return (_utoa(str, n, 1));
+}
+
 char_t fntoa(char_t *str, float n, uint8_t precision)
 {
     // handle special cases
@@ -232,37 +443,141 @@ char_t fntoa(char_t *str, float n, uint8_t precision)
 	} else if (isinf(n)) {
 		strcpy(str, "inf");
 		return (3);
+	}
+	if (precision > 7) { precision = 6; }
 
-	} else if (precision == 0 ) { return((char_t)sprintf((char *)str, "%0.0f", (double) n));
-	} else if (precision == 1 ) { return((char_t)sprintf((char *)str, "%0.1f", (double) n));
-	} else if (precision == 2 ) { return((char_t)sprintf((char *)str, "%0.2f", (double) n));
-	} else if (precision == 3 ) { return((char_t)sprintf((char *)str, "%0.3f", (double) n));
-	} else if (precision == 4 ) { return((char_t)sprintf((char *)str, "%0.4f", (double) n));
-	} else if (precision == 5 ) { return((char_t)sprintf((char *)str, "%0.5f", (double) n));
-	} else if (precision == 6 ) { return((char_t)sprintf((char *)str, "%0.6f", (double) n));
-	} else if (precision == 7 ) { return((char_t)sprintf((char *)str, "%0.7f", (double) n));
-	} else					    { return((char_t)sprintf((char *)str, "%f", (double) n)); }
+	float magnitude = fabs(n);
+	if (magnitude >= FNTOA_INTEGER_MAX) {
+		return((char_t)sprintf((char *)str, "%0.*f", precision, (double) n));
+	}
+	uint32_t integer = (uint32_t)magnitude;
+	uint32_t scale = (uint32_t)pow10_table[precision];
+	uint32_t fraction = (uint32_t)((magnitude - integer) * scale + 0.5);	// the subtraction is exact
+	if (fraction >= scale) {							// rounded up into the integer
+		fraction -= scale;
+		integer++;
+	}
+	char_t *wr = str;
+	if ((n < 0) && ((integer | fraction) != 0)) { *wr++ = '-'; }
+	wr += _utoa(wr, integer, 1);
+	if (precision != 0) {
+		*wr++ = '.';
+		wr += _utoa(wr, fraction, precision);
+	}
+	return ((char_t)(wr - str));
 }
 
 /*
  * compute_checksum() - calculate the checksum for a string
+ * update_checksum()  - continue the hash over more of the string (take % HASHMASK at the end)
  *
  *	Stops calculation on null termination or length value if non-zero.
+ *	This is a single pass - the string is not measured first - and 31*h is done as a
+ *	shift and subtract, which is cheaper than a 32 bit multiply on the AVR.
  *
  * 	This is based on the the Java hashCode function.
  *	See http://en.wikipedia.org/wiki/Java_hashCode()
  */
-#define HASHMASK 9999
-
 uint16_t compute_checksum(char_t const *string, const uint16_t length)
 {
-	uint32_t h = 0;
-	uint16_t len = strlen(string);
-	if (length != 0) len = min(len, length);
-    for (uint16_t i=0; i<len; i++) {
-		h = 31 * h + string[i];
-    }
-    return (h % HASHMASK);
+	return (update_checksum(0, string, length) % HASHMASK);
+}
+
+uint32_t update_checksum(uint32_t h, char_t const *string, const uint16_t length)
+{
+	for (uint16_t i=0; (string[i] != 0) && ((length == 0) || (i < length)); i++) {
+		h = (h << 5) - h + string[i];
+	}
+	return (h);
+}
+
+/*
+ * compute_crc16() - calculate the CRC-16/CCITT of a byte buffer
+ * update_crc16()  - continue a CRC-16/CCITT over more bytes (for data that arrives in pieces)
+ *
+ *	Polynomial 0x1021, initial value 0xFFFF, no reflection or final XOR (a.k.a CCITT-FALSE).
+ *	Works a byte at a time without a lookup table.
+ */
+uint16_t compute_crc16(const uint8_t *buf, const uint16_t length)
+{
+	return (update_crc16(0xFFFF, buf, length));
+}
+
+uint16_t update_crc16(uint16_t crc, const uint8_t *buf, const uint16_t length)
+{
+	for (uint16_t i=0; i<length; i++) {
+		uint8_t x = (crc >> 8) ^ buf[i];
+		x ^= x >> 4;
+		crc = (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ (uint16_t)x;
+	}
+	return (crc);
+}
+
+/*
+ * base64_encode() - encode bytes as padded base64 (NUL terminated), returns the string length
+ * base64_decode() - decode a base64 string, returns the byte count or -1 if it isn't base64
+ *
+ *	Standard alphabet (A-Z, a-z, 0-9, +, /), without a lookup table. The decoder only takes
+ *	whole 4 character groups, so data sent in pieces must be split on multiples of 3 bytes.
+ */
+static char_t _base64_char(uint8_t v)
+{
+	if (v < 26) return ('A' + v);
+	if (v < 52) return ('a' + v - 26);
+	if (v < 62) return ('0' + v - 52);
+	return ((v == 62) ? '+' : '/');
+}
+
+static int8_t _base64_value(char_t c)
+{
+	if ((c >= 'A') && (c <= 'Z')) return (c - 'A');
+	if ((c >= 'a') && (c <= 'z')) return (c - 'a' + 26);
+	if ((c >= '0') && (c <= '9')) return (c - '0' + 52);
+	if (c == '+') return (62);
+	if (c == '/') return (63);
+	return (-1);
+}
+
+uint16_t base64_encode(char_t *dst, const uint8_t *src, const uint16_t length)
+{
+	uint16_t j = 0;
+	for (uint16_t i=0; i<length; i+=3) {
+		uint32_t group = (uint32_t)src[i] << 16;
+		if (i+1 < length) group |= (uint32_t)src[i+1] << 8;
+		if (i+2 < length) group |= src[i+2];
+		dst[j++] = _base64_char((group >> 18) & 0x3F);
+		dst[j++] = _base64_char((group >> 12) & 0x3F);
+		dst[j++] = (i+1 < length) ? _base64_char((group >> 6) & 0x3F) : '=';
+		dst[j++] = (i+2 < length) ? _base64_char(group & 0x3F) : '=';
+	}
+	dst[j] = 0;										// NUL
+	return (j);
+}
+
+int16_t base64_decode(uint8_t *dst, const char_t *src)
+{
+	uint16_t length = strlen((const char *)src);
+	int16_t j = 0;
+
+	if ((length & 3) != 0) return (-1);
+	for (uint16_t i=0; i<length; i+=4) {
+		uint32_t group = 0;
+		uint8_t pad = 0;
+		for (uint8_t k=0; k<4; k++) {
+			int8_t v = 0;
+			if (src[i+k] == '=') {
+				if ((k < 2) || (i+4 < length)) return (-1);	// padding only ends the string
+				pad++;
+			} else if ((pad != 0) || ((v = _base64_value(src[i+k])) < 0)) {
+				return (-1);
+			}
+			group = (group << 6) | v;
+		}
+		dst[j++] = group >> 16;
+		if (pad < 2) dst[j++] = group >> 8;
+		if (pad < 1) dst[j++] = group;
+	}
+	return (j);
 }
 
 /*
@@ -67,6 +67,13 @@ float min3(float x1, float x2, float x3);
 float min4(float x1, float x2, float x3, float x4);
 float max3(float x1, float x2, float x3);
 float max4(float x1, float x2, float x3, float x4);
+
+#ifndef FAST_MATH_ITERATIONS
+#define FAST_MATH_ITERATIONS 2		// Newton steps of the approximation kernels. 1 is good to about 0.1%
+#endif
+float fast_sqrt(float x);
+float fast_cbrt(float x);
+float fast_recip(float x);
 //float std_dev(float a[], uint8_t n, float *mean);
 
 //*** string utilities ***
@@ -78,8 +85,17 @@ float max4(float x1, float x2, float x3, float x4);
 uint8_t isnumber(char_t c);
 char_t *escape_string(char_t *dst, char_t *src);
 char_t *pstr2str(const char *pgm_string);
+char_t intoa(char_t *str, int32_t n);
+char_t uintoa(char_t *str, uint32_t n);
 char_t fntoa(char_t *str, float n, uint8_t precision);
+float parse_float(const char_t *str, char_t **end);
+#define HASHMASK 9999					// compute_checksum() modulus
 uint16_t compute_checksum(char_t const *string, const uint16_t length);
+uint32_t update_checksum(uint32_t h, char_t const *string, const uint16_t length);
+uint16_t compute_crc16(const uint8_t *buf, const uint16_t length);
+uint16_t update_crc16(uint16_t crc, const uint8_t *buf, const uint16_t length);
+uint16_t base64_encode(char_t *dst, const uint8_t *src, const uint16_t length);
+int16_t base64_decode(uint8_t *dst, const char_t *src);
 
 //*** other utilities ***
 
@@ -84,10 +84,20 @@
 
 //
 typedef struct xioSingleton {
+	FILE fanout;					// stream stdout is bound to while a mirror is set (see xio_set_output())
+	uint8_t primary;				// device stdout writes to
+	uint8_t stderr_dev;				// device stderr writes to
+	uint8_t filter[XIO_DEV_USART_COUNT];// XIO_OUT_ line classes mirrored to each USART
+	uint8_t line_devs;				// USARTs taking the current line. 0 until the line is classified
+	uint8_t line_drop;				// mirrors that overran their TX buffer on the current line
+	uint8_t head_len;
+	char head[XIO_FANOUT_HEAD_LEN];	// start of a line that is not classified yet
 	FILE * stderr_shadow;			// used for stack overflow / memory integrity checking
 } xioSingleton_t;
 xioSingleton_t xio;
 
+static int _putc_fanout(const char c, FILE *stream);
+
 /********************************************************************************
  * XIO Initializations, Resets and Assertions
  */
@@ -97,6 +107,7 @@ xioSingleton_t xio;
 void xio_init()
 {
 	// set memory integrity check
+	fdev_setup_stream(&xio.fanout, _putc_fanout, NULL, _FDEV_SETUP_WRITE);
 	xio_set_stderr(0);				// set a bogus value; may be overwritten with a real value
 
 	// setup device types
@@ -211,6 +222,8 @@ void xio_open_generic(uint8_t dev, x_open_t x_open,
  * PUBLIC ENTRY POINTS - access the functions via the XIO_DEV number
  * xio_open() - open function
  * xio_gets() - entry point for non-blocking get line function
+ * xio_get_line() - xio_gets() that also returns a descriptor for the line read
+ * xio_keep_line() - keep the end of a chunk of a long line for the next read
  * xio_getc() - entry point for getc (not stdio compatible)
  * xio_putc() - entry point for putc (not stdio compatible)
  *
@@ -228,6 +241,44 @@ int xio_gets(const uint8_t dev, char *buf, const int size)
 	return (ds[dev].x_gets(&ds[dev], buf, size));
 }
 
+/*
+ *	The descriptor points into the line buffer the device was given and carries the
+ *	length the device counted, so callers can work on the line where it is without
+ *	copying it or looking for its end. It is valid until the next read on the device.
+ *
+ *	A line that fills the buffer before its end is returned as a chunk with more set.
+ *	The caller takes what it can use of it and calls xio_keep_line() with the count of
+ *	chars it did not use. Those are moved to the front of the buffer and the next read
+ *	carries on after them, so a long line is read in pieces through the one buffer.
+ *	The last piece is returned as a line with more clear.
+ */
+int xio_get_line(const uint8_t dev, char *buf, const int size, xioLine_t *line)
+{
+	xioDev_t *d = &ds[dev];
+	int status = d->x_gets(d, buf, size);
+
+	if ((status == XIO_BUFFER_FULL) && (d->flag_in_line == true)) {
+		d->buf[d->len] = NUL;
+		line->buf = buf;
+		line->len = d->len + 1;
+		line->more = true;
+		return (XIO_OK);
+	}
+	if (status == XIO_OK) {
+		line->buf = buf;
+		line->len = d->len;
+		line->more = false;
+	}
+	return (status);
+}
+
+void xio_keep_line(const uint8_t dev, const uint8_t keep)
+{
+	xioDev_t *d = &ds[dev];
+	memmove(d->buf, d->buf + d->len - keep, keep);
+	d->len = keep;
+}
+
 int xio_getc(const uint8_t dev)
 {
 	return (ds[dev].x_getc(&ds[dev].file));
@@ -297,10 +348,126 @@ void xio_fc_null(xioDev_t *d)
  *	allocated by the linker for this project. We usae that to keep a shadow
  *	of __iob[2] for stack overflow detection and other memory corruption.
  */
+static void _bind_output(void);
+
 void xio_set_stdin(const uint8_t dev) { stdin  = &ds[dev].file; }
-void xio_set_stdout(const uint8_t dev) { stdout = &ds[dev].file; }
+void xio_set_stdout(const uint8_t dev)
+{
+	xio.primary = dev;
+	_bind_output();
+}
 void xio_set_stderr(const uint8_t dev)
 {
-	stderr = &ds[dev].file;
+	xio.stderr_dev = dev;
+	_bind_output();
+}
+
+/*
+ * xio_set_output() - mirror classes of output lines to a USART
+ *
+ *	filter is a mask of XIO_OUT_ line classes (0 stops mirroring to the device). The
+ *	device stdout is bound to always gets everything, whatever its filter says.
+ *
+ *	stdout is normally bound straight to its device. While any mirror is set, stdout -
+ *	and stderr if it's the same device - are bound to the fan-out stream instead. printf()
+ *	and friends still format each line once; _putc_fanout() holds the first few chars of
+ *	the line until it can tell what kind of line it is, then writes the head and the rest
+ *	of the line to the stdout device and to each USART whose filter takes that class.
+ *
+ *	The stdout device gets every line and blocks as before. A mirror only takes a line if
+ *	it has XIO_FANOUT_ROOM chars free in its TX buffer when the line is classified, so a
+ *	slow pendant drops lines rather than stalling the host. If a long line overruns the
+ *	mirror anyway the rest of it is dropped and the line is ended early.
+ */
+void xio_set_output(const uint8_t dev, const uint8_t filter)
+{
+	if (dev >= XIO_DEV_USART_COUNT) return;
+	xio.filter[dev] = filter;
+	_bind_output();
+}
+
+static void _bind_output()
+{
+	FILE *out = &ds[xio.primary].file;
+
+	if (xio.primary < XIO_DEV_USART_COUNT) {
+		for (uint8_t dev=0; dev < XIO_DEV_USART_COUNT; dev++) {
+			if ((dev != xio.primary) && (xio.filter[dev] != 0)) out = &xio.fanout;
+		}
+	}
+	stdout = out;
+	stderr = (xio.stderr_dev == xio.primary) ? out : &ds[xio.stderr_dev].file;
 	xio.stderr_shadow = stderr;		// this is the last thing in RAM, so we use it as a memory corruption canary
 }
+
+/*
+ * _classify_line() - return the XIO_OUT_ class of a line from its first chars
+ *
+ *	Returns 0 if more chars are needed. eol is set once the whole line is in the head.
+ *	Binary status reports start with STX, JSON lines are told apart by their first key
+ *	(strict or relaxed) and everything else is a text mode response.
+ */
+static uint8_t _classify_line(const char *head, const uint8_t len, const bool eol)
+{
+	if (len == 0) return (eol ? XIO_OUT_RESPONSE : 0);
+	if (head[0] == STX) return (XIO_OUT_STATUS);
+	if (head[0] != '{') return (XIO_OUT_RESPONSE);
+
+	uint8_t k = ((len > 1) && (head[1] == '"')) ? 2 : 1;
+	uint8_t avail = len - k;
+	const char *key = &head[k];
+
+	if ((avail >= 2) && (key[0] == 'r') && ((key[1] == '"') || (key[1] == ':'))) return (XIO_OUT_RESPONSE);
+	if (avail < 3) return (eol ? XIO_OUT_OTHER : 0);
+	if ((key[1] == 'r') && ((key[2] == '"') || (key[2] == ':'))) {
+		if (key[0] == 's') return (XIO_OUT_STATUS);
+		if (key[0] == 'q') return (XIO_OUT_QUEUE);
+		if (key[0] == 'e') return (XIO_OUT_EXCEPTION);
+	}
+	return (XIO_OUT_OTHER);
+}
+
+static uint8_t _select_devs(const uint8_t line_class)
+{
+	uint8_t devs = (1 << xio.primary);
+
+	for (uint8_t dev=0; dev < XIO_DEV_USART_COUNT; dev++) {
+		if ((dev == xio.primary) || ((xio.filter[dev] & line_class) == 0)) continue;
+		if ((TX_BUFFER_SIZE - 2 - xio_get_tx_bufcount_usart(&us[dev - XIO_DEV_USART_OFFSET])) < XIO_FANOUT_ROOM) continue;
+		devs |= (1 << dev);
+	}
+	return (devs);
+}
+
+static void _fanout_write(const uint8_t devs, const char c)
+{
+	for (uint8_t dev=0; dev < XIO_DEV_USART_COUNT; dev++) {
+		uint8_t bit = (1 << dev);
+		if (((devs & bit) == 0) || (xio.line_drop & bit)) continue;
+		if ((ds[dev].x_putc(c, &ds[dev].file) != XIO_OK) && (dev != xio.primary)) {
+			xio.line_drop |= bit;
+		}
+	}
+}
+
+static int _putc_fanout(const char c, FILE *stream)
+{
+	if (xio.line_devs == 0) {							// still reading the head of the line
+		if (c != '\n') xio.head[xio.head_len++] = c;
+		uint8_t line_class = _classify_line(xio.head, xio.head_len, (c == '\n'));
+		if (line_class == 0) return (XIO_OK);
+		xio.line_devs = _select_devs(line_class);
+		for (uint8_t i=0; i < xio.head_len; i++) _fanout_write(xio.line_devs, xio.head[i]);
+		if (c != '\n') return (XIO_OK);
+	}
+	_fanout_write(xio.line_devs, c);
+	if (c == '\n') {
+		for (uint8_t dev=0; dev < XIO_DEV_USART_COUNT; dev++) {
+			if (xio.line_drop & (1 << dev)) ds[dev].x_putc('\n', &ds[dev].file);	// best effort
+		}
+		xio.line_devs = 0;
+		xio.line_drop = 0;
+		xio.head_len = 0;
+	}
+	return (XIO_OK);
+}
@@ -77,7 +77,7 @@ enum xioDevNum_t {		// TYPE:	DEVICE:
 //	XIO_DEV_SPI3,		// SPI		SPI channel #3
 //	XIO_DEV_SPI4,		// SPI		SPI channel #4
 	XIO_DEV_PGM,		// FILE		Program memory file  (read only)
-//	XIO_DEV_SD,			// FILE		SD card (not implemented)
+	XIO_DEV_FLASH,		// FILE		External SPI flash job storage (see xio_file.h)
 	XIO_DEV_COUNT		// total device count (must be last entry)
 };
 // If your change these ^, check these v
@@ -88,7 +88,7 @@ enum xioDevNum_t {		// TYPE:	DEVICE:
 #define XIO_DEV_SPI_COUNT 		2 				// # of SPI devices
 #define XIO_DEV_SPI_OFFSET		XIO_DEV_USART_COUNT	// offset for computing indicies
 
-#define XIO_DEV_FILE_COUNT		1				// # of FILE devices
+#define XIO_DEV_FILE_COUNT		2				// # of FILE devices
 #define XIO_DEV_FILE_OFFSET		(XIO_DEV_USART_COUNT + XIO_DEV_SPI_COUNT) // index into FILES
 
 // Fast accessors
@@ -153,6 +153,12 @@ typedef int (*x_getc_t)(FILE *);
 typedef int (*x_putc_t)(char, FILE *);
 typedef void (*x_flow_t)(xioDev_t *d);
 
+typedef struct xioLine {						// line descriptor returned by xio_get_line()
+	char *buf;									// start of the line (NUL terminated)
+	uint8_t len;								// chars in the line including the NUL
+	uint8_t more;								// TRUE if this is a chunk of a line too long for the buffer
+} xioLine_t;
+
 /*************************************************************************
  *	Sub-Includes and static allocations
  *************************************************************************/
@@ -186,6 +192,8 @@ void xio_reset_working_flags(xioDev_t *d);
 FILE *xio_open(const uint8_t dev, const char *addr, const flags_t flags);
 int xio_ctrl(const uint8_t dev, const flags_t flags);
 int xio_gets(const uint8_t dev, char *buf, const int size);
+int xio_get_line(const uint8_t dev, char *buf, const int size, xioLine_t *line);
+void xio_keep_line(const uint8_t dev, const uint8_t keep);
 int xio_getc(const uint8_t dev);
 int xio_putc(const uint8_t dev, const char c);
 int xio_set_baud(const uint8_t dev, const uint8_t baud_rate);
@@ -208,6 +216,19 @@ void xio_init_stdio(void);				// set std devs & do startup prompt
 void xio_set_stdin(const uint8_t dev);
 void xio_set_stdout(const uint8_t dev);
 void xio_set_stderr(const uint8_t dev);
+void xio_set_output(const uint8_t dev, const uint8_t filter);
+
+// output line classes for xio_set_output() filters
+enum xioOutClass {
+	XIO_OUT_RESPONSE = 0x01,			// text mode output and JSON {"r":...} responses
+	XIO_OUT_STATUS = 0x02,				// JSON and binary status reports
+	XIO_OUT_QUEUE = 0x04,				// queue reports
+	XIO_OUT_EXCEPTION = 0x08,			// exception reports
+	XIO_OUT_OTHER = 0x10				// any other JSON line
+};
+#define XIO_OUT_ALL				0x1F
+#define XIO_FANOUT_HEAD_LEN		6		// chars held while a line is classified - enough for {"sr":
+#define XIO_FANOUT_ROOM			96		// TX chars a mirror must have free to take a line
 
 /*************************************************************************
  * SUPPORTING DEFINTIONS - SHOULD NOT NEED TO CHANGE
@@ -282,6 +303,22 @@ enum xioSignals {
 #define CHAR_FEEDHOLD (char)'!'
 #define CHAR_CYCLE_START (char)'~'
 #define CHAR_QUEUE_FLUSH (char)'%'
+
+/* Realtime override chars. These are 8 bit so they can't collide with Gcode or JSON.
+ * The RX interrupts trap them with the signal chars and queue them for the canonical machine.
+ */
+#define CHAR_OVERRIDE_FIRST		CHAR_FEED_OVERRIDE_RESET
+#define CHAR_FEED_OVERRIDE_RESET	(char)0x90	// feed override to 100%
+#define CHAR_FEED_OVERRIDE_PLUS		(char)0x91	// feed override +10%
+#define CHAR_FEED_OVERRIDE_MINUS	(char)0x92	// feed override -10%
+#define CHAR_RAPID_OVERRIDE_RESET	(char)0x95	// traverse override to 100%
+#define CHAR_RAPID_OVERRIDE_MEDIUM	(char)0x96	// traverse override to 50%
+#define CHAR_RAPID_OVERRIDE_LOW		(char)0x97	// traverse override to 25%
+#define CHAR_SPINDLE_OVERRIDE_RESET	(char)0x99	// spindle override to 100%
+#define CHAR_SPINDLE_OVERRIDE_PLUS	(char)0x9A	// spindle override +10%
+#define CHAR_SPINDLE_OVERRIDE_MINUS	(char)0x9B	// spindle override -10%
+#define CHAR_OVERRIDE_LAST		CHAR_SPINDLE_OVERRIDE_MINUS
+#define CHAR_IS_OVERRIDE(c) (((uint8_t)(c) >= (uint8_t)CHAR_OVERRIDE_FIRST) && ((uint8_t)(c) <= (uint8_t)CHAR_OVERRIDE_LAST))
 //#define CHAR_BOOTLOADER ESC
 
 /* XIO return codes
@@ -46,6 +46,14 @@ static struct cfgFILE const cfgFile[] PROGMEM = {
 	xio_getc_pgm,				// stdio getc function
 	xio_putc_pgm,				// stdio putc function
 	xio_fc_null,				// flow control callback
+},
+{	// FLASH config
+	xio_open_flash,
+	xio_ctrl_generic,
+	xio_gets_flash,
+	xio_getc_flash,
+	xio_putc_flash,
+	xio_fc_null,
 }
 };
 /******************************************************************************
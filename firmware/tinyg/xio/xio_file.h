@@ -52,6 +52,50 @@
 		return;
 	}
 */
+/*--- Stored block programs ----
+
+  A stored program is Gcode that was tokenized on the host, so it runs with no
+  parsing or number conversion. It is a byte array in program memory:
+
+	const uint8_t blocks_smoke[] PROGMEM = {
+	2, 'G',0x00,0x00,0x00,0x00, 'X',0x00,0x00,0x20,0x41,	// G0 X10
+	0 };
+
+	- each block is a word count then the words as letter (uppercase) and value
+	  (IEEE 754 float, little-endian). These are the blocks of the O word cache
+	  and the words of Gcode frames (see gcode_parser.c)
+	- a word count of 0 ends the program
+	- comments, messages and O words are not stored
+
+  The headers are made from Gcode (or from the char array test headers) by the
+  simulator: sim/tinyg_sim -b blocks_smoke tests/test_001_smoke.h > tests/blocks_001_smoke.h
+
+  Programs are listed by O number in the index in xio_pgm.c and run by "O<n> call"
+  if no subroutine <n> is defined in RAM.
+*/
+/*--- Job storage in external SPI flash ----
+
+  A job is uploaded once and can then be run as often as needed without the host:
+
+	$job=1		start an upload. The stored job is erased. Gcode lines that follow
+				are stored instead of run (config and JSON commands still run).
+				Each stored line is acknowledged as usual.
+	$job=0		close the upload. The job is only valid once it has been closed.
+	$job=2		run the stored job. It becomes the input source until its end.
+	$job		returns the length of the stored job in bytes (0 if none)
+	$jcrc		returns the CRC-16 of the stored job, or of the lines stored so far during
+				an upload, so the host can check the upload chunk by chunk
+	$jrc=n		run the job n times from $job=2 (0 and 1 run it once). A read returns the
+				runs left including the one in progress
+
+  The flash is a 25 series SPI NOR part on the SPI bus with its chip select on SPI
+  slave select #2. The job header (magic, length and CRC) is in the first sector and the
+  text follows from FLASH_DATA_START with LF line ends. The job is read ahead in
+  blocks of FLASH_BLOCK_SIZE bytes, so the parser is fed at memory speed.
+
+  The SPI bus shares its pins with RS485, which can't be used while the flash is.
+  There is no flash in SPI slave mode (__XIO_SPI_SLAVE).
+*/
 
 #ifndef xio_file_h
 #define xio_file_h
@@ -64,6 +108,19 @@
 
 #define PGM_FLAGS (XIO_BLOCK | XIO_CRLF | XIO_LINEMODE)
 #define PGM_ADDR_MAX (0x4000)		// 16K
+#define PGM_BLOCK_WORDS_MAX 12		// most words in a stored program block
+#define PGM_BLOCK_SIZE (1 + PGM_BLOCK_WORDS_MAX*5)	// bytes of a block: count and words
+
+#define FLASH_FLAGS (XIO_BLOCK | XIO_CRLF | XIO_LINEMODE)
+#define FLASH_BLOCK_SIZE 256		// bytes read ahead in one transfer (and the write page buffer)
+#define FLASH_PAGE_SIZE 256			// program page of the flash part
+#define FLASH_SECTOR_SIZE 4096		// erase sector of the flash part
+#define FLASH_DATA_START FLASH_SECTOR_SIZE	// the job header has the first sector
+#define FLASH_JOB_MAGIC 0x434A4754	// "TGJC" (the header carries a CRC)
+
+#define SPI_FLASH SPIC				// SPI master the flash is on
+#define SPI_FLASH_SS_PORT SPI_SS2_PORT	// flash chip select
+#define SPI_FLASH_SS_bm (1<<SPI_SS2_bp)
 
 /* 
  * FILE device extended control structure 
@@ -79,6 +136,12 @@ typedef struct xioFILE {
 	const char * filebase_P;			// base location in program memory (PROGMEM)
 } xioFile_t;
 
+// stored block program index entry
+typedef struct pgmProgram {
+	uint16_t number;					// O number the program is called by
+	const uint8_t * blocks_P;			// blocks in program memory (PROGMEM)
+} pgmProgram_t;
+
 /* 
  * FILE DEVICE FUNCTION PROTOTYPES
  */
@@ -87,7 +150,21 @@ FILE *xio_open_file(const uint8_t dev, const char *addr, const flags_t flags);
 int xio_gets_pgm(xioDev_t *d, char *buf, const int size);		// read string from program memory
 int xio_getc_pgm(FILE *stream);									// get a character from PROGMEM
 int xio_putc_pgm(const char c, FILE *stream);					// always returns ERROR
-
-// SD Card functions
+const uint8_t *xio_open_pgm_program(const uint16_t number);		// find a stored block program
+uint8_t xio_read_pgm_block(const uint8_t **rd_P, uint8_t *block);	// copy the next block to RAM
+
+// SPI flash job storage functions
+FILE *xio_open_flash(const uint8_t dev, const char *addr, const flags_t flags);
+int xio_gets_flash(xioDev_t *d, char *buf, const int size);	// read a line of the stored job
+int xio_getc_flash(FILE *stream);								// get a character of the stored job
+int xio_putc_flash(const char c, FILE *stream);					// always returns ERROR
+int xio_open_flash_upload(void);								// start storing a job
+int xio_close_flash_upload(void);								// finish storing a job
+uint8_t xio_flash_is_storing(void);								// true while a job is uploaded
+int xio_store_flash_line(const char *line, const uint8_t len);	// append a line to the job
+uint32_t xio_get_flash_job_length(void);						// 0 if no job is stored
+uint16_t xio_get_flash_job_crc(void);							// CRC-16 of the job or the upload so far
+void xio_set_flash_runs(const uint16_t runs);					// times $job=2 runs the job
+uint16_t xio_get_flash_runs_left(void);							// 0 if the job isn't running
 
 #endif
@@ -0,0 +1,393 @@
+/*
+ *  xio_flash.c	- device driver for job storage in an external SPI flash
+ * 				- works with avr-gcc stdio library
+ *
+ * Part of TinyG project
+ *
+ * Copyright (c) 2011 - 2015 Alden S. Hart Jr.
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/* See xio_file.h for how jobs are stored and run
+ *
+ *	The flash is a 25 series SPI NOR part (JEDEC ID, 256 byte pages, 4K sector erase)
+ *	on the SPIC master at F_CPU/4. Transfers are polled; a block read of FLASH_BLOCK_SIZE
+ *	bytes takes a few hundred microseconds and is made only when the buffer runs dry,
+ *	so the reader is far ahead of the parser for the rest of the block.
+ */
+
+#include <stdio.h>						// precursor for xio.h
+#include <stdbool.h>					// true and false
+#include <string.h>						// for memset
+#include <avr/pgmspace.h>				// precursor for xio.h
+
+#include "../xio.h"						// includes for all devices are in here
+#include "../tinyg.h"					// needed for the compile-time settings
+#include "../util.h"					// update_crc16()
+
+// Fast accessors (cheating)
+#define FLASH ds[XIO_DEV_FLASH]			// device struct accessor
+#define FLASHf fs[XIO_DEV_FLASH - XIO_DEV_FILE_OFFSET]	// file extended struct accessor
+
+// 25 series commands
+#define FLASH_CMD_READ			0x03
+#define FLASH_CMD_PROGRAM		0x02
+#define FLASH_CMD_WRITE_ENABLE	0x06
+#define FLASH_CMD_READ_STATUS	0x05
+#define FLASH_CMD_ERASE_SECTOR	0x20
+#define FLASH_CMD_READ_ID		0x9F
+#define FLASH_STATUS_BUSY		0x01
+
+typedef struct flashJobHeader {			// written at address 0 when an upload is closed
+	uint32_t magic;
+	uint32_t length;					// bytes of text
+	uint16_t crc;						// CRC-16 of the text
+} flashJobHeader_t;
+
+typedef struct xioFlash {
+	uint8_t present;					// a flash was found on the last probe
+	uint8_t storing;					// an upload is open
+	uint32_t capacity;					// bytes, from the JEDEC ID
+	uint32_t job_length;				// stored job, 0 if none
+	uint16_t job_crc;					// CRC-16 of the stored job, or of the text stored so far
+	uint16_t runs;						// times $job=2 runs the job ($jrc)
+	uint16_t runs_left;					// runs left including the one in progress
+	uint16_t buf_len;					// bytes in the buffer
+	uint16_t buf_index;					// next byte to read from the buffer
+	uint8_t buf[FLASH_BLOCK_SIZE];		// read-ahead block, or the page being written
+} xioFlash_t;
+static xioFlash_t fl;
+
+/*
+ * Low level SPI flash transfers
+ */
+
+static uint8_t _xfer(const uint8_t c)
+{
+	SPI_FLASH.DATA = c;
+	while ((SPI_FLASH.STATUS & SPI_IF_bm) == 0);
+	return (SPI_FLASH.DATA);
+}
+
+static void _select(void) { SPI_FLASH_SS_PORT.OUTCLR = SPI_FLASH_SS_bm;}
+static void _deselect(void) { SPI_FLASH_SS_PORT.OUTSET = SPI_FLASH_SS_bm;}
+
+static void _command(const uint8_t command, const uint32_t addr)
+{
+	_select();
+	_xfer(command);
+	_xfer((uint8_t)(addr >> 16));
+	_xfer((uint8_t)(addr >> 8));
+	_xfer((uint8_t)addr);
+}
+
+static void _wait_ready(void)
+{
+	_select();
+	_xfer(FLASH_CMD_READ_STATUS);
+	while (_xfer(0) & FLASH_STATUS_BUSY);
+	_deselect();
+}
+
+static void _write_enable(void)
+{
+	_wait_ready();
+	_select();
+	_xfer(FLASH_CMD_WRITE_ENABLE);
+	_deselect();
+}
+
+static void _read(const uint32_t addr, uint8_t *buf, uint16_t len)
+{
+	_wait_ready();
+	_command(FLASH_CMD_READ, addr);
+	while (len-- > 0) { *buf++ = _xfer(0);}
+	_deselect();
+}
+
+static void _program(const uint32_t addr, const uint8_t *buf, uint16_t len)	// within one page
+{
+	_write_enable();
+	_command(FLASH_CMD_PROGRAM, addr);
+	while (len-- > 0) { _xfer(*buf++);}
+	_deselect();
+}
+
+static void _erase_sector(const uint32_t addr)
+{
+	_write_enable();
+	_command(FLASH_CMD_ERASE_SECTOR, addr);
+	_deselect();
+}
+
+/*
+ * _probe_flash() - set up the SPI master, read the flash size and the stored job
+ *
+ *	The SPI pins are shared with RS485 (and with SPI slave mode, which rules the flash out).
+ */
+
+static uint8_t _probe_flash(void)
+{
+	fl.present = false;
+	fl.job_length = 0;
+#ifndef __XIO_SPI_SLAVE
+	SPI_DATA_PORT.DIRSET = SPI_MOSI_bm | SPI_SCK_bm | SPI_SS1_bm;	// SS1 must be an output to stay master
+	SPI_DATA_PORT.DIRCLR = SPI_MISO_bm;
+	SPI_DATA_PORT.OUTSET = SPI_SS1_bm;
+	SPI_FLASH_SS_PORT.DIRSET = SPI_FLASH_SS_bm;
+	_deselect();
+	SPI_FLASH.CTRL = SPI_ENABLE_bm | SPI_MASTER_bm | SPI_MODE_0_gc | SPI_PRESCALER_DIV4_gc;
+
+	uint8_t id[3];
+	_select();
+	_xfer(FLASH_CMD_READ_ID);
+	for (uint8_t i=0; i<3; i++) { id[i] = _xfer(0);}
+	_deselect();
+	if ((id[0] == 0x00) || (id[0] == 0xFF) || (id[2] < 16) || (id[2] > 24)) {
+		return (false);									// nothing there, or not a 3 byte address part
+	}
+	fl.present = true;
+	fl.capacity = (uint32_t)1 << id[2];
+
+	flashJobHeader_t header;
+	_read(0, (uint8_t *)&header, sizeof(header));
+	if ((header.magic == FLASH_JOB_MAGIC) && (header.length <= fl.capacity - FLASH_DATA_START)) {
+		fl.job_length = header.length;
+		fl.job_crc = header.crc;
+	}
+#endif
+	return (fl.present);
+}
+
+/*
+ *	xio_open_flash() - open the stored job for reading
+ *
+ *  Returns NULL if there is no flash or no job stored.
+ */
+
+FILE *xio_open_flash(const uint8_t dev, const char *addr, const flags_t flags)
+{
+	xioDev_t *d = &ds[dev];
+	d->x = &fs[dev - XIO_DEV_FILE_OFFSET];			// bind extended struct to device
+	xioFile_t *dx = (xioFile_t *)d->x;
+
+	memset (dx, 0, sizeof(xioFile_t));
+	xio_reset_working_flags(d);
+	xio_ctrl_generic(d, flags);
+	fl.buf_len = 0;
+	fl.buf_index = 0;
+	if ((fl.storing == true) || (_probe_flash() == false) || (fl.job_length == 0)) {
+		return (NULL);
+	}
+	dx->rd_offset = FLASH_DATA_START;
+	dx->max_offset = FLASH_DATA_START + fl.job_length;
+	fl.runs_left = (fl.runs == 0) ? 1 : fl.runs;
+	return (&d->file);
+}
+
+/*
+ * _read_flash_char() - return the next char of the job, reading the next block as needed
+ */
+
+static int _read_flash_char(void)
+{
+	if (fl.buf_index >= fl.buf_len) {
+		if (FLASHf.rd_offset >= FLASHf.max_offset) {
+			return (_FDEV_EOF);
+		}
+		uint32_t left = FLASHf.max_offset - FLASHf.rd_offset;
+		fl.buf_len = (left < FLASH_BLOCK_SIZE) ? left : FLASH_BLOCK_SIZE;
+		fl.buf_index = 0;
+		_read(FLASHf.rd_offset, fl.buf, fl.buf_len);
+		FLASHf.rd_offset += fl.buf_len;
+	}
+	return (fl.buf[fl.buf_index++]);
+}
+
+/*
+ *	xio_gets_flash() - read a line of the stored job
+ *
+ *	Lines are stored with LF endings. At the end of the job it starts again from the
+ *	top until it has run $jrc times, then returns XIO_EOF once. The reruns cost a
+ *	block read, so a short job repeated many times runs at full speed without the host.
+ */
+
+int xio_gets_flash(xioDev_t *d, char *buf, const int size)
+{
+	int c;
+
+	if (FLASHf.max_offset == 0) {					// return error if no job is open
+		return (XIO_FILE_NOT_OPEN);
+	}
+	d->len = 0;
+	d->signal = XIO_SIG_OK;
+	while (true) {
+		while ((c = _read_flash_char()) != _FDEV_EOF) {
+			if ((c == LF) || (c == CR)) {
+				buf[(d->len)++] = NUL;
+				return (XIO_OK);
+			}
+			if (d->len >= size-1) {					// a line too long is cut short
+				continue;
+			}
+			buf[(d->len)++] = (char)c;
+		}
+		if (d->len > 0) {							// last line had no LF - the next read ends the run
+			buf[(d->len)++] = NUL;
+			return (XIO_OK);
+		}
+		if (fl.runs_left <= 1) break;
+		fl.runs_left--;								// run the job again
+		FLASHf.rd_offset = FLASH_DATA_START;
+	}
+	FLASHf.max_offset = 0;							// close the job
+	fl.runs_left = 0;
+	return (XIO_EOF);
+}
+
+/*
+ *  xio_getc_flash() - read a character of the stored job
+ *  xio_putc_flash() - always returns an error; jobs are written a line at a time
+ */
+
+int xio_getc_flash(FILE *stream)
+{
+	int c = _read_flash_char();
+	if (c == _FDEV_EOF) {
+		FLASH.signal = XIO_SIG_EOF;
+		return (_FDEV_EOF);
+	}
+	if (c == CR) c = LF;
+	if (FLASH.flag_echo) putchar(c);				// conditional echo
+	return (c);
+}
+
+int xio_putc_flash(const char c, FILE *stream)
+{
+	return -1;
+}
+
+/*
+ * Job upload
+ *
+ * xio_open_flash_upload()	- erase the stored job and start storing lines
+ * xio_close_flash_upload()	- write the job header; the job can be run from now on
+ * xio_flash_is_storing()	- true if an upload is open (Gcode lines are stored, not run)
+ * xio_store_flash_line()	- append a line (len includes the NUL) to the job
+ * xio_get_flash_job_length() - return the length of the stored job, 0 if none
+ * xio_get_flash_job_crc()	- return the CRC-16 of the stored job, or of the upload so far
+ * xio_set_flash_runs()		- set how many times the job runs from $job=2
+ * xio_get_flash_runs_left() - return the runs left including the one in progress
+ *
+ *	Pages are programmed as they fill and each sector is erased as the job reaches it.
+ *	The header is written last, so a job that was not closed is not run.
+ *
+ *	The CRC-16 is taken over the text as it is stored (LF line ends), so the host can
+ *	check an upload in chunks: it compares $jcrc with its own CRC of the lines sent so
+ *	far after each chunk and starts again on a mismatch, rather than reading the job
+ *	back. The CRC is kept in the header with the length.
+ */
+
+static void _flush_page(void)
+{
+	uint32_t addr = FLASHf.wr_offset - fl.buf_len;	// the buffer always starts on a page
+	if ((addr & (FLASH_SECTOR_SIZE-1)) == 0) {
+		_erase_sector(addr);
+	}
+	_program(addr, fl.buf, fl.buf_len);
+	fl.buf_len = 0;
+}
+
+int xio_open_flash_upload()
+{
+	if (_probe_flash() == false) {
+		return (XIO_NO_SUCH_DEVICE);
+	}
+	_erase_sector(0);								// invalidates the old job
+	fl.job_length = 0;
+	fl.job_crc = 0xFFFF;
+	fl.buf_len = 0;
+	FLASHf.wr_offset = FLASH_DATA_START;
+	FLASHf.max_offset = fl.capacity;
+	fl.storing = true;
+	return (XIO_OK);
+}
+
+int xio_close_flash_upload()
+{
+	if (fl.storing == false) {
+		return (XIO_FILE_NOT_OPEN);
+	}
+	if (fl.buf_len > 0) {
+		_flush_page();
+	}
+	flashJobHeader_t header = { FLASH_JOB_MAGIC, FLASHf.wr_offset - FLASH_DATA_START, fl.job_crc };
+	_program(0, (const uint8_t *)&header, sizeof(header));
+	_wait_ready();
+	fl.job_length = header.length;
+	fl.storing = false;
+	FLASHf.max_offset = 0;
+	return (XIO_OK);
+}
+
+uint8_t xio_flash_is_storing()
+{
+	return (fl.storing);
+}
+
+int xio_store_flash_line(const char *line, const uint8_t len)
+{
+	if (fl.storing == false) {
+		return (XIO_FILE_NOT_OPEN);
+	}
+	if (FLASHf.wr_offset + len > FLASHf.max_offset) {
+		return (XIO_FILE_SIZE_EXCEEDED);
+	}
+	for (uint8_t i=0; i<len; i++) {
+		uint8_t c = (line[i] == NUL) ? LF : line[i];
+		fl.job_crc = update_crc16(fl.job_crc, &c, 1);
+		fl.buf[fl.buf_len++] = c;
+		FLASHf.wr_offset++;
+		if (fl.buf_len == FLASH_PAGE_SIZE) {
+			_flush_page();
+		}
+		if (line[i] == NUL) break;
+	}
+	return (XIO_OK);
+}
+
+uint32_t xio_get_flash_job_length()
+{
+	if (fl.storing == false) {
+		_probe_flash();
+	}
+	return (fl.job_length);
+}
+
+uint16_t xio_get_flash_job_crc()
+{
+	if (fl.storing == false) {
+		_probe_flash();
+	}
+	return (fl.job_crc);
+}
+
+void xio_set_flash_runs(const uint16_t runs)
+{
+	fl.runs = runs;
+}
+
+uint16_t xio_get_flash_runs_left()
+{
+	return (fl.runs_left);
+}
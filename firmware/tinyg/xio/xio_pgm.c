@@ -21,8 +21,22 @@
 
 #include <stdio.h>						// precursor for xio.h
 #include <stdbool.h>					// true and false
+#include <string.h>						// strlen()
 #include <avr/pgmspace.h>				// precursor for xio.h
 #include "../xio.h"						// includes for all devices are in here
+#include "../tinyg.h"					// needed for the compile-time settings
+
+#ifdef __STORED_PROGRAMS
+#include "../tests/blocks_001_smoke.h"	// smoke test (test 1) as a stored program
+#endif
+
+// Stored block program index - see xio_file.h
+static const pgmProgram_t pgm_programs[] PROGMEM = {
+#ifdef __STORED_PROGRAMS
+	{ 1, blocks_smoke },
+#endif
+	{ 0, NULL }							// end of index
+};
 
 // Fast accessors (cheating)
 #define PGM ds[XIO_DEV_PGM]				// device struct accessor
@@ -46,6 +60,7 @@ int xio_gets_pgm(xioDev_t *d, char *buf, const int size)
 		clearerr(&PGM.file);
 		return (XIO_EOF);
 	}
+	d->len = strlen(buf)+1;				// fgets() doesn't count the chars for us
 	return (XIO_OK);
 }
 
@@ -116,3 +131,35 @@ int xio_putc_pgm(const char c, FILE *stream)
 }
 
 
+
+/*
+ *	xio_open_pgm_program() - return the stored block program called by O number, or NULL
+ *	xio_read_pgm_block()   - copy the next block of a stored program to RAM
+ *
+ *	xio_read_pgm_block() returns the word count and advances the read pointer past the
+ *	block. It returns 0 (end of program) at the end marker and for a block that is longer
+ *	than PGM_BLOCK_WORDS_MAX. The block buffer must hold PGM_BLOCK_SIZE bytes.
+ */
+
+const uint8_t *xio_open_pgm_program(const uint16_t number)
+{
+	for (const pgmProgram_t *p = pgm_programs; pgm_read_word(&p->blocks_P) != 0; p++) {
+		if (pgm_read_word(&p->number) == number) {
+			return ((const uint8_t *)pgm_read_word(&p->blocks_P));
+		}
+	}
+	return (NULL);
+}
+
+uint8_t xio_read_pgm_block(const uint8_t **rd_P, uint8_t *block)
+{
+	const uint8_t *rd = *rd_P;
+	uint8_t words = pgm_read_byte(rd);
+
+	if (words > PGM_BLOCK_WORDS_MAX) {
+		return (0);
+	}
+	memcpy_P(block, rd, 1 + words*5);
+	*rd_P = rd + 1 + words*5;
+	return (words);
+}
@@ -42,11 +42,14 @@
 #include "../hardware.h"				// needed for hardware reset
 #include "../controller.h"				// needed for trapping kill char
 #include "../canonical_machine.h"		// needed for fgeedhold and cycle start
+#include "../network.h"					// needed for slave mode
 
 // Fast accessors
 #define RS ds[XIO_DEV_RS485]
 #define RSu us[XIO_DEV_RS485 - XIO_DEV_USART_OFFSET]
 
+static uint32_t rx_usec;				// time the last char was received
+
 /*
  * Helper functions
  *	xio_enable_rs485_tx() - specialized routine to enable rs488 TX mode
@@ -145,8 +148,26 @@ ISR(RS485_TXC_ISR_vect)	// ISR(USARTC1_TXC_vect)
 
 /*
  * RS485_RX_ISR - RS485 receiver interrupt (RX)
+ *
+ *	A network slave receives binary frames, so nothing is trapped or filtered.
  */
 
+static inline void _queue_rx_char(const char c)
+{
+	advance_buffer(RSu.rx_buf_head, RX_BUFFER_SIZE);
+	if (RSu.rx_buf_head != RSu.rx_buf_tail) {		// write char unless buffer full
+		RSu.rx_buf[RSu.rx_buf_head] = c;			// (= USARTC1.DATA;)
+		RSu.rx_buf_count++;
+		// flow control detection goes here - should it be necessary
+		return;
+	}
+	// buffer-full handling
+	if ((++RSu.rx_buf_head) > RX_BUFFER_SIZE -1) {	// reset the head
+		RSu.rx_buf_count = RX_BUFFER_SIZE-1;		// reset count for good measure
+		RSu.rx_buf_head = 1;
+	}
+}
+
 ISR(RS485_RX_ISR_vect)	//ISR(USARTC1_RXC_vect)		// serial port C0 RX isr
 {
 	char c;
@@ -156,6 +177,12 @@ ISR(RS485_RX_ISR_vect)	//ISR(USARTC1_RXC_vect)		// serial port C0 RX isr
 	} else {
 		return;										// shouldn't ever happen; bit of a fail-safe here
 	}
+	rx_usec = hw_get_usec();
+	controller_post_event(EVENT_RX);
+	if (cs.network_mode == NETWORK_SLAVE) {
+		_queue_rx_char(c);
+		return;
+	}
 
 	// trap async commands - do not insert into RX queue
 	if (c == CHAR_RESET) {	 						// trap Kill character
@@ -170,21 +197,51 @@ ISR(RS485_RX_ISR_vect)	//ISR(USARTC1_RXC_vect)		// serial port C0 RX isr
 		cm_request_cycle_start();
 		return;
 	}
+	if (CHAR_IS_OVERRIDE(c)) {						// trap realtime override chars
+		cm_request_override(c);
+		return;
+	}
 	// filter out CRs and LFs if they are to be ignored
 	if ((c == CR) && (RS.flag_ignorecr)) return;
 	if ((c == LF) && (RS.flag_ignorelf)) return;
 
-	// normal character path
-	advance_buffer(RSu.rx_buf_head, RX_BUFFER_SIZE);
-	if (RSu.rx_buf_head != RSu.rx_buf_tail) {		// write char unless buffer full
-		RSu.rx_buf[RSu.rx_buf_head] = c;			// (= USARTC1.DATA;)
-		RSu.rx_buf_count++;
-		// flow control detection goes here - should it be necessary
-		return;
-	}
-	// buffer-full handling
-	if ((++RSu.rx_buf_head) > RX_BUFFER_SIZE -1) {	// reset the head
-		RSu.rx_buf_count = RX_BUFFER_SIZE-1;		// reset count for good measure
-		RSu.rx_buf_head = 1;
+	_queue_rx_char(c);								// normal character path
+}
+
+/*
+ * xio_read_rs485()			- read a raw 8 bit char without blocking, or _FDEV_ERR if none
+ * xio_get_rs485_rx_count()	- return the number of chars waiting in the RX buffer
+ * xio_get_rs485_rx_usec()	- return the time the last char was received
+ * xio_get_rs485_tx_free()	- return the number of chars that can be written without waiting
+ *
+ *	getc() masks chars to 7 bits, so the network reads them here.
+ */
+
+int xio_read_rs485()
+{
+	if (RSu.rx_buf_head == RSu.rx_buf_tail) {
+		return (_FDEV_ERR);
 	}
+	advance_buffer(RSu.rx_buf_tail, RX_BUFFER_SIZE);
+	RSu.rx_buf_count--;
+	return ((uint8_t)RSu.rx_buf[RSu.rx_buf_tail]);
+}
+
+buffer_t xio_get_rs485_rx_count(void)
+{
+	return (xio_get_rx_bufcount_usart(&RSu));
+}
+
+uint32_t xio_get_rs485_rx_usec(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint32_t usec = rx_usec;
+	SREG = sreg;
+	return (usec);
+}
+
+buffer_t xio_get_rs485_tx_free(void)
+{
+	return (TX_BUFFER_SIZE - 2 - xio_get_tx_bufcount_usart(&RSu));
 }
@@ -74,6 +74,8 @@
 #include "../xio.h"						// includes for all devices are in here
 #include "../xmega/xmega_interrupts.h"
 #include "../tinyg.h"					// needed for AXES definition
+#include "../hardware.h"				// needed for hardware reset
+#include "../canonical_machine.h"		// needed for feedhold and cycle start
 
 // statics
 static char _read_rx_buffer(xioSpi_t *dx);
@@ -105,6 +107,7 @@ typedef struct cfgSPI {
 } cfgSpi_t;
 
 static cfgSpi_t const cfgSpi[] PROGMEM = {
+#ifndef __XIO_SPI_SLAVE
 	{
 		xio_open_spi,			// SPI #1 configs
 		xio_ctrl_generic,
@@ -137,6 +140,40 @@ static cfgSpi_t const cfgSpi[] PROGMEM = {
 		SPI_OUTCLR_bm,
 		SPI_OUTSET_bm,
 	}
+#else
+	{
+		xio_open_spi_slave,		// SPI #1 configs - slave of the embedded host
+		xio_ctrl_generic,
+		xio_gets_spi_slave,
+		xio_getc_spi_slave,
+		xio_putc_spi_slave,
+		xio_fc_null,
+		BIT_BANG,
+		&SPI_DATA_PORT,
+		&SPI_SS1_PORT,
+		SPI_SS1_bm,
+		(SPI_SS1_bm | SPI_MOSI_bm | SPI_SCK_bm),
+		SPI_MISO_bm,
+		0,
+		0,
+	},
+	{							// SPI #2 is opened but its pins are left to the slave
+		xio_open_spi,
+		xio_ctrl_generic,
+		xio_gets_spi,
+		xio_getc_spi,
+		xio_putc_spi,
+		xio_fc_null,
+		BIT_BANG,
+		&SPI_DATA_PORT,
+		&SPI_SS2_PORT,
+		0,
+		0,
+		0,
+		0,
+		0,
+	}
+#endif
 };
 
 /******************************************************************************
@@ -226,7 +263,7 @@ int xio_gets_spi(xioDev_t *d, char *buf, const int size)
 	}
 	while (true) {
 		if (d->len >= (d->size)-1) {			// size is total count - aka 'num' in fgets()
-			d->buf[d->size] = NUL;				// string termination preserves latest char
+			d->buf[d->len] = NUL;				// string termination preserves latest char
 			return (XIO_BUFFER_FULL);
 		}
 		if ((c_out = _read_rx_buffer(dx)) == Q_EMPTY) {
@@ -449,3 +486,252 @@ static char _read_spi_char(xioSpi_t *dx)
 	dx->ssel_port->OUTSET = dx->ssbit;
 	return (c_in);
 }
+
+#ifdef __XIO_SPI_SLAVE
+/******************************************************************************
+ * SPI SLAVE MODE (see xio_spi.h)
+ *
+ * xio_open_spi_slave()	- set up SPIC as a slave, the DMA channels and the SS interrupt
+ * xio_gets_spi_slave()	- read a line from the received frames
+ * xio_getc_spi_slave()	- read a char from the received frames
+ * xio_putc_spi_slave()	- queue a char for the host to collect
+ * SPI_SS_ISR			- end of frame
+ *
+ *	A received frame belongs to the ISR until its length is set and to the readers until
+ *	they set it back to zero. The readers only re-arm the RX channel (with interrupts off)
+ *	if it was left discarding and no frame is in progress; otherwise the ISR does.
+ ******************************************************************************/
+
+typedef struct spiSlave {
+	uint8_t rx_frame[SPI_RX_FRAMES][SPI_FRAME_SIZE];
+	volatile uint8_t rx_len[SPI_RX_FRAMES];		// chars received in each frame; 0 if the frame is free
+	volatile uint8_t rx_fill;					// frame the RX channel writes into
+	volatile uint8_t rx_armed;					// false if no frame was free and the RX channel discards
+	uint8_t rx_read;							// frame being read
+	uint8_t rx_index;							// next char to read in it
+	uint8_t rx_discard;							// RX channel destination when discarding
+
+	uint8_t tx_frame[SPI_FRAME_SIZE];			// count followed by text
+	volatile uint16_t tx_buf_head;				// TX queue - runs top down like the USART queues
+	volatile uint16_t tx_buf_tail;
+	char tx_buf[SPI_SLAVE_TX_BUFFER_SIZE];
+} spiSlave_t;
+static spiSlave_t sx;
+
+static void _set_dma_address(volatile uint8_t *reg, const volatile void *addr)
+{
+	reg[0] = (uint8_t)((uint16_t)addr);				// ADDR0, ADDR1 and ADDR2 are consecutive
+	reg[1] = (uint8_t)((uint16_t)addr >> 8);
+	reg[2] = 0;
+}
+
+static uint16_t _get_dma_address(volatile uint8_t *reg)
+{
+	return (reg[0] | (reg[1] << 8));
+}
+
+static void _arm_rx_frame(void)						// call with interrupts off or from the ISR
+{
+	DMA.SPI_SLAVE_RX_DMA_CH.CTRLA = 0;
+	if (sx.rx_len[sx.rx_fill] == 0) {
+		DMA.SPI_SLAVE_RX_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_FIXED_gc |
+										   DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_INC_gc;
+		_set_dma_address(&DMA.SPI_SLAVE_RX_DMA_CH.DESTADDR0, sx.rx_frame[sx.rx_fill]);
+		sx.rx_armed = true;
+		SPI_READY_PORT.OUTSET = SPI_READY_bm;
+	} else {
+		DMA.SPI_SLAVE_RX_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_FIXED_gc |
+										   DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc;
+		_set_dma_address(&DMA.SPI_SLAVE_RX_DMA_CH.DESTADDR0, &sx.rx_discard);
+		sx.rx_armed = false;
+		SPI_READY_PORT.OUTCLR = SPI_READY_bm;
+	}
+	DMA.SPI_SLAVE_RX_DMA_CH.TRFCNT = SPI_FRAME_SIZE;
+	DMA.SPI_SLAVE_RX_DMA_CH.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+}
+
+static void _arm_tx_frame(uint8_t sent)				// sent is the number of bytes the host clocked
+{
+	uint8_t count = sx.tx_frame[0];
+	uint8_t taken = (sent > count) ? count : ((sent == 0) ? 0 : sent-1);
+
+	DMA.SPI_SLAVE_TX_DMA_CH.CTRLA = 0;
+	while (taken-- > 0) {							// the text the host got leaves the queue
+		if ((--sx.tx_buf_tail) == 0) sx.tx_buf_tail = SPI_SLAVE_TX_BUFFER_SIZE-1;
+	}
+	uint16_t tail = sx.tx_buf_tail;
+	count = 0;
+	while ((tail != sx.tx_buf_head) && (count < SPI_FRAME_SIZE-1)) {
+		if ((--tail) == 0) tail = SPI_SLAVE_TX_BUFFER_SIZE-1;
+		sx.tx_frame[++count] = sx.tx_buf[tail];
+	}
+	sx.tx_frame[0] = count;
+	SPI_SLAVE.DATA = count;							// the first byte goes out with the first MOSI byte
+	_set_dma_address(&DMA.SPI_SLAVE_TX_DMA_CH.SRCADDR0, &sx.tx_frame[1]);
+	DMA.SPI_SLAVE_TX_DMA_CH.TRFCNT = SPI_FRAME_SIZE-1;
+	DMA.SPI_SLAVE_TX_DMA_CH.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+}
+
+FILE *xio_open_spi_slave(const uint8_t dev, const char *addr, const flags_t flags)
+{
+	FILE *file = xio_open_spi(dev, addr, flags);	// pins as set in the config record
+
+	memset(&sx, 0, sizeof(sx));
+	sx.tx_buf_head = 1;
+	sx.tx_buf_tail = 1;
+	SPI_READY_PORT.DIRSET = SPI_READY_bm;
+	SPI_READY_PORT.OUTCLR = SPI_READY_bm;			// busy until armed
+
+	SPI_SLAVE.CTRL = SPI_ENABLE_bm | SPI_MODE_3_gc;	// slave, MSB first
+	SPI_SLAVE.INTCTRL = SPI_INTLVL_OFF_gc;			// the DMA takes the transfers
+
+	DMA.CTRL = DMA_ENABLE_bm | DMA_PRIMODE_CH0123_gc;// RX is read ahead of TX on the shared trigger
+	DMA.SPI_SLAVE_RX_DMA_CH.TRIGSRC = SPI_SLAVE_DMA_TRIGSRC;
+	DMA.SPI_SLAVE_RX_DMA_CH.REPCNT = 1;
+	_set_dma_address(&DMA.SPI_SLAVE_RX_DMA_CH.SRCADDR0, &SPI_SLAVE.DATA);
+	DMA.SPI_SLAVE_TX_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_INC_gc |
+									   DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc;
+	DMA.SPI_SLAVE_TX_DMA_CH.TRIGSRC = SPI_SLAVE_DMA_TRIGSRC;
+	DMA.SPI_SLAVE_TX_DMA_CH.REPCNT = 1;
+	_set_dma_address(&DMA.SPI_SLAVE_TX_DMA_CH.DESTADDR0, &SPI_SLAVE.DATA);
+
+	_arm_tx_frame(0);
+	_arm_rx_frame();
+
+	SPI_DATA_PORT.PIN4CTRL = PORT_ISC_RISING_gc;	// SS is pin 4 (SPI_SS1_bp)
+	SPI_DATA_PORT.INT1MASK = SPI_SS1_bm;
+	SPI_DATA_PORT.INTCTRL |= PORT_INT1LVL_MED_gc;
+	return (file);
+}
+
+/*
+ * _trap_rx_frame() - handle the signal chars in a frame; they are replaced with filler
+ */
+
+static void _trap_rx_frame(uint8_t *frame, uint8_t len)
+{
+	for (uint8_t i=0; i<len; i++) {
+		if (frame[i] == CHAR_RESET) {
+			hw_request_hard_reset();
+		} else if (frame[i] == CHAR_FEEDHOLD) {
+			cm_request_feedhold();
+		} else if (frame[i] == CHAR_QUEUE_FLUSH) {
+			cm_request_queue_flush();
+		} else if (frame[i] == CHAR_CYCLE_START) {
+			cm_request_cycle_start();
+		} else if (CHAR_IS_OVERRIDE(frame[i])) {
+			cm_request_override((char_t)frame[i]);
+		} else {
+			continue;
+		}
+		frame[i] = NUL;
+	}
+}
+
+ISR(SPI_SS_ISR_vect)
+{
+	DMA.SPI_SLAVE_RX_DMA_CH.CTRLA = 0;				// stop both channels
+	DMA.SPI_SLAVE_TX_DMA_CH.CTRLA = 0;
+
+	if (sx.rx_armed) {
+		uint8_t len = _get_dma_address(&DMA.SPI_SLAVE_RX_DMA_CH.DESTADDR0) - (uint16_t)sx.rx_frame[sx.rx_fill];
+		if (len != 0) {
+			_trap_rx_frame(sx.rx_frame[sx.rx_fill], len);
+			sx.rx_len[sx.rx_fill] = len;			// hand the frame to the readers
+			sx.rx_fill = (sx.rx_fill + 1) & SPI_RX_FRAMES_MASK;
+		}
+	}
+	_arm_rx_frame();
+	_arm_tx_frame(_get_dma_address(&DMA.SPI_SLAVE_TX_DMA_CH.SRCADDR0) - (uint16_t)&sx.tx_frame[1]);
+}
+
+/*
+ * _read_spi_slave_char() - return the next text char from the frames, or _FDEV_ERR if none
+ */
+
+static int _read_spi_slave_char(void)
+{
+	while (sx.rx_len[sx.rx_read] != 0) {
+		if (sx.rx_index < sx.rx_len[sx.rx_read]) {
+			char c = sx.rx_frame[sx.rx_read][sx.rx_index++];
+			if ((c == NUL) || (c == STX)) continue;	// filler
+			return (c);
+		}
+		sx.rx_index = 0;							// frame done - free it
+		sx.rx_len[sx.rx_read] = 0;
+		sx.rx_read = (sx.rx_read + 1) & SPI_RX_FRAMES_MASK;
+
+		uint8_t sreg = SREG;
+		cli();
+		if ((sx.rx_armed == false) && (SPI_DATA_PORT.IN & SPI_SS1_bm)) {
+			_arm_rx_frame();						// no frame in progress - take the freed one
+		}
+		SREG = sreg;
+	}
+	return (_FDEV_ERR);
+}
+
+int xio_gets_spi_slave(xioDev_t *d, char *buf, const int size)
+{
+	int c;
+
+	if (d->flag_in_line == false) {					// first time thru initializations
+		d->flag_in_line = true;
+		d->len = 0;
+		d->buf = buf;
+		d->size = size;
+		d->signal = XIO_SIG_OK;
+	}
+	while ((c = _read_spi_slave_char()) != _FDEV_ERR) {
+		if (d->flag_echo) d->x_putc(c, stdout);		// conditional echo regardless of character
+		if (d->len >= d->size) {					// handle buffer overruns
+			d->buf[d->size] = NUL;
+			d->signal = XIO_SIG_EOL;
+			return (XIO_BUFFER_FULL);
+		}
+		if ((c == CR) || (c == LF)) {
+			d->buf[(d->len)++] = NUL;
+			d->signal = XIO_SIG_EOL;
+			d->flag_in_line = false;				// clear in-line state (reset)
+			return (XIO_OK);
+		}
+		d->buf[(d->len)++] = c;
+	}
+	return (XIO_EAGAIN);
+}
+
+int xio_getc_spi_slave(FILE *stream)
+{
+	int c = _read_spi_slave_char();
+
+	if (c == _FDEV_ERR) {
+		((xioDev_t *)stream->udata)->signal = XIO_SIG_EAGAIN;
+	}
+	return (c);
+}
+
+int xio_putc_spi_slave(const char c, FILE *stream)
+{
+	uint16_t next_tx_buf_head = sx.tx_buf_head-1;
+	if (next_tx_buf_head == 0) next_tx_buf_head = SPI_SLAVE_TX_BUFFER_SIZE-1;
+	while (true) {
+		uint8_t sreg = SREG;
+		cli();										// the tail is 16 bits and moved by the SS ISR
+		uint8_t full = (next_tx_buf_head == sx.tx_buf_tail);
+		SREG = sreg;
+		if (full == false) break;
+		sleep_mode();								// wait for the host to collect a frame
+	}
+	sx.tx_buf[next_tx_buf_head] = c;
+	uint8_t sreg = SREG;
+	cli();
+	sx.tx_buf_head = next_tx_buf_head;
+	SREG = sreg;
+
+	if ((c == '\n') && (((xioDev_t *)stream->udata)->flag_crlf)) {
+		return (xio_putc_spi_slave(CR, stream));
+	}
+	return (XIO_OK);
+}
+
+#endif // __XIO_SPI_SLAVE
@@ -45,6 +45,42 @@
 //#define SPI_RX_BUFFER_SIZE (spibuf_t)1024
 //#define SPI_TX_BUFFER_SIZE (spibuf_t)1024
 
+/* SPI slave mode
+ *	With __XIO_SPI_SLAVE defined (tinyg.h) SPI channel 1 is a slave of an embedded host
+ *	on the xmega SPIC port and becomes stdin, stdout and stderr. The host transfers
+ *	frames of SPI_FRAME_SIZE bytes, each one framed by SS (mode 3, MSB first):
+ *
+ *	  - MOSI: text, padded out with NULs (STX is also taken as filler)
+ *	  - MISO: a count of the text bytes that follow, then the text; the rest is undefined
+ *
+ *	The ready line (PB3, slave select #2 in master mode) is high while a free frame
+ *	buffer is armed. The host may only start a frame with text while ready is high. A
+ *	frame of filler can be sent at any time to collect output and is dropped if there is
+ *	no free buffer. Output waits in the TX queue until the host collects it.
+ *
+ *	DMA channel 2 writes the MOSI bytes into the RX frame and channel 3 loads the MISO
+ *	bytes from the TX frame, both triggered by SPIC. The channels run at fixed priority so
+ *	the byte received is read before the next one is loaded. The host should leave about
+ *	a microsecond between bytes for that, which still gives several hundred KB/s. At the
+ *	end of a frame (SS rising) the ISR traps the signal characters, hands the frame to
+ *	the readers, arms RX on the next free frame and builds the next MISO frame.
+ *
+ *	SPIC is on port C pins 4-7, which are the RS485 pins, so the network is not available.
+ *	The USB channel can still be used.
+ */
+#define SPI_FRAME_SIZE		128					// bytes per frame
+#define SPI_RX_FRAMES		8					// RX frames buffered (must be a power of 2)
+#define SPI_RX_FRAMES_MASK	(SPI_RX_FRAMES-1)
+#define SPI_SLAVE_TX_BUFFER_SIZE (uint16_t)512	// TX queue (location 0 is not used)
+
+#define SPI_SLAVE SPIC							// SPI peripheral used in slave mode
+#define SPI_SLAVE_RX_DMA_CH CH2					// DMA channels and trigger (CH0 and CH1 are USB's)
+#define SPI_SLAVE_TX_DMA_CH CH3
+#define SPI_SLAVE_DMA_TRIGSRC DMA_CH_TRIGSRC_SPIC_gc
+#define SPI_SS_ISR_vect PORTC_INT1_vect			// SS rising edge - end of frame (INT0 is the USB CTS)
+#define SPI_READY_PORT	SPI_SS2_PORT			// ready/busy output to the host
+#define SPI_READY_bm	(1<<SPI_SS2_bp)
+
 
 //**** SPI device configuration ****
 //NOTE: XIO_BLOCK / XIO_NOBLOCK affects reads only. Writes always block. (see xio.h)
@@ -116,5 +152,11 @@ FILE *xio_open_spi(const uint8_t dev, const char *addr, const flags_t flags);
 int xio_gets_spi(xioDev_t *d, char *buf, const int size);
 int xio_putc_spi(const char c, FILE *stream);
 int xio_getc_spi(FILE *stream);
+#ifdef __XIO_SPI_SLAVE
+FILE *xio_open_spi_slave(const uint8_t dev, const char *addr, const flags_t flags);
+int xio_gets_spi_slave(xioDev_t *d, char *buf, const int size);
+int xio_putc_spi_slave(const char c, FILE *stream);
+int xio_getc_spi_slave(FILE *stream);
+#endif
 
 #endif
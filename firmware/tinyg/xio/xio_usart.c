@@ -32,6 +32,7 @@
 #include "../gpio.h"					// needed for XON/XOFF LED indicator
 #include "../util.h"					// needed to pick up __debug defines
 #include "../config.h"					// needed to write back usb baud rate
+#include "../perf.h"					// counts XOFF events
 
 /******************************************************************************
  * USART CONFIGURATION RECORDS
@@ -94,6 +95,7 @@ static struct cfgUSART const cfgUsart[] PROGMEM = {
  ******************************************************************************/
 
 static int _gets_helper(xioDev_t *d, xioUsart_t *dx);
+static void _force_tx_interrupt(xioUsart_t *dx);
 
 /*
  *	xio_init_usart() - general purpose USART initialization (shared)
@@ -147,6 +149,11 @@ FILE *xio_open_usart(const uint8_t dev, const char *addr, const flags_t flags)
 	dx->port->OUTCLR = (uint8_t)pgm_read_byte(&cfgUsart[idx].outclr);
 	dx->port->OUTSET = (uint8_t)pgm_read_byte(&cfgUsart[idx].outset);
 	dx->usart->CTRLB = (USART_TXEN_bm | USART_RXEN_bm);	// enable tx and rx
+#ifdef __XIO_DMA
+	if (dev == XIO_DEV_USB) {
+		xio_init_dma_usb();								// DMA instead of tx and rx IRQs
+	} else
+#endif
 	dx->usart->CTRLA = CTRLA_RXON_TXON;					// enable tx and rx IRQs
 
 	dx->port->USB_CTS_PINCTRL = PORT_OPC_TOTEM_gc | PORT_ISC_BOTHEDGES_gc;
@@ -176,25 +183,32 @@ void xio_set_baud_usart(xioUsart_t *dx, const uint8_t baud)
  * xio_fc_usart() - Usart device flow control callback
  * xio_get_tx_bufcount_usart() - returns number of chars in TX buffer
  * xio_get_rx_bufcount_usart() - returns number of chars in RX buffer
+ * _force_tx_interrupt() - get the transmitter to send a queued flow control char
  *
  *	Reminder: tx/rx queues fill from top to bottom, w/0 being the wrap location
  */
 
+static void _force_tx_interrupt(xioUsart_t *dx)
+{
+#ifdef __XIO_DMA
+	if (dx == &USBu) {
+		xio_kick_tx_usb();						// the USB transmitter has no TX interrupt in DMA mode
+		return;
+	}
+#endif
+	dx->usart->CTRLA = CTRLA_RXON_TXON;			// force a TX interrupt
+}
+
 void xio_xoff_usart(xioUsart_t *dx)
 {
 	if (dx->fc_state_rx == FC_IN_XON) {
 		dx->fc_state_rx = FC_IN_XOFF;
+		PERF_COUNT(PERF_XOFF);
 
 		// If using XON/XOFF flow control
 		if (cfg.enable_flow_control == FLOW_CONTROL_XON) {
 			dx->fc_char_rx = XOFF;
-			dx->usart->CTRLA = CTRLA_RXON_TXON;		// force a TX interrupt
-		}
-
-		// If using hardware flow control. The CTS pin on the *FTDI* is our RTS.
-		// Logic 1 means we're NOT ready for more data.
-		if (cfg.enable_flow_control == FLOW_CONTROL_RTS) {
-			dx->port->OUTSET = USB_RTS_bm;
+			_force_tx_interrupt(dx);
 		}
 	}
 }
@@ -207,13 +221,7 @@ void xio_xon_usart(xioUsart_t *dx)
 		// If using XON/XOFF flow control
 		if (cfg.enable_flow_control == FLOW_CONTROL_XON) {
 			dx->fc_char_rx = XON;
-			dx->usart->CTRLA = CTRLA_RXON_TXON;		// force a TX interrupt
-		}
-
-		// If using hardware flow control. The CTS pin on the *FTDI* is our RTS.
-		// Logic 0 means we're ready for more data.
-		if (cfg.enable_flow_control == FLOW_CONTROL_RTS) {
-			dx->port->OUTCLR = USB_RTS_bm;
+			_force_tx_interrupt(dx);
 		}
 	}
 }
@@ -221,7 +229,16 @@ void xio_xon_usart(xioUsart_t *dx)
 void xio_fc_usart(xioDev_t *d)		// callback from the usart handlers
 {
 	xioUsart_t *dx = d->x;
-	if (xio_get_rx_bufcount_usart(dx) < XOFF_RX_LO_WATER_MARK) {
+	buffer_t count = xio_get_rx_bufcount_usart(dx);
+
+	// RTS is raised by the USB RX ISR (see _check_rx_high_water()) and dropped here as the buffer drains.
+	// It is also dropped if flow control was changed away from RTS while it was raised.
+	if (dx->port->OUT & USB_RTS_bm) {
+		if ((cfg.enable_flow_control != FLOW_CONTROL_RTS) || (count < RTS_RX_LO_WATER_MARK)) {
+			dx->port->OUTCLR = USB_RTS_bm;
+		}
+	}
+	if (count < XOFF_RX_LO_WATER_MARK) {
 		xio_xon_usart(dx);
 	}
 }
@@ -254,16 +271,21 @@ buffer_t xio_get_rx_bufcount_usart(const xioUsart_t *dx)
  *
  *	  - RX buffer is empty on entry (return XIO_EAGAIN)
  *	  - no more chars to read from RX buffer (return XIO_EAGAIN)
- *	  - read would cause output buffer overflow (return XIO_BUFFER_FULL)
+ *	  - output buffer is full (return XIO_BUFFER_FULL - the line goes on in the next chunk)
  *	  - read returns complete line (returns XIO_OK)
  *
  *	Note: LINEMODE flag in device struct is ignored. It's ALWAYS LINEMODE here.
  *	Note: This function assumes ignore CR and ignore LF handled upstream before the RX buffer
+ *	Note: NULs are skipped. In DMA mode they mark signal chars trapped in the RX buffer
  */
 int xio_gets_usart(xioDev_t *d, char *buf, const int size)
 {
 	xioUsart_t *dx = d->x;						// USART pointer
 
+#ifdef __XIO_DMA
+	if (dx == &USBu) xio_scan_rx_usb();			// pick up the chars the DMA has received
+#endif
+
 	if (d->flag_in_line == false) {				// first time thru initializations
 		d->flag_in_line = true;					// yes, we are busy getting a line
 		d->len = 0;								// zero buffer
@@ -290,18 +312,20 @@ static int _gets_helper(xioDev_t *d, xioUsart_t *dx)
 		dx->rx_buf_count = 0;					// reset count for good measure
 		return(XIO_BUFFER_EMPTY);				// stop reading
 	}
+	if (d->len >= d->size-1) {					// buffer full - unless the line ends here the
+		buffer_t next = dx->rx_buf_tail;		// char is left for the next chunk (see xio_get_line())
+		advance_buffer(next, RX_BUFFER_SIZE);
+		c = (dx->rx_buf[next] & 0x007F);
+		if ((c != CR) && (c != LF)) return (XIO_BUFFER_FULL);
+	}
 	advance_buffer(dx->rx_buf_tail, RX_BUFFER_SIZE);
 	dx->rx_buf_count--;
 	d->x_flow(d);								// run flow control
 //	c = dx->rx_buf[dx->rx_buf_tail];			// get char from RX Q
 	c = (dx->rx_buf[dx->rx_buf_tail] & 0x007F);	// get char from RX Q & mask MSB
+	if (c == NUL) return (XIO_EAGAIN);			// skip trapped chars
 	if (d->flag_echo) d->x_putc(c, stdout);		// conditional echo regardless of character
 
-	if (d->len >= d->size) {					// handle buffer overruns
-		d->buf[d->size] = NUL;					// terminate line (d->size is zero based)
-		d->signal = XIO_SIG_EOL;
-		return (XIO_BUFFER_FULL);
-	}
 	if ((c == CR) || (c == LF)) {				// handle CR, LF termination
 		d->buf[(d->len)++] = NUL;
 		d->signal = XIO_SIG_EOL;
@@ -345,10 +369,16 @@ int xio_getc_usart(FILE *stream)
 	xioUsart_t *dx = d->x;
 	char c;
 
+#ifdef __XIO_DMA
+	if (dx == &USBu) xio_scan_rx_usb();				// pick up the chars the DMA has received
+#endif
 	while (dx->rx_buf_head == dx->rx_buf_tail) {	// RX ISR buffer empty
 		dx->rx_buf_count = 0;						// reset count for good measure
 		if (d->flag_block) {
 			sleep_mode();
+#ifdef __XIO_DMA
+			if (dx == &USBu) xio_scan_rx_usb();
+#endif
 		} else {
 			d->signal = XIO_SIG_EAGAIN;
 			return(_FDEV_ERR);
@@ -46,13 +46,36 @@
 //#define CTRLA_RXOFF_TXON_TXCON (USART_DREINTLVL_LO_gc | USART_TXCINTLVL_LO_gc)
 //#define CTRLA_RXOFF_TXOFF_TXCON (USART_TXCINTLVL_LO_gc)
 
+/* DMA mode
+ *	With __XIO_DMA defined the USB channel is moved off the per-character RX and TX
+ *	interrupts onto the xmega DMA controller, which leaves room for larger buffers:
+ *
+ *	  - RX: DMA channel 0 writes every received char into rx_buf. It runs top down
+ *		with a reload at the end of the block, the same order the ISR fills the
+ *		queue, so the readers are unchanged. New chars are scanned for signals and
+ *		flow control on every RTC tick and every read (xio_scan_rx_usb()); trapped
+ *		chars are overwritten with NULs, which the readers skip.
+ *	  - TX: DMA channel 1 sends the contiguous run of queued chars (up to
+ *		XIO_DMA_TX_CHUNK) and starts the next run from its completion interrupt.
+ *
+ *	RS485 stays on interrupts but shares the (larger) buffer sizes.
+ */
+//#define __XIO_DMA								// uncomment to run the USB USART from DMA
+
 // Buffer sizing
+#ifndef __XIO_DMA
 #define buffer_t uint_fast8_t					// fast, but limits buffer to 255 char max
 //#define buffer_t uint16_t						// larger buffers
 
 // Must reserve 2 bytes for buffer management
 #define RX_BUFFER_SIZE (buffer_t)254			// buffer_t can be 8 bits
 #define TX_BUFFER_SIZE (buffer_t)254			// buffer_t can be 8 bits
+#else
+#define buffer_t uint16_t						// buffer_t must be 16 bits if >255
+#define RX_BUFFER_SIZE (buffer_t)1024			// location 0 is not used
+#define TX_BUFFER_SIZE (buffer_t)256
+#define XIO_DMA_TX_CHUNK (buffer_t)32			// max chars per TX transfer - bounds the delay of an XOFF
+#endif
 //#define RX_BUFFER_SIZE (buffer_t)255			// buffer_t can be 8 bits
 //#define TX_BUFFER_SIZE (buffer_t)255			// buffer_t can be 8 bits
 
@@ -65,8 +88,28 @@
 
 // XON/XOFF hi and lo watermarks. At 115.200 the host has approx. 100 uSec per char
 // to react to an XOFF. 90% (0.9) of 255 chars gives 25 chars to react, or about 2.5 ms.
+// In DMA mode the XOFF can be sent up to one RTC tick (10 ms, ~115 chars) late, so the
+// high mark leaves a fixed headroom for that plus the host's reaction time.
+#ifndef __XIO_DMA
 #define XOFF_RX_HI_WATER_MARK (RX_BUFFER_SIZE * 0.8)	// % to issue XOFF
 #define XOFF_RX_LO_WATER_MARK (RX_BUFFER_SIZE * 0.1)	// % to issue XON
+#else
+#define XOFF_RX_HEADROOM 192							// chars that can still arrive after the XOFF
+#define XOFF_RX_HI_WATER_MARK (RX_BUFFER_SIZE - XOFF_RX_HEADROOM)
+#define XOFF_RX_LO_WATER_MARK (RX_BUFFER_SIZE * 0.25)
+#endif
+
+// RTS/CTS hi and lo watermarks. The FTDI stops sending within a few chars of RTS going
+// high, so the buffer can run nearly full before RTS is raised, and RTS can drop again at
+// half full instead of waiting for the buffer to drain. In DMA mode the high mark is tested
+// when the RX DMA is scanned, so it keeps the XOFF headroom.
+#ifndef __XIO_DMA
+#define RTS_RX_HI_WATER_MARK (RX_BUFFER_SIZE - 8)		// raise RTS (stop the host)
+#else
+#define RTS_RX_HI_WATER_MARK XOFF_RX_HI_WATER_MARK
+#endif
+#define RTS_RX_LO_WATER_MARK (RX_BUFFER_SIZE / 2)		// drop RTS (host may send)
+
 #define XOFF_TX_HI_WATER_MARK (TX_BUFFER_SIZE * 0.9)	// % to issue XOFF
 #define XOFF_TX_LO_WATER_MARK (TX_BUFFER_SIZE * 0.05)	// % to issue XON
 
@@ -83,6 +126,12 @@
 #define USB_USART USARTC0						// USB usart
 #define USB_RX_ISR_vect USARTC0_RXC_vect	 	// (RX) reception complete IRQ
 #define USB_TX_ISR_vect USARTC0_DRE_vect		// (TX) data register empty IRQ
+#define USB_RX_DMA_CH CH0						// DMA channel and triggers for DMA mode
+#define USB_TX_DMA_CH CH1
+#define USB_TX_DMA_ISR_vect DMA_CH1_vect		// (TX) DMA transfer complete IRQ
+#define USB_RX_DMA_TRIGSRC DMA_CH_TRIGSRC_USARTC0_RXC_gc
+#define USB_TX_DMA_TRIGSRC DMA_CH_TRIGSRC_USARTC0_DRE_gc
+#define USB_TX_DMA_INTLVL DMA_CH_TRNINTLVL_MED_gc	// MED for the same reason as the TX interrupt
 
 #define USB_PORT PORTC							// port where the USART is located
 #define USB_CTS_bp (1)							// CTS - bit position (pin is wired on board)
@@ -155,6 +204,12 @@ enum xioFCState {
 		FC_IN_XOFF					// flow controlled state
 };
 
+enum xioDMAState {					// TX DMA channel state (DMA mode)
+		DMA_TX_IDLE = 0,			// no transfer in progress
+		DMA_TX_DATA,				// sending a run of chars from tx_buf
+		DMA_TX_FLOW					// sending the RX-side XON or XOFF character
+};
+
 /******************************************************************************
  * STRUCTURES
  ******************************************************************************/
@@ -176,6 +231,12 @@ typedef struct xioUSART {
 	volatile buffer_t tx_buf_head;			// TX buffer write index
 	volatile buffer_t tx_buf_count;
 
+#ifdef __XIO_DMA
+	volatile buffer_t rx_scan_head;			// RX chars up to here are scanned (DMA mode)
+	volatile buffer_t tx_dma_tail;			// TX read index once the transfer completes (DMA mode)
+	volatile uint8_t tx_dma_state;			// TX DMA transfer in progress (DMA mode)
+#endif
+
 	USART_t *usart;							// xmega USART structure
 	PORT_t	*port;							// corresponding port
 
@@ -199,13 +260,25 @@ int xio_putc_usb(const char c, FILE *stream);	// stdio compatible put character
 int xio_putc_rs485(const char c, FILE *stream);	// stdio compatible put character
 void xio_enable_rs485_rx(void);					// needed for startup
 void xio_enable_rs485_tx(void);					// included for completeness
+int xio_read_rs485(void);						// raw 8 bit read for the network
+buffer_t xio_get_rs485_rx_count(void);
+uint32_t xio_get_rs485_rx_usec(void);
+buffer_t xio_get_rs485_tx_free(void);
 
 // handy helpers
 buffer_t xio_get_rx_bufcount_usart(const xioUsart_t *dx);
 buffer_t xio_get_tx_bufcount_usart(const xioUsart_t *dx);
 buffer_t xio_get_usb_rx_free(void);
+buffer_t xio_get_usb_tx_free(void);
 void xio_reset_usb_rx_buffers(void);
 
+#ifdef __XIO_DMA
+void xio_init_dma_usb(void);
+void xio_scan_rx_usb(void);
+void xio_rtc_callback_usb(void);
+void xio_kick_tx_usb(void);
+#endif
+
 void xio_queue_RX_char_usart(const uint8_t dev, const char c);
 void xio_queue_RX_string_usart(const uint8_t dev, const char *buf);
 void xio_queue_RX_char_usb(const char c);		// simulate char rcvd into RX buffer
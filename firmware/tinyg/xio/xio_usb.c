@@ -31,7 +31,6 @@
 // application specific stuff that's littered into the USB handler
 #include "../tinyg.h"
 #include "../config.h"					// needed to find flow control setting
-#include "../network.h"
 #include "../hardware.h"
 #include "../controller.h"
 #include "../canonical_machine.h"		// trapped characters communicate directly with the canonical machine
@@ -51,6 +50,185 @@
  *	an interrupt.
  */
 
+#ifdef __XIO_DMA
+/*
+ * DMA mode (see xio_usart.h)
+ *
+ * xio_init_dma_usb()	  - set up the RX and TX DMA channels. Called from xio_open_usart()
+ * xio_scan_rx_usb()	  - scan the chars received by DMA and pass them to the readers
+ * xio_rtc_callback_usb() - scan from the RTC tick so signals are seen while the main loop is busy
+ * xio_kick_tx_usb()	  - start a TX transfer if the channel is idle
+ * xio_putc_usb()		  - DMA mode char writer
+ * USB_TX_DMA_ISR		  - TX transfer complete; starts the next one
+ *
+ *	The RX channel writes down through rx_buf and reloads at the end of the block, so the
+ *	index of the last char received follows from its destination address. The scanner
+ *	advances rx_scan_head to it, trapping signals as the RX ISR would. Only the main loop
+ *	moves rx_buf_head on to rx_scan_head, so the readers never see a 16 bit index change
+ *	under them. Other TX and flow control state is only changed with interrupts off.
+ *	The DMA does not stop if the host overruns the buffer - flow control must be used.
+ */
+
+static inline uint8_t _trap_rx_char(const char c);
+static inline void _check_rx_high_water(buffer_t count);
+
+static void _set_dma_address(volatile uint8_t *reg, const volatile void *addr)
+{
+	reg[0] = (uint8_t)((uint16_t)addr);				// ADDR0, ADDR1 and ADDR2 are consecutive
+	reg[1] = (uint8_t)((uint16_t)addr >> 8);
+	reg[2] = 0;
+}
+
+static buffer_t _get_rx_dma_head(void)
+{
+	uint16_t addr, check;
+
+	do {											// the DMA may move on between the byte reads
+		addr = DMA.USB_RX_DMA_CH.DESTADDR0 | (DMA.USB_RX_DMA_CH.DESTADDR1 << 8);
+		check = DMA.USB_RX_DMA_CH.DESTADDR0 | (DMA.USB_RX_DMA_CH.DESTADDR1 << 8);
+	} while (addr != check);
+	buffer_t head = (addr - (uint16_t)USBu.rx_buf) + 1;// last char written is above the next one
+	if (head > RX_BUFFER_SIZE-1) head = 1;			// nothing written since the reload
+	return (head);
+}
+
+static void _scan_rx_dma(void)
+{
+	buffer_t head = _get_rx_dma_head();
+	buffer_t count;
+
+	while (USBu.rx_scan_head != head) {
+		advance_buffer(USBu.rx_scan_head, RX_BUFFER_SIZE);
+		if (_trap_rx_char(USBu.rx_buf[USBu.rx_scan_head]) == true) {
+			USBu.rx_buf[USBu.rx_scan_head] = NUL;	// the readers skip NULs
+		}
+	}
+	if (USBu.rx_scan_head <= USBu.rx_buf_tail) {
+		count = USBu.rx_buf_tail - USBu.rx_scan_head;
+	} else {
+		count = RX_BUFFER_SIZE - (USBu.rx_scan_head - USBu.rx_buf_tail);
+	}
+	_check_rx_high_water(count);
+}
+
+static void _start_tx_dma(void)						// call with interrupts off or from an ISR
+{
+	if (USBu.tx_dma_state != DMA_TX_IDLE) {
+		return;										// the transfer complete ISR will restart
+	}
+	if ((cfg.enable_flow_control == FLOW_CONTROL_RTS) && (USBu.port->IN & USB_CTS_bm)) {
+		return;										// the CTS ISR will restart
+	}
+	if (USBu.fc_char_rx != NUL) {					// an XON or XOFF goes ahead of the queue
+		_set_dma_address(&DMA.USB_TX_DMA_CH.SRCADDR0, &USBu.fc_char_rx);
+		DMA.USB_TX_DMA_CH.TRFCNT = 1;
+		USBu.tx_dma_state = DMA_TX_FLOW;
+	} else {
+		if ((USBu.fc_state_tx == FC_IN_XOFF) || (USBu.tx_buf_head == USBu.tx_buf_tail)) {
+			return;
+		}
+		buffer_t next = USBu.tx_buf_tail;
+		advance_buffer(next, TX_BUFFER_SIZE);		// first char to send
+		buffer_t len = (USBu.tx_buf_head <= next) ? (next - USBu.tx_buf_head + 1) : next; // up to the wrap
+		if (len > XIO_DMA_TX_CHUNK) len = XIO_DMA_TX_CHUNK;
+		_set_dma_address(&DMA.USB_TX_DMA_CH.SRCADDR0, &USBu.tx_buf[next]);
+		DMA.USB_TX_DMA_CH.TRFCNT = len;
+		USBu.tx_dma_tail = next - len + 1;			// last char of the transfer
+		USBu.tx_dma_state = DMA_TX_DATA;
+	}
+	DMA.USB_TX_DMA_CH.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+}
+
+void xio_init_dma_usb(void)
+{
+	DMA.CTRL = DMA_ENABLE_bm;
+
+	DMA.USB_RX_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_FIXED_gc |
+								 DMA_CH_DESTRELOAD_BLOCK_gc | DMA_CH_DESTDIR_DEC_gc;
+	DMA.USB_RX_DMA_CH.TRIGSRC = USB_RX_DMA_TRIGSRC;
+	DMA.USB_RX_DMA_CH.TRFCNT = RX_BUFFER_SIZE-1;	// locations RX_BUFFER_SIZE-1 down to 1
+	DMA.USB_RX_DMA_CH.REPCNT = 0;					// repeat forever
+	_set_dma_address(&DMA.USB_RX_DMA_CH.SRCADDR0, &USB_USART.DATA);
+	_set_dma_address(&DMA.USB_RX_DMA_CH.DESTADDR0, &USBu.rx_buf[RX_BUFFER_SIZE-1]);
+	DMA.USB_RX_DMA_CH.CTRLA = DMA_CH_ENABLE_bm | DMA_CH_REPEAT_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+
+	DMA.USB_TX_DMA_CH.ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_DEC_gc |
+								 DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc;
+	DMA.USB_TX_DMA_CH.TRIGSRC = USB_TX_DMA_TRIGSRC;
+	_set_dma_address(&DMA.USB_TX_DMA_CH.DESTADDR0, &USB_USART.DATA);
+	DMA.USB_TX_DMA_CH.CTRLB = USB_TX_DMA_INTLVL;
+
+	USBu.rx_scan_head = USBu.rx_buf_head;
+	USBu.tx_dma_state = DMA_TX_IDLE;
+}
+
+void xio_scan_rx_usb(void)
+{
+	uint8_t sreg = SREG;
+	cli();											// keep the RTC scan out
+	_scan_rx_dma();
+	USBu.rx_buf_head = USBu.rx_scan_head;			// hand the scanned chars to the readers
+	SREG = sreg;
+}
+
+void xio_rtc_callback_usb(void)
+{
+	_scan_rx_dma();
+}
+
+void xio_kick_tx_usb(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	_start_tx_dma();
+	SREG = sreg;
+}
+
+static void _queue_tx_char(const char c)
+{
+	buffer_t next_tx_buf_head = USBu.tx_buf_head-1;	// set next head while leaving current one alone
+	if (next_tx_buf_head == 0)
+		next_tx_buf_head = TX_BUFFER_SIZE-1; 		// detect wrap and adjust; -1 avoids off-by-one
+	while (true) {
+		uint8_t sreg = SREG;
+		cli();										// the tail is 16 bits and moved by the DMA ISR
+		uint8_t full = (next_tx_buf_head == USBu.tx_buf_tail);
+		SREG = sreg;
+		if (full == false) break;
+		xio_kick_tx_usb();
+		sleep_mode(); 								// sleep until there is space in the buffer
+	}
+	USBu.tx_buf[next_tx_buf_head] = c;				// write char to buffer
+	uint8_t sreg = SREG;
+	cli();
+	USBu.tx_buf_head = next_tx_buf_head;			// accept next buffer head
+	SREG = sreg;
+}
+
+int xio_putc_usb(const char c, FILE *stream)
+{
+	_queue_tx_char(c);
+	if ((c == '\n') && (USB.flag_crlf)) {			// expand <LF> to <LF><CR> if $ec is set
+		_queue_tx_char(CR);
+	}
+	xio_kick_tx_usb();
+	return (XIO_OK);
+}
+
+ISR(USB_TX_DMA_ISR_vect)
+{
+	DMA.USB_TX_DMA_CH.CTRLB |= DMA_CH_TRNIF_bm;		// clear the transfer complete flag
+	if (USBu.tx_dma_state == DMA_TX_FLOW) {
+		USBu.fc_char_rx = NUL;
+	} else {
+		USBu.tx_buf_tail = USBu.tx_dma_tail;
+	}
+	USBu.tx_dma_state = DMA_TX_IDLE;
+	_start_tx_dma();
+}
+
+#else // __XIO_DMA
+
 int xio_putc_usb(const char c, FILE *stream)
 {
 	buffer_t next_tx_buf_head = USBu.tx_buf_head-1;		// set next head while leaving current one alone
@@ -106,13 +284,85 @@ ISR(USB_TX_ISR_vect) //ISR(USARTC0_DRE_vect)		// USARTC0 data register empty
 	}
 }
 
+#endif // __XIO_DMA
+
+/*
+ * _trap_rx_char() - handle signal and flow control chars as they are received
+ *
+ *	Returns true if the char was trapped and must not go into the RX queue.
+ *	Runs from the RX ISR, or from the DMA mode scanner.
+ */
+static inline uint8_t _trap_rx_char(const char c)
+{
+	// trap async commands - do not insert character into RX queue
+	if (c == CHAR_RESET) {	 					// trap Kill signal
+		hw_request_hard_reset();
+		return (true);
+	}
+	if (c == CHAR_FEEDHOLD) {					// trap feedhold signal
+		cm_request_feedhold();
+		return (true);
+	}
+	if (c == CHAR_QUEUE_FLUSH) {				// trap queue flush signal
+		cm_request_queue_flush();
+		return (true);
+	}
+	if (c == CHAR_CYCLE_START) {				// trap cycle start signal
+		cm_request_cycle_start();
+		return (true);
+	}
+	if (CHAR_IS_OVERRIDE(c)) {					// trap realtime override chars
+		cm_request_override(c);
+		return (true);
+	}
+	if (USB.flag_xoff) {
+		if (c == XOFF) {						// trap incoming XON/XOFF signals
+			USBu.fc_state_tx = FC_IN_XOFF;
+			return (true);
+		}
+		if (c == XON) {
+			USBu.fc_state_tx = FC_IN_XON;
+#ifdef __XIO_DMA
+			_start_tx_dma();					// restart the transmitter
+#else
+			USBu.usart->CTRLA = CTRLA_RXON_TXOFF;// force a TX interrupt
+#endif
+			return (true);
+		}
+	}
+	return (false);
+}
+
 /*
  * Pin Change (edge-detect) interrupt for CTS pin.
  */
 
+/*
+ * _check_rx_high_water() - stop the host when the RX buffer reaches the high water mark
+ *
+ *	In RTS mode the RTS line is raised directly - the CTS pin on the *FTDI* is our RTS, and
+ *	logic 1 means we're NOT ready for more data. The host stops within a char or two and
+ *	nothing is added to the TX stream. xio_fc_usart() drops it again at the low water mark.
+ */
+
+static inline void _check_rx_high_water(buffer_t count)
+{
+	if (cfg.enable_flow_control == FLOW_CONTROL_RTS) {
+		if (count > RTS_RX_HI_WATER_MARK) {
+			USBu.port->OUTSET = USB_RTS_bm;
+		}
+	} else if ((USB.flag_xoff) && (count > XOFF_RX_HI_WATER_MARK)) {
+		xio_xoff_usart(&USBu);
+	}
+}
+
 ISR(USB_CTS_ISR_vect)
 {
+#ifdef __XIO_DMA
+	_start_tx_dma();							// restart the transmitter
+#else
 	USBu.usart->CTRLA = CTRLA_RXON_TXON;		// force another interrupt
+#endif
 }
 
 /*
@@ -129,47 +379,20 @@ ISR(USB_CTS_ISR_vect)
  *	- signal characters are not put in the RX buffer
  *
  * Flow Control:
- *	- Flow control is not implemented. Need to work RTS line.
- *	- Flow control should cut off at high water mark, re-enable at low water mark
- *	- High water mark should have about 4 - 8 bytes left in buffer (~95% full)
- *	- Low water mark about 50% full
+ *	- Flow control cuts off at the high water mark and re-enables at the low water mark
+ *	- In RTS mode the high water mark leaves 8 bytes in the buffer and the low mark is 50%
+ *	- See _check_rx_high_water() and xio_fc_usart()
  */
 
+#ifndef __XIO_DMA
 ISR(USB_RX_ISR_vect)	//ISR(USARTC0_RXC_vect)	// serial port C0 RX int
 {
 	char c = USBu.usart->DATA;					// can only read DATA once
 
-	if (cs.network_mode == NETWORK_MASTER) {	// forward character if you are a master
-		net_forward(c);
-	}
-	// trap async commands - do not insert character into RX queue
-	if (c == CHAR_RESET) {	 					// trap Kill signal
-		hw_request_hard_reset();
+	controller_post_event(EVENT_RX);
+	if (_trap_rx_char(c) == true) {				// do not insert signals into RX queue
 		return;
 	}
-	if (c == CHAR_FEEDHOLD) {					// trap feedhold signal
-		cm_request_feedhold();
-		return;
-	}
-	if (c == CHAR_QUEUE_FLUSH) {				// trap queue flush signal
-		cm_request_queue_flush();
-		return;
-	}
-	if (c == CHAR_CYCLE_START) {				// trap cycle start signal
-		cm_request_cycle_start();
-		return;
-	}
-	if (USB.flag_xoff) {
-		if (c == XOFF) {						// trap incoming XON/XOFF signals
-			USBu.fc_state_tx = FC_IN_XOFF;
-			return;
-		}
-		if (c == XON) {
-			USBu.fc_state_tx = FC_IN_XON;
-			USBu.usart->CTRLA = CTRLA_RXON_TXOFF;// force a TX interrupt
-			return;
-		}
-	}
 
 	// filter out CRs and LFs if they are to be ignored
 //	if ((c == CR) && (USB.flag_ignorecr)) return;	// REMOVED IGNORE_CR and IGNORE LF handling
@@ -180,9 +403,7 @@ ISR(USB_RX_ISR_vect)	//ISR(USARTC0_RXC_vect)	// serial port C0 RX int
 	if (USBu.rx_buf_head != USBu.rx_buf_tail) {	// buffer is not full
 		USBu.rx_buf[USBu.rx_buf_head] = c;		// write char unless full
 		USBu.rx_buf_count++;
-		if ((USB.flag_xoff) && (xio_get_rx_bufcount_usart(&USBu) > XOFF_RX_HI_WATER_MARK)) {
-			xio_xoff_usart(&USBu);
-		}
+		_check_rx_high_water(xio_get_rx_bufcount_usart(&USBu));
 	} else { 											// buffer-full - toss the incoming character
 		if ((++USBu.rx_buf_head) > RX_BUFFER_SIZE-1) {	// reset the head
 			USBu.rx_buf_count = RX_BUFFER_SIZE-1;		// reset count for good measure
@@ -190,15 +411,29 @@ ISR(USB_RX_ISR_vect)	//ISR(USARTC0_RXC_vect)	// serial port C0 RX int
 		}
 	}
 }
+#endif // __XIO_DMA
 
 /*
  * xio_get_usb_rx_free() - returns free space in the USB RX buffer
  *
  *	Remember: The queues fill from top to bottom, w/0 being the wrap location
+ *	Location 0 is never used and one location is kept empty to tell full from empty,
+ *	so this is the number of chars the host can send without any being dropped.
+ *	In FLOW_CONTROL_COUNT mode it is reported with every response.
  */
 buffer_t xio_get_usb_rx_free(void)
 {
-	return (RX_BUFFER_SIZE - xio_get_rx_bufcount_usart(&USBu));
+	return (RX_BUFFER_SIZE - 2 - xio_get_rx_bufcount_usart(&USBu));
+}
+
+/*
+ * xio_get_usb_tx_free() - returns free space in the USB TX buffer
+ *
+ *	This is the number of chars that can be written without waiting on the transmitter.
+ */
+buffer_t xio_get_usb_tx_free(void)
+{
+	return (TX_BUFFER_SIZE - 2 - xio_get_tx_bufcount_usart(&USBu));
 }
 
 /*
@@ -211,6 +446,11 @@ void xio_reset_usb_rx_buffers(void)
 	USB.flag_in_line = false;
 
 	// reset RX interrupt circular buffer
+#ifdef __XIO_DMA
+	xio_scan_rx_usb();			// the DMA keeps its place, so drop what it has received
+	USBu.rx_buf_tail = USBu.rx_buf_head;
+#else
 	USBu.rx_buf_head = 1;		// can't use location 0 in circular buffer
 	USBu.rx_buf_tail = 1;
+#endif
 }
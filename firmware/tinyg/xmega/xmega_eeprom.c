@@ -437,6 +437,49 @@ uint16_t EEPROM_ReadBytes(const uint16_t address, int8_t *buf, const uint16_t si
 #endif //__NNVM
 }
 
+/*
+ * EEPROM_ReadBlock() - read N bytes from EEPROM in one pass using memory mapping
+ *
+ *	EEPROM_ReadBytes() sets the address and waits on the NVM controller for every byte.
+ *	With the EEPROM mapped into data memory a block read is a plain copy. Mapping is
+ *	turned off again on exit as all the other functions here use IO-mapped access.
+ */
+
+uint16_t EEPROM_ReadBlock(const uint16_t address, int8_t *buf, const uint16_t size)
+{
+#ifdef __NNVM
+	NNVM_ReadBytes(address, buf, size);
+#else
+	EEPROM_WaitForNVM();					// mapped reads are not valid while NVM is busy
+	EEPROM_EnableMapping();
+	memcpy(buf, (const void *)(MAPPED_EEPROM_START + address), size);
+	EEPROM_DisableMapping();
+#endif //__NNVM
+	return (address + size);
+}
+
+/*
+ * EEPROM_WritePage() - write one full page with a single erase/write
+ *
+ *	The address must be on a page boundary and buf must hold EEPROM_PAGESIZE bytes.
+ *	EEPROM_WriteBytes() does an erase/write of the page for every byte it writes;
+ *	this loads the page buffer and writes it once.
+ *
+ *	Returns address past the write
+ */
+
+uint16_t EEPROM_WritePage(const uint16_t address, const int8_t *buf)
+{
+#ifdef __NNVM
+	NNVM_WriteBytes(address, buf, EEPROM_PAGESIZE);
+#else
+	EEPROM_FlushBuffer();					// prevent unintentional write
+	EEPROM_LoadPage((const uint8_t *)buf);
+	EEPROM_AtomicWritePage((uint8_t)(address / EEPROM_PAGESIZE));
+#endif //__NNVM
+	return (address + EEPROM_PAGESIZE);
+}
+
 /*************************************************************************
  ****** Functions from Atmel eeprom_driver.c w/some changes **************
  *************************************************************************/
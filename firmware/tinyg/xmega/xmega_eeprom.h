@@ -79,6 +79,8 @@ uint16_t EEPROM_WriteString(const uint16_t address, const char *buf, const uint8
 uint16_t EEPROM_ReadString(const uint16_t address, char *buf, const uint16_t size);
 uint16_t EEPROM_WriteBytes(const uint16_t address, const int8_t *buf, const uint16_t size);
 uint16_t EEPROM_ReadBytes(const uint16_t address, int8_t *buf, const uint16_t size);
+uint16_t EEPROM_ReadBlock(const uint16_t address, int8_t *buf, const uint16_t size);
+uint16_t EEPROM_WritePage(const uint16_t address, const int8_t *buf);
 
 //#ifdef __UNIT_TEST_EEPROM
 void EEPROM_unit_tests(void);
@@ -23,6 +23,13 @@
 #include "../tinyg.h"
 #include "../config.h"
 #include "../switch.h"
+#include "../controller.h"
+#ifdef __XIO_DMA
+#include <stdio.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include "../xio.h"
+#endif
 #include "xmega_rtc.h"
 
 rtClock_t rtc;		// allocate clock control struct
@@ -43,7 +50,7 @@ void rtc_init()
 	do {} while (RTC.STATUS & RTC_SYNCBUSY_bm);			// Wait until RTC is not busy
 
 	// the following must be in this order or it doesn;t work
-	RTC.PER = RTC_MILLISECONDS-1;						// set overflow period to 10ms - approximate
+	RTC.PER = RTC_MILLISECONDS-1;						// set overflow period to 2ms - approximate
 	RTC.CNT = 0;
 	RTC.COMP = RTC_MILLISECONDS-1;
 	RTC.CTRL = RTC_PRESCALER_DIV1_gc;					// no prescale (1x)
@@ -72,8 +79,13 @@ void rtc_init()
 
 ISR(RTC_COMP_vect)
 {
-	rtc.sys_ticks = ++rtc.rtc_ticks*10;		// advance both tick counters as appropriate
+	rtc.sys_ticks = ++rtc.rtc_ticks*RTC_MILLISECONDS;	// advance both tick counters as appropriate
+	controller_post_event(EVENT_TICK);		// the timers and timed reports run from the next pass
+	controller_publish(TOPIC_TICK);			// ...and the subscribers waiting on time
 
 	// callbacks to whatever you need to happen on each RTC tick go here:
 	switch_rtc_callback();					// switch debouncing
+#ifdef __XIO_DMA
+	xio_rtc_callback_usb();					// trap signals received by DMA
+#endif
 }
@@ -109,6 +109,8 @@ ENABLE_LOCK_BITS = yes
 ENABLE_FUSE_BITS = yes
 ENABLE_FLASH_ERASE_WRITE = yes
 ENABLE_CRC_SUPPORT = yes
+ENABLE_FAST_UPDATE = yes
+ENABLE_DELTA_UPDATE = yes
 
 # API
 ENABLE_API = yes
@@ -131,6 +133,7 @@ ENTER_PIN_PUEN        = 1
 # ENTER_DELAY
 ENTER_BLINK_COUNT     = 12
 ENTER_BLINK_WAIT      = 250000
+ENTER_DELAY_ON_REQUEST = yes
 
 # ENTER_UART
 ENTER_UART_NEED_SYNC = yes
@@ -86,6 +86,16 @@
 
 #define CMD_CRC                 'h'
 
+// Fast Update Commands
+#define CMD_CHECK_FAST_UPDATE   'w'
+#define CMD_SET_BAUD            'Z'
+#define CMD_STREAM_LOAD         'W'
+#define CMD_HARDWARE_CRC        'K'
+
+// Delta Update Commands
+#define CMD_PATCH_START         'X'
+#define CMD_PATCH_PAGE          'u'
+
 // I2C Address Autonegotiation Commands
 #define CMD_AUTONEG_START       '@'
 #define CMD_AUTONEG_DONE        '#'
@@ -103,6 +113,11 @@
 #define SECTION_APP             'a'
 #define SECTION_APP_TEMP        't'
 
+// Patch page ops
+#define PATCH_OP_KEEP           0x00    // 0x00-0x7f: keep the next op+1 installed bytes
+#define PATCH_OP_FILL           0x80    // 0x80-0xbf: set the next op-0x7f bytes to the byte that follows
+#define PATCH_OP_LITERAL        0xc0    // 0xc0-0xff: op-0xbf new bytes follow
+
 // Command Responses
 #define REPLY_ACK               '\r'
 #define REPLY_YES               'Y'
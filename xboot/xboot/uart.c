@@ -94,6 +94,23 @@ void uart_deinit(void)
         UART_DEVICE.BAUDCTRLB = 0;
         UART_PORT.DIRCLR = (1 << UART_TX_PIN);
 }
+
+#ifdef ENABLE_FAST_UPDATE
+// BSEL and BSCALE values for a 32MHz clock without CLK2X, indexed by rate code
+static const uint8_t uart_bsel[UART_BAUD_CODES] = { 0, 207, 103, 51, 34, 33, 31, 27, 19, 1, 1 };
+static const uint8_t uart_bscale[UART_BAUD_CODES] = { 0, 0, 0, 0, 0, 0xF0, 0xE0, 0xD0, 0xC0, 0x10, 0 };
+
+// Change the baud rate once the last character has gone out
+void uart_set_baud(unsigned char baud)
+{
+        #ifdef USE_INTERRUPTS
+        while (tx_char_cnt != 0) { };
+        #endif // USE_INTERRUPTS
+        UART_DEVICE.CTRLB &= ~USART_CLK2X_bm;
+        UART_DEVICE.BAUDCTRLA = uart_bsel[baud];
+        UART_DEVICE.BAUDCTRLB = uart_bscale[baud];
+}
+#endif // ENABLE_FAST_UPDATE
 /*
 void uart_send_string(char *s) 
 {
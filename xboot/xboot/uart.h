@@ -67,9 +67,16 @@
 
 #endif // __AVR_XMEGA__
 
+// rate codes follow the TinyG $baud setting, 1 (9600) to 10 (1000000)
+#define UART_BAUD_CODES         11
+#define uart_baud_valid(b) ((b) != 0 && (b) < UART_BAUD_CODES)
+
 // Prototypes
 extern void uart_init(void);
 extern void uart_deinit(void);
+#ifdef ENABLE_FAST_UPDATE
+extern void uart_set_baud(unsigned char baud);
+#endif // ENABLE_FAST_UPDATE
 //extern void uart_send_string(char *s);
 
 #endif // __UART_H
@@ -54,10 +54,18 @@ unsigned char comm_mode;
 
 unsigned char buffer[SPM_PAGESIZE];
 
+#ifdef ENABLE_FAST_UPDATE
+unsigned char stream_buffer[FAST_UPDATE_PAGES * SPM_PAGESIZE];
+#endif // ENABLE_FAST_UPDATE
+
 #ifdef NEED_CODE_PROTECTION
 unsigned char protected;
 #endif // NEED_CODE_PROTECTION
 
+#ifdef ENABLE_DELTA_UPDATE
+unsigned char patch_base;
+#endif // ENABLE_DELTA_UPDATE
+
 // Main code
 int main(void)
 {
@@ -72,6 +80,10 @@ int main(void)
         protected = 1;
         #endif // NEED_CODE_PROTECTION
         
+        #ifdef ENABLE_DELTA_UPDATE
+        patch_base = 0;
+        #endif // ENABLE_DELTA_UPDATE
+        
         #ifdef USE_I2C_ADDRESS_NEGOTIATION
         unsigned short devid_bit;
         #endif // USE_I2C_ADDRESS_NEGOTIATION
@@ -239,6 +251,14 @@ int main(void)
 			RST.STATUS = 0xFF;			// reset all status bits (just to be sure)
 			k *= 20;					// 20 times the timeout delay, which is typically 3 seconds.
 		}
+		#ifdef ENTER_DELAY_ON_REQUEST
+		// Fast path: any other reset (power-up, reset button, watchdog) jumps straight to
+		// the application. The software reset is the request the application leaves with
+		// hw_request_bootloader(). An erased application always waits for an update.
+		else if (Flash_ReadWord(0) != 0xFFFF) {
+			k = 0;
+		}
+		#endif // ENTER_DELAY_ON_REQUEST
 		// ++++ regular code resumes from here
 
         j = ENTER_BLINK_WAIT;
@@ -397,6 +417,11 @@ int main(void)
                         protected = 0;
                         #endif // NEED_CODE_PROTECTION
                         
+                        // nothing left to patch against
+                        #ifdef ENABLE_DELTA_UPDATE
+                        patch_base = 0;
+                        #endif // ENABLE_DELTA_UPDATE
+                        
                         // acknowledge
                         send_char(REPLY_ACK);
                 }
@@ -630,6 +655,89 @@ int main(void)
                         send_char(crc & 0xff);
                 }
                 #endif // ENABLE_CRC_SUPPORT
+                #ifdef ENABLE_FAST_UPDATE
+                // Check fast update support
+                else if (val == CMD_CHECK_FAST_UPDATE)
+                {
+                        // yes, it is supported
+                        send_char(REPLY_YES);
+                        // Send the most pages one streamed block may carry
+                        send_char(FAST_UPDATE_PAGES);
+                }
+                #ifdef USE_UART
+                // Change baud rate
+                else if (val == CMD_SET_BAUD)
+                {
+                        // Rate code
+                        val = get_char();
+                        if (comm_mode != MODE_UART || !uart_baud_valid(val))
+                        {
+                                send_char(REPLY_ERROR);
+                        }
+                        else
+                        {
+                                // acknowledge at the old rate, then switch
+                                // (if the host never follows, the watchdog
+                                // restarts the bootloader at the default rate)
+                                send_char(REPLY_ACK);
+                                uart_set_baud(val);
+                        }
+                }
+                #endif // USE_UART
+                // Streamed block load
+                else if (val == CMD_STREAM_LOAD)
+                {
+                        // Page count
+                        val = get_char();
+                        // Load it
+                        send_char(StreamLoad(val, &address));
+                }
+                // Hardware CRC
+                else if (val == CMD_HARDWARE_CRC)
+                {
+                        val = get_char();
+                        
+                        if (val == SECTION_APPLICATION)
+                        {
+                                j = SP_ApplicationCRC();
+                        }
+                        else if (val == SECTION_BOOT)
+                        {
+                                j = SP_BootCRC();
+                        }
+                        else
+                        {
+                                send_char(REPLY_ERROR);
+                                continue;
+                        }
+                        
+                        // 24 bit CRC from the NVM controller
+                        send_char((j >> 16) & 0xff);
+                        send_char((j >> 8) & 0xff);
+                        send_char(j & 0xff);
+                }
+                #endif // ENABLE_FAST_UPDATE
+                #ifdef ENABLE_DELTA_UPDATE
+                // Start a patch against the installed image
+                else if (val == CMD_PATCH_START)
+                {
+                        // Hardware CRC of the image the patch was made from
+                        j = (uint32_t)get_char() << 16;
+                        j |= get_2bytes();
+                        
+                        patch_base = (j == (SP_ApplicationCRC() & 0xffffff));
+                        
+                        send_char(patch_base ? REPLY_ACK : REPLY_ERROR);
+                }
+                // Patch one page
+                else if (val == CMD_PATCH_PAGE)
+                {
+                        // Page number
+                        i = get_2bytes();
+                        // Patch it
+                        send_char(PatchLoad(i));
+                }
+                #endif // ENABLE_DELTA_UPDATE
                 #ifdef USE_I2C
                 #ifdef USE_I2C_ADDRESS_NEGOTIATION
                 // Enter autonegotiate mode
@@ -1273,6 +1381,140 @@ void BlockRead(unsigned int size, unsigned char mem, ADDR_T *address)
         
 }
 
+#ifdef ENABLE_FAST_UPDATE
+unsigned char StreamLoad(unsigned char pages, ADDR_T *address)
+{
+        // NOTE: 'address' is given in words, as for BlockLoad.
+        ADDR_T tempaddress = (*address) << 1;
+        unsigned int size = pages * SPM_PAGESIZE;
+        uint16_t crc = 0;
+        uint16_t block_crc;
+        
+        // whole pages only, and only inside the application section
+        if (pages == 0 || pages > FAST_UPDATE_PAGES ||
+                (tempaddress & (SPM_PAGESIZE - 1)) ||
+                tempaddress + size > APP_SECTION_END + 1)
+        {
+                return REPLY_ERROR;
+        }
+        
+        // take the whole block before touching flash, so the receiver
+        // never has to keep up with a page write
+        for (unsigned int i = 0; i < size; i++)
+        {
+                #ifdef USE_WATCHDOG
+                if ((i & (SPM_PAGESIZE - 1)) == 0)
+                        WDT_Reset();
+                #endif // USE_WATCHDOG
+                
+                stream_buffer[i] = get_char();
+        }
+        block_crc = get_2bytes();
+        
+        for (unsigned int i = 0; i < size; i++)
+        {
+                crc = _crc16_update(crc, stream_buffer[i]);
+        }
+        
+        // a bad block leaves the address alone so the host can resend it
+        if (crc != block_crc)
+        {
+                return REPLY_ERROR;
+        }
+        
+        for (unsigned char p = 0; p < pages; p++)
+        {
+                #ifdef USE_WATCHDOG
+                WDT_Reset();
+                #endif // USE_WATCHDOG
+                
+                #ifdef ENABLE_FLASH_ERASE_WRITE
+                Flash_ProgramPage(tempaddress, stream_buffer + p * SPM_PAGESIZE, 1);
+                #else
+                Flash_ProgramPage(tempaddress, stream_buffer + p * SPM_PAGESIZE, 0);
+                #endif
+                tempaddress += SPM_PAGESIZE;
+        }
+        
+        (*address) += size >> 1;
+        
+        return REPLY_ACK; // Report programming OK
+}
+#endif // ENABLE_FAST_UPDATE
+
+#ifdef ENABLE_DELTA_UPDATE
+unsigned char PatchLoad(unsigned int page)
+{
+        uint32_t tempaddress = (uint32_t)page * SPM_PAGESIZE;
+        unsigned int pos = 0;
+        unsigned char changed = 0;
+        unsigned char op;
+        unsigned char n;
+        unsigned char c = 0;
+        uint16_t crc = 0;
+        
+        #ifdef USE_WATCHDOG
+        WDT_Reset();
+        #endif // USE_WATCHDOG
+        
+        // start from the installed page and apply the ops over it
+        Flash_ReadFlashPage(buffer, tempaddress);
+        
+        while (pos < SPM_PAGESIZE)
+        {
+                op = get_char();
+                
+                if (op < PATCH_OP_FILL)
+                {
+                        pos += op - PATCH_OP_KEEP + 1;
+                        continue;
+                }
+                if (op < PATCH_OP_LITERAL)
+                {
+                        n = op - PATCH_OP_FILL + 1;
+                        c = get_char();
+                }
+                else
+                {
+                        n = op - PATCH_OP_LITERAL + 1;
+                }
+                
+                for ( ; n > 0; n--, pos++)
+                {
+                        if (op >= PATCH_OP_LITERAL)
+                                c = get_char();
+                        
+                        // a run past the end of the page is read but dropped,
+                        // and the CRC below will not match
+                        if (pos < SPM_PAGESIZE && buffer[pos] != c)
+                        {
+                                buffer[pos] = c;
+                                changed = 1;
+                        }
+                }
+        }
+        
+        // CRC16 of the patched page
+        for (pos = 0; pos < SPM_PAGESIZE; pos++)
+        {
+                crc = _crc16_update(crc, buffer[pos]);
+        }
+        
+        if (get_2bytes() != crc || !patch_base || tempaddress > APP_SECTION_END)
+        {
+                return REPLY_ERROR;
+        }
+        
+        // pages the patch leaves as they are are not rewritten
+        if (changed)
+        {
+                Flash_ProgramPage(tempaddress, buffer, 1);
+        }
+        
+        return REPLY_ACK; // Report programming OK
+}
+#endif // ENABLE_DELTA_UPDATE
+
 uint16_t crc16_block(uint32_t start, uint32_t length)
 {
         uint16_t crc = 0;
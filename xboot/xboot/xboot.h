@@ -131,6 +131,7 @@
 // ENTER_DELAY
 #define ENTER_BLINK_COUNT       3
 #define ENTER_BLINK_WAIT        30000
+//#define ENTER_DELAY_ON_REQUEST
 
 // ENTER_UART
 //#define ENTER_UART_NEED_SYNC
@@ -284,6 +285,18 @@
 #endif
 #endif
 
+// Fast update
+// Pages in one streamed block; the block is held in RAM until its CRC checks out
+#ifndef FAST_UPDATE_PAGES
+#define FAST_UPDATE_PAGES       8
+#endif
+
+#ifdef ENABLE_FAST_UPDATE
+#if (F_CPU != 32000000L)
+#error Fast update baud rates assume a 32MHz clock!
+#endif // F_CPU
+#endif // ENABLE_FAST_UPDATE
+
 // FIFO
 #define FIFO_DATA_PORT          token_paste2(PORT, FIFO_DATA_PORT_NAME)
 #define FIFO_CTL_PORT           token_paste2(PORT, FIFO_CTL_PORT_NAME)
@@ -387,6 +400,8 @@ void clear_buffer(void);
 
 unsigned char BlockLoad(unsigned int size, unsigned char mem, ADDR_T *address);
 void BlockRead(unsigned int size, unsigned char mem, ADDR_T *address);
+unsigned char StreamLoad(unsigned char pages, ADDR_T *address);
+unsigned char PatchLoad(unsigned int page);
 
 uint16_t crc16_block(uint32_t start, uint32_t length);
 void install_firmware(void);